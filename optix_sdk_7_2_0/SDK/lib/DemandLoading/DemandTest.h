@@ -0,0 +1,54 @@
+#pragma once
+
+#include <iostream>
+
+namespace demandLoading {
+
+/// Minimal checks for the host tests of the library registered with ctest.  A failed check prints
+/// its location and expression and the remaining checks still run; main() returns
+/// demandTestResult(), which is non-zero after any failure.
+inline int& demandTestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+inline void demandTestFail( const char* file, int line, const char* expression )
+{
+    std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+    ++demandTestFailures();
+}
+
+inline int demandTestResult( const char* testName )
+{
+    if( demandTestFailures() == 0 )
+        std::cout << testName << ": all checks passed" << std::endl;
+    else
+        std::cerr << testName << ": " << demandTestFailures() << " checks failed" << std::endl;
+    return demandTestFailures() == 0 ? 0 : 1;
+}
+
+}  // namespace demandLoading
+
+#define DEMAND_CHECK( condition )                                                                  \
+    do                                                                                             \
+    {                                                                                              \
+        if( !( condition ) )                                                                       \
+            demandLoading::demandTestFail( __FILE__, __LINE__, #condition );                       \
+    } while( 0 )
+
+#define DEMAND_CHECK_THROWS( expression, E )                                                       \
+    do                                                                                             \
+    {                                                                                              \
+        bool demandCheckThrown_ = false;                                                           \
+        try                                                                                        \
+        {                                                                                          \
+            expression;                                                                            \
+        }                                                                                          \
+        catch( const E& )                                                                          \
+        {                                                                                          \
+            demandCheckThrown_ = true;                                                             \
+        }                                                                                          \
+        if( !demandCheckThrown_ )                                                                  \
+            demandLoading::demandTestFail( __FILE__, __LINE__, #expression " throws " #E );        \
+    } while( 0 )
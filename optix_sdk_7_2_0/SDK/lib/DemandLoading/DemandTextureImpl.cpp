@@ -196,7 +196,31 @@ void DemandTextureImpl::fillTile( unsigned int deviceIndex,
     size_t                       offset;
     ( *m_tilePools )[deviceIndex].allocate( tileSize, &handle, &offset );
 
-    m_textures[deviceIndex].fillTile( mipLevel, tileX, tileY, tileData, tileSize, handle, offset );
+    fillTile( deviceIndex, mipLevel, tileX, tileY, tileData, tileSize, handle, offset );
+}
+
+void DemandTextureImpl::fillTile( unsigned int                 deviceIndex,
+                                  unsigned int                 mipLevel,
+                                  unsigned int                 tileX,
+                                  unsigned int                 tileY,
+                                  const char*                  tileData,
+                                  size_t                       tileSize,
+                                  CUmemGenericAllocationHandle tileHandle,
+                                  size_t                       tileOffset ) const
+{
+    DEMAND_ASSERT( deviceIndex < m_textures.size() );
+    DEMAND_ASSERT( mipLevel < m_info.numMipLevels );
+    DEMAND_ASSERT( tileSize <= TilePool::TILE_SIZE );
+
+    m_textures[deviceIndex].fillTile( mipLevel, tileX, tileY, tileData, tileSize, tileHandle, tileOffset );
+}
+
+void DemandTextureImpl::unmapTile( unsigned int deviceIndex, unsigned int mipLevel, unsigned int tileX, unsigned int tileY ) const
+{
+    DEMAND_ASSERT( deviceIndex < m_textures.size() );
+    DEMAND_ASSERT( mipLevel < m_info.numMipLevels );
+
+    m_textures[deviceIndex].unmapTile( mipLevel, tileX, tileY );
 }
 
 
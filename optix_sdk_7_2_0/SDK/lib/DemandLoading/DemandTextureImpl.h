@@ -79,6 +79,13 @@ class DemandTextureImpl : public DemandTexture
     /// image reader that was provided to the constructor.  Returns false on error.
     bool init( unsigned int deviceIndex ) override;
 
+    /// Check whether the image has been opened, which happens when the texture is first initialized
+    /// on any device.
+    bool isImageOpen() const { return m_isInitialized; }
+
+    /// Get the image reader, which the tile loader threads read from.
+    const std::shared_ptr<ImageReader>& getImageReader() const { return m_image; }
+
     /// Get the image info.  Valid only after the image has been initialized (e.g. opened).
     const TextureInfo& getInfo() const override
     {
@@ -122,6 +129,20 @@ class DemandTextureImpl : public DemandTexture
         return m_mipTailFirstLevel;
     }
 
+    /// Get the size of the mip tail in bytes, zero if the texture has no mip tail.
+    size_t getMipTailSize() const
+    {
+        DEMAND_ASSERT( m_isInitialized );
+        return m_mipTailSize;
+    }
+
+    /// Get the size of a tile in bytes.
+    size_t getTileSize() const
+    {
+        DEMAND_ASSERT( m_isInitialized );
+        return m_tileWidth * m_tileHeight * getInfo().numChannels * getBytesPerChannel( getInfo().format );
+    }
+
     /// Get the CUDA texture object for the specified device.
     CUtexObject getTextureObject( unsigned int deviceIndex ) const override
     {
@@ -136,6 +157,20 @@ class DemandTextureImpl : public DemandTexture
     /// Map the given tile backing storage and fill it with the given data.
     void fillTile( unsigned int deviceIndex, unsigned int mipLevel, unsigned int tileX, unsigned int tileY, const char* tileData, size_t tileSize ) const override;
 
+    /// Fill the specified tile, mapping the given backing storage, which the caller allocated from
+    /// the tile pool of the device.  The manager uses this to keep track of evictable tiles.
+    void fillTile( unsigned int                 deviceIndex,
+                   unsigned int                 mipLevel,
+                   unsigned int                 tileX,
+                   unsigned int                 tileY,
+                   const char*                  tileData,
+                   size_t                       tileSize,
+                   CUmemGenericAllocationHandle tileHandle,
+                   size_t                       tileOffset ) const;
+
+    /// Unmap the specified tile.  The caller returns its backing storage to the tile pool.
+    void unmapTile( unsigned int deviceIndex, unsigned int mipLevel, unsigned int tileX, unsigned int tileY ) const;
+
     /// Read all the levels in the mip tail into the given buffer, resizing it if necessary.
     bool readMipTail( std::vector<char>* buffer ) const override;
 
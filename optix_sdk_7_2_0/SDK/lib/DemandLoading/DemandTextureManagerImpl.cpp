@@ -30,6 +30,7 @@
 
 #include "DemandTextureImpl.h"
 #include "Exception.h"
+#include "Math.h"
 #include <DemandLoading/DemandTextureContext.h>
 #include <DemandLoading/ImageReader.h>
 #include <DemandLoading/Tex2D.h>
@@ -37,6 +38,8 @@
 #include <optixPaging/optixPaging.h>
 
 #include <algorithm>
+#include <chrono>
+#include <mutex>
 
 namespace demandLoading {
 
@@ -47,6 +50,7 @@ DemandTextureManagerImpl::DemandTextureManagerImpl( const std::vector<unsigned i
     , m_pageTableManager( config.numPages )
     , m_config( config )
     , m_numDevices( static_cast<unsigned int>( devices.size() ) )
+    , m_tileCache( config.maxHostCacheMemory )
 {
     unsigned int numCapableDevices = 0;
     for( unsigned int currDevice : devices )
@@ -99,12 +103,18 @@ DemandTextureManagerImpl::DemandTextureManagerImpl( const std::vector<unsigned i
     m_tilePools.reserve( devices.size() );
     for( unsigned int deviceIndex : devices )
     {
-        m_tilePools.emplace_back( deviceIndex );
+        m_tilePools.emplace_back( deviceIndex, m_config.maxTileMemory );
     }
+
+    if( m_config.numLoaderThreads > 0 )
+        m_tileLoader.reset( new TileLoader( m_config.numLoaderThreads, &m_tileCache ) );
 }
 
 DemandTextureManagerImpl::~DemandTextureManagerImpl()
 {
+    // Stop the loader threads before the images they read from go away.
+    m_tileLoader.reset();
+
     for( PerDeviceState& state : m_perDeviceStates )
     {
         if( state.isActive )
@@ -145,6 +155,9 @@ const DemandTexture& DemandTextureManagerImpl::createTexture( std::shared_ptr<Im
 // a DemandTextureContext via result parameter.
 void DemandTextureManagerImpl::launchPrepare( unsigned int deviceIndex, DemandTextureContext& demandTextureContext )
 {
+    if( m_tileLoader )
+        fillCompletedReads();
+
     DEMAND_CUDA_CHECK( cudaSetDevice( deviceIndex ) );
     demandTextureContext.m_pagingContext = getPagingContext( deviceIndex );
     demandTextureContext.m_textureInfos  = m_textureInfo.synchronize( deviceIndex );
@@ -208,7 +221,8 @@ void DemandTextureManagerImpl::pullRequests()
 // Get page requests from the specified device (via optixPagingPullRequests).
 std::vector<unsigned int> DemandTextureManagerImpl::pullRequests( PerDeviceState& state )
 {
-    // Get a list of requested page ids, along with lists of stale and evictable pages (which are currently unused).
+    // Get a list of requested page ids, along with lists of stale and evictable pages (the latter are
+    // not implemented by the paging library).
     unsigned int* evictablePages    = nullptr;
     unsigned int  numEvictablePages = 0;
     optixPagingPullRequests( state.pagingContext, state.devRequestedPages, m_config.maxRequestedPages, state.devStalePages,
@@ -226,9 +240,54 @@ std::vector<unsigned int> DemandTextureManagerImpl::pullRequests( PerDeviceState
         DEMAND_CUDA_CHECK( cudaMemcpy( requestedPages.data(), state.devRequestedPages,
                                        numRequests * sizeof( unsigned int ), cudaMemcpyDeviceToHost ) );
     }
+
+    // Copy the stale page list, resident pages that were not referenced since the last push.
+    const unsigned int numStalePages = std::min( numReturned[1], m_config.maxStalePages );
+    state.stalePages.resize( numStalePages );
+    if( numStalePages > 0 )
+    {
+        DEMAND_CUDA_CHECK( cudaMemcpy( state.stalePages.data(), state.devStalePages, numStalePages * sizeof( PageMapping ),
+                                       cudaMemcpyDeviceToHost ) );
+    }
+    state.residentTiles.updateEvictionCandidates( state.stalePages, numReturned[1] >= m_config.maxStalePages );
+
     return requestedPages;
 }
 
+bool DemandTextureManagerImpl::hasRoom( unsigned int deviceIndex, size_t numBytes ) const
+{
+    const PerDeviceState& state = m_perDeviceStates[deviceIndex];
+    return m_tilePools[deviceIndex].canAllocate( numBytes )
+           || ( !state.residentTiles.getEvictionCandidates().empty()
+                && state.invalidatedPages.size() < m_config.maxInvalidatedPages );
+}
+
+// Each eviction unmaps the tile and takes a slot in the invalidated page list, which clears the
+// residence bit of the page with the next push, so the device requests the tile again if it needs
+// it.  Other devices keep their copy of the tile.
+bool DemandTextureManagerImpl::makeRoom( unsigned int deviceIndex, size_t numBytes )
+{
+    PerDeviceState& state = m_perDeviceStates[deviceIndex];
+    auto            unmap = [this, deviceIndex]( const ResidentTiles::Tile& tile ) {
+        m_textures[tile.textureId].unmapTile( deviceIndex, tile.mipLevel, tile.tileX, tile.tileY );
+    };
+    const size_t numInvalidated = state.invalidatedPages.size();
+    const bool   fits = state.residentTiles.makeRoom( m_tilePools[deviceIndex], numBytes, m_config.maxInvalidatedPages,
+                                                    state.invalidatedPages, unmap );
+    m_numEvictedTiles += static_cast<unsigned int>( state.invalidatedPages.size() - numInvalidated );
+    return fits;
+}
+
+bool DemandTextureManagerImpl::isTileResidentOnAllDevices( unsigned int pageId ) const
+{
+    for( const PerDeviceState& state : m_perDeviceStates )
+    {
+        if( state.isActive && !state.residentTiles.contains( pageId ) )
+            return false;
+    }
+    return true;
+}
+
 // Process page requests.
 int DemandTextureManagerImpl::processRequests()
 {
@@ -241,7 +300,7 @@ int DemandTextureManagerImpl::processRequests()
         const unsigned int textureId = m_pageTableManager.getResource( request.pageId );
 
         // The texture id serves as an index.
-        DemandTexture*           texture = &m_textures[textureId];
+        DemandTextureImpl*       texture = &m_textures[textureId];
         const DemandTextureInfo& info    = m_textureInfo.get( textureId );
 
         // Process the request.
@@ -256,9 +315,12 @@ int DemandTextureManagerImpl::processRequests()
 }
 
 // The start page is requested (1) if the texture is uninitialized, or (2) if a miplevel in the mip tail is required.
-void DemandTextureManagerImpl::processStartPageRequest( const PageRequest& request, DemandTexture* texture )
+// A mip tail that does not fit in the tile pool of a device is not filled, the device requests it again.  With
+// loader threads, an image that has not been opened yet is opened in the background.
+void DemandTextureManagerImpl::processStartPageRequest( const PageRequest& request, DemandTextureImpl* texture )
 {
-    bool mipTailLoaded = false;
+    std::bitset<MAX_NUM_DEVICES> mipTailDevices;
+    std::bitset<MAX_NUM_DEVICES> openDevices;
     for( unsigned int deviceIndex = 0; deviceIndex < MAX_NUM_DEVICES; ++deviceIndex )
     {
         if( !request.devices[deviceIndex] )
@@ -266,32 +328,68 @@ void DemandTextureManagerImpl::processStartPageRequest( const PageRequest& reque
 
         if( texture->isInitialized( deviceIndex ) )
         {
-            if( !mipTailLoaded )
+            if( !hasRoom( deviceIndex, texture->getMipTailSize() ) )
             {
-                // Read the mip tail (into a member variable, which amortizes allocation overhead).
-                const bool ok = texture->readMipTail( &m_tileBuff );
-                DEMAND_ASSERT_MSG( ok, "readMipTail call failed" );
-                mipTailLoaded = true;
+                ++m_numDeniedRequests;
+                continue;
             }
-            texture->fillMipTail( deviceIndex, m_tileBuff.data(), m_tileBuff.size() );
+            mipTailDevices.set( deviceIndex );
+        }
+        else if( m_tileLoader && !texture->isImageOpen() )
+        {
+            openDevices.set( deviceIndex );
         }
         else
         {
+            // Without loader threads the image is opened here, otherwise it is open already.
             initTexture( deviceIndex, texture );
+            PerDeviceState& state = m_perDeviceStates[deviceIndex];
+            state.filledPages.push_back( PageMapping{request.pageId, 1 /*arbitrary*/} );
+            m_filledPages.push_back( request.pageId );
+            ++m_numFilledRequests;
         }
+    }
 
-        // Push page mapping for the requested page.
-        PerDeviceState& state = m_perDeviceStates[deviceIndex];
-        state.filledPages.push_back( PageMapping{request.pageId, 1 /*arbitrary*/} );
+    if( openDevices.any() )
+    {
+        TileReadRequest read;
+        read.kind    = TileReadRequest::OPEN;
+        read.pageId  = request.pageId;
+        read.image   = texture->getImageReader();
+        read.devices = openDevices;
+        m_tileLoader->enqueue( read );
+    }
+
+    if( mipTailDevices.any() )
+    {
+        const TextureInfo& info = texture->getInfo();
+        TileReadRequest    read;
+        read.kind         = TileReadRequest::MIP_TAIL;
+        read.pageId       = request.pageId;
+        read.image        = texture->getImageReader();
+        read.devices      = mipTailDevices;
+        read.mipLevel     = texture->getMipTailFirstLevel();
+        read.numMipLevels = info.numMipLevels;
+        read.pixelSize    = info.numChannels * getBytesPerChannel( info.format );
+        read.size         = texture->getMipTailSize();
+        for( unsigned int level = 0; level < info.numMipLevels; ++level )
+            read.mipLevelDims.push_back( texture->getMipLevelDims( level ) );
+        loadPage( read, texture );
     }
 }
 
 // Initialize texture in preparation for reading tile data.
-void DemandTextureManagerImpl::initTexture( unsigned int deviceIndex, DemandTexture* texture )
+void DemandTextureManagerImpl::initTexture( unsigned int deviceIndex, DemandTextureImpl* texture )
 {
-    // Initialize the texture, reading image info from file header.
+    // Initialize the texture, reading image info from file header.  The loader threads may be
+    // reading from the image if it is already open on another device.
+    std::unique_lock<std::mutex> imageLock;
+    if( m_tileLoader )
+        imageLock = std::unique_lock<std::mutex>( m_tileLoader->getImageMutex( texture->getImageReader().get() ) );
     const bool ok = texture->init( deviceIndex );
     DEMAND_ASSERT_MSG( ok, "ImageReader::init() failed" );
+    if( imageLock.owns_lock() )
+        imageLock.unlock();
 
     // Update device texture info.
     const unsigned int textureId = texture->getId();
@@ -303,8 +401,23 @@ void DemandTextureManagerImpl::initTexture( unsigned int deviceIndex, DemandText
     state.textureObjects.set( textureId, texture->getTextureObject( deviceIndex ) );
 }
 
-void DemandTextureManagerImpl::processTileRequest( const PageRequest& request, DemandTexture* texture )
+// Tiles that do not fit in the tile pool of a device are not filled, the device keeps requesting them and the
+// application falls back to a coarser level.
+void DemandTextureManagerImpl::processTileRequest( const PageRequest& request, DemandTextureImpl* texture )
 {
+    // Skip the read if none of the requesting devices has room for the tile.
+    std::bitset<MAX_NUM_DEVICES> devices = request.devices;
+    for( unsigned int deviceIndex = 0; deviceIndex < MAX_NUM_DEVICES; ++deviceIndex )
+    {
+        if( devices[deviceIndex] && !hasRoom( deviceIndex, texture->getTileSize() ) )
+        {
+            devices.reset( deviceIndex );
+            ++m_numDeniedRequests;
+        }
+    }
+    if( devices.none() )
+        return;
+
     // Unpack tile index into miplevel and tile coordinates.
     const unsigned int tileIndex = request.pageId - texture->getDeviceInfo().startPage;
     unsigned int       mipLevel;
@@ -312,25 +425,180 @@ void DemandTextureManagerImpl::processTileRequest( const PageRequest& request, D
     unsigned int       tileY;
     unpackTileIndex( texture->getDeviceInfo(), tileIndex, mipLevel, tileX, tileY );
 
-    // Read the tile from disk into the tile buffer (which is a member variable, in order to amortize allocation overhead).
-    const bool ok = texture->readTile( mipLevel, tileX, tileY, &m_tileBuff );
-    DEMAND_ASSERT_MSG( ok, "readTile call failed" );
+    TileReadRequest read;
+    read.kind       = TileReadRequest::TILE;
+    read.pageId     = request.pageId;
+    read.image      = texture->getImageReader();
+    read.devices    = devices;
+    read.mipLevel   = mipLevel;
+    read.tileX      = tileX;
+    read.tileY      = tileY;
+    read.tileWidth  = texture->getTileWidth();
+    read.tileHeight = texture->getTileHeight();
+    read.size       = texture->getTileSize();
+    loadPage( read, texture );
+
+    if( m_tileLoader && m_config.prefetchNeighbors && m_tileCache.getMaxBytes() > 0 )
+        prefetchNeighbors( texture, mipLevel, tileX, tileY );
+}
+
+void DemandTextureManagerImpl::loadPage( const TileReadRequest& read, DemandTextureImpl* texture )
+{
+    // A read that is already under way fills the page when it is done; requesting it again raises its priority.
+    if( m_tileLoader && m_tileLoader->isPending( read.pageId ) )
+    {
+        m_tileLoader->enqueue( read );
+        return;
+    }
+
+    const TileCache::Data data = m_tileCache.find( read.pageId );
+    if( data )
+    {
+        fillPage( read, texture, data->data(), data->size() );
+    }
+    else if( m_tileLoader )
+    {
+        m_tileLoader->enqueue( read );
+    }
+    else
+    {
+        // Read the page into the tile buffer (which is a member variable, in order to amortize allocation overhead).
+        const auto start = std::chrono::steady_clock::now();
+        bool       ok;
+        if( read.kind == TileReadRequest::TILE )
+        {
+            ok = texture->readTile( read.mipLevel, read.tileX, read.tileY, &m_tileBuff );
+            DEMAND_ASSERT_MSG( ok, "readTile call failed" );
+        }
+        else
+        {
+            ok = texture->readMipTail( &m_tileBuff );
+            DEMAND_ASSERT_MSG( ok, "readMipTail call failed" );
+        }
+        ++m_numSyncReads;
+        m_syncBytesRead += m_tileBuff.size();
+        m_syncReadSeconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
 
-    // Fill all requests for the same page from different devices.
+        if( m_tileCache.getMaxBytes() > 0 )
+            m_tileCache.insert( read.pageId, std::make_shared<const std::vector<char>>( m_tileBuff ) );
+        fillPage( read, texture, m_tileBuff.data(), m_tileBuff.size() );
+    }
+}
+
+// The tile pools are checked again, they may have filled up since the page was requested.  Stale
+// tiles are evicted to make room.
+void DemandTextureManagerImpl::fillPage( const TileReadRequest& read, DemandTextureImpl* texture, const char* data, size_t size )
+{
     for( unsigned int deviceIndex = 0; deviceIndex < MAX_NUM_DEVICES; ++deviceIndex )
     {
-        if( !request.devices[deviceIndex] )
+        if( !read.devices[deviceIndex] )
+            continue;
+        if( !makeRoom( deviceIndex, size ) )
+        {
+            ++m_numDeniedRequests;
             continue;
+        }
 
-        texture->fillTile( deviceIndex, mipLevel, tileX, tileY, m_tileBuff.data(), m_tileBuff.size() );
+        PerDeviceState& state = m_perDeviceStates[deviceIndex];
+        if( read.kind == TileReadRequest::TILE )
+        {
+            // Allocate the tile here rather than in the texture, so that it can be evicted later.
+            ResidentTiles::Tile tile{};
+            m_tilePools[deviceIndex].allocate( size, &tile.handle, &tile.offset );
+            texture->fillTile( deviceIndex, read.mipLevel, read.tileX, read.tileY, data, size, tile.handle, tile.offset );
+            tile.textureId = texture->getId();
+            tile.mipLevel  = read.mipLevel;
+            tile.tileX     = read.tileX;
+            tile.tileY     = read.tileY;
+            state.residentTiles.insert( read.pageId, tile );
+        }
+        else
+        {
+            texture->fillMipTail( deviceIndex, data, size );
+        }
 
         // Record the new page mapping.  Note that we don't currently use the value in the page table
         // entry.  Mapping to a boolean would suffice.
-        PerDeviceState& state = m_perDeviceStates[deviceIndex];
-        state.filledPages.push_back( PageMapping{request.pageId, 1 /*arbitrary*/} );
+        state.filledPages.push_back( PageMapping{read.pageId, 1 /*arbitrary*/} );
+        m_filledPages.push_back( read.pageId );
+        ++m_numFilledRequests;
+    }
+}
+
+// A lookup near the edge of a tile is likely to be followed by lookups in the tile next to it, in the
+// next launch or a few pixels later.  Neighbors are not wrapped around the texture border.
+void DemandTextureManagerImpl::prefetchNeighbors( DemandTextureImpl* texture, unsigned int mipLevel, unsigned int tileX, unsigned int tileY )
+{
+    const DemandTextureInfo& info        = texture->getDeviceInfo();
+    const uint2              levelDims   = texture->getMipLevelDims( mipLevel );
+    const int                levelTilesX = static_cast<int>( idivCeil( levelDims.x, texture->getTileWidth() ) );
+    const int                levelTilesY = static_cast<int>( idivCeil( levelDims.y, texture->getTileHeight() ) );
+
+    for( int y = static_cast<int>( tileY ) - 1; y <= static_cast<int>( tileY ) + 1; ++y )
+    {
+        for( int x = static_cast<int>( tileX ) - 1; x <= static_cast<int>( tileX ) + 1; ++x )
+        {
+            if( x < 0 || y < 0 || x >= levelTilesX || y >= levelTilesY || ( x == static_cast<int>( tileX ) && y == static_cast<int>( tileY ) ) )
+                continue;
+
+            const unsigned int pageId =
+                info.startPage + calculateTileIndexFromTileCoords( info, mipLevel, static_cast<unsigned int>( x ),
+                                                                   static_cast<unsigned int>( y ), levelDims.x );
+            if( isTileResidentOnAllDevices( pageId ) || m_tileCache.contains( pageId ) || m_tileLoader->isPending( pageId ) )
+                continue;
+
+            TileReadRequest read;
+            read.kind       = TileReadRequest::TILE;
+            read.pageId     = pageId;
+            read.image      = texture->getImageReader();
+            read.prefetch   = true;
+            read.mipLevel   = mipLevel;
+            read.tileX      = static_cast<unsigned int>( x );
+            read.tileY      = static_cast<unsigned int>( y );
+            read.tileWidth  = texture->getTileWidth();
+            read.tileHeight = texture->getTileHeight();
+            read.size       = texture->getTileSize();
+            m_tileLoader->enqueue( read );
+        }
     }
 }
 
+// Called from launchPrepare().  The loader threads keep reading while the pages are filled.
+void DemandTextureManagerImpl::fillCompletedReads()
+{
+    m_tileLoader->takeCompleted( m_completedReads );
+    if( m_completedReads.empty() )
+        return;
+
+    for( const TileReadResult& result : m_completedReads )
+    {
+        const TileReadRequest& read    = result.request;
+        DemandTextureImpl*     texture = &m_textures[m_pageTableManager.getResource( read.pageId )];
+        if( read.kind == TileReadRequest::OPEN )
+        {
+            DEMAND_ASSERT_MSG( result.ok, "ImageReader::open() failed" );
+            for( unsigned int deviceIndex = 0; deviceIndex < MAX_NUM_DEVICES; ++deviceIndex )
+            {
+                if( !read.devices[deviceIndex] || texture->isInitialized( deviceIndex ) )
+                    continue;
+                initTexture( deviceIndex, texture );
+                PerDeviceState& state = m_perDeviceStates[deviceIndex];
+                state.filledPages.push_back( PageMapping{read.pageId, 1 /*arbitrary*/} );
+                m_filledPages.push_back( read.pageId );
+                ++m_numFilledRequests;
+            }
+        }
+        else
+        {
+            DEMAND_ASSERT_MSG( result.ok, read.kind == TileReadRequest::TILE ? "readTile call failed" : "readMipTail call failed" );
+            fillPage( read, texture, result.data->data(), result.data->size() );
+        }
+    }
+    m_completedReads.clear();
+
+    pushMappings();
+}
+
 // Push tile mappings to the device.  Returns the total number of new mappings.
 unsigned int DemandTextureManagerImpl::pushMappings()
 {
@@ -365,6 +633,48 @@ unsigned DemandTextureManagerImpl::reservePages( unsigned numPages )
     return m_pageTableManager.reserve( numPages, noResourceId );
 }
 
+DemandTextureManagerStats DemandTextureManagerImpl::getStats() const
+{
+    DemandTextureManagerStats stats{};
+    for( const TilePool& pool : m_tilePools )
+        stats.tileMemory += pool.getAllocatedBytes();
+    stats.numFilledRequests = m_numFilledRequests;
+    stats.numDeniedRequests = m_numDeniedRequests;
+    stats.numEvictedTiles   = m_numEvictedTiles;
+
+    stats.hostCacheMemory = m_tileCache.getBytes();
+    stats.numCacheHits    = m_tileCache.getNumHits();
+    stats.numCacheMisses  = m_tileCache.getNumMisses();
+    stats.numPrefetchHits = m_tileCache.getNumPrefetchHits();
+    stats.numTileReads    = m_numSyncReads;
+    stats.bytesRead       = m_syncBytesRead;
+    stats.readSeconds     = m_syncReadSeconds;
+    if( m_tileLoader )
+    {
+        stats.numTileReads += m_tileLoader->getNumReads();
+        stats.numPrefetchReads = m_tileLoader->getNumPrefetchReads();
+        stats.numPendingReads  = m_tileLoader->getNumPending();
+        stats.bytesRead += m_tileLoader->getBytesRead();
+        stats.readSeconds += m_tileLoader->getReadSeconds();
+    }
+    return stats;
+}
+
+std::vector<unsigned int> DemandTextureManagerImpl::getRequestedPages() const
+{
+    std::vector<unsigned int> pageIds;
+    pageIds.reserve( m_pageRequests.size() );
+    for( const PageRequest& request : m_pageRequests )
+        pageIds.push_back( request.pageId );
+    return pageIds;
+}
+
+void DemandTextureManagerImpl::takeFilledPages( std::vector<unsigned int>& pageIds )
+{
+    pageIds.insert( pageIds.end(), m_filledPages.begin(), m_filledPages.end() );
+    m_filledPages.clear();
+}
+
 DemandTextureManager* createDemandTextureManager( const std::vector<unsigned int>& devices, const DemandTextureManagerConfig& config )
 {
     return new DemandTextureManagerImpl( devices, config );
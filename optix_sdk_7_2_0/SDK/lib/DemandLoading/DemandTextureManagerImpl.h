@@ -30,6 +30,9 @@
 
 #include "ExtensibleArray.h"
 #include "PageTableManager.h"
+#include "ResidentTiles.h"
+#include "TileCache.h"
+#include "TileLoader.h"
 #include "TilePool.h"
 #include <DemandLoading/DemandTextureInfo.h>
 #include <DemandLoading/DemandTextureManager.h>
@@ -67,10 +70,13 @@ class DemandTextureManagerImpl : public DemandTextureManager
     const DemandTexture& createTexture( std::shared_ptr<ImageReader> image, const TextureDescriptor& textureDesc ) override;
 
     /// Prepare for launch, updating device-side texture sampler and texture array. Returns
-    /// a DemandTextureContext via result parameter.
+    /// a DemandTextureContext via result parameter.  Tiles the loader threads have finished reading
+    /// are filled and mapped on all devices first.
     void launchPrepare( unsigned int deviceIndex, DemandTextureContext& demandTextureContext ) override;
 
-    /// Process requests for missing tiles (from optixPagingMapOrRequest).
+    /// Process requests for missing tiles (from optixPagingMapOrRequest).  With loader threads,
+    /// only the requests found in the host cache are filled here; the others are read in the
+    /// background and filled by a later launchPrepare().
     int processRequests() override;
 
     // Push tile mappings to the device.  Returns the total number of new mappings.
@@ -78,6 +84,16 @@ class DemandTextureManagerImpl : public DemandTextureManager
 
     unsigned int reservePages( unsigned int numPages ) override;
 
+    /// Get the memory use and request counters.
+    DemandTextureManagerStats getStats() const override;
+
+    /// Get the pages requested by the devices in the launch before the last processRequests(), in
+    /// ascending order.
+    std::vector<unsigned int> getRequestedPages() const override;
+
+    /// Append the pages filled on any device since the last call to the given vector.
+    void takeFilledPages( std::vector<unsigned int>& pageIds ) override;
+
   private:
     static const unsigned int MAX_NUM_DEVICES = 32;
 
@@ -105,7 +121,9 @@ class DemandTextureManagerImpl : public DemandTextureManager
         std::vector<PageMapping>  filledPages;
         std::vector<PageMapping>  stalePages;
         std::vector<unsigned int> invalidatedPages;
-        int                       launchNum = 0;
+
+        // Tiles filled on this device and the stale ones among them, in eviction order.
+        ResidentTiles residentTiles;
 
         ExtensibleArray<CUtexObject> textureObjects;
     };
@@ -121,6 +139,19 @@ class DemandTextureManagerImpl : public DemandTextureManager
     std::vector<TilePool>              m_tilePools;  // one per device.
     DemandTextureManagerConfig         m_config;
     unsigned int                       m_numDevices;
+    unsigned int                       m_numFilledRequests = 0;
+    unsigned int                       m_numDeniedRequests = 0;
+    unsigned int                       m_numEvictedTiles   = 0;
+    std::vector<unsigned int>          m_filledPages;  // since the last takeFilledPages()
+
+    // Tile data read from the images, shared by all textures, and the threads that read it.  The
+    // loader is null if reads are done in processRequests().
+    TileCache                          m_tileCache;
+    std::unique_ptr<TileLoader>        m_tileLoader;
+    std::vector<TileReadResult>        m_completedReads;
+    unsigned int                       m_numSyncReads    = 0;
+    size_t                             m_syncBytesRead   = 0;
+    double                             m_syncReadSeconds = 0.0;
 
     /// Get the OptiX paging library context, which is passed as a launch parameter and used to call
     /// optixPagingMapOrRequest.
@@ -134,9 +165,25 @@ class DemandTextureManagerImpl : public DemandTextureManager
     // Get page requests from the device (via optixPagingPullRequests).
     std::vector<unsigned int> pullRequests( PerDeviceState& state );
 
-    void processStartPageRequest( const PageRequest& request, DemandTexture* texture );
-    void processTileRequest( const PageRequest& request, DemandTexture* texture );
-    void initTexture( unsigned int deviceIndex, DemandTexture* texture );
+    // Check whether an allocation fits in the tile pool of the device, possibly after evicting tiles.
+    bool hasRoom( unsigned int deviceIndex, size_t numBytes ) const;
+    // Evict stale tiles from the device until an allocation fits.  Returns false if it does not.
+    bool makeRoom( unsigned int deviceIndex, size_t numBytes );
+    // Check whether the tile is resident on every active device, so that prefetching it is useless.
+    bool isTileResidentOnAllDevices( unsigned int pageId ) const;
+
+    void processStartPageRequest( const PageRequest& request, DemandTextureImpl* texture );
+    void processTileRequest( const PageRequest& request, DemandTextureImpl* texture );
+    void initTexture( unsigned int deviceIndex, DemandTextureImpl* texture );
+
+    // Fill a tile or mip tail from the host cache, read it now, or hand it to the loader threads.
+    void loadPage( const TileReadRequest& read, DemandTextureImpl* texture );
+    // Map and fill a tile or mip tail on the devices of the read that have room for it.
+    void fillPage( const TileReadRequest& read, DemandTextureImpl* texture, const char* data, size_t size );
+    // Queue reads of the tiles around the given one into the host cache.
+    void prefetchNeighbors( DemandTextureImpl* texture, unsigned int mipLevel, unsigned int tileX, unsigned int tileY );
+    // Initialize the textures and fill the pages the loader threads have finished reading.
+    void fillCompletedReads();
 };
 
 }  // namespace demandLoading
@@ -0,0 +1,291 @@
+#include <DemandLoading/MappedTileImageReader.h>
+
+#include "Exception.h"
+#include "Math.h"
+#include "TileCompression.h"
+#include <DemandLoading/TileCacheFile.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+namespace demandLoading {
+
+MappedTileImageReader::MappedTileImageReader( const std::string& filename )
+    : m_filename( filename )
+{
+}
+
+MappedTileImageReader::~MappedTileImageReader()
+{
+    unmapFile();
+}
+
+bool MappedTileImageReader::open( TextureInfo* info )
+{
+    if( !m_isOpen )
+    {
+        if( !mapFile() )
+            return false;
+        if( !validate() )
+        {
+            unmapFile();
+            return false;
+        }
+        m_isOpen = true;
+    }
+    if( info != nullptr )
+        *info = m_info;
+    return true;
+}
+
+void MappedTileImageReader::close()
+{
+    unmapFile();
+    m_isOpen  = false;
+    m_entries = nullptr;
+    m_levelFirstTiles.clear();
+    std::vector<char>().swap( m_tileBuffer );
+    m_bufferedTile = ~0u;
+}
+
+// Check everything readTile() relies on, so that a truncated or foreign file fails here rather
+// than reading outside the mapping.
+bool MappedTileImageReader::validate()
+{
+    TileCacheHeader header;
+    if( m_size < sizeof( header ) )
+        return false;
+    std::memcpy( &header, m_data, sizeof( header ) );
+    if( std::memcmp( header.magic, TILE_CACHE_MAGIC, sizeof( header.magic ) ) != 0 || header.version != TILE_CACHE_VERSION
+        || header.headerSize != sizeof( header ) || header.fileSize != m_size )
+        return false;
+    if( header.width == 0 || header.height == 0 || header.numMipLevels == 0 || header.numMipLevels > 32 )
+        return false;
+
+    const CUarray_format format = static_cast<CUarray_format>( header.format );
+    try
+    {
+        m_pixelSize = header.numChannels * getBytesPerChannel( format );
+    }
+    catch( const Exception& )
+    {
+        return false;
+    }
+    if( !getTileCacheTileDims( m_pixelSize, &m_tileWidth, &m_tileHeight ) || m_tileWidth != header.tileWidth
+        || m_tileHeight != header.tileHeight )
+        return false;
+
+    m_levelFirstTiles.resize( header.numMipLevels );
+    uint64_t numTiles = 0;
+    for( unsigned int level = 0; level < header.numMipLevels; ++level )
+    {
+        m_levelFirstTiles[level] = static_cast<unsigned int>( numTiles );
+        numTiles += static_cast<uint64_t>( idivCeil( std::max( 1u, header.width >> level ), m_tileWidth ) )
+                    * idivCeil( std::max( 1u, header.height >> level ), m_tileHeight );
+    }
+    if( numTiles != header.numTiles || header.tableOffset % alignof( TileCacheEntry ) != 0 || header.tableOffset > m_size
+        || ( m_size - header.tableOffset ) / sizeof( TileCacheEntry ) < numTiles )
+        return false;
+
+    m_entries = reinterpret_cast<const TileCacheEntry*>( m_data + header.tableOffset );
+    for( unsigned int i = 0; i < header.numTiles; ++i )
+    {
+        const TileCacheEntry& entry = m_entries[i];
+        if( entry.offset > m_size || entry.storedSize > m_size - entry.offset )
+            return false;
+        if( !( entry.compression == TILE_CACHE_RAW && entry.storedSize == TILE_CACHE_TILE_SIZE ) && entry.compression != TILE_CACHE_DEFLATE )
+            return false;
+    }
+
+    m_info = TextureInfo{header.width, header.height, format, header.numChannels, header.numMipLevels};
+    return true;
+}
+
+bool MappedTileImageReader::readTile( char* dest, unsigned int mipLevel, unsigned int tileX, unsigned int tileY, unsigned int tileWidth, unsigned int tileHeight )
+{
+    if( !m_isOpen || mipLevel >= m_info.numMipLevels )
+        return false;
+
+    const unsigned int levelWidth  = std::max( 1u, m_info.width >> mipLevel );
+    const unsigned int levelHeight = std::max( 1u, m_info.height >> mipLevel );
+
+    // The tiles of the sparse texture are the stored tiles, padding included.
+    if( tileWidth == m_tileWidth && tileHeight == m_tileHeight )
+    {
+        const unsigned int levelTilesX = idivCeil( levelWidth, m_tileWidth );
+        if( tileX >= levelTilesX || tileY >= idivCeil( levelHeight, m_tileHeight ) )
+            return false;
+        return readStoredTile( m_levelFirstTiles[mipLevel] + tileY * levelTilesX + tileX, dest );
+    }
+
+    const unsigned int startX = tileX * tileWidth;
+    const unsigned int startY = tileY * tileHeight;
+    if( startX >= levelWidth || startY >= levelHeight )
+        return false;
+
+    // Copy the part of the tile inside the level, the rest stays black.
+    const unsigned int copyWidth  = std::min( tileWidth, levelWidth - startX );
+    const unsigned int copyHeight = std::min( tileHeight, levelHeight - startY );
+    if( copyWidth < tileWidth || copyHeight < tileHeight )
+        std::memset( dest, 0, static_cast<size_t>( tileWidth ) * tileHeight * m_pixelSize );
+    return copyRect( dest, static_cast<size_t>( tileWidth ) * m_pixelSize, mipLevel, startX, startY, copyWidth, copyHeight );
+}
+
+bool MappedTileImageReader::readMipLevel( char* dest, unsigned int mipLevel, unsigned int expectedWidth, unsigned int expectedHeight )
+{
+    if( !m_isOpen || mipLevel >= m_info.numMipLevels )
+        return false;
+    if( expectedWidth != std::max( 1u, m_info.width >> mipLevel ) || expectedHeight != std::max( 1u, m_info.height >> mipLevel ) )
+        return false;
+
+    return copyRect( dest, static_cast<size_t>( expectedWidth ) * m_pixelSize, mipLevel, 0, 0, expectedWidth, expectedHeight );
+}
+
+bool MappedTileImageReader::readStoredTile( unsigned int tileIndex, char* dest ) const
+{
+    const TileCacheEntry& entry = m_entries[tileIndex];
+    if( entry.compression == TILE_CACHE_RAW )
+    {
+        std::memcpy( dest, m_data + entry.offset, TILE_CACHE_TILE_SIZE );
+        return true;
+    }
+    return inflateTile( m_data + entry.offset, entry.storedSize, dest, TILE_CACHE_TILE_SIZE );
+}
+
+const char* MappedTileImageReader::getStoredTile( unsigned int tileIndex )
+{
+    const TileCacheEntry& entry = m_entries[tileIndex];
+    if( entry.compression == TILE_CACHE_RAW )
+        return m_data + entry.offset;
+
+    if( m_bufferedTile != tileIndex )
+    {
+        m_tileBuffer.resize( TILE_CACHE_TILE_SIZE );
+        m_bufferedTile = ~0u;
+        if( !readStoredTile( tileIndex, m_tileBuffer.data() ) )
+            return nullptr;
+        m_bufferedTile = tileIndex;
+    }
+    return m_tileBuffer.data();
+}
+
+bool MappedTileImageReader::copyRect( char* dest, size_t destPitch, unsigned int mipLevel, unsigned int x, unsigned int y, unsigned int width, unsigned int height )
+{
+    const unsigned int levelTilesX = idivCeil( std::max( 1u, m_info.width >> mipLevel ), m_tileWidth );
+    for( unsigned int tileY = y / m_tileHeight; tileY <= ( y + height - 1 ) / m_tileHeight; ++tileY )
+    {
+        for( unsigned int tileX = x / m_tileWidth; tileX <= ( x + width - 1 ) / m_tileWidth; ++tileX )
+        {
+            const char* tile = getStoredTile( m_levelFirstTiles[mipLevel] + tileY * levelTilesX + tileX );
+            if( !tile )
+                return false;
+
+            // Copy the overlap of the tile and the rectangle.
+            const unsigned int x0 = std::max( x, tileX * m_tileWidth );
+            const unsigned int x1 = std::min( x + width, ( tileX + 1 ) * m_tileWidth );
+            const unsigned int y0 = std::max( y, tileY * m_tileHeight );
+            const unsigned int y1 = std::min( y + height, ( tileY + 1 ) * m_tileHeight );
+            for( unsigned int py = y0; py < y1; ++py )
+            {
+                const size_t srcOffset = ( static_cast<size_t>( py - tileY * m_tileHeight ) * m_tileWidth + ( x0 - tileX * m_tileWidth ) ) * m_pixelSize;
+                std::memcpy( dest + ( py - y ) * destPitch + static_cast<size_t>( x0 - x ) * m_pixelSize, tile + srcOffset, ( x1 - x0 ) * m_pixelSize );
+            }
+        }
+    }
+    return true;
+}
+
+#ifdef _WIN32
+
+bool MappedTileImageReader::mapFile()
+{
+    HANDLE file = CreateFileA( m_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr );
+    if( file == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx( file, &size ) || size.QuadPart == 0 )
+    {
+        CloseHandle( file );
+        return false;
+    }
+    m_file    = file;
+    m_size    = static_cast<size_t>( size.QuadPart );
+    m_mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    if( m_mapping )
+        m_data = static_cast<const char*>( MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, 0 ) );
+    if( !m_data )
+    {
+        unmapFile();
+        return false;
+    }
+    return true;
+}
+
+void MappedTileImageReader::unmapFile()
+{
+    if( m_data )
+        UnmapViewOfFile( m_data );
+    if( m_mapping )
+        CloseHandle( m_mapping );
+    if( m_file )
+        CloseHandle( m_file );
+    m_data    = nullptr;
+    m_mapping = nullptr;
+    m_file    = nullptr;
+    m_size    = 0;
+}
+
+#else
+
+bool MappedTileImageReader::mapFile()
+{
+    const int fd = ::open( m_filename.c_str(), O_RDONLY );
+    if( fd < 0 )
+        return false;
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || st.st_size == 0 )
+    {
+        ::close( fd );
+        return false;
+    }
+    void* data = mmap( nullptr, static_cast<size_t>( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );  // the mapping keeps the file referenced
+    if( data == MAP_FAILED )
+        return false;
+
+    // Tiles are read in the order the renderer requests them.
+    madvise( data, static_cast<size_t>( st.st_size ), MADV_RANDOM );
+    m_data = static_cast<const char*>( data );
+    m_size = static_cast<size_t>( st.st_size );
+    return true;
+}
+
+void MappedTileImageReader::unmapFile()
+{
+    if( m_data )
+        munmap( const_cast<char*>( m_data ), m_size );
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
+
+}  // namespace demandLoading
@@ -0,0 +1,75 @@
+#include "ResidentTiles.h"
+
+#include "TilePool.h"
+
+#include <optixPaging/optixPaging.h>
+
+#include <algorithm>
+
+namespace demandLoading {
+
+void ResidentTiles::insert( unsigned int pageId, const Tile& tile )
+{
+    m_tiles[pageId] = Entry{tile, m_launchNum, -1};
+}
+
+void ResidentTiles::updateEvictionCandidates( const std::vector<PageMapping>& stalePages, bool truncated )
+{
+    const int launchNum = ++m_launchNum;
+
+    m_evictionCandidates.clear();
+    for( const PageMapping& stalePage : stalePages )
+    {
+        auto it = m_tiles.find( stalePage.id );
+        if( it == m_tiles.end() )
+            continue;
+        it->second.staleLaunch = launchNum;
+        m_evictionCandidates.push_back( stalePage.id );
+    }
+
+    if( !truncated )
+    {
+        for( auto& entry : m_tiles )
+        {
+            if( entry.second.staleLaunch != launchNum )
+                entry.second.lastUsed = launchNum;
+        }
+    }
+
+    // Order the candidates so that the least recently used tile is at the back.
+    const auto& tiles = m_tiles;
+    std::sort( m_evictionCandidates.begin(), m_evictionCandidates.end(), [&tiles]( unsigned int a, unsigned int b ) {
+        const int lastUsedA = tiles.at( a ).lastUsed;
+        const int lastUsedB = tiles.at( b ).lastUsed;
+        return lastUsedA != lastUsedB ? lastUsedA > lastUsedB : a > b;
+    } );
+}
+
+// A mip tail needs consecutive free tiles, which evicting single tiles may not produce.
+bool ResidentTiles::makeRoom( TilePool&                                 pool,
+                              size_t                                    numBytes,
+                              unsigned int                              maxInvalidatedPages,
+                              std::vector<unsigned int>&                invalidatedPages,
+                              const std::function<void( const Tile& )>& unmap )
+{
+    while( !pool.canAllocate( numBytes ) )
+    {
+        if( m_evictionCandidates.empty() || invalidatedPages.size() >= maxInvalidatedPages )
+            return false;
+
+        const unsigned int pageId = m_evictionCandidates.back();
+        m_evictionCandidates.pop_back();
+        auto it = m_tiles.find( pageId );
+        if( it == m_tiles.end() )
+            continue;
+
+        const Tile& tile = it->second.tile;
+        unmap( tile );
+        pool.free( tile.handle, tile.offset, TilePool::TILE_SIZE );
+        invalidatedPages.push_back( pageId );
+        m_tiles.erase( it );
+    }
+    return true;
+}
+
+}  // namespace demandLoading
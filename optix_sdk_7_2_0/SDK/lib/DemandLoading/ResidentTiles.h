@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cuda.h>
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+struct PageMapping;
+
+namespace demandLoading {
+
+class TilePool;
+
+/// The tiles filled on one device, by page id, and the order in which the stale ones are evicted.
+/// Only tiles are tracked; mip tails and texture start pages stay resident.  Each device of a
+/// DemandTextureManager has its own, since a tile can be resident on one device and evicted from
+/// another.
+class ResidentTiles
+{
+  public:
+    struct Tile
+    {
+        CUmemGenericAllocationHandle handle;
+        size_t                       offset;
+        unsigned int                 textureId;
+        unsigned int                 mipLevel;
+        unsigned int                 tileX;
+        unsigned int                 tileY;
+    };
+
+    /// Record a tile filled after the last pull, which counts as used by that pull.
+    void insert( unsigned int pageId, const Tile& tile );
+
+    /// Check whether the page is a tile resident on the device.
+    bool contains( unsigned int pageId ) const { return m_tiles.find( pageId ) != m_tiles.end(); }
+
+    /// Get the number of resident tiles.
+    size_t size() const { return m_tiles.size(); }
+
+    /// Record the stale pages of a pull, the resident pages the device did not reference since the
+    /// last push, and rank the tiles among them for eviction.  A resident tile that is missing from
+    /// the list was referenced, unless the list was truncated, in which case nothing is known about
+    /// the missing tiles and they keep their age.
+    void updateEvictionCandidates( const std::vector<PageMapping>& stalePages, bool truncated );
+
+    /// Get the tiles that were stale at the last pull, least recently used last.
+    const std::vector<unsigned int>& getEvictionCandidates() const { return m_evictionCandidates; }
+
+    /// Evict candidates, least recently used first, until an allocation of numBytes fits in the
+    /// pool, or return false once invalidatedPages holds maxInvalidatedPages pages or no candidate
+    /// is left.  Each evicted tile is unmapped by the given function, returned to the pool, and its
+    /// page appended to invalidatedPages, which clears its residence bit with the next push.
+    bool makeRoom( TilePool&                               pool,
+                   size_t                                  numBytes,
+                   unsigned int                            maxInvalidatedPages,
+                   std::vector<unsigned int>&              invalidatedPages,
+                   const std::function<void( const Tile& )>& unmap );
+
+  private:
+    struct Entry
+    {
+        Tile tile;
+        int  lastUsed;     // launch number of the last pull that found the tile referenced
+        int  staleLaunch;  // launch number of the last pull that found the tile stale
+    };
+
+    std::unordered_map<unsigned int, Entry> m_tiles;
+    std::vector<unsigned int>               m_evictionCandidates;
+    int                                     m_launchNum = 0;
+};
+
+}  // namespace demandLoading
@@ -77,6 +77,7 @@ void SparseTexture::init( const TextureDescriptor& descriptor, const TextureInfo
     td.mipmapFilterMode    = descriptor.mipmapFilterMode;
     td.maxMipmapLevelClamp = float( info.numMipLevels - 1 );
     td.minMipmapLevelClamp = 0.f;
+    td.flags               = descriptor.flags;
 
     // Create texture object.
     CUDA_RESOURCE_DESC rd{};
@@ -181,6 +182,37 @@ void SparseTexture::fillTile( unsigned int                 mipLevel,
     DEMAND_CUDA_CHECK( cuMemcpy2D( &copyArgs ) );
 }
 
+void SparseTexture::unmapTile( unsigned int mipLevel, unsigned int tileX, unsigned int tileY ) const
+{
+    // Make device current.
+    DEMAND_ASSERT( m_isInitialized );
+    DEMAND_CUDA_CHECK( cudaSetDevice( m_deviceIndex ) );
+
+    CUarrayMapInfo mapInfo{};
+    mapInfo.resourceType    = CU_RESOURCE_TYPE_MIPMAPPED_ARRAY;
+    mapInfo.resource.mipmap = m_array;
+
+    mapInfo.subresourceType               = CU_ARRAY_SPARSE_SUBRESOURCE_TYPE_SPARSE_LEVEL;
+    mapInfo.subresource.sparseLevel.level = mipLevel;
+
+    mapInfo.subresource.sparseLevel.offsetX = tileX * getTileWidth();
+    mapInfo.subresource.sparseLevel.offsetY = tileY * getTileHeight();
+
+    uint2 tileDims                               = getTileDimensions( mipLevel, tileX, tileY );
+    mapInfo.subresource.sparseLevel.extentWidth  = tileDims.x;
+    mapInfo.subresource.sparseLevel.extentHeight = tileDims.y;
+    mapInfo.subresource.sparseLevel.extentDepth  = 1;
+
+    mapInfo.memOperationType = CU_MEM_OPERATION_TYPE_UNMAP;
+    mapInfo.memHandleType    = CU_MEM_HANDLE_TYPE_GENERIC;
+    mapInfo.deviceBitMask    = 1U << m_deviceIndex;
+
+    // Synchronize so that the storage is no longer referenced when it is handed out again.
+    const CUstream stream{};
+    DEMAND_CUDA_CHECK( cuMemMapArrayAsync( &mapInfo, 1, stream ) );
+    DEMAND_CUDA_CHECK( cuStreamSynchronize( stream ) );
+}
+
 void SparseTexture::fillMipTail( const char* mipTailData, size_t mipTailSize, CUmemGenericAllocationHandle tileHandle, size_t tileOffset ) const
 {
     // Make device current.
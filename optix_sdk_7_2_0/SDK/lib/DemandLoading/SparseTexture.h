@@ -91,6 +91,9 @@ class SparseTexture
                    CUmemGenericAllocationHandle tileHandle,
                    size_t                       tileOffset ) const;
 
+    /// Unmap the backing storage of the specified tile.  The storage can be reused once this returns.
+    void unmapTile( unsigned int mipLevel, unsigned int tileX, unsigned int tileY ) const;
+
     /// Map the given backing storage for mip tail into the sparse texture and fill it with the
     /// given data.
     void fillMipTail( const char* tileData, size_t tileSize, CUmemGenericAllocationHandle tileHandle, size_t tileOffset ) const;
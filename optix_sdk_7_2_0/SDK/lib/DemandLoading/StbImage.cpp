@@ -0,0 +1,49 @@
+#include "StbImage.h"
+
+// Being static, every stb function the library does not call would warn as unused.
+#if defined( __GNUC__ )
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include <tinygltf/stb_image.h>
+
+#define STB_IMAGE_WRITE_STATIC
+#define STBI_WRITE_NO_STDIO
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <tinygltf/stb_image_write.h>
+
+#if defined( __GNUC__ )
+#pragma GCC diagnostic pop
+#endif
+
+namespace demandLoading {
+
+unsigned char* stbLoadRgba8( const char* filename, int* width, int* height, int* channels )
+{
+    return stbi_load( filename, width, height, channels, STBI_rgb_alpha );
+}
+
+unsigned char* stbZlibCompress( const unsigned char* data, int size, int* compressedSize, int level )
+{
+    return stbi_zlib_compress( const_cast<unsigned char*>( data ), size, compressedSize, level );
+}
+
+int stbZlibDecode( char* dest, int destSize, const char* data, int size )
+{
+    return stbi_zlib_decode_buffer( dest, destSize, data, size );
+}
+
+void stbFree( void* pixels )
+{
+    stbi_image_free( pixels );
+}
+
+void stbFreeCompressed( void* data )
+{
+    STBIW_FREE( data );
+}
+
+}  // namespace demandLoading
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+namespace demandLoading {
+
+/// The parts of stb_image and stb_image_write the library uses.  Both are compiled once, in
+/// StbImage.cpp, with static linkage so that they do not clash with the copy of stb_image in sutil.
+
+/// Load an image as 8-bit RGBA.  Returns null on failure; the pixels are released with stbFree().
+unsigned char* stbLoadRgba8( const char* filename, int* width, int* height, int* channels );
+void           stbFree( void* pixels );
+
+/// Compress data into a zlib stream at level 1 (fastest) to 9 (smallest).  Returns null on failure;
+/// the stream is released with stbFreeCompressed().
+unsigned char* stbZlibCompress( const unsigned char* data, int size, int* compressedSize, int level );
+void           stbFreeCompressed( void* data );
+
+/// Decompress a zlib stream into dest.  Returns the number of bytes written, or -1 on failure.
+int stbZlibDecode( char* dest, int destSize, const char* data, int size );
+
+}  // namespace demandLoading
@@ -0,0 +1,156 @@
+#include <DemandLoading/StbImageReader.h>
+
+#include "StbImage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace demandLoading {
+
+namespace {
+
+const unsigned int PIXEL_SIZE = 4;  // RGBA8
+
+float srgbToLinear( float c )
+{
+    return c <= 0.04045f ? c * ( 1.0f / 12.92f ) : std::pow( ( c + 0.055f ) * ( 1.0f / 1.055f ), 2.4f );
+}
+
+float linearToSrgb( float c )
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow( c, 1.0f / 2.4f ) - 0.055f;
+}
+
+unsigned char toByte( float c )
+{
+    return static_cast<unsigned char>( std::min( std::max( c, 0.0f ), 1.0f ) * 255.0f + 0.5f );
+}
+
+// Average 2x2 blocks of src into dst, clamping the blocks at the edges of odd sized levels
+void downsample( const unsigned char* src, unsigned int srcWidth, unsigned int srcHeight, unsigned char* dst, unsigned int dstWidth, unsigned int dstHeight, const float* decode, bool srgb )
+{
+    for( unsigned int y = 0; y < dstHeight; ++y )
+    {
+        const unsigned int y0 = std::min( 2 * y, srcHeight - 1 );
+        const unsigned int y1 = std::min( 2 * y + 1, srcHeight - 1 );
+        for( unsigned int x = 0; x < dstWidth; ++x )
+        {
+            const unsigned int x0        = std::min( 2 * x, srcWidth - 1 );
+            const unsigned int x1        = std::min( 2 * x + 1, srcWidth - 1 );
+            const unsigned char* taps[4] = {src + ( y0 * srcWidth + x0 ) * PIXEL_SIZE, src + ( y0 * srcWidth + x1 ) * PIXEL_SIZE,
+                                            src + ( y1 * srcWidth + x0 ) * PIXEL_SIZE, src + ( y1 * srcWidth + x1 ) * PIXEL_SIZE};
+            unsigned char* out = dst + ( y * dstWidth + x ) * PIXEL_SIZE;
+            for( unsigned int c = 0; c < PIXEL_SIZE; ++c )
+            {
+                // Alpha is always linear.
+                const bool linear = !srgb || c == 3;
+                float      sum    = 0.0f;
+                for( const unsigned char* tap : taps )
+                    sum += linear ? tap[c] * ( 1.0f / 255.0f ) : decode[tap[c]];
+                sum *= 0.25f;
+                out[c] = toByte( linear ? sum : linearToSrgb( sum ) );
+            }
+        }
+    }
+}
+
+}  // namespace
+
+StbImageReader::StbImageReader( const std::string& filename, bool srgb )
+    : m_filename( filename )
+    , m_srgb( srgb )
+{
+}
+
+bool StbImageReader::open( TextureInfo* info )
+{
+    if( !m_isOpen )
+    {
+        int            width    = 0;
+        int            height   = 0;
+        int            channels = 0;
+        unsigned char* data     = stbLoadRgba8( m_filename.c_str(), &width, &height, &channels );
+        if( !data )
+            return false;
+
+        // The level dimensions halve down to 1x1 like those of the CUDA mipmapped array.
+        const unsigned int dim = static_cast<unsigned int>( std::max( width, height ) );
+        unsigned int       numMipLevels = 1;
+        while( ( dim >> numMipLevels ) > 0 )
+            ++numMipLevels;
+        m_info = TextureInfo{static_cast<unsigned int>( width ), static_cast<unsigned int>( height ), CU_AD_FORMAT_UNSIGNED_INT8, PIXEL_SIZE, numMipLevels};
+
+        m_levelOffsets.resize( numMipLevels );
+        size_t size = 0;
+        for( unsigned int level = 0; level < numMipLevels; ++level )
+        {
+            m_levelOffsets[level] = size;
+            size += static_cast<size_t>( std::max( 1u, m_info.width >> level ) ) * std::max( 1u, m_info.height >> level ) * PIXEL_SIZE;
+        }
+        m_pixels.resize( size );
+        std::memcpy( m_pixels.data(), data, static_cast<size_t>( width ) * height * PIXEL_SIZE );
+        stbFree( data );
+
+        float decode[256];
+        for( int i = 0; i < 256; ++i )
+            decode[i] = srgbToLinear( i * ( 1.0f / 255.0f ) );
+        for( unsigned int level = 1; level < numMipLevels; ++level )
+        {
+            downsample( &m_pixels[m_levelOffsets[level - 1]], std::max( 1u, m_info.width >> ( level - 1 ) ),
+                        std::max( 1u, m_info.height >> ( level - 1 ) ), &m_pixels[m_levelOffsets[level]],
+                        std::max( 1u, m_info.width >> level ), std::max( 1u, m_info.height >> level ), decode, m_srgb );
+        }
+        m_isOpen = true;
+    }
+    if( info != nullptr )
+        *info = m_info;
+    return true;
+}
+
+void StbImageReader::close()
+{
+    m_isOpen = false;
+    std::vector<unsigned char>().swap( m_pixels );
+    m_levelOffsets.clear();
+}
+
+bool StbImageReader::readTile( char* dest, unsigned int mipLevel, unsigned int tileX, unsigned int tileY, unsigned int tileWidth, unsigned int tileHeight )
+{
+    if( !m_isOpen || mipLevel >= m_info.numMipLevels )
+        return false;
+
+    const unsigned int levelWidth  = std::max( 1u, m_info.width >> mipLevel );
+    const unsigned int levelHeight = std::max( 1u, m_info.height >> mipLevel );
+    const unsigned int startX      = tileX * tileWidth;
+    const unsigned int startY      = tileY * tileHeight;
+    if( startX >= levelWidth || startY >= levelHeight )
+        return false;
+
+    // Copy the part of the tile inside the level, the rest stays black.
+    const unsigned int copyWidth  = std::min( tileWidth, levelWidth - startX );
+    const unsigned int copyHeight = std::min( tileHeight, levelHeight - startY );
+    if( copyWidth < tileWidth || copyHeight < tileHeight )
+        std::memset( dest, 0, static_cast<size_t>( tileWidth ) * tileHeight * PIXEL_SIZE );
+
+    const unsigned char* level = &m_pixels[m_levelOffsets[mipLevel]];
+    for( unsigned int y = 0; y < copyHeight; ++y )
+    {
+        std::memcpy( dest + static_cast<size_t>( y ) * tileWidth * PIXEL_SIZE,
+                     level + ( static_cast<size_t>( startY + y ) * levelWidth + startX ) * PIXEL_SIZE, copyWidth * PIXEL_SIZE );
+    }
+    return true;
+}
+
+bool StbImageReader::readMipLevel( char* dest, unsigned int mipLevel, unsigned int expectedWidth, unsigned int expectedHeight )
+{
+    if( !m_isOpen || mipLevel >= m_info.numMipLevels )
+        return false;
+    if( expectedWidth != std::max( 1u, m_info.width >> mipLevel ) || expectedHeight != std::max( 1u, m_info.height >> mipLevel ) )
+        return false;
+
+    std::memcpy( dest, &m_pixels[m_levelOffsets[mipLevel]], static_cast<size_t>( expectedWidth ) * expectedHeight * PIXEL_SIZE );
+    return true;
+}
+
+}  // namespace demandLoading
@@ -0,0 +1,92 @@
+#include "TileCache.h"
+
+namespace demandLoading {
+
+TileCache::Data TileCache::find( unsigned int pageId )
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    auto                         it = m_index.find( pageId );
+    if( it == m_index.end() )
+    {
+        ++m_numMisses;
+        return Data();
+    }
+
+    // Move the entry to the front of the LRU list.
+    m_entries.splice( m_entries.begin(), m_entries, it->second );
+    Entry& entry = *it->second;
+    ++m_numHits;
+    if( entry.prefetched )
+    {
+        ++m_numPrefetchHits;
+        entry.prefetched = false;
+    }
+    return entry.data;
+}
+
+bool TileCache::contains( unsigned int pageId ) const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return m_index.find( pageId ) != m_index.end();
+}
+
+void TileCache::insert( unsigned int pageId, Data data, bool prefetched )
+{
+    if( !data || data->size() > m_maxBytes )
+        return;
+
+    std::unique_lock<std::mutex> lock( m_mutex );
+    auto                         it = m_index.find( pageId );
+    if( it != m_index.end() )
+    {
+        m_bytes -= it->second->data->size();
+        m_entries.erase( it->second );
+        m_index.erase( it );
+    }
+
+    // Evict least recently used entries until the new data fits.
+    while( !m_entries.empty() && m_bytes + data->size() > m_maxBytes )
+    {
+        const Entry& victim = m_entries.back();
+        m_bytes -= victim.data->size();
+        m_index.erase( victim.pageId );
+        m_entries.pop_back();
+        ++m_numEvictions;
+    }
+
+    m_bytes += data->size();
+    m_entries.push_front( Entry{pageId, std::move( data ), prefetched} );
+    m_index[pageId] = m_entries.begin();
+}
+
+size_t TileCache::getBytes() const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return m_bytes;
+}
+
+unsigned int TileCache::getNumHits() const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return m_numHits;
+}
+
+unsigned int TileCache::getNumMisses() const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return m_numMisses;
+}
+
+unsigned int TileCache::getNumPrefetchHits() const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return m_numPrefetchHits;
+}
+
+unsigned int TileCache::getNumEvictions() const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return m_numEvictions;
+}
+
+}  // namespace demandLoading
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace demandLoading {
+
+/// Host-side least recently used cache of tile and mip tail data, keyed by page id.  Page ids are
+/// unique across all textures, so one cache is shared by every texture of a DemandTextureManager.
+/// The data is reference counted: an entry evicted while a caller still holds it stays valid for
+/// that caller.  All methods are thread safe.
+class TileCache
+{
+  public:
+    typedef std::shared_ptr<const std::vector<char>> Data;
+
+    /// Construct a cache holding at most maxBytes of data.  Zero disables the cache.
+    explicit TileCache( size_t maxBytes = 0 )
+        : m_maxBytes( maxBytes )
+    {
+    }
+
+    /// Find the data of the given page and mark it most recently used.  Returns null on a miss.
+    /// Misses and hits (including the first hit of a prefetched entry) are counted.
+    Data find( unsigned int pageId );
+
+    /// Check whether the given page is cached without touching the LRU order or the counters.
+    bool contains( unsigned int pageId ) const;
+
+    /// Insert or replace the data of the given page as the most recently used entry, evicting the
+    /// least recently used entries to stay within the byte limit.  Prefetched entries are counted
+    /// as prefetch hits when they are first found.
+    void insert( unsigned int pageId, Data data, bool prefetched = false );
+
+    /// Get the number of bytes currently cached.
+    size_t getBytes() const;
+
+    size_t       getMaxBytes() const { return m_maxBytes; }
+    unsigned int getNumHits() const;
+    unsigned int getNumMisses() const;
+    unsigned int getNumPrefetchHits() const;
+    unsigned int getNumEvictions() const;
+
+  private:
+    struct Entry
+    {
+        unsigned int pageId;
+        Data         data;
+        bool         prefetched;
+    };
+
+    size_t                                                      m_maxBytes;
+    size_t                                                      m_bytes = 0;
+    std::list<Entry>                                            m_entries;  // most recently used first
+    std::unordered_map<unsigned int, std::list<Entry>::iterator> m_index;
+    unsigned int                                                m_numHits         = 0;
+    unsigned int                                                m_numMisses       = 0;
+    unsigned int                                                m_numPrefetchHits = 0;
+    unsigned int                                                m_numEvictions    = 0;
+    mutable std::mutex                                          m_mutex;
+};
+
+}  // namespace demandLoading
@@ -0,0 +1,243 @@
+//
+// tileCacheBenchmark - measures converting images into tile cache files and reading tiles back
+// through MappedTileImageReader, against reading the same tiles from the source images.  No GPU
+// needed.
+//
+// The images are the files given on the command line, read with StbImageReader, or a synthetic
+// RGBA8 image (smooth color gradients with a little noise, compressing roughly like a photo).
+// For each image the benchmark writes an uncompressed and a deflated cache file and reports:
+//   convert  time and throughput of writeTileCache, in tile bytes per second, and the file size
+//   first    time from constructing a reader to having the first tile of level 0
+//   tiles    throughput of reading every tile of every level in random order
+//
+
+#include <DemandLoading/ImageReader.h>
+#include <DemandLoading/MappedTileImageReader.h>
+#include <DemandLoading/StbImageReader.h>
+#include <DemandLoading/TextureInfo.h>
+#include <DemandLoading/TileCacheFile.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace demandLoading;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+/// RGBA8 gradients plus hash noise, generated per level so that every level is as costly to read.
+class SyntheticImage : public ImageReader
+{
+  public:
+    explicit SyntheticImage( unsigned int size )
+        : m_size( size )
+    {
+    }
+
+    bool open( TextureInfo* info ) override
+    {
+        unsigned int numMipLevels = 1;
+        while( ( m_size >> numMipLevels ) > 0 )
+            ++numMipLevels;
+        m_info = TextureInfo{m_size, m_size, CU_AD_FORMAT_UNSIGNED_INT8, 4, numMipLevels};
+        if( info )
+            *info = m_info;
+        return true;
+    }
+
+    void close() override {}
+
+    const TextureInfo& getInfo() override { return m_info; }
+
+    bool readTile( char* dest, unsigned int mipLevel, unsigned int tileX, unsigned int tileY, unsigned int tileWidth, unsigned int tileHeight ) override
+    {
+        const unsigned int levelSize = std::max( 1u, m_size >> mipLevel );
+        for( unsigned int y = 0; y < tileHeight; ++y )
+            for( unsigned int x = 0; x < tileWidth; ++x )
+                pixel( dest + ( static_cast<size_t>( y ) * tileWidth + x ) * 4, tileX * tileWidth + x, tileY * tileHeight + y, levelSize );
+        return true;
+    }
+
+    bool readMipLevel( char* dest, unsigned int mipLevel, unsigned int width, unsigned int height ) override
+    {
+        return readTile( dest, mipLevel, 0, 0, width, height );
+    }
+
+  private:
+    void pixel( char* dest, unsigned int x, unsigned int y, unsigned int levelSize ) const
+    {
+        if( x >= levelSize || y >= levelSize )
+        {
+            dest[0] = dest[1] = dest[2] = dest[3] = 0;
+            return;
+        }
+        const float        u     = static_cast<float>( x ) / levelSize;
+        const float        v     = static_cast<float>( y ) / levelSize;
+        const unsigned int hash  = ( x * 73856093u ) ^ ( y * 19349663u ) ^ ( levelSize * 83492791u );
+        const int          noise = static_cast<int>( ( hash * 2654435761u ) >> 29 ) - 4;
+        const float        base[3] = {0.5f + 0.5f * std::sin( 6.0f * u ), 0.5f + 0.5f * std::cos( 5.0f * v ), 0.5f + 0.5f * std::sin( 4.0f * ( u + v ) )};
+        for( int c = 0; c < 3; ++c )
+            dest[c] = static_cast<char>( std::min( std::max( static_cast<int>( base[c] * 255.0f ) + noise, 0 ), 255 ) );
+        dest[3] = static_cast<char>( 255 );
+    }
+
+    unsigned int m_size;
+    TextureInfo  m_info{};
+};
+
+struct TileCoord
+{
+    unsigned int level;
+    unsigned int x;
+    unsigned int y;
+};
+
+typedef std::function<std::unique_ptr<ImageReader>()> ReaderFactory;
+
+double secondsSince( Clock::time_point start )
+{
+    return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+void printUsageAndExit( const char* argv0 )
+{
+    std::cerr << "Usage  : " << argv0 << " [options] [<image>...]\n";
+    std::cerr << "Options: --size <n>                 Synthetic image width and height when no image is given (default 4096)\n";
+    std::cerr << "         --dir <path>               Directory for the cache files (default .)\n";
+    exit( 1 );
+}
+
+// Time from constructing the reader to the first tile, then every tile in the given order.
+void benchmarkReader( const std::string& name, const ReaderFactory& makeReader, const std::vector<TileCoord>& tiles, unsigned int tileWidth, unsigned int tileHeight, unsigned int pixelSize )
+{
+    std::vector<char> tile( static_cast<size_t>( tileWidth ) * tileHeight * pixelSize );
+
+    const Clock::time_point      start  = Clock::now();
+    std::unique_ptr<ImageReader> reader = makeReader();
+    TextureInfo                  info;
+    bool                         ok = reader->open( &info ) && reader->readTile( tile.data(), 0, 0, 0, tileWidth, tileHeight );
+    const double                 first = secondsSince( start );
+
+    const Clock::time_point readStart = Clock::now();
+    for( const TileCoord& coord : tiles )
+        ok = reader->readTile( tile.data(), coord.level, coord.x, coord.y, tileWidth, tileHeight ) && ok;
+    const double seconds = secondsSince( readStart );
+
+    const double megabytes = tiles.size() * tile.size() / ( 1024.0 * 1024.0 );
+    std::cout << "  " << std::left << std::setw( 16 ) << name << std::right << std::fixed << std::setprecision( 2 ) << "first "
+              << std::setw( 9 ) << first * 1000.0 << " ms   tiles " << std::setw( 8 ) << seconds * 1000.0 << " ms "
+              << std::setw( 9 ) << megabytes / seconds << " MB/s" << ( ok ? "" : "   (read failed)" ) << std::endl;
+}
+
+void benchmarkImage( const std::string& name, const ReaderFactory& makeSource, const std::string& cacheBase )
+{
+    std::unique_ptr<ImageReader> source = makeSource();
+    TextureInfo                  info;
+    if( !source->open( &info ) )
+    {
+        std::cerr << name << ": cannot read the image" << std::endl;
+        return;
+    }
+    const unsigned int pixelSize = info.numChannels * getBytesPerChannel( info.format );
+    unsigned int       tileWidth;
+    unsigned int       tileHeight;
+    if( !getTileCacheTileDims( pixelSize, &tileWidth, &tileHeight ) )
+    {
+        std::cerr << name << ": unsupported pixel size" << std::endl;
+        return;
+    }
+    std::cout << name << ": " << info.width << "x" << info.height << ", " << info.numMipLevels << " levels, "
+              << tileWidth << "x" << tileHeight << " tiles" << std::endl;
+
+    // Every tile of every level, in random order like the requests of a renderer.
+    std::vector<TileCoord> tiles;
+    for( unsigned int level = 0; level < info.numMipLevels; ++level )
+    {
+        const unsigned int levelWidth  = std::max( 1u, info.width >> level );
+        const unsigned int levelHeight = std::max( 1u, info.height >> level );
+        for( unsigned int y = 0; y * tileHeight < levelHeight; ++y )
+            for( unsigned int x = 0; x * tileWidth < levelWidth; ++x )
+                tiles.push_back( TileCoord{level, x, y} );
+    }
+    std::shuffle( tiles.begin(), tiles.end(), std::mt19937( 1 ) );
+
+    // The source reader has been opened above, so the conversion times do not include decoding.
+    std::vector<std::string> cacheFiles;
+    for( bool compress : {false, true} )
+    {
+        TileCacheWriteOptions options;
+        options.compress = compress;
+        const std::string       filename = cacheBase + ( compress ? ".deflate.tiles" : ".raw.tiles" );
+        TileCacheWriteStats     stats{};
+        std::string             error;
+        const Clock::time_point start = Clock::now();
+        if( !writeTileCache( *source, filename, options, &stats, &error ) )
+        {
+            std::cerr << name << ": " << error << std::endl;
+            return;
+        }
+        const double seconds = secondsSince( start );
+        std::cout << "  convert " << std::left << std::setw( 8 ) << ( compress ? "deflate" : "raw" ) << std::right << std::fixed
+                  << std::setprecision( 2 ) << std::setw( 9 ) << seconds * 1000.0 << " ms " << std::setw( 9 )
+                  << stats.rawBytes / ( 1024.0 * 1024.0 ) / seconds << " MB/s   " << std::setw( 8 )
+                  << stats.fileBytes / ( 1024.0 * 1024.0 ) << " MB (" << stats.numCompressedTiles << " of "
+                  << stats.numTiles << " tiles compressed)" << std::endl;
+        cacheFiles.push_back( filename );
+    }
+
+    benchmarkReader( "source", makeSource, tiles, tileWidth, tileHeight, pixelSize );
+    benchmarkReader( "mapped raw", [&cacheFiles]() { return std::unique_ptr<ImageReader>( new MappedTileImageReader( cacheFiles[0] ) ); },
+                     tiles, tileWidth, tileHeight, pixelSize );
+    benchmarkReader( "mapped deflate", [&cacheFiles]() { return std::unique_ptr<ImageReader>( new MappedTileImageReader( cacheFiles[1] ) ); },
+                     tiles, tileWidth, tileHeight, pixelSize );
+
+    for( const std::string& filename : cacheFiles )
+        std::remove( filename.c_str() );
+}
+
+}  // namespace
+
+int main( int argc, char* argv[] )
+{
+    std::vector<std::string> images;
+    unsigned int             size = 4096;
+    std::string              dir  = ".";
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+            printUsageAndExit( argv[0] );
+        else if( arg == "--size" && i + 1 < argc )
+            size = std::max( static_cast<unsigned int>( std::atoi( argv[++i] ) ), 1u );
+        else if( arg == "--dir" && i + 1 < argc )
+            dir = argv[++i];
+        else if( !arg.empty() && arg[0] != '-' )
+            images.push_back( arg );
+        else
+            printUsageAndExit( argv[0] );
+    }
+
+    if( images.empty() )
+    {
+        benchmarkImage( "synthetic", [size]() { return std::unique_ptr<ImageReader>( new SyntheticImage( size ) ); },
+                        dir + "/tileCacheBenchmark" );
+    }
+    for( size_t i = 0; i < images.size(); ++i )
+    {
+        const std::string image = images[i];
+        benchmarkImage( image, [image]() { return std::unique_ptr<ImageReader>( new StbImageReader( image ) ); },
+                        dir + "/tileCacheBenchmark" + std::to_string( i ) );
+    }
+    return 0;
+}
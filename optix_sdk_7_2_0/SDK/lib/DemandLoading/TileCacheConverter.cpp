@@ -0,0 +1,118 @@
+//
+// tileCacheConverter - converts images into tile cache files for MappedTileImageReader (see
+// TileCacheFile.h).  The images are decoded and their mip chains built once, here, instead of
+// every time a session opens them.
+//
+// PNG, JPEG, TGA, BMP and the other stb_image formats are read with StbImageReader; EXR files with
+// EXRReader if the library was built with OpenEXR.  Each image is written to <image>.tiles unless
+// --output is given.
+//
+
+#include <DemandLoading/ImageReader.h>
+#include <DemandLoading/StbImageReader.h>
+#include <DemandLoading/TileCacheFile.h>
+#ifdef OPTIX_SAMPLE_USE_OPEN_EXR
+#include <DemandLoading/EXRReader.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace demandLoading;
+
+namespace {
+
+void printUsageAndExit( const char* argv0 )
+{
+    std::cerr << "Usage  : " << argv0 << " [options] <image>...\n";
+    std::cerr << "Options: --output <file>            Output file, for a single image (default <image>.tiles)\n";
+    std::cerr << "         --linear                   Filter the mip levels of 8-bit images without sRGB decoding\n";
+    std::cerr << "         --no-compress              Store all tiles uncompressed\n";
+    std::cerr << "         --level <1-9>              Deflate level (default 5)\n";
+    exit( 1 );
+}
+
+bool hasExtension( const std::string& filename, const std::string& extension )
+{
+    if( filename.size() < extension.size() )
+        return false;
+    std::string tail = filename.substr( filename.size() - extension.size() );
+    std::transform( tail.begin(), tail.end(), tail.begin(), []( char c ) { return static_cast<char>( ::tolower( c ) ); } );
+    return tail == extension;
+}
+
+}  // namespace
+
+int main( int argc, char* argv[] )
+{
+    std::vector<std::string> images;
+    std::string              output;
+    bool                     srgb = true;
+    TileCacheWriteOptions    options;
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+            printUsageAndExit( argv[0] );
+        else if( arg == "--output" && i + 1 < argc )
+            output = argv[++i];
+        else if( arg == "--linear" )
+            srgb = false;
+        else if( arg == "--no-compress" )
+            options.compress = false;
+        else if( arg == "--level" && i + 1 < argc )
+            options.deflateLevel = std::min( std::max( std::atoi( argv[++i] ), 1 ), 9 );
+        else if( !arg.empty() && arg[0] != '-' )
+            images.push_back( arg );
+        else
+            printUsageAndExit( argv[0] );
+    }
+    if( images.empty() || ( !output.empty() && images.size() > 1 ) )
+        printUsageAndExit( argv[0] );
+
+    int status = 0;
+    for( const std::string& image : images )
+    {
+        std::unique_ptr<ImageReader> reader;
+        if( hasExtension( image, ".exr" ) )
+        {
+#ifdef OPTIX_SAMPLE_USE_OPEN_EXR
+            reader.reset( new EXRReader( image.c_str() ) );
+#else
+            std::cerr << image << ": EXR support requires OpenEXR" << std::endl;
+            status = 1;
+            continue;
+#endif
+        }
+        else
+        {
+            reader.reset( new StbImageReader( image, srgb ) );
+        }
+
+        const std::string   filename = output.empty() ? image + ".tiles" : output;
+        const auto          start    = std::chrono::steady_clock::now();
+        TileCacheWriteStats stats{};
+        std::string         error;
+        if( !writeTileCache( *reader, filename, options, &stats, &error ) )
+        {
+            std::cerr << image << ": " << error << std::endl;
+            status = 1;
+            continue;
+        }
+        const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+        const TextureInfo& info = reader->getInfo();
+        std::cout << std::fixed << std::setprecision( 2 ) << filename << ": " << info.width << "x" << info.height << ", "
+                  << info.numMipLevels << " levels, " << stats.numTiles << " tiles (" << stats.numCompressedTiles
+                  << " compressed), " << stats.fileBytes / ( 1024.0 * 1024.0 ) << " MB of "
+                  << stats.rawBytes / ( 1024.0 * 1024.0 ) << " MB, " << seconds << " s" << std::endl;
+    }
+    return status;
+}
@@ -0,0 +1,155 @@
+#include <DemandLoading/TileCacheFile.h>
+
+#include "Math.h"
+#include "TileCompression.h"
+#include <DemandLoading/ImageReader.h>
+#include <DemandLoading/TextureInfo.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace demandLoading {
+
+namespace {
+
+const uint64_t RAW_TILE_ALIGNMENT        = 4096;
+const uint64_t COMPRESSED_TILE_ALIGNMENT = 16;
+
+bool fail( std::string* error, const std::string& message )
+{
+    if( error )
+        *error = message;
+    return false;
+}
+
+}  // namespace
+
+bool getTileCacheTileDims( unsigned int pixelSize, unsigned int* tileWidth, unsigned int* tileHeight )
+{
+    if( pixelSize == 0 || pixelSize > 16 || ( pixelSize & ( pixelSize - 1 ) ) != 0 )
+        return false;
+
+    // The tile is square, or twice as wide as it is high.
+    unsigned int log2Pixels = 0;
+    while( ( 1u << log2Pixels ) * pixelSize < TILE_CACHE_TILE_SIZE )
+        ++log2Pixels;
+    *tileWidth  = 1u << ( ( log2Pixels + 1 ) / 2 );
+    *tileHeight = ( 1u << log2Pixels ) / *tileWidth;
+    return true;
+}
+
+bool writeTileCache( ImageReader& image, const std::string& filename, const TileCacheWriteOptions& options, TileCacheWriteStats* stats, std::string* error )
+{
+    TextureInfo info;
+    if( !image.open( &info ) )
+        return fail( error, "cannot read the image" );
+    const unsigned int pixelSize = info.numChannels * getBytesPerChannel( info.format );
+    unsigned int       tileWidth;
+    unsigned int       tileHeight;
+    if( !getTileCacheTileDims( pixelSize, &tileWidth, &tileHeight ) )
+        return fail( error, "unsupported pixel size" );
+    if( info.width == 0 || info.height == 0 || info.numMipLevels == 0 )
+        return fail( error, "empty image" );
+
+    unsigned int numTiles = 0;
+    for( unsigned int level = 0; level < info.numMipLevels; ++level )
+    {
+        numTiles += idivCeil( std::max( 1u, info.width >> level ), tileWidth ) * idivCeil( std::max( 1u, info.height >> level ), tileHeight );
+    }
+
+    std::ofstream file( filename, std::ios::binary | std::ios::trunc );
+    if( !file )
+        return fail( error, "cannot create " + filename );
+
+    // The header and the table are written last, when the tile offsets are known.
+    TileCacheHeader header{};
+    std::memcpy( header.magic, TILE_CACHE_MAGIC, sizeof( header.magic ) );
+    header.version      = TILE_CACHE_VERSION;
+    header.headerSize   = sizeof( TileCacheHeader );
+    header.width        = info.width;
+    header.height       = info.height;
+    header.format       = static_cast<uint32_t>( info.format );
+    header.numChannels  = info.numChannels;
+    header.numMipLevels = info.numMipLevels;
+    header.tileWidth    = tileWidth;
+    header.tileHeight   = tileHeight;
+    header.numTiles     = numTiles;
+    header.tableOffset  = sizeof( TileCacheHeader );
+
+    std::vector<TileCacheEntry> entries;
+    entries.reserve( numTiles );
+    uint64_t position = header.tableOffset + numTiles * sizeof( TileCacheEntry );
+    file.seekp( static_cast<std::streamoff>( position ) );
+
+    std::vector<char>       levelData;
+    std::vector<char>       tile( TILE_CACHE_TILE_SIZE );
+    std::vector<char>       compressed;
+    const std::vector<char> padding( RAW_TILE_ALIGNMENT, 0 );
+    const size_t            maxCompressedSize  = static_cast<size_t>( TILE_CACHE_TILE_SIZE * ( 1.0f - options.minSavings ) );
+    unsigned int            numCompressedTiles = 0;
+    for( unsigned int level = 0; level < info.numMipLevels; ++level )
+    {
+        const unsigned int levelWidth  = std::max( 1u, info.width >> level );
+        const unsigned int levelHeight = std::max( 1u, info.height >> level );
+        levelData.resize( static_cast<size_t>( levelWidth ) * levelHeight * pixelSize );
+        if( !image.readMipLevel( levelData.data(), level, levelWidth, levelHeight ) )
+            return fail( error, "cannot read mip level " + std::to_string( level ) );
+
+        for( unsigned int tileY = 0; tileY < idivCeil( levelHeight, tileHeight ); ++tileY )
+        {
+            for( unsigned int tileX = 0; tileX < idivCeil( levelWidth, tileWidth ); ++tileX )
+            {
+                // Copy the tile out of the level, padding it with black at the edges.
+                const unsigned int copyWidth  = std::min( tileWidth, levelWidth - tileX * tileWidth );
+                const unsigned int copyHeight = std::min( tileHeight, levelHeight - tileY * tileHeight );
+                if( copyWidth < tileWidth || copyHeight < tileHeight )
+                    std::fill( tile.begin(), tile.end(), 0 );
+                for( unsigned int y = 0; y < copyHeight; ++y )
+                {
+                    const size_t srcOffset = ( static_cast<size_t>( tileY * tileHeight + y ) * levelWidth + tileX * tileWidth ) * pixelSize;
+                    std::memcpy( &tile[static_cast<size_t>( y ) * tileWidth * pixelSize], &levelData[srcOffset], copyWidth * pixelSize );
+                }
+
+                TileCacheEntry entry{0, TILE_CACHE_TILE_SIZE, TILE_CACHE_RAW};
+                const char*    data = tile.data();
+                if( options.compress && deflateTile( tile.data(), tile.size(), options.deflateLevel, &compressed )
+                    && compressed.size() <= maxCompressedSize )
+                {
+                    entry.storedSize  = static_cast<uint32_t>( compressed.size() );
+                    entry.compression = TILE_CACHE_DEFLATE;
+                    data              = compressed.data();
+                    ++numCompressedTiles;
+                }
+
+                const uint64_t alignment = entry.compression == TILE_CACHE_RAW ? RAW_TILE_ALIGNMENT : COMPRESSED_TILE_ALIGNMENT;
+                const uint64_t aligned   = idivCeil( position, alignment ) * alignment;
+                file.write( padding.data(), static_cast<std::streamsize>( aligned - position ) );
+                file.write( data, entry.storedSize );
+                entry.offset = aligned;
+                position     = aligned + entry.storedSize;
+                entries.push_back( entry );
+            }
+        }
+    }
+
+    header.fileSize = position;
+    file.seekp( 0 );
+    file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+    file.write( reinterpret_cast<const char*>( entries.data() ), static_cast<std::streamsize>( entries.size() * sizeof( TileCacheEntry ) ) );
+    file.close();
+    if( !file )
+        return fail( error, "cannot write " + filename );
+
+    if( stats )
+    {
+        stats->numTiles           = numTiles;
+        stats->numCompressedTiles = numCompressedTiles;
+        stats->rawBytes           = static_cast<size_t>( numTiles ) * TILE_CACHE_TILE_SIZE;
+        stats->fileBytes          = static_cast<size_t>( position );
+    }
+    return true;
+}
+
+}  // namespace demandLoading
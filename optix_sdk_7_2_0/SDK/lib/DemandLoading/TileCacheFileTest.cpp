@@ -0,0 +1,314 @@
+//
+// tileCacheFileTest - host tests of tile cache files: images whose levels are not a multiple of the
+// tile size survive writeTileCache() and MappedTileImageReader with raw and deflated tiles, read at
+// the stored tile size, at other tile sizes and by mip level, and open() rejects truncated files, a
+// foreign magic or version, and a tile table that points outside the file.  No GPU is needed.
+//
+
+#include "DemandTest.h"
+#include <DemandLoading/CheckerBoardImage.h>
+#include <DemandLoading/MappedTileImageReader.h>
+#include <DemandLoading/TextureInfo.h>
+#include <DemandLoading/TileCacheFile.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace demandLoading;
+
+namespace {
+
+const std::string CACHE_FILE   = "tileCacheFileTest.tiles";
+const std::string DAMAGED_FILE = "tileCacheFileTest.damaged.tiles";
+
+/// RGBA8 image held in memory, each level with its own pattern: noise in the left half, which does
+/// not compress, and a few flat colors in the right half, which does.
+class PatternImage : public ImageReader
+{
+  public:
+    PatternImage( unsigned int width, unsigned int height )
+    {
+        unsigned int numMipLevels = 1;
+        while( ( std::max( width, height ) >> numMipLevels ) > 0 )
+            ++numMipLevels;
+        m_info = TextureInfo{width, height, CU_AD_FORMAT_UNSIGNED_INT8, 4, numMipLevels};
+
+        unsigned int random = 1;
+        for( unsigned int level = 0; level < numMipLevels; ++level )
+        {
+            const unsigned int levelWidth  = std::max( 1u, width >> level );
+            const unsigned int levelHeight = std::max( 1u, height >> level );
+            std::vector<unsigned char> pixels( static_cast<size_t>( levelWidth ) * levelHeight * 4 );
+            for( unsigned int y = 0; y < levelHeight; ++y )
+            {
+                for( unsigned int x = 0; x < levelWidth; ++x )
+                {
+                    unsigned char* pixel = &pixels[( static_cast<size_t>( y ) * levelWidth + x ) * 4];
+                    for( unsigned int c = 0; c < 4; ++c )
+                    {
+                        random   = random * 1664525u + 1013904223u;
+                        pixel[c] = x < levelWidth / 2 ? static_cast<unsigned char>( random >> 24 )
+                                                      : static_cast<unsigned char>( 40 * level + 60 * c + y / 16 );
+                    }
+                }
+            }
+            m_levels.push_back( pixels );
+        }
+    }
+
+    bool open( TextureInfo* info ) override
+    {
+        if( info != nullptr )
+            *info = m_info;
+        return true;
+    }
+
+    void close() override {}
+
+    const TextureInfo& getInfo() override { return m_info; }
+
+    // writeTileCache() reads whole levels
+    bool readTile( char*, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int ) override { return false; }
+
+    bool readMipLevel( char* dest, unsigned int mipLevel, unsigned int expectedWidth, unsigned int expectedHeight ) override
+    {
+        if( mipLevel >= m_levels.size() || static_cast<size_t>( expectedWidth ) * expectedHeight * 4 != m_levels[mipLevel].size() )
+            return false;
+        std::memcpy( dest, m_levels[mipLevel].data(), m_levels[mipLevel].size() );
+        return true;
+    }
+
+  private:
+    TextureInfo                             m_info;
+    std::vector<std::vector<unsigned char>> m_levels;
+};
+
+/// Compare every tile of every level read from the file with the tiles cut out of the levels of the
+/// source image, padded with black.
+bool sameTiles( ImageReader& source, MappedTileImageReader& cache, unsigned int tileWidth, unsigned int tileHeight )
+{
+    const TextureInfo& info      = source.getInfo();
+    const unsigned int pixelSize = info.numChannels * getBytesPerChannel( info.format );
+    std::vector<char>  expected( static_cast<size_t>( tileWidth ) * tileHeight * pixelSize );
+    std::vector<char>  actual( expected.size() );
+    for( unsigned int level = 0; level < info.numMipLevels; ++level )
+    {
+        const unsigned int levelWidth  = std::max( 1u, info.width >> level );
+        const unsigned int levelHeight = std::max( 1u, info.height >> level );
+        std::vector<char>  levelData( static_cast<size_t>( levelWidth ) * levelHeight * pixelSize );
+        if( !source.readMipLevel( levelData.data(), level, levelWidth, levelHeight ) )
+            return false;
+
+        for( unsigned int tileY = 0; tileY * tileHeight < levelHeight; ++tileY )
+        {
+            for( unsigned int tileX = 0; tileX * tileWidth < levelWidth; ++tileX )
+            {
+                std::fill( expected.begin(), expected.end(), 0 );
+                const unsigned int copyWidth = std::min( tileWidth, levelWidth - tileX * tileWidth );
+                for( unsigned int y = 0; y < tileHeight && tileY * tileHeight + y < levelHeight; ++y )
+                {
+                    const size_t srcOffset = ( static_cast<size_t>( tileY * tileHeight + y ) * levelWidth + tileX * tileWidth ) * pixelSize;
+                    std::memcpy( &expected[static_cast<size_t>( y ) * tileWidth * pixelSize], &levelData[srcOffset], copyWidth * pixelSize );
+                }
+
+                std::fill( actual.begin(), actual.end(), 7 );  // the padding must be written as well
+                if( !cache.readTile( actual.data(), level, tileX, tileY, tileWidth, tileHeight ) || actual != expected )
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// Compare every level read from the file with the source image.
+bool sameMipLevels( ImageReader& source, MappedTileImageReader& cache )
+{
+    const TextureInfo& info      = source.getInfo();
+    const unsigned int pixelSize = info.numChannels * getBytesPerChannel( info.format );
+    for( unsigned int level = 0; level < info.numMipLevels; ++level )
+    {
+        const unsigned int levelWidth  = std::max( 1u, info.width >> level );
+        const unsigned int levelHeight = std::max( 1u, info.height >> level );
+        std::vector<char>  expected( static_cast<size_t>( levelWidth ) * levelHeight * pixelSize );
+        std::vector<char>  actual( expected.size() );
+        if( !source.readMipLevel( expected.data(), level, levelWidth, levelHeight )
+            || !cache.readMipLevel( actual.data(), level, levelWidth, levelHeight ) || actual != expected )
+            return false;
+    }
+    return true;
+}
+
+void testRoundTrip( ImageReader& source, const TileCacheWriteOptions& options, bool expectRaw, bool expectDeflated )
+{
+    TileCacheWriteStats stats{};
+    std::string         error;
+    DEMAND_CHECK( writeTileCache( source, CACHE_FILE, options, &stats, &error ) );
+    DEMAND_CHECK( error.empty() );
+    DEMAND_CHECK( ( stats.numCompressedTiles > 0 ) == expectDeflated );
+    DEMAND_CHECK( ( stats.numCompressedTiles < stats.numTiles ) == expectRaw );
+
+    MappedTileImageReader cache( CACHE_FILE );
+    TextureInfo           info{};
+    DEMAND_CHECK( cache.open( &info ) );
+    const TextureInfo& sourceInfo = source.getInfo();
+    DEMAND_CHECK( info.width == sourceInfo.width && info.height == sourceInfo.height && info.format == sourceInfo.format
+                  && info.numChannels == sourceInfo.numChannels && info.numMipLevels == sourceInfo.numMipLevels );
+
+    // The stored tile size, which readTile() copies or inflates directly, then sizes that straddle
+    // the stored tiles.
+    DEMAND_CHECK( sameTiles( source, cache, cache.getTileWidth(), cache.getTileHeight() ) );
+    DEMAND_CHECK( sameTiles( source, cache, 32, 32 ) );
+    DEMAND_CHECK( sameTiles( source, cache, 100, 37 ) );
+    DEMAND_CHECK( sameMipLevels( source, cache ) );
+
+    // Tiles and levels that do not exist
+    std::vector<char> tile( TILE_CACHE_TILE_SIZE );
+    DEMAND_CHECK( !cache.readTile( tile.data(), info.numMipLevels, 0, 0, cache.getTileWidth(), cache.getTileHeight() ) );
+    DEMAND_CHECK( !cache.readTile( tile.data(), 0, 0, 1000, cache.getTileWidth(), cache.getTileHeight() ) );
+    DEMAND_CHECK( !cache.readMipLevel( tile.data(), 0, info.width + 1, info.height ) );
+}
+
+void testRoundTrips()
+{
+    // 300x157 RGBA8 in 128x128 tiles: noisy tiles stay raw, flat ones are deflated
+    PatternImage          pattern( 300, 157 );
+    TileCacheWriteOptions options;
+    testRoundTrip( pattern, options, true, true );
+
+    options.compress = false;
+    testRoundTrip( pattern, options, true, false );
+
+    // 200x70 float4 in 64x64 tiles, all of them deflated
+    CheckerBoardImage checkerBoard( 200, 70, 4 );
+    checkerBoard.open( nullptr );
+    options.compress = true;
+    testRoundTrip( checkerBoard, options, false, true );
+}
+
+
+std::vector<char> readFile( const std::string& filename )
+{
+    std::ifstream file( filename, std::ios::binary );
+    return std::vector<char>( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
+}
+
+/// Write the bytes to a file and check whether a reader accepts it.
+bool opens( const std::vector<char>& bytes )
+{
+    {
+        std::ofstream file( DAMAGED_FILE, std::ios::binary | std::ios::trunc );
+        file.write( bytes.data(), static_cast<std::streamsize>( bytes.size() ) );
+    }
+    MappedTileImageReader reader( DAMAGED_FILE );
+    return reader.open( nullptr );
+}
+
+TileCacheHeader getHeader( const std::vector<char>& bytes )
+{
+    TileCacheHeader header;
+    std::memcpy( &header, bytes.data(), sizeof( header ) );
+    return header;
+}
+
+std::vector<char> withHeader( std::vector<char> bytes, const TileCacheHeader& header )
+{
+    std::memcpy( bytes.data(), &header, sizeof( header ) );
+    return bytes;
+}
+
+TileCacheEntry getEntry( const std::vector<char>& bytes, unsigned int index )
+{
+    TileCacheEntry entry;
+    std::memcpy( &entry, &bytes[getHeader( bytes ).tableOffset + index * sizeof( entry )], sizeof( entry ) );
+    return entry;
+}
+
+std::vector<char> withEntry( std::vector<char> bytes, unsigned int index, const TileCacheEntry& entry )
+{
+    std::memcpy( &bytes[getHeader( bytes ).tableOffset + index * sizeof( entry )], &entry, sizeof( entry ) );
+    return bytes;
+}
+
+void testValidation()
+{
+    PatternImage          pattern( 300, 157 );
+    TileCacheWriteOptions options;
+    DEMAND_CHECK( writeTileCache( pattern, CACHE_FILE, options ) );
+    const std::vector<char> bytes = readFile( CACHE_FILE );
+    DEMAND_CHECK( bytes.size() > sizeof( TileCacheHeader ) && opens( bytes ) );  // the last tile ends at the end of the file
+    const TileCacheHeader header = getHeader( bytes );
+
+    // Truncated: inside the header, inside the tile data, and with the header claiming the shorter
+    // size.  A file longer than its header says is not trusted either.
+    DEMAND_CHECK( !opens( std::vector<char>( bytes.begin(), bytes.begin() + sizeof( TileCacheHeader ) - 1 ) ) );
+    DEMAND_CHECK( !opens( std::vector<char>( bytes.begin(), bytes.end() - 1 ) ) );
+    TileCacheHeader shorter = header;
+    shorter.fileSize -= 1;
+    DEMAND_CHECK( !opens( withHeader( std::vector<char>( bytes.begin(), bytes.end() - 1 ), shorter ) ) );
+    std::vector<char> longer = bytes;
+    longer.push_back( 0 );
+    DEMAND_CHECK( !opens( longer ) );
+
+    // Not a tile cache file, or one of another version
+    TileCacheHeader foreign = header;
+    foreign.magic[0]        = 'X';
+    DEMAND_CHECK( !opens( withHeader( bytes, foreign ) ) );
+    TileCacheHeader newer = header;
+    newer.version         = TILE_CACHE_VERSION + 1;
+    DEMAND_CHECK( !opens( withHeader( bytes, newer ) ) );
+
+    // A tile table that does not match the image, or that runs past the end of the file
+    TileCacheHeader fewerTiles = header;
+    fewerTiles.numTiles -= 1;
+    DEMAND_CHECK( !opens( withHeader( bytes, fewerTiles ) ) );
+    TileCacheHeader lateTable = header;
+    lateTable.tableOffset     = header.fileSize / alignof( TileCacheEntry ) * alignof( TileCacheEntry ) - sizeof( TileCacheEntry );
+    DEMAND_CHECK( !opens( withHeader( bytes, lateTable ) ) );
+    lateTable.tableOffset = header.fileSize + sizeof( TileCacheEntry );
+    DEMAND_CHECK( !opens( withHeader( bytes, lateTable ) ) );
+
+    // Entries pointing past the end of the file, raw and deflated
+    unsigned int rawTile = ~0u, deflatedTile = ~0u;
+    for( unsigned int i = 0; i < header.numTiles; ++i )
+        ( getEntry( bytes, i ).compression == TILE_CACHE_RAW ? rawTile : deflatedTile ) = i;
+    DEMAND_CHECK( rawTile != ~0u && deflatedTile != ~0u );
+    if( rawTile == ~0u || deflatedTile == ~0u )
+        return;
+    for( unsigned int index : {rawTile, deflatedTile} )
+    {
+        TileCacheEntry entry = getEntry( bytes, index );
+        entry.offset         = header.fileSize - entry.storedSize + 1;
+        DEMAND_CHECK( !opens( withEntry( bytes, index, entry ) ) );
+        entry.offset = header.fileSize + 1;
+        DEMAND_CHECK( !opens( withEntry( bytes, index, entry ) ) );
+
+        entry            = getEntry( bytes, index );
+        entry.storedSize = static_cast<uint32_t>( header.fileSize - entry.offset + 1 );
+        DEMAND_CHECK( !opens( withEntry( bytes, index, entry ) ) );
+    }
+
+    // A raw tile of the wrong size, and an unknown compression
+    TileCacheEntry entry = getEntry( bytes, rawTile );
+    entry.storedSize     = TILE_CACHE_TILE_SIZE / 2;
+    DEMAND_CHECK( !opens( withEntry( bytes, rawTile, entry ) ) );
+    entry             = getEntry( bytes, deflatedTile );
+    entry.compression = TILE_CACHE_DEFLATE + 1;
+    DEMAND_CHECK( !opens( withEntry( bytes, deflatedTile, entry ) ) );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testRoundTrips();
+    testValidation();
+    std::remove( CACHE_FILE.c_str() );
+    std::remove( DAMAGED_FILE.c_str() );
+    return demandTestResult( "tileCacheFileTest" );
+}
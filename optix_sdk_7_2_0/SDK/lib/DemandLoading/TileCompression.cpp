@@ -0,0 +1,33 @@
+#include "TileCompression.h"
+
+#include "StbImage.h"
+
+#include <limits>
+
+namespace demandLoading {
+
+bool deflateTile( const char* data, size_t size, int level, std::vector<char>* compressed )
+{
+    if( size > static_cast<size_t>( std::numeric_limits<int>::max() ) )
+        return false;
+
+    int            compressedSize = 0;
+    unsigned char* result =
+        stbZlibCompress( reinterpret_cast<const unsigned char*>( data ), static_cast<int>( size ), &compressedSize, level );
+    if( !result )
+        return false;
+    compressed->assign( reinterpret_cast<char*>( result ), reinterpret_cast<char*>( result ) + compressedSize );
+    stbFreeCompressed( result );
+    return true;
+}
+
+bool inflateTile( const char* data, size_t storedSize, char* dest, size_t size )
+{
+    if( storedSize > static_cast<size_t>( std::numeric_limits<int>::max() ) || size > static_cast<size_t>( std::numeric_limits<int>::max() ) )
+        return false;
+
+    const int inflated = stbZlibDecode( dest, static_cast<int>( size ), data, static_cast<int>( storedSize ) );
+    return inflated == static_cast<int>( size );
+}
+
+}  // namespace demandLoading
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace demandLoading {
+
+/// Compress a tile into a zlib stream, replacing the contents of compressed.  level is 1 (fastest)
+/// to 9 (smallest).  Returns false if the compressor fails.
+bool deflateTile( const char* data, size_t size, int level, std::vector<char>* compressed );
+
+/// Decompress a zlib stream into dest, which must decompress to exactly size bytes.
+bool inflateTile( const char* data, size_t storedSize, char* dest, size_t size );
+
+}  // namespace demandLoading
@@ -0,0 +1,266 @@
+#include "TileLoader.h"
+
+#include <DemandLoading/ImageReader.h>
+#include <DemandLoading/TextureInfo.h>
+
+#include <chrono>
+#include <exception>
+
+namespace demandLoading {
+
+bool TileLoader::QueueKey::operator<( const QueueKey& other ) const
+{
+    if( prefetch != other.prefetch )
+        return !prefetch;
+    if( level != other.level )
+        return level > other.level;
+    if( frequency != other.frequency )
+        return frequency > other.frequency;
+    if( sequence != other.sequence )
+        return sequence < other.sequence;
+    return pageId < other.pageId;
+}
+
+unsigned int TileLoader::priorityLevel( const TileReadRequest& request )
+{
+    // Nothing of a texture can be sampled before its header and mip tail are in, so they go first.
+    return request.kind == TileReadRequest::TILE ? request.mipLevel : ~0u;
+}
+
+TileLoader::TileLoader( unsigned int numThreads, TileCache* cache )
+    : m_cache( cache )
+{
+    m_threads.reserve( numThreads );
+    for( unsigned int i = 0; i < numThreads; ++i )
+        m_threads.emplace_back( &TileLoader::workerLoop, this );
+}
+
+TileLoader::~TileLoader()
+{
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_stop = true;
+    }
+    m_workAvailable.notify_all();
+    for( std::thread& thread : m_threads )
+        thread.join();
+}
+
+bool TileLoader::enqueue( const TileReadRequest& request )
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    auto                         it = m_jobs.find( request.pageId );
+    if( it != m_jobs.end() )
+    {
+        // Merge the request into the existing read, re-keying it if it is still queued.
+        Job& job = it->second;
+        job.request.devices |= request.devices;
+        if( job.state == Job::QUEUED )
+            m_queue.erase( job.key );
+        job.key.frequency += 1;
+        if( !request.prefetch )
+        {
+            job.request.prefetch = false;
+            job.key.prefetch     = false;
+        }
+        if( job.state == Job::QUEUED )
+            m_queue.insert( job.key );
+        return false;
+    }
+
+    Job job;
+    job.request = request;
+    job.key     = QueueKey{request.prefetch, priorityLevel( request ), 1, m_sequence++, request.pageId};
+    m_queue.insert( job.key );
+    m_jobs.emplace( request.pageId, std::move( job ) );
+    lock.unlock();
+
+    m_workAvailable.notify_one();
+    return true;
+}
+
+bool TileLoader::isPending( unsigned int pageId ) const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return m_jobs.find( pageId ) != m_jobs.end();
+}
+
+void TileLoader::takeCompleted( std::vector<TileReadResult>& results )
+{
+    results.clear();
+    std::unique_lock<std::mutex> lock( m_mutex );
+    results.reserve( m_completed.size() );
+    for( unsigned int pageId : m_completed )
+    {
+        auto it = m_jobs.find( pageId );
+        results.push_back( TileReadResult{std::move( it->second.request ), std::move( it->second.data ), it->second.ok} );
+        m_jobs.erase( it );
+    }
+    m_completed.clear();
+}
+
+void TileLoader::waitForIdle()
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    m_idle.wait( lock, [this] { return m_queue.empty() && m_numInFlight == 0; } );
+}
+
+std::mutex& TileLoader::getImageMutex( const ImageReader* image )
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return getImageMutexLocked( image );
+}
+
+// The caller holds m_mutex.  The mutexes are never destroyed before the loader, so the reference
+// stays valid after m_mutex is released.
+std::mutex& TileLoader::getImageMutexLocked( const ImageReader* image )
+{
+    std::unique_ptr<std::mutex>& imageMutex = m_imageMutexes[image];
+    if( !imageMutex )
+        imageMutex.reset( new std::mutex );
+    return *imageMutex;
+}
+
+unsigned int TileLoader::getNumPending() const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return static_cast<unsigned int>( m_jobs.size() );
+}
+
+unsigned int TileLoader::getNumReads() const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return m_numReads;
+}
+
+unsigned int TileLoader::getNumPrefetchReads() const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return m_numPrefetchReads;
+}
+
+size_t TileLoader::getBytesRead() const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return m_bytesRead;
+}
+
+double TileLoader::getReadSeconds() const
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    return m_readSeconds;
+}
+
+void TileLoader::workerLoop()
+{
+    std::vector<char> buffer;
+    while( true )
+    {
+        // Take the best queued read of an image no other worker is reading.
+        std::unique_lock<std::mutex> lock( m_mutex );
+        std::set<QueueKey>::iterator next;
+        m_workAvailable.wait( lock, [this, &next] { return m_stop || ( next = findReadable() ) != m_queue.end(); } );
+        if( m_stop )
+            return;
+
+        const unsigned int pageId = next->pageId;
+        m_queue.erase( next );
+        Job& job  = m_jobs.at( pageId );
+        job.state = Job::IN_FLIGHT;
+        ++m_numInFlight;
+        const TileReadRequest request    = job.request;
+        std::mutex&           imageMutex = getImageMutexLocked( request.image.get() );
+        m_busyImages.insert( request.image.get() );
+        lock.unlock();
+
+        const auto start = std::chrono::steady_clock::now();
+        const bool ok    = read( request, imageMutex, &buffer );
+        const auto end   = std::chrono::steady_clock::now();
+
+        // The buffer is handed over to the cache and the manager, the next read allocates a new one.
+        TileCache::Data data;
+        if( ok && request.kind != TileReadRequest::OPEN )
+        {
+            data = std::make_shared<const std::vector<char>>( std::move( buffer ) );
+            buffer.clear();
+            m_cache->insert( pageId, data, request.prefetch );
+        }
+
+        // The job may have been promoted from prefetch to demand while it was read.
+        lock.lock();
+        Job& done = m_jobs.at( pageId );
+        if( request.kind != TileReadRequest::OPEN )
+        {
+            ++m_numReads;
+            m_numPrefetchReads += request.prefetch ? 1 : 0;
+            m_bytesRead += request.size;
+        }
+        m_readSeconds += std::chrono::duration<double>( end - start ).count();
+        if( done.request.prefetch )
+        {
+            m_jobs.erase( pageId );
+        }
+        else
+        {
+            done.state = Job::DONE;
+            done.data  = std::move( data );
+            done.ok    = ok;
+            m_completed.push_back( pageId );
+        }
+        --m_numInFlight;
+        m_busyImages.erase( request.image.get() );
+        const bool idle    = m_queue.empty() && m_numInFlight == 0;
+        const bool waiting = !m_queue.empty();
+        lock.unlock();
+
+        // The queued reads of the image may have been skipped by the other workers.
+        if( waiting )
+            m_workAvailable.notify_all();
+        if( idle )
+            m_idle.notify_all();
+    }
+}
+
+// The caller holds m_mutex.
+std::set<TileLoader::QueueKey>::iterator TileLoader::findReadable()
+{
+    for( auto it = m_queue.begin(); it != m_queue.end(); ++it )
+    {
+        if( m_busyImages.count( m_jobs.at( it->pageId ).request.image.get() ) == 0 )
+            return it;
+    }
+    return m_queue.end();
+}
+
+// Exceptions thrown by the image readers are reported as failed reads; the manager decides what
+// to do about them on its own thread.
+bool TileLoader::read( const TileReadRequest& request, std::mutex& imageMutex, std::vector<char>* buffer )
+{
+    std::unique_lock<std::mutex> imageLock( imageMutex );
+    try
+    {
+        switch( request.kind )
+        {
+            case TileReadRequest::OPEN:
+            {
+                TextureInfo info;
+                buffer->clear();
+                return request.image->open( &info );
+            }
+            case TileReadRequest::MIP_TAIL:
+                buffer->resize( request.size );
+                return request.image->readMipTail( buffer->data(), request.mipLevel, request.numMipLevels,
+                                                   request.mipLevelDims.data(), request.pixelSize );
+            case TileReadRequest::TILE:
+                buffer->resize( request.size );
+                return request.image->readTile( buffer->data(), request.mipLevel, request.tileX, request.tileY,
+                                                request.tileWidth, request.tileHeight );
+        }
+    }
+    catch( const std::exception& )
+    {
+    }
+    return false;
+}
+
+}  // namespace demandLoading
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "TileCache.h"
+
+#include <vector_types.h>
+
+#include <bitset>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace demandLoading {
+
+class ImageReader;
+
+/// A read of one page of a demand-loaded texture.  The request carries everything the read needs,
+/// so a worker never touches the DemandTextureImpl, which the manager may move while the read is
+/// in progress.
+struct TileReadRequest
+{
+    enum Kind
+    {
+        OPEN,      // open the image (the start page of an uninitialized texture)
+        MIP_TAIL,  // read the mip tail (the start page of an initialized texture)
+        TILE       // read one tile
+    };
+
+    Kind                         kind   = TILE;
+    unsigned int                 pageId = 0;
+    std::shared_ptr<ImageReader> image;
+    std::bitset<32>              devices;  // devices waiting for the page, empty for a prefetch
+    bool                         prefetch = false;
+
+    // TILE; for MIP_TAIL mipLevel is the first level of the tail
+    unsigned int mipLevel   = 0;
+    unsigned int tileX      = 0;
+    unsigned int tileY      = 0;
+    unsigned int tileWidth  = 0;
+    unsigned int tileHeight = 0;
+
+    // MIP_TAIL
+    std::vector<uint2> mipLevelDims;
+    unsigned int       numMipLevels = 0;
+    unsigned int       pixelSize    = 0;
+
+    size_t size = 0;  // bytes of the tile or mip tail
+};
+
+/// A finished read.  The data is also in the tile cache, unless it was too big for it.
+struct TileReadResult
+{
+    TileReadRequest request;
+    TileCache::Data data;  // null for OPEN and for failed reads
+    bool            ok;
+};
+
+/// Pool of threads that read tiles, mip tails and image headers in the background.
+///
+/// Requests are deduplicated by page id: a request for a page that is already queued or being read
+/// only adds its devices and raises the priority of the queued read.  The queue is ordered by
+/// (1) demand before prefetch, (2) coarser mip level first, since a coarse tile covers more of the
+/// screen and the device falls back to it while the finer ones load, (3) number of times the page
+/// was requested, and (4) age.  Reads of one image are serialized because ImageReader is not thread
+/// safe; reads of different images proceed in parallel.  A worker skips the queued reads of images
+/// that another worker is reading, so a slow image holds up one worker rather than all of them.
+///
+/// Finished demand reads are collected by takeCompleted() on the thread that owns the devices.
+/// Prefetched data only goes to the cache.
+class TileLoader
+{
+  public:
+    /// Start numThreads worker threads storing what they read in the given cache.
+    TileLoader( unsigned int numThreads, TileCache* cache );
+
+    /// Stop the workers.  Queued reads are dropped; reads in progress are finished first.
+    ~TileLoader();
+
+    TileLoader( const TileLoader& ) = delete;
+    TileLoader& operator=( const TileLoader& ) = delete;
+
+    /// Queue a read.  Returns false if the page is already queued, being read, or waiting in the
+    /// completed list, in which case the existing read is promoted instead.
+    bool enqueue( const TileReadRequest& request );
+
+    /// Check whether a read of the page is queued, in progress or waiting to be taken.
+    bool isPending( unsigned int pageId ) const;
+
+    /// Move the finished demand reads into results (which is cleared first).
+    void takeCompleted( std::vector<TileReadResult>& results );
+
+    /// Block until the queue is empty and no read is in progress.
+    void waitForIdle();
+
+    /// Get the mutex that serializes access to the given image.  The manager holds it while it
+    /// opens an image on its own thread.
+    std::mutex& getImageMutex( const ImageReader* image );
+
+    /// Get the number of reads that are queued, in progress, or finished but not yet taken.
+    unsigned int getNumPending() const;
+
+    unsigned int getNumThreads() const { return static_cast<unsigned int>( m_threads.size() ); }
+    unsigned int getNumReads() const;          // tiles and mip tails read
+    unsigned int getNumPrefetchReads() const;  // of which prefetched
+    size_t       getBytesRead() const;
+    double       getReadSeconds() const;  // time spent in ImageReader, summed over the workers
+
+  private:
+    // Priority of a queued read, see the class comment.  The set orders the best read first.
+    struct QueueKey
+    {
+        bool         prefetch;
+        unsigned int level;  // mip level, the mip tail and the image header count as coarsest
+        unsigned int frequency;
+        unsigned int sequence;
+        unsigned int pageId;
+
+        bool operator<( const QueueKey& other ) const;
+    };
+
+    struct Job
+    {
+        enum State
+        {
+            QUEUED,
+            IN_FLIGHT,
+            DONE  // demand read waiting for takeCompleted()
+        };
+
+        TileReadRequest request;
+        QueueKey        key;
+        State           state = QUEUED;
+        TileCache::Data data;
+        bool            ok = false;
+    };
+
+    void                         workerLoop();
+    std::set<QueueKey>::iterator findReadable();
+    bool                         read( const TileReadRequest& request, std::mutex& imageMutex, std::vector<char>* buffer );
+    std::mutex&                  getImageMutexLocked( const ImageReader* image );
+    static unsigned int          priorityLevel( const TileReadRequest& request );
+
+    TileCache*                                                m_cache;
+    std::vector<std::thread>                                  m_threads;
+    std::set<QueueKey>                                        m_queue;
+    std::unordered_map<unsigned int, Job>                     m_jobs;       // not yet taken, by page id
+    std::vector<unsigned int>                                 m_completed;  // page ids of the DONE jobs
+    std::map<const ImageReader*, std::unique_ptr<std::mutex>> m_imageMutexes;
+    std::unordered_set<const ImageReader*>                    m_busyImages;  // being read by a worker
+    unsigned int                                              m_sequence         = 0;
+    unsigned int                                              m_numInFlight      = 0;
+    bool                                                      m_stop             = false;
+    unsigned int                                              m_numReads         = 0;
+    unsigned int                                              m_numPrefetchReads = 0;
+    size_t                                                    m_bytesRead        = 0;
+    double                                                    m_readSeconds      = 0.0;
+    mutable std::mutex                                        m_mutex;
+    std::condition_variable                                   m_workAvailable;
+    std::condition_variable                                   m_idle;
+};
+
+}  // namespace demandLoading
@@ -0,0 +1,379 @@
+//
+// tileLoaderBenchmark - replays the tile requests of a camera panning across a few large textures
+// against TileLoader and TileCache, without a GPU.  The images are CheckerBoardImages behind a reader
+// that sleeps for a fixed latency per read, standing in for disk or network I/O.  Each frame first
+// fills what the loader finished (like DemandTextureManager::launchPrepare), then "renders" for a
+// fixed time, then processes the requests of the frame (like processRequests).  The device holds a
+// limited number of tiles and evicts the least recently used ones, so tiles that scroll back into
+// view are served from the host cache.
+//
+// Reported per configuration: wall time, time the frame loop spent blocked in request processing,
+// tiles read per second, frames from first request to fill, host cache and prefetch hit rates, and
+// the number of repeated requests merged into a read already under way.
+//
+
+#include "TileCache.h"
+#include "TileLoader.h"
+#include <DemandLoading/CheckerBoardImage.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace demandLoading;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+const unsigned int TILE_WIDTH  = 64;  // 64x64 float4 texels, one 64 KiB sparse texture tile
+const unsigned int TILE_HEIGHT = 64;
+const unsigned int PIXEL_SIZE  = 16;
+
+/// Adds a fixed latency to every read of another image.
+class SlowImageReader : public ImageReader
+{
+  public:
+    SlowImageReader( std::shared_ptr<ImageReader> image, unsigned int latencyMicroseconds )
+        : m_image( image )
+        , m_latency( latencyMicroseconds )
+    {
+    }
+
+    bool open( TextureInfo* info ) override
+    {
+        wait();
+        return m_image->open( info );
+    }
+
+    void close() override { m_image->close(); }
+
+    const TextureInfo& getInfo() override { return m_image->getInfo(); }
+
+    bool readTile( char* dest, unsigned int mipLevel, unsigned int tileX, unsigned int tileY, unsigned int tileWidth, unsigned int tileHeight ) override
+    {
+        wait();
+        return m_image->readTile( dest, mipLevel, tileX, tileY, tileWidth, tileHeight );
+    }
+
+    bool readMipLevel( char* dest, unsigned int mipLevel, unsigned int expectedWidth, unsigned int expectedHeight ) override
+    {
+        wait();
+        return m_image->readMipLevel( dest, mipLevel, expectedWidth, expectedHeight );
+    }
+
+  private:
+    void wait() const { std::this_thread::sleep_for( std::chrono::microseconds( m_latency ) ); }
+
+    std::shared_ptr<ImageReader> m_image;
+    unsigned int                 m_latency;
+};
+
+struct Options
+{
+    unsigned int numTextures = 4;
+    unsigned int textureSize = 4096;
+    unsigned int latency     = 2000;  // microseconds per read
+    unsigned int frames      = 300;
+    unsigned int frameTime   = 8;   // milliseconds of rendering per frame
+    unsigned int viewTiles   = 6;   // the view covers viewTiles x viewTiles tiles of each texture
+    unsigned int panFrames   = 3;   // the view moves by one tile every panFrames frames
+    unsigned int panTiles    = 24;  // and turns around after panTiles tiles
+    unsigned int deviceTiles = 256;
+    size_t       cacheBytes  = size_t( 64 ) << 20;
+};
+
+/// Page ids of the tiles of one texture, finest level first.
+struct TextureLayout
+{
+    std::shared_ptr<ImageReader> image;
+    unsigned int                 startPage;
+    std::vector<unsigned int>    levelStart;
+    std::vector<unsigned int>    levelTiles;  // tiles per side
+};
+
+struct Result
+{
+    double       seconds        = 0.0;
+    double       blockedSeconds = 0.0;
+    unsigned int reads          = 0;
+    unsigned int prefetchReads  = 0;
+    unsigned int fills          = 0;
+    unsigned int cacheHits      = 0;
+    unsigned int cacheMisses    = 0;
+    unsigned int prefetchHits   = 0;
+    unsigned int merged         = 0;
+    double       framesToFill   = 0.0;  // mean over fills
+};
+
+/// Replays the request stream, reading synchronously if numThreads is zero.
+class Simulation
+{
+  public:
+    Simulation( const Options& options, unsigned int numThreads, bool prefetch )
+        : m_options( options )
+        , m_prefetch( prefetch )
+        , m_cache( options.cacheBytes )
+    {
+        unsigned int nextPage = 0;
+        for( unsigned int i = 0; i < options.numTextures; ++i )
+        {
+            std::shared_ptr<ImageReader> checkerBoard( new CheckerBoardImage( options.textureSize, options.textureSize, 16 ) );
+            TextureLayout texture;
+            texture.image     = std::make_shared<SlowImageReader>( checkerBoard, options.latency );
+            texture.startPage = nextPage;
+            for( unsigned int size = options.textureSize; size >= TILE_WIDTH; size /= 2 )
+            {
+                const unsigned int tiles = size / TILE_WIDTH;
+                texture.levelStart.push_back( nextPage );
+                texture.levelTiles.push_back( tiles );
+                nextPage += tiles * tiles;
+            }
+            TextureInfo info;
+            texture.image->open( &info );
+            m_textures.push_back( texture );
+        }
+        if( numThreads > 0 )
+            m_loader.reset( new TileLoader( numThreads, &m_cache ) );
+    }
+
+    Result run()
+    {
+        Result                      result;
+        double                      fillDelay = 0.0;
+        const auto                  start     = Clock::now();
+        std::vector<TileReadResult> completed;
+        for( m_frame = 0; m_frame < m_options.frames; ++m_frame )
+        {
+            if( m_loader )
+            {
+                m_loader->takeCompleted( completed );
+                for( const TileReadResult& read : completed )
+                    fill( read.request.pageId, &fillDelay );
+            }
+
+            std::this_thread::sleep_for( std::chrono::milliseconds( m_options.frameTime ) );
+
+            const auto blockStart = Clock::now();
+            for( const TileReadRequest& request : frameRequests() )
+            {
+                // Pages already resident are touched, not requested.
+                auto resident = m_resident.find( request.pageId );
+                if( resident != m_resident.end() )
+                {
+                    m_lru.splice( m_lru.begin(), m_lru, resident->second );
+                    continue;
+                }
+                m_firstRequest.emplace( request.pageId, m_frame );
+
+                if( m_loader && m_loader->isPending( request.pageId ) )
+                {
+                    m_loader->enqueue( request );
+                    ++result.merged;
+                }
+                else if( m_cache.find( request.pageId ) )
+                {
+                    fill( request.pageId, &fillDelay );
+                }
+                else if( m_loader )
+                {
+                    m_loader->enqueue( request );
+                }
+                else
+                {
+                    std::vector<char> buffer( request.size );
+                    request.image->readTile( buffer.data(), request.mipLevel, request.tileX, request.tileY, TILE_WIDTH, TILE_HEIGHT );
+                    ++m_syncReads;
+                    m_cache.insert( request.pageId, std::make_shared<const std::vector<char>>( std::move( buffer ) ) );
+                    fill( request.pageId, &fillDelay );
+                }
+
+                if( m_loader && m_prefetch )
+                    prefetchNeighbors( request );
+            }
+            result.blockedSeconds += std::chrono::duration<double>( Clock::now() - blockStart ).count();
+        }
+        result.seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+
+        result.reads         = m_loader ? m_loader->getNumReads() : m_syncReads;
+        result.prefetchReads = m_loader ? m_loader->getNumPrefetchReads() : 0;
+        result.fills         = m_fills;
+        result.cacheHits     = m_cache.getNumHits();
+        result.cacheMisses   = m_cache.getNumMisses();
+        result.prefetchHits  = m_cache.getNumPrefetchHits();
+        result.framesToFill  = m_fills ? fillDelay / m_fills : 0.0;
+        return result;
+    }
+
+  private:
+    // The view covers a square of tiles of each texture and pans diagonally back and forth.  Even
+    // textures are seen at their finest level, odd textures one level coarser.
+    std::vector<TileReadRequest> frameRequests() const
+    {
+        std::vector<TileReadRequest> requests;
+        const unsigned int           step   = ( m_frame / m_options.panFrames ) % ( 2 * m_options.panTiles );
+        const unsigned int           offset = step < m_options.panTiles ? step : 2 * m_options.panTiles - step;
+        for( const TextureLayout& texture : m_textures )
+        {
+            const unsigned int level = static_cast<unsigned int>( &texture - m_textures.data() ) % 2;
+            const unsigned int tiles = texture.levelTiles[level];
+            for( unsigned int y = 0; y < m_options.viewTiles; ++y )
+            {
+                for( unsigned int x = 0; x < m_options.viewTiles; ++x )
+                {
+                    requests.push_back( tileRequest( texture, level, ( x + offset ) % tiles, ( y + offset / 2 ) % tiles ) );
+                }
+            }
+        }
+        return requests;
+    }
+
+    TileReadRequest tileRequest( const TextureLayout& texture, unsigned int level, unsigned int tileX, unsigned int tileY ) const
+    {
+        TileReadRequest request;
+        request.kind       = TileReadRequest::TILE;
+        request.pageId     = texture.levelStart[level] + tileY * texture.levelTiles[level] + tileX;
+        request.image      = texture.image;
+        request.devices.set( 0 );
+        request.mipLevel   = level;
+        request.tileX      = tileX;
+        request.tileY      = tileY;
+        request.tileWidth  = TILE_WIDTH;
+        request.tileHeight = TILE_HEIGHT;
+        request.size       = TILE_WIDTH * TILE_HEIGHT * PIXEL_SIZE;
+        return request;
+    }
+
+    void prefetchNeighbors( const TileReadRequest& request )
+    {
+        const TextureLayout& texture = *std::find_if( m_textures.begin(), m_textures.end(), [&]( const TextureLayout& t ) {
+            return t.image == request.image;
+        } );
+        const int tiles = static_cast<int>( texture.levelTiles[request.mipLevel] );
+        for( int y = static_cast<int>( request.tileY ) - 1; y <= static_cast<int>( request.tileY ) + 1; ++y )
+        {
+            for( int x = static_cast<int>( request.tileX ) - 1; x <= static_cast<int>( request.tileX ) + 1; ++x )
+            {
+                if( x < 0 || y < 0 || x >= tiles || y >= tiles )
+                    continue;
+                TileReadRequest neighbor = tileRequest( texture, request.mipLevel, x, y );
+                if( m_resident.count( neighbor.pageId ) || m_cache.contains( neighbor.pageId ) || m_loader->isPending( neighbor.pageId ) )
+                    continue;
+                neighbor.devices.reset();
+                neighbor.prefetch = true;
+                m_loader->enqueue( neighbor );
+            }
+        }
+    }
+
+    void fill( unsigned int pageId, double* fillDelay )
+    {
+        if( m_resident.size() >= m_options.deviceTiles )
+        {
+            m_resident.erase( m_lru.back() );
+            m_lru.pop_back();
+        }
+        m_lru.push_front( pageId );
+        m_resident[pageId] = m_lru.begin();
+
+        auto first = m_firstRequest.find( pageId );
+        if( first != m_firstRequest.end() )
+        {
+            *fillDelay += m_frame - first->second;
+            m_firstRequest.erase( first );
+        }
+        ++m_fills;
+    }
+
+    const Options&                                                      m_options;
+    bool                                                                m_prefetch;
+    TileCache                                                           m_cache;
+    std::unique_ptr<TileLoader>                                         m_loader;
+    std::vector<TextureLayout>                                          m_textures;
+    std::list<unsigned int>                                             m_lru;  // device tiles, most recently used first
+    std::unordered_map<unsigned int, std::list<unsigned int>::iterator> m_resident;
+    std::unordered_map<unsigned int, unsigned int>                      m_firstRequest;  // page -> frame of its first request
+    unsigned int                                                        m_frame     = 0;
+    unsigned int                                                        m_fills     = 0;
+    unsigned int                                                        m_syncReads = 0;
+};
+
+void printUsageAndExit( const char* argv0 )
+{
+    std::cerr << "Usage  : " << argv0 << " [options]\n";
+    std::cerr << "Options: --textures <n>             Textures in view (default 4)\n";
+    std::cerr << "         --size <n>                 Texture width and height (default 4096)\n";
+    std::cerr << "         --latency <us>             Time per read (default 2000)\n";
+    std::cerr << "         --frames <n>               Frames to simulate (default 300)\n";
+    std::cerr << "         --frame-time <ms>          Rendering time per frame (default 8)\n";
+    std::cerr << "         --device-tiles <n>         Tiles the device holds (default 256)\n";
+    std::cerr << "         --cache-mb <n>             Host tile cache size (default 64)\n";
+    exit( 0 );
+}
+
+void printResult( const std::string& name, const Result& result )
+{
+    const unsigned int lookups = result.cacheHits + result.cacheMisses;
+    std::cout << std::left << std::setw( 22 ) << name << std::right << std::fixed << std::setprecision( 2 )
+              << std::setw( 8 ) << result.seconds << " s" << std::setw( 9 ) << result.blockedSeconds << " s"
+              << std::setw( 7 ) << result.reads << std::setw( 9 ) << std::setprecision( 0 ) << result.reads / result.seconds
+              << std::setw( 7 ) << result.fills << std::setw( 8 ) << std::setprecision( 2 ) << result.framesToFill
+              << std::setw( 8 ) << std::setprecision( 1 ) << ( lookups ? 100.0 * result.cacheHits / lookups : 0.0 ) << "%"
+              << std::setw( 8 ) << result.prefetchReads << std::setw( 8 ) << result.prefetchHits << std::setw( 8 )
+              << result.merged << std::endl;
+}
+
+}  // namespace
+
+int main( int argc, char* argv[] )
+{
+    Options options;
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+            printUsageAndExit( argv[0] );
+        if( i + 1 >= argc )
+            printUsageAndExit( argv[0] );
+        const unsigned int value = static_cast<unsigned int>( std::atoi( argv[++i] ) );
+        if( arg == "--textures" )
+            options.numTextures = value;
+        else if( arg == "--size" )
+            options.textureSize = value;
+        else if( arg == "--latency" )
+            options.latency = value;
+        else if( arg == "--frames" )
+            options.frames = std::max( value, 1u );
+        else if( arg == "--frame-time" )
+            options.frameTime = value;
+        else if( arg == "--device-tiles" )
+            options.deviceTiles = std::max( value, 1u );
+        else if( arg == "--cache-mb" )
+            options.cacheBytes = size_t( value ) << 20;
+        else
+            printUsageAndExit( argv[0] );
+    }
+
+    std::cout << options.numTextures << " textures of " << options.textureSize << "^2, " << options.latency
+              << " us per read, " << options.frames << " frames of " << options.frameTime << " ms, "
+              << options.deviceTiles << " device tiles, " << ( options.cacheBytes >> 20 ) << " MB host cache\n\n";
+    std::cout << std::left << std::setw( 22 ) << "mode" << std::right << std::setw( 10 ) << "wall" << std::setw( 11 )
+              << "blocked" << std::setw( 7 ) << "reads" << std::setw( 9 ) << "reads/s" << std::setw( 7 ) << "fills"
+              << std::setw( 8 ) << "frames" << std::setw( 9 ) << "cache" << std::setw( 8 ) << "prefch" << std::setw( 8 )
+              << "p.hits" << std::setw( 8 ) << "merged" << std::endl;
+
+    printResult( "synchronous", Simulation( options, 0, false ).run() );
+    for( unsigned int threads : {1u, 2u, 4u, 8u} )
+        printResult( std::to_string( threads ) + " threads", Simulation( options, threads, false ).run() );
+    for( unsigned int threads : {4u, 8u} )
+        printResult( std::to_string( threads ) + " threads+prefetch", Simulation( options, threads, true ).run() );
+    return 0;
+}
@@ -0,0 +1,315 @@
+//
+// tileLoaderTest - host tests of TileLoader and TileCache with CheckerBoardImages behind a reader that
+// can be held in the middle of a read: a read in progress does not block the calls the request
+// processing makes, repeated requests for a page are merged into one read, pages found in the host
+// cache are not read again, and the loader shuts down with reads queued and in progress.  No GPU is
+// needed.
+//
+
+#include "DemandTest.h"
+#include "TileCache.h"
+#include "TileLoader.h"
+#include <DemandLoading/CheckerBoardImage.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace demandLoading;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+const unsigned int TILE_WIDTH  = 64;  // 64x64 float4 texels, one 64 KiB sparse texture tile
+const unsigned int TILE_HEIGHT = 64;
+const size_t       TILE_SIZE   = TILE_WIDTH * TILE_HEIGHT * 16;
+
+/// Reads a CheckerBoardImage, optionally sleeping for a fixed latency per read or holding every
+/// read until the gate is opened.  A closed gate opens by itself after ten seconds so that a test
+/// that blocks fails instead of hanging.
+class GatedImageReader : public ImageReader
+{
+  public:
+    explicit GatedImageReader( bool gated, unsigned int latencyMilliseconds = 0 )
+        : m_image( 256, 256, 4 )
+        , m_gated( gated )
+        , m_latency( latencyMilliseconds )
+    {
+        m_image.open( nullptr );
+    }
+
+    bool open( TextureInfo* info ) override { return m_image.open( info ); }
+
+    void close() override {}
+
+    const TextureInfo& getInfo() override { return m_image.getInfo(); }
+
+    bool readTile( char* dest, unsigned int mipLevel, unsigned int tileX, unsigned int tileY, unsigned int tileWidth, unsigned int tileHeight ) override
+    {
+        ++m_numStarted;
+        {
+            std::unique_lock<std::mutex> lock( m_mutex );
+            m_started.notify_all();
+            m_opened.wait_for( lock, std::chrono::seconds( 10 ), [this] { return !m_gated; } );
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds( m_latency ) );
+        const bool ok = m_image.readTile( dest, mipLevel, tileX, tileY, tileWidth, tileHeight );
+        ++m_numFinished;
+        return ok;
+    }
+
+    bool readMipLevel( char* dest, unsigned int mipLevel, unsigned int expectedWidth, unsigned int expectedHeight ) override
+    {
+        return m_image.readMipLevel( dest, mipLevel, expectedWidth, expectedHeight );
+    }
+
+    /// Wait until at least the given number of reads started, at most ten seconds.
+    bool waitForStarted( unsigned int numReads )
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        return m_started.wait_for( lock, std::chrono::seconds( 10 ), [this, numReads] { return m_numStarted >= numReads; } );
+    }
+
+    void openGate()
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_gated = false;
+        m_opened.notify_all();
+    }
+
+    unsigned int getNumStarted() const { return m_numStarted; }
+    unsigned int getNumFinished() const { return m_numFinished; }
+
+  private:
+    CheckerBoardImage         m_image;
+    bool                      m_gated;
+    unsigned int              m_latency;
+    std::atomic<unsigned int> m_numStarted{0};
+    std::atomic<unsigned int> m_numFinished{0};
+    std::mutex                m_mutex;
+    std::condition_variable   m_started;
+    std::condition_variable   m_opened;
+};
+
+TileReadRequest tileRequest( const std::shared_ptr<GatedImageReader>& image, unsigned int pageId, unsigned int device = 0, bool prefetch = false )
+{
+    TileReadRequest request;
+    request.kind       = TileReadRequest::TILE;
+    request.pageId     = pageId;
+    request.image      = image;
+    request.prefetch   = prefetch;
+    request.mipLevel   = 0;
+    request.tileX      = pageId % 4;
+    request.tileY      = pageId / 4 % 4;
+    request.tileWidth  = TILE_WIDTH;
+    request.tileHeight = TILE_HEIGHT;
+    request.size       = TILE_SIZE;
+    if( !prefetch )
+        request.devices.set( device );
+    return request;
+}
+
+/// Take the finished reads until the given page is among them, at most ten seconds.
+bool waitForCompleted( TileLoader& loader, unsigned int pageId, std::vector<TileReadResult>& results )
+{
+    const auto deadline = Clock::now() + std::chrono::seconds( 10 );
+    while( Clock::now() < deadline )
+    {
+        std::vector<TileReadResult> taken;
+        loader.takeCompleted( taken );
+        for( TileReadResult& result : taken )
+            results.push_back( std::move( result ) );
+        for( const TileReadResult& result : results )
+        {
+            if( result.request.pageId == pageId )
+                return true;
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+    return false;
+}
+
+/// The order of DemandTextureManagerImpl::loadPage(): merge into a read under way, fill from the host
+/// cache, queue a read otherwise.  Returns the cached data, null if the page is being read.
+TileCache::Data loadPage( TileLoader& loader, TileCache& cache, const TileReadRequest& request )
+{
+    if( loader.isPending( request.pageId ) )
+    {
+        loader.enqueue( request );
+        return nullptr;
+    }
+    TileCache::Data data = cache.find( request.pageId );
+    if( !data )
+        loader.enqueue( request );
+    return data;
+}
+
+
+void testSlowReaderDoesNotBlock()
+{
+    TileCache                         cache( size_t( 16 ) << 20 );
+    TileLoader                        loader( 2, &cache );
+    std::shared_ptr<GatedImageReader> slow( new GatedImageReader( true ) );
+    std::shared_ptr<GatedImageReader> fast( new GatedImageReader( false ) );
+
+    DEMAND_CHECK( loader.enqueue( tileRequest( slow, 1 ) ) );
+    DEMAND_CHECK( slow->waitForStarted( 1 ) );
+
+    // While the slow read is held, what processRequests() and launchPrepare() call returns at once
+    const auto                  start = Clock::now();
+    std::vector<TileReadResult> results;
+    DEMAND_CHECK( loader.enqueue( tileRequest( slow, 2 ) ) );
+    DEMAND_CHECK( loader.isPending( 1 ) && loader.isPending( 2 ) );
+    DEMAND_CHECK( loader.getNumPending() == 2 );
+    loader.takeCompleted( results );
+    DEMAND_CHECK( results.empty() );
+    DEMAND_CHECK( !cache.find( 1 ) );
+    DEMAND_CHECK( std::chrono::duration<double>( Clock::now() - start ).count() < 1.0 );
+
+    // A read of another image proceeds on the other thread meanwhile
+    DEMAND_CHECK( loader.enqueue( tileRequest( fast, 10 ) ) );
+    DEMAND_CHECK( waitForCompleted( loader, 10, results ) );
+    DEMAND_CHECK( results.size() == 1 && results[0].ok && results[0].data && results[0].data->size() == TILE_SIZE );
+    DEMAND_CHECK( slow->getNumFinished() == 0 && loader.isPending( 1 ) );
+
+    // Once the reader lets go both slow reads finish
+    slow->openGate();
+    loader.waitForIdle();
+    loader.takeCompleted( results );
+    DEMAND_CHECK( results.size() == 2 && results[0].ok && results[1].ok );
+    DEMAND_CHECK( slow->getNumFinished() == 2 && loader.getNumPending() == 0 );
+}
+
+
+void testDuplicateRequestsMerged()
+{
+    TileCache                         cache( size_t( 16 ) << 20 );
+    TileLoader                        loader( 1, &cache );
+    std::shared_ptr<GatedImageReader> image( new GatedImageReader( true ) );
+
+    // Page 1 is being read, page 2 is queued behind it as a prefetch
+    DEMAND_CHECK( loader.enqueue( tileRequest( image, 1, 0 ) ) );
+    DEMAND_CHECK( image->waitForStarted( 1 ) );
+    DEMAND_CHECK( loader.enqueue( tileRequest( image, 2, 0, true ) ) );
+
+    // Requests from other devices and repeated ones join the reads instead of starting new ones; the
+    // demand request turns the prefetch into a demand read
+    DEMAND_CHECK( !loader.enqueue( tileRequest( image, 1, 2 ) ) );
+    DEMAND_CHECK( !loader.enqueue( tileRequest( image, 1, 2 ) ) );
+    DEMAND_CHECK( !loader.enqueue( tileRequest( image, 2, 1 ) ) );
+    DEMAND_CHECK( !loader.enqueue( tileRequest( image, 2, 0, true ) ) );
+    DEMAND_CHECK( loader.getNumPending() == 2 );
+
+    image->openGate();
+    loader.waitForIdle();
+    std::vector<TileReadResult> results;
+    loader.takeCompleted( results );
+    DEMAND_CHECK( image->getNumStarted() == 2 && loader.getNumReads() == 2 );
+    DEMAND_CHECK( results.size() == 2 );
+    for( const TileReadResult& result : results )
+    {
+        if( result.request.pageId == 1 )
+            DEMAND_CHECK( result.request.devices.to_ulong() == 0x5 );
+        else
+            DEMAND_CHECK( result.request.devices.to_ulong() == 0x2 && !result.request.prefetch );
+    }
+
+    // A finished read that was not taken yet still absorbs requests
+    DEMAND_CHECK( loader.enqueue( tileRequest( image, 3 ) ) );
+    loader.waitForIdle();
+    DEMAND_CHECK( !loader.enqueue( tileRequest( image, 3, 1 ) ) );
+    loader.waitForIdle();
+    loader.takeCompleted( results );
+    DEMAND_CHECK( image->getNumStarted() == 3 && results.size() == 1 && results[0].request.devices.to_ulong() == 0x3 );
+}
+
+
+void testCacheHitsSkipReader()
+{
+    TileCache                         cache( size_t( 16 ) << 20 );
+    TileLoader                        loader( 2, &cache );
+    std::shared_ptr<GatedImageReader> image( new GatedImageReader( false ) );
+
+    // A prefetch only fills the cache, the request for it later is served from there
+    DEMAND_CHECK( loader.enqueue( tileRequest( image, 5, 0, true ) ) );
+    loader.waitForIdle();
+    std::vector<TileReadResult> results;
+    loader.takeCompleted( results );
+    DEMAND_CHECK( results.empty() && cache.contains( 5 ) && loader.getNumPrefetchReads() == 1 );
+    const TileCache::Data prefetched = loadPage( loader, cache, tileRequest( image, 5 ) );
+    DEMAND_CHECK( prefetched && image->getNumStarted() == 1 && cache.getNumPrefetchHits() == 1 );
+
+    // A demand read of a tile that is evicted from the device and requested again
+    DEMAND_CHECK( !loadPage( loader, cache, tileRequest( image, 6 ) ) );
+    DEMAND_CHECK( waitForCompleted( loader, 6, results ) );
+    const TileCache::Data again = loadPage( loader, cache, tileRequest( image, 6 ) );
+    DEMAND_CHECK( again && again == results[0].data && image->getNumStarted() == 2 );
+    DEMAND_CHECK( loader.getNumPending() == 0 );
+
+    // The cached data is the tile
+    std::vector<char>       expected( TILE_SIZE );
+    const TileReadRequest   request = tileRequest( image, 6 );
+    CheckerBoardImage       reference( 256, 256, 4 );
+    reference.open( nullptr );
+    reference.readTile( expected.data(), request.mipLevel, request.tileX, request.tileY, TILE_WIDTH, TILE_HEIGHT );
+    DEMAND_CHECK( again && again->size() == TILE_SIZE && std::memcmp( again->data(), expected.data(), TILE_SIZE ) == 0 );
+
+    // Without a cache every request reads
+    TileCache  noCache;
+    TileLoader uncached( 1, &noCache );
+    DEMAND_CHECK( !loadPage( uncached, noCache, tileRequest( image, 7 ) ) );
+    uncached.waitForIdle();
+    uncached.takeCompleted( results );
+    DEMAND_CHECK( !loadPage( uncached, noCache, tileRequest( image, 7 ) ) );
+    uncached.waitForIdle();
+    DEMAND_CHECK( image->getNumStarted() == 4 );
+}
+
+
+void testShutdownWithReadsPending()
+{
+    // Forty queued reads of 20 ms on two threads: the destructor waits for the two in progress only
+    std::shared_ptr<GatedImageReader> slow( new GatedImageReader( false, 20 ) );
+    TileCache                         cache( size_t( 16 ) << 20 );
+    std::unique_ptr<TileLoader>       loader( new TileLoader( 2, &cache ) );
+    for( unsigned int pageId = 0; pageId < 40; ++pageId )
+        loader->enqueue( tileRequest( slow, pageId ) );
+    DEMAND_CHECK( slow->waitForStarted( 2 ) );
+    const auto start = Clock::now();
+    loader.reset();
+    DEMAND_CHECK( std::chrono::duration<double>( Clock::now() - start ).count() < 0.4 );
+    DEMAND_CHECK( slow->getNumStarted() < 40 && slow->getNumFinished() == slow->getNumStarted() );
+
+    // A read held by the reader is finished before the threads are joined, the queued one dropped
+    std::shared_ptr<GatedImageReader> held( new GatedImageReader( true ) );
+    loader.reset( new TileLoader( 1, &cache ) );
+    loader->enqueue( tileRequest( held, 100 ) );
+    loader->enqueue( tileRequest( held, 101 ) );
+    DEMAND_CHECK( held->waitForStarted( 1 ) );
+    std::thread opener( [held]() {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+        held->openGate();
+    } );
+    loader.reset();
+    opener.join();
+    DEMAND_CHECK( held->getNumStarted() == 1 && held->getNumFinished() == 1 );
+    DEMAND_CHECK( cache.contains( 100 ) && !cache.contains( 101 ) );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testSlowReaderDoesNotBlock();
+    testDuplicateRequestsMerged();
+    testCacheHitsSkipReader();
+    testShutdownWithReadsPending();
+    return demandTestResult( "tileLoaderTest" );
+}
@@ -31,9 +31,12 @@
 #include "Exception.h"
 #include "Math.h"
 
+#include <cstdint>
+#include <iterator>
+
 namespace demandLoading {
 
-TilePool::TilePool( unsigned int deviceIndex )
+CudaTilePoolBackend::CudaTilePoolBackend( unsigned int deviceIndex )
     : m_deviceIndex( deviceIndex )
 {
     // Use the recommended allocation granularity as the arena size.  Typically this gives 32 tiles per arena.
@@ -42,30 +45,96 @@ TilePool::TilePool( unsigned int deviceIndex )
     prop.location         = {CU_MEM_LOCATION_TYPE_DEVICE, static_cast<int>( m_deviceIndex )};
     prop.allocFlags.usage = CU_MEM_CREATE_USAGE_TILE_POOL;
     DEMAND_CUDA_CHECK( cuMemGetAllocationGranularity( &m_arenaSize, &prop, CU_MEM_ALLOC_GRANULARITY_RECOMMENDED ) );
+}
 
-    DEMAND_ASSERT( m_arenaSize >= TILE_SIZE );
+CUmemGenericAllocationHandle CudaTilePoolBackend::createArena()
+{
+    // Set current device.
+    DEMAND_CUDA_CHECK( cudaSetDevice( m_deviceIndex ) );
+
+    CUmemAllocationProp prop{};
+    prop.type             = CU_MEM_ALLOCATION_TYPE_PINNED;
+    prop.location         = {CU_MEM_LOCATION_TYPE_DEVICE, static_cast<int>( m_deviceIndex )};
+    prop.allocFlags.usage = CU_MEM_CREATE_USAGE_TILE_POOL;
+    CUmemGenericAllocationHandle arena;
+    DEMAND_CUDA_CHECK( cuMemCreate( &arena, m_arenaSize, &prop, 0 ) );
+    return arena;
+}
+
+void CudaTilePoolBackend::releaseArena( CUmemGenericAllocationHandle arena )
+{
+    DEMAND_CUDA_CHECK( cuMemRelease( arena ) );
+}
+
+TilePool::TilePool( unsigned int deviceIndex, size_t maxBytes )
+    : TilePool( std::unique_ptr<TilePoolBackend>( new CudaTilePoolBackend( deviceIndex ) ), maxBytes )
+{
+}
+
+TilePool::TilePool( std::unique_ptr<TilePoolBackend> backend, size_t maxBytes )
+    : m_backend( std::move( backend ) )
+    , m_maxBytes( maxBytes )
+{
+    m_arenaSize = m_backend->getArenaSize();
+    DEMAND_ASSERT( m_arenaSize >= TILE_SIZE && m_arenaSize % TILE_SIZE == 0 );
+    m_tilesPerArena = m_arenaSize / TILE_SIZE;
 }
 
 TilePool::~TilePool()
 {
+    // A moved-from pool has no arenas.
     for( CUmemGenericAllocationHandle arena : m_arenas )
     {
-        DEMAND_CUDA_CHECK( cuMemRelease( arena ) );
+        m_backend->releaseArena( arena );
     }
 }
 
+bool TilePool::canAllocate( size_t numBytes ) const
+{
+    // A block never spans arenas.
+    const size_t numTiles = idivCeil( numBytes, TILE_SIZE );
+    if( numTiles > m_tilesPerArena )
+        return false;
+    if( findFreeTiles( numTiles ) != SIZE_MAX )
+        return true;
+    if( !m_arenas.empty() && m_offset + numTiles * TILE_SIZE <= m_arenaSize )
+        return true;
+    return m_maxBytes == 0 || getAllocatedBytes() + m_arenaSize <= m_maxBytes;
+}
+
 void TilePool::allocate( size_t numBytes, CUmemGenericAllocationHandle* handle, size_t* offset )
 {
-    // Set current device.
-    DEMAND_CUDA_CHECK( cudaSetDevice( m_deviceIndex ) );
+    DEMAND_ASSERT_MSG( canAllocate( numBytes ), "Tile pool memory limit exceeded" );
 
     // Allocate an integral number of tiles.
-    numBytes = idivCeil( numBytes, TILE_SIZE ) * TILE_SIZE;
+    const size_t numTiles = idivCeil( numBytes, TILE_SIZE );
+    numBytes              = numTiles * TILE_SIZE;
+    m_numUsedTiles += numTiles;
 
-    // Create a new arena if necessary.
+    // Reuse freed tiles if possible.
+    const size_t freeTile = findFreeTiles( numTiles );
+    if( freeTile != SIZE_MAX )
+    {
+        auto first = m_freeTiles.find( freeTile );
+        m_freeTiles.erase( first, std::next( first, numTiles ) );
+        *handle = m_arenas[freeTile / m_tilesPerArena];
+        *offset = ( freeTile % m_tilesPerArena ) * TILE_SIZE;
+        return;
+    }
+
+    // Create a new arena if necessary.  The tiles left over in the current arena go to the free list.
     if( m_arenas.empty() || m_offset + numBytes > m_arenaSize )
     {
-        m_arenas.push_back( createArena() );
+        if( !m_arenas.empty() )
+        {
+            const size_t arenaStart = ( m_arenas.size() - 1 ) * m_tilesPerArena;
+            for( size_t tileOffset = m_offset; tileOffset < m_arenaSize; tileOffset += TILE_SIZE )
+                m_freeTiles.insert( arenaStart + tileOffset / TILE_SIZE );
+        }
+
+        const CUmemGenericAllocationHandle arena = m_backend->createArena();
+        m_arenaIndices[arena]                    = static_cast<unsigned int>( m_arenas.size() );
+        m_arenas.push_back( arena );
         m_offset = 0;
     }
 
@@ -77,15 +146,54 @@ void TilePool::allocate( size_t numBytes, CUmemGenericAllocationHandle* handle,
     m_offset += numBytes;
 }
 
-CUmemGenericAllocationHandle TilePool::createArena() const
+// The whole range is checked before any tile goes to the free list, so a bad free leaves the pool
+// unchanged.  Tiles of the last arena past the current offset were never allocated.
+void TilePool::free( CUmemGenericAllocationHandle handle, size_t offset, size_t numBytes )
 {
-    CUmemAllocationProp prop{};
-    prop.type             = CU_MEM_ALLOCATION_TYPE_PINNED;
-    prop.location         = {CU_MEM_LOCATION_TYPE_DEVICE, static_cast<int>( m_deviceIndex )};
-    prop.allocFlags.usage = CU_MEM_CREATE_USAGE_TILE_POOL;
-    CUmemGenericAllocationHandle arena;
-    DEMAND_CUDA_CHECK( cuMemCreate( &arena, m_arenaSize, &prop, 0 ) );
-    return arena;
+    auto it = m_arenaIndices.find( handle );
+    DEMAND_ASSERT_MSG( it != m_arenaIndices.end() && offset % TILE_SIZE == 0, "Invalid tile pool allocation" );
+
+    const size_t numTiles    = idivCeil( numBytes, TILE_SIZE );
+    const size_t firstTile   = it->second * m_tilesPerArena + offset / TILE_SIZE;
+    const bool   isLastArena = it->second + 1 == m_arenas.size();
+    DEMAND_ASSERT_MSG( numTiles > 0 && offset + numTiles * TILE_SIZE <= ( isLastArena ? m_offset : m_arenaSize )
+                           && numTiles <= m_numUsedTiles,
+                       "Invalid tile pool allocation" );
+    for( size_t tile = firstTile; tile < firstTile + numTiles; ++tile )
+    {
+        DEMAND_ASSERT_MSG( m_freeTiles.count( tile ) == 0, "Tile freed twice" );
+    }
+
+    for( size_t tile = firstTile; tile < firstTile + numTiles; ++tile )
+    {
+        m_freeTiles.insert( tile );
+    }
+    m_numUsedTiles -= numTiles;
+}
+
+size_t TilePool::findFreeTiles( size_t numTiles ) const
+{
+    if( numTiles == 1 )
+        return m_freeTiles.empty() ? SIZE_MAX : *m_freeTiles.begin();
+
+    // Look for a run of consecutive tiles that does not cross an arena boundary.
+    size_t runStart  = SIZE_MAX;
+    size_t runLength = 0;
+    for( size_t tile : m_freeTiles )
+    {
+        if( runLength > 0 && tile == runStart + runLength && tile % m_tilesPerArena != 0 )
+        {
+            ++runLength;
+        }
+        else
+        {
+            runStart  = tile;
+            runLength = 1;
+        }
+        if( runLength == numTiles )
+            return runStart;
+    }
+    return SIZE_MAX;
 }
 
 }  // namespace demandLoading
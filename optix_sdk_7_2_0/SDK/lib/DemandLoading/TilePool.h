@@ -29,32 +29,101 @@
 
 #include <cuda.h>
 
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 namespace demandLoading {
 
+/// Source of the arenas that back a TilePool.  The default backend creates physical allocations on
+/// a CUDA device.  Other backends let the allocation policy run on the host without a device.
+class TilePoolBackend
+{
+  public:
+    virtual ~TilePoolBackend() = default;
+
+    /// Get the size of an arena in bytes, a multiple of TilePool::TILE_SIZE.
+    virtual size_t getArenaSize() const = 0;
+
+    /// Create an arena, returning its memory handle.
+    virtual CUmemGenericAllocationHandle createArena() = 0;
+
+    /// Release an arena created by createArena().
+    virtual void releaseArena( CUmemGenericAllocationHandle arena ) = 0;
+};
+
+/// Backend that creates tile pool arenas on the specified CUDA device.
+class CudaTilePoolBackend : public TilePoolBackend
+{
+  public:
+    explicit CudaTilePoolBackend( unsigned int deviceIndex );
+
+    size_t                       getArenaSize() const override { return m_arenaSize; }
+    CUmemGenericAllocationHandle createArena() override;
+    void                         releaseArena( CUmemGenericAllocationHandle arena ) override;
+
+  private:
+    unsigned int m_deviceIndex;
+    size_t       m_arenaSize = 0;
+};
+
+/// TilePool allocates tile backing storage in arenas of device memory, up to a fixed budget.
+/// Freed tiles go to a free list and are reused before new arenas are created, so a pool that is
+/// kept within its budget by evicting tiles stops growing.  Blocks of several tiles (mip tails)
+/// need consecutive free tiles in one arena.
 class TilePool
 {
   public:
-    /// Construct tile pool for the specified device.
-    explicit TilePool( unsigned int deviceIndex );
+    /// Construct tile pool for the specified device.  The pool allocates at most maxBytes of device
+    /// memory (rounded down to whole arenas), zero means no limit.
+    explicit TilePool( unsigned int deviceIndex, size_t maxBytes = 0 );
+
+    /// Construct tile pool that takes its arenas from the given backend.
+    explicit TilePool( std::unique_ptr<TilePoolBackend> backend, size_t maxBytes = 0 );
 
     /// Destroy the tile pool, reclaiming its resources.
     ~TilePool();
 
+    TilePool( TilePool&& ) = default;
+    TilePool& operator=( TilePool&& ) = default;
+
     /// Allocate memory on the specified device, returning a device memory handle and offset.
     void allocate( size_t numBytes, CUmemGenericAllocationHandle* handle, size_t* offset );
 
+    /// Return an allocation to the free list.  The caller has unmapped it.  Throws, leaving the pool
+    /// unchanged, if any of its tiles was not allocated from this pool or is free already.
+    void free( CUmemGenericAllocationHandle handle, size_t offset, size_t numBytes );
+
+    /// Check whether an allocation of the given size fits in the memory limit.
+    bool canAllocate( size_t numBytes ) const;
+
+    /// Get the device memory allocated by the pool so far.
+    size_t getAllocatedBytes() const { return m_arenas.size() * m_arenaSize; }
+
+    /// Get the memory of the tiles that are currently allocated.
+    size_t getUsedBytes() const { return m_numUsedTiles * TILE_SIZE; }
+
+    /// Get the memory of the tiles on the free list.
+    size_t getFreeBytes() const { return m_freeTiles.size() * TILE_SIZE; }
+
     /// The tile size is fixed.
     static const unsigned int TILE_SIZE = 65536;
 
   private:
-    unsigned int                              m_deviceIndex;
-    std::vector<CUmemGenericAllocationHandle> m_arenas;
-    size_t                                    m_arenaSize = 0;
-    size_t                                    m_offset    = 0;
+    std::unique_ptr<TilePoolBackend>                               m_backend;
+    std::vector<CUmemGenericAllocationHandle>                      m_arenas;
+    std::unordered_map<CUmemGenericAllocationHandle, unsigned int> m_arenaIndices;  // arena handle to index in m_arenas
+    std::set<size_t>                                               m_freeTiles;     // arena index * tiles per arena + tile
+    size_t                                                         m_arenaSize     = 0;
+    size_t                                                         m_tilesPerArena = 0;
+    size_t                                                         m_offset        = 0;  // in the last arena
+    size_t                                                         m_maxBytes      = 0;
+    size_t                                                         m_numUsedTiles  = 0;
 
-    CUmemGenericAllocationHandle createArena() const;
+    // Find numTiles consecutive free tiles in one arena, returning the first or SIZE_MAX.
+    size_t findFreeTiles( size_t numTiles ) const;
 };
 
 }  // namespace demandLoading
@@ -0,0 +1,417 @@
+//
+// tilePoolTest - host tests of TilePool and ResidentTiles with arenas of four tiles from a mock
+// backend: freed tiles are reused before new arenas are created, multi-tile blocks never cross an
+// arena, bad frees throw and leave the pool unchanged, stale tiles are evicted least recently used
+// first up to the invalidated page limit, and each device evicts its own tiles.  No GPU is needed.
+//
+
+#include "DemandTest.h"
+#include "Exception.h"
+#include "ResidentTiles.h"
+#include "TilePool.h"
+
+#include <optixPaging/optixPaging.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+using namespace demandLoading;
+
+namespace {
+
+const size_t TILE_SIZE       = TilePool::TILE_SIZE;
+const size_t TILES_PER_ARENA = 4;
+const size_t ARENA_SIZE      = TILES_PER_ARENA * TILE_SIZE;
+
+struct ArenaLog
+{
+    std::vector<CUmemGenericAllocationHandle> created;
+    std::vector<CUmemGenericAllocationHandle> released;
+};
+
+// Arenas are numbered handles, nothing is allocated
+class MockTilePoolBackend : public TilePoolBackend
+{
+  public:
+    explicit MockTilePoolBackend( ArenaLog& log, CUmemGenericAllocationHandle firstHandle = 100 )
+        : m_log( log )
+        , m_nextHandle( firstHandle )
+    {
+    }
+
+    size_t getArenaSize() const override { return ARENA_SIZE; }
+
+    CUmemGenericAllocationHandle createArena() override
+    {
+        m_log.created.push_back( m_nextHandle );
+        return m_nextHandle++;
+    }
+
+    void releaseArena( CUmemGenericAllocationHandle arena ) override { m_log.released.push_back( arena ); }
+
+  private:
+    ArenaLog&                    m_log;
+    CUmemGenericAllocationHandle m_nextHandle;
+};
+
+std::unique_ptr<TilePoolBackend> mockBackend( ArenaLog& log, CUmemGenericAllocationHandle firstHandle = 100 )
+{
+    return std::unique_ptr<TilePoolBackend>( new MockTilePoolBackend( log, firstHandle ) );
+}
+
+struct Allocation
+{
+    CUmemGenericAllocationHandle handle;
+    size_t                       offset;
+};
+
+Allocation allocate( TilePool& pool, size_t numTiles )
+{
+    Allocation allocation{};
+    pool.allocate( numTiles * TILE_SIZE, &allocation.handle, &allocation.offset );
+    return allocation;
+}
+
+bool isAt( const Allocation& allocation, CUmemGenericAllocationHandle handle, size_t tile )
+{
+    return allocation.handle == handle && allocation.offset == tile * TILE_SIZE;
+}
+
+
+void testFreeListReuse()
+{
+    ArenaLog log;
+    TilePool pool( mockBackend( log ) );
+    const Allocation a = allocate( pool, 1 );
+    const Allocation b = allocate( pool, 1 );
+    const Allocation c = allocate( pool, 1 );
+    DEMAND_CHECK( isAt( a, 100, 0 ) && isAt( b, 100, 1 ) && isAt( c, 100, 2 ) );
+    DEMAND_CHECK( pool.getUsedBytes() == 3 * TILE_SIZE && pool.getAllocatedBytes() == ARENA_SIZE );
+
+    // A freed tile is handed out again before the rest of the arena
+    pool.free( b.handle, b.offset, TILE_SIZE );
+    DEMAND_CHECK( pool.getFreeBytes() == TILE_SIZE && pool.getUsedBytes() == 2 * TILE_SIZE );
+    DEMAND_CHECK( isAt( allocate( pool, 1 ), 100, 1 ) );
+    DEMAND_CHECK( pool.getFreeBytes() == 0 );
+
+    // Then the rest of the arena, then a new arena
+    DEMAND_CHECK( isAt( allocate( pool, 1 ), 100, 3 ) );
+    DEMAND_CHECK( log.created.size() == 1 );
+    DEMAND_CHECK( isAt( allocate( pool, 1 ), 101, 0 ) );
+    DEMAND_CHECK( log.created.size() == 2 && pool.getAllocatedBytes() == 2 * ARENA_SIZE );
+
+    // Freed tiles are reused in address order, whatever the order they were freed in
+    pool.free( 100, 3 * TILE_SIZE, TILE_SIZE );
+    pool.free( 100, 0, TILE_SIZE );
+    DEMAND_CHECK( isAt( allocate( pool, 1 ), 100, 0 ) );
+    DEMAND_CHECK( isAt( allocate( pool, 1 ), 100, 3 ) );
+    DEMAND_CHECK( log.created.size() == 2 );
+}
+
+
+void testRunsDoNotCrossArenas()
+{
+    // Two arenas at most
+    ArenaLog log;
+    TilePool pool( mockBackend( log ), 2 * ARENA_SIZE );
+    for( size_t i = 0; i < 2 * TILES_PER_ARENA; ++i )
+        allocate( pool, 1 );
+    DEMAND_CHECK( !pool.canAllocate( TILE_SIZE ) );
+
+    // The last two tiles of the first arena and the first two of the second are consecutive tile
+    // numbers, but not consecutive memory
+    pool.free( 100, 2 * TILE_SIZE, TILE_SIZE );
+    pool.free( 100, 3 * TILE_SIZE, TILE_SIZE );
+    pool.free( 101, 0, TILE_SIZE );
+    pool.free( 101, 1 * TILE_SIZE, TILE_SIZE );
+    DEMAND_CHECK( pool.getFreeBytes() == 4 * TILE_SIZE );
+    DEMAND_CHECK( !pool.canAllocate( 3 * TILE_SIZE ) );
+    DEMAND_CHECK_THROWS( allocate( pool, 3 ), Exception );
+    DEMAND_CHECK( pool.getFreeBytes() == 4 * TILE_SIZE );
+
+    // A block that is not a whole number of tiles takes the next whole number
+    DEMAND_CHECK( pool.canAllocate( 2 * TILE_SIZE - 1 ) );
+    Allocation block{};
+    pool.allocate( 2 * TILE_SIZE - 1, &block.handle, &block.offset );
+    DEMAND_CHECK( isAt( block, 100, 2 ) );
+    DEMAND_CHECK( isAt( allocate( pool, 2 ), 101, 0 ) );
+    DEMAND_CHECK( pool.getFreeBytes() == 0 && log.created.size() == 2 );
+}
+
+
+void testLeftoverTiles()
+{
+    ArenaLog log;
+    TilePool pool( mockBackend( log ) );
+    DEMAND_CHECK( isAt( allocate( pool, 1 ), 100, 0 ) );
+    DEMAND_CHECK( isAt( allocate( pool, 2 ), 100, 1 ) );
+
+    // A block that does not fit in the rest of the arena starts a new one, and the tile left over
+    // goes to the free list
+    DEMAND_CHECK( isAt( allocate( pool, 2 ), 101, 0 ) );
+    DEMAND_CHECK( pool.getFreeBytes() == TILE_SIZE && pool.getUsedBytes() == 5 * TILE_SIZE );
+    DEMAND_CHECK( isAt( allocate( pool, 1 ), 100, 3 ) );
+    DEMAND_CHECK( isAt( allocate( pool, 1 ), 101, 2 ) );
+
+    // The handed over tile is freed like any other
+    pool.free( 100, 3 * TILE_SIZE, TILE_SIZE );
+    DEMAND_CHECK( pool.getFreeBytes() == TILE_SIZE );
+    DEMAND_CHECK( log.created.size() == 2 );
+}
+
+
+void testMemoryLimit()
+{
+    // The limit is rounded down to whole arenas, and no block is larger than an arena
+    ArenaLog log;
+    TilePool pool( mockBackend( log ), ARENA_SIZE + ARENA_SIZE / 2 );
+    DEMAND_CHECK( pool.canAllocate( ARENA_SIZE ) && !pool.canAllocate( ARENA_SIZE + TILE_SIZE ) );
+    DEMAND_CHECK_THROWS( allocate( pool, TILES_PER_ARENA + 1 ), Exception );
+    for( size_t i = 0; i < TILES_PER_ARENA; ++i )
+        allocate( pool, 1 );
+    DEMAND_CHECK( !pool.canAllocate( TILE_SIZE ) );
+    DEMAND_CHECK_THROWS( allocate( pool, 1 ), Exception );
+    DEMAND_CHECK( pool.getAllocatedBytes() == ARENA_SIZE && pool.getUsedBytes() == ARENA_SIZE && log.created.size() == 1 );
+
+    pool.free( 100, TILE_SIZE, TILE_SIZE );
+    DEMAND_CHECK( pool.canAllocate( TILE_SIZE ) && !pool.canAllocate( 2 * TILE_SIZE ) );
+
+    // Zero means no limit
+    ArenaLog unlimitedLog;
+    TilePool unlimited( mockBackend( unlimitedLog ) );
+    for( size_t i = 0; i < 10 * TILES_PER_ARENA; ++i )
+        allocate( unlimited, 1 );
+    DEMAND_CHECK( unlimited.canAllocate( ARENA_SIZE ) && unlimitedLog.created.size() == 10 );
+    DEMAND_CHECK( !unlimited.canAllocate( ARENA_SIZE + TILE_SIZE ) );
+}
+
+
+void testBadFrees()
+{
+    ArenaLog log;
+    TilePool pool( mockBackend( log ) );
+    allocate( pool, 4 );
+    allocate( pool, 2 );  // second arena, tiles 2 and 3 never allocated
+    pool.free( 100, TILE_SIZE, TILE_SIZE );
+
+    const size_t usedBytes = pool.getUsedBytes();
+    const size_t freeBytes = pool.getFreeBytes();
+    auto         unchanged = [&]() { return pool.getUsedBytes() == usedBytes && pool.getFreeBytes() == freeBytes; };
+
+    // Freed twice, alone or as part of a block
+    DEMAND_CHECK_THROWS( pool.free( 100, TILE_SIZE, TILE_SIZE ), Exception );
+    DEMAND_CHECK( unchanged() );
+    DEMAND_CHECK_THROWS( pool.free( 100, 0, 2 * TILE_SIZE ), Exception );
+    DEMAND_CHECK( unchanged() );
+
+    // Not from this pool
+    DEMAND_CHECK_THROWS( pool.free( 999, 0, TILE_SIZE ), Exception );
+    DEMAND_CHECK( unchanged() );
+
+    // Not at a tile boundary
+    DEMAND_CHECK_THROWS( pool.free( 100, TILE_SIZE / 2, TILE_SIZE ), Exception );
+    DEMAND_CHECK( unchanged() );
+
+    // Past the end of the arena
+    DEMAND_CHECK_THROWS( pool.free( 100, 3 * TILE_SIZE, 2 * TILE_SIZE ), Exception );
+    DEMAND_CHECK( unchanged() );
+
+    // Never allocated, in the part of the current arena that was not handed out yet
+    DEMAND_CHECK_THROWS( pool.free( 101, 2 * TILE_SIZE, TILE_SIZE ), Exception );
+    DEMAND_CHECK_THROWS( pool.free( 101, TILE_SIZE, 2 * TILE_SIZE ), Exception );
+    DEMAND_CHECK( unchanged() );
+
+    // A pool from another backend hands out the same handles, but none is known to this pool
+    ArenaLog otherLog;
+    TilePool other( mockBackend( otherLog, 200 ) );
+    const Allocation foreign = allocate( other, 1 );
+    DEMAND_CHECK_THROWS( pool.free( foreign.handle, foreign.offset, TILE_SIZE ), Exception );
+    DEMAND_CHECK( unchanged() );
+
+    // The pool still works
+    DEMAND_CHECK( isAt( allocate( pool, 1 ), 100, 1 ) );
+    pool.free( 101, 0, 2 * TILE_SIZE );
+    DEMAND_CHECK( pool.getFreeBytes() == 2 * TILE_SIZE );
+}
+
+
+void testArenasReleased()
+{
+    ArenaLog log;
+    {
+        TilePool pool( mockBackend( log ) );
+        allocate( pool, 4 );
+        allocate( pool, 1 );
+        TilePool moved( std::move( pool ) );
+        DEMAND_CHECK( moved.getAllocatedBytes() == 2 * ARENA_SIZE );
+    }
+    DEMAND_CHECK( log.released == log.created && log.created.size() == 2 );
+}
+
+
+// Fill one tile of the given page on a device
+void fill( ResidentTiles& tiles, TilePool& pool, unsigned int pageId )
+{
+    ResidentTiles::Tile tile{};
+    pool.allocate( TILE_SIZE, &tile.handle, &tile.offset );
+    tile.textureId = pageId;
+    tiles.insert( pageId, tile );
+}
+
+std::vector<PageMapping> stale( const std::vector<unsigned int>& pageIds )
+{
+    std::vector<PageMapping> pages;
+    for( unsigned int pageId : pageIds )
+        pages.push_back( PageMapping{pageId, 1} );
+    return pages;
+}
+
+// Unmap function that records the evicted tiles
+struct Unmapped
+{
+    std::vector<unsigned int> pages;
+    void operator()( const ResidentTiles::Tile& tile ) { pages.push_back( tile.textureId ); }
+};
+
+
+void testEvictionOrder()
+{
+    ArenaLog      log;
+    TilePool      pool( mockBackend( log ), ARENA_SIZE );
+    ResidentTiles tiles;
+    for( unsigned int pageId = 10; pageId < 14; ++pageId )
+        fill( tiles, pool, pageId );
+    DEMAND_CHECK( tiles.size() == 4 && tiles.contains( 12 ) && !tiles.contains( 14 ) );
+
+    // Pull 1 finds every tile referenced, pull 2 all but 11, pull 3 none.  Stale pages that are not
+    // tiles, e.g. mip tails, are not candidates.
+    tiles.updateEvictionCandidates( stale( {} ), false );
+    DEMAND_CHECK( tiles.getEvictionCandidates().empty() );
+    tiles.updateEvictionCandidates( stale( {11, 99} ), false );
+    DEMAND_CHECK( tiles.getEvictionCandidates() == std::vector<unsigned int>( {11} ) );
+    tiles.updateEvictionCandidates( stale( {10, 11, 12, 13, 99} ), false );
+    DEMAND_CHECK( tiles.getEvictionCandidates() == std::vector<unsigned int>( {13, 12, 10, 11} ) );
+
+    // Nothing is evicted while the allocation fits
+    std::vector<unsigned int> invalidated;
+    Unmapped                  unmapped;
+    DEMAND_CHECK( !pool.canAllocate( TILE_SIZE ) );
+    DEMAND_CHECK( tiles.makeRoom( pool, TILE_SIZE, 16, invalidated, std::ref( unmapped ) ) );
+    DEMAND_CHECK( unmapped.pages == std::vector<unsigned int>( {11} ) && invalidated == unmapped.pages );
+    DEMAND_CHECK( !tiles.contains( 11 ) && tiles.size() == 3 && pool.getFreeBytes() == TILE_SIZE );
+    DEMAND_CHECK( tiles.makeRoom( pool, TILE_SIZE, 16, invalidated, std::ref( unmapped ) ) );
+    DEMAND_CHECK( invalidated.size() == 1 );
+
+    // A block of two tiles needs the neighbor of the free tile too
+    DEMAND_CHECK( tiles.makeRoom( pool, 2 * TILE_SIZE, 16, invalidated, std::ref( unmapped ) ) );
+    DEMAND_CHECK( invalidated == std::vector<unsigned int>( {11, 10} ) && unmapped.pages == invalidated );
+    DEMAND_CHECK( pool.canAllocate( 2 * TILE_SIZE ) && pool.getUsedBytes() == 2 * TILE_SIZE );
+
+    // The candidates run out, 13 is referenced again
+    tiles.updateEvictionCandidates( stale( {12} ), false );
+    DEMAND_CHECK( !tiles.makeRoom( pool, ARENA_SIZE, 16, invalidated, std::ref( unmapped ) ) );
+    DEMAND_CHECK( tiles.size() == 1 && tiles.contains( 13 ) && tiles.getEvictionCandidates().empty() );
+    DEMAND_CHECK( invalidated == std::vector<unsigned int>( {11, 10, 12} ) );
+}
+
+
+void testTruncatedStaleList()
+{
+    ArenaLog      log;
+    TilePool      pool( mockBackend( log ) );
+    ResidentTiles tiles;
+    fill( tiles, pool, 10 );
+    fill( tiles, pool, 11 );
+
+    // 11 was last referenced before pull 1, 10 before pull 2
+    tiles.updateEvictionCandidates( stale( {} ), false );
+    tiles.updateEvictionCandidates( stale( {11} ), false );
+    DEMAND_CHECK( tiles.getEvictionCandidates() == std::vector<unsigned int>( {11} ) );
+
+    // A truncated list says nothing about 11, which stays older than 10
+    tiles.updateEvictionCandidates( stale( {10} ), true );
+    DEMAND_CHECK( tiles.getEvictionCandidates() == std::vector<unsigned int>( {10} ) );
+    tiles.updateEvictionCandidates( stale( {10, 11} ), false );
+    DEMAND_CHECK( tiles.getEvictionCandidates() == std::vector<unsigned int>( {10, 11} ) );
+
+    // A tile filled after a pull counts as referenced by it, so it is younger than both
+    fill( tiles, pool, 12 );
+    tiles.updateEvictionCandidates( stale( {10, 11, 12} ), false );
+    DEMAND_CHECK( tiles.getEvictionCandidates() == std::vector<unsigned int>( {12, 10, 11} ) );
+}
+
+
+void testInvalidatedPageLimit()
+{
+    ArenaLog      log;
+    TilePool      pool( mockBackend( log ), ARENA_SIZE );
+    ResidentTiles tiles;
+    for( unsigned int pageId = 10; pageId < 14; ++pageId )
+        fill( tiles, pool, pageId );
+    tiles.updateEvictionCandidates( stale( {10, 11, 12, 13} ), false );
+
+    // Two pages invalidated by an earlier fill, room for one more before the next push
+    std::vector<unsigned int> invalidated = {1, 2};
+    Unmapped                  unmapped;
+    DEMAND_CHECK( !tiles.makeRoom( pool, 2 * TILE_SIZE, 3, invalidated, std::ref( unmapped ) ) );
+    DEMAND_CHECK( unmapped.pages == std::vector<unsigned int>( {10} ) && invalidated.size() == 3 );
+    DEMAND_CHECK( tiles.size() == 3 && tiles.getEvictionCandidates().size() == 3 );
+
+    // The tile already freed still serves a single tile allocation, nothing else is evicted
+    DEMAND_CHECK( tiles.makeRoom( pool, TILE_SIZE, 3, invalidated, std::ref( unmapped ) ) );
+    allocate( pool, 1 );
+    DEMAND_CHECK( !tiles.makeRoom( pool, TILE_SIZE, 3, invalidated, std::ref( unmapped ) ) );
+    DEMAND_CHECK( unmapped.pages.size() == 1 && tiles.size() == 3 );
+
+    // After the push the list is empty again
+    invalidated.clear();
+    DEMAND_CHECK( tiles.makeRoom( pool, TILE_SIZE, 3, invalidated, std::ref( unmapped ) ) );
+    DEMAND_CHECK( invalidated == std::vector<unsigned int>( {11} ) );
+}
+
+
+void testDevicesEvictSeparately()
+{
+    // The same page is resident on two devices, each with its own pool
+    ArenaLog      log0, log1;
+    TilePool      pool0( mockBackend( log0 ), ARENA_SIZE );
+    TilePool      pool1( mockBackend( log1 ), ARENA_SIZE );
+    ResidentTiles tiles0, tiles1;
+    for( unsigned int pageId = 10; pageId < 14; ++pageId )
+    {
+        fill( tiles0, pool0, pageId );
+        fill( tiles1, pool1, pageId );
+    }
+
+    // Only device 0 found 10 stale and needs room
+    tiles0.updateEvictionCandidates( stale( {10} ), false );
+    tiles1.updateEvictionCandidates( stale( {} ), false );
+    std::vector<unsigned int> invalidated0, invalidated1;
+    Unmapped                  unmapped;
+    DEMAND_CHECK( tiles0.makeRoom( pool0, TILE_SIZE, 16, invalidated0, std::ref( unmapped ) ) );
+    DEMAND_CHECK( !tiles0.contains( 10 ) && tiles1.contains( 10 ) );
+    DEMAND_CHECK( pool0.getFreeBytes() == TILE_SIZE && pool1.getFreeBytes() == 0 );
+
+    // Device 1 cannot evict a tile it still references
+    DEMAND_CHECK( !tiles1.makeRoom( pool1, TILE_SIZE, 16, invalidated1, std::ref( unmapped ) ) );
+    DEMAND_CHECK( tiles1.size() == 4 && invalidated1.empty() );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testFreeListReuse();
+    testRunsDoNotCrossArenas();
+    testLeftoverTiles();
+    testMemoryLimit();
+    testBadFrees();
+    testArenasReleased();
+    testEvictionOrder();
+    testTruncatedStaleList();
+    testInvalidatedPageLimit();
+    testDevicesEvictSeparately();
+    return demandTestResult( "tilePoolTest" );
+}
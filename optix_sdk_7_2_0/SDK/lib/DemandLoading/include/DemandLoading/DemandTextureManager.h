@@ -28,6 +28,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <vector>
 
@@ -44,8 +45,31 @@ struct DemandTextureManagerConfig
     unsigned int numPages;             // max virtual pages
     unsigned int maxRequestedPages;    // max requests to pull from device
     unsigned int maxFilledPages;       // num slots to push mappings back to device
-    unsigned int maxStalePages;        // max stale pages to pull from device
-    unsigned int maxInvalidatedPages;  // max slots to push invalidated pages back to device
+    unsigned int maxStalePages;        // max stale pages to pull from device, the candidates for eviction
+    unsigned int maxInvalidatedPages;  // max slots to push invalidated pages back to device, limits evictions per push
+    size_t       maxTileMemory;        // max device memory for tiles per device in bytes, 0 for no limit
+    unsigned int numLoaderThreads;     // threads reading tiles in the background, 0 to read in processRequests()
+    size_t       maxHostCacheMemory;   // host memory for recently read tiles of all textures, 0 for no cache
+    bool         prefetchNeighbors;    // read the tiles around each requested tile ahead (needs threads and a cache)
+};
+
+/// Counters of a DemandTextureManager, summed over all devices.
+struct DemandTextureManagerStats
+{
+    size_t       tileMemory;         // device memory allocated for tiles and mip tails
+    unsigned int numFilledRequests;  // requests filled since the manager was created
+    unsigned int numDeniedRequests;  // requests left unfilled because the tile memory was exhausted
+    unsigned int numEvictedTiles;    // stale tiles unmapped to make room for requested ones
+
+    size_t       hostCacheMemory;    // tile data held in the host cache
+    unsigned int numCacheHits;       // requests served from the host cache without reading the image
+    unsigned int numCacheMisses;     // requests that had to read the image
+    unsigned int numPrefetchHits;    // cache hits on tiles that were prefetched
+    unsigned int numTileReads;       // tiles and mip tails read from the images, including prefetches
+    unsigned int numPrefetchReads;   // tiles read ahead of a request
+    unsigned int numPendingReads;    // reads queued or in progress, or finished but not yet filled
+    size_t       bytesRead;          // tile data read from the images
+    double       readSeconds;        // time spent reading, summed over the loader threads
 };
 
 /// DemandTextureManager demonstrates how to implement demand-loaded textures using the OptiX paging library.
@@ -61,16 +85,30 @@ class DemandTextureManager
     virtual const DemandTexture& createTexture( std::shared_ptr<ImageReader> image, const TextureDescriptor& textureDesc ) = 0;
 
     /// Prepare for launch, updating device-side texture sampler and texture array. Returns
-    /// a DemandTextureContext via result parameter.
+    /// a DemandTextureContext via result parameter.  Tiles the loader threads have finished reading
+    /// are filled and mapped on all devices first.
     virtual void launchPrepare( unsigned int deviceIndex, DemandTextureContext& demandTextureContext ) = 0;
 
-    /// Process requests for missing tiles (from optixPagingMapOrRequest).
+    /// Process requests for missing tiles (from optixPagingMapOrRequest).  With loader threads,
+    /// only the requests found in the host cache are filled here; the others are read in the
+    /// background and filled by a later launchPrepare().
     virtual int processRequests() = 0;
 
     // Push tile mappings to the device.  Returns the total number of new mappings.
     virtual unsigned int pushMappings() = 0;
 
     virtual unsigned int reservePages( unsigned int numPages ) = 0;
+
+    /// Get the memory use and request counters.
+    virtual DemandTextureManagerStats getStats() const = 0;
+
+    /// Get the pages requested by the devices in the launch before the last processRequests(), in
+    /// ascending order.  A request means a lookup found the page not resident.
+    virtual std::vector<unsigned int> getRequestedPages() const = 0;
+
+    /// Append the pages filled on any device since the last call to the given vector, texture start
+    /// pages, mip tails and tiles alike.  The pages are recorded until they are taken.
+    virtual void takeFilledPages( std::vector<unsigned int>& pageIds ) = 0;
 };
 
 /// Factory function to create a demand texture manager for the given configuration on the given devices.
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <DemandLoading/ImageReader.h>
+#include <DemandLoading/TextureInfo.h>
+
+#include <string>
+#include <vector>
+
+namespace demandLoading {
+
+struct TileCacheEntry;
+
+/// Reads a tile cache file written by writeTileCache() (see TileCacheFile.h) through a read-only
+/// memory mapping.  A readTile() with the tile size of the file is one memcpy, or one inflate for
+/// a compressed tile, straight into dest; other tile sizes, readMipLevel() and the mip tail are
+/// assembled from the stored tiles.  Like the other readers it is not thread safe.
+class MappedTileImageReader : public ImageReader
+{
+  public:
+    /// Construct a reader for the given file.  The file is not mapped until open() is called.
+    explicit MappedTileImageReader( const std::string& filename );
+
+    /// The destructor unmaps the file.
+    ~MappedTileImageReader() override;
+
+    /// Map the file and check its header and tile table.  Returns false if the file cannot be
+    /// mapped or is not a valid tile cache file.
+    bool open( TextureInfo* info ) override;
+
+    /// Unmap the file.
+    void close() override;
+
+    /// Get the image info.  Valid only after calling open().
+    const TextureInfo& getInfo() override { return m_info; }
+
+    /// Read the specified tile, returning the data in dest.  dest must be large enough to hold the
+    /// tile.  Pixels outside the bounds of the mip level are filled in with black.
+    bool readTile( char* dest, unsigned int mipLevel, unsigned int tileX, unsigned int tileY, unsigned int tileWidth, unsigned int tileHeight ) override;
+
+    /// Read the specified mipLevel.  Returns true for success.
+    bool readMipLevel( char* dest, unsigned int mipLevel, unsigned int expectedWidth, unsigned int expectedHeight ) override;
+
+    /// Get the dimensions of the tiles in the file.  Valid only after calling open().
+    unsigned int getTileWidth() const { return m_tileWidth; }
+    unsigned int getTileHeight() const { return m_tileHeight; }
+
+  private:
+    std::string               m_filename;
+    bool                      m_isOpen = false;
+    TextureInfo               m_info{};
+    const char*               m_data = nullptr;
+    size_t                    m_size = 0;
+#ifdef _WIN32
+    void*                     m_file    = nullptr;
+    void*                     m_mapping = nullptr;
+#endif
+    const TileCacheEntry*     m_entries    = nullptr;
+    unsigned int              m_tileWidth  = 0;
+    unsigned int              m_tileHeight = 0;
+    unsigned int              m_pixelSize  = 0;
+    std::vector<unsigned int> m_levelFirstTiles;  // index of the first tile of each mip level
+    std::vector<char>         m_tileBuffer;       // inflated tile for copyRect()
+    unsigned int              m_bufferedTile = ~0u;
+
+    bool mapFile();
+    void unmapFile();
+    bool validate();
+
+    // Inflate or copy a stored tile into dest.
+    bool readStoredTile( unsigned int tileIndex, char* dest ) const;
+    // Get the pixels of a stored tile, from the mapping or inflated into m_tileBuffer.
+    const char* getStoredTile( unsigned int tileIndex );
+    // Copy a rectangle inside a mip level into dest, whose rows are destPitch bytes apart.
+    bool copyRect( char* dest, size_t destPitch, unsigned int mipLevel, unsigned int x, unsigned int y, unsigned int width, unsigned int height );
+};
+
+}  // namespace demandLoading
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <DemandLoading/ImageReader.h>
+#include <DemandLoading/TextureInfo.h>
+
+#include <string>
+#include <vector>
+
+namespace demandLoading {
+
+/// Reads 8-bit PNG, JPEG, TGA, BMP and similar images with stb_image.  Such files are not tiled, so
+/// open() decodes the whole image as RGBA8 and builds its mip chain with a box filter in host memory.
+/// Tiles are copied out of that chain on request.
+class StbImageReader : public ImageReader
+{
+  public:
+    /// Construct a reader for the given file.  The file is not read until open() is called.  With
+    /// srgb set, the mip levels are filtered in linear space; the texture descriptor should then use
+    /// CU_TRSF_SRGB so that samples are linear as well.
+    explicit StbImageReader( const std::string& filename, bool srgb = true );
+
+    /// The destructor is virtual.
+    ~StbImageReader() override {}
+
+    /// Decode the image and build its mip levels.  Returns false if the file cannot be decoded.
+    bool open( TextureInfo* info ) override;
+
+    /// Release the decoded image.
+    void close() override;
+
+    /// Get the image info.  Valid only after calling open().
+    const TextureInfo& getInfo() override { return m_info; }
+
+    /// Read the specified tile, returning the data in dest.  dest must be large enough to hold the
+    /// tile.  Pixels outside the bounds of the mip level are filled in with black.
+    bool readTile( char* dest, unsigned int mipLevel, unsigned int tileX, unsigned int tileY, unsigned int tileWidth, unsigned int tileHeight ) override;
+
+    /// Read the specified mipLevel.  Returns true for success.
+    bool readMipLevel( char* dest, unsigned int mipLevel, unsigned int expectedWidth, unsigned int expectedHeight ) override;
+
+  private:
+    std::string                m_filename;
+    bool                       m_srgb;
+    bool                       m_isOpen = false;
+    TextureInfo                m_info{};
+    std::vector<unsigned char> m_pixels;       // all mip levels, RGBA8, level 0 first
+    std::vector<size_t>        m_levelOffsets;  // offset of each mip level in m_pixels
+};
+
+}  // namespace demandLoading
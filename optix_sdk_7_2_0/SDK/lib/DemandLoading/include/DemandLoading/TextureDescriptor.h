@@ -38,6 +38,7 @@ struct TextureDescriptor
     CUfilter_mode  filterMode;
     CUfilter_mode  mipmapFilterMode;
     unsigned int   maxAnisotropy;
+    unsigned int   flags;  // CU_TRSF_* flags of the texture object, e.g. CU_TRSF_SRGB
 };
 
 }  // namespace demandLoading
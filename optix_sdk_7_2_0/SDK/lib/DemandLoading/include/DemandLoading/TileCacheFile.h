@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace demandLoading {
+
+class ImageReader;
+
+/// A tile cache file holds an image already split into the tiles of a sparse texture, with all of
+/// its mip levels, so that reading a tile is a copy (or an inflate) out of a memory mapped file.
+///
+/// Layout, all integers little endian:
+///   TileCacheHeader   at offset 0
+///   TileCacheEntry    numTiles of them at tableOffset, level 0 first, tiles in row-major order
+///   tile data         at the offsets given by the entries
+///
+/// Every tile is tileWidth x tileHeight pixels, TILE_CACHE_TILE_SIZE bytes uncompressed, the
+/// geometry of a 64 KiB tile of a CUDA sparse texture of the same format.  Tiles at the right
+/// and bottom edges of a level are padded with black, and levels smaller than a tile (the mip
+/// tail) take one tile each.  Uncompressed tiles start on a 4 KiB boundary.
+const char         TILE_CACHE_MAGIC[8]  = {'D', 'L', 'T', 'I', 'L', 'E', 'S', '\0'};
+const unsigned int TILE_CACHE_VERSION   = 1;
+const unsigned int TILE_CACHE_TILE_SIZE = 65536;
+
+struct TileCacheHeader
+{
+    char     magic[8];      // TILE_CACHE_MAGIC
+    uint32_t version;       // TILE_CACHE_VERSION
+    uint32_t headerSize;    // sizeof( TileCacheHeader )
+    uint32_t width;         // of mip level 0
+    uint32_t height;
+    uint32_t format;        // CUarray_format
+    uint32_t numChannels;
+    uint32_t numMipLevels;  // down to 1x1
+    uint32_t tileWidth;
+    uint32_t tileHeight;
+    uint32_t numTiles;
+    uint64_t tableOffset;
+    uint64_t fileSize;      // to detect truncated files
+};
+
+enum TileCacheCompression : uint32_t
+{
+    TILE_CACHE_RAW     = 0,  // TILE_CACHE_TILE_SIZE bytes as is
+    TILE_CACHE_DEFLATE = 1   // zlib stream
+};
+
+struct TileCacheEntry
+{
+    uint64_t offset;       // from the start of the file
+    uint32_t storedSize;   // bytes in the file
+    uint32_t compression;  // TileCacheCompression
+};
+
+/// Get the dimensions of a 64 KiB tile for the given pixel size, which must be a power of two
+/// from 1 to 16 bytes.  These agree with the tile extents CUDA reports for sparse arrays.
+bool getTileCacheTileDims( unsigned int pixelSize, unsigned int* tileWidth, unsigned int* tileHeight );
+
+struct TileCacheWriteOptions
+{
+    bool  compress     = true;    // deflate the tiles that get smaller by at least minSavings
+    float minSavings   = 0.125f;  // fraction of the tile size
+    int   deflateLevel = 5;       // 1 (fastest) to 9 (smallest)
+};
+
+struct TileCacheWriteStats
+{
+    unsigned int numTiles;
+    unsigned int numCompressedTiles;
+    size_t       rawBytes;   // numTiles * TILE_CACHE_TILE_SIZE
+    size_t       fileBytes;
+};
+
+/// Convert the given image into a tile cache file, reading it one mip level at a time.  Returns
+/// false if the image cannot be read, has an unsupported pixel size, or the file cannot be written;
+/// error describes the problem.
+bool writeTileCache( ImageReader&                 image,
+                     const std::string&           filename,
+                     const TileCacheWriteOptions& options,
+                     TileCacheWriteStats*         stats = nullptr,
+                     std::string*                 error = nullptr );
+
+}  // namespace demandLoading
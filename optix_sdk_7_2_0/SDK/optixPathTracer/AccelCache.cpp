@@ -0,0 +1,219 @@
+#include "AccelCache.h"
+
+#include "SceneCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+
+std::string accelCachePath( const std::string& scene_file )
+{
+    return scene_file + ".rraccel";
+}
+
+
+static uint64_t alignOffset( uint64_t offset )
+{
+    return ( offset + OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT - 1 ) / OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT * OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT;
+}
+
+
+bool AccelCache::open( const std::string& filename, std::string& reason )
+{
+    close();
+    if( !m_file.open( filename ) )
+    {
+        reason = "no cache file";
+        return false;
+    }
+
+    AccelCacheHeader header;
+    if( m_file.size() < sizeof( header ) )
+    {
+        reason = "truncated header";
+        m_file.close();
+        return false;
+    }
+    std::memcpy( &header, m_file.data(), sizeof( header ) );
+    if( std::memcmp( header.magic, ACCEL_CACHE_MAGIC, sizeof( header.magic ) ) != 0 || header.version != ACCEL_CACHE_VERSION
+        || header.header_bytes != sizeof( AccelCacheHeader ) || header.entry_bytes != sizeof( AccelCacheEntry ) )
+    {
+        reason = "different format version";
+        m_file.close();
+        return false;
+    }
+    if( header.file_bytes != m_file.size() || header.entries % alignof( AccelCacheEntry ) != 0 || header.entries > m_file.size()
+        || header.num_entries > ( m_file.size() - header.entries ) / sizeof( AccelCacheEntry ) )
+    {
+        reason = "truncated file";
+        m_file.close();
+        return false;
+    }
+
+    m_entries     = reinterpret_cast<const AccelCacheEntry*>( m_file.data() + header.entries );
+    m_num_entries = header.num_entries;
+    for( uint32_t i = 0; i < m_num_entries; ++i )
+        m_by_geometry.insert( std::make_pair( m_entries[i].key.geometry_hash, i ) );
+    return true;
+}
+
+
+void AccelCache::close()
+{
+    m_file.close();
+    m_entries     = nullptr;
+    m_num_entries = 0;
+    m_by_geometry.clear();
+    m_pending.clear();
+    m_hits   = 0;
+    m_misses = 0;
+    m_first_miss.clear();
+}
+
+
+bool AccelCache::find( const AccelCacheKey& key, const CompatibilityCheck& compatible, const char*& data, size_t& bytes,
+                       OptixAccelRelocationInfo& info, std::string& reason )
+{
+    // The most specific reason wins when the geometry was cached under another key
+    reason = "not cached";
+    const auto range = m_by_geometry.equal_range( key.geometry_hash );
+    for( auto it = range.first; it != range.second; ++it )
+    {
+        const AccelCacheEntry& entry = m_entries[it->second];
+        if( entry.key.build_flags != key.build_flags )
+        {
+            reason = "built with other flags";
+            continue;
+        }
+        if( entry.key.optix_version != key.optix_version )
+        {
+            reason = "built by OptiX " + std::to_string( entry.key.optix_version );
+            continue;
+        }
+        if( entry.data > m_file.size() || entry.bytes > m_file.size() - entry.data
+            || hashBytes( m_file.data() + entry.data, static_cast<size_t>( entry.bytes ) ) != entry.data_hash )
+        {
+            reason = "damaged";
+            break;
+        }
+        if( !compatible( entry.relocation_info ) )
+        {
+            reason = "incompatible with this device";
+            break;
+        }
+
+        data  = m_file.data() + entry.data;
+        bytes = static_cast<size_t>( entry.bytes );
+        info  = entry.relocation_info;
+        ++m_hits;
+        for( const Pending& pending : m_pending )
+            if( pending.key == key )
+                return true;
+        m_pending.push_back( Pending() );
+        m_pending.back().key   = key;
+        m_pending.back().info  = info;
+        m_pending.back().data  = data;
+        m_pending.back().bytes = bytes;
+        return true;
+    }
+    if( m_misses++ == 0 )
+        m_first_miss = reason;
+    return false;
+}
+
+
+void AccelCache::add( const AccelCacheKey& key, const OptixAccelRelocationInfo& info, const void* data, size_t bytes )
+{
+    for( const Pending& pending : m_pending )
+        if( pending.key == key )
+            return;
+
+    m_pending.push_back( Pending() );
+    Pending& pending = m_pending.back();
+    pending.key   = key;
+    pending.info  = info;
+    pending.storage.assign( static_cast<const char*>( data ), static_cast<const char*>( data ) + bytes );
+    pending.data  = pending.storage.data();
+    pending.bytes = bytes;
+}
+
+
+bool AccelCache::changed() const
+{
+    if( m_pending.size() != m_num_entries )
+        return true;
+    for( const Pending& pending : m_pending )
+        if( !pending.storage.empty() )
+            return true;
+    return false;
+}
+
+
+bool AccelCache::write( const std::string& filename, std::string& err )
+{
+    AccelCacheHeader header = {};
+    std::memcpy( header.magic, ACCEL_CACHE_MAGIC, sizeof( header.magic ) );
+    header.version      = ACCEL_CACHE_VERSION;
+    header.header_bytes = sizeof( AccelCacheHeader );
+    header.entry_bytes  = sizeof( AccelCacheEntry );
+    header.num_entries  = static_cast<uint32_t>( m_pending.size() );
+    header.entries      = alignOffset( sizeof( AccelCacheHeader ) );
+
+    std::vector<AccelCacheEntry> entries( m_pending.size() );
+    uint64_t                     offset = alignOffset( header.entries + entries.size() * sizeof( AccelCacheEntry ) );
+    for( size_t i = 0; i < m_pending.size(); ++i )
+    {
+        entries[i]                 = AccelCacheEntry();
+        entries[i].key             = m_pending[i].key;
+        entries[i].relocation_info = m_pending[i].info;
+        entries[i].data            = offset;
+        entries[i].bytes           = m_pending[i].bytes;
+        entries[i].data_hash       = hashBytes( m_pending[i].data, m_pending[i].bytes );
+        offset                     = alignOffset( offset + m_pending[i].bytes );
+    }
+    header.file_bytes = offset;
+
+    // The kept structures are read from the mapping, so it stays open until the new file is complete
+    const std::string temp_file = filename + ".tmp";
+    bool              written;
+    {
+        std::ofstream out( temp_file, std::ios::binary | std::ios::trunc );
+        const char    zeros[OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT] = {};
+        uint64_t      position = 0;
+        const auto    pad      = [&]( uint64_t to ) {
+            out.write( zeros, static_cast<std::streamsize>( to - position ) );
+            position = to;
+        };
+        out.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+        position = sizeof( header );
+        pad( header.entries );
+        out.write( reinterpret_cast<const char*>( entries.data() ), entries.size() * sizeof( AccelCacheEntry ) );
+        position += entries.size() * sizeof( AccelCacheEntry );
+        for( size_t i = 0; i < m_pending.size(); ++i )
+        {
+            pad( entries[i].data );
+            out.write( m_pending[i].data, m_pending[i].bytes );
+            position += m_pending[i].bytes;
+        }
+        pad( header.file_bytes );
+        written = static_cast<bool>( out );
+    }
+    if( !written )
+    {
+        err = "cannot write " + temp_file;
+        std::remove( temp_file.c_str() );
+        return false;
+    }
+
+    close();
+    std::remove( filename.c_str() );  // rename does not replace an existing file on Windows
+    if( std::rename( temp_file.c_str(), filename.c_str() ) != 0 )
+    {
+        std::remove( temp_file.c_str() );
+        err = "cannot rename " + temp_file + " to " + filename;
+        return false;
+    }
+    return true;
+}
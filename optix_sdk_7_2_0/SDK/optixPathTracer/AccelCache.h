@@ -0,0 +1,125 @@
+#pragma once
+
+#include <optix_types.h>
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+*   Cache of built and compacted geometry acceleration structures (.rraccel) across runs.
+*
+*   Every static GAS is stored as a copy of its device memory together with the
+*   OptixAccelRelocationInfo of the device it was built on. A later run that asks for the same key
+*   uploads the bytes and calls optixAccelRelocate instead of building and compacting again, provided
+*   optixAccelCheckRelocationCompatibility accepts the relocation info on the current device.
+*
+*   The key is a hash of the build input contents (vertices, indices or AABBs, SBT index offsets and
+*   geometry flags) plus the build flags and the OptiX version. Only the lookup and the file format
+*   live here; the OptiX calls are made by the caller, which passes the compatibility check in, so the
+*   invalidation rules can be exercised on the host.
+*
+*   The file is an AccelCacheHeader, an entry table and the structures, each aligned to
+*   OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT. write() replaces it with the entries found or added since open(),
+*   which drops structures the scene no longer uses.
+*/
+
+static const char     ACCEL_CACHE_MAGIC[8] = { 'R', 'R', 'A', 'C', 'C', 'E', 'L', 0 };
+static const uint32_t ACCEL_CACHE_VERSION  = 1;
+
+
+struct AccelCacheKey
+{
+    uint64_t geometry_hash;     // build input contents, see hashBytes()
+    uint32_t build_flags;       // OptixAccelBuildOptions::buildFlags
+    uint32_t optix_version;     // OPTIX_VERSION of the build
+
+    bool operator==( const AccelCacheKey& other ) const
+    {
+        return geometry_hash == other.geometry_hash && build_flags == other.build_flags && optix_version == other.optix_version;
+    }
+};
+
+
+struct AccelCacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_bytes;      // layout checks for the records copied as they are
+    uint32_t entry_bytes;
+    uint32_t num_entries;
+    uint64_t file_bytes;        // catches truncated files
+    uint64_t entries;           // offset of the entry table
+};
+
+
+struct AccelCacheEntry
+{
+    AccelCacheKey            key;
+    OptixAccelRelocationInfo relocation_info;
+    uint64_t                 data;       // offset of the structure from the start of the file
+    uint64_t                 bytes;
+    uint64_t                 data_hash;  // catches damaged structures before they reach the device
+};
+
+
+// Default cache path of a scene file
+std::string accelCachePath( const std::string& scene_file );
+
+
+class AccelCache
+{
+public:
+    typedef std::function<bool( const OptixAccelRelocationInfo& )> CompatibilityCheck;
+
+    // Map filename. Returns false and tells why if it holds no usable entries; lookups miss then, and
+    // add() and write() still work.
+    bool open( const std::string& filename, std::string& reason );
+    void close();
+
+    /*
+        Find the structure for key. On a hit data and bytes point into the mapping, info is needed for
+        optixAccelRelocate, and the entry is kept for the next write(). On a miss reason tells why: not
+        cached, built with other flags or another OptiX version, relocation incompatible with the
+        device, or damaged.
+    */
+    bool find( const AccelCacheKey& key, const CompatibilityCheck& compatible, const char*& data, size_t& bytes,
+               OptixAccelRelocationInfo& info, std::string& reason );
+
+    // Store a structure built in this run with the next write(); data is copied
+    void add( const AccelCacheKey& key, const OptixAccelRelocationInfo& info, const void* data, size_t bytes );
+
+    // Whether write() would change the file: a structure was added or an entry was not used
+    bool changed() const;
+
+    // Replace filename with the entries found or added since open() and close the mapping
+    bool write( const std::string& filename, std::string& err );
+
+    size_t             hits() const      { return m_hits; }
+    size_t             misses() const    { return m_misses; }
+    const std::string& firstMiss() const { return m_first_miss; }  // reason of the first miss since open()
+
+private:
+    struct Pending
+    {
+        AccelCacheKey            key;
+        OptixAccelRelocationInfo info;
+        const char*              data;    // into the mapping for kept entries
+        size_t                   bytes;
+        std::vector<char>        storage; // for added entries
+    };
+
+    MappedFile                        m_file;
+    const AccelCacheEntry*            m_entries     = nullptr;
+    uint32_t                          m_num_entries = 0;
+    std::multimap<uint64_t, uint32_t> m_by_geometry;  // geometry hash -> entry
+    std::vector<Pending>              m_pending;
+    size_t                            m_hits   = 0;
+    size_t                            m_misses = 0;
+    std::string                       m_first_miss;
+};
@@ -0,0 +1,265 @@
+//
+// accelCacheTest - host tests of the acceleration structure cache: entries round trip through
+// write() and open(), a lookup misses for another geometry hash, other build flags, another OptiX
+// version or a device that cannot relocate the structure, and damaged or truncated files are
+// rejected. The structures are arbitrary bytes here and the relocation compatibility check is a
+// stand-in for optixAccelCheckRelocationCompatibility that compares a device id stored in the info.
+//
+
+#include "AccelCache.h"
+#include "HostTest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+const std::string CACHE_FILE = "accelCacheTest.rraccel";
+const uint32_t    BUILT_BY   = 70200;  // OPTIX_VERSION of the builds; optix.h is not needed on the host
+
+std::vector<char> readFile( const std::string& filename )
+{
+    std::ifstream in( filename.c_str(), std::ios::binary );
+    return std::vector<char>( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+}
+
+void writeBytes( const std::string& filename, const std::vector<char>& bytes )
+{
+    std::ofstream out( filename.c_str(), std::ios::binary | std::ios::trunc );
+    out.write( bytes.data(), bytes.size() );
+}
+
+AccelCacheKey makeKey( uint64_t geometry_hash, uint32_t build_flags = OPTIX_BUILD_FLAG_ALLOW_COMPACTION, uint32_t optix_version = BUILT_BY )
+{
+    AccelCacheKey key;
+    key.geometry_hash = geometry_hash;
+    key.build_flags   = build_flags;
+    key.optix_version = optix_version;
+    return key;
+}
+
+// Relocation info of a structure built on the given device
+OptixAccelRelocationInfo deviceInfo( unsigned long long device )
+{
+    OptixAccelRelocationInfo info;
+    std::memset( &info, 0, sizeof( info ) );
+    info.info[0] = device;
+    info.info[1] = 0x5eedull;
+    return info;
+}
+
+AccelCache::CompatibilityCheck onDevice( unsigned long long device )
+{
+    return [device]( const OptixAccelRelocationInfo& info ) { return info.info[0] == device; };
+}
+
+// A structure of the given size with content depending on seed
+std::vector<char> structure( size_t bytes, int seed )
+{
+    std::vector<char> data( bytes );
+    for( size_t i = 0; i < bytes; ++i )
+        data[i] = static_cast<char>( i * 31 + seed * 7 );
+    return data;
+}
+
+// A cache with three structures of odd sizes, built on device 1
+void writeThree()
+{
+    AccelCache  cache;
+    std::string reason, err;
+    cache.open( CACHE_FILE, reason );
+    for( int i = 0; i < 3; ++i )
+    {
+        const std::vector<char> data = structure( 1000 + 333 * i, i );
+        cache.add( makeKey( 100 + i ), deviceInfo( 1 ), data.data(), data.size() );
+    }
+    HOST_CHECK( cache.changed() );
+    HOST_CHECK( cache.write( CACHE_FILE, err ) );
+}
+
+
+void testRoundTrip()
+{
+    std::remove( CACHE_FILE.c_str() );
+    writeThree();
+
+    AccelCache  cache;
+    std::string reason;
+    HOST_CHECK( cache.open( CACHE_FILE, reason ) );
+    for( int i = 0; i < 3; ++i )
+    {
+        const char*              data  = nullptr;
+        size_t                   bytes = 0;
+        OptixAccelRelocationInfo info;
+        HOST_CHECK( cache.find( makeKey( 100 + i ), onDevice( 1 ), data, bytes, info, reason ) );
+        const std::vector<char> expected = structure( 1000 + 333 * i, i );
+        HOST_CHECK( bytes == expected.size() && data && std::memcmp( data, expected.data(), bytes ) == 0 );
+        HOST_CHECK( info.info[0] == 1 && info.info[1] == 0x5eedull );
+    }
+    HOST_CHECK( cache.hits() == 3 && cache.misses() == 0 );
+
+    // Every entry used, nothing added: write() would not change the file
+    HOST_CHECK( !cache.changed() );
+}
+
+
+void testKeyMismatches()
+{
+    std::remove( CACHE_FILE.c_str() );
+    writeThree();
+
+    AccelCache  cache;
+    std::string reason;
+    HOST_CHECK( cache.open( CACHE_FILE, reason ) );
+    const char*              data;
+    size_t                   bytes;
+    OptixAccelRelocationInfo info;
+
+    // Geometry hash: changed vertices, indices, AABBs, SBT offsets or geometry flags
+    HOST_CHECK( !cache.find( makeKey( 999 ), onDevice( 1 ), data, bytes, info, reason ) );
+    HOST_CHECK( reason == "not cached" );
+    HOST_CHECK( cache.firstMiss() == "not cached" );
+
+    // Same geometry, other build flags or OptiX version
+    HOST_CHECK( !cache.find( makeKey( 100, OPTIX_BUILD_FLAG_ALLOW_COMPACTION | OPTIX_BUILD_FLAG_PREFER_FAST_TRACE ), onDevice( 1 ), data,
+                             bytes, info, reason ) );
+    HOST_CHECK( reason == "built with other flags" );
+    HOST_CHECK( !cache.find( makeKey( 100, OPTIX_BUILD_FLAG_ALLOW_COMPACTION, BUILT_BY + 100 ), onDevice( 1 ), data, bytes, info, reason ) );
+    HOST_CHECK( reason == "built by OptiX " + std::to_string( BUILT_BY ) );
+
+    // Device or driver the structure cannot be relocated to: the check sees the stored info
+    bool                     checked = false;
+    OptixAccelRelocationInfo seen;
+    const auto               record  = [&]( const OptixAccelRelocationInfo& i ) {
+        checked = true;
+        seen    = i;
+        return false;
+    };
+    HOST_CHECK( !cache.find( makeKey( 101 ), record, data, bytes, info, reason ) );
+    HOST_CHECK( reason == "incompatible with this device" );
+    HOST_CHECK( checked && seen.info[0] == 1 && seen.info[1] == 0x5eedull );
+    HOST_CHECK( !cache.find( makeKey( 101 ), onDevice( 2 ), data, bytes, info, reason ) );
+
+    HOST_CHECK( cache.misses() == 5 && cache.hits() == 0 );
+    HOST_CHECK( cache.firstMiss() == "not cached" );
+
+    // The mismatches do not keep entries: write() drops the three unused structures
+    HOST_CHECK( cache.changed() );
+    std::string err;
+    HOST_CHECK( cache.write( CACHE_FILE, err ) );
+    HOST_CHECK( cache.open( CACHE_FILE, reason ) );
+    HOST_CHECK( !cache.find( makeKey( 100 ), onDevice( 1 ), data, bytes, info, reason ) );
+}
+
+
+void testKeptAndAddedEntries()
+{
+    std::remove( CACHE_FILE.c_str() );
+    writeThree();
+
+    // Use one entry, add a rebuilt one for changed geometry: the file then holds exactly those two
+    AccelCache  cache;
+    std::string reason, err;
+    HOST_CHECK( cache.open( CACHE_FILE, reason ) );
+    const char*              data;
+    size_t                   bytes;
+    OptixAccelRelocationInfo info;
+    HOST_CHECK( cache.find( makeKey( 102 ), onDevice( 1 ), data, bytes, info, reason ) );
+    HOST_CHECK( cache.find( makeKey( 102 ), onDevice( 1 ), data, bytes, info, reason ) );  // instanced twice, kept once
+    const std::vector<char> rebuilt = structure( 77, 9 );
+    cache.add( makeKey( 200 ), deviceInfo( 1 ), rebuilt.data(), rebuilt.size() );
+    cache.add( makeKey( 200 ), deviceInfo( 1 ), rebuilt.data(), rebuilt.size() );
+    HOST_CHECK( cache.changed() );
+    HOST_CHECK( cache.write( CACHE_FILE, err ) );
+
+    HOST_CHECK( cache.open( CACHE_FILE, reason ) );
+    HOST_CHECK( cache.find( makeKey( 102 ), onDevice( 1 ), data, bytes, info, reason ) );
+    HOST_CHECK( bytes == 1666 && std::memcmp( data, structure( 1666, 2 ).data(), bytes ) == 0 );
+    HOST_CHECK( cache.find( makeKey( 200 ), onDevice( 1 ), data, bytes, info, reason ) );
+    HOST_CHECK( bytes == 77 && std::memcmp( data, rebuilt.data(), bytes ) == 0 );
+    HOST_CHECK( !cache.find( makeKey( 100 ), onDevice( 1 ), data, bytes, info, reason ) );
+    HOST_CHECK( !cache.changed() );  // 100 missed, but the file holds exactly the two used entries
+}
+
+
+void testDamagedFiles()
+{
+    std::remove( CACHE_FILE.c_str() );
+    AccelCache  cache;
+    std::string reason;
+    HOST_CHECK( !cache.open( CACHE_FILE, reason ) );
+    HOST_CHECK( reason == "no cache file" );
+
+    writeThree();
+    const std::vector<char> good = readFile( CACHE_FILE );
+    AccelCacheHeader        header;
+    std::memcpy( &header, good.data(), sizeof( header ) );
+    HOST_CHECK( header.num_entries == 3 && header.file_bytes == good.size() );
+    std::vector<AccelCacheEntry> entries( 3 );
+    std::memcpy( entries.data(), good.data() + header.entries, 3 * sizeof( AccelCacheEntry ) );
+
+    // optixAccelRelocate needs the structures at aligned device addresses, the file keeps them aligned too
+    for( const AccelCacheEntry& entry : entries )
+        HOST_CHECK( entry.data % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT == 0 && entry.data + entry.bytes <= header.file_bytes );
+
+    // Truncated in the header, the entry table, a structure, or by a single byte
+    for( size_t size : { size_t( 0 ), sizeof( AccelCacheHeader ) - 1, size_t( header.entries ) + 8, good.size() / 2, good.size() - 1 } )
+    {
+        writeBytes( CACHE_FILE, std::vector<char>( good.begin(), good.begin() + size ) );
+        HOST_CHECK( !cache.open( CACHE_FILE, reason ) );
+        HOST_CHECK( reason == "truncated header" || reason == "truncated file" );
+    }
+
+    // Header fields
+    const auto openDamaged = [&]( void ( *damage )( AccelCacheHeader& ) ) {
+        std::vector<char> damaged = good;
+        AccelCacheHeader  h;
+        std::memcpy( &h, damaged.data(), sizeof( h ) );
+        damage( h );
+        std::memcpy( damaged.data(), &h, sizeof( h ) );
+        writeBytes( CACHE_FILE, damaged );
+        std::string why;
+        return cache.open( CACHE_FILE, why ) ? std::string( "opened" ) : why;
+    };
+    HOST_CHECK( openDamaged( []( AccelCacheHeader& h ) { h.magic[1] = 'X'; } ) == "different format version" );
+    HOST_CHECK( openDamaged( []( AccelCacheHeader& h ) { ++h.version; } ) == "different format version" );
+    HOST_CHECK( openDamaged( []( AccelCacheHeader& h ) { h.entry_bytes -= 8; } ) == "different format version" );
+    HOST_CHECK( openDamaged( []( AccelCacheHeader& h ) { h.num_entries = 1000000; } ) == "truncated file" );
+    HOST_CHECK( openDamaged( []( AccelCacheHeader& h ) { h.entries = h.file_bytes + 8; } ) == "truncated file" );
+    HOST_CHECK( openDamaged( []( AccelCacheHeader& h ) { h.entries += 1; } ) == "truncated file" );
+
+    // A damaged structure or entry is a miss, the other entries still hit
+    std::vector<char> damaged = good;
+    damaged[entries[1].data + 500] ^= 0x10;
+    entries[2].bytes = header.file_bytes;  // reaches past the end of the file
+    std::memcpy( damaged.data() + header.entries, entries.data(), 3 * sizeof( AccelCacheEntry ) );
+    writeBytes( CACHE_FILE, damaged );
+    HOST_CHECK( cache.open( CACHE_FILE, reason ) );
+    const char*              data;
+    size_t                   bytes;
+    OptixAccelRelocationInfo info;
+    HOST_CHECK( !cache.find( makeKey( 101 ), onDevice( 1 ), data, bytes, info, reason ) );
+    HOST_CHECK( reason == "damaged" );
+    HOST_CHECK( !cache.find( makeKey( 102 ), onDevice( 1 ), data, bytes, info, reason ) );
+    HOST_CHECK( reason == "damaged" );
+    HOST_CHECK( cache.find( makeKey( 100 ), onDevice( 1 ), data, bytes, info, reason ) );
+
+    cache.close();
+    std::remove( CACHE_FILE.c_str() );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testRoundTrip();
+    testKeyMismatches();
+    testKeptAndAddedEntries();
+    testDamagedFiles();
+    return hostTestResult( "accelCacheTest" );
+}
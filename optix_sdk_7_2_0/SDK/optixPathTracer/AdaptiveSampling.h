@@ -0,0 +1,86 @@
+#pragma once
+
+#include <sutil/vec_math.h>
+
+#ifndef __CUDACC__
+#include <vector>
+#endif
+
+/*
+*   Per-pixel convergence estimation shared by the raygen program and host code.
+*
+*   Every launch contributes one sample of the pixel luminance (the average of samples_per_launch
+*   paths). The moment buffer keeps the running mean of the luminance in x, the running mean of its
+*   square in y and the number of launches in z. A pixel is converged once the standard error of its
+*   mean, relative to the mean, drops below a threshold.
+*/
+
+struct AdaptiveSamplingSettings
+{
+    float        error_threshold;  // relative standard error below which a pixel stops sampling
+    unsigned int min_launches;     // launches a pixel always receives before it may converge
+};
+
+
+SUTIL_INLINE SUTIL_HOSTDEVICE float pixelLuminance( const float3& c )
+{
+    return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
+}
+
+
+/* Add the luminance of one launch to the running moments. Pass restart to drop the old moments. */
+SUTIL_INLINE SUTIL_HOSTDEVICE float4 updateMoments( const float4& moments, float luminance, bool restart )
+{
+    if( restart )
+        return make_float4( luminance, luminance * luminance, 1.0f, 0.0f );
+
+    const float n = moments.z + 1.0f;
+    return make_float4(
+            moments.x + ( luminance - moments.x ) / n,
+            moments.y + ( luminance * luminance - moments.y ) / n,
+            n,
+            0.0f );
+}
+
+
+/* Relative standard error of the pixel mean */
+SUTIL_INLINE SUTIL_HOSTDEVICE float relativeError( const float4& moments )
+{
+    if( moments.z < 2.0f )
+        return 1e30f;
+    const float variance = fmaxf( moments.y - moments.x * moments.x, 0.0f );
+    return sqrtf( variance / moments.z ) / fmaxf( moments.x, 1e-3f );
+}
+
+
+SUTIL_INLINE SUTIL_HOSTDEVICE bool pixelConverged( const float4& moments, const AdaptiveSamplingSettings& settings )
+{
+    return moments.z >= static_cast<float>( settings.min_launches ) && relativeError( moments ) < settings.error_threshold;
+}
+
+
+#ifndef __CUDACC__
+/*
+    CPU reference of the active pixel list the raygen program appends to: the indices of all pixels
+    that are not converged, in ascending order (the device list has the same content in arbitrary order).
+*/
+inline std::vector<unsigned int> buildActivePixelList(
+        const float4*                   moments,
+        unsigned int                    num_pixels,
+        const AdaptiveSamplingSettings& settings,
+        std::vector<unsigned char>*     convergence_mask = nullptr )
+{
+    std::vector<unsigned int> active;
+    if( convergence_mask )
+        convergence_mask->assign( num_pixels, 0 );
+    for( unsigned int i = 0; i < num_pixels; ++i )
+    {
+        const bool converged = pixelConverged( moments[i], settings );
+        if( convergence_mask )
+            ( *convergence_mask )[i] = converged ? 1 : 0;
+        if( !converged )
+            active.push_back( i );
+    }
+    return active;
+}
+#endif
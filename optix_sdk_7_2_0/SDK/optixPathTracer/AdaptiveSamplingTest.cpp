@@ -0,0 +1,163 @@
+//
+// adaptiveSamplingTest - host tests of the convergence estimate in AdaptiveSampling.h. Synthetic
+// luminance streams are fed through updateMoments() like the raygen program does once per launch,
+// and buildActivePixelList() is checked against the expected active pixels, the error threshold
+// and the minimum launch rule.
+//
+
+#include "AdaptiveSampling.h"
+#include "HostTest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+AdaptiveSamplingSettings makeSettings( float threshold, unsigned int min_launches )
+{
+    AdaptiveSamplingSettings settings;
+    settings.error_threshold = threshold;
+    settings.min_launches    = min_launches;
+    return settings;
+}
+
+// Moments after the given launches, with a restart at the first one like the raygen program
+float4 momentsOf( const std::vector<float>& luminances )
+{
+    float4 moments = make_float4( 0.0f );
+    for( size_t i = 0; i < luminances.size(); ++i )
+        moments = updateMoments( moments, luminances[i], i == 0 );
+    return moments;
+}
+
+// n launches alternating between mean - spread and mean + spread: standard deviation spread
+float4 alternating( float mean, float spread, unsigned int n )
+{
+    std::vector<float> luminances;
+    for( unsigned int i = 0; i < n; ++i )
+        luminances.push_back( i % 2 ? mean + spread : mean - spread );
+    return momentsOf( luminances );
+}
+
+
+void testMoments()
+{
+    const float4 moments = momentsOf( { 1.0f, 2.0f, 3.0f, 6.0f } );
+    HOST_CHECK_NEAR( moments.x, 3.0f, 1e-6 );
+    HOST_CHECK_NEAR( moments.y, ( 1.0f + 4.0f + 9.0f + 36.0f ) / 4.0f, 1e-5 );
+    HOST_CHECK_NEAR( moments.z, 4.0f, 0.0 );
+
+    // A restart drops everything before it
+    const float4 restarted = updateMoments( moments, 0.5f, true );
+    HOST_CHECK_NEAR( restarted.x, 0.5f, 0.0 );
+    HOST_CHECK_NEAR( restarted.z, 1.0f, 0.0 );
+
+    // Standard deviation 0.1 of a mean of 1 over 16 launches: relative error 0.1 / sqrt( 16 )
+    HOST_CHECK_NEAR( relativeError( alternating( 1.0f, 0.1f, 16 ) ), 0.025f, 1e-4 );
+    HOST_CHECK( relativeError( alternating( 1.0f, 0.1f, 1 ) ) > 1e29f );
+}
+
+
+void testThreshold()
+{
+    // Relative error 0.025 after 16 launches, converged only below a threshold above it
+    const float4 moments = alternating( 1.0f, 0.1f, 16 );
+    HOST_CHECK( pixelConverged( moments, makeSettings( 0.026f, 8 ) ) );
+    HOST_CHECK( !pixelConverged( moments, makeSettings( 0.024f, 8 ) ) );
+
+    // Black pixels have no variance and converge, they do not divide by zero
+    HOST_CHECK( pixelConverged( alternating( 0.0f, 0.0f, 8 ), makeSettings( 0.01f, 8 ) ) );
+}
+
+
+void testMinimumLaunches()
+{
+    // A noiseless pixel still waits for min_launches, and converges exactly at min_launches
+    const AdaptiveSamplingSettings settings = makeSettings( 0.05f, 8 );
+    HOST_CHECK( !pixelConverged( alternating( 0.5f, 0.0f, 7 ), settings ) );
+    HOST_CHECK( pixelConverged( alternating( 0.5f, 0.0f, 8 ), settings ) );
+
+    // min_launches below 2 does not let a single launch converge, one sample has no variance estimate
+    HOST_CHECK( !pixelConverged( alternating( 0.5f, 0.0f, 1 ), makeSettings( 0.05f, 0 ) ) );
+    HOST_CHECK( pixelConverged( alternating( 0.5f, 0.0f, 2 ), makeSettings( 0.05f, 0 ) ) );
+}
+
+
+void testActivePixelList()
+{
+    // 64x32 image: a noisy region, a smooth region, a young region and black background
+    const unsigned int       width = 64, height = 32;
+    const AdaptiveSamplingSettings settings = makeSettings( 0.02f, 8 );
+    std::vector<float4>       moments( width * height );
+    std::vector<unsigned int> expected;
+    std::mt19937              rng( 7 );
+    for( unsigned int y = 0; y < height; ++y )
+    {
+        for( unsigned int x = 0; x < width; ++x )
+        {
+            const unsigned int i = y * width + x;
+            if( x < 16 )
+                moments[i] = alternating( 1.0f, 0.5f, 32 );     // relative error 0.088
+            else if( x < 32 )
+                moments[i] = alternating( 1.0f, 0.05f, 32 );    // relative error 0.0088
+            else if( x < 48 )
+                moments[i] = alternating( 1.0f, 0.0f, 1 + rng() % 12 );  // noiseless, 1 to 12 launches
+            else
+                moments[i] = alternating( 0.0f, 0.0f, 32 );
+            if( !pixelConverged( moments[i], settings ) )
+                expected.push_back( i );
+            // Independent of pixelConverged(): noisy pixels and young pixels stay active
+            if( x < 16 || ( x >= 32 && x < 48 && moments[i].z < 8.0f ) )
+                HOST_CHECK( !expected.empty() && expected.back() == i );
+        }
+    }
+
+    std::vector<unsigned char>      mask;
+    const std::vector<unsigned int> active = buildActivePixelList( moments.data(), width * height, settings, &mask );
+    HOST_CHECK( active == expected );
+    HOST_CHECK( std::is_sorted( active.begin(), active.end() ) );
+    HOST_CHECK( std::adjacent_find( active.begin(), active.end() ) == active.end() );
+
+    // The mask is the complement of the list
+    HOST_CHECK( mask.size() == width * height );
+    size_t num_converged = 0;
+    for( unsigned int i = 0; i < width * height; ++i )
+    {
+        num_converged += mask[i];
+        HOST_CHECK( ( mask[i] != 0 ) != std::binary_search( active.begin(), active.end(), i ) );
+    }
+    HOST_CHECK( num_converged + active.size() == width * height );
+
+    // The raygen program appends with atomicAdd in launch order: same set, any order
+    std::vector<unsigned int> device_list;
+    std::vector<unsigned int> launch_order( width * height );
+    for( unsigned int i = 0; i < width * height; ++i )
+        launch_order[i] = i;
+    std::shuffle( launch_order.begin(), launch_order.end(), rng );
+    for( unsigned int i : launch_order )
+        if( !pixelConverged( moments[i], settings ) )
+            device_list.push_back( i );
+    std::sort( device_list.begin(), device_list.end() );
+    HOST_CHECK( device_list == active );
+
+    // Without a mask. With a loose threshold only the pixels with a single launch stay active.
+    HOST_CHECK( buildActivePixelList( moments.data(), width * height, settings ) == active );
+    const std::vector<unsigned int> loose = buildActivePixelList( moments.data(), width * height, makeSettings( 1.0f, 0 ) );
+    for( unsigned int i = 0; i < width * height; ++i )
+        HOST_CHECK( std::binary_search( loose.begin(), loose.end(), i ) == ( moments[i].z < 2.0f ) );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testMoments();
+    testThreshold();
+    testMinimumLaunches();
+    testActivePixelList();
+    return hostTestResult( "adaptiveSamplingTest" );
+}
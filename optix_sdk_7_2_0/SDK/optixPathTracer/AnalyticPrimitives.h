@@ -0,0 +1,157 @@
+#pragma once
+
+#include <sutil/vec_math.h>
+
+/*
+*   Analytic primitives for custom primitive (AABB) build inputs.
+*
+*   The intersection functions are shared by the intersection programs and host code. They take the
+*   ray in object space as returned by optixGetObjectRayOrigin/Direction: the direction is not
+*   normalized when the instance transform scales, and the returned t is in units of that
+*   direction, which makes it directly comparable with optixGetRayTmin/Tmax. The normal is the
+*   unnormalized outward geometric normal in object space.
+*/
+
+struct Sphere
+{
+    float3 center;
+    float  radius;
+};
+
+
+/*
+    Parallelogram anchor + a * edge1 + b * edge2 with a, b in [0, 1]. Besides the plane it stores the
+    dual basis of the edges, so the (a, b) coordinates of a point in the plane are two dot products
+    even when the edges are not orthogonal. Use makeParallelogram() to fill it in.
+*/
+struct Parallelogram
+{
+    float4 plane;    // unit normal (cross( edge1, edge2 ) direction) and distance from the origin
+    float3 anchor;
+    float3 dual1;    // dot( dual1, edge1 ) == 1, dot( dual1, edge2 ) == 0
+    float3 dual2;    // dot( dual2, edge2 ) == 1, dot( dual2, edge1 ) == 0
+};
+
+
+SUTIL_INLINE SUTIL_HOSTDEVICE Parallelogram makeParallelogram( const float3& anchor, const float3& edge1, const float3& edge2 )
+{
+    const float3 n = normalize( cross( edge1, edge2 ) );
+    const float3 c1 = cross( edge2, n );
+    const float3 c2 = cross( n, edge1 );
+
+    Parallelogram p;
+    p.plane  = make_float4( n, dot( n, anchor ) );
+    p.anchor = anchor;
+    p.dual1  = c1 / dot( edge1, c1 );
+    p.dual2  = c2 / dot( edge2, c2 );
+    return p;
+}
+
+
+SUTIL_INLINE SUTIL_HOSTDEVICE bool intersectSphere(
+        const Sphere& sphere,
+        const float3& ray_orig,
+        const float3& ray_dir,
+        float         ray_tmin,
+        float         ray_tmax,
+        float&        t,
+        float3&       normal )
+{
+    const float3 O = ray_orig - sphere.center;
+    const float  l = 1.0f / length( ray_dir );
+    const float3 D = ray_dir * l;
+    const float  r = sphere.radius;
+
+    float b    = dot( O, D );
+    float c    = dot( O, O ) - r * r;
+    float disc = b * b - c;
+    if( disc <= 0.0f )
+        return false;
+
+    float sdisc = sqrtf( disc );
+    float root1 = -b - sdisc;
+
+    // Far from the sphere the near root loses precision, restart the solve from the first estimate
+    float      root11    = 0.0f;
+    const bool do_refine = fabsf( root1 ) > 10.0f * r;
+    if( do_refine )
+    {
+        const float3 O1 = O + root1 * D;
+        b    = dot( O1, D );
+        c    = dot( O1, O1 ) - r * r;
+        disc = b * b - c;
+        if( disc > 0.0f )
+        {
+            sdisc  = sqrtf( disc );
+            root11 = -b - sdisc;
+        }
+    }
+
+    t = ( root1 + root11 ) * l;
+    if( t > ray_tmin && t < ray_tmax )
+    {
+        normal = ( O + ( root1 + root11 ) * D ) / r;
+        return true;
+    }
+
+    // Origin inside the sphere or the near hit lies before tmin
+    const float root2 = -b + sdisc + ( do_refine ? root1 : 0.0f );
+    t = root2 * l;
+    if( t > ray_tmin && t < ray_tmax )
+    {
+        normal = ( O + root2 * D ) / r;
+        return true;
+    }
+    return false;
+}
+
+
+SUTIL_INLINE SUTIL_HOSTDEVICE bool intersectParallelogram(
+        const Parallelogram& parallelogram,
+        const float3&        ray_orig,
+        const float3&        ray_dir,
+        float                ray_tmin,
+        float                ray_tmax,
+        float&               t,
+        float3&              normal )
+{
+    const float3 n  = make_float3( parallelogram.plane );
+    const float  dt = dot( ray_dir, n );
+    if( dt == 0.0f )
+        return false;
+
+    t = ( parallelogram.plane.w - dot( n, ray_orig ) ) / dt;
+    if( !( t > ray_tmin && t < ray_tmax ) )
+        return false;
+
+    const float3 vi = ray_orig + t * ray_dir - parallelogram.anchor;
+    const float  a1 = dot( parallelogram.dual1, vi );
+    const float  a2 = dot( parallelogram.dual2, vi );
+    if( a1 < 0.0f || a1 > 1.0f || a2 < 0.0f || a2 > 1.0f )
+        return false;
+
+    normal = n;
+    return true;
+}
+
+
+SUTIL_INLINE SUTIL_HOSTDEVICE void sphereBounds( const Sphere& sphere, float3& lo, float3& hi )
+{
+    lo = sphere.center - make_float3( sphere.radius );
+    hi = sphere.center + make_float3( sphere.radius );
+}
+
+
+SUTIL_INLINE SUTIL_HOSTDEVICE void parallelogramBounds( const float3& anchor, const float3& edge1, const float3& edge2, float3& lo, float3& hi )
+{
+    const float3 p1 = anchor + edge1;
+    const float3 p2 = anchor + edge2;
+    const float3 p3 = p1 + edge2;
+    lo = fminf( fminf( anchor, p1 ), fminf( p2, p3 ) );
+    hi = fmaxf( fmaxf( anchor, p1 ), fmaxf( p2, p3 ) );
+
+    // Give the box of an axis aligned parallelogram some thickness
+    const float pad = 1e-4f * length( hi - lo );
+    lo -= make_float3( pad );
+    hi += make_float3( pad );
+}
@@ -0,0 +1,254 @@
+//
+// analyticPrimitivesTest - host tests of the sphere and parallelogram intersection functions and their
+// bounds in AnalyticPrimitives.h, which the intersection programs share: hits from outside and inside,
+// misses, grazing rays, tmin/tmax clipping, unnormalized directions, parallelogram edges and back faces.
+//
+
+#include "AnalyticPrimitives.h"
+#include "HostTest.h"
+
+#include <cmath>
+#include <random>
+
+
+namespace {
+
+const float INF = 1e30f;
+
+Sphere makeSphere( float3 center, float radius )
+{
+    Sphere sphere;
+    sphere.center = center;
+    sphere.radius = radius;
+    return sphere;
+}
+
+bool near3( const float3& a, const float3& b, float tolerance )
+{
+    return length( a - b ) <= tolerance;
+}
+
+
+void testSphereHits()
+{
+    const Sphere sphere = makeSphere( make_float3( 1.0f, 2.0f, 3.0f ), 2.0f );
+    float        t;
+    float3       n;
+
+    // From outside: the near root and the outward normal
+    HOST_CHECK( intersectSphere( sphere, make_float3( 1.0f, 2.0f, -10.0f ), make_float3( 0.0f, 0.0f, 1.0f ), 0.0f, INF, t, n ) );
+    HOST_CHECK_NEAR( t, 11.0f, 1e-5 );
+    HOST_CHECK( near3( n, make_float3( 0.0f, 0.0f, -1.0f ), 1e-6f ) );
+
+    // t is in units of an unnormalized direction, as with a scaling instance transform
+    HOST_CHECK( intersectSphere( sphere, make_float3( 1.0f, 2.0f, -10.0f ), make_float3( 0.0f, 0.0f, 4.0f ), 0.0f, INF, t, n ) );
+    HOST_CHECK_NEAR( t, 2.75f, 1e-5 );
+    HOST_CHECK( near3( n, make_float3( 0.0f, 0.0f, -1.0f ), 1e-6f ) );
+
+    // From inside: the far root, normal still pointing out of the sphere
+    HOST_CHECK( intersectSphere( sphere, sphere.center, make_float3( 0.0f, 1.0f, 0.0f ), 0.0f, INF, t, n ) );
+    HOST_CHECK_NEAR( t, 2.0f, 1e-6 );
+    HOST_CHECK( near3( n, make_float3( 0.0f, 1.0f, 0.0f ), 1e-6f ) );
+    HOST_CHECK( intersectSphere( sphere, make_float3( 1.0f, 2.0f, 4.0f ), make_float3( 0.0f, 0.0f, -1.0f ), 0.0f, INF, t, n ) );
+    HOST_CHECK_NEAR( t, 3.0f, 1e-6 );
+    HOST_CHECK( near3( n, make_float3( 0.0f, 0.0f, -1.0f ), 1e-6f ) );
+
+    // Off axis: the hit point lies on the sphere and the normal is unit length
+    const float3 origin = make_float3( -4.0f, 3.0f, 1.0f );
+    const float3 dir    = make_float3( 1.0f, -0.1f, 0.3f );
+    HOST_CHECK( intersectSphere( sphere, origin, dir, 0.0f, INF, t, n ) );
+    HOST_CHECK_NEAR( length( origin + t * dir - sphere.center ), sphere.radius, 1e-5 );
+    HOST_CHECK_NEAR( length( n ), 1.0f, 1e-5 );
+    HOST_CHECK( near3( sphere.center + n * sphere.radius, origin + t * dir, 1e-5f ) );
+}
+
+
+void testSphereMissesAndClipping()
+{
+    const Sphere sphere = makeSphere( make_float3( 1.0f, 2.0f, 3.0f ), 2.0f );
+    const float3 origin = make_float3( 1.0f, 2.0f, -10.0f );
+    const float3 dir    = make_float3( 0.0f, 0.0f, 1.0f );
+    float        t;
+    float3       n;
+
+    // Passing beside the sphere, and the sphere behind the ray
+    HOST_CHECK( !intersectSphere( sphere, origin + make_float3( 2.5f, 0.0f, 0.0f ), dir, 0.0f, INF, t, n ) );
+    HOST_CHECK( !intersectSphere( sphere, origin, -dir, 0.0f, INF, t, n ) );
+
+    // Roots at 11 and 15: tmin past the near one returns the far one, tmax before the near one misses
+    HOST_CHECK( intersectSphere( sphere, origin, dir, 12.0f, INF, t, n ) );
+    HOST_CHECK_NEAR( t, 15.0f, 1e-5 );
+    HOST_CHECK( near3( n, make_float3( 0.0f, 0.0f, 1.0f ), 1e-6f ) );
+    HOST_CHECK( !intersectSphere( sphere, origin, dir, 0.0f, 10.0f, t, n ) );
+    HOST_CHECK( intersectSphere( sphere, origin, dir, 0.0f, 11.5f, t, n ) );
+    HOST_CHECK_NEAR( t, 11.0f, 1e-5 );
+    HOST_CHECK( !intersectSphere( sphere, origin, dir, 15.5f, INF, t, n ) );
+    HOST_CHECK( !intersectSphere( sphere, origin, dir, 11.5f, 14.5f, t, n ) );  // both roots outside [tmin, tmax]
+
+    // Grazing: the exact tangent does not count, just inside hits with nearly equal roots, just outside misses
+    HOST_CHECK( !intersectSphere( sphere, origin + make_float3( 2.0f, 0.0f, 0.0f ), dir, 0.0f, INF, t, n ) );
+    HOST_CHECK( intersectSphere( sphere, origin + make_float3( 1.999f, 0.0f, 0.0f ), dir, 0.0f, INF, t, n ) );
+    HOST_CHECK( std::fabs( t - 13.0f ) < 0.2f && n.x > 0.99f );
+    HOST_CHECK( !intersectSphere( sphere, origin + make_float3( 2.001f, 0.0f, 0.0f ), dir, 0.0f, INF, t, n ) );
+}
+
+
+void testSpherePrecision()
+{
+    // Hundreds of radii away the refinement keeps the hit on the surface
+    const Sphere sphere = makeSphere( make_float3( 0.0f, 0.0f, 0.0f ), 0.5f );
+    const float3 origin = make_float3( 0.1f, 0.2f, -200.0f );
+    float        t;
+    float3       n;
+    HOST_CHECK( intersectSphere( sphere, origin, make_float3( 0.0f, 0.0f, 1.0f ), 0.0f, INF, t, n ) );
+    HOST_CHECK_NEAR( origin.z + t, -std::sqrt( 0.25f - 0.05f ), 1e-4 );
+    HOST_CHECK( n.z < -0.85f );
+
+    // Random rays against a double precision reference, away from tangents and the tmin boundary
+    std::mt19937                          rng( 11 );
+    std::uniform_real_distribution<float> u( -3.0f, 3.0f );
+    int                                   mismatches = 0, hits = 0;
+    for( int i = 0; i < 20000; ++i )
+    {
+        const Sphere s    = makeSphere( make_float3( u( rng ), u( rng ), u( rng ) ) * 0.3f, 0.2f + 0.1f * std::fabs( u( rng ) ) );
+        const float3 o    = make_float3( u( rng ), u( rng ), u( rng ) );
+        const float3 aim  = s.center + make_float3( u( rng ), u( rng ), u( rng ) ) * 0.2f;  // about half of the rays hit
+        const float3 d    = ( aim - o ) * ( 0.1f + std::fabs( u( rng ) ) );
+        const float  tmin = i % 3 == 0 ? 0.5f : 0.0f;
+
+        const double ox = o.x - s.center.x, oy = o.y - s.center.y, oz = o.z - s.center.z;
+        const double a = d.x * d.x + d.y * d.y + d.z * d.z, b = ox * d.x + oy * d.y + oz * d.z;
+        const double c = ox * ox + oy * oy + oz * oz - s.radius * s.radius, disc = b * b - a * c;
+        double       reference = -1.0;
+        if( disc > 0.0 )
+        {
+            const double t1 = ( -b - std::sqrt( disc ) ) / a, t2 = ( -b + std::sqrt( disc ) ) / a;
+            reference       = t1 > tmin ? t1 : ( t2 > tmin ? t2 : -1.0 );
+            if( std::fabs( t1 - tmin ) < 1e-3 || std::fabs( t2 - tmin ) < 1e-3 || disc < 1e-4 * a )
+                continue;
+        }
+        float      t;
+        float3     n;
+        const bool hit = intersectSphere( s, o, d, tmin, INF, t, n );
+        hits += hit;
+        if( hit != ( reference > 0.0 ) || ( hit && std::fabs( t - reference ) > 1e-4 * std::fmax( 1.0, reference ) ) )
+            ++mismatches;
+    }
+    HOST_CHECK( mismatches == 0 );
+    HOST_CHECK( hits > 5000 );
+}
+
+
+// A skewed parallelogram in the z = 0 plane: (0,0,0) + a * (2,0,0) + b * (1,1,0)
+Parallelogram skewed()
+{
+    return makeParallelogram( make_float3( 0.0f, 0.0f, 0.0f ), make_float3( 2.0f, 0.0f, 0.0f ), make_float3( 1.0f, 1.0f, 0.0f ) );
+}
+
+// The point with parallelogram coordinates (a, b), seen from above
+bool hitsAt( const Parallelogram& p, float a, float b, float& t )
+{
+    const float3 target = make_float3( 2.0f * a + b, b, 0.0f );
+    float3       n;
+    return intersectParallelogram( p, target + make_float3( 0.0f, 0.0f, 5.0f ), make_float3( 0.0f, 0.0f, -1.0f ), 0.0f, INF, t, n );
+}
+
+
+void testParallelogram()
+{
+    const Parallelogram p = skewed();
+    HOST_CHECK( near3( make_float3( p.plane ), make_float3( 0.0f, 0.0f, 1.0f ), 1e-6f ) && p.plane.w == 0.0f );
+    float  t;
+    float3 n;
+
+    // Front face, from above
+    HOST_CHECK( intersectParallelogram( p, make_float3( 1.5f, 0.5f, 5.0f ), make_float3( 0.0f, 0.0f, -2.0f ), 0.0f, INF, t, n ) );
+    HOST_CHECK_NEAR( t, 2.5f, 1e-6 );
+    HOST_CHECK( near3( n, make_float3( 0.0f, 0.0f, 1.0f ), 1e-6f ) );
+
+    // Back face, from below: also a hit, the normal stays the geometric one
+    HOST_CHECK( intersectParallelogram( p, make_float3( 1.5f, 0.5f, -5.0f ), make_float3( 0.0f, 0.0f, 1.0f ), 0.0f, INF, t, n ) );
+    HOST_CHECK_NEAR( t, 5.0f, 1e-6 );
+    HOST_CHECK( near3( n, make_float3( 0.0f, 0.0f, 1.0f ), 1e-6f ) );
+
+    // Oblique ray
+    const float3 origin = make_float3( -1.0f, -2.0f, 3.0f );
+    const float3 dir    = make_float3( 2.5f, 2.5f, -3.0f );
+    HOST_CHECK( intersectParallelogram( p, origin, dir, 0.0f, INF, t, n ) );
+    HOST_CHECK_NEAR( t, 1.0f, 1e-6 );
+
+    // Parallel to the plane, in it or above it
+    HOST_CHECK( !intersectParallelogram( p, make_float3( -1.0f, 0.5f, 0.0f ), make_float3( 1.0f, 0.0f, 0.0f ), 0.0f, INF, t, n ) );
+    HOST_CHECK( !intersectParallelogram( p, make_float3( -1.0f, 0.5f, 1.0f ), make_float3( 1.0f, 0.0f, 0.0f ), 0.0f, INF, t, n ) );
+
+    // Clipping and the plane behind the ray
+    HOST_CHECK( !intersectParallelogram( p, make_float3( 1.5f, 0.5f, 5.0f ), make_float3( 0.0f, 0.0f, -1.0f ), 0.0f, 4.9f, t, n ) );
+    HOST_CHECK( !intersectParallelogram( p, make_float3( 1.5f, 0.5f, 5.0f ), make_float3( 0.0f, 0.0f, -1.0f ), 5.1f, INF, t, n ) );
+    HOST_CHECK( !intersectParallelogram( p, make_float3( 1.5f, 0.5f, 5.0f ), make_float3( 0.0f, 0.0f, 1.0f ), 0.0f, INF, t, n ) );
+}
+
+
+void testParallelogramEdges()
+{
+    const Parallelogram p = skewed();
+    float               t;
+
+    // Just inside and just outside each of the four edges, at the middle of the edge
+    const float e = 1e-3f;
+    HOST_CHECK( hitsAt( p, e, 0.5f, t ) && !hitsAt( p, -e, 0.5f, t ) );
+    HOST_CHECK( hitsAt( p, 1.0f - e, 0.5f, t ) && !hitsAt( p, 1.0f + e, 0.5f, t ) );
+    HOST_CHECK( hitsAt( p, 0.5f, e, t ) && !hitsAt( p, 0.5f, -e, t ) );
+    HOST_CHECK( hitsAt( p, 0.5f, 1.0f - e, t ) && !hitsAt( p, 0.5f, 1.0f + e, t ) );
+
+    // Corners count as inside
+    HOST_CHECK( hitsAt( p, 0.0f, 0.0f, t ) );
+    HOST_CHECK( hitsAt( p, 0.5f, 0.0f, t ) );
+
+    // Inside the bounding box but outside the skewed shape: the dual basis, not the box, decides
+    float3 n;
+    HOST_CHECK( !intersectParallelogram( p, make_float3( 0.2f, 0.9f, 5.0f ), make_float3( 0.0f, 0.0f, -1.0f ), 0.0f, INF, t, n ) );
+    HOST_CHECK( !intersectParallelogram( p, make_float3( 2.8f, 0.1f, 5.0f ), make_float3( 0.0f, 0.0f, -1.0f ), 0.0f, INF, t, n ) );
+    HOST_CHECK( intersectParallelogram( p, make_float3( 2.8f, 0.9f, 5.0f ), make_float3( 0.0f, 0.0f, -1.0f ), 0.0f, INF, t, n ) );
+
+    // Dual basis
+    HOST_CHECK_NEAR( dot( p.dual1, make_float3( 2.0f, 0.0f, 0.0f ) ), 1.0f, 1e-6 );
+    HOST_CHECK_NEAR( dot( p.dual1, make_float3( 1.0f, 1.0f, 0.0f ) ), 0.0f, 1e-6 );
+    HOST_CHECK_NEAR( dot( p.dual2, make_float3( 1.0f, 1.0f, 0.0f ) ), 1.0f, 1e-6 );
+    HOST_CHECK_NEAR( dot( p.dual2, make_float3( 2.0f, 0.0f, 0.0f ) ), 0.0f, 1e-6 );
+}
+
+
+void testBounds()
+{
+    float3 lo, hi;
+    sphereBounds( makeSphere( make_float3( 1.0f, -2.0f, 3.0f ), 0.5f ), lo, hi );
+    HOST_CHECK( near3( lo, make_float3( 0.5f, -2.5f, 2.5f ), 0.0f ) && near3( hi, make_float3( 1.5f, -1.5f, 3.5f ), 0.0f ) );
+
+    // Skewed parallelogram: the box of its four corners, padded
+    const float3 anchor = make_float3( 1.0f, 1.0f, 1.0f ), edge1 = make_float3( 2.0f, 0.0f, 1.0f ), edge2 = make_float3( -1.0f, 1.0f, 0.0f );
+    parallelogramBounds( anchor, edge1, edge2, lo, hi );
+    const float3 corners[4] = { anchor, anchor + edge1, anchor + edge2, anchor + edge1 + edge2 };
+    for( const float3& c : corners )
+        HOST_CHECK( c.x > lo.x && c.y > lo.y && c.z > lo.z && c.x < hi.x && c.y < hi.y && c.z < hi.z );
+    const float pad = 1e-4f * length( make_float3( 3.0f, 1.0f, 1.0f ) );
+    HOST_CHECK( near3( lo, make_float3( 0.0f, 1.0f, 1.0f ) - make_float3( pad ), 1e-6f ) );
+    HOST_CHECK( near3( hi, make_float3( 3.0f, 2.0f, 2.0f ) + make_float3( pad ), 1e-6f ) );
+
+    // An axis aligned parallelogram still gets a box with volume
+    parallelogramBounds( make_float3( -0.5f, 0.0f, -0.5f ), make_float3( 1.0f, 0.0f, 0.0f ), make_float3( 0.0f, 0.0f, 1.0f ), lo, hi );
+    HOST_CHECK( lo.y < 0.0f && hi.y > 0.0f );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testSphereHits();
+    testSphereMissesAndClipping();
+    testSpherePrecision();
+    testParallelogram();
+    testParallelogramEdges();
+    testBounds();
+    return hostTestResult( "analyticPrimitivesTest" );
+}
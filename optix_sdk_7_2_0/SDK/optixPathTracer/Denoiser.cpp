@@ -0,0 +1,299 @@
+#include "Denoiser.h"
+#include "HostImageUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 1 )
+#include <xmmintrin.h>
+#define DENOISER_USE_SSE
+#endif
+
+//------------------------------------------------------------------------------
+//
+// 4-wide float helpers - one pixel (rgb + variance) per register
+//
+//------------------------------------------------------------------------------
+
+#ifdef DENOISER_USE_SSE
+typedef __m128 vec4;
+static inline vec4 load4( const float* p )            { return _mm_loadu_ps( p ); }
+static inline void store4( float* p, vec4 v )         { _mm_storeu_ps( p, v ); }
+static inline vec4 splat4( float s )                  { return _mm_set1_ps( s ); }
+static inline vec4 set4( float x, float y, float z, float w ) { return _mm_set_ps( w, z, y, x ); }
+static inline vec4 add4( vec4 a, vec4 b )             { return _mm_add_ps( a, b ); }
+static inline vec4 mul4( vec4 a, vec4 b )             { return _mm_mul_ps( a, b ); }
+static inline vec4 div4( vec4 a, vec4 b )             { return _mm_div_ps( a, b ); }
+static inline vec4 max4( vec4 a, vec4 b )             { return _mm_max_ps( a, b ); }
+#else
+struct vec4 { float v[4]; };
+static inline vec4 load4( const float* p )            { vec4 r; for( int i = 0; i < 4; ++i ) r.v[i] = p[i]; return r; }
+static inline void store4( float* p, vec4 a )         { for( int i = 0; i < 4; ++i ) p[i] = a.v[i]; }
+static inline vec4 splat4( float s )                  { vec4 r; for( int i = 0; i < 4; ++i ) r.v[i] = s; return r; }
+static inline vec4 set4( float x, float y, float z, float w ) { vec4 r = { { x, y, z, w } }; return r; }
+static inline vec4 add4( vec4 a, vec4 b )             { for( int i = 0; i < 4; ++i ) a.v[i] += b.v[i]; return a; }
+static inline vec4 mul4( vec4 a, vec4 b )             { for( int i = 0; i < 4; ++i ) a.v[i] *= b.v[i]; return a; }
+static inline vec4 div4( vec4 a, vec4 b )             { for( int i = 0; i < 4; ++i ) a.v[i] /= b.v[i]; return a; }
+static inline vec4 max4( vec4 a, vec4 b )             { for( int i = 0; i < 4; ++i ) a.v[i] = std::max( a.v[i], b.v[i] ); return a; }
+#endif
+
+static const float ALBEDO_EPSILON = 1e-3f;
+static const float KERNEL_WEIGHTS[5] = { 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+
+static inline float luminance( float r, float g, float b )
+{
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+
+void Denoiser::resize( unsigned int width, unsigned int height )
+{
+    if( width == m_width && height == m_height )
+        return;
+
+    m_width  = width;
+    m_height = height;
+    const size_t num_pixels = static_cast<size_t>( width ) * height;
+    m_illum[0].assign( num_pixels * 4, 0.f );
+    m_illum[1].assign( num_pixels * 4, 0.f );
+    m_moments.assign( num_pixels * 2, 0.f );
+    m_history.assign( num_pixels, 0.f );
+    m_luminance.assign( num_pixels, 0.f );
+    m_history_valid = false;
+}
+
+
+void Denoiser::demodulate( const float4* color, const float4* albedo, unsigned int y0, unsigned int y1 )
+{
+    float* illum = m_illum[0].data();
+    for( unsigned int y = y0; y < y1; ++y )
+    {
+        for( unsigned int x = 0; x < m_width; ++x )
+        {
+            const size_t i = static_cast<size_t>( y ) * m_width + x;
+            const vec4 c = set4( color[i].x, color[i].y, color[i].z, 0.f );
+            const vec4 a = max4( set4( albedo[i].x, albedo[i].y, albedo[i].z, 1.f ), splat4( ALBEDO_EPSILON ) );
+            store4( &illum[i * 4], div4( c, a ) );
+
+            const float l = luminance( illum[i * 4 + 0], illum[i * 4 + 1], illum[i * 4 + 2] );
+            m_luminance[i] = l;
+
+            // Exponential moving average of the first two luminance moments. The blend factor starts
+            // as a cumulative average and is clamped to temporal_alpha once enough history exists.
+            const float history = m_history_valid ? m_history[i] + 1.f : 1.f;
+            const float alpha   = std::max( m_settings.temporal_alpha, 1.f / history );
+            float* moments = &m_moments[i * 2];
+            if( !m_history_valid )
+            {
+                moments[0] = l;
+                moments[1] = l * l;
+            }
+            else
+            {
+                moments[0] += ( l - moments[0] ) * alpha;
+                moments[1] += ( l * l - moments[1] ) * alpha;
+            }
+            m_history[i] = std::min( history, 255.f );
+        }
+    }
+}
+
+
+void Denoiser::estimateVariance( const float* depth, unsigned int y0, unsigned int y1 )
+{
+    float* illum = m_illum[0].data();
+    for( unsigned int y = y0; y < y1; ++y )
+    {
+        for( unsigned int x = 0; x < m_width; ++x )
+        {
+            const size_t i = static_cast<size_t>( y ) * m_width + x;
+            float variance;
+            if( m_history[i] >= 4.f )
+            {
+                variance = m_moments[i * 2 + 1] - m_moments[i * 2] * m_moments[i * 2];
+            }
+            else
+            {
+                // Not enough temporal samples yet - estimate the variance from the 3x3 neighbourhood
+                float sum = 0.f, sum_sq = 0.f, count = 0.f;
+                for( int dy = -1; dy <= 1; ++dy )
+                {
+                    for( int dx = -1; dx <= 1; ++dx )
+                    {
+                        const int qx = static_cast<int>( x ) + dx;
+                        const int qy = static_cast<int>( y ) + dy;
+                        if( qx < 0 || qy < 0 || qx >= static_cast<int>( m_width ) || qy >= static_cast<int>( m_height ) )
+                            continue;
+                        const size_t q = static_cast<size_t>( qy ) * m_width + qx;
+                        if( depth[q] <= 0.f )
+                            continue;
+                        sum    += m_luminance[q];
+                        sum_sq += m_luminance[q] * m_luminance[q];
+                        count  += 1.f;
+                    }
+                }
+                variance = count > 0.f ? sum_sq / count - ( sum / count ) * ( sum / count ) : 0.f;
+                // Boost the variance of young pixels so the filter is more aggressive there
+                variance *= 4.f / m_history[i];
+            }
+            illum[i * 4 + 3] = std::max( variance, 0.f );
+        }
+    }
+}
+
+
+void Denoiser::atrousPass( int step, const float4* normal, const float* depth, unsigned int y0, unsigned int y1 )
+{
+    const float* src = m_illum[m_src].data();
+    float*       dst = m_illum[1 - m_src].data();
+    const int    w   = static_cast<int>( m_width );
+    const int    h   = static_cast<int>( m_height );
+
+    for( unsigned int y = y0; y < y1; ++y )
+    {
+        for( int x = 0; x < w; ++x )
+        {
+            const size_t p = static_cast<size_t>( y ) * m_width + x;
+            const float  z_p = depth[p];
+            if( z_p <= 0.f )
+            {
+                store4( &dst[p * 4], load4( &src[p * 4] ) );
+                continue;
+            }
+
+            // 3x3 gaussian prefilter of the variance used by the luminance edge-stopping function
+            float var_p = 0.f, var_weight = 0.f;
+            for( int dy = -1; dy <= 1; ++dy )
+            {
+                for( int dx = -1; dx <= 1; ++dx )
+                {
+                    const int qx = std::min( std::max( x + dx, 0 ), w - 1 );
+                    const int qy = std::min( std::max( static_cast<int>( y ) + dy, 0 ), h - 1 );
+                    const float k = ( dx == 0 ? 0.5f : 0.25f ) * ( dy == 0 ? 0.5f : 0.25f );
+                    var_p      += k * src[( static_cast<size_t>( qy ) * m_width + qx ) * 4 + 3];
+                    var_weight += k;
+                }
+            }
+            var_p /= var_weight;
+
+            const float  l_p     = luminance( src[p * 4 + 0], src[p * 4 + 1], src[p * 4 + 2] );
+            const float  l_scale = 1.f / ( m_settings.sigma_luminance * std::sqrt( var_p ) + 1e-4f );
+            const float4 n_p     = normal[p];
+
+            // Screen space depth gradient, used to make the depth test robust on slanted surfaces
+            const float z_left = x > 0 ? depth[p - 1] : 0.f;
+            const float z_up   = y > 0 ? depth[p - m_width] : 0.f;
+            const float z_gradient = std::max( z_left > 0.f ? std::fabs( z_p - z_left ) : 0.f,
+                                               z_up   > 0.f ? std::fabs( z_p - z_up )   : 0.f );
+
+            vec4  sum     = load4( &src[p * 4] );
+            float sum_w   = 1.f;
+            float sum_w_2 = 1.f;
+            // The center tap is added with weight h[2]*h[2] relative to itself - normalize everything by it
+            const float center_k = KERNEL_WEIGHTS[2] * KERNEL_WEIGHTS[2];
+
+            for( int ky = -2; ky <= 2; ++ky )
+            {
+                const int qy = static_cast<int>( y ) + ky * step;
+                if( qy < 0 || qy >= h )
+                    continue;
+                for( int kx = -2; kx <= 2; ++kx )
+                {
+                    const int qx = x + kx * step;
+                    if( qx < 0 || qx >= w || ( kx == 0 && ky == 0 ) )
+                        continue;
+
+                    const size_t q   = static_cast<size_t>( qy ) * m_width + qx;
+                    const float  z_q = depth[q];
+                    if( z_q <= 0.f )
+                        continue;
+
+                    const float4 n_q   = normal[q];
+                    const float  n_dot = n_p.x * n_q.x + n_p.y * n_q.y + n_p.z * n_q.z;
+                    if( n_dot <= 0.f )
+                        continue;
+                    // pow( n_dot, sigma_normal ) folded into the exponential below
+                    const float w_n = m_settings.sigma_normal * std::log( n_dot );
+
+                    const float dist = static_cast<float>( step ) * std::sqrt( static_cast<float>( kx * kx + ky * ky ) );
+                    const float w_z  = std::fabs( z_p - z_q ) / ( m_settings.sigma_depth * z_gradient * dist + 1e-3f );
+
+                    const float l_q = luminance( src[q * 4 + 0], src[q * 4 + 1], src[q * 4 + 2] );
+                    const float w_l = std::fabs( l_p - l_q ) * l_scale;
+
+                    const float k      = KERNEL_WEIGHTS[kx + 2] * KERNEL_WEIGHTS[ky + 2] / center_k;
+                    const float weight = k * std::exp( w_n - w_z - w_l );
+
+                    // Color is filtered with w, variance with w^2
+                    sum = add4( sum, mul4( load4( &src[q * 4] ), set4( weight, weight, weight, weight * weight ) ) );
+                    sum_w   += weight;
+                    sum_w_2 += weight * weight;
+                }
+            }
+
+            store4( &dst[p * 4], div4( sum, set4( sum_w, sum_w, sum_w, sum_w_2 ) ) );
+        }
+    }
+}
+
+
+void Denoiser::remodulate( const float4* color, const float4* albedo, const float* depth, uchar4* out, unsigned int y0, unsigned int y1 )
+{
+    const float* illum = m_illum[m_src].data();
+    for( unsigned int y = y0; y < y1; ++y )
+    {
+        for( unsigned int x = 0; x < m_width; ++x )
+        {
+            const size_t i = static_cast<size_t>( y ) * m_width + x;
+            float c[4];
+            if( depth[i] <= 0.f )
+            {
+                c[0] = color[i].x;
+                c[1] = color[i].y;
+                c[2] = color[i].z;
+            }
+            else
+            {
+                const vec4 a = max4( set4( albedo[i].x, albedo[i].y, albedo[i].z, 0.f ), splat4( ALBEDO_EPSILON ) );
+                store4( c, mul4( load4( &illum[i * 4] ), a ) );
+            }
+            out[i].x = toSRGB8( c[0] );
+            out[i].y = toSRGB8( c[1] );
+            out[i].z = toSRGB8( c[2] );
+            out[i].w = 255u;
+        }
+    }
+}
+
+
+void Denoiser::filter( unsigned int width,
+                       unsigned int height,
+                       const float4* color,
+                       const float4* albedo,
+                       const float4* normal,
+                       const float*  depth,
+                       uchar4*       out )
+{
+    const auto t0 = std::chrono::steady_clock::now();
+
+    resize( width, height );
+    if( m_width == 0 || m_height == 0 )
+        return;
+
+    parallelRows( m_height, m_settings.num_threads, [&]( unsigned int y0, unsigned int y1 ) { demodulate( color, albedo, y0, y1 ); } );
+    parallelRows( m_height, m_settings.num_threads, [&]( unsigned int y0, unsigned int y1 ) { estimateVariance( depth, y0, y1 ); } );
+    m_history_valid = true;
+
+    m_src = 0;
+    for( int i = 0; i < m_settings.iterations; ++i )
+    {
+        parallelRows( m_height, m_settings.num_threads, [&]( unsigned int y0, unsigned int y1 ) { atrousPass( 1 << i, normal, depth, y0, y1 ); } );
+        m_src = 1 - m_src;
+    }
+
+    parallelRows( m_height, m_settings.num_threads, [&]( unsigned int y0, unsigned int y1 ) { remodulate( color, albedo, depth, out, y0, y1 ); } );
+
+    const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - t0;
+    m_last_filter_time_ms = elapsed.count();
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <vector_types.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+       * Edge-aware a-trous wavelet filter (SVGF style) for the accumulated path traced frame.
+       *
+       * The filter demodulates the first-hit albedo from the radiance, estimates the luminance
+       * variance per pixel from temporally accumulated moments (falling back to a spatial estimate
+       * while the history is short), then runs a number of a-trous iterations whose weights are
+       * stopped by luminance, normal and depth differences. Rows are distributed over worker
+       * threads and the per-pixel color math uses SSE when it is available.
+       *
+       * Reference: Schied et al. 2017, "Spatiotemporal Variance-Guided Filtering"
+*/
+class Denoiser
+{
+public:
+    struct Settings
+    {
+        int          iterations     = 5;      // number of a-trous passes, tap distance doubles every pass
+        float        sigma_luminance = 4.f;   // luminance edge-stopping strength (scaled by std deviation)
+        float        sigma_normal   = 128.f;  // exponent of the normal similarity term
+        float        sigma_depth    = 1.f;    // depth edge-stopping strength (scaled by local depth gradient)
+        float        temporal_alpha = 0.2f;   // minimum blend factor of the temporal moments
+        unsigned int num_threads    = 0;      // 0 means std::thread::hardware_concurrency()
+    };
+
+    Denoiser() = default;
+    explicit Denoiser( const Settings& settings ) : m_settings( settings ) {}
+
+    Settings&       settings()       { return m_settings; }
+    const Settings& settings() const { return m_settings; }
+
+    // Drop the temporal moments, e.g. when the accumulation has been restarted
+    void resetHistory() { m_history_valid = false; }
+
+    /**
+     * Filter one frame. All buffers are width*height pixels in row-major order.
+     *   color  - accumulated radiance
+     *   albedo - first-hit albedo, used to demodulate texture/material detail out of the filter
+     *   normal - first-hit world space normal in xyz
+     *   depth  - first-hit distance along the primary ray, <= 0 for pixels that missed the scene
+     *   out    - sRGB 8 bit result, same encoding as make_color() in cuda/helpers.h
+     */
+    void filter( unsigned int width,
+                 unsigned int height,
+                 const float4* color,
+                 const float4* albedo,
+                 const float4* normal,
+                 const float*  depth,
+                 uchar4*       out );
+
+    // Wall clock time of the last filter() call in milliseconds
+    float lastFilterTime() const { return m_last_filter_time_ms; }
+
+    // Remove copy and move functions
+    Denoiser( const Denoiser& ) = delete;
+    Denoiser& operator=( const Denoiser& ) = delete;
+
+private:
+    void resize( unsigned int width, unsigned int height );
+    void demodulate( const float4* color, const float4* albedo, unsigned int y0, unsigned int y1 );
+    void estimateVariance( const float* depth, unsigned int y0, unsigned int y1 );
+    void atrousPass( int step, const float4* normal, const float* depth, unsigned int y0, unsigned int y1 );
+    void remodulate( const float4* color, const float4* albedo, const float* depth, uchar4* out, unsigned int y0, unsigned int y1 );
+
+    Settings           m_settings;
+    unsigned int       m_width  = 0;
+    unsigned int       m_height = 0;
+    bool               m_history_valid = false;
+    float              m_last_filter_time_ms = 0.f;
+
+    std::vector<float> m_illum[2];    // demodulated radiance, 4 floats per pixel (rgb + variance)
+    std::vector<float> m_moments;     // temporal luminance moments (mean, mean of squares)
+    std::vector<float> m_history;     // temporal history length per pixel
+    std::vector<float> m_luminance;   // luminance of the current demodulated frame
+    int                m_src = 0;     // index of the ping-pong buffer holding the current result
+};
@@ -0,0 +1,222 @@
+//
+// denoiserTest - host tests of the a-trous Denoiser on a synthetic noisy frame with known edges,
+// followed by a quality per millisecond report over the number of a-trous iterations.
+//
+// The frame shows two planes meeting at a vertical edge in the middle of the image, with different
+// normals, depths and radiance. The left plane also has an albedo edge. Gaussian noise is added to
+// the radiance; the filter has to remove most of it without blurring either edge.
+//
+
+#include "Denoiser.h"
+#include "HostImageUtils.h"
+#include "HostTest.h"
+
+#include <vector_functions.h>
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+struct Frame
+{
+    unsigned int        width;
+    unsigned int        height;
+    std::vector<float4> color;
+    std::vector<float4> clean;
+    std::vector<float4> albedo;
+    std::vector<float4> normal;
+    std::vector<float>  depth;
+};
+
+const float LEFT_RADIANCE  = 0.2f;
+const float RIGHT_RADIANCE = 0.6f;
+
+Frame makeFrame( unsigned int width, unsigned int height, float noise_sigma, unsigned int seed )
+{
+    Frame frame;
+    frame.width  = width;
+    frame.height = height;
+    const size_t num_pixels = static_cast<size_t>( width ) * height;
+    frame.color.resize( num_pixels );
+    frame.clean.resize( num_pixels );
+    frame.albedo.resize( num_pixels );
+    frame.normal.resize( num_pixels );
+    frame.depth.resize( num_pixels );
+
+    std::mt19937                    rng( seed );
+    std::normal_distribution<float> noise( 0.0f, noise_sigma );
+    for( unsigned int y = 0; y < height; ++y )
+    {
+        for( unsigned int x = 0; x < width; ++x )
+        {
+            const size_t i     = static_cast<size_t>( y ) * width + x;
+            const bool   right = x >= width / 2;
+            const float  a     = right ? 0.8f : ( x < width / 4 ? 0.9f : 0.3f );  // albedo edge at width/4
+            const float  c     = a * ( right ? RIGHT_RADIANCE : LEFT_RADIANCE );
+            frame.albedo[i] = make_float4( a, a, a, 1.0f );
+            frame.normal[i] = right ? make_float4( 0.6f, 0.0f, 0.8f, 0.0f ) : make_float4( 0.0f, 0.0f, 1.0f, 0.0f );
+            frame.depth[i]  = right ? 8.0f : 5.0f;
+            frame.clean[i]  = make_float4( c, c, c, 1.0f );
+
+            const float n = noise( rng );
+            frame.color[i] = make_float4( std::max( c + n, 0.0f ), std::max( c + n, 0.0f ), std::max( c + n, 0.0f ), 1.0f );
+        }
+    }
+    return frame;
+}
+
+// RMS error of an sRGB 8 bit image against the clean frame, over the columns [x0, x1)
+float rmsError( const Frame& frame, const std::vector<uchar4>& image, unsigned int x0, unsigned int x1 )
+{
+    double sum   = 0.0;
+    size_t count = 0;
+    for( unsigned int y = 0; y < frame.height; ++y )
+        for( unsigned int x = x0; x < x1; ++x )
+        {
+            const size_t i = static_cast<size_t>( y ) * frame.width + x;
+            const double d = static_cast<double>( image[i].x ) - toSRGB8( frame.clean[i].x );
+            sum += d * d;
+            ++count;
+        }
+    return static_cast<float>( std::sqrt( sum / count ) );
+}
+
+// Mean absolute error of one column against the clean frame, in sRGB 8 bit steps
+float columnError( const Frame& frame, const std::vector<uchar4>& image, unsigned int x )
+{
+    double sum = 0.0;
+    for( unsigned int y = 0; y < frame.height; ++y )
+    {
+        const size_t i = static_cast<size_t>( y ) * frame.width + x;
+        sum += std::fabs( static_cast<double>( image[i].x ) - toSRGB8( frame.clean[i].x ) );
+    }
+    return static_cast<float>( sum / frame.height );
+}
+
+std::vector<uchar4> noisyImage( const Frame& frame )
+{
+    std::vector<uchar4> image( frame.color.size() );
+    for( size_t i = 0; i < image.size(); ++i )
+    {
+        const unsigned char c = toSRGB8( frame.color[i].x );
+        image[i]              = make_uchar4( c, c, c, 255 );
+    }
+    return image;
+}
+
+std::vector<uchar4> denoise( const Frame& frame, Denoiser& denoiser )
+{
+    std::vector<uchar4> image( frame.color.size() );
+    denoiser.filter( frame.width, frame.height, frame.color.data(), frame.albedo.data(), frame.normal.data(),
+                     frame.depth.data(), image.data() );
+    return image;
+}
+
+
+void testNoiseDropsEdgesSurvive()
+{
+    const Frame               frame    = makeFrame( 128, 96, 0.05f, 1 );
+    const std::vector<uchar4> noisy    = noisyImage( frame );
+    Denoiser                  denoiser;
+    const std::vector<uchar4> filtered = denoise( frame, denoiser );
+
+    // Noise: well below the input on both planes
+    const unsigned int w = frame.width;
+    HOST_CHECK( rmsError( frame, filtered, 0, w / 2 ) < 0.35f * rmsError( frame, noisy, 0, w / 2 ) );
+    HOST_CHECK( rmsError( frame, filtered, w / 2, w ) < 0.35f * rmsError( frame, noisy, w / 2, w ) );
+
+    // Geometric edge: the columns on either side keep their own plane's value. A blur across the
+    // edge would move them by half the contrast, about 60 steps.
+    HOST_CHECK( columnError( frame, filtered, w / 2 - 1 ) < 6.0f );
+    HOST_CHECK( columnError( frame, filtered, w / 2 ) < 6.0f );
+
+    // Albedo edge on a single plane: demodulation keeps it sharp
+    HOST_CHECK( columnError( frame, filtered, w / 4 - 1 ) < 6.0f );
+    HOST_CHECK( columnError( frame, filtered, w / 4 ) < 6.0f );
+}
+
+
+void testMissedPixelsPassThrough()
+{
+    Frame frame = makeFrame( 32, 32, 0.05f, 2 );
+    for( unsigned int y = 0; y < frame.height; ++y )
+        frame.depth[y * frame.width + 5] = 0.0f;
+
+    Denoiser                  denoiser;
+    const std::vector<uchar4> filtered = denoise( frame, denoiser );
+    for( unsigned int y = 0; y < frame.height; ++y )
+    {
+        const size_t i = y * frame.width + 5;
+        HOST_CHECK( filtered[i].x == toSRGB8( frame.color[i].x ) );
+    }
+}
+
+
+void testTemporalHistory()
+{
+    // Later frames use the accumulated moments instead of the spatial variance estimate. Filtering
+    // independent noisy frames of the same scene must stay at least as good as the first frame.
+    Denoiser    denoiser;
+    const Frame first    = makeFrame( 96, 64, 0.05f, 3 );
+    const float first_error = rmsError( first, denoise( first, denoiser ), 0, first.width );
+    float       last_error  = 0.0f;
+    for( unsigned int i = 0; i < 6; ++i )
+    {
+        const Frame frame = makeFrame( 96, 64, 0.05f, 10 + i );
+        last_error        = rmsError( frame, denoise( frame, denoiser ), 0, frame.width );
+    }
+    HOST_CHECK( last_error < 1.25f * first_error );
+
+    denoiser.resetHistory();
+    const float reset_error = rmsError( first, denoise( first, denoiser ), 0, first.width );
+    HOST_CHECK_NEAR( reset_error, first_error, 1e-6 );
+}
+
+
+// Error reduction against filter time for 0 to 5 a-trous iterations, at 640x360
+void reportQualityPerMillisecond()
+{
+    const Frame               frame = makeFrame( 640, 360, 0.05f, 4 );
+    const float               noisy = rmsError( frame, noisyImage( frame ), 0, frame.width );
+
+    std::cout << "640x360, input RMS error " << std::fixed << std::setprecision( 2 ) << noisy << " (sRGB steps)\n";
+    std::cout << "iterations   RMS error   edge error    time ms   error removed per ms\n";
+    for( int iterations = 0; iterations <= 5; ++iterations )
+    {
+        Denoiser denoiser;
+        denoiser.settings().iterations = iterations;
+        denoise( frame, denoiser );  // warm up the buffers and threads
+
+        float               time_ms = 0.0f;
+        std::vector<uchar4> filtered;
+        const int           runs = 2;
+        for( int run = 0; run < runs; ++run )
+        {
+            denoiser.resetHistory();
+            filtered = denoise( frame, denoiser );
+            time_ms += denoiser.lastFilterTime() / runs;
+        }
+        const float error      = rmsError( frame, filtered, 0, frame.width );
+        const float edge_error = 0.5f * ( columnError( frame, filtered, frame.width / 2 - 1 ) + columnError( frame, filtered, frame.width / 2 ) );
+        std::cout << std::setw( 10 ) << iterations << std::setw( 12 ) << error << std::setw( 13 ) << edge_error
+                  << std::setw( 11 ) << time_ms << std::setw( 23 ) << ( noisy - error ) / time_ms << "\n";
+    }
+    std::cout << std::flush;
+}
+
+}  // namespace
+
+
+int main()
+{
+    testNoiseDropsEdgesSurvive();
+    testMissedPixelsPassThrough();
+    testTemporalHistory();
+    reportQualityPerMillisecond();
+    return hostTestResult( "denoiserTest" );
+}
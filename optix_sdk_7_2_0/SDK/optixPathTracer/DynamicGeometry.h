@@ -0,0 +1,189 @@
+#pragma once
+
+#include <sutil/vec_math.h>
+
+#include <cmath>
+#include <vector>
+
+/*
+*   Host-side bookkeeping for meshes whose vertices move at runtime.
+*
+*   A refit (OPTIX_BUILD_OPERATION_UPDATE) keeps the BVH topology of the last full build and only
+*   recomputes the node bounds, so it is much cheaper than a rebuild but the tree gets looser the further
+*   the vertices move relative to each other from the positions it was built for. RefitTracker estimates
+*   that degradation as the mean vertex deformation since the last full build relative to the mean edge
+*   length at that build: once vertices have on average moved further than the threshold (in edge
+*   lengths), the GAS is rebuilt. Deformation is measured after the best rigid motion of the build
+*   positions onto the current ones (Horn's closed form absolute orientation), so a mesh that is only
+*   translated or rotated as a whole keeps being refit.
+*/
+
+namespace dynamic_geometry_detail
+{
+
+// Unit eigenvector of the largest eigenvalue of the symmetric 4x4 matrix a, by cyclic Jacobi rotations.
+// a is overwritten.
+inline void largestEigenvector( double a[4][4], double result[4] )
+{
+    double v[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+    for( int sweep = 0; sweep < 50; ++sweep )
+    {
+        double off = 0.0, diagonal = 0.0;
+        for( int p = 0; p < 4; ++p )
+        {
+            diagonal += a[p][p] * a[p][p];
+            for( int q = p + 1; q < 4; ++q )
+                off += a[p][q] * a[p][q];
+        }
+        if( off <= 1e-24 * diagonal || off == 0.0 )
+            break;
+
+        for( int p = 0; p < 3; ++p )
+        {
+            for( int q = p + 1; q < 4; ++q )
+            {
+                if( a[p][q] == 0.0 )
+                    continue;
+                // Rotation in the (p, q) plane that zeroes a[p][q]
+                const double theta = ( a[q][q] - a[p][p] ) / ( 2.0 * a[p][q] );
+                const double t     = ( theta >= 0.0 ? 1.0 : -1.0 ) / ( std::fabs( theta ) + std::sqrt( theta * theta + 1.0 ) );
+                const double c     = 1.0 / std::sqrt( t * t + 1.0 );
+                const double s     = t * c;
+                for( int k = 0; k < 4; ++k )
+                {
+                    const double kp = a[k][p], kq = a[k][q];
+                    a[k][p] = c * kp - s * kq;
+                    a[k][q] = s * kp + c * kq;
+                }
+                for( int k = 0; k < 4; ++k )
+                {
+                    const double pk = a[p][k], qk = a[q][k];
+                    a[p][k] = c * pk - s * qk;
+                    a[q][k] = s * pk + c * qk;
+                }
+                for( int k = 0; k < 4; ++k )
+                {
+                    const double kp = v[k][p], kq = v[k][q];
+                    v[k][p] = c * kp - s * kq;
+                    v[k][q] = s * kp + c * kq;
+                }
+            }
+        }
+    }
+
+    int largest = 0;
+    for( int i = 1; i < 4; ++i )
+        if( a[i][i] > a[largest][largest] )
+            largest = i;
+    for( int k = 0; k < 4; ++k )
+        result[k] = v[k][largest];
+}
+
+}  // namespace dynamic_geometry_detail
+
+
+class RefitTracker
+{
+public:
+    explicit RefitTracker( float threshold = 1.0f ) : m_threshold( threshold ) {}
+
+    float threshold() const { return m_threshold; }
+    void  setThreshold( float threshold ) { m_threshold = threshold; }
+
+    // Record the positions a full build was made from
+    void rebuilt( const std::vector<float3>& positions, const std::vector<uint3>& indices )
+    {
+        m_build_positions = positions;
+        m_refits          = 0;
+
+        double sum = 0.0;
+        for( const uint3& tri : indices )
+        {
+            sum += length( positions[tri.y] - positions[tri.x] );
+            sum += length( positions[tri.z] - positions[tri.y] );
+            sum += length( positions[tri.x] - positions[tri.z] );
+        }
+        m_mean_edge_length = indices.empty() ? 0.0f : static_cast<float>( sum / ( 3.0 * indices.size() ) );
+    }
+
+    // Mean deformation since the last full build in units of the mean edge length: the mean distance of
+    // the positions from the build positions moved by the rotation and translation that fit them best
+    float degradation( const std::vector<float3>& positions ) const
+    {
+        if( positions.size() != m_build_positions.size() || positions.empty() || m_mean_edge_length <= 0.0f )
+            return 0.0f;
+
+        const size_t n = positions.size();
+        double       from_center[3] = { 0.0, 0.0, 0.0 };
+        double       to_center[3]   = { 0.0, 0.0, 0.0 };
+        for( size_t i = 0; i < n; ++i )
+        {
+            const float3& from = m_build_positions[i];
+            const float3& to   = positions[i];
+            from_center[0] += from.x;
+            from_center[1] += from.y;
+            from_center[2] += from.z;
+            to_center[0] += to.x;
+            to_center[1] += to.y;
+            to_center[2] += to.z;
+        }
+        for( int c = 0; c < 3; ++c )
+        {
+            from_center[c] /= n;
+            to_center[c] /= n;
+        }
+
+        // Cross covariance of the centered point sets, S[a][b] = sum of from_a * to_b
+        double S[3][3] = {};
+        for( size_t i = 0; i < n; ++i )
+        {
+            const double from[3] = { m_build_positions[i].x - from_center[0], m_build_positions[i].y - from_center[1],
+                                     m_build_positions[i].z - from_center[2] };
+            const double to[3]   = { positions[i].x - to_center[0], positions[i].y - to_center[1], positions[i].z - to_center[2] };
+            for( int a = 0; a < 3; ++a )
+                for( int b = 0; b < 3; ++b )
+                    S[a][b] += from[a] * to[b];
+        }
+
+        // The best rotation is the quaternion of the largest eigenvalue of Horn's symmetric matrix
+        double N[4][4] = {
+            { S[0][0] + S[1][1] + S[2][2], S[1][2] - S[2][1], S[2][0] - S[0][2], S[0][1] - S[1][0] },
+            { S[1][2] - S[2][1], S[0][0] - S[1][1] - S[2][2], S[0][1] + S[1][0], S[2][0] + S[0][2] },
+            { S[2][0] - S[0][2], S[0][1] + S[1][0], -S[0][0] + S[1][1] - S[2][2], S[1][2] + S[2][1] },
+            { S[0][1] - S[1][0], S[2][0] + S[0][2], S[1][2] + S[2][1], -S[0][0] - S[1][1] + S[2][2] } };
+        double q[4];
+        dynamic_geometry_detail::largestEigenvector( N, q );
+        const double w = q[0], x = q[1], y = q[2], z = q[3];
+        const double R[3][3] = { { 1 - 2 * ( y * y + z * z ), 2 * ( x * y - w * z ), 2 * ( x * z + w * y ) },
+                                 { 2 * ( x * y + w * z ), 1 - 2 * ( x * x + z * z ), 2 * ( y * z - w * x ) },
+                                 { 2 * ( x * z - w * y ), 2 * ( y * z + w * x ), 1 - 2 * ( x * x + y * y ) } };
+
+        double sum = 0.0;
+        for( size_t i = 0; i < n; ++i )
+        {
+            const double from[3] = { m_build_positions[i].x - from_center[0], m_build_positions[i].y - from_center[1],
+                                     m_build_positions[i].z - from_center[2] };
+            const double to[3]   = { positions[i].x - to_center[0], positions[i].y - to_center[1], positions[i].z - to_center[2] };
+            double       d2      = 0.0;
+            for( int a = 0; a < 3; ++a )
+            {
+                const double d = to[a] - ( R[a][0] * from[0] + R[a][1] * from[1] + R[a][2] * from[2] );
+                d2 += d * d;
+            }
+            sum += std::sqrt( d2 );
+        }
+        return static_cast<float>( sum / n ) / m_mean_edge_length;
+    }
+
+    // Returns true if the GAS should be rebuilt rather than refit for these positions
+    bool needsRebuild( const std::vector<float3>& positions ) const { return degradation( positions ) > m_threshold; }
+
+    void         refitted() { ++m_refits; }
+    unsigned int refitsSinceBuild() const { return m_refits; }
+
+private:
+    float               m_threshold;
+    float               m_mean_edge_length = 0.0f;
+    unsigned int        m_refits           = 0;
+    std::vector<float3> m_build_positions;
+};
@@ -0,0 +1,144 @@
+//
+// dynamicGeometryTest - host tests of RefitTracker in DynamicGeometry.h: rigid motions of a whole mesh
+// keep it refitting, deformation is measured in mean edge lengths whatever rigid motion comes with it.
+//
+
+#include "DynamicGeometry.h"
+#include "HostTest.h"
+
+#include <cmath>
+#include <vector>
+
+
+namespace {
+
+// A 16x16 vertex grid in the xy plane with unit spacing and a gentle bump, two triangles per quad
+void makeGrid( std::vector<float3>& positions, std::vector<uint3>& indices )
+{
+    const unsigned int n = 16;
+    positions.clear();
+    indices.clear();
+    for( unsigned int y = 0; y < n; ++y )
+        for( unsigned int x = 0; x < n; ++x )
+            positions.push_back( make_float3( static_cast<float>( x ), static_cast<float>( y ), 0.3f * std::sin( 0.4f * x ) * std::cos( 0.3f * y ) ) );
+    for( unsigned int y = 0; y + 1 < n; ++y )
+        for( unsigned int x = 0; x + 1 < n; ++x )
+        {
+            const unsigned int i = y * n + x;
+            indices.push_back( make_uint3( i, i + 1, i + n + 1 ) );
+            indices.push_back( make_uint3( i, i + n + 1, i + n ) );
+        }
+}
+
+// Rotation by angle around a unit axis (Rodrigues), then a translation
+std::vector<float3> rigidMotion( const std::vector<float3>& positions, float3 axis, float angle, float3 offset )
+{
+    axis = normalize( axis );
+    const float         c = std::cos( angle ), s = std::sin( angle );
+    std::vector<float3> moved;
+    for( const float3& p : positions )
+        moved.push_back( p * c + cross( axis, p ) * s + axis * dot( axis, p ) * ( 1.0f - c ) + offset );
+    return moved;
+}
+
+float meanEdgeLength( const std::vector<float3>& positions, const std::vector<uint3>& indices )
+{
+    double sum = 0.0;
+    for( const uint3& t : indices )
+        sum += length( positions[t.y] - positions[t.x] ) + length( positions[t.z] - positions[t.y] ) + length( positions[t.x] - positions[t.z] );
+    return static_cast<float>( sum / ( 3.0 * indices.size() ) );
+}
+
+
+void testRigidMotionKeepsRefitting()
+{
+    std::vector<float3> positions;
+    std::vector<uint3>  indices;
+    makeGrid( positions, indices );
+    RefitTracker tracker( 0.25f );
+    tracker.rebuilt( positions, indices );
+    HOST_CHECK_NEAR( tracker.degradation( positions ), 0.0f, 1e-6 );
+
+    // A translation by many mesh sizes
+    const std::vector<float3> translated = rigidMotion( positions, make_float3( 0.0f, 0.0f, 1.0f ), 0.0f, make_float3( 100.0f, -40.0f, 7.0f ) );
+    HOST_CHECK_NEAR( tracker.degradation( translated ), 0.0f, 1e-4 );
+    HOST_CHECK( !tracker.needsRebuild( translated ) );
+
+    // Rotations around skewed axes, a half turn included where the quaternion has no real part
+    const float angles[] = { 0.1f, 1.0f, 2.5f, 3.14159265f };
+    for( float angle : angles )
+    {
+        const std::vector<float3> rotated = rigidMotion( positions, make_float3( 0.3f, -1.0f, 0.5f ), angle, make_float3( 3.0f, 2.0f, 1.0f ) );
+        HOST_CHECK_NEAR( tracker.degradation( rotated ), 0.0f, 1e-4 );
+        HOST_CHECK( !tracker.needsRebuild( rotated ) );
+    }
+}
+
+
+void testDeformation()
+{
+    std::vector<float3> positions;
+    std::vector<uint3>  indices;
+    makeGrid( positions, indices );
+    RefitTracker tracker( 0.25f );
+    tracker.rebuilt( positions, indices );
+    const float edge = meanEdgeLength( positions, indices );
+
+    // Every vertex pushed out of the plane by d in a checkerboard: no rigid motion undoes that, the
+    // best fit leaves the grid in place and the mean deformation is d
+    for( float d : { 0.05f, 0.2f, 0.5f } )
+    {
+        std::vector<float3> bumped = positions;
+        for( size_t i = 0; i < bumped.size(); ++i )
+            bumped[i].z += ( ( i % 16 ) + ( i / 16 ) ) % 2 ? d : -d;
+        HOST_CHECK_NEAR( tracker.degradation( bumped ), d / edge, 1e-3 );
+        HOST_CHECK( tracker.needsRebuild( bumped ) == ( d / edge > 0.25f ) );
+
+        // The same deformation carried along with a rigid motion measures the same
+        const std::vector<float3> moved = rigidMotion( bumped, make_float3( 1.0f, 1.0f, 0.2f ), 0.8f, make_float3( -9.0f, 4.0f, 30.0f ) );
+        HOST_CHECK_NEAR( tracker.degradation( moved ), d / edge, 1e-3 );
+    }
+
+    // A rebuild makes the deformed positions the new reference
+    std::vector<float3> bent = positions;
+    for( float3& p : bent )
+        p.z += 0.05f * p.x * p.x;
+    HOST_CHECK( tracker.needsRebuild( bent ) );
+    tracker.rebuilt( bent, indices );
+    HOST_CHECK( !tracker.needsRebuild( bent ) );
+}
+
+
+void testBookkeeping()
+{
+    std::vector<float3> positions;
+    std::vector<uint3>  indices;
+    makeGrid( positions, indices );
+
+    // Nothing recorded, mismatched vertex counts and empty meshes do not ask for a rebuild
+    RefitTracker tracker;
+    HOST_CHECK( tracker.degradation( positions ) == 0.0f );
+    tracker.rebuilt( positions, indices );
+    HOST_CHECK( tracker.degradation( std::vector<float3>( positions.begin(), positions.end() - 1 ) ) == 0.0f );
+    HOST_CHECK( tracker.degradation( std::vector<float3>() ) == 0.0f );
+
+    tracker.refitted();
+    tracker.refitted();
+    HOST_CHECK( tracker.refitsSinceBuild() == 2 );
+    tracker.rebuilt( positions, indices );
+    HOST_CHECK( tracker.refitsSinceBuild() == 0 );
+
+    tracker.setThreshold( 3.0f );
+    HOST_CHECK( tracker.threshold() == 3.0f );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testRigidMotionKeepsRefitting();
+    testDeformation();
+    testBookkeeping();
+    return hostTestResult( "dynamicGeometryTest" );
+}
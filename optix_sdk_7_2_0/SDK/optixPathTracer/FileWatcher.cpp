@@ -0,0 +1,145 @@
+#include "FileWatcher.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined( __linux__ )
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+static std::pair<std::string, std::string> splitPath( const std::string& file )
+{
+    const size_t slash = file.find_last_of( "/\\" );
+    if( slash == std::string::npos )
+        return std::make_pair( std::string( "." ), file );
+    return std::make_pair( slash == 0 ? std::string( "/" ) : file.substr( 0, slash ), file.substr( slash + 1 ) );
+}
+
+
+FileWatcher::FileWatcher( std::chrono::milliseconds settle )
+    : m_settle( settle )
+{
+#if defined( __linux__ )
+    m_inotify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+#endif
+}
+
+
+FileWatcher::~FileWatcher()
+{
+#if defined( __linux__ )
+    if( m_inotify >= 0 )
+        close( m_inotify );
+#endif
+}
+
+
+void FileWatcher::watch( const std::vector<std::string>& files )
+{
+    m_files = files;
+    m_names.clear();
+    m_pending = false;
+
+#if defined( __linux__ )
+    if( m_inotify >= 0 )
+    {
+        for( const std::pair<int, std::string>& directory : m_directories )
+            inotify_rm_watch( m_inotify, directory.first );
+        m_directories.clear();
+
+        std::set<std::string> directories;
+        for( const std::string& file : files )
+        {
+            const std::pair<std::string, std::string> path = splitPath( file );
+            m_names.insert( path );
+            if( !directories.insert( path.first ).second )
+                continue;
+            const int wd = inotify_add_watch( m_inotify, path.first.c_str(),
+                                              IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM );
+            if( wd >= 0 )
+                m_directories.push_back( std::make_pair( wd, path.first ) );
+        }
+        readEvents();  // drop what happened before
+        m_pending = false;
+        return;
+    }
+#endif
+
+    m_stamps.clear();
+    for( const std::string& file : files )
+        m_stamps.push_back( stamp( file ) );
+    m_last_scan = Clock::now();
+}
+
+
+bool FileWatcher::poll()
+{
+    if( m_inotify >= 0 )
+        readEvents();
+    else if( Clock::now() - m_last_scan >= std::chrono::milliseconds( 250 ) )
+        scan();
+
+    if( !m_pending || Clock::now() - m_last_change < m_settle )
+        return false;
+    m_pending = false;
+    return true;
+}
+
+
+void FileWatcher::readEvents()
+{
+#if defined( __linux__ )
+    alignas( inotify_event ) char buffer[4096];
+    for( ;; )
+    {
+        const ssize_t bytes = read( m_inotify, buffer, sizeof( buffer ) );
+        if( bytes <= 0 )
+            return;
+        for( ssize_t offset = 0; offset < bytes; )
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>( buffer + offset );
+            offset += sizeof( inotify_event ) + event->len;
+            if( event->len == 0 )
+                continue;
+            for( const std::pair<int, std::string>& directory : m_directories )
+            {
+                if( directory.first == event->wd && m_names.count( std::make_pair( directory.second, std::string( event->name ) ) ) )
+                {
+                    m_pending     = true;
+                    m_last_change = Clock::now();
+                }
+            }
+        }
+    }
+#endif
+}
+
+
+void FileWatcher::scan()
+{
+    m_last_scan = Clock::now();
+    for( size_t i = 0; i < m_files.size(); ++i )
+    {
+        const Stamp current = stamp( m_files[i] );
+        if( current.size != m_stamps[i].size || current.modified != m_stamps[i].modified )
+        {
+            m_stamps[i]   = current;
+            m_pending     = true;
+            m_last_change = m_last_scan;
+        }
+    }
+}
+
+
+FileWatcher::Stamp FileWatcher::stamp( const std::string& file ) const
+{
+    Stamp       result;
+    struct stat info;
+    if( stat( file.c_str(), &info ) == 0 )
+    {
+        result.size     = static_cast<long long>( info.st_size );
+        result.modified = static_cast<long long>( info.st_mtime );
+    }
+    return result;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+       * Watches a set of files for changes without blocking the render loop.
+       *
+       * On Linux the directories of the files are watched with inotify, which also catches editors
+       * that save by writing a new file and renaming it over the old one. Elsewhere, or if inotify is
+       * unavailable, the size and modification time of every file are compared a few times a second.
+       * Editors and exporters often write a file in several steps, so poll() only reports a change
+       * once it has seen no further event for the settle time; call it every frame.
+*/
+class FileWatcher
+{
+public:
+    explicit FileWatcher( std::chrono::milliseconds settle = std::chrono::milliseconds( 100 ) );
+    ~FileWatcher();
+
+    FileWatcher( const FileWatcher& ) = delete;
+    FileWatcher& operator=( const FileWatcher& ) = delete;
+
+    // Watch exactly these files from now on; changes seen before are dropped
+    void watch( const std::vector<std::string>& files );
+
+    // True once after a watched file changed, was created, replaced or removed and then stayed quiet
+    bool poll();
+
+    bool usesInotify() const { return m_inotify >= 0; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Stamp
+    {
+        long long size     = -1;  // -1 if missing
+        long long modified = 0;
+    };
+
+    void   readEvents();
+    void   scan();
+    Stamp  stamp( const std::string& file ) const;
+
+    std::chrono::milliseconds                     m_settle;
+    int                                           m_inotify = -1;
+    std::vector<std::pair<int, std::string> >     m_directories;  // inotify watch descriptor, directory
+    std::set<std::pair<std::string, std::string> > m_names;       // directory, file name
+    std::vector<std::string>                      m_files;
+    std::vector<Stamp>                            m_stamps;       // without inotify
+    Clock::time_point                             m_last_scan;
+    bool                                          m_pending = false;
+    Clock::time_point                             m_last_change;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+/*
+*   Small helpers shared by the CPU image passes (Denoiser, JointBilateralUpsampler).
+*/
+
+
+/*
+    Split the rows [0, height) into contiguous bands and run f( y0, y1 ) for each band on its own thread.
+    The calling thread processes the first band. num_threads 0 means std::thread::hardware_concurrency().
+*/
+template <typename F>
+void parallelRows( unsigned int height, unsigned int num_threads, F&& f )
+{
+    if( num_threads == 0 )
+        num_threads = std::thread::hardware_concurrency();
+    num_threads = std::max( 1u, std::min( num_threads, height ) );
+
+    const unsigned int rows_per_thread = ( height + num_threads - 1 ) / num_threads;
+    std::vector<std::thread> workers;
+    workers.reserve( num_threads - 1 );
+    for( unsigned int t = 1; t < num_threads; ++t )
+    {
+        const unsigned int y0 = std::min( t * rows_per_thread, height );
+        const unsigned int y1 = std::min( y0 + rows_per_thread, height );
+        workers.emplace_back( [&f, y0, y1]() { f( y0, y1 ); } );
+    }
+    f( 0u, std::min( rows_per_thread, height ) );
+    for( std::thread& worker : workers )
+        worker.join();
+}
+
+
+// Host version of toSRGB() + quantizeUnsigned8Bits() from cuda/helpers.h
+inline unsigned char toSRGB8( float c )
+{
+    c = std::min( std::max( c, 0.f ), 1.f );
+    c = c < 0.0031308f ? 12.92f * c : 1.055f * std::pow( c, 1.f / 2.4f ) - 0.055f;
+    c = std::min( std::max( c, 0.f ), 1.f );
+    return static_cast<unsigned char>( std::min( static_cast<unsigned int>( c * 256.f ), 255u ) );
+}
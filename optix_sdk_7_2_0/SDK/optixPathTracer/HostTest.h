@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+
+/*
+*   Minimal checks for the host unit tests registered with ctest. A test executable calls its test
+*   functions from main() and returns hostTestResult(). A failed check prints its location and the
+*   expression and the executable exits with a non-zero status, the remaining checks still run.
+*/
+
+namespace hostTest
+{
+
+inline int& failureCount()
+{
+    static int count = 0;
+    return count;
+}
+
+inline void fail( const char* file, int line, const char* expression )
+{
+    std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+    ++failureCount();
+}
+
+}  // namespace hostTest
+
+
+#define HOST_CHECK( condition )                                                \
+    do                                                                         \
+    {                                                                          \
+        if( !( condition ) )                                                   \
+            hostTest::fail( __FILE__, __LINE__, #condition );                  \
+    } while( 0 )
+
+#define HOST_CHECK_NEAR( a, b, tolerance )                                     \
+    do                                                                         \
+    {                                                                          \
+        const double host_check_a_ = static_cast<double>( a );                 \
+        const double host_check_b_ = static_cast<double>( b );                 \
+        if( !( std::fabs( host_check_a_ - host_check_b_ ) <= ( tolerance ) ) ) \
+        {                                                                      \
+            hostTest::fail( __FILE__, __LINE__, #a " ~= " #b );                \
+            std::cerr << "    " << host_check_a_ << " vs " << host_check_b_    \
+                      << " (tolerance " << ( tolerance ) << ")" << std::endl;  \
+        }                                                                      \
+    } while( 0 )
+
+// Expects expression to throw an exception of type E.
+#define HOST_CHECK_THROWS( expression, E )                                     \
+    do                                                                         \
+    {                                                                          \
+        bool host_check_thrown_ = false;                                       \
+        try                                                                    \
+        {                                                                      \
+            expression;                                                        \
+        }                                                                      \
+        catch( const E& )                                                      \
+        {                                                                      \
+            host_check_thrown_ = true;                                         \
+        }                                                                      \
+        if( !host_check_thrown_ )                                              \
+            hostTest::fail( __FILE__, __LINE__, #expression " throws " #E );   \
+    } while( 0 )
+
+
+inline int hostTestResult( const char* name )
+{
+    if( hostTest::failureCount() == 0 )
+    {
+        std::cout << name << ": all checks passed" << std::endl;
+        return 0;
+    }
+    std::cerr << name << ": " << hostTest::failureCount() << " checks failed" << std::endl;
+    return 1;
+}
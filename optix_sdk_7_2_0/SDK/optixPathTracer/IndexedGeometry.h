@@ -0,0 +1,198 @@
+#pragma once
+
+#include <vector_functions.h>
+#include <vector_types.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+*   Host-side conversion of a triangle soup (three vertices per triangle, as emitted by
+*   addSceneGeometry) into indexed geometry:
+*     - vertices with identical positions are welded through a hash map keyed by the position bits
+*     - one uint3 index triplet per triangle for OPTIX_BUILD_INPUT_TYPE_TRIANGLES indexBuffer
+*     - one precomputed geometric normal per triangle, so the closest-hit program does not have to
+*       fetch three vertices and take a cross product on every hit
+*   The vertex type only needs public x, y and z float members.
+*/
+
+template <typename VertexT>
+struct IndexedMesh
+{
+    std::vector<VertexT> vertices;      // welded vertices, first occurrence order
+    std::vector<uint3>   indices;       // one triplet per input triangle, same order as the soup
+    std::vector<float3>  face_normals;  // normalize( cross( v1 - v0, v2 - v0 ) ), zero for degenerate triangles
+
+    size_t vertexBytes() const { return vertices.size() * sizeof( VertexT ); }
+    size_t indexBytes() const  { return indices.size() * sizeof( uint3 ); }
+    size_t normalBytes() const { return face_normals.size() * sizeof( float3 ); }
+};
+
+
+namespace indexed_geometry_detail
+{
+
+struct PositionKey
+{
+    uint32_t x, y, z;
+
+    bool operator==( const PositionKey& other ) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+struct PositionKeyHash
+{
+    size_t operator()( const PositionKey& k ) const
+    {
+        // Combine the three words with large odd multipliers, then fold the high bits down
+        uint64_t h = k.x * 0x9E3779B97F4A7C15ull;
+        h ^= k.y * 0xC2B2AE3D27D4EB4Full;
+        h ^= k.z * 0x165667B19E3779F9ull;
+        return static_cast<size_t>( h ^ ( h >> 29 ) );
+    }
+};
+
+template <typename VertexT>
+float3 faceNormal( const VertexT& v0, const VertexT& v1, const VertexT& v2 )
+{
+    const float e1x = v1.x - v0.x, e1y = v1.y - v0.y, e1z = v1.z - v0.z;
+    const float e2x = v2.x - v0.x, e2y = v2.y - v0.y, e2z = v2.z - v0.z;
+    const float nx  = e1y * e2z - e1z * e2y;
+    const float ny  = e1z * e2x - e1x * e2z;
+    const float nz  = e1x * e2y - e1y * e2x;
+    const float len = std::sqrt( nx * nx + ny * ny + nz * nz );
+    const float inv = len > 0.f ? 1.f / len : 0.f;
+    return make_float3( nx * inv, ny * inv, nz * inv );
+}
+
+inline uint32_t floatBits( float f )
+{
+    // +0 and -0 weld together
+    if( f == 0.f )
+        f = 0.f;
+    uint32_t bits;
+    std::memcpy( &bits, &f, sizeof( bits ) );
+    return bits;
+}
+
+}  // namespace indexed_geometry_detail
+
+
+/*
+    Weld a triangle soup of num_vertices vertices, a multiple of three; vertices are welded when their
+    positions are bitwise equal (after folding -0 to +0), which is exact for the duplicated corners
+    produced by the procedural shapes and the OBJ loader.
+*/
+template <typename VertexT>
+IndexedMesh<VertexT> weldTriangleSoup( const VertexT* soup, size_t num_vertices )
+{
+    using namespace indexed_geometry_detail;
+
+    IndexedMesh<VertexT> mesh;
+    const size_t num_triangles = num_vertices / 3;
+    mesh.indices.reserve( num_triangles );
+    mesh.face_normals.reserve( num_triangles );
+
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> lookup;
+    lookup.reserve( num_vertices );
+
+    uint32_t corner[3];
+    for( size_t t = 0; t < num_triangles; ++t )
+    {
+        for( int c = 0; c < 3; ++c )
+        {
+            const VertexT&    v   = soup[t * 3 + c];
+            const PositionKey key = { floatBits( v.x ), floatBits( v.y ), floatBits( v.z ) };
+            const auto inserted   = lookup.insert( std::make_pair( key, static_cast<uint32_t>( mesh.vertices.size() ) ) );
+            if( inserted.second )
+                mesh.vertices.push_back( v );
+            corner[c] = inserted.first->second;
+        }
+        mesh.indices.push_back( make_uint3( corner[0], corner[1], corner[2] ) );
+
+        mesh.face_normals.push_back( faceNormal( mesh.vertices[corner[0]], mesh.vertices[corner[1]], mesh.vertices[corner[2]] ) );
+    }
+    return mesh;
+}
+
+template <typename VertexT>
+IndexedMesh<VertexT> weldTriangleSoup( const std::vector<VertexT>& soup )
+{
+    return weldTriangleSoup( soup.data(), soup.size() );
+}
+
+
+// Copy geometry that is already welded and indexed, e.g. from a scene cache, and compute its face normals
+template <typename VertexT>
+IndexedMesh<VertexT> makeIndexedMesh( const VertexT* vertices, size_t num_vertices, const uint3* indices, size_t num_triangles )
+{
+    using namespace indexed_geometry_detail;
+
+    IndexedMesh<VertexT> mesh;
+    mesh.vertices.assign( vertices, vertices + num_vertices );
+    mesh.indices.assign( indices, indices + num_triangles );
+    mesh.face_normals.reserve( num_triangles );
+    for( const uint3& t : mesh.indices )
+        mesh.face_normals.push_back( faceNormal( mesh.vertices[t.x], mesh.vertices[t.y], mesh.vertices[t.z] ) );
+    return mesh;
+}
+
+
+/*
+    Vertex clustering decimation (Rossignac and Borrel): all vertices inside one cell of a uniform grid
+    with the given edge length are merged into their mean, triangles that collapse are dropped. The
+    output keeps the input triangle order and has its face normals recomputed.
+*/
+template <typename VertexT>
+IndexedMesh<VertexT> decimateByClustering( const IndexedMesh<VertexT>& mesh, float cell_size )
+{
+    using namespace indexed_geometry_detail;
+    if( cell_size <= 0.f )
+        return mesh;
+
+    IndexedMesh<VertexT> result;
+    std::vector<uint32_t> cluster_of( mesh.vertices.size() );
+    std::vector<uint32_t> cluster_size;
+
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> lookup;
+    lookup.reserve( mesh.vertices.size() );
+    const float inv_cell = 1.f / cell_size;
+    for( size_t i = 0; i < mesh.vertices.size(); ++i )
+    {
+        const VertexT&    v   = mesh.vertices[i];
+        const PositionKey key = { static_cast<uint32_t>( static_cast<int32_t>( std::floor( v.x * inv_cell ) ) ),
+                                  static_cast<uint32_t>( static_cast<int32_t>( std::floor( v.y * inv_cell ) ) ),
+                                  static_cast<uint32_t>( static_cast<int32_t>( std::floor( v.z * inv_cell ) ) ) };
+        const auto inserted = lookup.insert( std::make_pair( key, static_cast<uint32_t>( result.vertices.size() ) ) );
+        const uint32_t c    = inserted.first->second;
+        if( inserted.second )
+        {
+            result.vertices.push_back( v );
+            cluster_size.push_back( 1 );
+        }
+        else
+        {
+            // Running mean of the cluster position
+            VertexT&    mean = result.vertices[c];
+            const float w    = 1.f / static_cast<float>( ++cluster_size[c] );
+            mean.x += ( v.x - mean.x ) * w;
+            mean.y += ( v.y - mean.y ) * w;
+            mean.z += ( v.z - mean.z ) * w;
+        }
+        cluster_of[i] = c;
+    }
+
+    result.indices.reserve( mesh.indices.size() );
+    for( const uint3& tri : mesh.indices )
+    {
+        const uint3 c = make_uint3( cluster_of[tri.x], cluster_of[tri.y], cluster_of[tri.z] );
+        if( c.x == c.y || c.y == c.z || c.x == c.z )
+            continue;
+        result.indices.push_back( c );
+        result.face_normals.push_back( faceNormal( result.vertices[c.x], result.vertices[c.y], result.vertices[c.z] ) );
+    }
+    return result;
+}
@@ -0,0 +1,210 @@
+//
+// indexedGeometryTest - host tests of weldTriangleSoup() and decimateByClustering() in
+// IndexedGeometry.h: shared vertex counts, the folding of -0 onto +0, index validity and the order
+// of the output triangles.
+//
+
+#include "IndexedGeometry.h"
+#include "HostTest.h"
+
+#include <cmath>
+#include <vector>
+
+
+namespace {
+
+struct Vertex
+{
+    float x, y, z, pad;
+};
+
+Vertex makeVertex( float x, float y, float z )
+{
+    Vertex v = { x, y, z, 0.0f };
+    return v;
+}
+
+// Unit cube soup, 12 outward facing triangles over 8 corners
+std::vector<Vertex> cubeSoup( float size )
+{
+    const int faces[12][3] = { { 0, 2, 3 }, { 0, 3, 1 }, { 4, 5, 7 }, { 4, 7, 6 }, { 0, 1, 5 }, { 0, 5, 4 },
+                               { 2, 6, 7 }, { 2, 7, 3 }, { 0, 4, 6 }, { 0, 6, 2 }, { 1, 3, 7 }, { 1, 7, 5 } };
+    std::vector<Vertex> soup;
+    for( const auto& face : faces )
+        for( int corner : face )
+            soup.push_back( makeVertex( corner & 1 ? size : -size, corner & 2 ? size : -size, corner & 4 ? size : -size ) );
+    return soup;
+}
+
+bool samePosition( const Vertex& a, const Vertex& b )
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+template <typename VertexT>
+bool indicesValid( const IndexedMesh<VertexT>& mesh )
+{
+    for( const uint3& t : mesh.indices )
+        if( t.x >= mesh.vertices.size() || t.y >= mesh.vertices.size() || t.z >= mesh.vertices.size() )
+            return false;
+    return mesh.face_normals.size() == mesh.indices.size();
+}
+
+
+void testWeldCube()
+{
+    const std::vector<Vertex>  soup = cubeSoup( 0.5f );
+    const IndexedMesh<Vertex> mesh = weldTriangleSoup( soup );
+    HOST_CHECK( mesh.vertices.size() == 8 );
+    HOST_CHECK( mesh.indices.size() == 12 );
+    HOST_CHECK( indicesValid( mesh ) );
+    HOST_CHECK( mesh.vertexBytes() == 8 * sizeof( Vertex ) && mesh.indexBytes() == 12 * sizeof( uint3 ) );
+
+    // Triangle t still has the corners of soup triangle t, in the same winding
+    for( size_t t = 0; t < mesh.indices.size(); ++t )
+    {
+        const uint3& i = mesh.indices[t];
+        HOST_CHECK( samePosition( mesh.vertices[i.x], soup[t * 3 + 0] ) );
+        HOST_CHECK( samePosition( mesh.vertices[i.y], soup[t * 3 + 1] ) );
+        HOST_CHECK( samePosition( mesh.vertices[i.z], soup[t * 3 + 2] ) );
+    }
+
+    // Vertices in first occurrence order
+    HOST_CHECK( mesh.indices[0].x == 0 && mesh.indices[0].y == 1 && mesh.indices[0].z == 2 );
+
+    // Unit normals pointing away from the center
+    for( size_t t = 0; t < mesh.indices.size(); ++t )
+    {
+        const float3  n = mesh.face_normals[t];
+        const Vertex& v = mesh.vertices[mesh.indices[t].x];
+        HOST_CHECK_NEAR( n.x * n.x + n.y * n.y + n.z * n.z, 1.0f, 1e-6 );
+        HOST_CHECK( n.x * v.x + n.y * v.y + n.z * v.z > 0.0f );
+    }
+}
+
+
+void testSignedZero()
+{
+    using indexed_geometry_detail::floatBits;
+    HOST_CHECK( floatBits( -0.0f ) == floatBits( 0.0f ) );
+    HOST_CHECK( floatBits( 0.0f ) == 0u );
+    HOST_CHECK( floatBits( -1.0f ) != floatBits( 1.0f ) );
+    HOST_CHECK( floatBits( 1e-45f ) != floatBits( 0.0f ) );  // denormals are not zero
+
+    // Two triangles sharing an edge, one written with -0: four vertices, not six
+    std::vector<Vertex> soup = { makeVertex( 0.0f, 0.0f, 0.0f ), makeVertex( 1.0f, 0.0f, 0.0f ), makeVertex( 0.0f, 1.0f, 0.0f ),
+                                 makeVertex( -0.0f, 1.0f, -0.0f ), makeVertex( 1.0f, -0.0f, 0.0f ), makeVertex( 1.0f, 1.0f, 0.0f ) };
+    const IndexedMesh<Vertex> mesh = weldTriangleSoup( soup );
+    HOST_CHECK( mesh.vertices.size() == 4 );
+    HOST_CHECK( mesh.indices[1].x == mesh.indices[0].z && mesh.indices[1].y == mesh.indices[0].y );
+    HOST_CHECK( indicesValid( mesh ) );
+
+    // Nearby but not bitwise equal positions stay apart
+    soup[3].x = 1e-7f;
+    HOST_CHECK( weldTriangleSoup( soup ).vertices.size() == 5 );
+}
+
+
+void testDegenerateTriangles()
+{
+    // A collapsed triangle keeps its slot and has a zero normal
+    std::vector<Vertex> soup = cubeSoup( 1.0f );
+    soup.push_back( makeVertex( 2.0f, 2.0f, 2.0f ) );
+    soup.push_back( makeVertex( 2.0f, 2.0f, 2.0f ) );
+    soup.push_back( makeVertex( 3.0f, 2.0f, 2.0f ) );
+    const IndexedMesh<Vertex> mesh = weldTriangleSoup( soup );
+    HOST_CHECK( mesh.indices.size() == 13 && mesh.vertices.size() == 10 );
+    HOST_CHECK( mesh.indices[12].x == mesh.indices[12].y );
+    const float3 n = mesh.face_normals[12];
+    HOST_CHECK( n.x == 0.0f && n.y == 0.0f && n.z == 0.0f );
+
+    // Leftover vertices of an incomplete triangle are ignored
+    HOST_CHECK( weldTriangleSoup( soup.data(), soup.size() - 1 ).indices.size() == 12 );
+    HOST_CHECK( weldTriangleSoup( soup.data(), 0 ).vertices.empty() );
+}
+
+
+// A 16x16 grid of quads in the xy plane, two triangles per quad
+IndexedMesh<Vertex> gridMesh( unsigned int n )
+{
+    std::vector<Vertex> soup;
+    for( unsigned int y = 0; y < n; ++y )
+        for( unsigned int x = 0; x < n; ++x )
+        {
+            const float x0 = static_cast<float>( x ), x1 = x0 + 1.0f, y0 = static_cast<float>( y ), y1 = y0 + 1.0f;
+            soup.push_back( makeVertex( x0, y0, 0.0f ) );
+            soup.push_back( makeVertex( x1, y0, 0.0f ) );
+            soup.push_back( makeVertex( x1, y1, 0.0f ) );
+            soup.push_back( makeVertex( x0, y0, 0.0f ) );
+            soup.push_back( makeVertex( x1, y1, 0.0f ) );
+            soup.push_back( makeVertex( x0, y1, 0.0f ) );
+        }
+    return weldTriangleSoup( soup );
+}
+
+
+void testDecimate()
+{
+    const IndexedMesh<Vertex> grid = gridMesh( 16 );
+    HOST_CHECK( grid.vertices.size() == 17 * 17 && grid.indices.size() == 512 );
+
+    // A cell size of zero or less returns the mesh unchanged
+    const IndexedMesh<Vertex> same = decimateByClustering( grid, 0.0f );
+    HOST_CHECK( same.vertices.size() == grid.vertices.size() && same.indices.size() == grid.indices.size() );
+
+    // Cells slightly wider than four quads hold the grid coordinates 0-4, 5-8, 9-12 and 13-16
+    const IndexedMesh<Vertex> coarse = decimateByClustering( grid, 4.25f );
+    HOST_CHECK( coarse.vertices.size() == 4 * 4 );
+    HOST_CHECK( coarse.indices.size() < grid.indices.size() && !coarse.indices.empty() );
+    HOST_CHECK( indicesValid( coarse ) );
+
+    // No collapsed triangles survive, and the normals stay unit length and facing +z
+    for( size_t t = 0; t < coarse.indices.size(); ++t )
+    {
+        const uint3& c = coarse.indices[t];
+        HOST_CHECK( c.x != c.y && c.y != c.z && c.x != c.z );
+        HOST_CHECK_NEAR( coarse.face_normals[t].z, 1.0f, 1e-6 );
+    }
+
+    // Cluster positions are the means of their vertices: the cell [0, 4.25)^2 holds x, y in 0..4
+    HOST_CHECK_NEAR( coarse.vertices[0].x, 2.0f, 1e-5 );
+    HOST_CHECK_NEAR( coarse.vertices[0].y, 2.0f, 1e-5 );
+
+    // Surviving triangles keep the input order: they are a subsequence of the input triangles
+    // mapped through the clusters
+    std::vector<uint32_t> cluster_of( grid.vertices.size() );
+    for( size_t i = 0; i < grid.vertices.size(); ++i )
+    {
+        const Vertex& v = grid.vertices[i];
+        const int     cx = static_cast<int>( std::floor( v.x / 4.25f ) ), cy = static_cast<int>( std::floor( v.y / 4.25f ) );
+        for( uint32_t c = 0; c < coarse.vertices.size(); ++c )
+            if( static_cast<int>( std::floor( coarse.vertices[c].x / 4.25f ) ) == cx
+                && static_cast<int>( std::floor( coarse.vertices[c].y / 4.25f ) ) == cy )
+                cluster_of[i] = c;
+    }
+    size_t next = 0;
+    for( const uint3& t : grid.indices )
+    {
+        const uint3 c = make_uint3( cluster_of[t.x], cluster_of[t.y], cluster_of[t.z] );
+        if( next < coarse.indices.size() && c.x == coarse.indices[next].x && c.y == coarse.indices[next].y && c.z == coarse.indices[next].z )
+            ++next;
+    }
+    HOST_CHECK( next == coarse.indices.size() );
+
+    // Negative coordinates use floor, not truncation: -0.5 and 0.5 are in different cells
+    std::vector<Vertex> soup = { makeVertex( -0.5f, 0.0f, 0.0f ), makeVertex( 0.5f, 0.0f, 0.0f ), makeVertex( 0.5f, 3.0f, 0.0f ) };
+    const IndexedMesh<Vertex> straddle = decimateByClustering( weldTriangleSoup( soup ), 2.0f );
+    HOST_CHECK( straddle.vertices.size() == 3 && straddle.indices.size() == 1 );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testWeldCube();
+    testSignedZero();
+    testDegenerateTriangles();
+    testDecimate();
+    return hostTestResult( "indexedGeometryTest" );
+}
@@ -0,0 +1,137 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <utility>
+
+
+MappedFile::MappedFile( MappedFile&& other )
+{
+    *this = std::move( other );
+}
+
+
+MappedFile& MappedFile::operator=( MappedFile&& other )
+{
+    if( this != &other )
+    {
+        close();
+        std::swap( m_data, other.m_data );
+        std::swap( m_size, other.m_size );
+        std::swap( m_valid, other.m_valid );
+#ifdef _WIN32
+        std::swap( m_file, other.m_file );
+        std::swap( m_mapping, other.m_mapping );
+#endif
+    }
+    return *this;
+}
+
+
+#ifdef _WIN32
+
+bool MappedFile::open( const std::string& filename )
+{
+    close();
+    HANDLE file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+    if( file == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx( file, &size ) )
+    {
+        CloseHandle( file );
+        return false;
+    }
+    m_file  = file;
+    m_size  = static_cast<size_t>( size.QuadPart );
+    m_valid = true;
+    if( m_size == 0 )
+        return true;
+
+    m_mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    if( m_mapping )
+        m_data = static_cast<const char*>( MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, 0 ) );
+    if( !m_data )
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+void MappedFile::close()
+{
+    if( m_data )
+        UnmapViewOfFile( m_data );
+    if( m_mapping )
+        CloseHandle( m_mapping );
+    if( m_file )
+        CloseHandle( m_file );
+    m_data    = nullptr;
+    m_mapping = nullptr;
+    m_file    = nullptr;
+    m_size    = 0;
+    m_valid   = false;
+}
+
+#else
+
+bool MappedFile::open( const std::string& filename )
+{
+    close();
+    const int fd = ::open( filename.c_str(), O_RDONLY );
+    if( fd < 0 )
+        return false;
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 )
+    {
+        ::close( fd );
+        return false;
+    }
+    m_size = static_cast<size_t>( st.st_size );
+    if( m_size > 0 )
+    {
+        void* data = mmap( nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if( data == MAP_FAILED )
+        {
+            ::close( fd );
+            m_size = 0;
+            return false;
+        }
+        // The parsers read front to back
+        madvise( data, m_size, MADV_SEQUENTIAL );
+        m_data = static_cast<const char*>( data );
+    }
+    ::close( fd );  // the mapping keeps the file referenced
+    m_valid = true;
+    return true;
+}
+
+
+void MappedFile::close()
+{
+    if( m_data )
+        munmap( const_cast<char*>( m_data ), m_size );
+    m_data  = nullptr;
+    m_size  = 0;
+    m_valid = false;
+}
+
+#endif
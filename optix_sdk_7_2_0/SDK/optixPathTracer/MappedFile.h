@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/**
+       * Read-only memory mapping of a whole file (mmap, or CreateFileMapping on Windows).
+       *
+       * Move-only; the mapping is released on destruction. An empty file maps successfully with
+       * size() == 0 and data() == nullptr.
+*/
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile( MappedFile&& other );
+    MappedFile& operator=( MappedFile&& other );
+
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+
+    // Map filename, replacing any current mapping; false if it cannot be opened or mapped
+    bool open( const std::string& filename );
+    void close();
+
+    const char* data() const { return m_data; }
+    size_t      size() const { return m_size; }
+    bool        valid() const { return m_valid; }
+
+private:
+    const char* m_data  = nullptr;
+    size_t      m_size  = 0;
+    bool        m_valid = false;
+#ifdef _WIN32
+    void*       m_file    = nullptr;
+    void*       m_mapping = nullptr;
+#endif
+};
@@ -0,0 +1,212 @@
+#include "MaterialTextures.h"
+
+#include <optix_types.h>
+
+#include "optixPathTracer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef OPTIX_SAMPLE_USE_DEMAND_LOADING
+#include <DemandLoading/DemandTexture.h>
+#include <DemandLoading/DemandTextureManager.h>
+#include <DemandLoading/MappedTileImageReader.h>
+#include <DemandLoading/StbImageReader.h>
+#include <DemandLoading/TextureDescriptor.h>
+#endif
+
+
+#ifdef OPTIX_SAMPLE_USE_DEMAND_LOADING
+
+bool MaterialTextures::init( size_t max_tile_memory )
+{
+    demandLoading::DemandTextureManagerConfig config = {};
+    config.numPages            = 1u << 26;  // virtual pages shared by all textures
+    config.maxRequestedPages   = 4096;      // requests pulled per launch
+    config.maxFilledPages      = 4096;      // mappings pushed per launch
+    config.maxStalePages       = 8192;      // eviction candidates pulled per launch
+    config.maxInvalidatedPages = 1024;      // tiles evicted per launch
+    config.maxTileMemory       = max_tile_memory;
+    config.numLoaderThreads    = std::max( 2u, std::min( 8u, std::thread::hardware_concurrency() / 2 ) );  // image reads off the render thread
+    config.maxHostCacheMemory  = size_t( 256 ) << 20;  // recently read and prefetched tiles
+    config.prefetchNeighbors   = true;
+    try
+    {
+        m_manager = demandLoading::createDemandTextureManager( std::vector<unsigned int>( 1, 0u ), config );
+    }
+    catch( const std::exception& e )
+    {
+        std::cerr << "Material textures disabled: " << e.what() << std::endl;
+        m_manager = nullptr;
+    }
+    return m_manager != nullptr;
+}
+
+
+void MaterialTextures::useManager( demandLoading::DemandTextureManager* manager )
+{
+    release();
+    m_manager = manager;
+}
+
+
+int MaterialTextures::textureId( const std::string& path )
+{
+    auto it = m_ids.find( path );
+    if( it != m_ids.end() )
+        return it->second;
+
+    int id = NO_TEXTURE;
+    if( m_manager )
+    {
+        // The image is decoded when its first tile is requested; check now that it is there at all so a
+        // missing file is not requested again every launch
+        if( std::ifstream( path, std::ios::binary ).good() )
+        {
+            demandLoading::TextureDescriptor desc = {};
+            desc.addressMode[0]                   = CU_TR_ADDRESS_MODE_WRAP;
+            desc.addressMode[1]                   = CU_TR_ADDRESS_MODE_WRAP;
+            desc.filterMode                       = CU_TR_FILTER_MODE_LINEAR;
+            desc.mipmapFilterMode                 = CU_TR_FILTER_MODE_LINEAR;
+            desc.maxAnisotropy                    = 16;
+            desc.flags                            = CU_TRSF_NORMALIZED_COORDINATES | CU_TRSF_SRGB;
+
+            // A tile cache written by tileCacheConverter next to the image is mapped instead of
+            // decoding the image
+            std::shared_ptr<demandLoading::ImageReader> image;
+            const std::string                           tiles_path = path + ".tiles";
+            if( std::ifstream( tiles_path, std::ios::binary ).good() )
+                image.reset( new demandLoading::MappedTileImageReader( tiles_path ) );
+            else
+                image.reset( new demandLoading::StbImageReader( path, true ) );
+            id = static_cast<int>( m_manager->createTexture( image, desc ).getId() );
+        }
+        else
+        {
+            std::cerr << "Cannot read texture " << path << std::endl;
+        }
+    }
+    m_ids[path] = id;
+    return id;
+}
+
+
+void MaterialTextures::launchPrepare( demandLoading::DemandTextureContext& context )
+{
+    if( m_manager )
+        m_manager->launchPrepare( 0, context );
+}
+
+
+unsigned int MaterialTextures::processRequests()
+{
+    if( !m_manager )
+        return 0;
+    m_manager->processRequests();
+    for( unsigned int page : m_manager->getRequestedPages() )
+        m_sampled_pages.insert( page );
+
+    // A page filled on several devices counts once
+    m_filled_pages.clear();
+    m_manager->takeFilledPages( m_filled_pages );
+    unsigned int sampled_fills = 0;
+    for( unsigned int page : m_filled_pages )
+        sampled_fills += static_cast<unsigned int>( m_sampled_pages.erase( page ) );
+    return sampled_fills;
+}
+
+
+void MaterialTextures::restartAccumulation()
+{
+    m_sampled_pages.clear();
+}
+
+
+bool MaterialTextures::loading() const
+{
+    return m_manager && m_manager->getStats().numPendingReads > 0;
+}
+
+
+void MaterialTextures::printStats( std::ostream& out ) const
+{
+    if( !m_manager )
+        return;
+    const demandLoading::DemandTextureManagerStats stats = m_manager->getStats();
+    out << std::fixed << std::setprecision( 1 ) << "Material textures: " << m_ids.size() << " images, "
+        << stats.tileMemory / ( 1024.0 * 1024.0 ) << " MB of tiles, " << stats.numFilledRequests << " requests filled, "
+        << stats.numDeniedRequests << " denied for lack of tile memory, " << stats.numEvictedTiles << " tiles evicted" << std::endl;
+    out << "Material textures: " << stats.numTileReads << " tiles read (" << stats.numPrefetchReads << " prefetched), "
+        << stats.bytesRead / ( 1024.0 * 1024.0 ) << " MB in " << stats.readSeconds << " s of reader time, "
+        << stats.numCacheHits << " host cache hits (" << stats.numPrefetchHits << " prefetched)" << std::endl;
+}
+
+
+void MaterialTextures::release()
+{
+    if( m_manager )
+        demandLoading::destroyDemandTextureManager( m_manager );
+    m_manager = nullptr;
+    m_ids.clear();
+    m_sampled_pages.clear();
+    m_filled_pages.clear();
+}
+
+#else
+
+bool MaterialTextures::init( size_t )
+{
+    std::cerr << "Material textures disabled: built without the DemandLoading library (CUDA 11.1 or later)" << std::endl;
+    return false;
+}
+
+
+void MaterialTextures::useManager( demandLoading::DemandTextureManager* )
+{
+}
+
+
+int MaterialTextures::textureId( const std::string& )
+{
+    return NO_TEXTURE;
+}
+
+
+void MaterialTextures::launchPrepare( demandLoading::DemandTextureContext& )
+{
+}
+
+
+unsigned int MaterialTextures::processRequests()
+{
+    return 0;
+}
+
+
+void MaterialTextures::restartAccumulation()
+{
+}
+
+
+bool MaterialTextures::loading() const
+{
+    return false;
+}
+
+
+void MaterialTextures::printStats( std::ostream& ) const
+{
+}
+
+
+void MaterialTextures::release()
+{
+}
+
+#endif
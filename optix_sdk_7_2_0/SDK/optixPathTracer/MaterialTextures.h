@@ -0,0 +1,87 @@
+#pragma once
+
+#include <DemandLoading/DemandTextureContext.h>
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace demandLoading {
+class DemandTextureManager;
+}
+
+/**
+       * Material texture maps backed by demand loaded sparse textures.
+       *
+       * Each image file becomes one texture of a DemandTextureManager on device 0. Nothing is read
+       * when a texture is created: the hit programs request the tiles their lookups touch, and
+       * processRequests() hands them to loader threads after the launch. launchPrepare() maps the
+       * tiles that have been read since, so a slow image never stalls a frame. Tiles that were read
+       * recently, or prefetched next to a requested one, are kept in a host cache and are mapped
+       * by processRequests() right away. The tiles of all textures share a pool of at most
+       * max_tile_memory bytes; once it is full the tiles the last launch did not touch are evicted,
+       * least recently used first, to make room. Requests that still do not fit are denied and the
+       * device samples the coarser mip levels it already has. An image with a tile cache file next
+       * to it (<image>.tiles, written by tileCacheConverter) is read from the mapped file instead,
+       * which skips decoding the image and building its mip chain.
+       *
+       * A tile that becomes resident changes the image only where a lookup fell back to a coarser
+       * level while it was missing, and each such lookup requested it. processRequests() therefore
+       * counts only the mappings of pages requested since the last restartAccumulation(), so the
+       * accumulation restarts for the tiles it sampled and not for tiles an earlier view asked for.
+       * Blending the new samples into the old ones would avoid the restart but leave the coarse
+       * samples in the image until it converged, which is what the restart is there to prevent.
+       *
+       * Without the DemandLoading library (CUDA older than 11.1) or without a device that supports
+       * sparse textures init() returns false and every texture id is NO_TEXTURE, so the materials
+       * fall back to their colors.
+*/
+class MaterialTextures
+{
+public:
+    MaterialTextures() = default;
+    ~MaterialTextures() { release(); }
+
+    MaterialTextures( const MaterialTextures& ) = delete;
+    MaterialTextures& operator=( const MaterialTextures& ) = delete;
+
+    // Create the texture manager, max_tile_memory of 0 means no limit. Prints the reason and returns
+    // false if demand loaded textures are not available.
+    bool init( size_t max_tile_memory );
+
+    // Take over a texture manager created elsewhere, e.g. one without a device in the tests
+    void useManager( demandLoading::DemandTextureManager* manager );
+
+    bool enabled() const { return m_manager != nullptr; }
+
+    // Demand texture id of an image file, created on first use; NO_TEXTURE if disabled or the file
+    // cannot be read
+    int textureId( const std::string& path );
+
+    // Fill in the device context before a launch
+    void launchPrepare( demandLoading::DemandTextureContext& context );
+
+    // Queue the reads of the tiles the last launch requested once it finished. Returns the number of
+    // pages mapped since the previous call, including by launchPrepare(), that a launch since the last
+    // restartAccumulation() requested.
+    unsigned int processRequests();
+
+    // Forget the pages earlier launches requested, the next launch starts a new accumulation
+    void restartAccumulation();
+
+    // Whether tiles are still being read; another launch maps them
+    bool loading() const;
+
+    void printStats( std::ostream& out ) const;
+
+    void release();
+
+private:
+    demandLoading::DemandTextureManager* m_manager = nullptr;
+    std::map<std::string, int>           m_ids;            // image path -> demand texture id or NO_TEXTURE
+    std::unordered_set<unsigned int>     m_sampled_pages;  // requested since the last restartAccumulation()
+    std::vector<unsigned int>            m_filled_pages;
+};
@@ -0,0 +1,278 @@
+//
+// materialTexturesTest - host tests of MaterialTextures against a texture manager without a device:
+// every image file becomes one texture whatever the number of lookups, missing images are NO_TEXTURE
+// without being retried, a tile cache file next to an image is read instead of the image, and only
+// the pages the current accumulation requested before they became resident restart it.
+//
+
+#include "MaterialTextures.h"
+
+#include <optix_types.h>
+
+#include "HostTest.h"
+#include "optixPathTracer.h"
+
+#include <DemandLoading/DemandTexture.h>
+#include <DemandLoading/DemandTextureInfo.h>
+#include <DemandLoading/DemandTextureManager.h>
+#include <DemandLoading/MappedTileImageReader.h>
+#include <DemandLoading/StbImageReader.h>
+#include <DemandLoading/TextureDescriptor.h>
+#include <DemandLoading/TextureInfo.h>
+
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+// Texture that only remembers what it was created with
+class MockTexture : public demandLoading::DemandTexture
+{
+  public:
+    MockTexture( unsigned int id, std::shared_ptr<demandLoading::ImageReader> image, const demandLoading::TextureDescriptor& desc )
+        : m_id( id )
+        , m_image( image )
+        , m_desc( desc )
+    {
+    }
+
+    const std::shared_ptr<demandLoading::ImageReader>& image() const { return m_image; }
+
+    unsigned int getId() const override { return m_id; }
+    bool         isInitialized( unsigned int ) const override { return false; }
+    bool         init( unsigned int ) override { return false; }
+    const demandLoading::TextureInfo&       getInfo() const override { return m_info; }
+    const demandLoading::DemandTextureInfo& getDeviceInfo() const override { return m_device_info; }
+    const demandLoading::TextureDescriptor& getDescriptor() const override { return m_desc; }
+    uint2        getMipLevelDims( unsigned int ) const override { return uint2{}; }
+    unsigned int getTileWidth() const override { return 0; }
+    unsigned int getTileHeight() const override { return 0; }
+    unsigned int getMipTailFirstLevel() const override { return 0; }
+    CUtexObject  getTextureObject( unsigned int ) const override { return 0; }
+    bool readTile( unsigned int, unsigned int, unsigned int, std::vector<char>* ) const override { return false; }
+    void fillTile( unsigned int, unsigned int, unsigned int, unsigned int, const char*, size_t ) const override {}
+    bool readMipTail( std::vector<char>* ) const override { return false; }
+    void fillMipTail( unsigned int, const char*, size_t ) const override {}
+
+  private:
+    unsigned int                                m_id;
+    std::shared_ptr<demandLoading::ImageReader> m_image;
+    demandLoading::TextureDescriptor            m_desc;
+    demandLoading::TextureInfo                  m_info        = {};
+    demandLoading::DemandTextureInfo            m_device_info = {};
+};
+
+
+// Manager whose launches request and fill the pages a test scripts
+class MockManager : public demandLoading::DemandTextureManager
+{
+  public:
+    std::deque<MockTexture>   textures;
+    std::vector<unsigned int> next_requests;    // pulled by the next processRequests()
+    std::vector<unsigned int> fill_on_prepare;  // filled by the next launchPrepare(), reads that finished
+    std::vector<unsigned int> fill_on_process;  // filled by the next processRequests(), host cache hits
+    unsigned int              pending_reads = 0;
+    bool*                     destroyed     = nullptr;
+
+    ~MockManager() override
+    {
+        if( destroyed )
+            *destroyed = true;
+    }
+
+    const demandLoading::DemandTexture& createTexture( std::shared_ptr<demandLoading::ImageReader> image,
+                                                       const demandLoading::TextureDescriptor&     desc ) override
+    {
+        textures.emplace_back( static_cast<unsigned int>( textures.size() ), image, desc );
+        return textures.back();
+    }
+
+    void launchPrepare( unsigned int, demandLoading::DemandTextureContext& ) override { take( fill_on_prepare ); }
+
+    int processRequests() override
+    {
+        m_requested = next_requests;
+        next_requests.clear();
+        return static_cast<int>( take( fill_on_process ) );
+    }
+
+    unsigned int pushMappings() override { return 0; }
+    unsigned int reservePages( unsigned int ) override { return 0; }
+
+    demandLoading::DemandTextureManagerStats getStats() const override
+    {
+        demandLoading::DemandTextureManagerStats stats = {};
+        stats.numPendingReads                          = pending_reads;
+        return stats;
+    }
+
+    std::vector<unsigned int> getRequestedPages() const override { return m_requested; }
+
+    void takeFilledPages( std::vector<unsigned int>& page_ids ) override
+    {
+        page_ids.insert( page_ids.end(), m_filled.begin(), m_filled.end() );
+        m_filled.clear();
+    }
+
+  private:
+    std::vector<unsigned int> m_requested;
+    std::vector<unsigned int> m_filled;
+
+    size_t take( std::vector<unsigned int>& pages )
+    {
+        const size_t count = pages.size();
+        m_filled.insert( m_filled.end(), pages.begin(), pages.end() );
+        pages.clear();
+        return count;
+    }
+};
+
+
+void writeText( const std::string& path, const std::string& text )
+{
+    std::ofstream out( path.c_str(), std::ios::binary | std::ios::trunc );
+    out << text;
+}
+
+// One launch of the frame loop: map finished reads, then pull the requests and count the fills
+unsigned int launch( MaterialTextures& textures, MockManager& manager, const std::vector<unsigned int>& requests )
+{
+    demandLoading::DemandTextureContext context = {};
+    textures.launchPrepare( context );
+    manager.next_requests = requests;
+    return textures.processRequests();
+}
+
+
+void testTextureIds()
+{
+    // Nothing is read while the ids are handed out, the files only have to exist
+    writeText( "materialTexturesTest.a.png", "not decoded" );
+    writeText( "materialTexturesTest.b.png", "not decoded" );
+    writeText( "materialTexturesTest.b.png.tiles", "not mapped" );
+
+    MaterialTextures textures;
+    MockManager*     manager = new MockManager;
+    textures.useManager( manager );
+    HOST_CHECK( textures.enabled() );
+
+    const int a = textures.textureId( "materialTexturesTest.a.png" );
+    const int b = textures.textureId( "materialTexturesTest.b.png" );
+    HOST_CHECK( a == 0 && b == 1 );
+    HOST_CHECK( textures.textureId( "materialTexturesTest.a.png" ) == a );
+    HOST_CHECK( textures.textureId( "materialTexturesTest.b.png" ) == b );
+    HOST_CHECK( manager->textures.size() == 2 );
+
+    // The image is decoded, the tile cache file mapped
+    HOST_CHECK( dynamic_cast<demandLoading::StbImageReader*>( manager->textures[0].image().get() ) != nullptr );
+    HOST_CHECK( dynamic_cast<demandLoading::MappedTileImageReader*>( manager->textures[1].image().get() ) != nullptr );
+
+    // Tiled lookups that wrap, filter across mip levels and return linear colors
+    const demandLoading::TextureDescriptor& desc = manager->textures[0].getDescriptor();
+    HOST_CHECK( desc.addressMode[0] == CU_TR_ADDRESS_MODE_WRAP && desc.addressMode[1] == CU_TR_ADDRESS_MODE_WRAP );
+    HOST_CHECK( desc.mipmapFilterMode == CU_TR_FILTER_MODE_LINEAR && desc.maxAnisotropy == 16 );
+    HOST_CHECK( ( desc.flags & CU_TRSF_SRGB ) != 0 && ( desc.flags & CU_TRSF_NORMALIZED_COORDINATES ) != 0 );
+
+    // A missing image creates no texture, neither now nor when it is looked up again
+    HOST_CHECK( textures.textureId( "materialTexturesTest.missing.png" ) == NO_TEXTURE );
+    HOST_CHECK( textures.textureId( "materialTexturesTest.missing.png" ) == NO_TEXTURE );
+    HOST_CHECK( manager->textures.size() == 2 );
+
+    // Without a manager every image is NO_TEXTURE and nothing is ever mapped
+    MaterialTextures disabled;
+    HOST_CHECK( !disabled.enabled() );
+    HOST_CHECK( disabled.textureId( "materialTexturesTest.a.png" ) == NO_TEXTURE );
+    HOST_CHECK( disabled.processRequests() == 0 && !disabled.loading() );
+
+    std::remove( "materialTexturesTest.a.png" );
+    std::remove( "materialTexturesTest.b.png" );
+    std::remove( "materialTexturesTest.b.png.tiles" );
+}
+
+
+void testRestartOnlyForSampledPages()
+{
+    MaterialTextures textures;
+    MockManager*     manager = new MockManager;
+    textures.useManager( manager );
+    textures.restartAccumulation();
+
+    // Reads in the background: nothing is mapped by the launch that requested the pages
+    HOST_CHECK( launch( textures, *manager, { 10, 11, 12 } ) == 0 );
+
+    // The next launch maps two of them before it runs, the processRequests() after it reports them
+    manager->fill_on_prepare = { 10, 11 };
+    HOST_CHECK( launch( textures, *manager, { 12 } ) == 2 );
+
+    // A host cache hit is mapped right away, for the pull that requested it
+    manager->fill_on_process = { 13 };
+    HOST_CHECK( launch( textures, *manager, { 12, 13 } ) == 1 );
+
+    // A page filled on two devices restarts once, a page no launch requested not at all
+    manager->fill_on_prepare = { 12, 12, 99 };
+    HOST_CHECK( launch( textures, *manager, {} ) == 1 );
+
+    // An evicted page that is sampled again restarts again once it is back
+    HOST_CHECK( launch( textures, *manager, { 10 } ) == 0 );
+    manager->fill_on_prepare = { 10 };
+    HOST_CHECK( launch( textures, *manager, {} ) == 1 );
+
+    // After a restart, e.g. for a camera move, pages the earlier view requested do not restart the new
+    // accumulation, its first launch already sees them
+    HOST_CHECK( launch( textures, *manager, { 20, 21 } ) == 0 );
+    textures.restartAccumulation();
+    manager->fill_on_prepare = { 20 };
+    HOST_CHECK( launch( textures, *manager, { 21 } ) == 0 );
+    manager->fill_on_prepare = { 21 };
+    HOST_CHECK( launch( textures, *manager, {} ) == 1 );
+}
+
+
+void testLoadingAndRelease()
+{
+    writeText( "materialTexturesTest.c.png", "not decoded" );
+    bool             destroyed = false;
+    MaterialTextures textures;
+    MockManager*     manager = new MockManager;
+    manager->destroyed       = &destroyed;
+    textures.useManager( manager );
+    HOST_CHECK( !textures.loading() );
+    manager->pending_reads = 3;
+    HOST_CHECK( textures.loading() );
+    HOST_CHECK( textures.textureId( "materialTexturesTest.c.png" ) == 0 );
+
+    // A page requested before the manager is replaced is not remembered for the next one
+    textures.restartAccumulation();
+    HOST_CHECK( launch( textures, *manager, { 30 } ) == 0 );
+
+    // Replacing the manager destroys the old one and forgets its texture ids
+    MockManager* next = new MockManager;
+    textures.useManager( next );
+    HOST_CHECK( destroyed && textures.enabled() && !textures.loading() );
+    HOST_CHECK( textures.textureId( "materialTexturesTest.c.png" ) == 0 && next->textures.size() == 1 );
+    next->fill_on_prepare = { 30 };
+    HOST_CHECK( launch( textures, *next, {} ) == 0 );
+
+    destroyed       = false;
+    next->destroyed = &destroyed;
+    textures.release();
+    HOST_CHECK( destroyed && !textures.enabled() );
+    HOST_CHECK( textures.textureId( "materialTexturesTest.c.png" ) == NO_TEXTURE );
+    std::remove( "materialTexturesTest.c.png" );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testTextureIds();
+    testRestartOnlyForSampledPages();
+    testLoadingAndRelease();
+    return hostTestResult( "materialTexturesTest" );
+}
@@ -0,0 +1,820 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace
+{
+
+// Chunks below this size are not worth a thread
+const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+// Texture coordinate index of a corner without one; unlike -1 it cannot be a relative index
+const int32_t NO_TEXCOORD = std::numeric_limits<int32_t>::min();
+
+
+template <typename F>
+void parallelFor( size_t count, unsigned int num_threads, const F& fn )
+{
+    std::atomic<size_t> next( 0 );
+    const auto worker = [&]() {
+        for( size_t i = next++; i < count; i = next++ )
+            fn( i );
+    };
+    std::vector<std::thread> threads;
+    for( unsigned int t = 1; t < num_threads && t < count; ++t )
+        threads.emplace_back( worker );
+    worker();
+    for( std::thread& thread : threads )
+        thread.join();
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Tokenizing on [begin, end) ranges of the mapped file. The rules follow tinyobjloader, which
+// works on NUL terminated lines: tokens end at ' ', '\t' or '\r'.
+//
+//------------------------------------------------------------------------------
+
+inline bool isSpace( char c ) { return c == ' ' || c == '\t'; }
+inline bool isDigit( char c ) { return c >= '0' && c <= '9'; }
+
+inline const char* skipSpace( const char* p, const char* end )
+{
+    while( p < end && isSpace( *p ) )
+        ++p;
+    return p;
+}
+
+inline const char* skipSpaceCr( const char* p, const char* end )
+{
+    while( p < end && ( isSpace( *p ) || *p == '\r' ) )
+        ++p;
+    return p;
+}
+
+inline const char* tokenEnd( const char* p, const char* end )
+{
+    while( p < end && !isSpace( *p ) && *p != '\r' )
+        ++p;
+    return p;
+}
+
+// strcspn( p, "/ \t\r" )
+inline const char* cornerEnd( const char* p, const char* end )
+{
+    while( p < end && *p != '/' && !isSpace( *p ) && *p != '\r' )
+        ++p;
+    return p;
+}
+
+inline bool startsWith( const char* p, const char* end, const char* keyword, size_t length )
+{
+    return static_cast<size_t>( end - p ) >= length && std::memcmp( p, keyword, length ) == 0;
+}
+
+
+// atoi without leaving the line
+inline int parseInt( const char* p, const char* end )
+{
+    p = skipSpace( p, end );
+    bool negative = false;
+    if( p < end && ( *p == '+' || *p == '-' ) )
+        negative = *p++ == '-';
+    int value = 0;
+    while( p < end && isDigit( *p ) )
+        value = value * 10 + ( *p++ - '0' );
+    return negative ? -value : value;
+}
+
+
+// tinyobj::tryParseDouble: the same digit accumulation and scaling, so both produce identical values
+bool parseDouble( const char* s, const char* s_end, double& result )
+{
+    if( s >= s_end )
+        return false;
+
+    double      mantissa = 0.0;
+    int         exponent = 0;
+    char        sign     = '+';
+    char        exp_sign = '+';
+    const char* curr     = s;
+    int         read     = 0;
+    bool        leading_decimal_dots = false;
+
+    if( *curr == '+' || *curr == '-' )
+    {
+        sign = *curr++;
+        if( curr != s_end && *curr == '.' )
+            leading_decimal_dots = true;
+    }
+    else if( *curr == '.' )
+    {
+        leading_decimal_dots = true;
+    }
+    else if( !isDigit( *curr ) )
+    {
+        return false;
+    }
+
+    if( !leading_decimal_dots )
+    {
+        while( curr != s_end && isDigit( *curr ) )
+        {
+            mantissa = mantissa * 10 + static_cast<int>( *curr - '0' );
+            ++curr;
+            ++read;
+        }
+        if( read == 0 )
+            return false;
+    }
+
+    if( curr != s_end )
+    {
+        if( *curr == '.' )
+        {
+            static const double pow_lut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+            const int lut_entries = sizeof( pow_lut ) / sizeof( pow_lut[0] );
+            ++curr;
+            read = 1;
+            while( curr != s_end && isDigit( *curr ) )
+            {
+                mantissa += static_cast<int>( *curr - '0' ) * ( read < lut_entries ? pow_lut[read] : std::pow( 10.0, -read ) );
+                ++read;
+                ++curr;
+            }
+        }
+
+        if( curr != s_end && ( *curr == 'e' || *curr == 'E' ) )
+        {
+            ++curr;
+            if( curr != s_end && ( *curr == '+' || *curr == '-' ) )
+                exp_sign = *curr++;
+            else if( curr == s_end || !isDigit( *curr ) )
+                return false;
+
+            read = 0;
+            while( curr != s_end && isDigit( *curr ) )
+            {
+                exponent = exponent * 10 + static_cast<int>( *curr - '0' );
+                ++curr;
+                ++read;
+            }
+            exponent *= exp_sign == '+' ? 1 : -1;
+            if( read == 0 )
+                return false;
+        }
+    }
+
+    result = ( sign == '+' ? 1 : -1 ) * ( exponent ? std::ldexp( mantissa * std::pow( 5.0, exponent ), exponent ) : mantissa );
+    return true;
+}
+
+
+// tinyobj::parseReal: the next token as a float, 0 when it is not a number
+inline float parseReal( const char*& p, const char* end )
+{
+    p = skipSpace( p, end );
+    const char* token_end = tokenEnd( p, end );
+    double      value     = 0.0;
+    parseDouble( p, token_end, value );
+    p = token_end;
+    return static_cast<float>( value );
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Chunk parsing
+//
+//------------------------------------------------------------------------------
+
+struct MaterialEvent
+{
+    uint32_t    face;  // first chunk-local face the material applies to
+    std::string name;
+};
+
+
+struct ChunkResult
+{
+    const char* begin = nullptr;
+    const char* end   = nullptr;
+
+    std::vector<float>         positions;
+    std::vector<float>         texcoords;
+    std::vector<int32_t>       corners;           // position indices, relative ones still without the chunk's vertex base
+    std::vector<uint32_t>      relative_corners;  // entries of corners that need the vertex base
+    std::vector<int32_t>       corner_texcoords;           // texture coordinate indices, NO_TEXCOORD if the corner has none
+    std::vector<uint32_t>      relative_corner_texcoords;  // entries of corner_texcoords that need the texcoord base
+    std::vector<uint32_t>      face_sizes;        // corners per face
+    std::vector<uint32_t>      face_groups;       // g/o lines in this chunk before the face
+    std::vector<MaterialEvent> material_events;
+    std::vector<std::vector<std::string> > mtllibs;
+    uint32_t                   groups = 0;
+
+    // Filled by the merge
+    uint32_t vertex_base   = 0;
+    uint32_t texcoord_base = 0;
+    uint32_t group_base    = 0;
+    int32_t  initial_material = -1;
+
+    // Filled by the triangulation
+    std::vector<uint32_t> triangles;
+    std::vector<int32_t>  triangle_texcoords;
+    std::vector<int32_t>  triangle_materials;
+    std::vector<uint32_t> triangle_shapes;
+
+    const char* error_at = nullptr;
+    std::string error;
+    bool        invalid_texcoords = false;
+};
+
+
+// One corner "v", "v/vt", "v//vn" or "v/vt/vn"; like tinyobj, zero indices are an error
+bool parseCorner( const char*& p, const char* end, int32_t local_vertices, int32_t local_texcoords, int32_t& index,
+                  bool& relative, int32_t& texcoord, bool& texcoord_relative )
+{
+    const int v = parseInt( p, end );
+    if( v == 0 )
+        return false;
+    relative = v < 0;
+    index    = relative ? local_vertices + v : v - 1;
+    texcoord          = NO_TEXCOORD;
+    texcoord_relative = false;
+
+    p = cornerEnd( p, end );
+    for( int component = 0; component < 2 && p < end && *p == '/'; ++component )
+    {
+        ++p;
+        if( component == 0 && p < end && *p == '/' )
+        {
+            // v//vn
+            ++p;
+            component = 1;
+        }
+        const int value = parseInt( p, end );
+        if( value == 0 )
+            return false;
+        if( component == 0 )
+        {
+            texcoord_relative = value < 0;
+            texcoord          = texcoord_relative ? local_texcoords + value : value - 1;
+        }
+        p = cornerEnd( p, end );
+    }
+    return true;
+}
+
+
+void parseChunk( ChunkResult& chunk )
+{
+    const char* p = chunk.begin;
+    while( p < chunk.end )
+    {
+        const char* line_end = static_cast<const char*>( std::memchr( p, '\n', chunk.end - p ) );
+        const char* next     = line_end ? line_end + 1 : chunk.end;
+        if( !line_end )
+            line_end = chunk.end;
+        if( line_end > p && line_end[-1] == '\r' )
+            --line_end;
+
+        const char* token = skipSpace( p, line_end );
+        const char* line  = p;
+        p                 = next;
+        if( token == line_end || *token == '#' )
+            continue;
+
+        const bool second_is_space = line_end - token > 1 && isSpace( token[1] );
+        if( token[0] == 'v' && second_is_space )
+        {
+            token += 2;
+            const float x = parseReal( token, line_end );
+            const float y = parseReal( token, line_end );
+            const float z = parseReal( token, line_end );
+            chunk.positions.push_back( x );
+            chunk.positions.push_back( y );
+            chunk.positions.push_back( z );
+        }
+        else if( token[0] == 'v' && line_end - token > 2 && token[1] == 't' && isSpace( token[2] ) )
+        {
+            token += 3;
+            const float u = parseReal( token, line_end );
+            const float v = parseReal( token, line_end );
+            chunk.texcoords.push_back( u );
+            chunk.texcoords.push_back( v );
+        }
+        else if( token[0] == 'f' && second_is_space )
+        {
+            token = skipSpace( token + 2, line_end );
+            const int32_t local_vertices  = static_cast<int32_t>( chunk.positions.size() / 3 );
+            const int32_t local_texcoords = static_cast<int32_t>( chunk.texcoords.size() / 2 );
+            uint32_t      size            = 0;
+            while( token < line_end )
+            {
+                int32_t index, texcoord;
+                bool    relative, texcoord_relative;
+                if( !parseCorner( token, line_end, local_vertices, local_texcoords, index, relative, texcoord, texcoord_relative ) )
+                {
+                    chunk.error_at = line;
+                    chunk.error    = "Failed parse `f' line (e.g. zero value for face index)";
+                    return;
+                }
+                if( relative )
+                    chunk.relative_corners.push_back( static_cast<uint32_t>( chunk.corners.size() ) );
+                chunk.corners.push_back( index );
+                if( texcoord_relative )
+                    chunk.relative_corner_texcoords.push_back( static_cast<uint32_t>( chunk.corner_texcoords.size() ) );
+                chunk.corner_texcoords.push_back( texcoord );
+                ++size;
+                token = skipSpaceCr( token, line_end );
+            }
+            chunk.face_sizes.push_back( size );
+            chunk.face_groups.push_back( chunk.groups );
+        }
+        else if( startsWith( token, line_end, "usemtl", 6 ) )
+        {
+            token = skipSpace( token + 6, line_end );
+            MaterialEvent event;
+            event.face = static_cast<uint32_t>( chunk.face_sizes.size() );
+            event.name.assign( token, tokenEnd( token, line_end ) );
+            chunk.material_events.push_back( std::move( event ) );
+        }
+        else if( startsWith( token, line_end, "mtllib", 6 ) && line_end - token > 6 && isSpace( token[6] ) )
+        {
+            std::vector<std::string> filenames;
+            std::istringstream       names( std::string( token + 7, line_end ) );
+            for( std::string name; std::getline( names, name, ' ' ); )
+                if( !name.empty() )
+                    filenames.push_back( name );
+            chunk.mtllibs.push_back( filenames );
+        }
+        else if( ( token[0] == 'g' || token[0] == 'o' ) && second_is_space )
+        {
+            ++chunk.groups;
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Triangulation, ported from tinyobj::exportGroupsToShape (triangulate = true)
+//
+//------------------------------------------------------------------------------
+
+// https://wrf.ecse.rpi.edu//Research/Short_Notes/pnpoly.html
+int pnpoly( int nvert, const float* vertx, const float* verty, float testx, float testy )
+{
+    int c = 0;
+    for( int i = 0, j = nvert - 1; i < nvert; j = i++ )
+    {
+        if( ( ( verty[i] > testy ) != ( verty[j] > testy ) )
+            && ( testx < ( vertx[j] - vertx[i] ) * ( testy - verty[i] ) / ( verty[j] - verty[i] ) + vertx[i] ) )
+            c = !c;
+    }
+    return c;
+}
+
+
+// Appends the triangles as corner slots of face (0 to npolys - 1), so that the other per corner indices can follow
+void triangulateFace( const int32_t* face, size_t npolys, const std::vector<float>& v, std::vector<uint32_t>& out )
+{
+    if( npolys == 3 )
+    {
+        const uint32_t slots[3] = { 0, 1, 2 };
+        out.insert( out.end(), slots, slots + 3 );
+        return;
+    }
+
+    // Find the two axes to work in
+    size_t axes[2] = { 1, 2 };
+    for( size_t k = 0; k < npolys; ++k )
+    {
+        const size_t vi0 = static_cast<size_t>( face[( k + 0 ) % npolys] );
+        const size_t vi1 = static_cast<size_t>( face[( k + 1 ) % npolys] );
+        const size_t vi2 = static_cast<size_t>( face[( k + 2 ) % npolys] );
+        const float  e0x = v[vi1 * 3 + 0] - v[vi0 * 3 + 0];
+        const float  e0y = v[vi1 * 3 + 1] - v[vi0 * 3 + 1];
+        const float  e0z = v[vi1 * 3 + 2] - v[vi0 * 3 + 2];
+        const float  e1x = v[vi2 * 3 + 0] - v[vi1 * 3 + 0];
+        const float  e1y = v[vi2 * 3 + 1] - v[vi1 * 3 + 1];
+        const float  e1z = v[vi2 * 3 + 2] - v[vi1 * 3 + 2];
+        const float  cx  = std::fabs( e0y * e1z - e0z * e1y );
+        const float  cy  = std::fabs( e0z * e1x - e0x * e1z );
+        const float  cz  = std::fabs( e0x * e1y - e0y * e1x );
+        const float  epsilon = std::numeric_limits<float>::epsilon();
+        if( cx > epsilon || cy > epsilon || cz > epsilon )
+        {
+            // Found a corner
+            if( !( cx > cy && cx > cz ) )
+            {
+                axes[0] = 0;
+                if( cz > cx && cz > cy )
+                    axes[1] = 1;
+            }
+            break;
+        }
+    }
+
+    float area = 0;
+    for( size_t k = 0; k < npolys; ++k )
+    {
+        const size_t vi0 = static_cast<size_t>( face[( k + 0 ) % npolys] );
+        const size_t vi1 = static_cast<size_t>( face[( k + 1 ) % npolys] );
+        area += ( v[vi0 * 3 + axes[0]] * v[vi1 * 3 + axes[1]] - v[vi0 * 3 + axes[1]] * v[vi1 * 3 + axes[0]] ) * 0.5f;
+    }
+
+    std::vector<uint32_t> remaining( npolys );
+    for( size_t k = 0; k < npolys; ++k )
+        remaining[k] = static_cast<uint32_t>( k );
+    size_t guess_vert = 0;
+    float  vx[3];
+    float  vy[3];
+    uint32_t ind[3];
+
+    // How many iterations can we do without decreasing the remaining vertices
+    size_t remaining_iterations = remaining.size();
+    size_t previous_remaining   = remaining.size();
+
+    while( remaining.size() > 3 && remaining_iterations > 0 )
+    {
+        npolys = remaining.size();
+        if( guess_vert >= npolys )
+            guess_vert -= npolys;
+
+        if( previous_remaining != npolys )
+        {
+            previous_remaining   = npolys;
+            remaining_iterations = npolys;
+        }
+        else
+        {
+            remaining_iterations--;
+        }
+
+        for( size_t k = 0; k < 3; k++ )
+        {
+            ind[k] = remaining[( guess_vert + k ) % npolys];
+            vx[k]  = v[face[ind[k]] * 3 + axes[0]];
+            vy[k]  = v[face[ind[k]] * 3 + axes[1]];
+        }
+        const float e0x   = vx[1] - vx[0];
+        const float e0y   = vy[1] - vy[0];
+        const float e1x   = vx[2] - vx[1];
+        const float e1y   = vy[2] - vy[1];
+        const float cross = e0x * e1y - e0y * e1x;
+        // An internal angle
+        if( cross * area < 0.0f )
+        {
+            guess_vert += 1;
+            continue;
+        }
+
+        // Check all other verts in case they are inside this triangle
+        bool overlap = false;
+        for( size_t other = 3; other < npolys; ++other )
+        {
+            const size_t ovi = static_cast<size_t>( face[remaining[( guess_vert + other ) % npolys]] );
+            if( pnpoly( 3, vx, vy, v[ovi * 3 + axes[0]], v[ovi * 3 + axes[1]] ) )
+            {
+                overlap = true;
+                break;
+            }
+        }
+        if( overlap )
+        {
+            guess_vert += 1;
+            continue;
+        }
+
+        // This triangle is an ear
+        out.insert( out.end(), ind, ind + 3 );
+        remaining.erase( remaining.begin() + ( guess_vert + 1 ) % npolys );
+    }
+
+    if( remaining.size() == 3 )
+        out.insert( out.end(), remaining.begin(), remaining.end() );
+}
+
+
+//------------------------------------------------------------------------------
+//
+// MTL
+//
+//------------------------------------------------------------------------------
+
+inline float3 parseColor( const char* p, const char* end )
+{
+    float3 c;
+    c.x = parseReal( p, end );
+    c.y = parseReal( p, end );
+    c.z = parseReal( p, end );
+    return c;
+}
+
+
+// tinyobj::ParseTextureNameAndOption: options are skipped, the name is the rest of the line
+std::string parseTextureName( const char* p, const char* end )
+{
+    // Option names and the number of tokens each one takes
+    static const std::pair<const char*, int> options[] = {
+        { "-blendu", 1 }, { "-blendv", 1 }, { "-clamp", 1 },   { "-boost", 1 },   { "-bm", 1 },
+        { "-o", 3 },      { "-s", 3 },      { "-t", 3 },       { "-type", 1 },    { "-texres", 1 },
+        { "-imfchan", 1 }, { "-mm", 2 },    { "-colorspace", 1 } };
+
+    for( ;; )
+    {
+        p = skipSpace( p, end );
+        const char* token_end = tokenEnd( p, end );
+        int         arguments = -1;
+        for( const auto& option : options )
+            if( static_cast<size_t>( token_end - p ) == std::strlen( option.first ) && std::memcmp( p, option.first, token_end - p ) == 0 )
+                arguments = option.second;
+        if( arguments < 0 )
+            break;
+        p = token_end;
+        for( int a = 0; a < arguments; ++a )
+            p = tokenEnd( skipSpace( p, end ), end );
+    }
+    while( end > p && ( isSpace( end[-1] ) || end[-1] == '\r' ) )
+        --end;
+    return std::string( p, end );
+}
+
+
+bool loadMtl( const std::string& filename, std::vector<ObjMaterial>& materials, std::map<std::string, int>& material_map )
+{
+    MappedFile file;
+    if( !file.open( filename ) )
+        return false;
+
+    ObjMaterial material;
+    // Not reset by newmtl, as in tinyobj: after the first Kd of the file a map_Kd without Kd leaves it 0
+    bool        has_diffuse = false;
+    const auto  flush       = [&]() {
+        if( material.name.empty() )
+            return;
+        material_map.insert( std::make_pair( material.name, static_cast<int>( materials.size() ) ) );
+        materials.push_back( material );
+    };
+
+    const char* p   = file.data();
+    const char* end = p + file.size();
+    while( p < end )
+    {
+        const char* line_end = static_cast<const char*>( std::memchr( p, '\n', end - p ) );
+        const char* next     = line_end ? line_end + 1 : end;
+        if( !line_end )
+            line_end = end;
+        if( line_end > p && line_end[-1] == '\r' )
+            --line_end;
+
+        const char* token = skipSpace( p, line_end );
+        p                 = next;
+        if( token == line_end || *token == '#' )
+            continue;
+
+        if( startsWith( token, line_end, "newmtl", 6 ) && line_end - token > 6 && isSpace( token[6] ) )
+        {
+            flush();
+            material      = ObjMaterial();
+            material.name = std::string( token + 7, line_end );
+        }
+        else if( startsWith( token, line_end, "Kd", 2 ) && line_end - token > 2 && isSpace( token[2] ) )
+        {
+            material.diffuse = parseColor( token + 2, line_end );
+            has_diffuse      = true;
+        }
+        else if( startsWith( token, line_end, "Ks", 2 ) && line_end - token > 2 && isSpace( token[2] ) )
+            material.specular = parseColor( token + 2, line_end );
+        else if( startsWith( token, line_end, "Ke", 2 ) && line_end - token > 2 && isSpace( token[2] ) )
+            material.emission = parseColor( token + 2, line_end );
+        else if( startsWith( token, line_end, "Ns", 2 ) && line_end - token > 2 && isSpace( token[2] ) )
+        {
+            token += 2;
+            material.shininess = parseReal( token, line_end );
+        }
+        else if( startsWith( token, line_end, "Ni", 2 ) && line_end - token > 2 && isSpace( token[2] ) )
+        {
+            token += 2;
+            material.ior = parseReal( token, line_end );
+        }
+        else if( startsWith( token, line_end, "map_Kd", 6 ) && line_end - token > 6 && isSpace( token[6] ) )
+        {
+            material.diffuse_texname = parseTextureName( token + 7, line_end );
+            if( !has_diffuse )
+                material.diffuse = { 0.6f, 0.6f, 0.6f };
+        }
+        else if( startsWith( token, line_end, "map_Ks", 6 ) && line_end - token > 6 && isSpace( token[6] ) )
+            material.specular_texname = parseTextureName( token + 7, line_end );
+    }
+    flush();
+    return true;
+}
+
+
+size_t lineNumber( const char* begin, const char* at )
+{
+    return 1 + static_cast<size_t>( std::count( begin, at, '\n' ) );
+}
+
+}  // namespace
+
+
+bool loadObj( const std::string& filename, ObjMesh& mesh, std::string& warn, std::string& err, unsigned int num_threads )
+{
+    mesh = ObjMesh();
+
+    MappedFile file;
+    if( !file.open( filename ) )
+    {
+        err += "Cannot open " + filename + "\n";
+        return false;
+    }
+    if( num_threads == 0 )
+        num_threads = std::max( 1u, std::thread::hardware_concurrency() );
+
+    // Line aligned chunks, a few per thread to even out the load
+    const char*  data       = file.data();
+    const char*  data_end   = data + file.size();
+    const size_t num_chunks = std::max<size_t>( 1, std::min<size_t>( num_threads * 4, file.size() / MIN_CHUNK_BYTES ) );
+    std::vector<ChunkResult> chunks( num_chunks );
+    const char* begin = data;
+    for( size_t c = 0; c < num_chunks; ++c )
+    {
+        const char* end = c + 1 == num_chunks ? data_end : std::max( begin, data + file.size() * ( c + 1 ) / num_chunks );
+        if( end < data_end )
+        {
+            const char* newline = static_cast<const char*>( std::memchr( end, '\n', data_end - end ) );
+            end                 = newline ? newline + 1 : data_end;
+        }
+        chunks[c].begin = begin;
+        chunks[c].end   = end;
+        begin           = end;
+    }
+
+    parallelFor( num_chunks, num_threads, [&]( size_t c ) { parseChunk( chunks[c] ); } );
+    for( const ChunkResult& chunk : chunks )
+    {
+        if( !chunk.error.empty() )
+        {
+            std::stringstream ss;
+            ss << filename << ":" << lineNumber( data, chunk.error_at ) << ": " << chunk.error << "\n";
+            err += ss.str();
+            return false;
+        }
+    }
+
+    // Material libraries in file order, the first loadable file of each mtllib line counts
+    const std::string          mtl_dir = filename.substr( 0, filename.rfind( '/' ) + 1 );
+    std::map<std::string, int> material_map;
+    for( const ChunkResult& chunk : chunks )
+    {
+        for( const std::vector<std::string>& filenames : chunk.mtllibs )
+        {
+            bool found = false;
+            for( size_t i = 0; i < filenames.size() && !found; ++i )
+            {
+                mesh.material_libraries.push_back( mtl_dir + filenames[i] );
+                found = loadMtl( mesh.material_libraries.back(), mesh.materials, material_map );
+            }
+            if( !found )
+                warn += "Failed to load material file(s). Use default material.\n";
+        }
+    }
+
+    // Prefix sums over the chunks, carrying the active material across chunk boundaries
+    uint32_t num_vertices = 0, num_texcoords = 0, num_groups = 0;
+    int32_t  material     = -1;
+    for( ChunkResult& chunk : chunks )
+    {
+        chunk.vertex_base      = num_vertices;
+        chunk.texcoord_base    = num_texcoords;
+        chunk.group_base       = num_groups;
+        chunk.initial_material = material;
+        num_vertices  += static_cast<uint32_t>( chunk.positions.size() / 3 );
+        num_texcoords += static_cast<uint32_t>( chunk.texcoords.size() / 2 );
+        num_groups    += chunk.groups;
+        for( const MaterialEvent& event : chunk.material_events )
+        {
+            auto it  = material_map.find( event.name );
+            material = it != material_map.end() ? it->second : -1;
+            if( it == material_map.end() )
+                warn += "material [ '" + event.name + "' ] not found in .mtl\n";
+        }
+    }
+
+    mesh.positions.resize( static_cast<size_t>( num_vertices ) * 3 );
+    mesh.texcoords.resize( static_cast<size_t>( num_texcoords ) * 2 );
+    parallelFor( num_chunks, num_threads, [&]( size_t c ) {
+        ChunkResult& chunk = chunks[c];
+        if( !chunk.positions.empty() )
+            std::memcpy( &mesh.positions[static_cast<size_t>( chunk.vertex_base ) * 3], chunk.positions.data(), chunk.positions.size() * sizeof( float ) );
+        if( !chunk.texcoords.empty() )
+            std::memcpy( &mesh.texcoords[static_cast<size_t>( chunk.texcoord_base ) * 2], chunk.texcoords.data(), chunk.texcoords.size() * sizeof( float ) );
+        std::vector<float>().swap( chunk.positions );
+        std::vector<float>().swap( chunk.texcoords );
+    } );
+
+    // Resolve indices and triangulate every chunk against the merged positions. Texture coordinates
+    // follow the position indices through the triangulation and are only kept if the file has any.
+    const bool has_texcoords = num_texcoords > 0;
+    parallelFor( num_chunks, num_threads, [&]( size_t c ) {
+        ChunkResult& chunk = chunks[c];
+        for( uint32_t i : chunk.relative_corners )
+            chunk.corners[i] += static_cast<int32_t>( chunk.vertex_base );
+        for( int32_t index : chunk.corners )
+        {
+            if( index < 0 || static_cast<uint32_t>( index ) >= num_vertices )
+            {
+                chunk.error = "vertex index out of range";
+                return;
+            }
+        }
+        for( uint32_t i : chunk.relative_corner_texcoords )
+            chunk.corner_texcoords[i] += static_cast<int32_t>( chunk.texcoord_base );
+        for( int32_t& texcoord : chunk.corner_texcoords )
+        {
+            if( texcoord == NO_TEXCOORD )
+            {
+                texcoord = -1;
+            }
+            else if( texcoord < 0 || static_cast<uint32_t>( texcoord ) >= num_texcoords )
+            {
+                texcoord                = -1;
+                chunk.invalid_texcoords = true;
+            }
+        }
+
+        int32_t               material = chunk.initial_material;
+        size_t                event    = 0;
+        size_t                corner   = 0;
+        std::vector<uint32_t> slots;
+        for( uint32_t f = 0; f < chunk.face_sizes.size(); ++f )
+        {
+            for( ; event < chunk.material_events.size() && chunk.material_events[event].face == f; ++event )
+            {
+                auto it  = material_map.find( chunk.material_events[event].name );
+                material = it != material_map.end() ? it->second : -1;
+            }
+
+            const uint32_t size = chunk.face_sizes[f];
+            if( size >= 3 )
+            {
+                slots.clear();
+                triangulateFace( &chunk.corners[corner], size, mesh.positions, slots );
+                for( uint32_t slot : slots )
+                    chunk.triangles.push_back( static_cast<uint32_t>( chunk.corners[corner + slot] ) );
+                if( has_texcoords )
+                    for( uint32_t slot : slots )
+                        chunk.triangle_texcoords.push_back( chunk.corner_texcoords[corner + slot] );
+                const size_t count = slots.size() / 3;
+                chunk.triangle_materials.insert( chunk.triangle_materials.end(), count, material );
+                chunk.triangle_shapes.insert( chunk.triangle_shapes.end(), count, chunk.group_base + chunk.face_groups[f] );
+            }
+            corner += size;
+        }
+        std::vector<int32_t>().swap( chunk.corners );
+        std::vector<int32_t>().swap( chunk.corner_texcoords );
+    } );
+
+    size_t num_triangles = 0;
+    bool   invalid_texcoords = false;
+    std::vector<size_t> triangle_base( num_chunks );
+    for( size_t c = 0; c < num_chunks; ++c )
+    {
+        if( !chunks[c].error.empty() )
+        {
+            err += filename + ": " + chunks[c].error + "\n";
+            return false;
+        }
+        triangle_base[c] = num_triangles;
+        num_triangles += chunks[c].triangle_materials.size();
+        invalid_texcoords |= chunks[c].invalid_texcoords;
+    }
+    if( invalid_texcoords )
+        warn += "Texcoord indices out of bounds, ignored.\n";
+
+    mesh.indices.resize( num_triangles * 3 );
+    mesh.texcoord_indices.resize( has_texcoords ? num_triangles * 3 : 0 );
+    mesh.material_ids.resize( num_triangles );
+    mesh.shape_ids.resize( num_triangles );
+    parallelFor( num_chunks, num_threads, [&]( size_t c ) {
+        const ChunkResult& chunk = chunks[c];
+        std::copy( chunk.triangles.begin(), chunk.triangles.end(), mesh.indices.begin() + triangle_base[c] * 3 );
+        std::copy( chunk.triangle_texcoords.begin(), chunk.triangle_texcoords.end(), mesh.texcoord_indices.begin() + triangle_base[c] * 3 );
+        std::copy( chunk.triangle_materials.begin(), chunk.triangle_materials.end(), mesh.material_ids.begin() + triangle_base[c] );
+        std::copy( chunk.triangle_shapes.begin(), chunk.triangle_shapes.end(), mesh.shape_ids.begin() + triangle_base[c] );
+    } );
+    return true;
+}
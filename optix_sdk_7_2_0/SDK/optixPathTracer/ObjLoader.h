@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector_types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+*   Parallel Wavefront OBJ/MTL loader for the geometry the path tracer uses: positions, texture
+*   coordinates, triangles, material ids and shape boundaries (normals are skipped).
+*
+*   The file is memory mapped and split into line aligned chunks that are parsed concurrently.
+*   Chunk results are merged with prefix sums over their vertex, face and group counts, which also
+*   resolves relative (negative) indices and the usemtl state carried across chunk boundaries.
+*   Polygons are triangulated with the same ear clipping and the numbers are parsed with the same
+*   arithmetic as tinyobjloader, so for valid files the output matches tinyobj::LoadObj exactly:
+*   positions and texcoords equal attrib.vertices and attrib.texcoords, and the triangles with their
+*   texture coordinate indices, material ids and shapes appear in the same order as in its shapes.
+*/
+
+struct ObjMaterial
+{
+    std::string name;
+    float3      diffuse   = { 0.f, 0.f, 0.f };  // Kd
+    float3      specular  = { 0.f, 0.f, 0.f };  // Ks
+    float3      emission  = { 0.f, 0.f, 0.f };  // Ke
+    float       shininess = 1.f;                // Ns
+    float       ior       = 1.f;                // Ni
+    std::string diffuse_texname;                // map_Kd, as written in the file; with a map, Kd defaults to 0.6 until the library has a Kd
+    std::string specular_texname;               // map_Ks
+};
+
+
+struct ObjMesh
+{
+    std::vector<float>       positions;     // x, y, z per vertex in file order
+    std::vector<float>       texcoords;     // u, v per texture coordinate in file order
+    std::vector<uint32_t>    indices;       // three position indices per triangle
+    std::vector<int32_t>     texcoord_indices;  // three per triangle, index into texcoords or -1; empty without vt lines
+    std::vector<int32_t>     material_ids;  // per triangle, index into materials or -1
+    std::vector<uint32_t>    shape_ids;     // per triangle, non-decreasing; a new value starts a new tinyobj shape
+    std::vector<ObjMaterial> materials;     // in the order of the mtllib files
+    std::vector<std::string> material_libraries;  // every .mtl path looked up, including ones that failed to load
+
+    size_t numVertices() const  { return positions.size() / 3; }
+    size_t numTriangles() const { return material_ids.size(); }
+};
+
+
+/*
+    Load filename into mesh. Material libraries are looked up next to the OBJ file. num_threads 0
+    uses every hardware thread. Returns false and describes the problem in err when the file cannot
+    be read or is malformed (zero or out of range vertex indices); non fatal problems such as
+    missing materials or out of range texture coordinate indices (loaded as -1) are reported in warn.
+*/
+bool loadObj( const std::string& filename, ObjMesh& mesh, std::string& warn, std::string& err, unsigned int num_threads = 0 );
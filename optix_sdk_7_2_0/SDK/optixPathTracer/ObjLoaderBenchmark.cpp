@@ -0,0 +1,119 @@
+//
+// objLoaderBenchmark - parses OBJ files with tinyobjloader and with the parallel ObjLoader at
+// increasing thread counts, checks that both produce the same positions, texture coordinates,
+// triangles, material ids, texture maps and shapes, and reports the throughput in MB/s.
+//
+
+#include "ObjLoader.h"
+#include "ObjLoaderCompare.h"
+#include "tiny_obj_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+
+void printUsageAndExit( const char* argv0 )
+{
+    std::cerr << "Usage  : " << argv0 << " [options] <file.obj>...\n";
+    std::cerr << "Options: --threads <n,n,...>        Thread counts to measure (default 1,2,4,... up to the hardware threads)\n";
+    std::cerr << "         --repeat <n>               Runs per measurement, the fastest counts (default 3)\n";
+    exit( 0 );
+}
+
+
+int main( int argc, char* argv[] )
+{
+    std::vector<std::string>  files;
+    std::vector<unsigned int> thread_counts;
+    int                       repeat = 3;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+            printUsageAndExit( argv[0] );
+        else if( arg == "--threads" && i + 1 < argc )
+        {
+            std::stringstream list( argv[++i] );
+            for( std::string n; std::getline( list, n, ',' ); )
+                thread_counts.push_back( std::max( 1, atoi( n.c_str() ) ) );
+        }
+        else if( arg == "--repeat" && i + 1 < argc )
+            repeat = std::max( 1, atoi( argv[++i] ) );
+        else if( arg[0] != '-' )
+            files.push_back( arg );
+        else
+        {
+            std::cerr << "Unknown option '" << arg << "'\n";
+            printUsageAndExit( argv[0] );
+        }
+    }
+    if( files.empty() )
+        printUsageAndExit( argv[0] );
+    if( thread_counts.empty() )
+    {
+        const unsigned int hardware = std::max( 1u, std::thread::hardware_concurrency() );
+        for( unsigned int n = 1; n < hardware; n *= 2 )
+            thread_counts.push_back( n );
+        thread_counts.push_back( hardware );
+    }
+
+    int result = 0;
+    for( const std::string& filename : files )
+    {
+        std::ifstream size_probe( filename, std::ios::binary | std::ios::ate );
+        const double  megabytes = static_cast<double>( size_probe.tellg() ) / ( 1024.0 * 1024.0 );
+
+        tinyobj::attrib_t                attrib;
+        std::vector<tinyobj::shape_t>    shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string                      warn, err;
+        const std::string                mtl_dir = filename.substr( 0, filename.rfind( '/' ) + 1 );
+        const Clock::time_point          t0      = Clock::now();
+        if( !tinyobj::LoadObj( &attrib, &shapes, &materials, &warn, &err, filename.c_str(), mtl_dir.c_str() ) )
+        {
+            std::cerr << filename << ": tinyobj failed: " << err << std::endl;
+            result = 1;
+            continue;
+        }
+        const double tinyobj_seconds = std::chrono::duration<double>( Clock::now() - t0 ).count();
+
+        std::cout << std::fixed << std::setprecision( 1 ) << filename << " (" << megabytes << " MB)\n"
+                  << "  tinyobj          " << std::setw( 8 ) << megabytes / tinyobj_seconds << " MB/s\n";
+
+        for( unsigned int threads : thread_counts )
+        {
+            double best = 1e30;
+            ObjMesh mesh;
+            for( int r = 0; r < repeat; ++r )
+            {
+                std::string obj_warn, obj_err;
+                const Clock::time_point start = Clock::now();
+                if( !loadObj( filename, mesh, obj_warn, obj_err, threads ) )
+                {
+                    std::cerr << obj_err;
+                    return 1;
+                }
+                best = std::min( best, std::chrono::duration<double>( Clock::now() - start ).count() );
+            }
+
+            const std::string difference = compareWithTinyObj( attrib, shapes, materials, mesh );
+            std::cout << "  ObjLoader " << std::setw( 3 ) << threads << "t   " << std::setw( 8 ) << megabytes / best
+                      << " MB/s  " << std::setprecision( 2 ) << tinyobj_seconds / best << "x  "
+                      << ( difference.empty() ? "identical" : "MISMATCH: " + difference ) << std::setprecision( 1 ) << "\n";
+            if( !difference.empty() )
+                result = 1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ObjLoader.h"
+#include "tiny_obj_loader.h"
+
+#include <string>
+#include <vector>
+
+/*
+*   Comparison of a loadObj() result with tinyobj::LoadObj() on the same file, shared by
+*   objLoaderBenchmark and objLoaderTest.
+*/
+
+inline bool sameColor( const float3& color, const tinyobj::real_t value[3] )
+{
+    return color.x == value[0] && color.y == value[1] && color.z == value[2];
+}
+
+// Returns an empty string when the results match, otherwise the first difference
+inline std::string compareWithTinyObj( const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+                                       const std::vector<tinyobj::material_t>& materials, const ObjMesh& mesh )
+{
+    if( attrib.vertices != mesh.positions )
+        return "positions differ";
+    if( attrib.texcoords != mesh.texcoords )
+        return "texture coordinates differ";
+    if( materials.size() != mesh.materials.size() )
+        return "material count differs";
+    for( size_t m = 0; m < materials.size(); ++m )
+    {
+        if( materials[m].name != mesh.materials[m].name )
+            return "name of material " + std::to_string( m ) + " differs";
+        if( !sameColor( mesh.materials[m].diffuse, materials[m].diffuse ) || !sameColor( mesh.materials[m].specular, materials[m].specular )
+            || !sameColor( mesh.materials[m].emission, materials[m].emission ) )
+            return "colors of material " + std::to_string( m ) + " differ";
+        if( materials[m].diffuse_texname != mesh.materials[m].diffuse_texname
+            || materials[m].specular_texname != mesh.materials[m].specular_texname )
+            return "texture maps of material " + std::to_string( m ) + " differ";
+    }
+
+    size_t triangle = 0;
+    for( size_t s = 0; s < shapes.size(); ++s )
+    {
+        const tinyobj::mesh_t& shape = shapes[s].mesh;
+        for( size_t f = 0; f < shape.num_face_vertices.size(); ++f, ++triangle )
+        {
+            if( triangle >= mesh.numTriangles() )
+                return "too few triangles";
+            for( int k = 0; k < 3; ++k )
+                if( static_cast<uint32_t>( shape.indices[f * 3 + k].vertex_index ) != mesh.indices[triangle * 3 + k] )
+                    return "indices of triangle " + std::to_string( triangle ) + " differ";
+            for( int k = 0; k < 3 && !mesh.texcoord_indices.empty(); ++k )
+                if( shape.indices[f * 3 + k].texcoord_index != mesh.texcoord_indices[triangle * 3 + k] )
+                    return "texture coordinates of triangle " + std::to_string( triangle ) + " differ";
+            if( shape.material_ids[f] != mesh.material_ids[triangle] )
+                return "material of triangle " + std::to_string( triangle ) + " differs";
+            // Shape boundaries: a new tinyobj shape must start a new shape id and vice versa
+            const bool starts_shape = f == 0 && triangle > 0;
+            if( triangle > 0 && starts_shape != ( mesh.shape_ids[triangle] != mesh.shape_ids[triangle - 1] ) )
+                return "shape boundary at triangle " + std::to_string( triangle ) + " differs";
+        }
+    }
+    if( triangle != mesh.numTriangles() )
+        return "too many triangles";
+    return std::string();
+}
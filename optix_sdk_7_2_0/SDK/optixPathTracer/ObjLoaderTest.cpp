@@ -0,0 +1,283 @@
+//
+// objLoaderTest - host tests of loadObj() in ObjLoader.h against tinyobj::LoadObj on a generated
+// OBJ/MTL pair: relative and absolute indices, CRLF line ends, concave polygons, and usemtl and g/o
+// lines around every chunk boundary, loaded with 1, 2 and 7 threads.
+//
+
+#include "ObjLoader.h"
+#include "ObjLoaderCompare.h"
+#include "HostTest.h"
+#include "tiny_obj_loader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+const std::string OBJ_FILE   = "objLoaderTest.obj";
+const std::string MTL_FILE   = "objLoaderTest.mtl";
+const std::string MTL_FILE_2 = "objLoaderTest2.mtl";
+
+// ObjLoader splits files of at least 256 KiB into up to 4 chunks per thread. A file of a little over
+// 8 such sizes is split in 4 chunks with 1 thread and in 8 with 2 or 7 threads, the boundaries of the
+// 4 are among those of the 8.
+const size_t OBJ_SIZE   = 8 * 256 * 1024 + 4099;
+const size_t NUM_CHUNKS = 8;
+
+
+// Generated OBJ text that keeps track of what its indices may refer to
+class ObjWriter
+{
+  public:
+    explicit ObjWriter( unsigned int seed ) : m_random( seed ) {}
+
+    const std::string& text() const { return m_text; }
+
+    void line( const std::string& text )
+    {
+        m_text += text;
+        m_text += chance( 10 ) ? "\r\n" : "\n";
+    }
+
+    // Comment line of the given length, at least 2, inserted at a line start
+    void insertComment( size_t position, size_t length )
+    {
+        m_text.insert( position, "#" + std::string( length - 2, '-' ) + "\n" );
+    }
+
+    bool chance( unsigned int percent ) { return m_random() % 100 < percent; }
+    unsigned int below( unsigned int n ) { return m_random() % n; }
+
+    // The same coordinates in the number formats an exporter may write
+    std::string number( float value )
+    {
+        char buffer[64];
+        switch( below( 5 ) )
+        {
+            case 0: std::snprintf( buffer, sizeof( buffer ), "%.6f", value ); break;
+            case 1: std::snprintf( buffer, sizeof( buffer ), "%g", value ); break;
+            case 2: std::snprintf( buffer, sizeof( buffer ), "%e", value ); break;
+            case 3: std::snprintf( buffer, sizeof( buffer ), "%+.3f", value ); break;
+            default: std::snprintf( buffer, sizeof( buffer ), "%d", static_cast<int>( value ) ); break;
+        }
+        return buffer;
+    }
+
+    float coordinate() { return static_cast<float>( static_cast<int>( below( 20001 ) ) - 10000 ) / 97.0f; }
+
+    void vertex( float x, float y, float z )
+    {
+        line( "v " + number( x ) + " " + number( y ) + " " + number( z ) );
+        ++m_vertices;
+    }
+
+    void texcoord()
+    {
+        line( "vt " + number( below( 1001 ) / 1000.0f ) + " " + number( below( 1001 ) / 1000.0f ) );
+        ++m_texcoords;
+    }
+
+    // Face of random corners that refer to earlier vertices, relative or absolute
+    void face( unsigned int corners )
+    {
+        std::string text = "f";
+        for( unsigned int k = 0; k < corners; ++k )
+            text += " " + corner( 1 + below( std::min( m_vertices, 64u ) ) );
+        line( text );
+    }
+
+    // Concave polygon of fresh coplanar vertices, an L or an arrow in one of the axis planes
+    void concave()
+    {
+        static const float L_SHAPE[6][2] = { { 0, 0 }, { 2, 0 }, { 2, 1 }, { 1, 1 }, { 1, 2 }, { 0, 2 } };
+        static const float ARROW[5][2]   = { { 0, 0 }, { 2, 1 }, { 0, 2 }, { 0.5f, 1 }, { 0, 0.5f } };
+        const bool         arrow  = chance( 50 );
+        const unsigned int count  = arrow ? 5 : 6;
+        const unsigned int plane  = below( 3 );
+        const float        x0 = coordinate(), y0 = coordinate(), z0 = coordinate();
+        for( unsigned int k = 0; k < count; ++k )
+        {
+            const float a = arrow ? ARROW[k][0] : L_SHAPE[k][0];
+            const float b = arrow ? ARROW[k][1] : L_SHAPE[k][1];
+            if( plane == 0 )
+                vertex( x0 + a, y0 + b, z0 );
+            else if( plane == 1 )
+                vertex( x0 + a, y0, z0 + b );
+            else
+                vertex( x0, y0 + a, z0 + b );
+        }
+        std::string text = "f";
+        for( unsigned int k = count; k > 0; --k )
+            text += " " + corner( k );
+        line( text );
+    }
+
+    // A usemtl line, sometimes naming a material the library does not have
+    void material()
+    {
+        line( chance( 10 ) ? "usemtl missing" : "usemtl m" + std::to_string( below( 6 ) ) );
+    }
+
+    void group()
+    {
+        line( std::string( chance( 70 ) ? "g" : "o" ) + " part" + std::to_string( m_groups++ ) );
+    }
+
+    // Mostly geometry, with a usemtl or g/o line every few lines
+    void randomLine()
+    {
+        const unsigned int kind = below( 100 );
+        if( kind < 35 || m_vertices < 8 )
+            vertex( coordinate(), coordinate(), coordinate() );
+        else if( kind < 45 )
+            texcoord();
+        else if( kind < 70 )
+            face( 3 + below( 2 ) );
+        else if( kind < 76 )
+            concave();
+        else if( kind < 85 )
+            material();
+        else if( kind < 94 )
+            group();
+        else if( kind < 97 )
+            line( "# comment" );
+        else
+            line( "" );
+    }
+
+  private:
+    // Corner of the vertex the given distance back, relative or absolute, with a texture coordinate or not
+    std::string corner( unsigned int back )
+    {
+        std::string text = chance( 50 ) ? "-" + std::to_string( back ) : std::to_string( m_vertices - back + 1 );
+        if( m_texcoords > 0 && chance( 60 ) )
+        {
+            const unsigned int t = 1 + below( std::min( m_texcoords, 16u ) );
+            text += "/" + ( chance( 50 ) ? "-" + std::to_string( t ) : std::to_string( m_texcoords - t + 1 ) );
+        }
+        return text;
+    }
+
+    std::mt19937 m_random;
+    std::string  m_text;
+    unsigned int m_vertices  = 0;
+    unsigned int m_texcoords = 0;
+    unsigned int m_groups    = 0;
+};
+
+
+void writeText( const std::string& path, const std::string& text )
+{
+    std::ofstream out( path.c_str(), std::ios::binary | std::ios::trunc );
+    out << text;
+}
+
+// Materials with and without texture maps. m3 has a map_Kd but no Kd; after the Kd of the earlier
+// materials it stays 0, as in tinyobj, while in the second library it defaults to 0.6.
+void writeMtl()
+{
+    writeText( MTL_FILE,
+               "# objLoaderTest materials\n"
+               "newmtl m0\nKd 0.8 0.1 0.1\nKs 0.5 0.5 0.5\nNs 20\n\n"
+               "newmtl m1\r\nKd 0.1 0.8 0.1\r\nmap_Kd green.png\r\n\r\n"
+               "newmtl m2\nKd 1 1 1\nKe 4 4 3.5\n\n"
+               "newmtl m3\nmap_Kd textures/wood.png\nmap_Ks textures/wood_spec.png\nKs 0.04 0.04 0.04\n\n"
+               "newmtl m4\r\nKd .25 .5 .75\r\nNi 1.5\r\n" );
+    writeText( MTL_FILE_2, "newmtl m5\nmap_Kd stone.png\n" );
+}
+
+// The line of the boundary cluster in writeObj() that each chunk boundary falls on: the first usemtl,
+// the g/o line, the second usemtl, either face, or the third vertex of the concave polygon. The next
+// chunk starts with the line after it, so its faces continue the group and material of the previous
+// chunk and refer back to its vertices and texture coordinates.
+const size_t BOUNDARY_LINE[NUM_CHUNKS - 1] = { 0, 1, 2, 3, 4, 7, 3 };
+
+// OBJ of exactly OBJ_SIZE bytes, with a cluster of material and group changes and faces at every
+// chunk boundary
+void writeObj()
+{
+    ObjWriter obj( 2021 );
+    obj.line( "mtllib " + MTL_FILE );
+    obj.line( "mtllib " + MTL_FILE_2 );
+    for( size_t c = 1; c < NUM_CHUNKS; ++c )
+    {
+        const size_t boundary = OBJ_SIZE * c / NUM_CHUNKS;
+        while( obj.text().size() + 1024 < boundary )
+            obj.randomLine();
+
+        const size_t cluster = obj.text().size();
+        obj.material();
+        obj.group();
+        obj.material();
+        obj.face( 3 );
+        obj.face( 4 );
+        obj.concave();
+
+        // Pad in front of the cluster so that the boundary is the second character of the chosen line
+        size_t line = cluster;
+        for( size_t i = 0; i < BOUNDARY_LINE[c - 1]; ++i )
+            line = obj.text().find( '\n', line ) + 1;
+        obj.insertComment( cluster, boundary - 1 - line );
+    }
+    while( obj.text().size() + 1024 < OBJ_SIZE )
+        obj.randomLine();
+    obj.insertComment( obj.text().size(), OBJ_SIZE - obj.text().size() );
+    writeText( OBJ_FILE, obj.text() );
+}
+
+
+void testAgainstTinyObj()
+{
+    writeMtl();
+    writeObj();
+
+    tinyobj::attrib_t                attrib;
+    std::vector<tinyobj::shape_t>    shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string                      warn, err;
+    HOST_CHECK( tinyobj::LoadObj( &attrib, &shapes, &materials, &warn, &err, OBJ_FILE.c_str(), "" ) );
+
+    // The file exercises what it is meant to
+    HOST_CHECK( materials.size() == 6 && shapes.size() > 100 );
+    HOST_CHECK( materials.size() == 6 && materials[3].diffuse[0] == 0.0f && materials[5].diffuse[0] == 0.6f );  // see writeMtl()
+    bool no_material = false, material = false, no_texcoord = false, texcoord = false;
+    for( const tinyobj::shape_t& shape : shapes )
+    {
+        for( int id : shape.mesh.material_ids )
+            ( id < 0 ? no_material : material ) = true;
+        for( const tinyobj::index_t& index : shape.mesh.indices )
+            ( index.texcoord_index < 0 ? no_texcoord : texcoord ) = true;
+    }
+    HOST_CHECK( no_material && material && no_texcoord && texcoord );
+
+    for( unsigned int num_threads : { 1u, 2u, 7u } )
+    {
+        ObjMesh     mesh;
+        std::string mesh_warn, mesh_err;
+        HOST_CHECK( loadObj( OBJ_FILE, mesh, mesh_warn, mesh_err, num_threads ) );
+        HOST_CHECK( mesh_err.empty() );
+        const std::string difference = compareWithTinyObj( attrib, shapes, materials, mesh );
+        if( !difference.empty() )
+            std::cerr << num_threads << " threads: " << difference << std::endl;
+        HOST_CHECK( difference.empty() );
+    }
+
+    std::remove( OBJ_FILE.c_str() );
+    std::remove( MTL_FILE.c_str() );
+    std::remove( MTL_FILE_2.c_str() );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testAgainstTinyObj();
+    return hostTestResult( "objLoaderTest" );
+}
@@ -0,0 +1,238 @@
+//
+// ptxCacheTest - host tests of the on-disk PTX cache in sutil/PtxCache.h: the key changes with the
+// source, the options and the contents of nested includes so a stale entry is never loaded, eviction
+// removes the least recently used entries until the directory fits its limit, and the entry store()
+// just wrote survives its own eviction.
+//
+
+#include <sutil/PtxCache.h>
+
+#include "HostTest.h"
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+#if defined( _WIN32 )
+#    include <sys/utime.h>
+#else
+#    include <utime.h>
+#endif
+
+
+namespace {
+
+const std::string CACHE_DIR = "ptxCacheTest.cache";
+
+void writeText( const std::string& path, const std::string& text )
+{
+    std::ofstream out( path.c_str(), std::ios::binary | std::ios::trunc );
+    out << text;
+}
+
+void setLastUsed( const std::string& path, time_t seconds )
+{
+    utimbuf times;
+    times.actime  = seconds;
+    times.modtime = seconds;
+    utime( path.c_str(), &times );
+}
+
+void clearCache()
+{
+    for( const sutil::PtxCache::Entry& entry : sutil::PtxCache( CACHE_DIR, 0 ).entries() )
+        std::remove( entry.path.c_str() );
+}
+
+sutil::PtxCacheKey keyOf( const std::string& name )
+{
+    sutil::PtxCacheKey key;
+    key.add( name );
+    return key;
+}
+
+bool present( const sutil::PtxCache& cache, const std::string& name )
+{
+    std::ifstream file( cache.entryPath( keyOf( name ) ).c_str() );
+    return file.good();
+}
+
+
+void testKeyInputs()
+{
+    // main.cu includes a header next to it and one from the include path, which includes a third
+    const std::string source = "#include \"ptxCacheTestA.h\"\n#include <ptxCacheTestB.h>\n__global__ void f() {}\n";
+    writeText( "ptxCacheTestA.h", "#define A 1\n" );
+    writeText( "ptxCacheTestB.h", "#include \"ptxCacheTestC.h\"\n" );
+    writeText( "ptxCacheTestC.h", "#define C 1\n" );
+    const std::vector<std::string> include_dirs = { "." };
+    const std::vector<std::string> options      = { "-arch=compute_60", "-use_fast_math" };
+
+    const auto key = [&]() { return sutil::compilationKey( source, "./ptxCacheTestMain.cu", include_dirs, options ).value(); };
+    const uint64_t original = key();
+    HOST_CHECK( key() == original );
+
+    std::vector<std::string> headers;
+    sutil::collectIncludes( source, "./ptxCacheTestMain.cu", include_dirs, headers );
+    HOST_CHECK( headers.size() == 3 );
+
+    // Source, options and their order
+    HOST_CHECK( sutil::compilationKey( source + " ", "./ptxCacheTestMain.cu", include_dirs, options ).value() != original );
+    HOST_CHECK( sutil::compilationKey( source, "./ptxCacheTestMain.cu", include_dirs, { "-arch=compute_60" } ).value() != original );
+    HOST_CHECK( sutil::compilationKey( source, "./ptxCacheTestMain.cu", include_dirs, { "-use_fast_math", "-arch=compute_60" } ).value()
+                != original );
+    HOST_CHECK( sutil::compilationKey( source, "./ptxCacheTestMain.cu", include_dirs, { "-arch=compute_60-use_fast_math" } ).value()
+                != original );
+
+    // Contents of a direct and of a nested include
+    writeText( "ptxCacheTestA.h", "#define A 2\n" );
+    const uint64_t edited_a = key();
+    HOST_CHECK( edited_a != original );
+    writeText( "ptxCacheTestA.h", "#define A 1\n" );
+    HOST_CHECK( key() == original );
+    writeText( "ptxCacheTestC.h", "#define C 2\n" );
+    HOST_CHECK( key() != original && key() != edited_a );
+
+    // An entry stored under the old key is not loaded for the edited header
+    clearCache();
+    const sutil::PtxCache cache( CACHE_DIR, 1 << 20 );
+    writeText( "ptxCacheTestC.h", "#define C 1\n" );
+    const sutil::PtxCacheKey stored = sutil::compilationKey( source, "./ptxCacheTestMain.cu", include_dirs, options );
+    HOST_CHECK( cache.store( stored, "// ptx of C 1\n" ) );
+    std::string ptx;
+    HOST_CHECK( cache.load( stored, ptx ) && ptx == "// ptx of C 1\n" );
+    writeText( "ptxCacheTestC.h", "#define C 2\n" );
+    HOST_CHECK( !cache.load( sutil::compilationKey( source, "./ptxCacheTestMain.cu", include_dirs, options ), ptx ) );
+
+    // Strings are length prefixed
+    sutil::PtxCacheKey ab_c, a_bc;
+    ab_c.add( std::string( "ab" ) );
+    ab_c.add( std::string( "c" ) );
+    a_bc.add( std::string( "a" ) );
+    a_bc.add( std::string( "bc" ) );
+    HOST_CHECK( ab_c.value() != a_bc.value() );
+    HOST_CHECK( ab_c.hex().size() == 16 );
+
+    clearCache();
+    std::remove( "ptxCacheTestA.h" );
+    std::remove( "ptxCacheTestB.h" );
+    std::remove( "ptxCacheTestC.h" );
+}
+
+
+void testDamagedEntries()
+{
+    clearCache();
+    const sutil::PtxCache cache( CACHE_DIR, 1 << 20 );
+    HOST_CHECK( cache.store( keyOf( "a" ), std::string( 500, 'a' ) ) );
+
+    // Truncated, or stored under another key
+    std::string contents;
+    {
+        std::ifstream in( cache.entryPath( keyOf( "a" ) ).c_str(), std::ios::binary );
+        contents.assign( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+    }
+    std::string ptx;
+    writeText( cache.entryPath( keyOf( "a" ) ), contents.substr( 0, contents.size() - 1 ) );
+    HOST_CHECK( !cache.load( keyOf( "a" ), ptx ) );
+    writeText( cache.entryPath( keyOf( "b" ) ), contents );
+    HOST_CHECK( !cache.load( keyOf( "b" ), ptx ) );
+
+    // Files not named like entries are neither listed nor evicted
+    writeText( CACHE_DIR + "/notes.ptx", std::string( 5000, 'x' ) );
+    HOST_CHECK( cache.entries().size() == 2 );
+    HOST_CHECK( sutil::PtxCache( CACHE_DIR, 0 ).evict() == 2 );
+    std::ifstream notes( ( CACHE_DIR + "/notes.ptx" ).c_str() );
+    HOST_CHECK( notes.good() );
+    notes.close();
+    std::remove( ( CACHE_DIR + "/notes.ptx" ).c_str() );
+
+    // A disabled cache does nothing
+    const sutil::PtxCache disabled;
+    HOST_CHECK( !disabled.enabled() && !disabled.store( keyOf( "a" ), "x" ) && !disabled.load( keyOf( "a" ), ptx ) );
+}
+
+
+void testEvictionOrder()
+{
+    clearCache();
+    const sutil::PtxCache unlimited( CACHE_DIR, 1 << 20 );
+    const char*           names[5] = { "e0", "e1", "e2", "e3", "e4" };
+    const time_t          now      = time( nullptr );
+    for( int i = 0; i < 5; ++i )
+    {
+        HOST_CHECK( unlimited.store( keyOf( names[i] ), std::string( 1000, 'p' ) ) );
+        setLastUsed( unlimited.entryPath( keyOf( names[i] ) ), now - 1000 + 100 * i );
+    }
+
+    // Listed least recently used first
+    const std::vector<sutil::PtxCache::Entry> entries = unlimited.entries();
+    HOST_CHECK( entries.size() == 5 );
+    for( int i = 0; i < 5 && i < static_cast<int>( entries.size() ); ++i )
+        HOST_CHECK( entries[i].path == unlimited.entryPath( keyOf( names[i] ) ) );
+    const uint64_t entry_bytes = entries[0].bytes;
+
+    // A load makes e0 the most recently used
+    std::string ptx;
+    HOST_CHECK( unlimited.load( keyOf( "e0" ), ptx ) && ptx.size() == 1000 );
+
+    // Room for three and a half entries: e1 and e2 go, in that order
+    const sutil::PtxCache limited( CACHE_DIR, entry_bytes * 7 / 2 );
+    HOST_CHECK( limited.evict() == 2 );
+    HOST_CHECK( present( limited, "e0" ) && !present( limited, "e1" ) && !present( limited, "e2" ) );
+    HOST_CHECK( present( limited, "e3" ) && present( limited, "e4" ) );
+    uint64_t total = 0;
+    for( const sutil::PtxCache::Entry& entry : limited.entries() )
+        total += entry.bytes;
+    HOST_CHECK( total <= limited.maxBytes() );
+    HOST_CHECK( limited.evict() == 0 );
+
+    // A store over the limit evicts e3, the least recently used now, and keeps the total in bounds
+    HOST_CHECK( limited.store( keyOf( "e5" ), std::string( 1000, 'p' ) ) );
+    HOST_CHECK( !present( limited, "e3" ) && present( limited, "e0" ) && present( limited, "e4" ) && present( limited, "e5" ) );
+    clearCache();
+}
+
+
+void testStoredEntrySurvives()
+{
+    // The other entries were used after the new one by the clock, still the new one stays
+    clearCache();
+    const sutil::PtxCache unlimited( CACHE_DIR, 1 << 20 );
+    const time_t          later = time( nullptr ) + 1000;
+    for( const char* name : { "f0", "f1" } )
+    {
+        HOST_CHECK( unlimited.store( keyOf( name ), std::string( 1000, 'p' ) ) );
+        setLastUsed( unlimited.entryPath( keyOf( name ) ), later );
+    }
+    const uint64_t        entry_bytes = unlimited.entries()[0].bytes;
+    const sutil::PtxCache limited( CACHE_DIR, entry_bytes * 2 );
+    HOST_CHECK( limited.store( keyOf( "new" ), std::string( 1000, 'p' ) ) );
+    HOST_CHECK( present( limited, "new" ) );
+    HOST_CHECK( present( limited, "f0" ) != present( limited, "f1" ) );
+
+    // An entry larger than the whole limit stays alone
+    const sutil::PtxCache tiny( CACHE_DIR, 10 );
+    HOST_CHECK( tiny.store( keyOf( "big" ), std::string( 5000, 'p' ) ) );
+    const std::vector<sutil::PtxCache::Entry> entries = tiny.entries();
+    HOST_CHECK( entries.size() == 1 && entries[0].path == tiny.entryPath( keyOf( "big" ) ) );
+    std::string ptx;
+    HOST_CHECK( tiny.load( keyOf( "big" ), ptx ) && ptx.size() == 5000 );
+
+    // Without a kept entry evict() removes it
+    HOST_CHECK( tiny.evict() == 1 && tiny.entries().empty() );
+    std::remove( CACHE_DIR.c_str() );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testKeyInputs();
+    testDamagedEntries();
+    testEvictionOrder();
+    testStoredEntrySurvives();
+    return hostTestResult( "ptxCacheTest" );
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <sutil/vec_math.h>
+
+/*
+*   Temporal reprojection helpers shared by the raygen program and host code.
+*
+*   The accumulation buffer stores the running mean in rgb and the history length (number of
+*   accumulated launches) in w. When the camera moves, the first hit of a pixel is projected into
+*   the previous camera and the previous accumulation is fetched with a bilinear filter. Taps whose
+*   stored depth or normal do not match the current surface (disocclusions, silhouettes) are rejected.
+*   The history that survives is clamped to the colors the current launch sees around the pixel before
+*   it is blended in, so a highlight or shadow that moved does not leave a trail behind.
+*/
+
+struct ReprojectionSettings
+{
+    float        depth_tolerance;     // maximum relative difference between expected and stored hit distance
+    float        normal_threshold;    // minimum cosine between current and stored normal
+    float        max_history;         // history length clamp for reprojected pixels
+    unsigned int clamp_history;       // clamp reprojected colors to the current 3x3 neighborhood
+};
+
+
+/*
+    Blend one launch into an accumulation. accum holds the running mean in rgb and the history length
+    in w, the result holds the new mean and history length + 1.
+*/
+SUTIL_INLINE SUTIL_HOSTDEVICE float4 accumulateLaunch( const float4& accum, const float3& launch_color )
+{
+    if( accum.w <= 0.0f )
+        return make_float4( launch_color, 1.0f );
+    return make_float4( lerp( make_float3( accum ), launch_color, 1.0f / ( accum.w + 1.0f ) ), accum.w + 1.0f );
+}
+
+
+/*
+    Project world space point P into the pinhole camera (eye, U, V, W) as built by sutil::Camera::UVWFrame.
+    Returns false if P is behind the camera. pixel is in continuous pixel coordinates, pixel centers at +0.5.
+*/
+SUTIL_INLINE SUTIL_HOSTDEVICE bool projectToPixel(
+        const float3& P,
+        const float3& eye,
+        const float3& U,
+        const float3& V,
+        const float3& W,
+        unsigned int  width,
+        unsigned int  height,
+        float2&       pixel )
+{
+    // U, V and W are mutually orthogonal, so the ray parameters come from plain projections
+    const float3 v = P - eye;
+    const float  t = dot( v, W ) / dot( W, W );
+    if( t <= 0.0f )
+        return false;
+
+    const float dx = dot( v, U ) / ( dot( U, U ) * t );
+    const float dy = dot( v, V ) / ( dot( V, V ) * t );
+    pixel = make_float2(
+            ( dx + 1.0f ) * 0.5f * static_cast<float>( width ),
+            ( dy + 1.0f ) * 0.5f * static_cast<float>( height ) );
+    return true;
+}
+
+
+/*
+    History rejection test for one tap of the previous frame.
+    expected_distance is the distance from the previous eye to the current hit point, prev_distance
+    the first-hit distance stored for the tap. Normals do not need to be normalized.
+*/
+SUTIL_INLINE SUTIL_HOSTDEVICE bool historyMatches(
+        float                       expected_distance,
+        float                       prev_distance,
+        const float3&               normal,
+        const float3&               prev_normal,
+        const ReprojectionSettings& settings )
+{
+    if( prev_distance <= 0.0f || expected_distance <= 0.0f )
+        return false;
+    if( fabsf( prev_distance - expected_distance ) > settings.depth_tolerance * expected_distance )
+        return false;
+
+    const float len2 = dot( normal, normal ) * dot( prev_normal, prev_normal );
+    if( len2 <= 0.0f )
+        return false;
+    return dot( normal, prev_normal ) >= settings.normal_threshold * sqrtf( len2 );
+}
+
+
+/*
+    Fetch the previous accumulation for the surface point P with normal N.
+    Returns the reprojected color in rgb and its (clamped) history length in w. A history length of 0
+    means every tap was rejected and the pixel restarts accumulation.
+*/
+SUTIL_INLINE SUTIL_HOSTDEVICE float4 reprojectHistory(
+        const float3&               P,
+        const float3&               N,
+        const float4*               prev_accum,
+        const float4*               prev_normal,
+        const float*                prev_depth,
+        unsigned int                width,
+        unsigned int                height,
+        const float3&               prev_eye,
+        const float3&               prev_U,
+        const float3&               prev_V,
+        const float3&               prev_W,
+        const ReprojectionSettings& settings )
+{
+    float2 pixel;
+    if( !projectToPixel( P, prev_eye, prev_U, prev_V, prev_W, width, height, pixel ) )
+        return make_float4( 0.0f );
+
+    // Bilinear footprint around the projected position
+    const float  fx = pixel.x - 0.5f;
+    const float  fy = pixel.y - 0.5f;
+    const int    x0 = static_cast<int>( floorf( fx ) );
+    const int    y0 = static_cast<int>( floorf( fy ) );
+    const float  tx = fx - static_cast<float>( x0 );
+    const float  ty = fy - static_cast<float>( y0 );
+    const float  expected_distance = length( P - prev_eye );
+
+    float3 color   = make_float3( 0.0f );
+    float  history = 0.0f;
+    float  weight  = 0.0f;
+    for( int j = 0; j < 4; ++j )
+    {
+        const int x = x0 + ( j & 1 );
+        const int y = y0 + ( j >> 1 );
+        if( x < 0 || y < 0 || x >= static_cast<int>( width ) || y >= static_cast<int>( height ) )
+            continue;
+
+        const unsigned int i = static_cast<unsigned int>( y ) * width + static_cast<unsigned int>( x );
+        if( !historyMatches( expected_distance, prev_depth[i], N, make_float3( prev_normal[i] ), settings ) )
+            continue;
+
+        const float w = ( ( j & 1 ) ? tx : 1.0f - tx ) * ( ( j >> 1 ) ? ty : 1.0f - ty );
+        color   += w * make_float3( prev_accum[i] );
+        history += w * prev_accum[i].w;
+        weight  += w;
+    }
+
+    if( weight <= 1e-4f )
+        return make_float4( 0.0f );
+
+    return make_float4( color / weight, fminf( history / weight, settings.max_history ) );
+}
+
+
+/*
+    Neighborhood clamp of a reprojected history color. launch_colors holds the colors of the current
+    launch only (not accumulated), the history is clamped per channel to their minimum and maximum
+    over the 3x3 pixels around (x, y) that lie inside the image.
+*/
+SUTIL_INLINE SUTIL_HOSTDEVICE float3 clampToNeighborhood(
+        const float3& history,
+        const float4* launch_colors,
+        unsigned int  x,
+        unsigned int  y,
+        unsigned int  width,
+        unsigned int  height )
+{
+    float3 lo = make_float3( launch_colors[ y * width + x ] );
+    float3 hi = lo;
+    for( unsigned int ny = y > 0 ? y - 1 : 0; ny <= y + 1 && ny < height; ++ny )
+    {
+        for( unsigned int nx = x > 0 ? x - 1 : 0; nx <= x + 1 && nx < width; ++nx )
+        {
+            const float3 c = make_float3( launch_colors[ ny * width + nx ] );
+            lo = fminf( lo, c );
+            hi = fmaxf( hi, c );
+        }
+    }
+    return clamp( history, lo, hi );
+}
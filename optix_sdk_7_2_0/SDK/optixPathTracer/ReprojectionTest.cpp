@@ -0,0 +1,273 @@
+//
+// reprojectionTest - host tests of the temporal reprojection helpers in Reprojection.h: reprojection
+// of a known camera move over a plane, depth and normal rejection, history length growth and the
+// neighborhood clamp.
+//
+
+#include "HostTest.h"
+#include "Reprojection.h"
+
+#include <vector>
+
+
+namespace {
+
+const unsigned int WIDTH  = 64;
+const unsigned int HEIGHT = 48;
+const float        PLANE_Z = -10.0f;
+
+struct Frame
+{
+    float3 eye, U, V, W;
+};
+
+// Same frame as sutil::Camera::UVWFrame, looking down -z with a 60 degree vertical field of view.
+Frame makeFrame( const float3& eye )
+{
+    const float3 lookat = eye + make_float3( 0.0f, 0.0f, -1.0f );
+    const float3 up     = make_float3( 0.0f, 1.0f, 0.0f );
+    Frame        frame;
+    frame.eye = eye;
+    frame.W   = lookat - eye;
+    frame.U   = normalize( cross( frame.W, up ) );
+    frame.V   = normalize( cross( frame.U, frame.W ) );
+    const float vlen = length( frame.W ) * tanf( 0.5f * 60.0f * M_PIf / 180.0f );
+    frame.V *= vlen;
+    frame.U *= vlen * static_cast<float>( WIDTH ) / static_cast<float>( HEIGHT );
+    return frame;
+}
+
+// Hit point of the ray through the center of pixel (x, y) with the plane z = PLANE_Z.
+float3 hitPlane( const Frame& frame, unsigned int x, unsigned int y )
+{
+    const float2 d = 2.0f * make_float2(
+            ( static_cast<float>( x ) + 0.5f ) / static_cast<float>( WIDTH ),
+            ( static_cast<float>( y ) + 0.5f ) / static_cast<float>( HEIGHT ) ) - 1.0f;
+    const float3 direction = normalize( d.x * frame.U + d.y * frame.V + frame.W );
+    return frame.eye + direction * ( ( PLANE_Z - frame.eye.z ) / direction.z );
+}
+
+// Previous launch over the plane. The accumulated color of a pixel is its index, so a bilinear fetch
+// returns the continuous pixel position minus 0.5, and every pixel has the given history length.
+struct PreviousLaunch
+{
+    std::vector<float4> accum;
+    std::vector<float4> normal;
+    std::vector<float>  depth;
+    Frame               frame;
+
+    PreviousLaunch( const Frame& f, float history )
+        : accum( WIDTH * HEIGHT )
+        , normal( WIDTH * HEIGHT, make_float4( 0.0f, 0.0f, 1.0f, 0.0f ) )
+        , depth( WIDTH * HEIGHT )
+        , frame( f )
+    {
+        for( unsigned int y = 0; y < HEIGHT; ++y )
+            for( unsigned int x = 0; x < WIDTH; ++x )
+            {
+                accum[y * WIDTH + x] = make_float4( static_cast<float>( x ), static_cast<float>( y ), 0.0f, history );
+                depth[y * WIDTH + x] = length( hitPlane( frame, x, y ) - frame.eye );
+            }
+    }
+
+    float4 reproject( const float3& P, const float3& N, const ReprojectionSettings& settings ) const
+    {
+        return reprojectHistory( P, N, accum.data(), normal.data(), depth.data(), WIDTH, HEIGHT, frame.eye, frame.U,
+                                 frame.V, frame.W, settings );
+    }
+};
+
+ReprojectionSettings defaultSettings()
+{
+    ReprojectionSettings settings;
+    settings.depth_tolerance  = 0.05f;
+    settings.normal_threshold = 0.9f;
+    settings.max_history      = 64.0f;
+    settings.clamp_history    = 1u;
+    return settings;
+}
+
+const float3 PLANE_NORMAL = make_float3( 0.0f, 0.0f, 1.0f );
+
+
+void testProjectToPixel()
+{
+    const Frame frame = makeFrame( make_float3( 0.0f ) );
+    for( unsigned int y = 0; y < HEIGHT; y += 7 )
+        for( unsigned int x = 0; x < WIDTH; x += 5 )
+        {
+            float2 pixel = make_float2( 0.0f );
+            HOST_CHECK( projectToPixel( hitPlane( frame, x, y ), frame.eye, frame.U, frame.V, frame.W, WIDTH, HEIGHT, pixel ) );
+            HOST_CHECK_NEAR( pixel.x, x + 0.5f, 1e-3 );
+            HOST_CHECK_NEAR( pixel.y, y + 0.5f, 1e-3 );
+        }
+
+    float2 pixel = make_float2( 0.0f );
+    HOST_CHECK( !projectToPixel( make_float3( 0.0f, 0.0f, 1.0f ), frame.eye, frame.U, frame.V, frame.W, WIDTH, HEIGHT, pixel ) );
+}
+
+
+void testSidewaysMove()
+{
+    // Moving the camera 2.5 pixels (measured on the plane) to the right shifts the image 2.5 pixels left
+    const Frame          previous_frame = makeFrame( make_float3( 0.0f ) );
+    const PreviousLaunch previous( previous_frame, 5.0f );
+    const float pixel_width = 2.0f * length( previous_frame.U ) * -PLANE_Z / static_cast<float>( WIDTH );
+    const Frame current     = makeFrame( make_float3( 2.5f * pixel_width, 0.0f, 0.0f ) );
+
+    for( unsigned int y = 1; y < HEIGHT - 1; y += 3 )
+        for( unsigned int x = 0; x < WIDTH - 4; x += 3 )
+        {
+            const float4 history = previous.reproject( hitPlane( current, x, y ), PLANE_NORMAL, defaultSettings() );
+            HOST_CHECK_NEAR( history.x, x + 2.5f, 1e-3 );
+            HOST_CHECK_NEAR( history.y, static_cast<float>( y ), 1e-3 );
+            HOST_CHECK_NEAR( history.w, 5.0f, 1e-5 );
+        }
+
+    // Pixels whose taps all left the previous image restart
+    const float4 outside = previous.reproject( hitPlane( current, WIDTH - 1, HEIGHT / 2 ), PLANE_NORMAL, defaultSettings() );
+    HOST_CHECK_NEAR( outside.w, 0.0f, 0.0 );
+}
+
+
+void testForwardMove()
+{
+    // Moving 1 unit towards the plane scales the image by 10/9 around its center
+    const PreviousLaunch previous( makeFrame( make_float3( 0.0f ) ), 3.0f );
+    const Frame          current = makeFrame( make_float3( 0.0f, 0.0f, -1.0f ) );
+    const float2         center  = make_float2( WIDTH * 0.5f, HEIGHT * 0.5f );
+
+    for( unsigned int y = 0; y < HEIGHT; y += 5 )
+        for( unsigned int x = 0; x < WIDTH; x += 5 )
+        {
+            const float2 expected = center + ( make_float2( x + 0.5f, y + 0.5f ) - center ) * 0.9f - 0.5f;
+            const float4 history  = previous.reproject( hitPlane( current, x, y ), PLANE_NORMAL, defaultSettings() );
+            HOST_CHECK_NEAR( history.x, expected.x, 1e-3 );
+            HOST_CHECK_NEAR( history.y, expected.y, 1e-3 );
+            HOST_CHECK_NEAR( history.w, 3.0f, 1e-5 );
+        }
+}
+
+
+void testRejection()
+{
+    const Frame    previous_frame = makeFrame( make_float3( 0.0f ) );
+    const float    pixel_width    = 2.0f * length( previous_frame.U ) * -PLANE_Z / static_cast<float>( WIDTH );
+    const Frame    current        = makeFrame( make_float3( 2.5f * pixel_width, 0.0f, 0.0f ) );
+    const unsigned x = 20, y = 20;
+    const float3   P = hitPlane( current, x, y );  // taps at (22,19..20) and (23,19..20) of the previous launch
+
+    // Depth: 20% further away is a disocclusion, 3% is within the tolerance
+    {
+        PreviousLaunch previous( previous_frame, 5.0f );
+        for( float& depth : previous.depth )
+            depth *= 1.2f;
+        HOST_CHECK_NEAR( previous.reproject( P, PLANE_NORMAL, defaultSettings() ).w, 0.0f, 0.0 );
+
+        PreviousLaunch close( previous_frame, 5.0f );
+        for( float& depth : close.depth )
+            depth *= 1.03f;
+        HOST_CHECK_NEAR( close.reproject( P, PLANE_NORMAL, defaultSettings() ).w, 5.0f, 1e-5 );
+    }
+
+    // Normal: a surface facing another way is rejected, unnormalized normals are fine
+    {
+        PreviousLaunch previous( previous_frame, 5.0f );
+        for( float4& normal : previous.normal )
+            normal = make_float4( 1.0f, 0.0f, 0.2f, 0.0f );
+        HOST_CHECK_NEAR( previous.reproject( P, PLANE_NORMAL, defaultSettings() ).w, 0.0f, 0.0 );
+        HOST_CHECK_NEAR( previous.reproject( P, make_float3( 0.0f, 0.0f, 3.0f ), defaultSettings() ).w, 0.0f, 0.0 );
+
+        PreviousLaunch scaled( previous_frame, 5.0f );
+        for( float4& normal : scaled.normal )
+            normal = make_float4( 0.0f, 0.0f, 0.25f, 0.0f );
+        HOST_CHECK_NEAR( scaled.reproject( P, make_float3( 0.0f, 0.0f, 4.0f ), defaultSettings() ).w, 5.0f, 1e-5 );
+    }
+
+    // A rejected tap drops out of the bilinear filter, the others are renormalized
+    {
+        PreviousLaunch previous( previous_frame, 5.0f );
+        previous.depth[19 * WIDTH + 23] = 0.0f;  // miss
+        previous.depth[20 * WIDTH + 23] *= 2.0f;  // occluder
+        const float4 history = previous.reproject( P, PLANE_NORMAL, defaultSettings() );
+        HOST_CHECK_NEAR( history.x, 22.0f, 1e-3 );
+        HOST_CHECK_NEAR( history.w, 5.0f, 1e-5 );
+    }
+
+    // Surface behind the previous camera
+    {
+        const PreviousLaunch previous( previous_frame, 5.0f );
+        HOST_CHECK_NEAR( previous.reproject( make_float3( 0.0f, 0.0f, 5.0f ), PLANE_NORMAL, defaultSettings() ).w, 0.0f, 0.0 );
+    }
+}
+
+
+void testHistoryGrowth()
+{
+    // Static camera: the running mean of the launches, one more history per launch
+    float4 accum = make_float4( 0.0f );
+    for( int i = 1; i <= 4; ++i )
+    {
+        accum = accumulateLaunch( accum, make_float3( static_cast<float>( i ) ) );
+        HOST_CHECK_NEAR( accum.w, static_cast<float>( i ), 0.0 );
+    }
+    HOST_CHECK_NEAR( accum.x, 2.5f, 1e-6 );
+
+    // Reprojection keeps the history length up to max_history, the resolve pass adds the new launch
+    const PreviousLaunch previous( makeFrame( make_float3( 0.0f ) ), 100.0f );
+    const Frame          current = makeFrame( make_float3( 0.01f, 0.0f, 0.0f ) );
+    const float4         history = previous.reproject( hitPlane( current, 30, 30 ), PLANE_NORMAL, defaultSettings() );
+    HOST_CHECK_NEAR( history.w, 64.0f, 0.0 );
+    HOST_CHECK_NEAR( accumulateLaunch( history, make_float3( 0.0f ) ).w, 65.0f, 0.0 );
+
+    PreviousLaunch young( makeFrame( make_float3( 0.0f ) ), 7.0f );
+    HOST_CHECK_NEAR( young.reproject( hitPlane( current, 30, 30 ), PLANE_NORMAL, defaultSettings() ).w, 7.0f, 1e-5 );
+
+    // A rejected pixel restarts with this launch alone
+    const float4 restart = accumulateLaunch( make_float4( 0.0f ), make_float3( 0.25f ) );
+    HOST_CHECK_NEAR( restart.x, 0.25f, 0.0 );
+    HOST_CHECK_NEAR( restart.w, 1.0f, 0.0 );
+}
+
+
+void testNeighborhoodClamp()
+{
+    const unsigned int  width = 5, height = 4;
+    std::vector<float4> launch( width * height, make_float4( 0.5f, 0.5f, 0.5f, 0.0f ) );
+    launch[1 * width + 1] = make_float4( 0.2f, 0.9f, 0.5f, 0.0f );
+    launch[2 * width + 2] = make_float4( 0.1f, 0.3f, 2.0f, 0.0f );
+
+    // History inside the range of the neighbors is kept
+    const float3 inside = clampToNeighborhood( make_float3( 0.3f, 0.6f, 0.5f ), launch.data(), 1, 1, width, height );
+    HOST_CHECK_NEAR( inside.x, 0.3f, 0.0 );
+    HOST_CHECK_NEAR( inside.y, 0.6f, 0.0 );
+
+    // Stale lighting outside the range is pulled in per channel
+    const float3 bright = clampToNeighborhood( make_float3( 5.0f, 0.0f, 0.5f ), launch.data(), 2, 1, width, height );
+    HOST_CHECK_NEAR( bright.x, 0.5f, 0.0 );
+    HOST_CHECK_NEAR( bright.y, 0.3f, 0.0 );
+    HOST_CHECK_NEAR( bright.z, 0.5f, 0.0 );
+
+    // At the corner only the pixels inside the image count; (2,2) is out of reach of (0,0)
+    const float3 corner = clampToNeighborhood( make_float3( 0.0f, 0.0f, 3.0f ), launch.data(), 0, 0, width, height );
+    HOST_CHECK_NEAR( corner.x, 0.2f, 0.0 );
+    HOST_CHECK_NEAR( corner.y, 0.5f, 0.0 );
+    HOST_CHECK_NEAR( corner.z, 0.5f, 0.0 );
+    const float3 far_corner = clampToNeighborhood( make_float3( 0.0f, 0.0f, 3.0f ), launch.data(), width - 1, height - 1, width, height );
+    HOST_CHECK_NEAR( far_corner.x, 0.5f, 0.0 );
+    HOST_CHECK_NEAR( far_corner.z, 0.5f, 0.0 );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testProjectToPixel();
+    testSidewaysMove();
+    testForwardMove();
+    testRejection();
+    testHistoryGrowth();
+    testNeighborhoodClamp();
+    return hostTestResult( "reprojectionTest" );
+}
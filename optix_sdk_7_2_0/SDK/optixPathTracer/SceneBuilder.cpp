@@ -0,0 +1,314 @@
+#include "SceneBuilder.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+
+Arena::Arena( Arena&& other ) : m_block_bytes( other.m_block_bytes )
+{
+    *this = std::move( other );
+}
+
+
+Arena& Arena::operator=( Arena&& other )
+{
+    if( this != &other )
+    {
+        release();
+        std::swap( m_blocks, other.m_blocks );
+        std::swap( m_block_bytes, other.m_block_bytes );
+        std::swap( m_used, other.m_used );
+        std::swap( m_reserved, other.m_reserved );
+    }
+    return *this;
+}
+
+
+static size_t alignedOffset( const char* base, size_t used, size_t alignment )
+{
+    const uintptr_t address = reinterpret_cast<uintptr_t>( base ) + used;
+    const uintptr_t aligned = ( address + alignment - 1 ) & ~static_cast<uintptr_t>( alignment - 1 );
+    return used + static_cast<size_t>( aligned - address );
+}
+
+
+void* Arena::allocate( size_t bytes, size_t alignment )
+{
+    if( bytes == 0 )
+        return nullptr;
+
+    if( !m_blocks.empty() )
+    {
+        Block&       block  = m_blocks.back();
+        const size_t offset = alignedOffset( block.data, block.used, alignment );
+        if( offset + bytes <= block.size )
+        {
+            block.used = offset + bytes;
+            m_used += bytes;
+            return block.data + offset;
+        }
+    }
+
+    const size_t size  = std::max( m_block_bytes, bytes + alignment );
+    Block        block = { static_cast<char*>( std::malloc( size ) ), size, 0 };
+    if( !block.data )
+        throw std::bad_alloc();
+    const size_t offset = alignedOffset( block.data, 0, alignment );
+    block.used = offset + bytes;
+    m_used += bytes;
+    m_reserved += size;
+
+    // An oversized request gets a block of its own behind the current one, which keeps its free tail
+    if( size > m_block_bytes && !m_blocks.empty() )
+        m_blocks.insert( m_blocks.end() - 1, block );
+    else
+        m_blocks.push_back( block );
+    return block.data + offset;
+}
+
+
+void Arena::release()
+{
+    for( const Block& block : m_blocks )
+        std::free( block.data );
+    m_blocks.clear();
+    m_used     = 0;
+    m_reserved = 0;
+}
+
+
+// Copy the texture coordinates of the corners of triangle t of mesh to the corners of triangle destination
+static void copyTriangleTexcoords( const ObjMesh& mesh, size_t t, size_t destination, std::vector<float>& texcoords )
+{
+    for( size_t corner = 0; corner < 3; ++corner )
+    {
+        const int32_t index = mesh.texcoord_indices[t * 3 + corner];
+        float*        uv    = &texcoords[( destination * 3 + corner ) * 2];
+        uv[0]               = index < 0 ? 0.f : mesh.texcoords[index * 2 + 0];
+        uv[1]               = index < 0 ? 0.f : mesh.texcoords[index * 2 + 1];
+    }
+}
+
+
+void bucketByMaterial( ObjMesh&& mesh, ObjModel& model )
+{
+    const size_t num_triangles = mesh.numTriangles();
+    const bool   has_texcoords = !mesh.texcoord_indices.empty();
+    model.positions     = std::move( mesh.positions );
+    model.materials     = std::move( mesh.materials );
+    model.has_materials = !model.materials.empty();
+    model.runs.clear();
+    model.texcoords.assign( has_texcoords ? num_triangles * 6 : 0, 0.f );
+
+    if( !model.has_materials )
+    {
+        model.indices = std::move( mesh.indices );
+        if( num_triangles > 0 )
+            model.runs.push_back( { -1, 0, static_cast<uint32_t>( num_triangles ) } );
+        if( has_texcoords )
+            for( size_t t = 0; t < num_triangles; ++t )
+                copyTriangleTexcoords( mesh, t, t, model.texcoords );
+        mesh = ObjMesh();
+        return;
+    }
+
+    // Bucket b holds material b - 1, so faces without usemtl (-1) come first. first[b] is counted
+    // one slot ahead and turned into the start of bucket b by the prefix sum.
+    const size_t          num_buckets = model.materials.size() + 1;
+    std::vector<uint32_t> first( num_buckets + 1, 0 );
+    for( int32_t material : mesh.material_ids )
+        ++first[material + 2];
+    for( size_t b = 1; b <= num_buckets; ++b )
+        first[b] += first[b - 1];
+
+    for( size_t b = 0; b < num_buckets; ++b )
+        if( first[b + 1] > first[b] )
+            model.runs.push_back( { static_cast<int32_t>( b ) - 1, first[b], first[b + 1] - first[b] } );
+
+    std::vector<uint32_t> cursor( first.begin(), first.end() - 1 );
+    model.indices.resize( mesh.indices.size() );
+    for( size_t t = 0; t < num_triangles; ++t )
+    {
+        const uint32_t destination = cursor[mesh.material_ids[t] + 1]++;
+        std::memcpy( &model.indices[destination * 3], &mesh.indices[t * 3], 3 * sizeof( uint32_t ) );
+        if( has_texcoords )
+            copyTriangleTexcoords( mesh, t, destination, model.texcoords );
+    }
+    mesh = ObjMesh();
+}
+
+
+uint32_t SceneBuilder::addMaterial( Material type, float3 diffuse, float3 specular, float3 emission, float spec_exp, float ior,
+                                    int32_t diffuse_texture, int32_t specular_texture )
+{
+    materials.types.push_back( type );
+    materials.diffuse.push_back( diffuse );
+    materials.specular.push_back( specular );
+    materials.emission.push_back( emission );
+    materials.spec_exp.push_back( spec_exp );
+    materials.ior.push_back( ior );
+    materials.diffuse_texture.push_back( diffuse_texture );
+    materials.specular_texture.push_back( specular_texture );
+    return materials.size() - 1;
+}
+
+
+int32_t SceneBuilder::addTexture( const std::string& path )
+{
+    auto cached = m_texture_ids.find( path );
+    if( cached != m_texture_ids.end() )
+        return cached->second;
+    const int32_t id    = static_cast<int32_t>( textures.size() );
+    m_texture_ids[path] = id;
+    textures.push_back( path );
+    return id;
+}
+
+
+SceneMesh* SceneBuilder::addInstance( const std::string& key, const float transform[12] )
+{
+    SceneMesh* mesh = nullptr;
+    uint32_t   mesh_id;
+    auto       cached = m_mesh_cache.find( key );
+    if( cached == m_mesh_cache.end() )
+    {
+        mesh_id            = static_cast<uint32_t>( meshes.size() );
+        m_mesh_cache[key]  = mesh_id;
+        meshes.push_back( SceneMesh() );
+        mesh       = &meshes.back();
+        mesh->name = key;
+    }
+    else
+    {
+        mesh_id = cached->second;
+    }
+
+    Instance instance;
+    std::memcpy( instance.transform, transform, sizeof( instance.transform ) );
+    instance.mesh_id = mesh_id;
+    instances.push_back( instance );
+    return mesh;
+}
+
+
+void SceneBuilder::allocate( SceneMesh& mesh, size_t num_primitives, bool texcoords )
+{
+    mesh.num_primitives   = num_primitives;
+    mesh.material_indices = ArenaArray<uint32_t>::allocate( m_arena, num_primitives );
+    if( mesh.type == GEOMETRY_TRIANGLES && texcoords )
+        mesh.texcoords = ArenaArray<float2>::allocate( m_arena, num_primitives * 3 );
+    if( mesh.type == GEOMETRY_TRIANGLES )
+        mesh.vertices = ArenaArray<float3>::allocate( m_arena, num_primitives * 3 );
+    else if( mesh.type == GEOMETRY_SPHERES )
+        mesh.spheres = ArenaArray<Sphere>::allocate( m_arena, num_primitives );
+    else
+        mesh.parallelograms = ArenaArray<float3>::allocate( m_arena, num_primitives * 3 );
+}
+
+
+const ObjModel& SceneBuilder::loadObjCached( const std::string& filename )
+{
+    auto cached = m_obj_cache.find( filename );
+    if( cached != m_obj_cache.end() )
+        return cached->second;
+
+    ObjMesh     obj;
+    std::string warn, err;
+    const auto  t0 = std::chrono::steady_clock::now();
+    const bool  ok = loadObj( filename, obj, warn, err );
+    if( !warn.empty() )
+        std::cout << warn << std::endl;
+    if( !ok )
+        throw std::runtime_error( err );
+    const std::chrono::duration<double, std::milli> parse_time = std::chrono::steady_clock::now() - t0;
+
+    dependencies.push_back( filename );
+    dependencies.insert( dependencies.end(), obj.material_libraries.begin(), obj.material_libraries.end() );
+
+    const size_t num_triangles = obj.numTriangles();
+    ObjModel&    model         = m_obj_cache[filename];
+    bucketByMaterial( std::move( obj ), model );
+
+    // Texture maps are relative to the material library, which lives next to the OBJ file
+    const std::string directory = filename.substr( 0, filename.rfind( '/' ) + 1 );
+    for( ObjMaterial& material : model.materials )
+    {
+        for( std::string* texname : { &material.diffuse_texname, &material.specular_texname } )
+        {
+            if( texname->empty() )
+                continue;
+            std::replace( texname->begin(), texname->end(), '\\', '/' );
+            const bool absolute = ( *texname )[0] == '/' || ( texname->size() > 1 && ( *texname )[1] == ':' );
+            if( !absolute )
+                *texname = directory + *texname;
+        }
+    }
+    if( model.has_materials )
+        std::cout << "mtl file loaded!" << std::endl;
+    std::cout << "Loaded mesh with " << num_triangles << " triangles from " << filename << " in "
+              << parse_time.count() << " ms" << std::endl;
+    return model;
+}
+
+
+void SceneBuilder::releaseObjCache()
+{
+    m_obj_cache.clear();
+}
+
+
+SceneStorage SceneBuilder::takeGeometry()
+{
+    SceneStorage storage;
+    storage.arena   = std::move( m_arena );
+    storage.mapping = std::move( m_mapping );
+    return storage;
+}
+
+
+size_t SceneBuilder::numPrimitives() const
+{
+    size_t count = 0;
+    for( const SceneMesh& mesh : meshes )
+        count += mesh.num_primitives;
+    return count;
+}
+
+
+size_t peakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if( GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+        return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>( usage.ru_maxrss );  // bytes
+#else
+    return static_cast<size_t>( usage.ru_maxrss ) * 1024;  // kilobytes
+#endif
+#endif
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <optix_types.h>
+
+#include "MappedFile.h"
+#include "ObjLoader.h"
+#include "optixPathTracer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+*   Host side scene description assembled by readSceneFile and consumed by the acceleration builds.
+*
+*   Materials are a structure of arrays indexed by material id (the SBT offset), meshes, instances and
+*   lights are flat arrays. The per-primitive data of the meshes (triangle soups, spheres,
+*   parallelograms and material indices) is carved out of one Arena with exact sizes that are known
+*   before a mesh is filled, so loading a scene performs no per-triangle heap allocations. A scene
+*   loaded from the binary cache (SceneCache.h) points into the mapped file instead. Either storage is
+*   handed over to the GAS builds with takeGeometry() and freed in one go once the meshes are on the
+*   device.
+*/
+
+/**
+       * Bump allocator for trivially copyable arrays. Memory comes from large blocks and is only
+       * returned all at once by release() or destruction. Move-only; moving keeps every pointer handed
+       * out so far valid.
+*/
+class Arena
+{
+public:
+    explicit Arena( size_t block_bytes = size_t( 4 ) << 20 ) : m_block_bytes( block_bytes ) {}
+    ~Arena() { release(); }
+
+    Arena( Arena&& other );
+    Arena& operator=( Arena&& other );
+
+    Arena( const Arena& ) = delete;
+    Arena& operator=( const Arena& ) = delete;
+
+    // bytes of uninitialized memory with the given power of two alignment, nullptr for zero bytes
+    void* allocate( size_t bytes, size_t alignment );
+    void  release();
+
+    size_t bytesUsed() const     { return m_used; }
+    size_t bytesReserved() const { return m_reserved; }
+
+private:
+    struct Block
+    {
+        char*  data;
+        size_t size;
+        size_t used;
+    };
+
+    std::vector<Block> m_blocks;  // the last block is the one being filled
+    size_t             m_block_bytes;
+    size_t             m_used     = 0;
+    size_t             m_reserved = 0;
+};
+
+
+// Non-owning view of an array in the scene storage: allocated from an Arena or mapped from a scene cache
+template <typename T>
+class ArenaArray
+{
+public:
+    ArenaArray() = default;
+    ArenaArray( T* data, size_t size ) : m_data( data ), m_size( size ) {}
+
+    static ArenaArray allocate( Arena& arena, size_t count )
+    {
+        return ArenaArray( static_cast<T*>( arena.allocate( count * sizeof( T ), alignof( T ) ) ), count );
+    }
+
+    T*     data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool   empty() const { return m_size == 0; }
+    T*     begin() const { return m_data; }
+    T*     end() const { return m_data + m_size; }
+    T&     operator[]( size_t i ) const { return m_data[i]; }
+
+private:
+    T*     m_data = nullptr;
+    size_t m_size = 0;
+};
+
+
+struct MaterialTable
+{
+    std::vector<Material> types;
+    std::vector<float3>   diffuse;
+    std::vector<float3>   specular;
+    std::vector<float3>   emission;
+    std::vector<float>    spec_exp;
+    std::vector<float>    ior;
+    std::vector<int32_t>  diffuse_texture;   // index into SceneBuilder::textures, -1 for none
+    std::vector<int32_t>  specular_texture;
+
+    uint32_t size() const { return static_cast<uint32_t>( types.size() ); }
+};
+
+
+/*
+    Object space geometry shared by every instance that references it; one GAS is built per mesh.
+    The arrays point into the scene storage and are emptied once the GAS is built. Arrays that point
+    into a mapped scene cache are read-only.
+*/
+struct SceneMesh
+{
+    std::string            name;                // cache key: OBJ path or procedural shape, plus material
+    GeometryType           type = GEOMETRY_TRIANGLES;
+    bool                   dynamic = false;     // vertices change at runtime, see updateMeshVertices()
+    size_t                 num_primitives = 0;  // triangles, spheres or parallelograms, kept after the build
+    ArenaArray<float3>     vertices;            // GEOMETRY_TRIANGLES: triangle soup, three vertices per triangle
+    ArenaArray<uint3>      indices;             // if not empty, vertices are welded and indexed by these triplets
+    ArenaArray<Sphere>     spheres;             // GEOMETRY_SPHERES
+    ArenaArray<float3>     parallelograms;      // GEOMETRY_PARALLELOGRAMS: anchor, edge1, edge2 per primitive
+    ArenaArray<uint32_t>   material_indices;    // material (SBT offset) per primitive
+    ArenaArray<float2>     texcoords;           // GEOMETRY_TRIANGLES: three per triangle like vertices, empty if the
+                                                // mesh has no texture coordinates
+};
+
+
+struct Instance
+{
+    float        transform[12];  // row-major 3x4, object to world
+    unsigned int mesh_id;        // index into SceneBuilder::meshes, also the OptixInstance instanceId
+};
+
+
+/*
+    An OBJ file with its triangles bucketed by material: runs[i] covers the index triplets
+    [first_triangle, first_triangle + num_triangles) that all use OBJ material runs[i].material (-1 for
+    faces without usemtl). Without a material library there is a single run. Texture coordinates are
+    stored per triangle corner in the order of the indices.
+*/
+struct ObjModel
+{
+    struct MaterialRun
+    {
+        int32_t  material;
+        uint32_t first_triangle;
+        uint32_t num_triangles;
+    };
+
+    std::vector<float>       positions;  // x, y, z per vertex, as loaded
+    std::vector<uint32_t>    indices;    // three per triangle, grouped by material, file order within a group
+    std::vector<MaterialRun> runs;       // by ascending material id
+    std::vector<float>       texcoords;  // u, v per entry of indices, (0, 0) for corners without one; empty if the file has none
+    std::vector<ObjMaterial> materials;  // texture paths resolved against the directory of the OBJ file
+    bool                     has_materials = false;
+
+    size_t numTriangles() const { return indices.size() / 3; }
+};
+
+
+// Bucket the triangles of mesh by material id with one counting sort; mesh is consumed
+void bucketByMaterial( ObjMesh&& mesh, ObjModel& model );
+
+
+// Memory behind the mesh arrays of a scene
+struct SceneStorage
+{
+    Arena      arena;
+    MappedFile mapping;  // scene cache the scene was loaded from, if any
+};
+
+
+class SceneBuilder
+{
+public:
+    MaterialTable            materials;
+    std::vector<SceneMesh>   meshes;
+    std::vector<Instance>    instances;
+    std::vector<Light>       lights;
+    std::vector<std::string> dependencies;  // OBJ and MTL files the geometry was built from, for the scene cache
+    std::vector<std::string> textures;      // image files of the material texture maps, loaded on demand at render time
+
+    uint32_t addMaterial( Material type, float3 diffuse, float3 specular, float3 emission, float spec_exp, float ior,
+                          int32_t diffuse_texture = -1, int32_t specular_texture = -1 );
+    uint32_t numMaterials() const { return materials.size(); }
+
+    // Index of the texture with the given path in textures, added if it is new
+    int32_t addTexture( const std::string& path );
+
+    // Place an instance of the mesh with the given key. Returns the mesh if it is new and still has to be
+    // given a type and filled with allocate(), nullptr if an earlier call already created it.
+    SceneMesh* addInstance( const std::string& key, const float transform[12] );
+
+    // Size the primitive arrays of mesh for its type from the arena, with texcoords also the texture
+    // coordinates of a triangle mesh; the caller fills them
+    void allocate( SceneMesh& mesh, size_t num_primitives, bool texcoords = false );
+
+    // Parse and bucket each OBJ file once, no matter how many meshes use it. Throws on malformed files.
+    const ObjModel& loadObjCached( const std::string& filename );
+    void            releaseObjCache();
+
+    // Keep a mapped scene cache alive for the mesh arrays that point into it
+    void adoptMapping( MappedFile&& mapping ) { m_mapping = std::move( mapping ); }
+
+    // Hand the storage over to the GAS builds. The mesh arrays stay valid for as long as the returned
+    // storage lives; the builder starts a new, empty one.
+    SceneStorage takeGeometry();
+
+    size_t numPrimitives() const;
+    size_t arenaBytes() const { return m_arena.bytesReserved(); }
+
+private:
+    Arena                           m_arena;
+    MappedFile                      m_mapping;
+    std::map<std::string, uint32_t> m_mesh_cache;  // mesh key -> index into meshes
+    std::map<std::string, ObjModel> m_obj_cache;   // OBJ path -> bucketed model
+    std::map<std::string, int32_t>  m_texture_ids; // texture path -> index into textures
+};
+
+
+// High water mark of the resident set size of this process in bytes, 0 if unknown
+size_t peakResidentBytes();
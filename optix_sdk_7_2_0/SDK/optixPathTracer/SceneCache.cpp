@@ -0,0 +1,450 @@
+#include "SceneCache.h"
+
+#include "IndexedGeometry.h"
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <utility>
+#include <vector>
+
+
+static uint64_t rotl( uint64_t x, int r )
+{
+    return ( x << r ) | ( x >> ( 64 - r ) );
+}
+
+
+static uint64_t fmix( uint64_t h )
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+
+uint64_t hashBytes( const void* data, size_t size, uint64_t seed )
+{
+    // Four independent lanes over 32 byte blocks keep the multiplies pipelined
+    const uint64_t       k1       = 0x9E3779B97F4A7C15ull;
+    const uint64_t       k2       = 0xC2B2AE3D27D4EB4Full;
+    const unsigned char* p        = static_cast<const unsigned char*>( data );
+    uint64_t             lanes[4] = { seed + k1 + k2, seed + k2, seed, seed - k1 };
+
+    size_t i = 0;
+    for( ; i + 32 <= size; i += 32 )
+    {
+        for( int l = 0; l < 4; ++l )
+        {
+            uint64_t word;
+            std::memcpy( &word, p + i + 8 * l, sizeof( word ) );
+            lanes[l] = rotl( lanes[l] + word * k2, 31 ) * k1;
+        }
+    }
+
+    uint64_t h = size * k1;
+    for( int l = 0; l < 4; ++l )
+        h = rotl( h ^ fmix( lanes[l] ), 27 ) * k1 + k2;
+    for( ; i < size; ++i )
+        h = ( h ^ p[i] ) * 0x100000001B3ull;
+    return fmix( h );
+}
+
+
+bool hashFile( const std::string& filename, uint64_t& hash, uint64_t& size )
+{
+    MappedFile file;
+    if( !file.open( filename ) )
+        return false;
+    hash = hashBytes( file.data(), file.size() );
+    size = file.size();
+    return true;
+}
+
+
+std::string sceneCachePath( const std::string& scene_file )
+{
+    return scene_file + ".rrscene";
+}
+
+
+uint64_t sceneCacheOptions( bool tessellate_primitives )
+{
+    return tessellate_primitives ? 1u : 0u;
+}
+
+
+namespace
+{
+
+const uint64_t SECTION_ALIGNMENT = 64;
+const uint64_t MISSING_FILE      = ~0ull;
+
+class CacheWriter
+{
+public:
+    explicit CacheWriter( size_t reserved ) : m_bytes( reserved, 0 ) {}
+
+    // Append bytes at the next section boundary and return their offset
+    uint64_t append( const void* data, size_t bytes )
+    {
+        m_bytes.resize( ( m_bytes.size() + SECTION_ALIGNMENT - 1 ) / SECTION_ALIGNMENT * SECTION_ALIGNMENT, 0 );
+        const uint64_t offset = m_bytes.size();
+        if( bytes )
+            m_bytes.insert( m_bytes.end(), static_cast<const char*>( data ), static_cast<const char*>( data ) + bytes );
+        return offset;
+    }
+
+    template <typename T>
+    uint64_t append( const std::vector<T>& array )
+    {
+        return append( array.data(), array.size() * sizeof( T ) );
+    }
+
+    std::vector<char>& bytes() { return m_bytes; }
+
+private:
+    std::vector<char> m_bytes;
+};
+
+
+// Typed view of count records at offset, nullptr if they do not lie within the file
+template <typename T>
+const T* section( const MappedFile& file, uint64_t offset, uint64_t count )
+{
+    if( offset > file.size() || offset % alignof( T ) != 0 || count > ( file.size() - offset ) / sizeof( T ) )
+        return nullptr;
+    return reinterpret_cast<const T*>( file.data() + offset );
+}
+
+
+template <typename T>
+ArenaArray<T> mappedArray( const T* data, uint64_t count )
+{
+    return ArenaArray<T>( const_cast<T*>( data ), static_cast<size_t>( count ) );
+}
+
+}  // namespace
+
+
+bool writeSceneCache( const std::string& cache_file, const std::string& scene_file, uint64_t options,
+                      const SceneBuilder& scene, std::string& err )
+{
+    SceneCacheHeader header = {};
+    std::memcpy( header.magic, SCENE_CACHE_MAGIC, sizeof( header.magic ) );
+    header.version        = SCENE_CACHE_VERSION;
+    header.header_bytes   = sizeof( SceneCacheHeader );
+    header.instance_bytes = sizeof( Instance );
+    header.light_bytes    = sizeof( Light );
+    header.options        = options;
+    uint64_t scene_bytes;
+    if( !hashFile( scene_file, header.scene_hash, scene_bytes ) )
+    {
+        err = "cannot read " + scene_file;
+        return false;
+    }
+
+    CacheWriter writer( sizeof( SceneCacheHeader ) );
+    std::string strings;
+    const auto addString = [&strings]( const std::string& s ) {
+        const uint32_t offset = static_cast<uint32_t>( strings.size() );
+        strings += s;
+        return offset;
+    };
+
+    std::vector<SceneCacheDependency> dependencies;
+    std::set<std::string>             seen;
+    for( const std::string& path : scene.dependencies )
+    {
+        if( !seen.insert( path ).second )
+            continue;
+        SceneCacheDependency dependency = {};
+        if( !hashFile( path, dependency.content_hash, dependency.size ) )
+            dependency.size = MISSING_FILE;
+        dependency.path        = addString( path );
+        dependency.path_length = static_cast<uint32_t>( path.size() );
+        dependencies.push_back( dependency );
+    }
+
+    std::vector<SceneCacheMaterial> materials( scene.numMaterials() );
+    for( uint32_t i = 0; i < scene.numMaterials(); ++i )
+    {
+        SceneCacheMaterial& material = materials[i];
+        const float3        diffuse  = scene.materials.diffuse[i];
+        const float3        specular = scene.materials.specular[i];
+        const float3        emission = scene.materials.emission[i];
+        material.type     = scene.materials.types[i];
+        std::memcpy( material.diffuse, &diffuse, sizeof( material.diffuse ) );
+        std::memcpy( material.specular, &specular, sizeof( material.specular ) );
+        std::memcpy( material.emission, &emission, sizeof( material.emission ) );
+        material.spec_exp = scene.materials.spec_exp[i];
+        material.ior      = scene.materials.ior[i];
+        material.diffuse_texture  = scene.materials.diffuse_texture[i];
+        material.specular_texture = scene.materials.specular_texture[i];
+    }
+
+    std::vector<SceneCacheTexture> textures;
+    for( const std::string& path : scene.textures )
+        textures.push_back( { addString( path ), static_cast<uint32_t>( path.size() ) } );
+
+    std::vector<SceneCacheMesh> meshes;
+    for( const SceneMesh& mesh : scene.meshes )
+    {
+        SceneCacheMesh record = {};
+        record.type           = mesh.type;
+        record.dynamic        = mesh.dynamic;
+        record.name           = addString( mesh.name );
+        record.name_length    = static_cast<uint32_t>( mesh.name.size() );
+        record.num_primitives = mesh.num_primitives;
+        if( mesh.type == GEOMETRY_TRIANGLES && mesh.indices.empty() )
+        {
+            const IndexedMesh<float3> welded = weldTriangleSoup( mesh.vertices.data(), mesh.vertices.size() );
+            record.num_vertices = welded.vertices.size();
+            record.geometry     = writer.append( welded.vertices );
+            record.indices      = writer.append( welded.indices );
+        }
+        else if( mesh.type == GEOMETRY_TRIANGLES )
+        {
+            record.num_vertices = mesh.vertices.size();
+            record.geometry     = writer.append( mesh.vertices.data(), mesh.vertices.size() * sizeof( float3 ) );
+            record.indices      = writer.append( mesh.indices.data(), mesh.indices.size() * sizeof( uint3 ) );
+        }
+        else if( mesh.type == GEOMETRY_SPHERES )
+        {
+            record.geometry = writer.append( mesh.spheres.data(), mesh.spheres.size() * sizeof( Sphere ) );
+        }
+        else
+        {
+            record.geometry = writer.append( mesh.parallelograms.data(), mesh.parallelograms.size() * sizeof( float3 ) );
+        }
+        record.material_indices = writer.append( mesh.material_indices.data(), mesh.material_indices.size() * sizeof( uint32_t ) );
+        if( !mesh.texcoords.empty() )
+            record.texcoords = writer.append( mesh.texcoords.data(), mesh.texcoords.size() * sizeof( float2 ) );
+        meshes.push_back( record );
+    }
+
+    header.num_dependencies = static_cast<uint32_t>( dependencies.size() );
+    header.num_materials    = static_cast<uint32_t>( materials.size() );
+    header.num_meshes       = static_cast<uint32_t>( meshes.size() );
+    header.num_instances    = static_cast<uint32_t>( scene.instances.size() );
+    header.num_lights       = static_cast<uint32_t>( scene.lights.size() );
+    header.num_textures     = static_cast<uint32_t>( textures.size() );
+    header.dependencies     = writer.append( dependencies );
+    header.materials        = writer.append( materials );
+    header.meshes           = writer.append( meshes );
+    header.instances        = writer.append( scene.instances );
+    header.lights           = writer.append( scene.lights );
+    header.textures         = writer.append( textures );
+    header.strings          = writer.append( strings.data(), strings.size() );
+    header.strings_bytes    = strings.size();
+    header.file_bytes       = writer.bytes().size();
+    std::memcpy( writer.bytes().data(), &header, sizeof( header ) );
+
+    const std::string temp_file = cache_file + ".tmp";
+    {
+        std::ofstream out( temp_file, std::ios::binary | std::ios::trunc );
+        out.write( writer.bytes().data(), writer.bytes().size() );
+        if( !out )
+        {
+            err = "cannot write " + temp_file;
+            return false;
+        }
+    }
+    std::remove( cache_file.c_str() );  // rename does not replace an existing file on Windows
+    if( std::rename( temp_file.c_str(), cache_file.c_str() ) != 0 )
+    {
+        std::remove( temp_file.c_str() );
+        err = "cannot rename " + temp_file + " to " + cache_file;
+        return false;
+    }
+    return true;
+}
+
+
+bool loadSceneCache( const std::string& cache_file, const std::string& scene_file, uint64_t options,
+                     SceneBuilder& scene, std::string& reason )
+{
+    MappedFile file;
+    if( !file.open( cache_file ) )
+    {
+        reason = "no cache file";
+        return false;
+    }
+    SceneCacheHeader header;
+    if( file.size() < sizeof( header ) )
+    {
+        reason = "truncated header";
+        return false;
+    }
+    std::memcpy( &header, file.data(), sizeof( header ) );
+    if( std::memcmp( header.magic, SCENE_CACHE_MAGIC, sizeof( header.magic ) ) != 0 || header.version != SCENE_CACHE_VERSION
+        || header.header_bytes != sizeof( SceneCacheHeader ) || header.instance_bytes != sizeof( Instance )
+        || header.light_bytes != sizeof( Light ) )
+    {
+        reason = "different format version";
+        return false;
+    }
+    if( header.file_bytes != file.size() )
+    {
+        reason = "truncated file";
+        return false;
+    }
+    if( header.options != options )
+    {
+        reason = "written with different options";
+        return false;
+    }
+
+    uint64_t scene_hash, scene_bytes;
+    if( !hashFile( scene_file, scene_hash, scene_bytes ) )
+    {
+        reason = "cannot read " + scene_file;
+        return false;
+    }
+    if( scene_hash != header.scene_hash )
+    {
+        reason = scene_file + " changed";
+        return false;
+    }
+
+    const SceneCacheDependency* dependencies = section<SceneCacheDependency>( file, header.dependencies, header.num_dependencies );
+    const SceneCacheMaterial*   materials    = section<SceneCacheMaterial>( file, header.materials, header.num_materials );
+    const SceneCacheMesh*       meshes       = section<SceneCacheMesh>( file, header.meshes, header.num_meshes );
+    const Instance*             instances    = section<Instance>( file, header.instances, header.num_instances );
+    const Light*                lights       = section<Light>( file, header.lights, header.num_lights );
+    const SceneCacheTexture*    textures     = section<SceneCacheTexture>( file, header.textures, header.num_textures );
+    const char*                 strings      = section<char>( file, header.strings, header.strings_bytes );
+    if( !dependencies || !materials || !meshes || !instances || !lights || !textures || !strings )
+    {
+        reason = "corrupt section table";
+        return false;
+    }
+    const auto getString = [&]( uint32_t offset, uint32_t length, std::string& s ) {
+        if( offset > header.strings_bytes || length > header.strings_bytes - offset )
+            return false;
+        s.assign( strings + offset, length );
+        return true;
+    };
+
+    for( uint32_t i = 0; i < header.num_dependencies; ++i )
+    {
+        std::string path;
+        if( !getString( dependencies[i].path, dependencies[i].path_length, path ) )
+        {
+            reason = "corrupt dependency table";
+            return false;
+        }
+        uint64_t hash = 0, size = MISSING_FILE;
+        hashFile( path, hash, size );
+        if( size != dependencies[i].size || hash != dependencies[i].content_hash )
+        {
+            reason = path + ( size == MISSING_FILE ? " is missing" : dependencies[i].size == MISSING_FILE ? " appeared" : " changed" );
+            return false;
+        }
+    }
+
+    SceneBuilder loaded;
+    for( uint32_t i = 0; i < header.num_textures; ++i )
+    {
+        std::string path;
+        if( !getString( textures[i].path, textures[i].path_length, path ) )
+        {
+            reason = "corrupt texture table";
+            return false;
+        }
+        loaded.addTexture( path );
+    }
+    const auto validTexture = [&]( int32_t texture ) {
+        return texture >= -1 && texture < static_cast<int32_t>( loaded.textures.size() );
+    };
+    for( uint32_t i = 0; i < header.num_materials; ++i )
+    {
+        const SceneCacheMaterial& m = materials[i];
+        if( m.type > EMISSIVE || !validTexture( m.diffuse_texture ) || !validTexture( m.specular_texture ) )
+        {
+            reason = "corrupt material table";
+            return false;
+        }
+        loaded.addMaterial( static_cast<Material>( m.type ), make_float3( m.diffuse[0], m.diffuse[1], m.diffuse[2] ),
+                            make_float3( m.specular[0], m.specular[1], m.specular[2] ),
+                            make_float3( m.emission[0], m.emission[1], m.emission[2] ), m.spec_exp, m.ior,
+                            m.diffuse_texture, m.specular_texture );
+    }
+
+    // Every index is checked once here so that a damaged cache cannot send the GAS builds out of bounds
+    loaded.meshes.resize( header.num_meshes );
+    for( uint32_t i = 0; i < header.num_meshes; ++i )
+    {
+        const SceneCacheMesh& record = meshes[i];
+        SceneMesh&            mesh   = loaded.meshes[i];
+        mesh.type           = static_cast<GeometryType>( record.type );
+        mesh.dynamic        = record.dynamic != 0;
+        mesh.num_primitives = static_cast<size_t>( record.num_primitives );
+
+        bool valid = record.type < GEOMETRY_TYPE_COUNT && record.num_primitives <= file.size()
+                     && getString( record.name, record.name_length, mesh.name );
+        const uint32_t* material_indices = section<uint32_t>( file, record.material_indices, record.num_primitives );
+        valid = valid && material_indices;
+        for( uint64_t p = 0; valid && p < record.num_primitives; ++p )
+            valid = material_indices[p] < header.num_materials;
+        if( valid && mesh.type == GEOMETRY_TRIANGLES )
+        {
+            const float3* vertices = section<float3>( file, record.geometry, record.num_vertices );
+            const uint3*  indices  = section<uint3>( file, record.indices, record.num_primitives );
+            const float2* texcoords = record.texcoords ? section<float2>( file, record.texcoords, record.num_primitives * 3 ) : nullptr;
+            valid = vertices && indices && ( texcoords || !record.texcoords );
+            for( uint64_t t = 0; valid && t < record.num_primitives; ++t )
+                valid = indices[t].x < record.num_vertices && indices[t].y < record.num_vertices && indices[t].z < record.num_vertices;
+            if( valid )
+            {
+                mesh.vertices = mappedArray( vertices, record.num_vertices );
+                mesh.indices  = mappedArray( indices, record.num_primitives );
+                if( texcoords )
+                    mesh.texcoords = mappedArray( texcoords, record.num_primitives * 3 );
+            }
+        }
+        else if( valid && mesh.type == GEOMETRY_SPHERES )
+        {
+            const Sphere* spheres = section<Sphere>( file, record.geometry, record.num_primitives );
+            valid                 = spheres != nullptr;
+            mesh.spheres          = mappedArray( spheres, record.num_primitives );
+        }
+        else if( valid )
+        {
+            const float3* parallelograms = section<float3>( file, record.geometry, record.num_primitives * 3 );
+            valid                        = parallelograms != nullptr;
+            mesh.parallelograms          = mappedArray( parallelograms, record.num_primitives * 3 );
+        }
+        if( !valid )
+        {
+            reason = "corrupt mesh " + std::to_string( i );
+            return false;
+        }
+        mesh.material_indices = mappedArray( material_indices, record.num_primitives );
+    }
+
+    loaded.instances.assign( instances, instances + header.num_instances );
+    for( const Instance& instance : loaded.instances )
+    {
+        if( instance.mesh_id >= header.num_meshes )
+        {
+            reason = "corrupt instance table";
+            return false;
+        }
+    }
+    loaded.lights.assign( lights, lights + header.num_lights );
+    for( uint32_t i = 0; i < header.num_dependencies; ++i )
+    {
+        loaded.dependencies.emplace_back();
+        getString( dependencies[i].path, dependencies[i].path_length, loaded.dependencies.back() );
+    }
+
+    loaded.adoptMapping( std::move( file ) );
+    scene = std::move( loaded );
+    return true;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "SceneBuilder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+*   Binary scene cache (.rrscene). It is written after a scene has been loaded from its text file and
+*   OBJ/MTL files, and mapped on later runs instead of parsing them again.
+*
+*   The file is a SceneCacheHeader followed by 64 byte aligned sections:
+*     - dependencies: path, size and content hash of every OBJ and MTL file the geometry came from
+*     - materials, instances and lights as flat records
+*     - textures: the paths of the texture maps the materials refer to
+*     - meshes: one record per SceneMesh pointing at its arrays; triangle meshes are stored welded
+*       (float3 vertices and uint3 indices) with optional float2 texture coordinates per corner,
+*       custom primitives as Sphere or anchor/edge triples, each with one uint32 material index per
+*       primitive
+*     - strings: mesh names, dependency and texture paths
+*   The mesh arrays are used in place from the mapping, so a cached scene goes to the GAS builds
+*   without being parsed or copied on the host. Texture images are not part of the cache, they are
+*   read on demand while rendering.
+*
+*   A cache only applies to the scene file content, the loader options and the dependency contents it
+*   was written for; anything else (and a different version or record layout) is reported as stale.
+*   The records are written in the host byte order and layout, so a cache is not portable between
+*   platforms.
+*/
+
+static const char     SCENE_CACHE_MAGIC[8] = { 'R', 'R', 'S', 'C', 'E', 'N', 'E', 0 };
+static const uint32_t SCENE_CACHE_VERSION  = 2;
+
+
+struct SceneCacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_bytes;      // layout checks for the records copied as they are
+    uint32_t instance_bytes;
+    uint32_t light_bytes;
+    uint64_t file_bytes;        // catches truncated files
+    uint64_t scene_hash;        // content hash of the scene text file
+    uint64_t options;           // loader options the geometry depends on, see sceneCacheOptions()
+
+    uint32_t num_dependencies;
+    uint32_t num_materials;
+    uint32_t num_meshes;
+    uint32_t num_instances;
+    uint32_t num_lights;
+    uint32_t num_textures;
+
+    uint64_t dependencies;      // section offsets from the start of the file
+    uint64_t materials;
+    uint64_t meshes;
+    uint64_t instances;
+    uint64_t lights;
+    uint64_t textures;
+    uint64_t strings;
+    uint64_t strings_bytes;
+};
+
+
+struct SceneCacheDependency
+{
+    uint64_t content_hash;
+    uint64_t size;              // UINT64_MAX if the file did not exist, e.g. a missing mtllib
+    uint32_t path;              // offset into the string section
+    uint32_t path_length;
+};
+
+
+struct SceneCacheMaterial
+{
+    uint32_t type;              // Material
+    float    diffuse[3];
+    float    specular[3];
+    float    emission[3];
+    float    spec_exp;
+    float    ior;
+    int32_t  diffuse_texture;   // index into the texture section, -1 for none
+    int32_t  specular_texture;
+};
+
+
+struct SceneCacheTexture
+{
+    uint32_t path;              // offset into the string section
+    uint32_t path_length;
+};
+
+
+struct SceneCacheMesh
+{
+    uint32_t type;              // GeometryType
+    uint32_t dynamic;
+    uint32_t name;              // offset into the string section
+    uint32_t name_length;
+    uint64_t num_primitives;
+    uint64_t num_vertices;      // welded vertices of a triangle mesh, three floats per primitive otherwise
+    uint64_t geometry;          // float3 vertices, Sphere or float3 anchor/edge1/edge2 per primitive
+    uint64_t indices;           // uint3 per triangle, 0 for custom primitives
+    uint64_t material_indices;  // uint32 per primitive
+    uint64_t texcoords;         // float2 per triangle corner in primitive order, 0 without texture coordinates
+};
+
+
+// 64-bit content hash, not cryptographic; used to detect changed inputs
+uint64_t hashBytes( const void* data, size_t size, uint64_t seed = 0 );
+
+// Hash the content of filename; false if it cannot be read
+bool hashFile( const std::string& filename, uint64_t& hash, uint64_t& size );
+
+// Default cache path of a scene file
+std::string sceneCachePath( const std::string& scene_file );
+
+// Bits of the options that change the loaded geometry and therefore the cache
+uint64_t sceneCacheOptions( bool tessellate_primitives );
+
+/*
+    Write scene, as loaded from scene_file with the given options, to cache_file. Triangle soups are
+    welded first. The file is written under a temporary name and renamed, so a crash never leaves a
+    partial cache behind. Returns false and describes the problem in err.
+*/
+bool writeSceneCache( const std::string& cache_file, const std::string& scene_file, uint64_t options,
+                      const SceneBuilder& scene, std::string& err );
+
+/*
+    Replace the materials, meshes, instances and lights of scene with the content of cache_file if it
+    is valid for the current scene_file, options and dependency contents. The mesh arrays point into
+    the mapping, which scene keeps alive. Returns false and tells why in reason otherwise; scene is
+    left untouched then.
+*/
+bool loadSceneCache( const std::string& cache_file, const std::string& scene_file, uint64_t options,
+                     SceneBuilder& scene, std::string& reason );
@@ -0,0 +1,345 @@
+//
+// sceneCacheTest - host tests of the binary scene cache: a cache written for a scene loads back with
+// the same content, and loadSceneCache() rejects it once the scene file, an OBJ or MTL file it depends
+// on or the loader options change, and when the cache file is truncated or damaged.
+//
+// The test writes a small scene file, OBJ and MTL into the working directory and removes them again.
+//
+
+#include "SceneCache.h"
+#include "HostTest.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+const std::string SCENE_FILE = "sceneCacheTest.scene";
+const std::string OBJ_FILE   = "sceneCacheTest.obj";
+const std::string MTL_FILE   = "sceneCacheTest.mtl";
+const std::string CACHE_FILE = "sceneCacheTest.rrscene";
+
+void writeFile( const std::string& filename, const std::string& content )
+{
+    std::ofstream out( filename.c_str(), std::ios::binary | std::ios::trunc );
+    out << content;
+}
+
+void appendFile( const std::string& filename, const std::string& content )
+{
+    std::ofstream out( filename.c_str(), std::ios::binary | std::ios::app );
+    out << content;
+}
+
+std::vector<char> readFile( const std::string& filename )
+{
+    std::ifstream in( filename.c_str(), std::ios::binary );
+    return std::vector<char>( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+}
+
+void writeBytes( const std::string& filename, const std::vector<char>& bytes )
+{
+    std::ofstream out( filename.c_str(), std::ios::binary | std::ios::trunc );
+    out.write( bytes.data(), bytes.size() );
+}
+
+const char* const SCENE_TEXT = "CAMERA 0 1 5  0 0 0  0 1 0  35\nOBJ sceneCacheTest.obj\n";
+
+// A quad in two materials, with a shared edge so that welding has work to do
+const char* const OBJ_TEXT =
+    "mtllib sceneCacheTest.mtl\n"
+    "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+    "usemtl red\nf 1 2 3\n"
+    "usemtl green\nf 1 3 4\n";
+
+const char* const MTL_TEXT = "newmtl red\nKd 0.8 0.1 0.1\nnewmtl green\nKd 0.1 0.8 0.1\n";
+
+void writeInputs()
+{
+    writeFile( SCENE_FILE, SCENE_TEXT );
+    writeFile( OBJ_FILE, OBJ_TEXT );
+    writeFile( MTL_FILE, MTL_TEXT );
+}
+
+void removeFiles()
+{
+    for( const std::string& f : { SCENE_FILE, OBJ_FILE, MTL_FILE, CACHE_FILE } )
+        std::remove( f.c_str() );
+}
+
+// What readSceneFile makes of the OBJ line, plus a sphere, a parallelogram and an area light
+void buildScene( SceneBuilder& scene )
+{
+    const ObjModel& model        = scene.loadObjCached( OBJ_FILE );
+    float           transform[12] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0 };
+    SceneMesh*      mesh         = scene.addInstance( OBJ_FILE, transform );
+    scene.allocate( *mesh, model.numTriangles() );
+    const float3* positions = reinterpret_cast<const float3*>( model.positions.data() );
+    for( const ObjModel::MaterialRun& run : model.runs )
+    {
+        const uint32_t material = scene.addMaterial( DIFFUSE, make_float3( 0.1f * ( run.material + 1 ), 0.2f, 0.3f ),
+                                                     make_float3( 0.0f, 0.0f, 0.0f ), make_float3( 0.0f, 0.0f, 0.0f ), 0.0f, 1.0f );
+        for( uint32_t t = run.first_triangle; t < run.first_triangle + run.num_triangles; ++t )
+        {
+            mesh->material_indices[t] = material;
+            for( int c = 0; c < 3; ++c )
+                mesh->vertices[3 * t + c] = positions[model.indices[3 * t + c]];
+        }
+    }
+
+    transform[3] = 2.0f;
+    mesh         = scene.addInstance( "sphere", transform );
+    mesh->type   = GEOMETRY_SPHERES;
+    scene.allocate( *mesh, 1 );
+    mesh->spheres[0].center   = make_float3( 0.0f, 0.5f, 0.0f );
+    mesh->spheres[0].radius   = 0.5f;
+    mesh->material_indices[0] = 0;
+
+    mesh       = scene.addInstance( "floor", transform );
+    mesh->type = GEOMETRY_PARALLELOGRAMS;
+    scene.allocate( *mesh, 1 );
+    mesh->parallelograms[0]   = make_float3( -5.0f, 0.0f, -5.0f );
+    mesh->parallelograms[1]   = make_float3( 10.0f, 0.0f, 0.0f );
+    mesh->parallelograms[2]   = make_float3( 0.0f, 0.0f, 10.0f );
+    mesh->material_indices[0] = 1;
+
+    Light light;
+    std::memset( &light, 0, sizeof( light ) );
+    light.shape    = AREA_LIGHT;
+    light.corner   = make_float3( -0.5f, 3.0f, -0.5f );
+    light.v1       = make_float3( 1.0f, 0.0f, 0.0f );
+    light.v2       = make_float3( 0.0f, 0.0f, 1.0f );
+    light.normal   = make_float3( 0.0f, -1.0f, 0.0f );
+    light.emission = make_float3( 10.0f, 10.0f, 10.0f );
+    scene.lights.push_back( light );
+    scene.releaseObjCache();
+}
+
+bool writeCache( uint64_t options )
+{
+    SceneBuilder scene;
+    buildScene( scene );
+    std::string err;
+    const bool  ok = writeSceneCache( CACHE_FILE, SCENE_FILE, options, scene, err );
+    if( !ok )
+        std::cerr << "writeSceneCache: " << err << std::endl;
+    return ok;
+}
+
+bool loads( uint64_t options, std::string* reason_out = nullptr )
+{
+    SceneBuilder scene;
+    std::string  reason;
+    const bool   ok = loadSceneCache( CACHE_FILE, SCENE_FILE, options, scene, reason );
+    if( reason_out )
+        *reason_out = reason;
+    return ok;
+}
+
+
+void testRoundTrip()
+{
+    writeInputs();
+    const uint64_t options = sceneCacheOptions( false );
+    HOST_CHECK( writeCache( options ) );
+
+    SceneBuilder scene;
+    std::string  reason;
+    HOST_CHECK( loadSceneCache( CACHE_FILE, SCENE_FILE, options, scene, reason ) );
+    HOST_CHECK( reason.empty() );
+    HOST_CHECK( scene.meshes.size() == 3 && scene.instances.size() == 3 && scene.lights.size() == 1 );
+    HOST_CHECK( scene.numMaterials() == 2 );
+    HOST_CHECK( scene.dependencies.size() == 2 );
+    if( scene.meshes.size() == 3 )
+    {
+        // The quad is stored welded: four vertices, two index triplets
+        const SceneMesh& quad = scene.meshes[0];
+        HOST_CHECK( quad.type == GEOMETRY_TRIANGLES && quad.num_primitives == 2 );
+        HOST_CHECK( quad.vertices.size() == 4 && quad.indices.size() == 2 );
+        HOST_CHECK( quad.material_indices[0] != quad.material_indices[1] );
+        HOST_CHECK( scene.meshes[1].type == GEOMETRY_SPHERES && scene.meshes[1].spheres[0].radius == 0.5f );
+        HOST_CHECK( scene.meshes[2].type == GEOMETRY_PARALLELOGRAMS && scene.meshes[2].parallelograms[1].x == 10.0f );
+        HOST_CHECK( scene.instances[1].transform[3] == 2.0f && scene.instances[1].mesh_id == 1 );
+        HOST_CHECK( scene.lights[0].emission.x == 10.0f );
+    }
+
+    // Unchanged inputs load again and again
+    HOST_CHECK( loads( options ) );
+}
+
+
+void testSceneFileEdit()
+{
+    writeInputs();
+    const uint64_t options = sceneCacheOptions( false );
+    HOST_CHECK( writeCache( options ) );
+
+    // A trailing newline is enough, and restoring the content makes the cache valid again
+    std::string reason;
+    appendFile( SCENE_FILE, "\n" );
+    HOST_CHECK( !loads( options, &reason ) );
+    HOST_CHECK( reason.find( SCENE_FILE ) != std::string::npos );
+    writeFile( SCENE_FILE, SCENE_TEXT );
+    HOST_CHECK( loads( options ) );
+
+    // A missing scene file
+    std::remove( SCENE_FILE.c_str() );
+    HOST_CHECK( !loads( options ) );
+}
+
+
+void testDependencyEdits()
+{
+    const uint64_t options = sceneCacheOptions( false );
+    std::string    reason;
+
+    // OBJ edit of the same size: a vertex moved
+    writeInputs();
+    HOST_CHECK( writeCache( options ) );
+    std::string obj = OBJ_TEXT;
+    obj[obj.find( "v 1 1 0" ) + 2] = '2';
+    writeFile( OBJ_FILE, obj );
+    HOST_CHECK( !loads( options, &reason ) );
+    HOST_CHECK( reason == OBJ_FILE + " changed" );
+
+    // MTL edit, removed MTL, removed OBJ
+    writeInputs();
+    HOST_CHECK( writeCache( options ) );
+    appendFile( MTL_FILE, "# touched\n" );
+    HOST_CHECK( !loads( options, &reason ) );
+    HOST_CHECK( reason == MTL_FILE + " changed" );
+    std::remove( MTL_FILE.c_str() );
+    HOST_CHECK( !loads( options, &reason ) );
+    HOST_CHECK( reason == MTL_FILE + " is missing" );
+    writeFile( MTL_FILE, MTL_TEXT );
+    HOST_CHECK( loads( options ) );
+    std::remove( OBJ_FILE.c_str() );
+    HOST_CHECK( !loads( options, &reason ) );
+    HOST_CHECK( reason == OBJ_FILE + " is missing" );
+}
+
+
+void testOptions()
+{
+    writeInputs();
+    HOST_CHECK( sceneCacheOptions( false ) != sceneCacheOptions( true ) );
+    HOST_CHECK( writeCache( sceneCacheOptions( false ) ) );
+    std::string reason;
+    HOST_CHECK( !loads( sceneCacheOptions( true ), &reason ) );
+    HOST_CHECK( reason == "written with different options" );
+
+    HOST_CHECK( writeCache( sceneCacheOptions( true ) ) );
+    HOST_CHECK( loads( sceneCacheOptions( true ) ) );
+    HOST_CHECK( !loads( sceneCacheOptions( false ) ) );
+}
+
+
+void testDamagedFiles()
+{
+    writeInputs();
+    const uint64_t options = sceneCacheOptions( false );
+    HOST_CHECK( writeCache( options ) );
+    const std::vector<char> good = readFile( CACHE_FILE );
+    HOST_CHECK( good.size() > sizeof( SceneCacheHeader ) );
+    std::string reason;
+
+    // Truncated anywhere: in the header, in the sections, by a single byte
+    for( size_t size : { size_t( 0 ), size_t( 16 ), sizeof( SceneCacheHeader ) - 1, sizeof( SceneCacheHeader ), good.size() / 2, good.size() - 1 } )
+    {
+        writeBytes( CACHE_FILE, std::vector<char>( good.begin(), good.begin() + size ) );
+        HOST_CHECK( !loads( options, &reason ) );
+        HOST_CHECK( reason == "truncated header" || reason == "truncated file" );
+    }
+
+    // Extended by garbage
+    std::vector<char> bytes = good;
+    bytes.push_back( 0 );
+    writeBytes( CACHE_FILE, bytes );
+    HOST_CHECK( !loads( options ) );
+
+    // Magic, version and record layout
+    SceneCacheHeader header;
+    const auto       damagedHeader = [&]( void ( *damage )( SceneCacheHeader& ) ) {
+        std::vector<char> damaged = good;
+        std::memcpy( &header, damaged.data(), sizeof( header ) );
+        damage( header );
+        std::memcpy( damaged.data(), &header, sizeof( header ) );
+        writeBytes( CACHE_FILE, damaged );
+        std::string why;
+        const bool  ok = loads( options, &why );
+        return ok ? std::string( "loaded" ) : why;
+    };
+    HOST_CHECK( damagedHeader( []( SceneCacheHeader& h ) { h.magic[0] = 'X'; } ) == "different format version" );
+    HOST_CHECK( damagedHeader( []( SceneCacheHeader& h ) { ++h.version; } ) == "different format version" );
+    HOST_CHECK( damagedHeader( []( SceneCacheHeader& h ) { h.light_bytes += 4; } ) == "different format version" );
+
+    // Section tables pointing outside the file, counts larger than the file
+    HOST_CHECK( damagedHeader( []( SceneCacheHeader& h ) { h.meshes = h.file_bytes + 64; } ) == "corrupt section table" );
+    HOST_CHECK( damagedHeader( []( SceneCacheHeader& h ) { h.num_meshes = 0x7fffffff; } ) == "corrupt section table" );
+    HOST_CHECK( damagedHeader( []( SceneCacheHeader& h ) { h.instances += 1; } ) == "corrupt section table" );  // misaligned
+    HOST_CHECK( damagedHeader( []( SceneCacheHeader& h ) { h.strings_bytes = ~0ull; } ) == "corrupt section table" );
+
+    // Fewer materials than the meshes use: caught by the per primitive index check
+    HOST_CHECK( damagedHeader( []( SceneCacheHeader& h ) { h.num_materials = 1; } ) == "corrupt mesh 0" );
+    HOST_CHECK( damagedHeader( []( SceneCacheHeader& h ) { h.num_meshes = 1; } ) == "corrupt instance table" );
+
+    // A material type outside the Material enum
+    bytes = good;
+    std::memcpy( &header, bytes.data(), sizeof( header ) );
+    const uint32_t bad_type = 99;
+    std::memcpy( bytes.data() + header.materials + offsetof( SceneCacheMaterial, type ), &bad_type, sizeof( bad_type ) );
+    writeBytes( CACHE_FILE, bytes );
+    HOST_CHECK( !loads( options, &reason ) );
+    HOST_CHECK( reason == "corrupt material table" );
+
+    // Random bytes flipped anywhere in the file: rejected, or loaded with every index in range.
+    // Flips in the vertex positions themselves are not detected, the cache has no checksum.
+    std::mt19937 rng( 5 );
+    int          loaded = 0;
+    for( int i = 0; i < 300; ++i )
+    {
+        bytes = good;
+        bytes[rng() % bytes.size()] ^= static_cast<char>( 1 << ( rng() % 8 ) );
+        writeBytes( CACHE_FILE, bytes );
+        SceneBuilder scene;
+        if( !loadSceneCache( CACHE_FILE, SCENE_FILE, options, scene, reason ) )
+            continue;
+        ++loaded;
+        for( const Instance& instance : scene.instances )
+            HOST_CHECK( instance.mesh_id < scene.meshes.size() );
+        for( const SceneMesh& mesh : scene.meshes )
+        {
+            for( size_t p = 0; p < mesh.num_primitives; ++p )
+                HOST_CHECK( mesh.material_indices[p] < scene.numMaterials() );
+            for( size_t t = 0; t < mesh.indices.size(); ++t )
+                HOST_CHECK( mesh.indices[t].x < mesh.vertices.size() && mesh.indices[t].y < mesh.vertices.size()
+                            && mesh.indices[t].z < mesh.vertices.size() );
+        }
+    }
+    HOST_CHECK( loaded < 300 );
+
+    // A missing cache
+    std::remove( CACHE_FILE.c_str() );
+    HOST_CHECK( !loads( options, &reason ) );
+    HOST_CHECK( reason == "no cache file" );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testRoundTrip();
+    testSceneFileEdit();
+    testDependencyEdits();
+    testOptions();
+    testDamagedFiles();
+    removeFiles();
+    return hostTestResult( "sceneCacheTest" );
+}
@@ -0,0 +1,203 @@
+#include "SceneDiff.h"
+
+#include "SceneCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+
+template <typename T>
+static uint64_t hashArray( const ArenaArray<T>& array, uint64_t seed )
+{
+    const uint64_t size = array.size();
+    return hashBytes( array.data(), array.size() * sizeof( T ), hashBytes( &size, sizeof( size ), seed ) );
+}
+
+
+// Hash of the triangle soup, whether the mesh holds it directly (parsed) or welded and indexed (from the
+// scene cache), so that both loads of the same geometry compare equal
+static uint64_t hashTriangles( const SceneMesh& mesh, uint64_t seed )
+{
+    const size_t   chunk         = 1024;  // triangles per hashed block, the same for both layouts
+    const uint64_t num_triangles = mesh.indices.empty() ? mesh.vertices.size() / 3 : mesh.indices.size();
+    uint64_t       hash          = hashBytes( &num_triangles, sizeof( num_triangles ), seed );
+
+    std::vector<float3> soup;
+    for( size_t first = 0; first < num_triangles; first += chunk )
+    {
+        const size_t  count = std::min<size_t>( chunk, num_triangles - first );
+        const float3* data  = mesh.vertices.data() + 3 * first;
+        if( !mesh.indices.empty() )
+        {
+            soup.resize( 3 * count );
+            for( size_t t = 0; t < count; ++t )
+            {
+                const uint3& triangle = mesh.indices[first + t];
+                soup[3 * t + 0]       = mesh.vertices[triangle.x];
+                soup[3 * t + 1]       = mesh.vertices[triangle.y];
+                soup[3 * t + 2]       = mesh.vertices[triangle.z];
+            }
+            data = soup.data();
+        }
+        hash = hashBytes( data, 3 * count * sizeof( float3 ), hash );
+    }
+    return hash;
+}
+
+
+SceneSnapshot makeSceneSnapshot( const SceneBuilder& scene, const SceneCamera& camera )
+{
+    SceneSnapshot snapshot;
+    snapshot.materials = scene.materials;
+    snapshot.textures  = scene.textures;
+    snapshot.instances = scene.instances;
+    snapshot.lights    = scene.lights;
+    snapshot.camera    = camera;
+    for( const SceneMesh& mesh : scene.meshes )
+    {
+        SceneMeshSnapshot mesh_snapshot;
+        mesh_snapshot.name           = mesh.name;
+        mesh_snapshot.type           = mesh.type;
+        mesh_snapshot.dynamic        = mesh.dynamic;
+        mesh_snapshot.num_primitives = mesh.num_primitives;
+
+        uint64_t hash = hashTriangles( mesh, 0 );
+        hash          = hashArray( mesh.spheres, hash );
+        hash          = hashArray( mesh.parallelograms, hash );
+        hash          = hashArray( mesh.material_indices, hash );
+        hash          = hashArray( mesh.texcoords, hash );
+        mesh_snapshot.content_hash = hash;
+        snapshot.meshes.push_back( mesh_snapshot );
+    }
+    return snapshot;
+}
+
+
+static bool operator==( const float3& a, const float3& b )
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+
+// Texture ids are compared by path, the ids of two loads of a scene need not agree
+static bool sameTexture( const SceneSnapshot& a, int32_t a_texture, const SceneSnapshot& b, int32_t b_texture )
+{
+    if( a_texture < 0 || b_texture < 0 )
+        return a_texture == b_texture;
+    return a.textures[a_texture] == b.textures[b_texture];
+}
+
+
+static bool sameMaterial( const SceneSnapshot& from, const SceneSnapshot& to, uint32_t i )
+{
+    const MaterialTable& a = from.materials;
+    const MaterialTable& b = to.materials;
+    return a.types[i] == b.types[i] && a.diffuse[i] == b.diffuse[i] && a.specular[i] == b.specular[i]
+           && a.emission[i] == b.emission[i] && a.spec_exp[i] == b.spec_exp[i] && a.ior[i] == b.ior[i]
+           && sameTexture( from, a.diffuse_texture[i], to, b.diffuse_texture[i] )
+           && sameTexture( from, a.specular_texture[i], to, b.specular_texture[i] );
+}
+
+
+static bool sameLight( const Light& a, const Light& b )
+{
+    return a.shape == b.shape && a.corner == b.corner && a.v1 == b.v1 && a.v2 == b.v2 && a.normal == b.normal
+           && a.emission == b.emission && a.width == b.width && a.falloff_start == b.falloff_start;
+}
+
+
+static bool sameMesh( const SceneMeshSnapshot& a, const SceneMeshSnapshot& b )
+{
+    return a.type == b.type && a.dynamic == b.dynamic && a.num_primitives == b.num_primitives && a.content_hash == b.content_hash;
+}
+
+
+SceneDiff diffScenes( const SceneSnapshot& from, const SceneSnapshot& to )
+{
+    SceneDiff diff;
+
+    diff.materials_resized = from.materials.size() != to.materials.size();
+    if( !diff.materials_resized )
+        for( uint32_t i = 0; i < to.materials.size(); ++i )
+            if( !sameMaterial( from, to, i ) )
+                diff.changed_materials.push_back( i );
+
+    // Mesh keys are unique within a scene, each old mesh is kept at most once
+    std::map<std::string, uint32_t> old_meshes;
+    for( uint32_t i = 0; i < from.meshes.size(); ++i )
+        old_meshes.insert( std::make_pair( from.meshes[i].name, i ) );
+    std::vector<bool> kept( from.meshes.size(), false );
+    diff.mesh_sources.assign( to.meshes.size(), NEW_MESH );
+    for( uint32_t i = 0; i < to.meshes.size(); ++i )
+    {
+        const auto match = old_meshes.find( to.meshes[i].name );
+        if( match == old_meshes.end() || kept[match->second]
+            || !sameMesh( from.meshes[match->second], to.meshes[i] ) )
+            continue;
+        diff.mesh_sources[i] = match->second;
+        kept[match->second]  = true;
+    }
+    for( uint32_t i = 0; i < from.meshes.size(); ++i )
+        if( !kept[i] )
+            diff.removed_meshes.push_back( i );
+
+    // Instances address meshes by index, so a mesh that moved or was built changes the IAS as well
+    diff.instances_changed = from.instances.size() != to.instances.size() || !diff.removed_meshes.empty()
+                             || from.meshes.size() != to.meshes.size();
+    for( uint32_t i = 0; i < to.meshes.size() && !diff.instances_changed; ++i )
+        diff.instances_changed = diff.mesh_sources[i] != i;
+    for( size_t i = 0; i < to.instances.size() && !diff.instances_changed; ++i )
+        diff.instances_changed = from.instances[i].mesh_id != to.instances[i].mesh_id
+                                 || std::memcmp( from.instances[i].transform, to.instances[i].transform,
+                                                 sizeof( to.instances[i].transform ) ) != 0;
+
+    diff.lights_changed = from.lights.size() != to.lights.size();
+    for( size_t i = 0; i < to.lights.size() && !diff.lights_changed; ++i )
+        diff.lights_changed = !sameLight( from.lights[i], to.lights[i] );
+
+    diff.camera_changed = !( from.camera.eye == to.camera.eye ) || !( from.camera.lookat == to.camera.lookat )
+                          || !( from.camera.up == to.camera.up ) || from.camera.fovy != to.camera.fovy;
+    diff.resolution_changed = from.camera.width != to.camera.width || from.camera.height != to.camera.height;
+    return diff;
+}
+
+
+size_t SceneDiff::numBuiltMeshes() const
+{
+    size_t built = 0;
+    for( uint32_t source : mesh_sources )
+        built += source == NEW_MESH;
+    return built;
+}
+
+
+bool SceneDiff::empty() const
+{
+    return changed_materials.empty() && !materials_resized && !instances_changed && numBuiltMeshes() == 0
+           && removed_meshes.empty() && !lights_changed && !camera_changed && !resolution_changed;
+}
+
+
+std::string describeSceneDiff( const SceneDiff& diff, size_t num_meshes )
+{
+    std::string text;
+    const auto  item = [&text]( const std::string& s ) { text += ( text.empty() ? "" : ", " ) + s; };
+    if( diff.materials_resized )
+        item( "material count" );
+    else if( !diff.changed_materials.empty() )
+        item( std::to_string( diff.changed_materials.size() ) + ( diff.changed_materials.size() == 1 ? " material" : " materials" ) );
+    if( diff.numBuiltMeshes() > 0 )
+        item( std::to_string( diff.numBuiltMeshes() ) + " of " + std::to_string( num_meshes ) + " meshes built" );
+    if( !diff.removed_meshes.empty() )
+        item( std::to_string( diff.removed_meshes.size() ) + " old GAS freed" );
+    if( diff.instances_changed )
+        item( "instances" );
+    if( diff.lights_changed )
+        item( "lights" );
+    if( diff.camera_changed )
+        item( "camera" );
+    if( diff.resolution_changed )
+        item( "resolution (needs a restart)" );
+    return text.empty() ? "no changes" : text;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "SceneBuilder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+*   Structural diff of two loaded scenes, for reloading an edited scene file while the sample runs.
+*
+*   The host geometry of a scene is released once its GAS are built, so a SceneSnapshot keeps what a
+*   newly parsed scene is compared against: the material table, a content hash per mesh, the
+*   instances, the lights and the camera. diffScenes() reduces two snapshots to the device updates
+*   that bring the running scene up to date:
+*
+*   - material records that changed are rewritten in place in the SBT. A different material count
+*     resizes the SBT and rebuilds every GAS, as each build input has one SBT record per material.
+*   - meshes are matched by their key (SceneMesh::name) and content hash. A matched mesh keeps its
+*     GAS, every other mesh is built, and old meshes without a match are freed.
+*   - the IAS is rebuilt when an instance changed or any mesh was built, removed or moved.
+*   - the light buffer is uploaded again when any light changed.
+*
+*   Nothing here depends on CUDA or OptiX, so the matching rules can be exercised on the host.
+*/
+
+struct SceneCamera
+{
+    float3 eye    = {};
+    float3 lookat = {};
+    float3 up     = {};
+    float  fovy   = 0.f;
+    int    width  = 0;
+    int    height = 0;
+};
+
+
+struct SceneMeshSnapshot
+{
+    std::string  name;
+    GeometryType type           = GEOMETRY_TRIANGLES;
+    bool         dynamic        = false;
+    size_t       num_primitives = 0;
+    uint64_t     content_hash   = 0;  // primitives, material indices and texture coordinates
+};
+
+
+struct SceneSnapshot
+{
+    MaterialTable                  materials;
+    std::vector<std::string>       textures;  // paths of the texture ids in materials
+    std::vector<SceneMeshSnapshot> meshes;
+    std::vector<Instance>          instances;
+    std::vector<Light>             lights;
+    SceneCamera                    camera;
+};
+
+
+// Snapshot of a scene whose meshes still hold their host geometry, i.e. before takeGeometry()
+SceneSnapshot makeSceneSnapshot( const SceneBuilder& scene, const SceneCamera& camera );
+
+
+static const uint32_t NEW_MESH = ~0u;
+
+struct SceneDiff
+{
+    std::vector<uint32_t> changed_materials;           // ids whose record differs, if the count stayed the same
+    bool                  materials_resized  = false;  // the material table is uploaded again
+    std::vector<uint32_t> mesh_sources;                // per new mesh: the old mesh whose GAS it keeps, or NEW_MESH
+    std::vector<uint32_t> removed_meshes;              // old meshes no new mesh keeps
+    bool                  instances_changed  = false;  // the IAS is rebuilt
+    bool                  lights_changed     = false;
+    bool                  camera_changed     = false;  // eye, lookat, up or field of view
+    bool                  resolution_changed = false;  // not applied while running
+
+    size_t numBuiltMeshes() const;
+    bool   empty() const;
+};
+
+SceneDiff diffScenes( const SceneSnapshot& from, const SceneSnapshot& to );
+
+// Short summary for the log, e.g. "1 material, 2 of 7 meshes built, lights"
+std::string describeSceneDiff( const SceneDiff& diff, size_t num_meshes );
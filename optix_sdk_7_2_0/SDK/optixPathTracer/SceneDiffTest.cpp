@@ -0,0 +1,318 @@
+//
+// sceneDiffTest - host tests of diffScenes() in SceneDiff.h on pairs of snapshots: material edits and
+// resizes, meshes that moved, changed, were removed or added, instance, light and camera edits, and
+// the empty diff of a scene compared with itself or with its scene cache load.
+//
+
+#include "SceneDiff.h"
+#include "HostTest.h"
+
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+// What a test changes of the sample scene before it is snapshot
+struct SceneSpec
+{
+    std::vector<std::string> meshes        = { "quad", "sphere", "floor" };  // in the order they are added
+    float                    sphere_radius = 1.0f;
+    uint32_t                 quad_material = 1;
+    bool                     indexed_quad  = false;  // welded and indexed like a scene cache load
+};
+
+
+// The quad as a triangle soup and welded
+const float3 QUAD_SOUP[6] = { { 0.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, { 1.f, 1.f, 0.f },
+                              { 0.f, 0.f, 0.f }, { 1.f, 1.f, 0.f }, { 0.f, 1.f, 0.f } };
+float3     QUAD_WELDED[4]  = { { 0.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, { 1.f, 1.f, 0.f }, { 0.f, 1.f, 0.f } };
+uint3      QUAD_INDICES[2] = { { 0, 1, 2 }, { 0, 2, 3 } };
+
+
+void translation( float transform[12], float x )
+{
+    const float identity[12] = { 1.f, 0.f, 0.f, x, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f };
+    std::memcpy( transform, identity, sizeof( identity ) );
+}
+
+
+// Three materials, the second one textured, a quad, a sphere and a floor parallelogram with one instance
+// each, and an area light
+SceneSnapshot snapshot( const SceneSpec& spec = SceneSpec() )
+{
+    SceneBuilder scene;
+    const float3 white = make_float3( 0.8f, 0.8f, 0.8f ), black = make_float3( 0.f, 0.f, 0.f );
+    scene.addMaterial( DIFFUSE, white, black, black, 0.f, 1.f );
+    scene.addMaterial( DIFFUSE, make_float3( 0.8f, 0.1f, 0.1f ), black, black, 0.f, 1.f, scene.addTexture( "wood.png" ) );
+    scene.addMaterial( GLOSSY, white, white, black, 50.f, 1.5f );
+
+    for( size_t i = 0; i < spec.meshes.size(); ++i )
+    {
+        float transform[12];
+        translation( transform, 3.0f * i );
+        SceneMesh* mesh = scene.addInstance( spec.meshes[i], transform );
+        if( spec.meshes[i] == "quad" )
+        {
+            mesh->type = GEOMETRY_TRIANGLES;
+            scene.allocate( *mesh, 2 );
+            std::copy( QUAD_SOUP, QUAD_SOUP + 6, mesh->vertices.begin() );
+            if( spec.indexed_quad )
+            {
+                mesh->vertices = ArenaArray<float3>( QUAD_WELDED, 4 );
+                mesh->indices  = ArenaArray<uint3>( QUAD_INDICES, 2 );
+            }
+            mesh->material_indices[0] = mesh->material_indices[1] = spec.quad_material;
+        }
+        else if( spec.meshes[i] == "sphere" )
+        {
+            mesh->type = GEOMETRY_SPHERES;
+            scene.allocate( *mesh, 1 );
+            mesh->spheres[0].center   = make_float3( 0.f, 1.f, 0.f );
+            mesh->spheres[0].radius   = spec.sphere_radius;
+            mesh->material_indices[0] = 2;
+        }
+        else
+        {
+            mesh->type = GEOMETRY_PARALLELOGRAMS;
+            scene.allocate( *mesh, 1 );
+            mesh->parallelograms[0]   = make_float3( -5.f, 0.f, -5.f );
+            mesh->parallelograms[1]   = make_float3( 10.f, 0.f, 0.f );
+            mesh->parallelograms[2]   = make_float3( 0.f, 0.f, 10.f );
+            mesh->material_indices[0] = 0;
+        }
+    }
+
+    Light light;
+    light.shape         = AREA_LIGHT;
+    light.corner        = make_float3( -1.f, 5.f, -1.f );
+    light.v1            = make_float3( 2.f, 0.f, 0.f );
+    light.v2            = make_float3( 0.f, 0.f, 2.f );
+    light.normal        = make_float3( 0.f, -1.f, 0.f );
+    light.emission      = make_float3( 15.f, 15.f, 15.f );
+    light.width         = 0.f;
+    light.falloff_start = 0.f;
+    scene.lights.push_back( light );
+
+    SceneCamera camera;
+    camera.eye    = make_float3( 0.f, 2.f, 10.f );
+    camera.lookat = make_float3( 0.f, 1.f, 0.f );
+    camera.up     = make_float3( 0.f, 1.f, 0.f );
+    camera.fovy   = 35.f;
+    camera.width  = 768;
+    camera.height = 768;
+    return makeSceneSnapshot( scene, camera );
+}
+
+
+bool keepsAllMeshes( const SceneDiff& diff, size_t num_meshes )
+{
+    if( diff.mesh_sources.size() != num_meshes || !diff.removed_meshes.empty() )
+        return false;
+    for( uint32_t i = 0; i < num_meshes; ++i )
+        if( diff.mesh_sources[i] != i )
+            return false;
+    return true;
+}
+
+
+void testEmptyDiff()
+{
+    const SceneDiff same = diffScenes( snapshot(), snapshot() );
+    HOST_CHECK( same.empty() );
+    HOST_CHECK( keepsAllMeshes( same, 3 ) && same.numBuiltMeshes() == 0 );
+    HOST_CHECK( describeSceneDiff( same, 3 ) == "no changes" );
+
+    // The scene cache holds triangle meshes welded and indexed, a parsed scene holds the soup
+    SceneSpec indexed;
+    indexed.indexed_quad = true;
+    HOST_CHECK( diffScenes( snapshot(), snapshot( indexed ) ).empty() );
+    HOST_CHECK( diffScenes( snapshot( indexed ), snapshot() ).empty() );
+
+    // Empty scenes
+    HOST_CHECK( diffScenes( SceneSnapshot(), SceneSnapshot() ).empty() );
+}
+
+
+void testMaterials()
+{
+    const SceneSnapshot from = snapshot();
+
+    // An edited record is rewritten in place, nothing else changes
+    SceneSnapshot to = from;
+    to.materials.diffuse[1].y = 0.5f;
+    to.materials.spec_exp[2]  = 60.f;
+    SceneDiff diff            = diffScenes( from, to );
+    HOST_CHECK( diff.changed_materials == std::vector<uint32_t>( { 1, 2 } ) && !diff.materials_resized );
+    HOST_CHECK( keepsAllMeshes( diff, 3 ) && !diff.instances_changed && !diff.lights_changed && !diff.camera_changed );
+    HOST_CHECK( describeSceneDiff( diff, 3 ) == "2 materials" );
+
+    // Texture ids are compared by path: renumbered ids are no change, another path is
+    to                              = from;
+    to.textures                     = { "stone.png", "wood.png" };
+    to.materials.diffuse_texture[1] = 1;
+    HOST_CHECK( diffScenes( from, to ).empty() );
+    to.materials.diffuse_texture[1] = 0;
+    diff                            = diffScenes( from, to );
+    HOST_CHECK( diff.changed_materials == std::vector<uint32_t>( { 1 } ) );
+    to.materials.diffuse_texture[1] = -1;
+    HOST_CHECK( diffScenes( from, to ).changed_materials == std::vector<uint32_t>( { 1 } ) );
+    to                    = from;
+    to.materials.types[0] = MIRROR;
+    HOST_CHECK( diffScenes( from, to ).changed_materials == std::vector<uint32_t>( { 0 } ) );
+
+    // Another material count resizes the table instead of listing records
+    to = from;
+    to.materials.types.push_back( DIFFUSE );
+    to.materials.diffuse.push_back( make_float3( 1.f, 1.f, 1.f ) );
+    to.materials.specular.push_back( make_float3( 0.f, 0.f, 0.f ) );
+    to.materials.emission.push_back( make_float3( 0.f, 0.f, 0.f ) );
+    to.materials.spec_exp.push_back( 0.f );
+    to.materials.ior.push_back( 1.f );
+    to.materials.diffuse_texture.push_back( -1 );
+    to.materials.specular_texture.push_back( -1 );
+    to.materials.diffuse[0].x = 0.1f;
+    diff                      = diffScenes( from, to );
+    HOST_CHECK( diff.materials_resized && diff.changed_materials.empty() && !diff.empty() );
+    HOST_CHECK( keepsAllMeshes( diff, 3 ) && !diff.instances_changed );
+    HOST_CHECK( describeSceneDiff( diff, 3 ) == "material count" );
+    HOST_CHECK( diffScenes( to, from ).materials_resized );
+}
+
+
+void testMeshReorder()
+{
+    // The same meshes added in another order keep their GAS; the instances address them by index
+    SceneSpec reordered;
+    reordered.meshes     = { "sphere", "floor", "quad" };
+    const SceneDiff diff = diffScenes( snapshot(), snapshot( reordered ) );
+    HOST_CHECK( diff.mesh_sources == std::vector<uint32_t>( { 1, 2, 0 } ) );
+    HOST_CHECK( diff.removed_meshes.empty() && diff.numBuiltMeshes() == 0 );
+    HOST_CHECK( diff.instances_changed && diff.changed_materials.empty() && !diff.lights_changed );
+    HOST_CHECK( describeSceneDiff( diff, 3 ) == "instances" );
+}
+
+
+void testChangedAndRemovedMeshes()
+{
+    const SceneSnapshot from = snapshot();
+
+    // Changed primitives or material indices build the mesh again and free the old GAS
+    SceneSpec bigger;
+    bigger.sphere_radius = 2.0f;
+    SceneDiff diff       = diffScenes( from, snapshot( bigger ) );
+    HOST_CHECK( diff.mesh_sources == std::vector<uint32_t>( { 0, NEW_MESH, 2 } ) );
+    HOST_CHECK( diff.removed_meshes == std::vector<uint32_t>( { 1 } ) && diff.numBuiltMeshes() == 1 );
+    HOST_CHECK( diff.instances_changed );
+    HOST_CHECK( describeSceneDiff( diff, 3 ) == "1 of 3 meshes built, 1 old GAS freed, instances" );
+
+    SceneSpec recolored;
+    recolored.quad_material = 2;
+    diff                    = diffScenes( from, snapshot( recolored ) );
+    HOST_CHECK( diff.mesh_sources == std::vector<uint32_t>( { NEW_MESH, 1, 2 } ) && diff.removed_meshes == std::vector<uint32_t>( { 0 } ) );
+
+    // A dynamic mesh with the same content is built again as well
+    SceneSnapshot dynamic     = from;
+    dynamic.meshes[2].dynamic = true;
+    HOST_CHECK( diffScenes( from, dynamic ).mesh_sources[2] == NEW_MESH );
+
+    // A removed mesh is freed and the meshes after it move
+    SceneSpec removed;
+    removed.meshes = { "quad", "floor" };
+    diff           = diffScenes( from, snapshot( removed ) );
+    HOST_CHECK( diff.mesh_sources == std::vector<uint32_t>( { 0, 2 } ) );
+    HOST_CHECK( diff.removed_meshes == std::vector<uint32_t>( { 1 } ) && diff.numBuiltMeshes() == 0 );
+    HOST_CHECK( diff.instances_changed );
+
+    // A removed last mesh still changes the IAS though no kept mesh moved
+    SceneSpec last_removed;
+    last_removed.meshes = { "quad", "sphere" };
+    diff                = diffScenes( from, snapshot( last_removed ) );
+    HOST_CHECK( diff.mesh_sources == std::vector<uint32_t>( { 0, 1 } ) && diff.removed_meshes == std::vector<uint32_t>( { 2 } ) );
+    HOST_CHECK( diff.instances_changed );
+
+    // An added mesh is built, nothing is freed
+    diff = diffScenes( snapshot( last_removed ), from );
+    HOST_CHECK( diff.mesh_sources == std::vector<uint32_t>( { 0, 1, NEW_MESH } ) && diff.removed_meshes.empty() );
+    HOST_CHECK( diff.numBuiltMeshes() == 1 && diff.instances_changed );
+
+    // An old mesh is kept at most once, a second mesh with its key and content is built
+    SceneSnapshot twice = from;
+    twice.meshes[1]     = twice.meshes[0];
+    diff                = diffScenes( from, twice );
+    HOST_CHECK( diff.mesh_sources == std::vector<uint32_t>( { 0, NEW_MESH, 2 } ) && diff.removed_meshes == std::vector<uint32_t>( { 1 } ) );
+
+    // Everything replaced
+    SceneSnapshot renamed = from;
+    for( SceneMeshSnapshot& mesh : renamed.meshes )
+        mesh.name += " v2";
+    diff = diffScenes( from, renamed );
+    HOST_CHECK( diff.numBuiltMeshes() == 3 && diff.removed_meshes.size() == 3 );
+}
+
+
+void testInstancesLightsAndCamera()
+{
+    const SceneSnapshot from = snapshot();
+
+    // A moved or retargeted instance rebuilds the IAS only
+    SceneSnapshot to             = from;
+    to.instances[1].transform[7] = 0.5f;
+    SceneDiff diff               = diffScenes( from, to );
+    HOST_CHECK( diff.instances_changed && keepsAllMeshes( diff, 3 ) && diff.numBuiltMeshes() == 0 );
+    HOST_CHECK( diff.changed_materials.empty() && !diff.lights_changed && !diff.camera_changed );
+    to                      = from;
+    to.instances[2].mesh_id = 0;
+    HOST_CHECK( diffScenes( from, to ).instances_changed );
+    to = from;
+    to.instances.push_back( from.instances[0] );
+    HOST_CHECK( diffScenes( from, to ).instances_changed );
+
+    // Light edits upload the light buffer only
+    to                      = from;
+    to.lights[0].emission.x = 20.f;
+    diff                    = diffScenes( from, to );
+    HOST_CHECK( diff.lights_changed && !diff.instances_changed && diff.changed_materials.empty() && keepsAllMeshes( diff, 3 ) );
+    HOST_CHECK( describeSceneDiff( diff, 3 ) == "lights" );
+    to                 = from;
+    to.lights[0].shape = POINT_LIGHT;
+    HOST_CHECK( diffScenes( from, to ).lights_changed );
+    to.lights.clear();
+    HOST_CHECK( diffScenes( from, to ).lights_changed );
+
+    // Camera only
+    to            = from;
+    to.camera.eye = make_float3( 1.f, 2.f, 10.f );
+    diff          = diffScenes( from, to );
+    HOST_CHECK( diff.camera_changed && !diff.resolution_changed && !diff.instances_changed && !diff.lights_changed );
+    HOST_CHECK( diff.changed_materials.empty() && keepsAllMeshes( diff, 3 ) );
+    HOST_CHECK( describeSceneDiff( diff, 3 ) == "camera" );
+    to             = from;
+    to.camera.fovy = 40.f;
+    HOST_CHECK( diffScenes( from, to ).camera_changed );
+    to           = from;
+    to.camera.up = make_float3( 0.f, 0.f, 1.f );
+    HOST_CHECK( diffScenes( from, to ).camera_changed );
+
+    // The resolution is reported separately, it needs a restart
+    to              = from;
+    to.camera.width = 1024;
+    diff            = diffScenes( from, to );
+    HOST_CHECK( diff.resolution_changed && !diff.camera_changed && !diff.empty() );
+    HOST_CHECK( describeSceneDiff( diff, 3 ) == "resolution (needs a restart)" );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testEmptyDiff();
+    testMaterials();
+    testMeshReorder();
+    testChangedAndRemovedMeshes();
+    testInstancesLightsAndCamera();
+    return hostTestResult( "sceneDiffTest" );
+}
@@ -0,0 +1,344 @@
+//
+// sceneEditLoadTest - drives optixPathTracer --edit-port with a scripted stream of scene edits and reports
+// the edit throughput, the latency from sending an edit to its acknowledgement and how many edits the
+// renderer applied per frame.
+//
+// The script adds a set of objects in a few groups, then for the given duration mostly moves them along
+// orbits, with some objects removed and added again, groups turned (which moves all their objects),
+// material colors changed and, with --light, one point or spot light replaced by an orbiting point light.
+// The objects and groups are removed again at the end.
+//
+// Protocol: see SceneEditProtocol.h.
+//
+
+#include "SceneEditProtocol.h"
+#include "TcpSocket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// Geom and Material values of optixPathTracer.h, which the tool does not include
+static const uint32_t SHAPE_CUBE        = 0;
+static const uint32_t SHAPE_ICOSPHERE   = 1;
+static const uint32_t SHAPE_POINT_LIGHT = 4;
+static const uint32_t MATERIAL_DIFFUSE  = 0;
+
+
+void printUsageAndExit( const char* argv0 )
+{
+    std::cerr << "Usage  : " << argv0 << " [options]\n";
+    std::cerr << "Options: --host <name>              Renderer host (default localhost)\n";
+    std::cerr << "         --port <port>              Renderer --edit-port (default 27016)\n";
+    std::cerr << "         --rate <edits per second>  Edits to send per second (default 5000)\n";
+    std::cerr << "         --duration <seconds>       Length of the test (default 10)\n";
+    std::cerr << "         --objects <n>              Objects to add and move (default 64)\n";
+    std::cerr << "         --groups <n>               Groups the objects are placed in (default 8)\n";
+    std::cerr << "         --first-id <id>            Object id of the first added object, groups follow the objects (default 1000000)\n";
+    std::cerr << "         --material <id>            Material of the added objects, also recolored (default 0)\n";
+    std::cerr << "         --light <index>            Point or spot light to replace by an orbiting point light (default none)\n";
+    exit( 0 );
+}
+
+
+// Row-major 3x4 transform of a uniformly scaled, unrotated object at p
+static void translation( float3 p, float scale, float transform[12] )
+{
+    const float m[12] = { scale, 0.f, 0.f, p.x, 0.f, scale, 0.f, p.y, 0.f, 0.f, scale, p.z };
+    std::copy( m, m + 12, transform );
+}
+
+
+// Row-major 3x4 rotation about y by angle
+static void rotationY( float angle, float transform[12] )
+{
+    const float c = std::cos( angle ), s = std::sin( angle );
+    const float m[12] = { c, 0.f, s, 0.f, 0.f, 1.f, 0.f, 0.f, -s, 0.f, c, 0.f };
+    std::copy( m, m + 12, transform );
+}
+
+
+// Position of object i at time t on one of several stacked orbits around the origin
+static float3 orbit( uint32_t i, uint32_t count, float t )
+{
+    const float phase = 6.2831853f * i / count;
+    const float ring  = 100.f + 40.f * ( i % 4 );
+    const float3 p     = { ring * std::cos( phase + t * 0.5f ), 60.f + 30.f * ( i % 5 ), ring * std::sin( phase + t * 0.5f ) };
+    return p;
+}
+
+
+int main( int argc, char* argv[] )
+{
+    std::string host     = "localhost";
+    uint16_t    port     = 27016;
+    double      rate     = 5000.0;
+    double      duration = 10.0;
+    uint32_t    objects  = 64;
+    uint32_t    groups   = 8;
+    uint64_t    first_id = 1000000;
+    uint32_t    material = 0;
+    int64_t     light    = -1;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+            printUsageAndExit( argv[0] );
+        else if( arg == "--host" && i + 1 < argc )
+            host = argv[++i];
+        else if( arg == "--port" && i + 1 < argc )
+            port = static_cast<uint16_t>( atoi( argv[++i] ) );
+        else if( arg == "--rate" && i + 1 < argc )
+            rate = std::max( 1.0, atof( argv[++i] ) );
+        else if( arg == "--duration" && i + 1 < argc )
+            duration = std::max( 0.0, atof( argv[++i] ) );
+        else if( arg == "--objects" && i + 1 < argc )
+            objects = static_cast<uint32_t>( std::max( 1, atoi( argv[++i] ) ) );
+        else if( arg == "--groups" && i + 1 < argc )
+            groups = static_cast<uint32_t>( std::max( 1, atoi( argv[++i] ) ) );
+        else if( arg == "--first-id" && i + 1 < argc )
+            first_id = strtoull( argv[++i], nullptr, 10 );
+        else if( arg == "--material" && i + 1 < argc )
+            material = static_cast<uint32_t>( atoi( argv[++i] ) );
+        else if( arg == "--light" && i + 1 < argc )
+            light = atoi( argv[++i] );
+        else
+        {
+            std::cerr << "Unknown option '" << arg << "'\n";
+            printUsageAndExit( argv[0] );
+        }
+    }
+
+    TcpSocket socket = TcpSocket::connect( host, port );
+    if( !socket.valid() )
+    {
+        std::cerr << "Cannot connect to " << host << ":" << port << std::endl;
+        return 1;
+    }
+
+    // Send times by sequence number, matched against acknowledgements by the reader thread
+    std::mutex                            mutex;
+    std::map<uint32_t, Clock::time_point> in_flight;
+    std::vector<double>                   latencies_ms;
+    std::set<uint64_t>                    frames;
+    size_t                                failed = 0;
+    bool                                  done   = false;
+
+    std::thread reader( [&]() {
+        for( ;; )
+        {
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+                if( done )
+                    return;
+            }
+            if( !socket.waitReadable( 100 ) )
+                continue;
+            SceneEditAck ack;
+            if( !socket.receiveAll( &ack, sizeof( ack ) ) || ack.magic != SCENE_EDIT_ACK_MAGIC )
+                return;
+
+            const Clock::time_point     now = Clock::now();
+            std::lock_guard<std::mutex> lock( mutex );
+            auto sent = in_flight.find( ack.sequence );
+            if( sent == in_flight.end() )
+                continue;
+            latencies_ms.push_back( std::chrono::duration<double, std::milli>( now - sent->second ).count() );
+            frames.insert( ack.frame );
+            failed += ack.status != SCENE_EDIT_OK;
+            in_flight.erase( sent );
+        }
+    } );
+
+
+    // Edits are collected per batch and sent in one write, their send times are recorded just before
+    uint32_t                   sequence = 0;
+    std::vector<uint32_t>      batch_sequences;
+    std::vector<unsigned char> batch;
+    bool                       connected = true;
+    const auto queue = [&]( SceneEdit& edit ) {
+        edit.sequence = sequence++;
+        batch_sequences.push_back( edit.sequence );
+        encodeSceneEdit( edit, batch );
+    };
+    const auto flush = [&]() {
+        if( batch.empty() || !connected )
+            return;
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            const Clock::time_point     now = Clock::now();
+            for( uint32_t s : batch_sequences )
+                in_flight[s] = now;
+        }
+        if( !socket.sendAll( batch.data(), batch.size() ) )
+        {
+            std::cerr << "Connection lost" << std::endl;
+            connected = false;
+        }
+        batch.clear();
+        batch_sequences.clear();
+    };
+
+    std::mt19937                          rng( 1234 );
+    std::uniform_real_distribution<float> uniform( 0.f, 1.f );
+    std::vector<bool>                     present( objects, true );
+    const auto addObject = [&]( uint32_t i, float t ) {
+        SceneEdit edit;
+        edit.type              = SCENE_EDIT_ADD_GEOMETRY;
+        edit.id                = first_id + i;
+        edit.geometry.shape    = i % 2 ? SHAPE_ICOSPHERE : SHAPE_CUBE;
+        edit.geometry.material = material;
+        translation( orbit( i, objects, t ), 10.f, edit.geometry.transform );
+        queue( edit );
+        present[i] = true;
+
+        SceneEdit parent;
+        parent.type   = SCENE_EDIT_SET_PARENT;
+        parent.id     = first_id + i;
+        parent.parent = first_id + objects + i % groups;
+        queue( parent );
+    };
+    const auto removeObject = [&]( uint32_t i ) {
+        SceneEdit edit;
+        edit.type = SCENE_EDIT_REMOVE_GEOMETRY;
+        edit.id   = first_id + i;
+        queue( edit );
+        present[i] = false;
+    };
+
+    std::cout << "Sending " << rate << " edits per second for " << duration << " s to " << host << ":" << port << std::endl;
+    for( uint32_t g = 0; g < groups; ++g )
+    {
+        SceneEdit edit;
+        edit.type = SCENE_EDIT_ADD_GROUP;
+        edit.id   = first_id + objects + g;
+        rotationY( 0.f, edit.transform );
+        queue( edit );
+    }
+    for( uint32_t i = 0; i < objects; ++i )
+        addObject( i, 0.f );
+    flush();
+
+    // Edits that are due by now go out together, every millisecond
+    const Clock::time_point start = Clock::now();
+    const size_t            total = static_cast<size_t>( rate * duration );
+    size_t                  sent  = 0;
+    while( sent < total && connected )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        const double t   = std::chrono::duration<double>( Clock::now() - start ).count();
+        const size_t due = std::min( total, static_cast<size_t>( t * rate ) );
+        for( ; sent < due; ++sent )
+        {
+            const float    r = uniform( rng );
+            const uint32_t i = static_cast<uint32_t>( rng() % objects );
+            SceneEdit      edit;
+            if( r < 0.05f )
+            {
+                // Churn: an object disappears and comes back
+                if( present[i] )
+                    removeObject( i );
+                else
+                    addObject( i, static_cast<float>( t ) );
+            }
+            else if( r < 0.10f )
+            {
+                edit.type              = SCENE_EDIT_SET_MATERIAL;
+                edit.id                = material;
+                edit.material.type     = MATERIAL_DIFFUSE;
+                edit.material.diffuse  = { uniform( rng ), uniform( rng ), uniform( rng ) };
+                queue( edit );
+            }
+            else if( r < 0.15f )
+            {
+                edit.type = SCENE_EDIT_SET_TRANSFORM;
+                edit.id   = first_id + objects + i % groups;
+                rotationY( static_cast<float>( t ) * ( 1.f + i % groups ), edit.transform );
+                queue( edit );
+            }
+            else if( r < 0.20f && light >= 0 )
+            {
+                const float3 p          = orbit( i, objects, static_cast<float>( t ) );
+                edit.type               = SCENE_EDIT_SET_LIGHT;
+                edit.id                 = static_cast<uint64_t>( light );
+                edit.light.shape        = SHAPE_POINT_LIGHT;
+                edit.light.corner       = p;
+                edit.light.v1           = p;
+                edit.light.v2           = p;
+                edit.light.emission     = { 20.f, 20.f, 20.f };
+                queue( edit );
+            }
+            else if( present[i] )
+            {
+                edit.type = SCENE_EDIT_SET_TRANSFORM;
+                edit.id   = first_id + i;
+                translation( orbit( i, objects, static_cast<float>( t ) ), 10.f, edit.transform );
+                queue( edit );
+            }
+            else
+            {
+                addObject( i, static_cast<float>( t ) );
+            }
+        }
+        flush();
+    }
+    const double send_seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+
+    for( uint32_t i = 0; i < objects; ++i )
+        if( present[i] )
+            removeObject( i );
+    for( uint32_t g = 0; g < groups; ++g )
+    {
+        SceneEdit edit;
+        edit.type = SCENE_EDIT_REMOVE_GEOMETRY;
+        edit.id   = first_id + objects + g;
+        queue( edit );
+    }
+    flush();
+
+    // Give the renderer a few seconds to acknowledge what is still in flight
+    const Clock::time_point deadline = Clock::now() + std::chrono::seconds( 5 );
+    for( ;; )
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            if( in_flight.empty() || Clock::now() > deadline )
+            {
+                done = true;
+                break;
+            }
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+    reader.join();
+
+    std::cout << "Sent " << sequence << " edits in " << std::fixed << std::setprecision( 2 ) << send_seconds << " s ("
+              << sequence / std::max( send_seconds, 1e-3 ) << " per second), " << latencies_ms.size() << " acknowledged ("
+              << failed << " not applied), " << in_flight.size() << " unacknowledged" << std::endl;
+    if( latencies_ms.empty() )
+        return 1;
+
+    std::sort( latencies_ms.begin(), latencies_ms.end() );
+    double sum = 0.0;
+    for( double ms : latencies_ms )
+        sum += ms;
+    const auto percentile = [&]( double p ) { return latencies_ms[static_cast<size_t>( p * ( latencies_ms.size() - 1 ) )]; };
+    std::cout << "Send to applied latency: mean " << sum / latencies_ms.size() << " ms, p50 " << percentile( 0.5 )
+              << " ms, p95 " << percentile( 0.95 ) << " ms, max " << latencies_ms.back() << " ms\n"
+              << "Applied over " << frames.size() << " frames, " << static_cast<double>( latencies_ms.size() ) / frames.size()
+              << " edits per frame" << std::endl;
+    return failed == 0 && in_flight.empty() ? 0 : 1;
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "TcpSocket.h"
+
+#include <vector_types.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+*   Wire format of the scene edit channel (little endian, no padding).
+*
+*   Client -> renderer, one message per edit:
+*       SceneEditHeader                             24 bytes
+*       payload[payload_bytes]                      depends on the type:
+*           SCENE_EDIT_ADD_GEOMETRY                 SceneEditGeometry, then the OBJ path for a MESH (not terminated)
+*           SCENE_EDIT_REMOVE_GEOMETRY              nothing
+*           SCENE_EDIT_SET_TRANSFORM                float[12], row-major 3x4 object to parent
+*           SCENE_EDIT_SET_MATERIAL                 SceneEditMaterial
+*           SCENE_EDIT_SET_LIGHT                    SceneEditLight
+*           SCENE_EDIT_ADD_GROUP                    float[12], row-major 3x4 group to parent
+*           SCENE_EDIT_SET_PARENT                   uint64_t id of the new parent, SCENE_EDIT_NO_PARENT for none
+*   The id names an object for the geometry, group, transform and parent edits: instances of the scene
+*   file are objects 0 to n-1 in file order, AddGeometry and AddGroup create a new one under an unused
+*   id. Objects form a hierarchy (see SceneGraph.h); groups have no geometry and move their children
+*   along. New objects have no parent, a parent change keeps the transform relative to the parent, and
+*   only objects without children can be removed. For SetMaterial the id is the material id, for
+*   SetLight the index of the light in the scene. SetLight edits point and spot lights only: an area light
+*   is emitted by a plane object of the scene, which is moved and recolored like any other object.
+*
+*   The renderer applies all edits that arrived since the previous frame in order, between two launches.
+*   Renderer -> client, once per edit:
+*       SceneEditAck                                24 bytes
+*   The frame is the first frame rendered with the edit, counted from the start of the renderer. Every
+*   edit is acknowledged, the ones that could not be applied with a status other than SCENE_EDIT_OK.
+*/
+
+static const uint32_t SCENE_EDIT_MAGIC     = 0x54444553u;  // "SEDT"
+static const uint32_t SCENE_EDIT_ACK_MAGIC = 0x4b444553u;  // "SEDK"
+
+enum SceneEditType
+{
+    SCENE_EDIT_ADD_GEOMETRY    = 1,
+    SCENE_EDIT_REMOVE_GEOMETRY = 2,
+    SCENE_EDIT_SET_TRANSFORM   = 3,
+    SCENE_EDIT_SET_MATERIAL    = 4,
+    SCENE_EDIT_SET_LIGHT       = 5,
+    SCENE_EDIT_ADD_GROUP       = 6,
+    SCENE_EDIT_SET_PARENT      = 7
+};
+
+static const uint64_t SCENE_EDIT_NO_PARENT = ~0ull;
+
+enum SceneEditStatus
+{
+    SCENE_EDIT_OK             = 0,
+    SCENE_EDIT_UNKNOWN_OBJECT = 1,  // no object, material or light with that id
+    SCENE_EDIT_INVALID        = 2,  // id already in use, a shape, material or light type out of range, an area
+                                    // light in a SetLight, a parent change that would form a cycle or the
+                                    // removal of an object with children
+    SCENE_EDIT_FAILED         = 3   // the OBJ file of an AddGeometry could not be loaded
+};
+
+struct SceneEditHeader
+{
+    uint32_t magic;
+    uint32_t type;           // SceneEditType
+    uint32_t sequence;       // chosen by the client, echoed in the ack
+    uint32_t payload_bytes;
+    uint64_t id;
+};
+
+struct SceneEditGeometry
+{
+    uint32_t shape;          // Geom: CUBE, ICOSPHERE or MESH
+    uint32_t material;       // material id, for a MESH only used if its OBJ file has no material library
+    float    transform[12];
+};
+
+struct SceneEditMaterial
+{
+    uint32_t type;           // Material
+    float3   diffuse;
+    float3   specular;
+    float3   emission;
+    float    spec_exp;
+    float    ior;
+};
+
+struct SceneEditLight
+{
+    uint32_t shape;          // Geom: POINT_LIGHT or SPOT_LIGHT
+    float3   corner;
+    float3   v1;
+    float3   v2;
+    float3   normal;
+    float3   emission;
+    float    width;
+    float    falloff_start;
+};
+
+struct SceneEditAck
+{
+    uint32_t magic;
+    uint32_t sequence;
+    uint64_t frame;
+    uint32_t status;         // SceneEditStatus
+    uint32_t reserved;
+};
+
+// One decoded edit; only the members of its type are meaningful
+struct SceneEdit
+{
+    SceneEditType     type     = SCENE_EDIT_SET_TRANSFORM;
+    uint32_t          sequence = 0;
+    uint64_t          id       = 0;
+    SceneEditGeometry geometry = {};  // ADD_GEOMETRY
+    std::string       path;           // ADD_GEOMETRY of a MESH
+    float             transform[12] = {};  // SET_TRANSFORM, ADD_GROUP
+    uint64_t          parent   = SCENE_EDIT_NO_PARENT;  // SET_PARENT
+    SceneEditMaterial material = {};  // SET_MATERIAL
+    SceneEditLight    light    = {};  // SET_LIGHT
+};
+
+
+// Upper bound that keeps a corrupt header from allocating unbounded memory
+static const uint32_t SCENE_EDIT_MAX_PATH = 4096;
+
+// Payload size of a type without the OBJ path, ~0u for an unknown type
+inline uint32_t sceneEditPayloadBytes( uint32_t type )
+{
+    switch( type )
+    {
+        case SCENE_EDIT_ADD_GEOMETRY:    return sizeof( SceneEditGeometry );
+        case SCENE_EDIT_REMOVE_GEOMETRY: return 0;
+        case SCENE_EDIT_SET_TRANSFORM:   return sizeof( float ) * 12;
+        case SCENE_EDIT_SET_MATERIAL:    return sizeof( SceneEditMaterial );
+        case SCENE_EDIT_SET_LIGHT:       return sizeof( SceneEditLight );
+        case SCENE_EDIT_ADD_GROUP:       return sizeof( float ) * 12;
+        case SCENE_EDIT_SET_PARENT:      return sizeof( uint64_t );
+        default:                         return ~0u;
+    }
+}
+
+
+// Append the message of an edit to out, so that a batch of edits can be sent at once
+inline void encodeSceneEdit( const SceneEdit& edit, std::vector<unsigned char>& out )
+{
+    const void* payload = nullptr;
+    switch( edit.type )
+    {
+        case SCENE_EDIT_ADD_GEOMETRY:    payload = &edit.geometry; break;
+        case SCENE_EDIT_REMOVE_GEOMETRY: break;
+        case SCENE_EDIT_SET_TRANSFORM:   payload = edit.transform; break;
+        case SCENE_EDIT_SET_MATERIAL:    payload = &edit.material; break;
+        case SCENE_EDIT_SET_LIGHT:       payload = &edit.light; break;
+        case SCENE_EDIT_ADD_GROUP:       payload = edit.transform; break;
+        case SCENE_EDIT_SET_PARENT:      payload = &edit.parent; break;
+    }
+    const uint32_t payload_bytes = sceneEditPayloadBytes( edit.type );
+    const uint32_t path_bytes    = edit.type == SCENE_EDIT_ADD_GEOMETRY ? static_cast<uint32_t>( edit.path.size() ) : 0;
+
+    SceneEditHeader header;
+    header.magic         = SCENE_EDIT_MAGIC;
+    header.type          = edit.type;
+    header.sequence      = edit.sequence;
+    header.payload_bytes = payload_bytes + path_bytes;
+    header.id            = edit.id;
+
+    const size_t offset = out.size();
+    out.resize( offset + sizeof( header ) + header.payload_bytes );
+    std::memcpy( out.data() + offset, &header, sizeof( header ) );
+    if( payload_bytes )
+        std::memcpy( out.data() + offset + sizeof( header ), payload, payload_bytes );
+    if( path_bytes )
+        std::memcpy( out.data() + offset + sizeof( header ) + payload_bytes, edit.path.data(), path_bytes );
+}
+
+
+// Read one edit message; false when the connection closed or the stream is malformed
+inline bool receiveSceneEdit( TcpSocket& socket, SceneEdit& edit )
+{
+    SceneEditHeader header;
+    if( !socket.receiveAll( &header, sizeof( header ) ) )
+        return false;
+    const uint32_t payload_bytes = sceneEditPayloadBytes( header.type );
+    if( header.magic != SCENE_EDIT_MAGIC || payload_bytes == ~0u || header.payload_bytes < payload_bytes )
+        return false;
+    const uint32_t path_bytes = header.payload_bytes - payload_bytes;
+    if( path_bytes > ( header.type == SCENE_EDIT_ADD_GEOMETRY ? SCENE_EDIT_MAX_PATH : 0 ) )
+        return false;
+
+    edit.type     = static_cast<SceneEditType>( header.type );
+    edit.sequence = header.sequence;
+    edit.id       = header.id;
+    edit.path.clear();
+
+    void* payload = nullptr;
+    switch( edit.type )
+    {
+        case SCENE_EDIT_ADD_GEOMETRY:    payload = &edit.geometry; break;
+        case SCENE_EDIT_REMOVE_GEOMETRY: break;
+        case SCENE_EDIT_SET_TRANSFORM:   payload = edit.transform; break;
+        case SCENE_EDIT_SET_MATERIAL:    payload = &edit.material; break;
+        case SCENE_EDIT_SET_LIGHT:       payload = &edit.light; break;
+        case SCENE_EDIT_ADD_GROUP:       payload = edit.transform; break;
+        case SCENE_EDIT_SET_PARENT:      payload = &edit.parent; break;
+    }
+    if( payload_bytes && !socket.receiveAll( payload, payload_bytes ) )
+        return false;
+    if( path_bytes )
+    {
+        edit.path.resize( path_bytes );
+        if( !socket.receiveAll( &edit.path[0], path_bytes ) )
+            return false;
+    }
+    return true;
+}
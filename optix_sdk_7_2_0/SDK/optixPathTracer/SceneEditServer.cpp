@@ -0,0 +1,152 @@
+#include "SceneEditServer.h"
+
+#include <iostream>
+#include <utility>
+
+// How long the network thread blocks before it checks for a shutdown request
+static const int POLL_INTERVAL_MS = 100;
+// A client that blocks a single send or receive for longer is dropped
+static const int CLIENT_TIMEOUT_MS = 2000;
+
+
+bool SceneEditServer::start()
+{
+    if( m_running )
+        return true;
+
+    m_listener = TcpSocket::listen( m_settings.port );
+    if( !m_listener.valid() )
+    {
+        std::cerr << "Scene edits: cannot listen on port " << m_settings.port << std::endl;
+        return false;
+    }
+    if( !TcpSocket::pair( m_wake_sender, m_wake_receiver ) )
+    {
+        std::cerr << "Scene edits: cannot create the ack wakeup socket pair" << std::endl;
+        m_listener.close();
+        return false;
+    }
+    std::cout << "Scene edits: listening on port " << m_settings.port << std::endl;
+
+    m_running        = true;
+    m_network_thread = std::thread( &SceneEditServer::networkLoop, this );
+    return true;
+}
+
+
+void SceneEditServer::stop()
+{
+    if( !m_running )
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock( m_ack_mutex );
+        m_running = false;
+        m_acks.clear();
+    }
+
+    // A send or receive the network thread is blocked in returns right away
+    {
+        std::lock_guard<std::mutex> lock( m_client_mutex );
+        m_client.shutdown();
+    }
+    m_network_thread.join();
+
+    m_client.close();
+    m_listener.close();
+    m_wake_sender.close();
+    m_wake_receiver.close();
+}
+
+
+void SceneEditServer::poll( std::vector<SceneEdit>& edits )
+{
+    edits.clear();
+    std::lock_guard<std::mutex> lock( m_mutex );
+    edits.swap( m_pending );
+}
+
+
+void SceneEditServer::acknowledge( const std::vector<SceneEditAck>& acks )
+{
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock( m_ack_mutex );
+        if( !m_running || acks.empty() )
+            return;
+        wake = m_acks.empty();
+        m_acks.insert( m_acks.end(), acks.begin(), acks.end() );
+    }
+
+    // One byte per batch of acks, the network thread sends the whole queue when it wakes up
+    if( wake )
+    {
+        const char wakeup = 0;
+        m_wake_sender.sendAll( &wakeup, 1 );
+    }
+}
+
+
+void SceneEditServer::sendAcks()
+{
+    std::vector<SceneEditAck> acks;
+    {
+        std::lock_guard<std::mutex> lock( m_ack_mutex );
+        acks.swap( m_acks );
+    }
+    // Acks for a client that went away are dropped with it
+    if( !acks.empty() && m_client.valid() && !m_client.sendAll( acks.data(), acks.size() * sizeof( SceneEditAck ) ) )
+    {
+        std::cout << "Scene edits: client does not take acks, disconnected" << std::endl;
+        std::lock_guard<std::mutex> lock( m_client_mutex );
+        m_client.close();
+    }
+}
+
+
+bool SceneEditServer::consumeWakeup()
+{
+    char wakeup;
+    return m_wake_receiver.waitReadable( 0 ) && m_wake_receiver.receiveAll( &wakeup, 1 );
+}
+
+
+void SceneEditServer::networkLoop()
+{
+    while( m_running )
+    {
+        sendAcks();
+
+        if( !m_client.valid() )
+        {
+            if( !m_listener.waitReadable( POLL_INTERVAL_MS, &m_wake_receiver ) || consumeWakeup() )
+                continue;
+            TcpSocket client = m_listener.accept();
+            {
+                std::lock_guard<std::mutex> lock( m_client_mutex );
+                m_client = std::move( client );
+            }
+            if( m_client.valid() )
+            {
+                std::cout << "Scene edits: client connected" << std::endl;
+                m_client.setTimeout( CLIENT_TIMEOUT_MS );
+            }
+            continue;
+        }
+
+        if( !m_client.waitReadable( POLL_INTERVAL_MS, &m_wake_receiver ) || consumeWakeup() )
+            continue;
+
+        SceneEdit edit;
+        if( !receiveSceneEdit( m_client, edit ) )
+        {
+            std::cout << "Scene edits: client disconnected" << std::endl;
+            std::lock_guard<std::mutex> lock( m_client_mutex );
+            m_client.close();
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_pending.push_back( std::move( edit ) );
+    }
+}
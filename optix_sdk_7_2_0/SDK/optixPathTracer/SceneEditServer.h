@@ -0,0 +1,74 @@
+#pragma once
+
+#include "SceneEditProtocol.h"
+#include "TcpSocket.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+       * Receiving end of the scene edit channel (see SceneEditProtocol.h).
+       *
+       * A network thread accepts one client at a time and queues its edits in arrival order. The render
+       * thread takes the whole queue with poll() once per frame, applies it between two launches and
+       * answers every edit with acknowledge(). Unlike spatial mapping patches, edits are never merged:
+       * a transform sent after an AddGeometry must not overtake it. As in SpatialMeshIngest, acks are
+       * queued and sent by the network thread, and a client that stalls in the middle of a message or
+       * stops reading acks for longer than a timeout is dropped.
+*/
+class SceneEditServer
+{
+public:
+    struct Settings
+    {
+        uint16_t port = 27016;
+    };
+
+    SceneEditServer() = default;
+    explicit SceneEditServer( const Settings& settings ) : m_settings( settings ) {}
+    ~SceneEditServer() { stop(); }
+
+    SceneEditServer( const SceneEditServer& ) = delete;
+    SceneEditServer& operator=( const SceneEditServer& ) = delete;
+
+    // Settings only take effect on the next start()
+    Settings&       settings()       { return m_settings; }
+    const Settings& settings() const { return m_settings; }
+
+    // Open the port and start the network thread; false if the port cannot be opened
+    bool start();
+    void stop();
+    bool running() const { return m_running; }
+
+    // Move out every edit received since the last call, oldest first. Never blocks on the network.
+    void poll( std::vector<SceneEdit>& edits );
+
+    // Queue the acks of one frame for the connected client, sent in a single write. Never blocks on
+    // the network.
+    void acknowledge( const std::vector<SceneEditAck>& acks );
+
+private:
+    void networkLoop();
+    // Network thread: send the queued acks, consume a wakeup from acknowledge()
+    void sendAcks();
+    bool consumeWakeup();
+
+    Settings           m_settings;
+    std::atomic<bool>  m_running{ false };
+    std::thread        m_network_thread;
+
+    TcpSocket          m_listener;
+    TcpSocket          m_client;         // replaced and closed by the network thread only
+    TcpSocket          m_wake_sender;    // acknowledge() wakes the network thread through this pair
+    TcpSocket          m_wake_receiver;
+    std::mutex         m_client_mutex;   // stop() shuts the client down from another thread
+
+    std::mutex                m_ack_mutex;  // guards m_acks
+    std::vector<SceneEditAck> m_acks;
+
+    std::mutex             m_mutex;     // guards m_pending
+    std::vector<SceneEdit> m_pending;
+};
@@ -0,0 +1,259 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+const SceneGraph::NodeId SceneGraph::NO_NODE;
+const uint32_t           SceneGraph::NO_INSTANCE;
+
+static const uint8_t IN_USE = 1;
+static const uint8_t DIRTY  = 2;
+
+static const float IDENTITY[12] = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f };
+
+
+void multiplyAffine( const float a[12], const float b[12], float c[12] )
+{
+    for( int r = 0; r < 3; ++r )
+    {
+        const float* row = a + r * 4;
+        for( int col = 0; col < 4; ++col )
+            c[r * 4 + col] = row[0] * b[col] + row[1] * b[4 + col] + row[2] * b[8 + col];
+        c[r * 4 + 3] += row[3];
+    }
+}
+
+
+SceneGraph::NodeId SceneGraph::addNode( NodeId parent, const float local[12], uint32_t instance )
+{
+    if( parent != NO_NODE )
+        check( parent );
+
+    NodeId node;
+    if( !m_free.empty() )
+    {
+        node = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        node = static_cast<NodeId>( m_parent.size() );
+        m_parent.push_back( NO_NODE );
+        m_first_child.push_back( NO_NODE );
+        m_next_sibling.push_back( NO_NODE );
+        m_prev_sibling.push_back( NO_NODE );
+        m_instance.push_back( NO_INSTANCE );
+        m_local.push_back( Transform() );
+        m_world.push_back( Transform() );
+        m_flags.push_back( 0 );
+    }
+
+    m_first_child[node] = NO_NODE;
+    m_instance[node]    = instance;
+    m_flags[node]       = IN_USE;
+    std::memcpy( m_local[node].m, local, sizeof( Transform ) );
+    std::memcpy( m_world[node].m, IDENTITY, sizeof( Transform ) );
+    link( node, parent );
+    flag( node );
+    return node;
+}
+
+
+bool SceneGraph::removeNode( NodeId node )
+{
+    check( node );
+    if( m_first_child[node] != NO_NODE )
+        return false;
+    unlink( node );
+    m_flags[node] = 0;  // a stale entry in m_dirty is skipped by update()
+    m_free.push_back( node );
+    return true;
+}
+
+
+void SceneGraph::setLocal( NodeId node, const float local[12] )
+{
+    check( node );
+    std::memcpy( m_local[node].m, local, sizeof( Transform ) );
+    flag( node );
+}
+
+
+bool SceneGraph::setParent( NodeId node, NodeId parent )
+{
+    check( node );
+    if( parent != NO_NODE )
+    {
+        check( parent );
+        for( NodeId ancestor = parent; ancestor != NO_NODE; ancestor = m_parent[ancestor] )
+            if( ancestor == node )
+                return false;
+    }
+    if( m_parent[node] == parent )
+        return true;
+    unlink( node );
+    link( node, parent );
+    flag( node );
+    return true;
+}
+
+
+void SceneGraph::setInstance( NodeId node, uint32_t instance )
+{
+    check( node );
+    m_instance[node] = instance;
+    flag( node );
+}
+
+
+SceneGraph::NodeId SceneGraph::parent( NodeId node ) const
+{
+    check( node );
+    return m_parent[node];
+}
+
+
+uint32_t SceneGraph::instance( NodeId node ) const
+{
+    check( node );
+    return m_instance[node];
+}
+
+
+bool SceneGraph::hasChildren( NodeId node ) const
+{
+    check( node );
+    return m_first_child[node] != NO_NODE;
+}
+
+
+const float* SceneGraph::local( NodeId node ) const
+{
+    check( node );
+    return m_local[node].m;
+}
+
+
+const float* SceneGraph::world( NodeId node ) const
+{
+    check( node );
+    return m_world[node].m;
+}
+
+
+size_t SceneGraph::update( void* instances, size_t stride_bytes, std::vector<uint32_t>& written )
+{
+    written.clear();
+    size_t computed = 0;
+    for( NodeId root : m_dirty )
+    {
+        // Removed, or already recomputed as part of the subtree of a flagged ancestor
+        if( !( m_flags[root] & DIRTY ) )
+            continue;
+        // A flagged ancestor that comes later in the list recomputes this subtree as well
+        bool covered = false;
+        for( NodeId ancestor = m_parent[root]; ancestor != NO_NODE && !covered; ancestor = m_parent[ancestor] )
+            covered = ( m_flags[ancestor] & DIRTY ) != 0;
+        if( covered )
+            continue;
+
+        // Parents before children; the world transform of the parent of root is current
+        m_stack.push_back( root );
+        while( !m_stack.empty() )
+        {
+            const NodeId node = m_stack.back();
+            m_stack.pop_back();
+            compute( node, instances, stride_bytes );
+            if( m_instance[node] != NO_INSTANCE )
+                written.push_back( m_instance[node] );
+            ++computed;
+            for( NodeId child = m_first_child[node]; child != NO_NODE; child = m_next_sibling[child] )
+                m_stack.push_back( child );
+        }
+    }
+    m_dirty.clear();
+    std::sort( written.begin(), written.end() );
+    return computed;
+}
+
+
+void SceneGraph::updateAll( void* instances, size_t stride_bytes )
+{
+    for( NodeId root = 0; root < m_parent.size(); ++root )
+    {
+        if( !( m_flags[root] & IN_USE ) || m_parent[root] != NO_NODE )
+            continue;
+        m_stack.push_back( root );
+        while( !m_stack.empty() )
+        {
+            const NodeId node = m_stack.back();
+            m_stack.pop_back();
+            compute( node, instances, stride_bytes );
+            for( NodeId child = m_first_child[node]; child != NO_NODE; child = m_next_sibling[child] )
+                m_stack.push_back( child );
+        }
+    }
+    m_dirty.clear();
+}
+
+
+void SceneGraph::check( NodeId node ) const
+{
+    if( node >= m_flags.size() || !( m_flags[node] & IN_USE ) )
+        throw std::invalid_argument( "SceneGraph: node " + std::to_string( node ) + " does not exist" );
+}
+
+
+void SceneGraph::flag( NodeId node )
+{
+    if( m_flags[node] & DIRTY )
+        return;
+    m_flags[node] |= DIRTY;
+    m_dirty.push_back( node );
+}
+
+
+// Insert node at the front of the child list of parent; roots are not linked
+void SceneGraph::link( NodeId node, NodeId parent )
+{
+    m_parent[node]       = parent;
+    m_prev_sibling[node] = NO_NODE;
+    m_next_sibling[node] = NO_NODE;
+    if( parent == NO_NODE )
+        return;
+    m_next_sibling[node] = m_first_child[parent];
+    if( m_first_child[parent] != NO_NODE )
+        m_prev_sibling[m_first_child[parent]] = node;
+    m_first_child[parent] = node;
+}
+
+
+void SceneGraph::unlink( NodeId node )
+{
+    const NodeId parent = m_parent[node];
+    if( parent == NO_NODE )
+        return;
+    if( m_prev_sibling[node] != NO_NODE )
+        m_next_sibling[m_prev_sibling[node]] = m_next_sibling[node];
+    else
+        m_first_child[parent] = m_next_sibling[node];
+    if( m_next_sibling[node] != NO_NODE )
+        m_prev_sibling[m_next_sibling[node]] = m_prev_sibling[node];
+    m_parent[node] = m_prev_sibling[node] = m_next_sibling[node] = NO_NODE;
+}
+
+
+void SceneGraph::compute( NodeId node, void* instances, size_t stride_bytes )
+{
+    const NodeId parent = m_parent[node];
+    if( parent == NO_NODE )
+        m_world[node] = m_local[node];
+    else
+        multiplyAffine( m_world[parent].m, m_local[node].m, m_world[node].m );
+    m_flags[node] &= ~DIRTY;
+
+    if( instances && m_instance[node] != NO_INSTANCE )
+        std::memcpy( static_cast<char*>( instances ) + m_instance[node] * stride_bytes, m_world[node].m, sizeof( Transform ) );
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+       * Transform hierarchy of the scene objects.
+       *
+       * Every node has a local transform relative to its parent and a world transform, both row-major
+       * 3x4 like Instance::transform. A node can drive one instance: whenever its world transform
+       * changes, update() writes it into the caller's instance array. Nodes without an instance group
+       * other nodes so that they move together.
+       *
+       * Changing a local transform or a parent only flags the node. update() then recomputes the world
+       * transforms of the flagged subtrees and of nothing else, so the cost follows the size of the
+       * change, not the size of the scene. The instances it wrote are returned in ascending order, which
+       * lets the caller upload them as one contiguous range.
+       *
+       * Node ids of removed nodes are reused. All functions throw std::invalid_argument on a node id
+       * that is not in use.
+*/
+class SceneGraph
+{
+public:
+    typedef uint32_t NodeId;
+    static const NodeId   NO_NODE     = ~0u;
+    static const uint32_t NO_INSTANCE = ~0u;
+
+    // New node under parent (NO_NODE for a root), flagged for the next update()
+    NodeId addNode( NodeId parent, const float local[12], uint32_t instance = NO_INSTANCE );
+
+    // Remove a node without children; false if it still has some
+    bool removeNode( NodeId node );
+
+    void setLocal( NodeId node, const float local[12] );
+
+    // Move a node, keeping its local transform; false if parent lies in the subtree of node
+    bool setParent( NodeId node, NodeId parent );
+
+    // The instance a node writes its world transform to, for when the caller moves instances around.
+    // Setting it flags the node, so the instance receives its transform on the next update().
+    void setInstance( NodeId node, uint32_t instance );
+
+    NodeId       parent( NodeId node ) const;
+    uint32_t     instance( NodeId node ) const;
+    bool         hasChildren( NodeId node ) const;
+    const float* local( NodeId node ) const;
+    // Valid after the update() following the last change above the node
+    const float* world( NodeId node ) const;
+
+    size_t size() const { return m_parent.size() - m_free.size(); }
+    bool   dirty() const { return !m_dirty.empty(); }
+
+    // Recompute the world transform of every flagged subtree and write those of nodes with an instance to
+    // instances + instance * stride_bytes. The written instance indices are returned in ascending order.
+    // Returns the number of nodes that were recomputed.
+    size_t update( void* instances, size_t stride_bytes, std::vector<uint32_t>& written );
+
+    // Recompute every world transform, ignoring the flags (reference for update())
+    void updateAll( void* instances, size_t stride_bytes );
+
+private:
+    struct Transform
+    {
+        float m[12];
+    };
+
+    void check( NodeId node ) const;
+    void flag( NodeId node );
+    void link( NodeId node, NodeId parent );
+    void unlink( NodeId node );
+    void compute( NodeId node, void* instances, size_t stride_bytes );
+
+    // Structure of arrays by node id
+    std::vector<NodeId>    m_parent;
+    std::vector<NodeId>    m_first_child;
+    std::vector<NodeId>    m_next_sibling;
+    std::vector<NodeId>    m_prev_sibling;
+    std::vector<uint32_t>  m_instance;
+    std::vector<Transform> m_local;
+    std::vector<Transform> m_world;
+    std::vector<uint8_t>   m_flags;  // IN_USE, DIRTY
+
+    std::vector<NodeId>    m_dirty;  // flagged nodes, each at most once
+    std::vector<NodeId>    m_free;   // removed node ids
+    std::vector<NodeId>    m_stack;  // traversal scratch of update()
+};
+
+
+// c = a * b for row-major 3x4 affine transforms; c may alias neither a nor b
+void multiplyAffine( const float a[12], const float b[12], float c[12] );
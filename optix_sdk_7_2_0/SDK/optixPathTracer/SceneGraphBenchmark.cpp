@@ -0,0 +1,148 @@
+//
+// sceneGraphBenchmark - builds a random transform hierarchy, changes small sets of its nodes (local
+// transforms and parents) and measures SceneGraph::update() against recomputing every node. After
+// every change set the incrementally updated instance transforms are checked against a full update.
+//
+
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+
+void printUsageAndExit( const char* argv0 )
+{
+    std::cerr << "Usage  : " << argv0 << " [options]\n";
+    std::cerr << "Options: --nodes <n>                Nodes in the hierarchy, each drives one instance (default 100000)\n";
+    std::cerr << "         --roots <fraction>         Fraction of nodes without a parent (default 0.01)\n";
+    std::cerr << "         --repeat <n>               Change sets per size (default 20)\n";
+    exit( 0 );
+}
+
+
+// Row-major 3x4 transform: rotation about y by angle, then translation
+static void randomLocal( std::mt19937& rng, float local[12] )
+{
+    std::uniform_real_distribution<float> uniform( -1.f, 1.f );
+    const float angle = uniform( rng ) * 3.14159265f;
+    const float c = std::cos( angle ), s = std::sin( angle );
+    const float m[12] = { c, 0.f, s, uniform( rng ), 0.f, 1.f, 0.f, uniform( rng ), -s, 0.f, c, uniform( rng ) };
+    std::copy( m, m + 12, local );
+}
+
+
+static double milliseconds( Clock::time_point t0, Clock::time_point t1 )
+{
+    return std::chrono::duration<double, std::milli>( t1 - t0 ).count();
+}
+
+
+int main( int argc, char* argv[] )
+{
+    uint32_t num_nodes = 100000;
+    double   roots     = 0.01;
+    int      repeat    = 20;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+            printUsageAndExit( argv[0] );
+        else if( arg == "--nodes" && i + 1 < argc )
+            num_nodes = static_cast<uint32_t>( std::max( 1, atoi( argv[++i] ) ) );
+        else if( arg == "--roots" && i + 1 < argc )
+            roots = std::min( 1.0, std::max( 0.0, atof( argv[++i] ) ) );
+        else if( arg == "--repeat" && i + 1 < argc )
+            repeat = std::max( 1, atoi( argv[++i] ) );
+        else
+        {
+            std::cerr << "Unknown option '" << arg << "'\n";
+            printUsageAndExit( argv[0] );
+        }
+    }
+
+    // Random recursive tree: every node is a root or hangs below a random earlier node
+    std::mt19937                           rng( 1234 );
+    std::uniform_real_distribution<double> chance( 0.0, 1.0 );
+    SceneGraph                             graph;
+    float                                  local[12];
+    for( uint32_t i = 0; i < num_nodes; ++i )
+    {
+        randomLocal( rng, local );
+        const SceneGraph::NodeId parent = i == 0 || chance( rng ) < roots ? SceneGraph::NO_NODE : static_cast<SceneGraph::NodeId>( rng() % i );
+        graph.addNode( parent, local, i );
+    }
+
+    // Instance transforms as in the renderer: 12 floats at the start of a larger record
+    const size_t       stride = 80;  // sizeof( OptixInstance )
+    std::vector<char>  instances( num_nodes * stride ), reference( num_nodes * stride );
+    std::vector<uint32_t> written;
+
+    Clock::time_point t0 = Clock::now();
+    graph.update( instances.data(), stride, written );
+    Clock::time_point t1 = Clock::now();
+    const double first_ms = milliseconds( t0, t1 );
+
+    t0 = Clock::now();
+    for( int r = 0; r < repeat; ++r )
+        graph.updateAll( reference.data(), stride );
+    t1 = Clock::now();
+    const double full_ms = milliseconds( t0, t1 ) / repeat;
+
+    std::cout << num_nodes << " nodes, " << std::fixed << std::setprecision( 3 ) << "first update " << first_ms
+              << " ms, full update " << full_ms << " ms\n";
+    std::cout << "  changed    recomputed     written        span    update ms   speedup\n";
+
+    bool ok = true;
+    for( uint32_t changes = 1; changes <= std::min<uint32_t>( num_nodes, 10000 ); changes *= 10 )
+    {
+        double update_ms = 0.0;
+        size_t recomputed = 0, num_written = 0, span = 0;
+        for( int r = 0; r < repeat; ++r )
+        {
+            // Mostly moved nodes, every tenth change reparents a node
+            for( uint32_t c = 0; c < changes; ++c )
+            {
+                const SceneGraph::NodeId node = static_cast<SceneGraph::NodeId>( rng() % num_nodes );
+                if( c % 10 == 9 )
+                {
+                    graph.setParent( node, static_cast<SceneGraph::NodeId>( rng() % num_nodes ) );  // refused if it would form a cycle
+                }
+                else
+                {
+                    randomLocal( rng, local );
+                    graph.setLocal( node, local );
+                }
+            }
+
+            t0 = Clock::now();
+            recomputed += graph.update( instances.data(), stride, written );
+            t1 = Clock::now();
+            update_ms   += milliseconds( t0, t1 );
+            num_written += written.size();
+            span        += written.empty() ? 0 : written.back() - written.front() + 1;
+
+            // The same arithmetic in the same order, so the results have to match exactly
+            graph.updateAll( reference.data(), stride );
+            for( uint32_t i = 0; i < num_nodes && ok; ++i )
+                ok = std::memcmp( instances.data() + i * stride, reference.data() + i * stride, 12 * sizeof( float ) ) == 0;
+        }
+        update_ms /= repeat;
+        std::cout << std::setw( 9 ) << changes << std::setw( 13 ) << recomputed / repeat << std::setw( 12 ) << num_written / repeat
+                  << std::setw( 12 ) << span / repeat << std::setw( 13 ) << update_ms << std::setw( 9 ) << std::setprecision( 1 )
+                  << full_ms / std::max( update_ms, 1e-6 ) << "x" << std::setprecision( 3 ) << "\n";
+    }
+
+    std::cout << ( ok ? "Incremental and full updates agree" : "MISMATCH between incremental and full updates" ) << std::endl;
+    return ok ? 0 : 1;
+}
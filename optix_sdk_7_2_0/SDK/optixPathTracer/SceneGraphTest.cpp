@@ -0,0 +1,289 @@
+//
+// sceneGraphTest - host tests of SceneGraph::update(): reparented subtrees are recomputed with their new
+// ancestors and nothing else, removed nodes and subtrees stop writing their instances, and the written
+// instance list is ascending without duplicates. A random edit sequence is checked against world
+// transforms computed from the parent chains.
+//
+
+#include "SceneGraph.h"
+#include "HostTest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+
+namespace {
+
+// Instances as the sample lays them out: a transform followed by other data
+struct TestInstance
+{
+    float    transform[12];
+    uint32_t mesh_id;
+};
+
+struct Affine
+{
+    float m[12];
+};
+
+Affine translation( float x, float y, float z )
+{
+    const Affine t = { { 1.f, 0.f, 0.f, x, 0.f, 1.f, 0.f, y, 0.f, 0.f, 1.f, z } };
+    return t;
+}
+
+Affine rotationZ( float angle, float x = 0.f )
+{
+    const float  c = std::cos( angle ), s = std::sin( angle );
+    const Affine r = { { c, -s, 0.f, x, s, c, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f } };
+    return r;
+}
+
+Affine product( const Affine& a, const Affine& b )
+{
+    Affine c;
+    multiplyAffine( a.m, b.m, c.m );
+    return c;
+}
+
+bool same( const float* a, const Affine& b, float tolerance = 0.f )
+{
+    for( int i = 0; i < 12; ++i )
+        if( std::fabs( a[i] - b.m[i] ) > tolerance )
+            return false;
+    return true;
+}
+
+bool strictlyAscending( const std::vector<uint32_t>& v )
+{
+    for( size_t i = 1; i < v.size(); ++i )
+        if( v[i - 1] >= v[i] )
+            return false;
+    return true;
+}
+
+
+void testReparenting()
+{
+    //   r1 (x + 10)          r2 (quarter turn about z, instance 5)
+    //   +- c (y + 1)         +- d (instance 6)
+    //      +- g (instance 2)
+    std::vector<TestInstance> instances( 8 );
+    SceneGraph                graph;
+    const Affine              r1_local = translation( 10.f, 0.f, 0.f ), c_local = translation( 0.f, 1.f, 0.f );
+    const Affine              g_local = rotationZ( 0.3f, 2.f ), r2_local = rotationZ( 1.5707964f ), d_local = translation( 0.f, 0.f, 4.f );
+    const SceneGraph::NodeId  r1      = graph.addNode( SceneGraph::NO_NODE, r1_local.m );
+    const SceneGraph::NodeId  c       = graph.addNode( r1, c_local.m );
+    const SceneGraph::NodeId  g       = graph.addNode( c, g_local.m, 2 );
+    const SceneGraph::NodeId  r2      = graph.addNode( SceneGraph::NO_NODE, r2_local.m, 5 );
+    const SceneGraph::NodeId  d       = graph.addNode( r2, d_local.m, 6 );
+    std::vector<uint32_t>     written;
+    HOST_CHECK( graph.update( instances.data(), sizeof( TestInstance ), written ) == 5 );
+    HOST_CHECK( written == std::vector<uint32_t>( { 2, 5, 6 } ) );
+    HOST_CHECK( same( instances[2].transform, product( product( r1_local, c_local ), g_local ) ) );
+    HOST_CHECK( same( instances[6].transform, product( r2_local, d_local ) ) );
+    HOST_CHECK( !graph.dirty() );
+
+    // Moving c under r2 recomputes c and g with the transform of r2, not r1 or d
+    HOST_CHECK( graph.setParent( c, r2 ) );
+    HOST_CHECK( graph.dirty() && graph.parent( c ) == r2 );
+    instances[6].transform[3] = 99.f;  // d is not written again
+    HOST_CHECK( graph.update( instances.data(), sizeof( TestInstance ), written ) == 2 );
+    HOST_CHECK( written == std::vector<uint32_t>( { 2 } ) );
+    HOST_CHECK( same( instances[2].transform, product( product( r2_local, c_local ), g_local ) ) );
+    HOST_CHECK( same( graph.world( c ), product( r2_local, c_local ) ) );
+    HOST_CHECK( instances[6].transform[3] == 99.f );
+
+    // A later change of the new parent moves the reparented subtree along
+    const Affine r2_turned = rotationZ( 0.7f );
+    graph.setLocal( r2, r2_turned.m );
+    HOST_CHECK( graph.update( instances.data(), sizeof( TestInstance ), written ) == 4 );
+    HOST_CHECK( written == std::vector<uint32_t>( { 2, 5, 6 } ) );
+    HOST_CHECK( same( instances[2].transform, product( product( r2_turned, c_local ), g_local ) ) );
+    HOST_CHECK( same( instances[6].transform, product( r2_turned, d_local ) ) );
+
+    // ... and one of the old parent does not
+    graph.setLocal( r1, translation( -3.f, 0.f, 0.f ).m );
+    HOST_CHECK( graph.update( instances.data(), sizeof( TestInstance ), written ) == 1 && written.empty() );
+
+    // To a root: the local transform becomes the world transform
+    HOST_CHECK( graph.setParent( c, SceneGraph::NO_NODE ) );
+    HOST_CHECK( graph.update( instances.data(), sizeof( TestInstance ), written ) == 2 );
+    HOST_CHECK( same( instances[2].transform, product( c_local, g_local ) ) && same( graph.world( c ), c_local ) );
+
+    // Cycles are refused and flag nothing; the same parent again flags nothing either
+    HOST_CHECK( !graph.setParent( c, g ) && !graph.setParent( c, c ) );
+    HOST_CHECK( graph.setParent( g, c ) );
+    HOST_CHECK( !graph.dirty() );
+
+    // A node and its ancestor flagged, in either order: every node is computed and written once
+    graph.setParent( c, r2 );
+    graph.setLocal( g, g_local.m );
+    graph.setLocal( r2, r2_local.m );
+    graph.setLocal( d, d_local.m );
+    HOST_CHECK( graph.update( instances.data(), sizeof( TestInstance ), written ) == 4 );
+    HOST_CHECK( written == std::vector<uint32_t>( { 2, 5, 6 } ) );
+    HOST_CHECK( same( instances[2].transform, product( product( r2_local, c_local ), g_local ) ) );
+}
+
+
+void testRemoval()
+{
+    // root (instance 0) with three children (1, 2, 3); child 2 has two leaves (4, 5)
+    std::vector<TestInstance> instances( 6 );
+    SceneGraph                graph;
+    const Affine              root_local = translation( 1.f, 2.f, 3.f ), child_local = rotationZ( 0.5f, 1.f );
+    const SceneGraph::NodeId  root       = graph.addNode( SceneGraph::NO_NODE, root_local.m, 0 );
+    std::vector<SceneGraph::NodeId> children, leaves;
+    for( uint32_t i = 1; i <= 3; ++i )
+        children.push_back( graph.addNode( root, child_local.m, i ) );
+    for( uint32_t i = 4; i <= 5; ++i )
+        leaves.push_back( graph.addNode( children[1], child_local.m, i ) );
+    std::vector<uint32_t> written;
+    graph.update( instances.data(), sizeof( TestInstance ), written );
+    HOST_CHECK( written == std::vector<uint32_t>( { 0, 1, 2, 3, 4, 5 } ) && graph.size() == 6 );
+
+    // Only leaves go: the subtree of child 2 is removed bottom up
+    HOST_CHECK( !graph.removeNode( children[1] ) && !graph.removeNode( root ) );
+    graph.setLocal( leaves[0], translation( 5.f, 5.f, 5.f ).m );  // flagged, then removed
+    HOST_CHECK( graph.removeNode( leaves[0] ) );
+    HOST_CHECK( graph.hasChildren( children[1] ) );
+    HOST_CHECK( graph.removeNode( leaves[1] ) );
+    HOST_CHECK( !graph.hasChildren( children[1] ) );
+    HOST_CHECK( graph.removeNode( children[1] ) );
+    HOST_CHECK( graph.size() == 3 );
+    HOST_CHECK_THROWS( graph.world( leaves[0] ), std::invalid_argument );
+    HOST_CHECK_THROWS( graph.setLocal( children[1], child_local.m ), std::invalid_argument );
+    HOST_CHECK_THROWS( graph.setParent( children[0], leaves[1] ), std::invalid_argument );
+
+    // The removed nodes write nothing, the siblings around the removed middle child still move with the root
+    for( TestInstance& instance : instances )
+        instance.transform[3] = -1.f;
+    const Affine moved = translation( 0.f, 0.f, 7.f );
+    graph.setLocal( root, moved.m );
+    HOST_CHECK( graph.update( instances.data(), sizeof( TestInstance ), written ) == 3 );
+    HOST_CHECK( written == std::vector<uint32_t>( { 0, 1, 3 } ) );
+    HOST_CHECK( same( instances[1].transform, product( moved, child_local ) ) && same( instances[3].transform, product( moved, child_local ) ) );
+    HOST_CHECK( instances[2].transform[3] == -1.f && instances[4].transform[3] == -1.f && instances[5].transform[3] == -1.f );
+
+    // Removed ids are reused; the new node is flagged and writes its own instance only
+    const SceneGraph::NodeId reused = graph.addNode( children[0], child_local.m, 4 );
+    HOST_CHECK( reused == children[1] || reused == leaves[0] || reused == leaves[1] );
+    HOST_CHECK( graph.update( instances.data(), sizeof( TestInstance ), written ) == 1 );
+    HOST_CHECK( written == std::vector<uint32_t>( { 4 } ) );
+    HOST_CHECK( same( instances[4].transform, product( product( moved, child_local ), child_local ) ) );
+
+    // Removing a node whose instance moved to another node, like applySceneEdits does
+    graph.setInstance( children[2], 2 );
+    HOST_CHECK( graph.removeNode( children[0] ) == false );
+    HOST_CHECK( graph.removeNode( reused ) && graph.removeNode( children[0] ) );
+    HOST_CHECK( graph.update( instances.data(), sizeof( TestInstance ), written ) == 1 );
+    HOST_CHECK( written == std::vector<uint32_t>( { 2 } ) );
+}
+
+
+// World transform from the chain of local transforms, multiplied in the order update() uses
+Affine chainWorld( const SceneGraph& graph, SceneGraph::NodeId node )
+{
+    Affine world;
+    std::memcpy( world.m, graph.local( node ), sizeof( world.m ) );
+    if( graph.parent( node ) == SceneGraph::NO_NODE )
+        return world;
+    return product( chainWorld( graph, graph.parent( node ) ), world );
+}
+
+
+void testRandomEdits()
+{
+    std::mt19937                         rng( 7 );
+    std::uniform_real_distribution<float> angle( -3.f, 3.f );
+    SceneGraph                           graph;
+    std::vector<TestInstance>            instances( 256 );
+    std::vector<SceneGraph::NodeId>      nodes;
+    std::map<SceneGraph::NodeId, uint32_t> instance_of;  // nodes with an instance
+    std::vector<uint32_t>                free_instances;
+    for( uint32_t i = 0; i < 256; ++i )
+        free_instances.push_back( 255 - i );
+
+    std::vector<uint32_t> written;
+    for( int batch = 0; batch < 300; ++batch )
+    {
+        for( int e = 0; e < 1 + static_cast<int>( rng() % 8 ); ++e )
+        {
+            const unsigned op = rng() % 10;
+            if( nodes.empty() || op < 3 )
+            {
+                const SceneGraph::NodeId parent   = nodes.empty() || rng() % 4 == 0 ? SceneGraph::NO_NODE : nodes[rng() % nodes.size()];
+                uint32_t                 instance = SceneGraph::NO_INSTANCE;
+                if( !free_instances.empty() && rng() % 3 != 0 )
+                {
+                    instance = free_instances.back();
+                    free_instances.pop_back();
+                }
+                const SceneGraph::NodeId node = graph.addNode( parent, rotationZ( angle( rng ), angle( rng ) ).m, instance );
+                nodes.push_back( node );
+                if( instance != SceneGraph::NO_INSTANCE )
+                    instance_of[node] = instance;
+            }
+            else if( op < 6 )
+            {
+                graph.setLocal( nodes[rng() % nodes.size()], rotationZ( angle( rng ), angle( rng ) ).m );
+            }
+            else if( op < 8 )
+            {
+                const SceneGraph::NodeId node   = nodes[rng() % nodes.size()];
+                const SceneGraph::NodeId parent = rng() % 5 == 0 ? SceneGraph::NO_NODE : nodes[rng() % nodes.size()];
+                graph.setParent( node, parent );  // refused if it would form a cycle
+            }
+            else
+            {
+                const size_t index = rng() % nodes.size();
+                if( graph.removeNode( nodes[index] ) )
+                {
+                    auto with_instance = instance_of.find( nodes[index] );
+                    if( with_instance != instance_of.end() )
+                    {
+                        free_instances.push_back( with_instance->second );
+                        instance_of.erase( with_instance );
+                    }
+                    nodes.erase( nodes.begin() + index );
+                }
+            }
+        }
+
+        const std::vector<TestInstance> before = instances;
+        graph.update( instances.data(), sizeof( TestInstance ), written );
+        HOST_CHECK( strictlyAscending( written ) );
+        HOST_CHECK( !graph.dirty() );
+
+        // Every instance that changed was reported, and only live ones were written
+        for( uint32_t i = 0; i < instances.size(); ++i )
+            if( std::memcmp( before[i].transform, instances[i].transform, sizeof( instances[i].transform ) ) != 0 )
+                HOST_CHECK( std::binary_search( written.begin(), written.end(), i ) );
+        std::vector<uint32_t> live;
+        for( const auto& node : instance_of )
+            live.push_back( node.second );
+        std::sort( live.begin(), live.end() );
+        HOST_CHECK( std::includes( live.begin(), live.end(), written.begin(), written.end() ) );
+
+        // All transforms are current
+        for( const auto& node : instance_of )
+            HOST_CHECK( same( instances[node.second].transform, chainWorld( graph, node.first ) ) );
+    }
+}
+
+}  // namespace
+
+
+int main()
+{
+    testReparenting();
+    testRemoval();
+    testRandomEdits();
+    return hostTestResult( "sceneGraphTest" );
+}
@@ -0,0 +1,225 @@
+#include "SpatialMeshIngest.h"
+#include "IndexedGeometry.h"
+
+#include <iostream>
+#include <utility>
+
+// How long the service threads block before they check for a shutdown request
+static const int POLL_INTERVAL_MS = 100;
+// A client that blocks a single send or receive for longer is dropped
+static const int CLIENT_TIMEOUT_MS = 2000;
+
+
+bool SpatialMeshIngest::start()
+{
+    if( m_running )
+        return true;
+
+    m_listener = TcpSocket::listen( m_settings.port );
+    if( !m_listener.valid() )
+    {
+        std::cerr << "Spatial mapping: cannot listen on port " << m_settings.port << std::endl;
+        return false;
+    }
+    if( !TcpSocket::pair( m_wake_sender, m_wake_receiver ) )
+    {
+        std::cerr << "Spatial mapping: cannot create the ack wakeup socket pair" << std::endl;
+        m_listener.close();
+        return false;
+    }
+    std::cout << "Spatial mapping: listening on port " << m_settings.port << std::endl;
+
+    m_running        = true;
+    m_network_thread = std::thread( &SpatialMeshIngest::networkLoop, this );
+    m_worker_thread  = std::thread( &SpatialMeshIngest::workerLoop, this );
+    return true;
+}
+
+
+void SpatialMeshIngest::stop()
+{
+    if( !m_running )
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_running = false;
+    }
+    m_pending_cv.notify_all();
+
+    // A send or receive the network thread is blocked in returns right away
+    {
+        std::lock_guard<std::mutex> lock( m_client_mutex );
+        m_client.shutdown();
+    }
+    m_network_thread.join();
+    m_worker_thread.join();
+
+    m_client.close();
+    m_listener.close();
+    m_wake_sender.close();
+    m_wake_receiver.close();
+    std::lock_guard<std::mutex> lock( m_ack_mutex );
+    m_acks.clear();
+}
+
+
+void SpatialMeshIngest::poll( std::vector<SpatialPatchUpdate>& updates )
+{
+    updates.clear();
+    std::lock_guard<std::mutex> lock( m_mutex );
+    for( auto& ready : m_ready )
+        updates.push_back( std::move( ready.second ) );
+    m_ready.clear();
+}
+
+
+void SpatialMeshIngest::acknowledge( uint64_t id, uint32_t version )
+{
+    SpatialChunkAck ack;
+    ack.magic   = SPATIAL_ACK_MAGIC;
+    ack.version = version;
+    ack.id      = id;
+
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock( m_ack_mutex );
+        if( !m_running )
+            return;
+        wake = m_acks.empty();
+        m_acks.push_back( ack );
+    }
+
+    // One byte per batch of acks, the network thread sends the whole queue when it wakes up
+    if( wake )
+    {
+        const char wakeup = 0;
+        m_wake_sender.sendAll( &wakeup, 1 );
+    }
+}
+
+
+void SpatialMeshIngest::sendAcks()
+{
+    std::vector<SpatialChunkAck> acks;
+    {
+        std::lock_guard<std::mutex> lock( m_ack_mutex );
+        acks.swap( m_acks );
+    }
+    // Acks for a client that went away are dropped with it
+    if( !acks.empty() && m_client.valid() && !m_client.sendAll( acks.data(), acks.size() * sizeof( SpatialChunkAck ) ) )
+    {
+        std::cout << "Spatial mapping: client does not take acks, disconnected" << std::endl;
+        std::lock_guard<std::mutex> lock( m_client_mutex );
+        m_client.close();
+    }
+}
+
+
+bool SpatialMeshIngest::consumeWakeup()
+{
+    char wakeup;
+    return m_wake_receiver.waitReadable( 0 ) && m_wake_receiver.receiveAll( &wakeup, 1 );
+}
+
+
+void SpatialMeshIngest::networkLoop()
+{
+    while( m_running )
+    {
+        sendAcks();
+
+        if( !m_client.valid() )
+        {
+            if( !m_listener.waitReadable( POLL_INTERVAL_MS, &m_wake_receiver ) || consumeWakeup() )
+                continue;
+            TcpSocket client = m_listener.accept();
+            {
+                std::lock_guard<std::mutex> lock( m_client_mutex );
+                m_client = std::move( client );
+            }
+            if( m_client.valid() )
+            {
+                // Versions are only ordered within a connection, a client that reconnects (or a
+                // replay that is run again) numbers them from the start
+                std::cout << "Spatial mapping: client connected" << std::endl;
+                m_client.setTimeout( CLIENT_TIMEOUT_MS );
+                m_latest_version.clear();
+            }
+            continue;
+        }
+
+        if( !m_client.waitReadable( POLL_INTERVAL_MS, &m_wake_receiver ) || consumeWakeup() )
+            continue;
+
+        SpatialChunk chunk;
+        if( !receiveSpatialChunk( m_client, chunk ) )
+        {
+            std::cout << "Spatial mapping: client disconnected" << std::endl;
+            std::lock_guard<std::mutex> lock( m_client_mutex );
+            m_client.close();
+            continue;
+        }
+        const auto received = std::chrono::steady_clock::now();
+
+        // Out of order or repeated versions of a patch are stale
+        auto latest = m_latest_version.find( chunk.id );
+        if( latest != m_latest_version.end() && chunk.version <= latest->second )
+            continue;
+        m_latest_version[chunk.id] = chunk.version;
+
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            PendingChunk& pending = m_pending[chunk.id];  // replaces a version the worker has not started yet
+            pending.chunk         = std::move( chunk );
+            pending.received      = received;
+        }
+        m_pending_cv.notify_one();
+    }
+}
+
+
+void SpatialMeshIngest::workerLoop()
+{
+    for( ;; )
+    {
+        PendingChunk job;
+        {
+            std::unique_lock<std::mutex> lock( m_mutex );
+            m_pending_cv.wait( lock, [this]() { return !m_running || !m_pending.empty(); } );
+            if( !m_running )
+                return;
+            job = std::move( m_pending.begin()->second );
+            m_pending.erase( m_pending.begin() );
+        }
+
+        const SpatialChunk& chunk = job.chunk;
+        SpatialPatchUpdate  update;
+        update.id              = chunk.id;
+        update.version         = chunk.version;
+        update.received        = job.received;
+        update.input_triangles = chunk.indices.size() / 3;
+
+        // Expand to a soup (skipping triangles with out of range indices), weld, decimate and pack
+        std::vector<float3> soup;
+        soup.reserve( chunk.indices.size() );
+        for( size_t i = 0; i + 2 < chunk.indices.size(); i += 3 )
+        {
+            const uint32_t a = chunk.indices[i], b = chunk.indices[i + 1], c = chunk.indices[i + 2];
+            if( a >= chunk.vertices.size() || b >= chunk.vertices.size() || c >= chunk.vertices.size() )
+                continue;
+            soup.push_back( chunk.vertices[a] );
+            soup.push_back( chunk.vertices[b] );
+            soup.push_back( chunk.vertices[c] );
+        }
+        const IndexedMesh<float3> mesh = decimateByClustering( weldTriangleSoup( soup ), m_settings.cell_size );
+
+        // A patch that decimates away entirely is removed as well
+        update.removal = mesh.indices.empty();
+        if( !update.removal )
+            update.geometry = packGeometry( mesh, m_settings.format );
+
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_ready[update.id] = std::move( update );
+    }
+}
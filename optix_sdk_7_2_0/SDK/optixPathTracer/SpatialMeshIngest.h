@@ -0,0 +1,103 @@
+#pragma once
+
+#include "SpatialMeshProtocol.h"
+#include "TcpSocket.h"
+#include "VertexCompression.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A processed surface patch, ready to be turned into a GAS by the renderer
+struct SpatialPatchUpdate
+{
+    uint64_t       id      = 0;
+    uint32_t       version = 0;
+    bool           removal = false;
+    PackedGeometry geometry;             // welded, decimated and packed, empty for a removal
+    size_t         input_triangles = 0;  // triangle count before decimation
+    std::chrono::steady_clock::time_point received;  // arrival of the chunk, for latency reports
+};
+
+/**
+       * Ingestion service for live spatial mapping meshes (see SpatialMeshProtocol.h).
+       *
+       * A network thread accepts one client at a time and reads surface chunks into a pending
+       * map that keeps only the newest version per patch id, so a burst of edits to the same patch
+       * is processed once. A worker thread welds, decimates (vertex clustering) and packs pending
+       * chunks into SpatialPatchUpdates. The render thread collects finished updates with poll()
+       * between frames - it never waits on the network or on mesh processing - and reports back
+       * with acknowledge() once a patch version is visible. Acks are queued and sent by the network
+       * thread, and a client that stalls in the middle of a message or stops reading acks for
+       * longer than a timeout is dropped, so neither rendering nor stop() waits on a client.
+*/
+class SpatialMeshIngest
+{
+public:
+    struct Settings
+    {
+        uint16_t       port      = 27015;
+        float          cell_size = 0.02f;  // decimation grid edge length in meters, 0 only welds
+        PositionFormat format    = POSITION_FLOAT3;
+    };
+
+    SpatialMeshIngest() = default;
+    explicit SpatialMeshIngest( const Settings& settings ) : m_settings( settings ) {}
+    ~SpatialMeshIngest() { stop(); }
+
+    SpatialMeshIngest( const SpatialMeshIngest& ) = delete;
+    SpatialMeshIngest& operator=( const SpatialMeshIngest& ) = delete;
+
+    // Settings only take effect on the next start()
+    Settings&       settings()       { return m_settings; }
+    const Settings& settings() const { return m_settings; }
+
+    // Open the port and start the threads; false if the port cannot be opened
+    bool start();
+    void stop();
+    bool running() const { return m_running; }
+
+    // Move out every finished update, at most one (the newest) per patch. Never blocks on processing.
+    void poll( std::vector<SpatialPatchUpdate>& updates );
+
+    // Tell the connected client that a patch version is visible. Never blocks on the network.
+    void acknowledge( uint64_t id, uint32_t version );
+
+private:
+    struct PendingChunk
+    {
+        SpatialChunk                          chunk;
+        std::chrono::steady_clock::time_point received;
+    };
+
+    void networkLoop();
+    void workerLoop();
+    // Network thread: send the queued acks, consume a wakeup from acknowledge()
+    void sendAcks();
+    bool consumeWakeup();
+
+    Settings                m_settings;
+    std::atomic<bool>       m_running{ false };
+    std::thread             m_network_thread;
+    std::thread             m_worker_thread;
+
+    TcpSocket               m_listener;
+    TcpSocket               m_client;         // replaced and closed by the network thread only
+    TcpSocket               m_wake_sender;    // acknowledge() wakes the network thread through this pair
+    TcpSocket               m_wake_receiver;
+    std::mutex              m_client_mutex;   // stop() shuts the client down from another thread
+
+    std::mutex                   m_ack_mutex;  // guards m_acks
+    std::vector<SpatialChunkAck> m_acks;
+
+    std::mutex              m_mutex;          // guards m_pending and m_ready
+    std::condition_variable m_pending_cv;
+    std::map<uint64_t, PendingChunk>       m_pending;
+    std::map<uint64_t, SpatialPatchUpdate> m_ready;
+    std::map<uint64_t, uint32_t>           m_latest_version;  // of the current client, network thread only
+};
@@ -0,0 +1,243 @@
+//
+// spatialMeshIngestTest - host tests of the spatial mapping wire format and ingestion service over
+// loopback: receiveSpatialChunk rejects malformed headers, the worker skips triangles with out of range
+// indices, a burst of versions of a patch ends with the newest and stale versions are dropped, chunks
+// without vertices remove their patch, acks reach the client, a reconnecting client numbers versions
+// from the start, and a client that stalls in the middle of a chunk is dropped.
+//
+
+#include "SpatialMeshIngest.h"
+#include "HostTest.h"
+
+#include <chrono>
+#include <map>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+// Send a raw header followed by nothing, as a misbehaving client would
+void sendHeader( TcpSocket& socket, uint32_t magic, uint32_t num_vertices, uint32_t num_indices )
+{
+    SpatialChunkHeader header;
+    header.magic        = magic;
+    header.version      = 1;
+    header.id           = 7;
+    header.num_vertices = num_vertices;
+    header.num_indices  = num_indices;
+    socket.sendAll( &header, sizeof( header ) );
+}
+
+void sendChunk( TcpSocket& socket, const SpatialChunk& chunk )
+{
+    std::vector<unsigned char> message;
+    encodeSpatialChunk( chunk, message );
+    socket.sendAll( message.data(), message.size() );
+}
+
+// Patch of one or more unit squares side by side, two triangles each
+SpatialChunk makePatch( uint64_t id, uint32_t version, unsigned int squares )
+{
+    SpatialChunk chunk;
+    chunk.id      = id;
+    chunk.version = version;
+    for( unsigned int i = 0; i <= squares; ++i )
+    {
+        chunk.vertices.push_back( make_float3( static_cast<float>( i ), 0.0f, 0.0f ) );
+        chunk.vertices.push_back( make_float3( static_cast<float>( i ), 1.0f, 0.0f ) );
+    }
+    for( uint32_t i = 0; i < squares; ++i )
+    {
+        const uint32_t a = 2 * i, b = 2 * i + 1, c = 2 * i + 2, d = 2 * i + 3;
+        chunk.indices.insert( chunk.indices.end(), { a, c, b, b, c, d } );
+    }
+    return chunk;
+}
+
+
+// A malformed header must be rejected from the header alone, not by waiting for a payload that never comes
+bool rejectedAtOnce( TcpSocket& server )
+{
+    SpatialChunk chunk;
+    const auto   start = std::chrono::steady_clock::now();
+    return !receiveSpatialChunk( server, chunk ) && std::chrono::steady_clock::now() - start < std::chrono::seconds( 1 );
+}
+
+
+void testReceiveChunk()
+{
+    TcpSocket client, server;
+    HOST_CHECK( TcpSocket::pair( client, server ) );
+    HOST_CHECK( server.setTimeout( 3000 ) );
+
+    // A well formed chunk arrives unchanged
+    const SpatialChunk sent = makePatch( 42, 3, 2 );
+    sendChunk( client, sent );
+    SpatialChunk received;
+    HOST_CHECK( receiveSpatialChunk( server, received ) );
+    HOST_CHECK( received.id == 42 && received.version == 3 && received.indices == sent.indices );
+    HOST_CHECK( received.vertices.size() == sent.vertices.size() && received.vertices[5].x == sent.vertices[5].x );
+
+    // So does a removal
+    SpatialChunk removal;
+    removal.id      = 42;
+    removal.version = 4;
+    sendChunk( client, removal );
+    HOST_CHECK( receiveSpatialChunk( server, received ) && received.removal() && received.indices.empty() );
+
+    // Bad magic, a partial triangle, too many vertices or indices: the stream is not trusted any further
+    sendHeader( client, SPATIAL_ACK_MAGIC, 3, 3 );
+    HOST_CHECK( rejectedAtOnce( server ) );
+    sendHeader( client, SPATIAL_CHUNK_MAGIC, 3, 4 );
+    HOST_CHECK( rejectedAtOnce( server ) );
+    sendHeader( client, SPATIAL_CHUNK_MAGIC, SPATIAL_MAX_CHUNK_VERTICES + 1, 3 );
+    HOST_CHECK( rejectedAtOnce( server ) );
+    sendHeader( client, SPATIAL_CHUNK_MAGIC, 3, SPATIAL_MAX_CHUNK_INDICES + 3 );
+    HOST_CHECK( rejectedAtOnce( server ) );
+
+    // A message cut short by the client closing the connection
+    std::vector<unsigned char> message;
+    encodeSpatialChunk( sent, message );
+    client.sendAll( message.data(), message.size() - 4 );
+    client.close();
+    HOST_CHECK( !receiveSpatialChunk( server, received ) );
+}
+
+
+// Ingestion service on a free port of the loopback interface
+bool startIngest( SpatialMeshIngest& ingest, uint16_t& port )
+{
+    ingest.settings().cell_size = 0.0f;  // only weld, the triangle counts stay exact
+    for( port = 27300; port < 27400; ++port )
+    {
+        ingest.settings().port = port;
+        if( ingest.start() )
+            return true;
+    }
+    return false;
+}
+
+// Poll until an update of the given patch version arrives, keeping every update seen on the way
+bool waitForUpdate( SpatialMeshIngest& ingest, uint64_t id, uint32_t version, std::vector<SpatialPatchUpdate>& seen )
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+    std::vector<SpatialPatchUpdate> updates;
+    while( std::chrono::steady_clock::now() < deadline )
+    {
+        ingest.poll( updates );
+        bool found = false;
+        for( SpatialPatchUpdate& update : updates )
+        {
+            found = found || ( update.id == id && update.version == version );
+            seen.push_back( std::move( update ) );
+        }
+        if( found )
+            return true;
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+    return false;
+}
+
+const SpatialPatchUpdate* find( const std::vector<SpatialPatchUpdate>& updates, uint64_t id, uint32_t version )
+{
+    for( const SpatialPatchUpdate& update : updates )
+        if( update.id == id && update.version == version )
+            return &update;
+    return nullptr;
+}
+
+
+void testIngest()
+{
+    SpatialMeshIngest ingest;
+    uint16_t          port = 0;
+    HOST_CHECK( startIngest( ingest, port ) );
+    TcpSocket client = TcpSocket::connect( "127.0.0.1", port );
+    HOST_CHECK( client.valid() );
+
+    // Triangles that reference missing vertices are skipped, the rest of the patch is kept
+    SpatialChunk partial = makePatch( 1, 1, 2 );
+    partial.indices.insert( partial.indices.end(), { 99, 0, 1, 0, 99, 1, 0, 1, 99 } );
+    sendChunk( client, partial );
+    std::vector<SpatialPatchUpdate> seen;
+    HOST_CHECK( waitForUpdate( ingest, 1, 1, seen ) );
+    const SpatialPatchUpdate* update = find( seen, 1, 1 );
+    HOST_CHECK( update && !update->removal && update->input_triangles == 7 );
+    HOST_CHECK( update && update->geometry.indices.size() == 4 && update->geometry.num_vertices == 6 );
+
+    // A patch whose triangles are all out of range is removed
+    SpatialChunk broken = makePatch( 2, 1, 1 );
+    for( uint32_t& index : broken.indices )
+        index += 1000;
+    sendChunk( client, broken );
+    HOST_CHECK( waitForUpdate( ingest, 2, 1, seen ) );
+    HOST_CHECK( find( seen, 2, 1 ) && find( seen, 2, 1 )->removal );
+
+    // A burst of versions ends with the newest, each version at most once and in order. Version 2 sent
+    // after version 5 is stale, patch 9 sent behind it shows that it was dropped.
+    seen.clear();
+    for( uint32_t version = 1; version <= 5; ++version )
+        sendChunk( client, makePatch( 3, version, version ) );
+    sendChunk( client, makePatch( 3, 2, 7 ) );
+    sendChunk( client, makePatch( 9, 1, 1 ) );
+    HOST_CHECK( waitForUpdate( ingest, 9, 1, seen ) );
+    std::vector<uint32_t> versions;
+    for( const SpatialPatchUpdate& seen_update : seen )
+        if( seen_update.id == 3 )
+            versions.push_back( seen_update.version );
+    HOST_CHECK( !versions.empty() && versions.back() == 5 && versions.size() <= 5 );
+    for( size_t i = 1; i < versions.size(); ++i )
+        HOST_CHECK( versions[i] > versions[i - 1] );
+    update = find( seen, 3, 5 );
+    HOST_CHECK( update && update->input_triangles == 10 );
+
+    // A chunk without vertices removes the patch
+    SpatialChunk removal;
+    removal.id      = 3;
+    removal.version = 6;
+    sendChunk( client, removal );
+    HOST_CHECK( waitForUpdate( ingest, 3, 6, seen ) );
+    HOST_CHECK( find( seen, 3, 6 )->removal && find( seen, 3, 6 )->geometry.indices.empty() );
+
+    // Acks reach the client in order
+    ingest.acknowledge( 3, 6 );
+    ingest.acknowledge( 9, 1 );
+    SpatialChunkAck acks[2] = {};
+    HOST_CHECK( client.waitReadable( 5000 ) && client.receiveAll( acks, sizeof( acks ) ) );
+    HOST_CHECK( acks[0].magic == SPATIAL_ACK_MAGIC && acks[0].id == 3 && acks[0].version == 6 );
+    HOST_CHECK( acks[1].magic == SPATIAL_ACK_MAGIC && acks[1].id == 9 && acks[1].version == 1 );
+
+    // A client that connects again, e.g. a replay that is run twice, starts over at version 1
+    client.close();
+    client = TcpSocket::connect( "127.0.0.1", port );
+    HOST_CHECK( client.valid() );
+    sendChunk( client, makePatch( 3, 1, 1 ) );
+    HOST_CHECK( waitForUpdate( ingest, 3, 1, seen ) );
+
+    // A client that sends half a header is dropped once the receive times out
+    const auto stalled = std::chrono::steady_clock::now();
+    client.sendAll( "SMCH", 4 );
+    char byte = 0;
+    HOST_CHECK( client.waitReadable( 10000 ) && !client.receiveAll( &byte, 1 ) );
+    HOST_CHECK( std::chrono::steady_clock::now() - stalled < std::chrono::seconds( 10 ) );
+
+    // stop() does not wait for a client stalled in the middle of a chunk either
+    client = TcpSocket::connect( "127.0.0.1", port );
+    std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+    client.sendAll( "SMCH", 4 );
+    std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+    const auto stopping = std::chrono::steady_clock::now();
+    ingest.stop();
+    HOST_CHECK( std::chrono::steady_clock::now() - stopping < std::chrono::seconds( 1 ) );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testReceiveChunk();
+    testIngest();
+    return hostTestResult( "spatialMeshIngestTest" );
+}
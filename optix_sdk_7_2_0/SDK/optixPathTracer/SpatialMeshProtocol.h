@@ -0,0 +1,99 @@
+#pragma once
+
+#include "TcpSocket.h"
+
+#include <vector_types.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+*   Wire format of the spatial mapping stream (little endian, no padding).
+*
+*   Client -> renderer, one message per changed surface patch:
+*       SpatialChunkHeader                          24 bytes
+*       float3   vertices[num_vertices]             world space, meters
+*       uint32_t indices[num_indices]               triangle list, num_indices % 3 == 0
+*   A chunk without vertices removes the patch. Versions increase per patch id; a chunk that is
+*   older than the newest version already received for its id on the same connection is dropped.
+*
+*   Renderer -> client, once a chunk is visible in the acceleration structure:
+*       SpatialChunkAck                             16 bytes
+*
+*   Recordings (see SpatialReplay.cpp) store the client messages, each preceded by a uint64_t
+*   timestamp in microseconds since the start of the scan.
+*/
+
+static const uint32_t SPATIAL_CHUNK_MAGIC = 0x48434d53u;  // "SMCH"
+static const uint32_t SPATIAL_ACK_MAGIC   = 0x4b434d53u;  // "SMCK"
+
+struct SpatialChunkHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t id;
+    uint32_t num_vertices;
+    uint32_t num_indices;
+};
+
+struct SpatialChunkAck
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t id;
+};
+
+struct SpatialChunk
+{
+    uint64_t              id      = 0;
+    uint32_t              version = 0;
+    std::vector<float3>   vertices;
+    std::vector<uint32_t> indices;
+
+    bool removal() const { return vertices.empty(); }
+};
+
+
+// Serialize a chunk message into out (replacing its contents)
+inline void encodeSpatialChunk( const SpatialChunk& chunk, std::vector<unsigned char>& out )
+{
+    SpatialChunkHeader header;
+    header.magic        = SPATIAL_CHUNK_MAGIC;
+    header.version      = chunk.version;
+    header.id           = chunk.id;
+    header.num_vertices = static_cast<uint32_t>( chunk.vertices.size() );
+    header.num_indices  = static_cast<uint32_t>( chunk.indices.size() );
+
+    const size_t vertex_bytes = chunk.vertices.size() * sizeof( float3 );
+    const size_t index_bytes  = chunk.indices.size() * sizeof( uint32_t );
+    out.resize( sizeof( header ) + vertex_bytes + index_bytes );
+    std::memcpy( out.data(), &header, sizeof( header ) );
+    if( vertex_bytes )
+        std::memcpy( out.data() + sizeof( header ), chunk.vertices.data(), vertex_bytes );
+    if( index_bytes )
+        std::memcpy( out.data() + sizeof( header ) + vertex_bytes, chunk.indices.data(), index_bytes );
+}
+
+
+// Upper bounds that keep a corrupt header from allocating unbounded memory
+static const uint32_t SPATIAL_MAX_CHUNK_VERTICES = 1u << 22;
+static const uint32_t SPATIAL_MAX_CHUNK_INDICES  = 3u << 23;
+
+// Read one chunk message; false when the connection closed or the stream is malformed
+inline bool receiveSpatialChunk( TcpSocket& socket, SpatialChunk& chunk )
+{
+    SpatialChunkHeader header;
+    if( !socket.receiveAll( &header, sizeof( header ) ) )
+        return false;
+    if( header.magic != SPATIAL_CHUNK_MAGIC || header.num_indices % 3 != 0
+        || header.num_vertices > SPATIAL_MAX_CHUNK_VERTICES || header.num_indices > SPATIAL_MAX_CHUNK_INDICES )
+        return false;
+
+    chunk.id      = header.id;
+    chunk.version = header.version;
+    chunk.vertices.resize( header.num_vertices );
+    chunk.indices.resize( header.num_indices );
+    return ( chunk.vertices.empty() || socket.receiveAll( chunk.vertices.data(), chunk.vertices.size() * sizeof( float3 ) ) )
+           && ( chunk.indices.empty() || socket.receiveAll( chunk.indices.data(), chunk.indices.size() * sizeof( uint32_t ) ) );
+}
@@ -0,0 +1,351 @@
+//
+// spatialReplay - replays a recorded spatial mapping session against optixPathTracer --spatial-port
+// and reports the latency from sending a surface chunk to the renderer acknowledging it, or
+// synthesizes such a recording (a scan of a room that refines its wall patches over time).
+//
+// Recording format: see SpatialMeshProtocol.h.
+//
+
+#include "SpatialMeshProtocol.h"
+#include "TcpSocket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct RecordedMessage
+{
+    uint64_t                   timestamp_us;
+    uint64_t                   id;
+    uint32_t                   version;
+    std::vector<unsigned char> bytes;
+};
+
+
+void printUsageAndExit( const char* argv0 )
+{
+    std::cerr << "Usage  : " << argv0 << " <recording> [options]\n";
+    std::cerr << "         " << argv0 << " --synthesize <recording> [synthesis options]\n";
+    std::cerr << "Options: --host <name>              Renderer host (default localhost)\n";
+    std::cerr << "         --port <port>              Renderer --spatial-port (default 27015)\n";
+    std::cerr << "         --speed <factor>           Replay speed, 0 sends as fast as possible (default 1)\n";
+    std::cerr << "Synthesis options:\n";
+    std::cerr << "         --patches <n>              Surface patches of the room (default 64)\n";
+    std::cerr << "         --updates <n>              Refinements per patch (default 8)\n";
+    std::cerr << "         --duration <seconds>       Length of the scan (default 20)\n";
+    std::cerr << "         --resolution <n>           Grid vertices per patch edge (default 48)\n";
+    exit( 0 );
+}
+
+
+bool readRecording( const std::string& filename, std::vector<RecordedMessage>& messages )
+{
+    std::ifstream in( filename, std::ios::binary );
+    if( !in )
+        return false;
+
+    for( ;; )
+    {
+        RecordedMessage    message;
+        SpatialChunkHeader header;
+        if( !in.read( reinterpret_cast<char*>( &message.timestamp_us ), sizeof( message.timestamp_us ) ) )
+            return true;
+        if( !in.read( reinterpret_cast<char*>( &header ), sizeof( header ) ) || header.magic != SPATIAL_CHUNK_MAGIC )
+            return false;
+
+        const size_t payload = header.num_vertices * sizeof( float3 ) + header.num_indices * sizeof( uint32_t );
+        message.id      = header.id;
+        message.version = header.version;
+        message.bytes.resize( sizeof( header ) + payload );
+        std::memcpy( message.bytes.data(), &header, sizeof( header ) );
+        if( payload && !in.read( reinterpret_cast<char*>( message.bytes.data() + sizeof( header ) ), payload ) )
+            return false;
+        messages.push_back( std::move( message ) );
+    }
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Synthetic scan: the walls, floor and ceiling of a 6 x 3 x 5 m room split into square patches.
+// Every patch is first seen as a coarse, noisy grid that gets finer and less noisy with each
+// update, as a spatial mapping system refines surfaces while the user looks around.
+//
+//------------------------------------------------------------------------------
+
+SpatialChunk synthesizePatch( uint64_t id, uint32_t version, uint32_t updates, int patches, int resolution, std::mt19937& rng )
+{
+    const float3 room = { 6.f, 3.f, 5.f };
+
+    // Distribute the patches over the six faces of the room
+    const int   per_face = std::max( 1, patches / 6 );
+    const int   face     = static_cast<int>( id % 6 );
+    const int   index    = static_cast<int>( id / 6 ) % per_face;
+    const int   tiles    = static_cast<int>( std::ceil( std::sqrt( static_cast<float>( per_face ) ) ) );
+    const float u0 = static_cast<float>( index % tiles ) / tiles, v0 = static_cast<float>( index / tiles ) / tiles;
+    const float extent = 1.f / tiles;
+
+    // Refinement: resolution and noise improve with every version
+    const float refinement = static_cast<float>( version ) / std::max( 1u, updates );
+    const int   n          = std::max( 2, static_cast<int>( resolution * ( 0.25f + 0.75f * refinement ) ) );
+    const float noise      = 0.02f * ( 1.f - 0.9f * refinement );
+    std::normal_distribution<float> jitter( 0.f, noise );
+
+    SpatialChunk chunk;
+    chunk.id      = id;
+    chunk.version = version;
+    for( int j = 0; j < n; ++j )
+    {
+        for( int i = 0; i < n; ++i )
+        {
+            const float u = u0 + extent * i / ( n - 1 ), v = v0 + extent * j / ( n - 1 );
+            const float d = jitter( rng );
+            float3      p;
+            switch( face )
+            {
+                case 0:  p = { u * room.x, v * room.y, d }; break;
+                case 1:  p = { u * room.x, v * room.y, room.z + d }; break;
+                case 2:  p = { d, v * room.y, u * room.z }; break;
+                case 3:  p = { room.x + d, v * room.y, u * room.z }; break;
+                case 4:  p = { u * room.x, d, v * room.z }; break;
+                default: p = { u * room.x, room.y + d, v * room.z }; break;
+            }
+            chunk.vertices.push_back( p );
+        }
+    }
+    for( int j = 0; j + 1 < n; ++j )
+    {
+        for( int i = 0; i + 1 < n; ++i )
+        {
+            const uint32_t a = j * n + i, b = a + 1, c = a + n, e = c + 1;
+            const uint32_t quad[6] = { a, b, e, a, e, c };
+            chunk.indices.insert( chunk.indices.end(), quad, quad + 6 );
+        }
+    }
+    return chunk;
+}
+
+
+int synthesize( const std::string& filename, int patches, int updates, float duration, int resolution )
+{
+    std::mt19937                          rng( 1234 );
+    std::uniform_real_distribution<float> uniform( 0.f, 1.f );
+
+    // Patches come into view one after another, their refinements spread over the rest of the scan
+    std::vector<std::pair<uint64_t, std::pair<uint64_t, uint32_t> > > schedule;
+    for( int p = 0; p < patches; ++p )
+    {
+        const float first = duration * 0.5f * p / patches;
+        for( int u = 1; u <= updates; ++u )
+        {
+            const float t = u == 1 ? first : first + ( duration - first ) * uniform( rng );
+            schedule.push_back( std::make_pair( static_cast<uint64_t>( t * 1e6f ), std::make_pair( static_cast<uint64_t>( p ), static_cast<uint32_t>( u ) ) ) );
+        }
+    }
+    std::sort( schedule.begin(), schedule.end() );
+
+    std::ofstream out( filename, std::ios::binary );
+    if( !out )
+    {
+        std::cerr << "Cannot write " << filename << std::endl;
+        return 1;
+    }
+
+    // Refinements were drawn independently per patch, so renumber versions in time order
+    std::map<uint64_t, uint32_t> versions;
+    std::vector<unsigned char>   bytes;
+    size_t                       triangles = 0;
+    for( const auto& entry : schedule )
+    {
+        const uint64_t id      = entry.second.first;
+        const uint32_t version = ++versions[id];
+        const SpatialChunk chunk = synthesizePatch( id, version, updates, patches, resolution, rng );
+        encodeSpatialChunk( chunk, bytes );
+        out.write( reinterpret_cast<const char*>( &entry.first ), sizeof( entry.first ) );
+        out.write( reinterpret_cast<const char*>( bytes.data() ), bytes.size() );
+        triangles += chunk.indices.size() / 3;
+    }
+
+    std::cout << "Wrote " << schedule.size() << " chunks (" << patches << " patches, " << triangles
+              << " triangles) over " << duration << " s to " << filename << std::endl;
+    return 0;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Replay
+//
+//------------------------------------------------------------------------------
+
+int replay( const std::string& filename, const std::string& host, uint16_t port, float speed )
+{
+    std::vector<RecordedMessage> messages;
+    if( !readRecording( filename, messages ) || messages.empty() )
+    {
+        std::cerr << "Cannot read recording " << filename << std::endl;
+        return 1;
+    }
+
+    TcpSocket socket = TcpSocket::connect( host, port );
+    if( !socket.valid() )
+    {
+        std::cerr << "Cannot connect to " << host << ":" << port << std::endl;
+        return 1;
+    }
+
+    // Send times per (id, version), matched against acknowledgements by the reader thread. The
+    // renderer only acknowledges the newest version of a patch it picked up in a frame, so an ack
+    // also covers the older versions of the same patch that were superseded.
+    typedef std::pair<uint64_t, uint32_t> Key;
+    std::mutex                     mutex;
+    std::map<Key, Clock::time_point> in_flight;
+    std::vector<double>            latencies_ms;
+    size_t                         superseded = 0;
+    bool                           done       = false;
+
+    std::thread reader( [&]() {
+        for( ;; )
+        {
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+                if( done || ( in_flight.empty() && latencies_ms.size() + superseded == messages.size() ) )
+                    return;
+            }
+            if( !socket.waitReadable( 100 ) )
+                continue;
+            SpatialChunkAck ack;
+            if( !socket.receiveAll( &ack, sizeof( ack ) ) || ack.magic != SPATIAL_ACK_MAGIC )
+                return;
+
+            const Clock::time_point now = Clock::now();
+            std::lock_guard<std::mutex> lock( mutex );
+            for( auto it = in_flight.lower_bound( Key( ack.id, 0 ) ); it != in_flight.end() && it->first.first == ack.id; )
+            {
+                if( it->first.second > ack.version )
+                    break;
+                if( it->first.second == ack.version )
+                    latencies_ms.push_back( std::chrono::duration<double, std::milli>( now - it->second ).count() );
+                else
+                    ++superseded;
+                it = in_flight.erase( it );
+            }
+        }
+    } );
+
+    std::cout << "Replaying " << messages.size() << " chunks to " << host << ":" << port << std::endl;
+    const Clock::time_point start = Clock::now();
+    for( const RecordedMessage& message : messages )
+    {
+        if( speed > 0.f )
+            std::this_thread::sleep_until( start + std::chrono::microseconds( static_cast<uint64_t>( message.timestamp_us / speed ) ) );
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            in_flight[Key( message.id, message.version )] = Clock::now();
+        }
+        if( !socket.sendAll( message.bytes.data(), message.bytes.size() ) )
+        {
+            std::cerr << "Connection lost" << std::endl;
+            break;
+        }
+    }
+
+    // Give the renderer a few seconds to acknowledge what is still in flight
+    const Clock::time_point deadline = Clock::now() + std::chrono::seconds( 5 );
+    for( ;; )
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            if( in_flight.empty() || Clock::now() > deadline )
+            {
+                done = true;
+                break;
+            }
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+    reader.join();
+
+    std::cout << "Acknowledged " << latencies_ms.size() << " chunks, " << superseded << " superseded before upload, "
+              << in_flight.size() << " unacknowledged" << std::endl;
+    if( latencies_ms.empty() )
+        return 1;
+
+    std::sort( latencies_ms.begin(), latencies_ms.end() );
+    double sum = 0.0;
+    for( double ms : latencies_ms )
+        sum += ms;
+    const auto percentile = [&]( double p ) { return latencies_ms[static_cast<size_t>( p * ( latencies_ms.size() - 1 ) )]; };
+    std::cout << std::fixed << std::setprecision( 2 ) << "Send to visible latency: mean " << sum / latencies_ms.size()
+              << " ms, p50 " << percentile( 0.5 ) << " ms, p95 " << percentile( 0.95 ) << " ms, max "
+              << latencies_ms.back() << " ms" << std::endl;
+    return 0;
+}
+
+
+int main( int argc, char* argv[] )
+{
+    std::string recording;
+    std::string host       = "localhost";
+    uint16_t    port       = 27015;
+    float       speed      = 1.f;
+    bool        synthesis  = false;
+    int         patches    = 64;
+    int         updates    = 8;
+    float       duration   = 20.f;
+    int         resolution = 48;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg = argv[i];
+        if( arg == "--help" || arg == "-h" )
+            printUsageAndExit( argv[0] );
+        else if( arg == "--synthesize" && i + 1 < argc )
+        {
+            synthesis = true;
+            recording = argv[++i];
+        }
+        else if( arg == "--host" && i + 1 < argc )
+            host = argv[++i];
+        else if( arg == "--port" && i + 1 < argc )
+            port = static_cast<uint16_t>( atoi( argv[++i] ) );
+        else if( arg == "--speed" && i + 1 < argc )
+            speed = static_cast<float>( atof( argv[++i] ) );
+        else if( arg == "--patches" && i + 1 < argc )
+            patches = std::max( 1, atoi( argv[++i] ) );
+        else if( arg == "--updates" && i + 1 < argc )
+            updates = std::max( 1, atoi( argv[++i] ) );
+        else if( arg == "--duration" && i + 1 < argc )
+            duration = std::max( 0.f, static_cast<float>( atof( argv[++i] ) ) );
+        else if( arg == "--resolution" && i + 1 < argc )
+            resolution = std::max( 2, atoi( argv[++i] ) );
+        else if( arg[0] != '-' && recording.empty() )
+            recording = arg;
+        else
+        {
+            std::cerr << "Unknown option '" << arg << "'\n";
+            printUsageAndExit( argv[0] );
+        }
+    }
+    if( recording.empty() )
+        printUsageAndExit( argv[0] );
+
+    if( synthesis )
+        return synthesize( recording, patches, updates, duration, resolution );
+    return replay( recording, host, port, speed );
+}
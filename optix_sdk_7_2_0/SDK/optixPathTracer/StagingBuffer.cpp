@@ -0,0 +1,71 @@
+#include "StagingBuffer.h"
+
+#include <sutil/Exception.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+
+CUdeviceptr StagingBuffer::upload( const void* data, size_t bytes )
+{
+    CUdeviceptr d_buffer = 0;
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_buffer ), bytes ) );
+    copy( d_buffer, data, bytes );
+    return d_buffer;
+}
+
+
+void StagingBuffer::copy( CUdeviceptr destination, const void* data, size_t bytes )
+{
+    if( !m_stream )
+    {
+        CUDA_CHECK( cudaStreamCreate( &m_stream ) );
+        for( int half = 0; half < 2; ++half )
+        {
+            CUDA_CHECK( cudaMallocHost( reinterpret_cast<void**>( &m_host[half] ), m_chunk_bytes ) );
+            CUDA_CHECK( cudaEventCreateWithFlags( &m_free[half], cudaEventDisableTiming ) );
+        }
+    }
+
+    const char* source = static_cast<const char*>( data );
+    for( size_t offset = 0; offset < bytes; offset += m_chunk_bytes )
+    {
+        const size_t size = std::min( m_chunk_bytes, bytes - offset );
+        const unsigned half = m_next;
+        m_next ^= 1u;
+
+        // The previous copy out of this half has to be done before it is overwritten
+        CUDA_CHECK( cudaEventSynchronize( m_free[half] ) );
+        memcpy( m_host[half], source + offset, size );
+        CUDA_CHECK( cudaMemcpyAsync( reinterpret_cast<void*>( destination + offset ), m_host[half], size,
+                                     cudaMemcpyHostToDevice, m_stream ) );
+        CUDA_CHECK( cudaEventRecord( m_free[half], m_stream ) );
+    }
+    m_bytes_uploaded += bytes;
+}
+
+
+void StagingBuffer::synchronize()
+{
+    if( m_stream )
+        CUDA_CHECK( cudaStreamSynchronize( m_stream ) );
+}
+
+
+void StagingBuffer::release()
+{
+    if( !m_stream )
+        return;
+    // Also runs from the destructor, so errors terminate instead of throwing
+    CUDA_CHECK_NOTHROW( cudaStreamSynchronize( m_stream ) );
+    for( int half = 0; half < 2; ++half )
+    {
+        CUDA_CHECK_NOTHROW( cudaFreeHost( m_host[half] ) );
+        CUDA_CHECK_NOTHROW( cudaEventDestroy( m_free[half] ) );
+        m_host[half] = nullptr;
+        m_free[half] = 0;
+    }
+    CUDA_CHECK_NOTHROW( cudaStreamDestroy( m_stream ) );
+    m_stream = 0;
+}
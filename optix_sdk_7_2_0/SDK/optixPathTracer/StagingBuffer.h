@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cuda.h>
+#include <cuda_runtime.h>
+
+#include <cstddef>
+
+/**
+       * Host to device uploads through pinned memory.
+       *
+       * Data is copied in chunks into one of two pinned halves, and each half is handed to
+       * cudaMemcpyAsync on a stream of its own while the CPU fills the other one. upload() returns once
+       * the last chunk is queued, so the host can go on with the next mesh while the DMA finishes. The
+       * stream is a blocking one: work issued afterwards to the legacy default stream, such as the GAS
+       * builds, cudaMemcpy and cudaFree, is ordered after the copies.
+       *
+       * Not thread safe; the startup graph keeps all uploads on the main thread. Buffers are allocated
+       * on first use and kept until release().
+*/
+class StagingBuffer
+{
+public:
+    explicit StagingBuffer( size_t chunk_bytes = 4u << 20 ) : m_chunk_bytes( chunk_bytes ) {}
+    ~StagingBuffer() { release(); }
+
+    StagingBuffer( const StagingBuffer& ) = delete;
+    StagingBuffer& operator=( const StagingBuffer& ) = delete;
+
+    // Allocate bytes of device memory and queue the copy of data into it
+    CUdeviceptr upload( const void* data, size_t bytes );
+
+    // Queue the copy of bytes from data to destination
+    void copy( CUdeviceptr destination, const void* data, size_t bytes );
+
+    // Wait until every queued copy arrived
+    void synchronize();
+
+    // Wait for the copies and free the pinned memory, the stream and the events
+    void release();
+
+    size_t bytesUploaded() const { return m_bytes_uploaded; }
+
+private:
+    size_t       m_chunk_bytes;
+    char*        m_host[2] = {};
+    cudaEvent_t  m_free[2] = {};  // recorded after the copy out of each half
+    cudaStream_t m_stream  = 0;
+    unsigned     m_next    = 0;
+    size_t       m_bytes_uploaded = 0;
+};
@@ -0,0 +1,149 @@
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+
+
+TaskGraph::TaskId TaskGraph::add( const std::string& name, std::function<void()> work, const std::vector<TaskId>& dependencies,
+                                  Affinity affinity )
+{
+    const TaskId id = m_tasks.size();
+    for( TaskId dependency : dependencies )
+        if( dependency >= id )
+            throw std::invalid_argument( "TaskGraph: " + name + " depends on a task that was not added before it" );
+
+    Task task;
+    task.work             = std::move( work );
+    task.affinity         = affinity;
+    task.num_dependencies = dependencies.size();
+    m_tasks.push_back( std::move( task ) );
+    for( TaskId dependency : dependencies )
+        m_tasks[dependency].dependents.push_back( id );
+
+    TimelineEntry entry;
+    entry.name = name;
+    m_timeline.push_back( entry );
+    return id;
+}
+
+
+void TaskGraph::run( unsigned num_workers )
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+
+    std::mutex              mutex;
+    std::condition_variable changed;
+    std::deque<TaskId>      ready[2];  // by Affinity
+    std::vector<size_t>     waiting_for( m_tasks.size() );
+    size_t                  finished = 0, running = 0;
+    std::exception_ptr      error;
+
+    for( TaskId id = 0; id < m_tasks.size(); ++id )
+    {
+        m_timeline[id].ran = false;
+        waiting_for[id]    = m_tasks[id].num_dependencies;
+        if( waiting_for[id] == 0 )
+            ready[m_tasks[id].affinity].push_back( id );
+    }
+
+    // Every thread runs this loop on its own queue until all tasks finished or one failed
+    const auto process = [&]( Affinity affinity, unsigned thread ) {
+        std::unique_lock<std::mutex> lock( mutex );
+        for( ;; )
+        {
+            changed.wait( lock, [&] {
+                return ( !ready[affinity].empty() && !error ) || finished == m_tasks.size() || ( error && running == 0 );
+            } );
+            if( ready[affinity].empty() || error )
+                return;
+
+            const TaskId id = ready[affinity].front();
+            ready[affinity].pop_front();
+            ++running;
+            lock.unlock();
+
+            TimelineEntry& entry = m_timeline[id];
+            entry.thread         = thread;
+            entry.start_ms       = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+            std::exception_ptr task_error;
+            try
+            {
+                if( m_tasks[id].work )
+                    m_tasks[id].work();
+            }
+            catch( ... )
+            {
+                task_error = std::current_exception();
+            }
+            entry.end_ms = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+            entry.ran    = true;
+
+            lock.lock();
+            --running;
+            ++finished;
+            if( task_error && !error )
+                error = task_error;
+            for( TaskId dependent : m_tasks[id].dependents )
+                if( --waiting_for[dependent] == 0 )
+                    ready[m_tasks[dependent].affinity].push_back( dependent );
+            changed.notify_all();
+        }
+    };
+
+    // No more workers than there are tasks for them
+    size_t num_worker_tasks = 0;
+    for( const Task& task : m_tasks )
+        num_worker_tasks += task.affinity == ANY_THREAD;
+    if( num_workers == 0 )
+        num_workers = std::max( 1u, std::thread::hardware_concurrency() );
+    num_workers = static_cast<unsigned>( std::min<size_t>( num_workers, num_worker_tasks ) );
+
+    std::vector<std::thread> workers;
+    for( unsigned i = 0; i < num_workers; ++i )
+        workers.emplace_back( process, ANY_THREAD, i + 1 );
+    process( MAIN_THREAD, 0 );
+    for( std::thread& worker : workers )
+        worker.join();
+
+    if( error )
+        std::rethrow_exception( error );
+}
+
+
+void TaskGraph::printTimeline( std::ostream& out, const std::string& title ) const
+{
+    const int bar_width = 40;
+    double    total_ms  = 0.0;
+    size_t    name_width = 4;
+    for( const TimelineEntry& entry : m_timeline )
+    {
+        total_ms   = std::max( total_ms, entry.end_ms );
+        name_width = std::max( name_width, entry.name.size() );
+    }
+
+    out << title << " (" << std::fixed << std::setprecision( 1 ) << total_ms << " ms, thread 0 is the main thread)\n";
+    for( const TimelineEntry& entry : m_timeline )
+    {
+        out << "  " << std::left << std::setw( static_cast<int>( name_width ) ) << entry.name << std::right;
+        if( !entry.ran )
+        {
+            out << "  not run\n";
+            continue;
+        }
+        const int first = total_ms > 0.0 ? static_cast<int>( entry.start_ms / total_ms * bar_width ) : 0;
+        const int last  = total_ms > 0.0 ? std::max( first + 1, static_cast<int>( entry.end_ms / total_ms * bar_width + 0.5 ) ) : 1;
+        out << "  t" << std::setw( 2 ) << std::left << entry.thread << std::right << std::setw( 9 ) << entry.start_ms << " - "
+            << std::setw( 9 ) << entry.end_ms << " ms  |" << std::string( first, ' ' )
+            << std::string( std::min( last, bar_width ) - first, '#' ) << std::string( bar_width - std::min( last, bar_width ), ' ' ) << "|\n";
+    }
+    out.flush();
+}
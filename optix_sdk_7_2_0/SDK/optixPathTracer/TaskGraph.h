@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/**
+       * One-shot dependency scheduler, used for the startup pipeline.
+       *
+       * Tasks are added together with the tasks they depend on, which must have been added before,
+       * so a graph can never contain a cycle. run() executes every task once all of its dependencies
+       * finished: ANY_THREAD tasks on a pool of worker threads, MAIN_THREAD tasks on the thread that
+       * called run() (for work that has to stay there, e.g. GL or the order of device uploads). The
+       * main thread only runs MAIN_THREAD tasks, so a long worker task never delays them.
+       *
+       * If a task throws, no further task is started; run() waits for the running ones and rethrows
+       * the first exception. The start and end of every task are recorded for timeline().
+*/
+class TaskGraph
+{
+public:
+    typedef size_t TaskId;
+
+    enum Affinity
+    {
+        ANY_THREAD,
+        MAIN_THREAD
+    };
+
+    struct TimelineEntry
+    {
+        std::string name;
+        unsigned    thread   = 0;    // 0 is the thread that called run(), workers count from 1
+        double      start_ms = 0.0;  // relative to the start of run()
+        double      end_ms   = 0.0;
+        bool        ran      = false;
+    };
+
+    TaskId add( const std::string& name, std::function<void()> work, const std::vector<TaskId>& dependencies = {},
+                Affinity affinity = ANY_THREAD );
+
+    // Run every task; num_workers 0 means std::thread::hardware_concurrency()
+    void run( unsigned num_workers = 0 );
+
+    size_t size() const { return m_tasks.size(); }
+
+    // One entry per task, in the order they were added
+    const std::vector<TimelineEntry>& timeline() const { return m_timeline; }
+
+    // Table of the timeline with a bar per task
+    void printTimeline( std::ostream& out, const std::string& title ) const;
+
+private:
+    struct Task
+    {
+        std::function<void()> work;
+        Affinity              affinity;
+        size_t                num_dependencies;
+        std::vector<TaskId>   dependents;
+    };
+
+    std::vector<Task>          m_tasks;
+    std::vector<TimelineEntry> m_timeline;
+};
@@ -0,0 +1,228 @@
+//
+// taskGraphTest - host tests of the startup scheduler in TaskGraph.h: every task starts after its
+// dependencies finished, MAIN_THREAD tasks run on the thread that called run() and only there, the
+// first exception is rethrown without starting its dependents, and graphs without worker tasks or
+// with dependencies on later tasks are handled.
+//
+
+#include "TaskGraph.h"
+#include "HostTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+// Sequence numbers of task starts and ends, shared by all threads
+struct Trace
+{
+    std::atomic<int> clock{ 0 };
+    std::vector<int> start, end;
+    std::vector<std::thread::id> thread;
+
+    explicit Trace( size_t num_tasks )
+        : start( num_tasks, -1 )
+        , end( num_tasks, -1 )
+        , thread( num_tasks )
+    {
+    }
+
+    std::function<void()> task( size_t id, int sleep_us = 0 )
+    {
+        return [this, id, sleep_us]() {
+            start[id]  = clock++;
+            thread[id] = std::this_thread::get_id();
+            if( sleep_us > 0 )
+                std::this_thread::sleep_for( std::chrono::microseconds( sleep_us ) );
+            end[id] = clock++;
+        };
+    }
+};
+
+
+void testDependencyOrder()
+{
+    // Random graphs of 200 tasks with up to four dependencies each, a fifth of them on the main thread
+    std::mt19937 rng( 42 );
+    for( int graph_index = 0; graph_index < 10; ++graph_index )
+    {
+        const size_t                     num_tasks = 200;
+        Trace                            trace( num_tasks );
+        TaskGraph                        graph;
+        std::vector<std::vector<size_t>> dependencies( num_tasks );
+        for( size_t id = 0; id < num_tasks; ++id )
+        {
+            for( int d = 0; id > 0 && d < static_cast<int>( rng() % 5 ); ++d )
+                dependencies[id].push_back( rng() % id );
+            const TaskGraph::Affinity affinity = rng() % 5 == 0 ? TaskGraph::MAIN_THREAD : TaskGraph::ANY_THREAD;
+            HOST_CHECK( graph.add( "task " + std::to_string( id ), trace.task( id, rng() % 200 ), dependencies[id], affinity ) == id );
+        }
+        graph.run( 4 );
+
+        for( size_t id = 0; id < num_tasks; ++id )
+        {
+            HOST_CHECK( trace.start[id] >= 0 && trace.end[id] > trace.start[id] && graph.timeline()[id].ran );
+            for( size_t dependency : dependencies[id] )
+                HOST_CHECK( trace.end[dependency] < trace.start[id] );
+        }
+    }
+
+    // A diamond runs its middle tasks in parallel; a second run() runs everything again
+    Trace     trace( 4 );
+    TaskGraph graph;
+    const TaskGraph::TaskId top    = graph.add( "top", trace.task( 0 ) );
+    const TaskGraph::TaskId left   = graph.add( "left", trace.task( 1, 20000 ), { top } );
+    const TaskGraph::TaskId right  = graph.add( "right", trace.task( 2, 20000 ), { top } );
+    graph.add( "bottom", trace.task( 3 ), { left, right } );
+    for( int pass = 0; pass < 2; ++pass )
+    {
+        graph.run( 2 );
+        HOST_CHECK( trace.end[0] < trace.start[1] && trace.end[0] < trace.start[2] );
+        HOST_CHECK( trace.start[1] < trace.end[2] && trace.start[2] < trace.end[1] );
+        HOST_CHECK( trace.end[1] < trace.start[3] && trace.end[2] < trace.start[3] );
+        const TaskGraph::TimelineEntry& bottom = graph.timeline()[3];
+        HOST_CHECK( bottom.ran && bottom.start_ms >= graph.timeline()[1].end_ms && bottom.start_ms >= graph.timeline()[2].end_ms );
+    }
+}
+
+
+void testMainThreadAffinity()
+{
+    const std::thread::id main_thread = std::this_thread::get_id();
+    const size_t          num_tasks   = 60;
+    Trace                 trace( num_tasks );
+    TaskGraph             graph;
+    for( size_t id = 0; id < num_tasks; ++id )
+    {
+        // Main thread tasks interleaved with chains of slow worker tasks that feed them
+        const std::vector<TaskGraph::TaskId> dependencies = id >= 3 ? std::vector<TaskGraph::TaskId>{ id - 3 } : std::vector<TaskGraph::TaskId>{};
+        graph.add( "task", trace.task( id, 1000 ), dependencies, id % 3 == 0 ? TaskGraph::MAIN_THREAD : TaskGraph::ANY_THREAD );
+    }
+    graph.run( 3 );
+
+    for( size_t id = 0; id < num_tasks; ++id )
+    {
+        const TaskGraph::TimelineEntry& entry = graph.timeline()[id];
+        if( id % 3 == 0 )
+            HOST_CHECK( trace.thread[id] == main_thread && entry.thread == 0 );
+        else
+            HOST_CHECK( trace.thread[id] != main_thread && entry.thread >= 1 && entry.thread <= 3 );
+    }
+}
+
+
+void testFirstExceptionStopsDependents()
+{
+    // fail throws once the others started, late throws after it, slow is still running then
+    std::atomic<int>  started( 0 );
+    std::atomic<bool> failed( false );
+    std::atomic<int>  dependents_started( 0 );
+    TaskGraph         graph;
+    const TaskGraph::TaskId fail = graph.add( "fail", [&]() {
+        while( started < 2 )
+            std::this_thread::yield();
+        failed = true;
+        throw std::runtime_error( "first" );
+    } );
+    graph.add( "late", [&]() {
+        ++started;
+        while( !failed )
+            std::this_thread::yield();
+        std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+        throw std::runtime_error( "second" );
+    } );
+    const TaskGraph::TaskId slow = graph.add( "slow", [&]() {
+        ++started;
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+    } );
+    const TaskGraph::TaskId after_fail = graph.add( "after fail", [&]() { ++dependents_started; }, { fail } );
+    graph.add( "after both", [&]() { ++dependents_started; }, { after_fail, slow } );
+    graph.add( "main after fail", [&]() { ++dependents_started; }, { fail }, TaskGraph::MAIN_THREAD );
+
+    std::string message;
+    try
+    {
+        graph.run( 3 );
+    }
+    catch( const std::runtime_error& e )
+    {
+        message = e.what();
+    }
+    HOST_CHECK( message == "first" );
+    HOST_CHECK( dependents_started == 0 );
+
+    // run() waited for the tasks that were running
+    const std::vector<TaskGraph::TimelineEntry>& timeline = graph.timeline();
+    HOST_CHECK( timeline[0].ran && timeline[1].ran && timeline[2].ran );
+    HOST_CHECK( !timeline[3].ran && !timeline[4].ran && !timeline[5].ran );
+}
+
+
+void testWithoutWorkerTasks()
+{
+    // Only main thread tasks: no workers are started whatever num_workers says
+    const std::thread::id main_thread = std::this_thread::get_id();
+    Trace                 trace( 5 );
+    TaskGraph             graph;
+    for( size_t id = 0; id < 5; ++id )
+        graph.add( "main", trace.task( id ), id > 0 ? std::vector<TaskGraph::TaskId>{ id - 1 } : std::vector<TaskGraph::TaskId>{},
+                   TaskGraph::MAIN_THREAD );
+    graph.run( 8 );
+    for( size_t id = 0; id < 5; ++id )
+    {
+        HOST_CHECK( trace.thread[id] == main_thread && graph.timeline()[id].thread == 0 );
+        HOST_CHECK( id == 0 || trace.end[id - 1] < trace.start[id] );
+    }
+
+    // No more workers than worker tasks: the one worker task gets worker 1 even after all of them waited
+    TaskGraph one;
+    const TaskGraph::TaskId wait = one.add( "wait", []() { std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) ); }, {},
+                                            TaskGraph::MAIN_THREAD );
+    one.add( "worker", []() {}, { wait } );
+    one.run( 16 );
+    HOST_CHECK( one.timeline()[0].thread == 0 && one.timeline()[1].thread == 1 );
+
+    // Empty graphs and tasks without work
+    TaskGraph empty;
+    empty.run();
+    HOST_CHECK( empty.size() == 0 && empty.timeline().empty() );
+    TaskGraph nothing;
+    nothing.add( "nothing", std::function<void()>() );
+    nothing.run();
+    HOST_CHECK( nothing.timeline()[0].ran );
+}
+
+
+void testForwardDependencies()
+{
+    TaskGraph               graph;
+    const TaskGraph::TaskId first = graph.add( "first", []() {} );
+    HOST_CHECK_THROWS( graph.add( "self", []() {}, { first + 1 } ), std::invalid_argument );
+    HOST_CHECK_THROWS( graph.add( "later", []() {}, { first, 7 } ), std::invalid_argument );
+    HOST_CHECK( graph.size() == 1 && graph.timeline().size() == 1 );
+
+    // The rejected tasks left no dangling dependents behind
+    bool ran = false;
+    graph.add( "second", [&]() { ran = true; }, { first } );
+    graph.run( 2 );
+    HOST_CHECK( ran && graph.size() == 2 );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testDependencyOrder();
+    testMainThreadAffinity();
+    testFirstExceptionStopsDependents();
+    testWithoutWorkerTasks();
+    testForwardDependencies();
+    return hostTestResult( "taskGraphTest" );
+}
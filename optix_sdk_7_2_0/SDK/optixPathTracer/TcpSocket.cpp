@@ -0,0 +1,254 @@
+#include "TcpSocket.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment( lib, "Ws2_32.lib" )
+typedef int socklen_t;
+#define MSG_NOSIGNAL 0
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+namespace
+{
+
+#ifdef _WIN32
+// WSAStartup once per process, WSACleanup at exit
+struct WinsockInit
+{
+    WinsockInit()
+    {
+        WSADATA data;
+        WSAStartup( MAKEWORD( 2, 2 ), &data );
+    }
+    ~WinsockInit() { WSACleanup(); }
+};
+
+void ensureInit()
+{
+    static WinsockInit init;
+}
+
+void closeHandle( uintptr_t handle )
+{
+    closesocket( static_cast<SOCKET>( handle ) );
+}
+#else
+void ensureInit() {}
+
+void closeHandle( int handle )
+{
+    ::close( handle );
+}
+#endif
+
+}  // namespace
+
+
+TcpSocket& TcpSocket::operator=( TcpSocket&& other )
+{
+    if( this != &other )
+    {
+        close();
+        m_handle       = other.m_handle;
+        other.m_handle = INVALID;
+    }
+    return *this;
+}
+
+
+void TcpSocket::close()
+{
+    if( m_handle != INVALID )
+        closeHandle( m_handle );
+    m_handle = INVALID;
+}
+
+
+void TcpSocket::shutdown()
+{
+#ifdef _WIN32
+    if( m_handle != INVALID )
+        ::shutdown( static_cast<SOCKET>( m_handle ), SD_BOTH );
+#else
+    if( m_handle != INVALID )
+        ::shutdown( m_handle, SHUT_RDWR );
+#endif
+}
+
+
+TcpSocket TcpSocket::listen( uint16_t port )
+{
+    ensureInit();
+    TcpSocket socket( static_cast<Handle>( ::socket( AF_INET, SOCK_STREAM, IPPROTO_TCP ) ) );
+    if( !socket.valid() )
+        return socket;
+
+    const int reuse = 1;
+    setsockopt( socket.m_handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>( &reuse ), sizeof( reuse ) );
+
+    sockaddr_in address = {};
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_ANY );
+    address.sin_port        = htons( port );
+    if( ::bind( socket.m_handle, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) != 0
+        || ::listen( socket.m_handle, 1 ) != 0 )
+        socket.close();
+    return socket;
+}
+
+
+TcpSocket TcpSocket::connect( const std::string& host, uint16_t port )
+{
+    ensureInit();
+    addrinfo hints = {};
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    addrinfo* result = nullptr;
+    if( getaddrinfo( host.c_str(), std::to_string( port ).c_str(), &hints, &result ) != 0 )
+        return TcpSocket();
+
+    TcpSocket socket;
+    for( addrinfo* a = result; a && !socket.valid(); a = a->ai_next )
+    {
+        socket = TcpSocket( static_cast<Handle>( ::socket( a->ai_family, a->ai_socktype, a->ai_protocol ) ) );
+        if( socket.valid() && ::connect( socket.m_handle, a->ai_addr, static_cast<socklen_t>( a->ai_addrlen ) ) != 0 )
+            socket.close();
+    }
+    freeaddrinfo( result );
+
+    // Chunks and acknowledgements are small, latency matters more than throughput
+    if( socket.valid() )
+    {
+        const int no_delay = 1;
+        setsockopt( socket.m_handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>( &no_delay ), sizeof( no_delay ) );
+    }
+    return socket;
+}
+
+
+bool TcpSocket::pair( TcpSocket& a, TcpSocket& b )
+{
+    // socketpair() is not available on Windows, connect through a listener on an ephemeral port
+    ensureInit();
+    TcpSocket listener( static_cast<Handle>( ::socket( AF_INET, SOCK_STREAM, IPPROTO_TCP ) ) );
+    if( !listener.valid() )
+        return false;
+
+    sockaddr_in address     = {};
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    address.sin_port        = 0;
+    socklen_t length        = sizeof( address );
+    if( ::bind( listener.m_handle, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) != 0
+        || ::listen( listener.m_handle, 1 ) != 0
+        || getsockname( listener.m_handle, reinterpret_cast<sockaddr*>( &address ), &length ) != 0 )
+        return false;
+
+    a = TcpSocket( static_cast<Handle>( ::socket( AF_INET, SOCK_STREAM, IPPROTO_TCP ) ) );
+    if( !a.valid() || ::connect( a.m_handle, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) != 0 )
+    {
+        a.close();
+        return false;
+    }
+    b = listener.accept();
+    if( !b.valid() )
+    {
+        a.close();
+        return false;
+    }
+    const int no_delay = 1;
+    setsockopt( a.m_handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>( &no_delay ), sizeof( no_delay ) );
+    return true;
+}
+
+
+TcpSocket TcpSocket::accept()
+{
+    TcpSocket client( static_cast<Handle>( ::accept( m_handle, nullptr, nullptr ) ) );
+    if( client.valid() )
+    {
+        const int no_delay = 1;
+        setsockopt( client.m_handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>( &no_delay ), sizeof( no_delay ) );
+    }
+    return client;
+}
+
+
+bool TcpSocket::waitReadable( int timeout_ms, const TcpSocket* wake ) const
+{
+    if( !valid() )
+        return false;
+    fd_set read_set;
+    FD_ZERO( &read_set );
+    FD_SET( m_handle, &read_set );
+    Handle max_handle = m_handle;
+    if( wake && wake->valid() )
+    {
+        FD_SET( wake->m_handle, &read_set );
+        max_handle = wake->m_handle > max_handle ? wake->m_handle : max_handle;
+    }
+    timeval timeout;
+    timeout.tv_sec  = timeout_ms / 1000;
+    timeout.tv_usec = ( timeout_ms % 1000 ) * 1000;
+    return ::select( static_cast<int>( max_handle + 1 ), &read_set, nullptr, nullptr, &timeout ) > 0;
+}
+
+
+bool TcpSocket::setTimeout( int timeout_ms )
+{
+#ifdef _WIN32
+    const DWORD timeout = static_cast<DWORD>( timeout_ms );
+#else
+    timeval timeout;
+    timeout.tv_sec  = timeout_ms / 1000;
+    timeout.tv_usec = ( timeout_ms % 1000 ) * 1000;
+#endif
+    const char* value = reinterpret_cast<const char*>( &timeout );
+    return valid() && setsockopt( m_handle, SOL_SOCKET, SO_RCVTIMEO, value, sizeof( timeout ) ) == 0
+           && setsockopt( m_handle, SOL_SOCKET, SO_SNDTIMEO, value, sizeof( timeout ) ) == 0;
+}
+
+
+bool TcpSocket::sendAll( const void* data, size_t size )
+{
+    // A peer that went away must fail the send, not raise SIGPIPE
+    const char* bytes = static_cast<const char*>( data );
+    while( size > 0 )
+    {
+        const int sent = static_cast<int>( ::send( m_handle, bytes, static_cast<int>( size ), MSG_NOSIGNAL ) );
+        if( sent <= 0 )
+            return false;
+        bytes += sent;
+        size -= static_cast<size_t>( sent );
+    }
+    return true;
+}
+
+
+bool TcpSocket::receiveAll( void* data, size_t size )
+{
+    char* bytes = static_cast<char*>( data );
+    while( size > 0 )
+    {
+        const int received = static_cast<int>( ::recv( m_handle, bytes, static_cast<int>( size ), 0 ) );
+        if( received <= 0 )
+            return false;
+        bytes += received;
+        size -= static_cast<size_t>( received );
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+       * Minimal blocking TCP socket over Winsock2 or BSD sockets.
+       *
+       * Only what the spatial mapping ingestion and its replay tool need: listen/accept on a port,
+       * connect to a host, send and receive exact byte counts, and wait for readability with a
+       * timeout so that service threads can notice a shutdown request. A connected pair over
+       * loopback lets another thread wake such a wait. Sockets are move-only and close themselves
+       * on destruction.
+*/
+class TcpSocket
+{
+public:
+    TcpSocket() = default;
+    ~TcpSocket() { close(); }
+
+    TcpSocket( TcpSocket&& other ) : m_handle( other.m_handle ) { other.m_handle = INVALID; }
+    TcpSocket& operator=( TcpSocket&& other );
+
+    TcpSocket( const TcpSocket& ) = delete;
+    TcpSocket& operator=( const TcpSocket& ) = delete;
+
+    // Listening socket on all interfaces; invalid on failure
+    static TcpSocket listen( uint16_t port );
+    // Connected socket; invalid on failure
+    static TcpSocket connect( const std::string& host, uint16_t port );
+    // Two sockets connected to each other over loopback; false on failure
+    static bool pair( TcpSocket& a, TcpSocket& b );
+
+    // Accept a pending connection of a listening socket; invalid on failure
+    TcpSocket accept();
+
+    // Returns true when a read (or accept) will not block, or when wake (if valid) is readable; false
+    // on timeout or error
+    bool waitReadable( int timeout_ms, const TcpSocket* wake = nullptr ) const;
+
+    // Make each send or receive call fail after blocking for timeout_ms; false on failure
+    bool setTimeout( int timeout_ms );
+
+    // Send or receive exactly size bytes; false when the connection closed, failed or timed out
+    bool sendAll( const void* data, size_t size );
+    bool receiveAll( void* data, size_t size );
+
+    bool valid() const { return m_handle != INVALID; }
+    void close();
+    // End the connection in both directions, a send or receive blocked in another thread returns
+    void shutdown();
+
+private:
+#ifdef _WIN32
+    typedef uintptr_t Handle;  // SOCKET
+#else
+    typedef int Handle;
+#endif
+    static const Handle INVALID = static_cast<Handle>( -1 );
+
+    explicit TcpSocket( Handle handle ) : m_handle( handle ) {}
+
+    Handle m_handle = INVALID;
+};
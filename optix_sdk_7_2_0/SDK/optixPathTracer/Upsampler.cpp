@@ -0,0 +1,216 @@
+#include "Upsampler.h"
+#include "HostImageUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define UPSAMPLER_USE_SSE
+#endif
+
+//------------------------------------------------------------------------------
+//
+// 4-wide float helpers - either one texel (rgba) or one channel of four taps per register
+//
+//------------------------------------------------------------------------------
+
+#ifdef UPSAMPLER_USE_SSE
+typedef __m128 vec4;
+static inline vec4 load4( const float* p )            { return _mm_loadu_ps( p ); }
+static inline void store4( float* p, vec4 v )         { _mm_storeu_ps( p, v ); }
+static inline vec4 splat4( float s )                  { return _mm_set1_ps( s ); }
+static inline vec4 set4( float x, float y, float z, float w ) { return _mm_set_ps( w, z, y, x ); }
+static inline vec4 add4( vec4 a, vec4 b )             { return _mm_add_ps( a, b ); }
+static inline vec4 sub4( vec4 a, vec4 b )             { return _mm_sub_ps( a, b ); }
+static inline vec4 mul4( vec4 a, vec4 b )             { return _mm_mul_ps( a, b ); }
+static inline vec4 abs4( vec4 a )                     { return _mm_andnot_ps( _mm_set1_ps( -0.f ), a ); }
+static inline void transpose4( vec4& a, vec4& b, vec4& c, vec4& d ) { _MM_TRANSPOSE4_PS( a, b, c, d ); }
+
+// a where d > 0, zero otherwise
+static inline vec4 maskPositive4( vec4 a, vec4 d )    { return _mm_and_ps( a, _mm_cmpgt_ps( d, _mm_setzero_ps() ) ); }
+
+// exp( x ) for x <= 0: 2^n * exp( r ) with r = x - n*ln(2) in [-ln(2)/2, ln(2)/2] and exp( r ) from
+// its degree 5 Taylor polynomial (relative error below 3e-6)
+static inline vec4 expNonPositive4( vec4 x )
+{
+    x = _mm_max_ps( _mm_min_ps( x, _mm_setzero_ps() ), _mm_set1_ps( -87.f ) );
+    const __m128i n = _mm_cvtps_epi32( _mm_mul_ps( x, _mm_set1_ps( 1.44269504f ) ) );
+    const __m128  r = _mm_sub_ps( x, _mm_mul_ps( _mm_cvtepi32_ps( n ), _mm_set1_ps( 0.693147181f ) ) );
+    __m128 p = _mm_set1_ps( 1.f / 120.f );
+    p = _mm_add_ps( _mm_mul_ps( p, r ), _mm_set1_ps( 1.f / 24.f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, r ), _mm_set1_ps( 1.f / 6.f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, r ), _mm_set1_ps( 0.5f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, r ), _mm_set1_ps( 1.f ) );
+    p = _mm_add_ps( _mm_mul_ps( p, r ), _mm_set1_ps( 1.f ) );
+    return _mm_mul_ps( p, _mm_castsi128_ps( _mm_slli_epi32( _mm_add_epi32( n, _mm_set1_epi32( 127 ) ), 23 ) ) );
+}
+#else
+struct vec4 { float v[4]; };
+static inline vec4 load4( const float* p )            { vec4 r; for( int i = 0; i < 4; ++i ) r.v[i] = p[i]; return r; }
+static inline void store4( float* p, vec4 a )         { for( int i = 0; i < 4; ++i ) p[i] = a.v[i]; }
+static inline vec4 splat4( float s )                  { vec4 r; for( int i = 0; i < 4; ++i ) r.v[i] = s; return r; }
+static inline vec4 set4( float x, float y, float z, float w ) { vec4 r = { { x, y, z, w } }; return r; }
+static inline vec4 add4( vec4 a, vec4 b )             { for( int i = 0; i < 4; ++i ) a.v[i] += b.v[i]; return a; }
+static inline vec4 sub4( vec4 a, vec4 b )             { for( int i = 0; i < 4; ++i ) a.v[i] -= b.v[i]; return a; }
+static inline vec4 mul4( vec4 a, vec4 b )             { for( int i = 0; i < 4; ++i ) a.v[i] *= b.v[i]; return a; }
+static inline vec4 abs4( vec4 a )                     { for( int i = 0; i < 4; ++i ) a.v[i] = std::fabs( a.v[i] ); return a; }
+static inline void transpose4( vec4& a, vec4& b, vec4& c, vec4& d )
+{
+    const vec4 r[4] = { a, b, c, d };
+    a = set4( r[0].v[0], r[1].v[0], r[2].v[0], r[3].v[0] );
+    b = set4( r[0].v[1], r[1].v[1], r[2].v[1], r[3].v[1] );
+    c = set4( r[0].v[2], r[1].v[2], r[2].v[2], r[3].v[2] );
+    d = set4( r[0].v[3], r[1].v[3], r[2].v[3], r[3].v[3] );
+}
+static inline vec4 maskPositive4( vec4 a, vec4 d )    { for( int i = 0; i < 4; ++i ) a.v[i] = d.v[i] > 0.f ? a.v[i] : 0.f; return a; }
+static inline vec4 expNonPositive4( vec4 x )          { for( int i = 0; i < 4; ++i ) x.v[i] = std::exp( std::min( x.v[i], 0.f ) ); return x; }
+#endif
+
+static const float MIN_WEIGHT = 1e-6f;
+
+
+void Upsampler::normalizeGuide( const float4* low_guide, unsigned int y0, unsigned int y1 )
+{
+    for( unsigned int y = y0; y < y1; ++y )
+    {
+        for( unsigned int x = 0; x < m_low_width; ++x )
+        {
+            const size_t i   = static_cast<size_t>( y ) * m_low_width + x;
+            const float4 g   = low_guide[i];
+            const float  len = std::sqrt( g.x * g.x + g.y * g.y + g.z * g.z );
+            const float  inv = len > 0.f ? 1.f / len : 0.f;
+            store4( &m_guide[i * 4], set4( g.x * inv, g.y * inv, g.z * inv, g.w ) );
+        }
+    }
+}
+
+
+void Upsampler::upsampleRows( unsigned int width, unsigned int scale, const float4* low_color,
+                              const float4* normal, const float* depth, float4* out, unsigned int y0, unsigned int y1 )
+{
+    const float* guide     = m_guide.data();
+    const float* color     = reinterpret_cast<const float*>( low_color );
+    const int    lw        = static_cast<int>( m_low_width );
+    const int    lh        = static_cast<int>( m_low_height );
+    const float  inv_scale = 1.f / static_cast<float>( scale );
+
+    for( unsigned int y = y0; y < y1; ++y )
+    {
+        // Footprint rows and their tent weights (radius of two low resolution texels)
+        const float v      = ( static_cast<float>( y ) + 0.5f ) * inv_scale - 0.5f;
+        const int   row0   = static_cast<int>( std::floor( v ) ) - 1;
+        int         rows[4];
+        float       row_weights[4];
+        for( int j = 0; j < 4; ++j )
+        {
+            rows[j]        = std::min( std::max( row0 + j, 0 ), lh - 1 );
+            row_weights[j] = std::max( 0.f, 1.f - 0.5f * std::fabs( v - static_cast<float>( row0 + j ) ) );
+        }
+
+        for( unsigned int x = 0; x < width; ++x )
+        {
+            const size_t p   = static_cast<size_t>( y ) * width + x;
+            const float  z_p = depth[p];
+            if( z_p <= 0.f )
+            {
+                store4( &out[p].x, splat4( 0.f ) );
+                continue;
+            }
+
+            const float4 n   = normal[p];
+            const float  len = std::sqrt( n.x * n.x + n.y * n.y + n.z * n.z );
+            const float  inv = len > 0.f ? 1.f / len : 0.f;
+            const vec4   n_x = splat4( n.x * inv );
+            const vec4   n_y = splat4( n.y * inv );
+            const vec4   n_z = splat4( n.z * inv );
+            const vec4   z   = splat4( z_p );
+            const vec4   sigma_normal    = splat4( m_settings.sigma_normal );
+            const vec4   inv_sigma_depth = splat4( 1.f / ( m_settings.sigma_depth * z_p ) );
+
+            const float u    = ( static_cast<float>( x ) + 0.5f ) * inv_scale - 0.5f;
+            const int   col0 = static_cast<int>( std::floor( u ) ) - 1;
+            int         cols[4];
+            for( int k = 0; k < 4; ++k )
+                cols[k] = std::min( std::max( col0 + k, 0 ), lw - 1 );
+            const float fu = u - static_cast<float>( col0 );
+            const vec4  col_weights = set4(
+                    std::max( 0.f, 1.f - 0.5f * fu ),
+                    std::max( 0.f, 1.f - 0.5f * std::fabs( fu - 1.f ) ),
+                    std::max( 0.f, 1.f - 0.5f * std::fabs( fu - 2.f ) ),
+                    std::max( 0.f, 1.f - 0.5f * std::fabs( fu - 3.f ) ) );
+
+            vec4   sum        = splat4( 0.f );
+            float  sum_w      = 0.f;
+            float  best_range = -1.f;
+            size_t best       = 0;
+            for( int j = 0; j < 4; ++j )
+            {
+                const size_t row = static_cast<size_t>( rows[j] ) * m_low_width;
+
+                // Range weights of the four taps of this footprint row, one tap per lane
+                vec4 g_x = load4( &guide[( row + cols[0] ) * 4] );
+                vec4 g_y = load4( &guide[( row + cols[1] ) * 4] );
+                vec4 g_z = load4( &guide[( row + cols[2] ) * 4] );
+                vec4 g_d = load4( &guide[( row + cols[3] ) * 4] );
+                transpose4( g_x, g_y, g_z, g_d );
+
+                const vec4 cos_angle = add4( add4( mul4( g_x, n_x ), mul4( g_y, n_y ) ), mul4( g_z, n_z ) );
+                const vec4 exponent  = sub4( mul4( sigma_normal, sub4( cos_angle, splat4( 1.f ) ) ),
+                                             mul4( abs4( sub4( g_d, z ) ), inv_sigma_depth ) );
+                const vec4 range     = maskPositive4( expNonPositive4( exponent ), g_d );
+
+                float range_weights[4], weights[4];
+                store4( range_weights, range );
+                store4( weights, mul4( range, mul4( col_weights, splat4( row_weights[j] ) ) ) );
+
+                for( int k = 0; k < 4; ++k )
+                {
+                    const size_t q = row + cols[k];
+                    sum    = add4( sum, mul4( load4( &color[q * 4] ), splat4( weights[k] ) ) );
+                    sum_w += weights[k];
+                    if( range_weights[k] > best_range )
+                    {
+                        best_range = range_weights[k];
+                        best       = q;
+                    }
+                }
+            }
+
+            // Every tap was rejected (thin features, silhouettes) - take the most similar texel
+            if( sum_w > MIN_WEIGHT )
+                store4( &out[p].x, mul4( sum, splat4( 1.f / sum_w ) ) );
+            else
+                store4( &out[p].x, load4( &color[best * 4] ) );
+        }
+    }
+}
+
+
+void Upsampler::upsample( unsigned int  width,
+                          unsigned int  height,
+                          unsigned int  scale,
+                          const float4* low_color,
+                          const float4* low_guide,
+                          const float4* normal,
+                          const float*  depth,
+                          float4*       out )
+{
+    const auto t0 = std::chrono::steady_clock::now();
+
+    scale        = std::max( scale, 1u );
+    m_low_width  = lowResolution( width, scale );
+    m_low_height = lowResolution( height, scale );
+    if( m_low_width == 0 || m_low_height == 0 )
+        return;
+    m_guide.resize( static_cast<size_t>( m_low_width ) * m_low_height * 4 );
+
+    parallelRows( m_low_height, m_settings.num_threads, [&]( unsigned int y0, unsigned int y1 ) { normalizeGuide( low_guide, y0, y1 ); } );
+    parallelRows( height, m_settings.num_threads, [&]( unsigned int y0, unsigned int y1 ) {
+        upsampleRows( width, scale, low_color, normal, depth, out, y0, y1 );
+    } );
+
+    const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - t0;
+    m_last_upsample_time_ms = elapsed.count();
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector_types.h>
+
+#include <vector>
+
+/**
+       * Joint bilateral upsampler for the reduced resolution indirect lighting pass.
+       *
+       * Every full resolution pixel gathers a 4x4 footprint of low resolution texels around its
+       * position. The tent shaped spatial weight is multiplied by a range weight that compares the
+       * full resolution first-hit normal and depth with the guide stored by the low resolution
+       * pass, so indirect light does not bleed across silhouettes and creases. Pixels whose whole
+       * footprint is rejected fall back to the most similar texel. Rows are distributed over
+       * worker threads and the range weights of a footprint row are evaluated 4-wide with SSE2.
+       *
+       * Reference: Kopf et al. 2007, "Joint Bilateral Upsampling"
+*/
+class Upsampler
+{
+public:
+    struct Settings
+    {
+        float        sigma_depth  = 0.05f;  // relative depth difference at which the weight falls to 1/e
+        float        sigma_normal = 32.f;   // normal similarity falloff, weight is exp( -sigma_normal * ( 1 - cos ) )
+        unsigned int num_threads  = 0;      // 0 means std::thread::hardware_concurrency()
+    };
+
+    Upsampler() = default;
+    explicit Upsampler( const Settings& settings ) : m_settings( settings ) {}
+
+    Settings&       settings()       { return m_settings; }
+    const Settings& settings() const { return m_settings; }
+
+    // Size of the low resolution image for a full resolution dimension and scale factor
+    static unsigned int lowResolution( unsigned int size, unsigned int scale ) { return ( size + scale - 1 ) / scale; }
+
+    /**
+     * Upsample one frame. Full resolution buffers are width*height pixels, low resolution buffers
+     * lowResolution( width, scale )*lowResolution( height, scale ) pixels, both in row-major order.
+     * Low resolution texel (X,Y) is centered on full resolution position ( (X+0.5)*scale, (Y+0.5)*scale ).
+     *   low_color - low resolution signal, all four channels are interpolated
+     *   low_guide - low resolution first-hit normal in xyz (need not be normalized), distance in w
+     *   normal    - full resolution first-hit normal in xyz
+     *   depth     - full resolution first-hit distance, <= 0 for pixels that missed the scene
+     *   out       - full resolution result, zero for pixels that missed the scene
+     */
+    void upsample( unsigned int  width,
+                   unsigned int  height,
+                   unsigned int  scale,
+                   const float4* low_color,
+                   const float4* low_guide,
+                   const float4* normal,
+                   const float*  depth,
+                   float4*       out );
+
+    // Wall clock time of the last upsample() call in milliseconds
+    float lastUpsampleTime() const { return m_last_upsample_time_ms; }
+
+private:
+    void normalizeGuide( const float4* low_guide, unsigned int y0, unsigned int y1 );
+    void upsampleRows( unsigned int width, unsigned int scale, const float4* low_color,
+                       const float4* normal, const float* depth, float4* out, unsigned int y0, unsigned int y1 );
+
+    Settings           m_settings;
+    unsigned int       m_low_width  = 0;
+    unsigned int       m_low_height = 0;
+    float              m_last_upsample_time_ms = 0.f;
+
+    std::vector<float> m_guide;   // normalized low resolution guide, 4 floats per texel (normal + distance)
+};
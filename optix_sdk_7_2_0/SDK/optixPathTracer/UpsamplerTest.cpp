@@ -0,0 +1,286 @@
+//
+// upsamplerTest - host tests of the joint bilateral Upsampler for --indirect-scale, followed by a
+// timing report at 1920x1080 for scale 2 and 4.
+//
+// The image sizes are not multiples of the scale, so the last low resolution texel of every row and
+// column is only partly covered and the footprints at the borders are clamped.
+//
+
+#include "Upsampler.h"
+#include "HostTest.h"
+
+#include <vector_functions.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+
+namespace {
+
+struct Images
+{
+    unsigned int        width;
+    unsigned int        height;
+    unsigned int        scale;
+    unsigned int        low_width;
+    unsigned int        low_height;
+    std::vector<float4> low_color;
+    std::vector<float4> low_guide;
+    std::vector<float4> normal;
+    std::vector<float>  depth;
+    std::vector<float4> out;
+};
+
+// A single plane facing the camera at distance 5 with a constant low resolution color
+Images makePlane( unsigned int width, unsigned int height, unsigned int scale, const float4& color )
+{
+    Images images;
+    images.width      = width;
+    images.height     = height;
+    images.scale      = scale;
+    images.low_width  = Upsampler::lowResolution( width, scale );
+    images.low_height = Upsampler::lowResolution( height, scale );
+
+    const size_t num_low = static_cast<size_t>( images.low_width ) * images.low_height;
+    images.low_color.assign( num_low, color );
+    images.low_guide.assign( num_low, make_float4( 0.0f, 0.0f, 2.0f, 5.0f ) );  // the guide normal need not be normalized
+    images.normal.assign( static_cast<size_t>( width ) * height, make_float4( 0.0f, 0.0f, 1.0f, 0.0f ) );
+    images.depth.assign( static_cast<size_t>( width ) * height, 5.0f );
+    images.out.assign( static_cast<size_t>( width ) * height, make_float4( -1.0f, -1.0f, -1.0f, -1.0f ) );
+    return images;
+}
+
+void upsample( Images& images, Upsampler& upsampler )
+{
+    upsampler.upsample( images.width, images.height, images.scale, images.low_color.data(), images.low_guide.data(),
+                        images.normal.data(), images.depth.data(), images.out.data() );
+}
+
+// Full resolution x of the center of low resolution column X
+float lowCenter( unsigned int X, unsigned int scale )
+{
+    return ( X + 0.5f ) * scale;
+}
+
+
+void testConstantReproduces()
+{
+    const float4 color = make_float4( 0.3f, 0.5f, 0.7f, 1.0f );
+    for( unsigned int scale : { 1u, 2u, 3u, 4u } )
+    {
+        Images    images = makePlane( 97, 61, scale, color );
+        Upsampler upsampler;
+        upsample( images, upsampler );
+
+        // Every pixel, corners and the partly covered last row and column included
+        float max_error = 0.0f;
+        for( const float4& o : images.out )
+            max_error = std::max( max_error, std::max( std::max( std::fabs( o.x - color.x ), std::fabs( o.y - color.y ) ),
+                                                       std::max( std::fabs( o.z - color.z ), std::fabs( o.w - color.w ) ) ) );
+        HOST_CHECK_NEAR( max_error, 0.0f, 1e-6 );
+    }
+}
+
+
+void testMissedPixels()
+{
+    Images images = makePlane( 40, 24, 2, make_float4( 1.0f, 1.0f, 1.0f, 1.0f ) );
+    images.depth[3]                    = 0.0f;
+    images.depth[10 * images.width + 7] = -1.0f;
+
+    Upsampler upsampler;
+    upsample( images, upsampler );
+    HOST_CHECK( images.out[3].x == 0.0f && images.out[3].w == 0.0f );
+    HOST_CHECK( images.out[10 * images.width + 7].y == 0.0f );
+    HOST_CHECK_NEAR( images.out[4].x, 1.0f, 1e-6 );
+}
+
+
+// Red in front on the left, green behind on the right: the edge runs between low resolution
+// columns, so every footprint near it mixes both sides and only the range weights keep them apart.
+void testDepthEdge( unsigned int scale )
+{
+    Images             images = makePlane( 97, 61, scale, make_float4( 0.0f, 0.0f, 0.0f, 0.0f ) );
+    const unsigned int edge   = 48;
+    for( unsigned int Y = 0; Y < images.low_height; ++Y )
+        for( unsigned int X = 0; X < images.low_width; ++X )
+        {
+            const bool   left = lowCenter( X, scale ) < edge;
+            const size_t i    = Y * images.low_width + X;
+            images.low_color[i] = left ? make_float4( 1.0f, 0.0f, 0.0f, 0.0f ) : make_float4( 0.0f, 1.0f, 0.0f, 0.0f );
+            images.low_guide[i].w = left ? 5.0f : 20.0f;
+        }
+    for( unsigned int y = 0; y < images.height; ++y )
+        for( unsigned int x = 0; x < images.width; ++x )
+            images.depth[y * images.width + x] = x < edge ? 5.0f : 20.0f;
+
+    Upsampler upsampler;
+    upsample( images, upsampler );
+    float bleed = 0.0f;
+    for( unsigned int y = 0; y < images.height; ++y )
+        for( unsigned int x = 0; x < images.width; ++x )
+        {
+            const float4& o = images.out[y * images.width + x];
+            bleed = std::max( bleed, x < edge ? o.y : o.x );
+        }
+    HOST_CHECK_NEAR( bleed, 0.0f, 1e-3 );
+}
+
+
+// Same depth on both sides, a crease: the normals turn by 90 degrees at the edge
+void testNormalEdge( unsigned int scale )
+{
+    Images             images = makePlane( 97, 61, scale, make_float4( 0.0f, 0.0f, 0.0f, 0.0f ) );
+    const unsigned int edge   = 48;
+    for( unsigned int Y = 0; Y < images.low_height; ++Y )
+        for( unsigned int X = 0; X < images.low_width; ++X )
+        {
+            const bool   left = lowCenter( X, scale ) < edge;
+            const size_t i    = Y * images.low_width + X;
+            images.low_color[i] = left ? make_float4( 1.0f, 0.0f, 0.0f, 0.0f ) : make_float4( 0.0f, 1.0f, 0.0f, 0.0f );
+            images.low_guide[i] = left ? make_float4( 0.0f, 0.0f, 1.0f, 5.0f ) : make_float4( 3.0f, 0.0f, 0.0f, 5.0f );
+        }
+    for( unsigned int y = 0; y < images.height; ++y )
+        for( unsigned int x = 0; x < images.width; ++x )
+            images.normal[y * images.width + x] = x < edge ? make_float4( 0.0f, 0.0f, 1.0f, 0.0f ) : make_float4( 1.0f, 0.0f, 0.0f, 0.0f );
+
+    Upsampler upsampler;
+    upsample( images, upsampler );
+    float bleed = 0.0f;
+    for( unsigned int y = 0; y < images.height; ++y )
+        for( unsigned int x = 0; x < images.width; ++x )
+        {
+            const float4& o = images.out[y * images.width + x];
+            bleed = std::max( bleed, x < edge ? o.y : o.x );
+        }
+    HOST_CHECK_NEAR( bleed, 0.0f, 1e-3 );
+}
+
+
+// A sliver whose normal matches no texel of its footprint well enough falls back to the most similar one
+void testRejectedFootprint()
+{
+    Images images = makePlane( 32, 32, 4, make_float4( 0.0f, 0.0f, 0.0f, 0.0f ) );
+    for( unsigned int i = 0; i < images.low_color.size(); ++i )
+        images.low_color[i] = make_float4( static_cast<float>( i ), 0.0f, 0.0f, 0.0f );
+    images.low_guide[19] = make_float4( 1.0f, 0.0f, 1.7320508f, 5.0f );  // 60 degrees from the sliver, the others 90
+
+    const unsigned int x = 13, y = 9;  // inside low resolution texel (3, 2), index 19
+    images.normal[y * images.width + x] = make_float4( 1.0f, 0.0f, 0.0f, 0.0f );
+
+    Upsampler upsampler;
+    upsample( images, upsampler );
+    HOST_CHECK_NEAR( images.out[y * images.width + x].x, 19.0f, 0.0 );
+}
+
+
+// A horizontal ramp: exact in the interior, within the range of the texels and monotonic at the
+// borders where the footprint is clamped
+void testBorders( unsigned int scale )
+{
+    Images images = makePlane( 97, 61, scale, make_float4( 0.0f, 0.0f, 0.0f, 0.0f ) );
+    for( unsigned int Y = 0; Y < images.low_height; ++Y )
+        for( unsigned int X = 0; X < images.low_width; ++X )
+            images.low_color[Y * images.low_width + X] = make_float4( lowCenter( X, scale ), 0.0f, 0.0f, 1.0f );
+
+    Upsampler upsampler;
+    upsample( images, upsampler );
+
+    const float low_min = lowCenter( 0, scale );
+    const float low_max = lowCenter( images.low_width - 1, scale );
+    for( unsigned int y = 0; y < images.height; ++y )
+    {
+        float previous = -1.0f;
+        for( unsigned int x = 0; x < images.width; ++x )
+        {
+            const float4& o = images.out[y * images.width + x];
+            const float   u = x + 0.5f;
+            HOST_CHECK( o.x >= low_min - 1e-4f && o.x <= low_max + 1e-4f );
+            HOST_CHECK( o.x >= previous - 1e-4f );
+            HOST_CHECK_NEAR( o.w, 1.0f, 1e-6 );
+            if( u >= low_min + scale && u <= low_max - scale )
+                HOST_CHECK_NEAR( o.x, u, 1e-3 * scale );
+            previous = o.x;
+        }
+    }
+
+    // The rows are the same image, top and bottom rows included
+    for( unsigned int x = 0; x < images.width; ++x )
+    {
+        HOST_CHECK( images.out[x].x == images.out[( images.height - 1 ) * images.width + x].x );
+        HOST_CHECK( images.out[x].x == images.out[( images.height / 2 ) * images.width + x].x );
+    }
+}
+
+
+void testThreadsAgree()
+{
+    Images images = makePlane( 97, 61, 2, make_float4( 0.0f, 0.0f, 0.0f, 0.0f ) );
+    for( unsigned int i = 0; i < images.low_color.size(); ++i )
+    {
+        images.low_color[i]   = make_float4( std::sin( 0.1f * i ), std::cos( 0.37f * i ), 0.5f, 1.0f );
+        images.low_guide[i].w = 5.0f + ( i % 7 ) * 0.3f;
+    }
+    Upsampler::Settings single;
+    single.num_threads = 1;
+    Upsampler one( single );
+    upsample( images, one );
+    const std::vector<float4> reference = images.out;
+
+    Upsampler::Settings several;
+    several.num_threads = 4;
+    Upsampler four( several );
+    upsample( images, four );
+    for( size_t i = 0; i < reference.size(); ++i )
+        HOST_CHECK( reference[i].x == images.out[i].x && reference[i].y == images.out[i].y );
+}
+
+
+// Time per frame at 1920x1080 for --indirect-scale 2 and 4, one thread and all threads
+void reportTiming()
+{
+    std::cout << "1920x1080   scale   threads    time ms" << std::endl;
+    for( unsigned int scale : { 2u, 4u } )
+    {
+        Images images = makePlane( 1920, 1080, scale, make_float4( 0.5f, 0.5f, 0.5f, 1.0f ) );
+        for( unsigned int threads : { 1u, 0u } )
+        {
+            Upsampler::Settings settings;
+            settings.num_threads = threads;
+            Upsampler upsampler( settings );
+            upsample( images, upsampler );  // warm up the guide buffer
+
+            float     time_ms = 0.0f;
+            const int runs    = 3;
+            for( int run = 0; run < runs; ++run )
+            {
+                upsample( images, upsampler );
+                time_ms += upsampler.lastUpsampleTime() / runs;
+            }
+            std::cout << std::setw( 15 ) << scale << std::setw( 10 ) << ( threads ? "1" : "all" ) << std::fixed
+                      << std::setprecision( 2 ) << std::setw( 11 ) << time_ms << std::endl;
+        }
+    }
+}
+
+}  // namespace
+
+
+int main()
+{
+    testConstantReproduces();
+    testMissedPixels();
+    for( unsigned int scale : { 2u, 4u } )
+    {
+        testDepthEdge( scale );
+        testNormalEdge( scale );
+        testBorders( scale );
+    }
+    testRejectedFootprint();
+    testThreadsAgree();
+    reportTiming();
+    return hostTestResult( "upsamplerTest" );
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <sutil/vec_math.h>
+
+#ifndef __CUDACC__
+#include <sutil/Aabb.h>
+
+#include "IndexedGeometry.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+#endif
+
+/*
+*   Compact geometry storage.
+*
+*   Normals are stored octahedrally encoded in 32 bits (two snorm16 components), the decoder is
+*   shared by host and device code. Positions are either tightly packed floats
+*   (OPTIX_VERTEX_FORMAT_FLOAT3, 12 bytes) or snorm16 relative to the bounding box of the mesh
+*   (OPTIX_VERTEX_FORMAT_SNORM16_3, 6 bytes). The snorm16 positions are decoded during the GAS build
+*   by a preTransform matrix that maps [-1,1]^3 back onto the box.
+*/
+
+SUTIL_INLINE SUTIL_HOSTDEVICE float dequantizeSnorm16( int q )
+{
+    return fmaxf( static_cast<float>( q ) / 32767.0f, -1.0f );
+}
+
+
+SUTIL_INLINE SUTIL_HOSTDEVICE int quantizeSnorm16( float f )
+{
+    f = fminf( fmaxf( f, -1.0f ), 1.0f );
+    return static_cast<int>( f * 32767.0f + ( f >= 0.0f ? 0.5f : -0.5f ) );
+}
+
+
+/* Octahedral encoding of a unit vector: x in the low, y in the high 16 bits */
+SUTIL_INLINE SUTIL_HOSTDEVICE unsigned int encodeOctahedral( const float3& n )
+{
+    const float l1 = fabsf( n.x ) + fabsf( n.y ) + fabsf( n.z );
+    if( l1 <= 0.0f )
+        return 0u;
+
+    float x = n.x / l1;
+    float y = n.y / l1;
+    if( n.z < 0.0f )
+    {
+        // Fold the lower hemisphere over the diagonals
+        const float fx = ( 1.0f - fabsf( y ) ) * ( x >= 0.0f ? 1.0f : -1.0f );
+        const float fy = ( 1.0f - fabsf( x ) ) * ( y >= 0.0f ? 1.0f : -1.0f );
+        x = fx;
+        y = fy;
+    }
+    const unsigned int qx = static_cast<unsigned int>( quantizeSnorm16( x ) ) & 0xffffu;
+    const unsigned int qy = static_cast<unsigned int>( quantizeSnorm16( y ) ) & 0xffffu;
+    return qx | ( qy << 16 );
+}
+
+
+SUTIL_INLINE SUTIL_HOSTDEVICE float3 decodeOctahedral( unsigned int e )
+{
+    float x = dequantizeSnorm16( static_cast<short>( e & 0xffffu ) );
+    float y = dequantizeSnorm16( static_cast<short>( e >> 16 ) );
+    const float z = 1.0f - fabsf( x ) - fabsf( y );
+    const float t = fmaxf( -z, 0.0f );
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    return normalize( make_float3( x, y, z ) );
+}
+
+
+#ifndef __CUDACC__
+enum PositionFormat
+{
+    POSITION_FLOAT3,
+    POSITION_SNORM16
+};
+
+
+struct PackedGeometry
+{
+    PositionFormat             format = POSITION_FLOAT3;
+    std::vector<unsigned char> positions;          // tightly packed float3 or short3
+    unsigned int               num_vertices  = 0;
+    unsigned int               vertex_stride = 0;  // bytes per packed position
+    float                      pre_transform[12];  // row-major 3x4, maps packed positions to world space
+    std::vector<uint3>         indices;
+    std::vector<unsigned int>  normals;            // octahedral geometric normal per triangle
+    sutil::Aabb                bounds;
+    size_t                     unindexed_bytes = 0;  // size of the float4 triangle soup this replaces
+
+    size_t positionBytes() const { return positions.size(); }
+    size_t indexBytes() const    { return indices.size() * sizeof( uint3 ); }
+    size_t normalBytes() const   { return normals.size() * sizeof( unsigned int ); }
+    size_t totalBytes() const    { return positionBytes() + indexBytes() + normalBytes(); }
+};
+
+
+/*
+    Octahedral geometric normal of every triangle, zero for degenerate triangles
+*/
+inline std::vector<unsigned int> encodeFaceNormals( const std::vector<float3>& positions, const std::vector<uint3>& indices )
+{
+    std::vector<unsigned int> normals;
+    normals.reserve( indices.size() );
+    for( const uint3& tri : indices )
+    {
+        const float3 n = cross( positions[tri.y] - positions[tri.x], positions[tri.z] - positions[tri.x] );
+        const float  l = length( n );
+        normals.push_back( l > 0.0f ? encodeOctahedral( n / l ) : 0u );
+    }
+    return normals;
+}
+
+
+/*
+    Pack a welded mesh. The face normals are recomputed from the decoded positions so that they match
+    the triangles the GAS is built from.
+*/
+template <typename VertexT>
+PackedGeometry packGeometry( const IndexedMesh<VertexT>& mesh, PositionFormat format )
+{
+    PackedGeometry packed;
+    packed.format          = format;
+    packed.num_vertices    = static_cast<unsigned int>( mesh.vertices.size() );
+    packed.indices         = mesh.indices;
+    packed.unindexed_bytes = mesh.indices.size() * 3 * sizeof( float4 );
+
+    for( const VertexT& v : mesh.vertices )
+        packed.bounds.include( make_float3( v.x, v.y, v.z ) );
+
+    // Decoded positions, used for the face normals below
+    std::vector<float3> decoded( mesh.vertices.size() );
+    std::memset( packed.pre_transform, 0, sizeof( packed.pre_transform ) );
+    if( format == POSITION_FLOAT3 || mesh.vertices.empty() )
+    {
+        packed.format                = POSITION_FLOAT3;
+        packed.vertex_stride         = sizeof( float3 );
+        packed.pre_transform[0]      = 1.0f;
+        packed.pre_transform[5]      = 1.0f;
+        packed.pre_transform[10]     = 1.0f;
+        packed.positions.resize( mesh.vertices.size() * sizeof( float3 ) );
+        float3* dst = reinterpret_cast<float3*>( packed.positions.data() );
+        for( size_t i = 0; i < mesh.vertices.size(); ++i )
+            dst[i] = decoded[i] = make_float3( mesh.vertices[i].x, mesh.vertices[i].y, mesh.vertices[i].z );
+    }
+    else
+    {
+        const float3 center = packed.bounds.center();
+        float3       half   = 0.5f * packed.bounds.extent();
+        // A flat box axis holds a single coordinate that quantizes to zero with any scale
+        half.x = half.x > 0.0f ? half.x : 1.0f;
+        half.y = half.y > 0.0f ? half.y : 1.0f;
+        half.z = half.z > 0.0f ? half.z : 1.0f;
+
+        packed.vertex_stride     = 3 * sizeof( int16_t );
+        packed.pre_transform[0]  = half.x;
+        packed.pre_transform[3]  = center.x;
+        packed.pre_transform[5]  = half.y;
+        packed.pre_transform[7]  = center.y;
+        packed.pre_transform[10] = half.z;
+        packed.pre_transform[11] = center.z;
+        packed.positions.resize( mesh.vertices.size() * packed.vertex_stride );
+        int16_t* dst = reinterpret_cast<int16_t*>( packed.positions.data() );
+        for( size_t i = 0; i < mesh.vertices.size(); ++i )
+        {
+            const VertexT& v = mesh.vertices[i];
+            const int      q[3] = { quantizeSnorm16( ( v.x - center.x ) / half.x ),
+                                    quantizeSnorm16( ( v.y - center.y ) / half.y ),
+                                    quantizeSnorm16( ( v.z - center.z ) / half.z ) };
+            for( int c = 0; c < 3; ++c )
+                dst[i * 3 + c] = static_cast<int16_t>( q[c] );
+            decoded[i] = make_float3( dequantizeSnorm16( q[0] ) * half.x + center.x,
+                                      dequantizeSnorm16( q[1] ) * half.y + center.y,
+                                      dequantizeSnorm16( q[2] ) * half.z + center.z );
+        }
+    }
+
+    packed.normals = encodeFaceNormals( decoded, mesh.indices );
+    return packed;
+}
+
+
+inline void printGeometryReport( std::ostream& out, const PackedGeometry& g )
+{
+    const double kb = 1.0 / 1024.0;
+    out << std::fixed << std::setprecision( 1 )
+        << "Geometry: " << g.indices.size() << " triangles, " << g.num_vertices << " vertices\n"
+        << "  positions " << ( g.format == POSITION_SNORM16 ? "snorm16 " : "float3  " ) << g.positionBytes() * kb << " KB\n"
+        << "  indices           " << g.indexBytes() * kb << " KB\n"
+        << "  normals (oct32)   " << g.normalBytes() * kb << " KB\n"
+        << "  total             " << g.totalBytes() * kb << " KB (unindexed float4 soup: " << g.unindexed_bytes * kb << " KB)"
+        << std::endl;
+}
+#endif
@@ -0,0 +1,220 @@
+//
+// vertexCompressionTest - host tests of the octahedral normal encoding and the snorm16 positions in
+// VertexCompression.h: the angular error over a sweep of the sphere, the folded lower hemisphere and
+// the poles, the position error of packGeometry() and the normals of degenerate triangles.
+//
+
+#include "VertexCompression.h"
+#include "HostTest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+namespace {
+
+const float PI = 3.14159265358979f;
+
+struct Vertex
+{
+    float x, y, z, pad;
+};
+
+double angleBetween( const float3& a, const float3& b )
+{
+    // atan2 of |a x b| and a . b stays accurate for tiny angles, acos does not
+    const double cx = static_cast<double>( a.y ) * b.z - static_cast<double>( a.z ) * b.y;
+    const double cy = static_cast<double>( a.z ) * b.x - static_cast<double>( a.x ) * b.z;
+    const double cz = static_cast<double>( a.x ) * b.y - static_cast<double>( a.y ) * b.x;
+    const double d  = static_cast<double>( a.x ) * b.x + static_cast<double>( a.y ) * b.y + static_cast<double>( a.z ) * b.z;
+    return std::atan2( std::sqrt( cx * cx + cy * cy + cz * cz ), d );
+}
+
+double roundTripError( const float3& n )
+{
+    return angleBetween( n, decodeOctahedral( encodeOctahedral( n ) ) );
+}
+
+
+void testSnorm16()
+{
+    HOST_CHECK( quantizeSnorm16( 1.0f ) == 32767 && quantizeSnorm16( -1.0f ) == -32767 );
+    HOST_CHECK( quantizeSnorm16( 0.0f ) == 0 && quantizeSnorm16( -0.0f ) == 0 );
+    HOST_CHECK( quantizeSnorm16( 2.0f ) == 32767 && quantizeSnorm16( -7.0f ) == -32767 );  // clamped
+    HOST_CHECK( quantizeSnorm16( 0.5f / 32767.0f ) == 1 && quantizeSnorm16( -0.5f / 32767.0f ) == -1 );  // rounds half away from zero
+    HOST_CHECK( dequantizeSnorm16( -32768 ) == -1.0f );  // the one code outside the symmetric range
+    HOST_CHECK( dequantizeSnorm16( 32767 ) == 1.0f );
+
+    // Round trip within half a step over [-1, 1]
+    double max_error = 0.0;
+    for( int i = -100000; i <= 100000; ++i )
+    {
+        const float f = i / 100000.0f;
+        max_error     = std::max( max_error, std::fabs( static_cast<double>( dequantizeSnorm16( quantizeSnorm16( f ) ) ) - f ) );
+    }
+    HOST_CHECK( max_error <= 0.5 / 32767.0 + 1e-7 );
+}
+
+
+void testOctahedralSphere()
+{
+    // Latitude / longitude sweep, both hemispheres
+    double max_error = 0.0, max_error_lower = 0.0;
+    for( int i = 0; i <= 400; ++i )
+    {
+        const float theta = PI * i / 400.0f;
+        for( int j = 0; j < 800; ++j )
+        {
+            const float  phi = 2.0f * PI * j / 800.0f;
+            const float3 n   = make_float3( std::sin( theta ) * std::cos( phi ), std::sin( theta ) * std::sin( phi ), std::cos( theta ) );
+            const double e   = roundTripError( n );
+            max_error        = std::max( max_error, e );
+            if( n.z < 0.0f )
+                max_error_lower = std::max( max_error_lower, e );
+        }
+    }
+    HOST_CHECK( max_error <= 1e-4 );
+    HOST_CHECK( max_error_lower <= 1e-4 );
+
+    // Decoded normals are unit length
+    const float3 d = decodeOctahedral( encodeOctahedral( normalize( make_float3( 0.3f, -0.5f, -0.8f ) ) ) );
+    HOST_CHECK_NEAR( length( d ), 1.0f, 1e-6 );
+}
+
+
+void testOctahedralSpecialDirections()
+{
+    // The axes, the poles in particular, round trip exactly
+    const float3 axes[6] = { make_float3( 1.0f, 0.0f, 0.0f ), make_float3( -1.0f, 0.0f, 0.0f ), make_float3( 0.0f, 1.0f, 0.0f ),
+                             make_float3( 0.0f, -1.0f, 0.0f ), make_float3( 0.0f, 0.0f, 1.0f ), make_float3( 0.0f, 0.0f, -1.0f ) };
+    for( const float3& axis : axes )
+    {
+        const float3 d = decodeOctahedral( encodeOctahedral( axis ) );
+        HOST_CHECK( d.x == axis.x && d.y == axis.y && d.z == axis.z );
+    }
+
+    // Next to the south pole every quadrant of the fold lands near its corner and decodes back
+    for( int q = 0; q < 4; ++q )
+    {
+        const float3 n = normalize( make_float3( q & 1 ? -1e-3f : 1e-3f, q & 2 ? -1e-3f : 1e-3f, -1.0f ) );
+        HOST_CHECK( roundTripError( n ) <= 1e-4 );
+    }
+
+    // The equator, where the two hemispheres meet, and the diagonals of the fold
+    for( int j = 0; j < 360; ++j )
+    {
+        const float phi = 2.0f * PI * j / 360.0f;
+        HOST_CHECK( roundTripError( make_float3( std::cos( phi ), std::sin( phi ), 0.0f ) ) <= 1e-4 );
+        HOST_CHECK( roundTripError( normalize( make_float3( std::cos( phi ), std::sin( phi ), -1e-6f ) ) ) <= 1e-4 );
+    }
+
+    // A zero vector encodes to 0, which decodes to +z
+    HOST_CHECK( encodeOctahedral( make_float3( 0.0f, 0.0f, 0.0f ) ) == 0u );
+    HOST_CHECK( decodeOctahedral( 0u ).z == 1.0f );
+}
+
+
+IndexedMesh<Vertex> sampleMesh()
+{
+    // A skewed box of 64 random-ish vertices with an offset, plus a degenerate triangle
+    IndexedMesh<Vertex> mesh;
+    for( int i = 0; i < 64; ++i )
+    {
+        const Vertex v = { 100.0f + 3.0f * std::sin( 1.7f * i ), -20.0f + 0.25f * std::cos( 2.3f * i ), 7.0f * std::sin( 0.37f * i * i ), 0.0f };
+        mesh.vertices.push_back( v );
+    }
+    for( unsigned int i = 0; i + 2 < 64; ++i )
+        mesh.indices.push_back( make_uint3( i, i + 1, i + 2 ) );
+    mesh.indices.push_back( make_uint3( 5, 5, 9 ) );
+    return mesh;
+}
+
+
+void testSnorm16Positions()
+{
+    const IndexedMesh<Vertex> mesh   = sampleMesh();
+    const PackedGeometry      packed = packGeometry( mesh, POSITION_SNORM16 );
+    HOST_CHECK( packed.format == POSITION_SNORM16 && packed.vertex_stride == 6 );
+    HOST_CHECK( packed.positionBytes() == mesh.vertices.size() * 6 );
+    HOST_CHECK( packed.indices.size() == mesh.indices.size() && packed.normals.size() == mesh.indices.size() );
+
+    // Decode through the pre-transform like the GAS build; error at most half a step per axis
+    const float*   m = packed.pre_transform;
+    const int16_t* q = reinterpret_cast<const int16_t*>( packed.positions.data() );
+    for( size_t i = 0; i < mesh.vertices.size(); ++i )
+    {
+        const float  sx = dequantizeSnorm16( q[i * 3] ), sy = dequantizeSnorm16( q[i * 3 + 1] ), sz = dequantizeSnorm16( q[i * 3 + 2] );
+        const float3 p  = make_float3( m[0] * sx + m[1] * sy + m[2] * sz + m[3], m[4] * sx + m[5] * sy + m[6] * sz + m[7],
+                                       m[8] * sx + m[9] * sy + m[10] * sz + m[11] );
+        // Half a step of the box half extent, plus the float rounding of the offset
+        HOST_CHECK( std::fabs( p.x - mesh.vertices[i].x ) <= m[0] * 0.5f / 32767.0f + 1e-5f * std::fabs( m[3] ) );
+        HOST_CHECK( std::fabs( p.y - mesh.vertices[i].y ) <= m[5] * 0.5f / 32767.0f + 1e-5f * std::fabs( m[7] ) );
+        HOST_CHECK( std::fabs( p.z - mesh.vertices[i].z ) <= m[10] * 0.5f / 32767.0f + 1e-5f * std::fabs( m[11] ) );
+    }
+
+    // The box corners map onto the full snorm range
+    HOST_CHECK_NEAR( m[3] - m[0], packed.bounds.m_min.x, 1e-4 );
+    HOST_CHECK_NEAR( m[3] + m[0], packed.bounds.m_max.x, 1e-4 );
+
+    // Float3 positions are copied verbatim with an identity pre-transform
+    const PackedGeometry exact = packGeometry( mesh, POSITION_FLOAT3 );
+    const float3*        f     = reinterpret_cast<const float3*>( exact.positions.data() );
+    HOST_CHECK( exact.vertex_stride == 12 && exact.pre_transform[0] == 1.0f && exact.pre_transform[3] == 0.0f );
+    HOST_CHECK( f[7].x == mesh.vertices[7].x && f[7].y == mesh.vertices[7].y && f[7].z == mesh.vertices[7].z );
+}
+
+
+void testFlatMesh()
+{
+    // A mesh in the z = 3 plane: the flat axis keeps its coordinate exactly
+    IndexedMesh<Vertex> mesh;
+    const Vertex        v[3] = { { 0.0f, 0.0f, 3.0f, 0.0f }, { 1.0f, 0.0f, 3.0f, 0.0f }, { 0.0f, 2.0f, 3.0f, 0.0f } };
+    mesh.vertices.assign( v, v + 3 );
+    mesh.indices.push_back( make_uint3( 0, 1, 2 ) );
+    const PackedGeometry packed = packGeometry( mesh, POSITION_SNORM16 );
+    const int16_t*       q      = reinterpret_cast<const int16_t*>( packed.positions.data() );
+    for( int i = 0; i < 3; ++i )
+        HOST_CHECK( q[i * 3 + 2] == 0 && dequantizeSnorm16( q[i * 3 + 2] ) * packed.pre_transform[10] + packed.pre_transform[11] == 3.0f );
+    const float3 n = decodeOctahedral( packed.normals[0] );
+    HOST_CHECK( n.x == 0.0f && n.y == 0.0f && n.z == 1.0f );
+
+    // Without vertices the result falls back to float3
+    HOST_CHECK( packGeometry( IndexedMesh<Vertex>(), POSITION_SNORM16 ).format == POSITION_FLOAT3 );
+}
+
+
+void testFaceNormals()
+{
+    const std::vector<float3> positions = { make_float3( 0.0f, 0.0f, 0.0f ), make_float3( 1.0f, 0.0f, 0.0f ), make_float3( 0.0f, 0.0f, -1.0f ),
+                                            make_float3( 2.0f, 2.0f, 2.0f ) };
+    const std::vector<uint3>  indices   = { make_uint3( 0, 1, 2 ), make_uint3( 0, 0, 1 ), make_uint3( 0, 1, 1 ), make_uint3( 0, 3, 3 ) };
+    const std::vector<unsigned int> normals = encodeFaceNormals( positions, indices );
+    HOST_CHECK( normals.size() == 4 );
+
+    // cross( +x, -z ) = +y
+    HOST_CHECK( roundTripError( make_float3( 0.0f, 1.0f, 0.0f ) ) == 0.0 );
+    HOST_CHECK( normals[0] == encodeOctahedral( make_float3( 0.0f, 1.0f, 0.0f ) ) );
+
+    // Degenerate triangles, repeated corners or collinear ones, encode to 0
+    HOST_CHECK( normals[1] == 0u && normals[2] == 0u && normals[3] == 0u );
+
+    // packGeometry uses the same rule: the degenerate last triangle of the sample mesh
+    const PackedGeometry packed = packGeometry( sampleMesh(), POSITION_SNORM16 );
+    HOST_CHECK( packed.normals.back() == 0u );
+    HOST_CHECK( packed.normals.front() != 0u );
+}
+
+}  // namespace
+
+
+int main()
+{
+    testSnorm16();
+    testOctahedralSphere();
+    testOctahedralSpecialDirections();
+    testSnorm16Positions();
+    testFlatMesh();
+    testFaceNormals();
+    return hostTestResult( "vertexCompressionTest" );
+}
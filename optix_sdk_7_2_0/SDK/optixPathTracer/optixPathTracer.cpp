@@ -29,6 +29,23 @@
 #include <glad/glad.h>  // Needs to be included before gl_interop
 
 #include <cuda_gl_interop.h>
+#include "AccelCache.h"
+#include "Denoiser.h"
+#include "DynamicGeometry.h"
+#include "FileWatcher.h"
+#include "HostImageUtils.h"
+#include "IndexedGeometry.h"
+#include "MaterialTextures.h"
+#include "SceneBuilder.h"
+#include "SceneCache.h"
+#include "SceneDiff.h"
+#include "SceneEditServer.h"
+#include "SceneGraph.h"
+#include "SpatialMeshIngest.h"
+#include "StagingBuffer.h"
+#include "TaskGraph.h"
+#include "VertexCompression.h"
+#include "Upsampler.h"
 #include "performance_timer.h"
 
 #include <glm/glm.hpp>
@@ -45,6 +62,7 @@
 #include <sutil/Exception.h>
 #include <sutil/GLDisplay.h>
 #include <sutil/Matrix.h>
+#include <sutil/PtxCache.h>
 #include <sutil/Trackball.h>
 #include <sutil/sutil.h>
 #include <sutil/vec_math.h>
@@ -52,23 +70,32 @@
 
 #include <GLFW/glfw3.h>
 #include "optixPathTracer.h"
-#include "tiny_obj_loader.h"
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <string>
 #include <set>
+#include <thread>
+#include <utility>
 #include <vector>
-#define TINYOBJLOADER_IMPLEMENTATION 
 
 bool resize_dirty = false;
 bool minimized    = false;
 bool saveRequestedFull = false;
 bool saveRequestedQuarter = false;
 bool re_render = true;
+bool image_converged = false;
+bool geometry_changed = false;  // a dynamic mesh moved since the last launch
+bool shading_changed  = false;  // materials or lights were edited since the last launch
+bool textures_changed = false;  // texture tiles the accumulation sampled before they were resident became resident
 
 // Camera state
 bool             camera_changed = true;
@@ -84,6 +111,27 @@ int32_t samples_per_launch = 4;
 int depth = 3;
 int width = 768;
 int height = 768;
+bool denoise = false;
+bool reproject = true;
+float max_history = 64.f;
+bool clamp_history = true;
+bool adaptive_sampling = false;
+float convergence_threshold = 0.02f;
+bool cache_primary_hits = false;
+unsigned int indirect_scale = 1;
+PositionFormat position_format = POSITION_FLOAT3;
+float refit_threshold = 1.0f;
+bool animate_dynamic = false;
+bool benchmark_refit = false;
+int benchmark_subframes = 0;  // static camera subframes timed per configuration at startup, 0 for none
+int benchmark_materials = 0;  // iterations of the material table against per-material SBT records at startup, 0 for none
+bool spatial_mapping = false;
+bool tessellate_primitives = false;  // triangulate spheres and area lights instead of intersecting them analytically
+bool use_scene_cache = true;  // load and write the binary scene cache next to the scene file
+bool use_accel_cache = true;  // relocate static GAS from the acceleration structure cache instead of building them
+bool watch_scene = false;  // reload the scene when its file or one of its OBJ and MTL files changes
+bool scene_editing = false;  // apply edits received on the scene edit port between frames
+size_t texture_memory = size_t( 1024 ) << 20;  // device memory for material texture tiles in bytes, 0 for no limit
 
 
 //------------------------------------------------------------------------------
@@ -117,41 +165,55 @@ struct IndexedTriangle
 };
 
 
-struct Instance
+// Device copy and GAS of one SceneMesh
+struct MeshAccel
 {
-    float transform[12];
-};
-
-struct Triangle {
-    glm::vec3 vertex[3];     // Vertices
-    glm::vec3 normal;        // Normal
-
-    //Material data;
-    glm::vec3 diffuse;
-};
-
-struct Mesh {
-    std::vector<Triangle*> triangles;
-    glm::vec3 diffuse;
-};
-
-struct Model {
-    ~Model()
-    {
-        for (auto mesh : meshes) delete mesh;
-    }
-    bool material;
-    std::vector<Mesh*> meshes;
+    GeometryType           type                = GEOMETRY_TRIANGLES;
+    OptixTraversableHandle gas_handle          = 0;
+    CUdeviceptr            d_gas_output_buffer = 0;
+    CUdeviceptr            d_primitives        = 0;  // Sphere or Parallelogram per custom primitive
+    CUdeviceptr            d_vertices          = 0;
+    CUdeviceptr            d_indices           = 0;  // uint3 per triangle into d_vertices
+    CUdeviceptr            d_normals           = 0;  // octahedral object space geometric normal per triangle
+    CUdeviceptr            d_pre_transform     = 0;  // decodes snorm16 positions during the GAS build
+    CUdeviceptr            d_material_ids      = 0;  // material id per primitive, 0 if they all use material_id
+    CUdeviceptr            d_texcoords         = 0;  // TriangleTexcoords per triangle, 0 for untextured meshes
+    uint32_t               material_id         = 0;
+    size_t                 geometry_bytes      = 0;
+    size_t                 gas_bytes           = 0;
+
+    // Dynamic meshes are built with ALLOW_UPDATE and keep everything a refit or rebuild needs
+    bool                   dynamic             = false;
+    OptixBuildInput        build_input         = {};
+    std::vector<uint32_t>  input_flags;
+    CUdeviceptr            d_temp_buffer       = 0;  // large enough for both a build and an update
+    size_t                 temp_bytes          = 0;
+    std::vector<uint3>     indices;
+    std::vector<float3>    rest_positions;           // welded positions as loaded
+    RefitTracker           refit;
 };
 
 struct PathTracerState
 {
     OptixDeviceContext context = 0;
 
-    OptixTraversableHandle         gas_handle               = 0;  // Traversable handle for triangle AS
-    CUdeviceptr                    d_gas_output_buffer      = 0;  // Triangle AS memory
-    CUdeviceptr                    d_vertices               = 0;
+    OptixTraversableHandle         ias_handle               = 0;  // Traversable handle for the instance AS
+    CUdeviceptr                    d_ias_output_buffer      = 0;  // Instance AS memory
+    CUdeviceptr                    d_instances              = 0;  // OptixInstance per scene instance
+    std::vector<OptixInstance>     instances;                     // host copy of d_instances
+    std::deque<MeshAccel>          meshes;                        // one triangle GAS per unique mesh, stable addresses
+    bool                           ias_updatable            = false;  // the scene has dynamic meshes or takes edits
+    bool                           ias_needs_rebuild        = false;  // a dynamic GAS was rebuilt since the last IAS update
+    CUdeviceptr                    d_ias_temp_buffer        = 0;
+    size_t                         ias_output_bytes         = 0;
+    size_t                         ias_temp_bytes           = 0;
+    CUdeviceptr                    d_geometries             = 0;  // GeometryData per mesh, indexed by instance id
     CUdeviceptr                    d_lights                 = 0;
+    CUdeviceptr                    d_materials              = 0;  // MaterialData per material id
+    size_t                         materials_capacity       = 0;  // materials d_materials has room for
+    MaterialTextures               textures;                      // demand loaded texture maps of the materials
+    bool                           textures_initialized     = false;  // textures.init() was called
+    StagingBuffer                  staging;                       // pinned uploads of mesh geometry
 
     OptixModule                    ptx_module               = 0;
     OptixPipelineCompileOptions    pipeline_compile_options = {};
@@ -160,14 +222,34 @@ struct PathTracerState
     OptixProgramGroup              raygen_prog_group        = 0;
     OptixProgramGroup              radiance_miss_group      = 0;
     OptixProgramGroup              occlusion_miss_group     = 0;
-    OptixProgramGroup              radiance_hit_group       = 0;
-    OptixProgramGroup              occlusion_hit_group      = 0;
+    OptixProgramGroup              radiance_hit_groups[GEOMETRY_TYPE_COUNT]  = {};  // per GeometryType
+    OptixProgramGroup              occlusion_hit_groups[GEOMETRY_TYPE_COUNT] = {};
 
     CUstream                       stream                   = 0;
     Params                         params;
     Params*                        d_params;
 
     OptixShaderBindingTable        sbt                      = {};
+
+    // Host copies of the accumulated frame and its AOVs for the CPU denoiser
+    Denoiser                       denoiser;
+    std::vector<float4>            h_accum;
+    std::vector<float4>            h_albedo;
+    std::vector<float4>            h_normal;
+    std::vector<float>             h_depth;
+
+    // Decoupled shading: host copies of the reduced resolution indirect pass and its upsampled result
+    Upsampler                      upsampler;
+    std::vector<float4>            h_indirect;
+    std::vector<float4>            h_indirect_guide;
+    std::vector<float4>            h_indirect_full;
+
+    // Live spatial mapping patches streamed in over a socket
+    SpatialMeshIngest              spatial_ingest;
+
+    // Object edits streamed in over a socket
+    SceneEditServer                scene_edits;
+    unsigned int                   ias_edit_refits          = 0;  // IAS refits for moved objects since its last build
 };
 
 // Timer
@@ -183,20 +265,17 @@ PerformanceTimer& timer()
 // Scene data
 //
 //------------------------------------------------------------------------------
-// Buffers - These are initially dynamic
-int32_t TRIANGLE_COUNT = 0;
-int32_t MAT_COUNT = 0;
-
-std::vector<Vertex> d_vertices;
-std::vector<Material> d_mat_types;
-std::vector<uint32_t> d_material_indices;
-std::vector<float3> d_emission_colors;
-std::vector<float3> d_diffuse_colors;
-std::vector<float3> d_spec_colors;
-std::vector<float> d_spec_exp;
-std::vector<float> d_ior;
-std::vector<Triangle> d_triangles;
-std::vector<Light> d_lights;
+SceneBuilder scene;
+SceneSnapshot scene_snapshot;  // the running scene as loaded, what a reload is diffed against
+
+// Spatial mapping patch id -> index into scene.meshes
+std::map<uint64_t, uint32_t> spatial_patches;
+int spatial_material = -1;
+
+// Scene edit objects: the transform hierarchy, object id -> its node, and the node of every scene instance
+SceneGraph                             scene_graph;
+std::map<uint64_t, SceneGraph::NodeId> edit_objects;
+std::vector<SceneGraph::NodeId>        instance_nodes;
 
 static Vertex toVertex(glm::vec3& v, glm::mat4& t)
 {
@@ -205,18 +284,6 @@ static Vertex toVertex(glm::vec3& v, glm::mat4& t)
     return { v.x, v.y, v.z, 0.f };
 }
 
-static glm::vec3 randomColor(int i)
-{
-    {
-        int r = unsigned(i) * 13 * 17 + 0x234235;
-        int g = unsigned(i) * 7 * 3 * 5 + 0x773477;
-        int b = unsigned(i) * 11 * 19 + 0x223766;
-        return glm::vec3((r & 255) / 255.f,
-            (g & 255) / 255.f,
-            (b & 255) / 255.f);
-    }
-}
-
 static Vertex fixToUnitSphere(Vertex v) 
 {
     // fix vertex position to be on unit sphere
@@ -224,143 +291,13 @@ static Vertex fixToUnitSphere(Vertex v)
     return { v.x / length, v.y / length, v.z / length, 0.f };
 }
 
-static int addMaterial(Material m,
-                        float3 dif_col,
-                        float3 spec_col,
-                        float3 em_col,
-                        float spec_exp,
-                        float ior)
-{
-    d_mat_types.push_back(m);
-    d_diffuse_colors.push_back(dif_col);
-    d_spec_colors.push_back(spec_col);
-    d_emission_colors.push_back(em_col);
-    d_spec_exp.push_back(spec_exp);
-    d_ior.push_back(ior);
-    MAT_COUNT++;
-    return MAT_COUNT - 1;
-}
-
-// Reference: TinyOBJ Sample code: https://github.com/tinyobjloader/tinyobjloader
-Model* loadMesh(std::string filename) {
-
-    const std::string mtlDir
-        = filename.substr(0, filename.rfind('/') + 1);
-    Model* model = new Model;
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn;
-    std::string err;
-    bool material = false;
-    // load obj
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str(), mtlDir.c_str());
-
-    if (!warn.empty()) {
-        std::cout << warn << std::endl;
-    }
-
-    if (!err.empty()) {
-        std::cerr << err << std::endl;
-    }
-
-    if (!ret) {
-        exit(1);
-    }
-
-    if (!materials.empty())
-    {
-        material = true;
-        std::cout << "mtl file loaded!" << std::endl;
-    }
-    // Loop over shapes
-    for (size_t s = 0; s < shapes.size(); s++) {
-        // Loop over faces(polygon)
-
-        if (material)
-        {
-            model->material = true;
-            tinyobj::shape_t& shape = shapes[s];
-            size_t index_offset = 0;
-            std::set<int> materialIDs;
-            for (auto faceMatID : shape.mesh.material_ids)
-            {
-                materialIDs.insert(faceMatID);
-            }
-
-            for (int materialID : materialIDs) {
-                Mesh* mesh = new Mesh;
-
-                for (int f = 0; f < shape.mesh.material_ids.size(); f++) {
-                    if (shape.mesh.material_ids[f] != materialID) continue;
-                    Triangle* t = new Triangle;
-                    int fv = shape.mesh.num_face_vertices[f];
-
-                    for (size_t v = 0; v < fv; v++) {
-                        // access to vertex
-                        // Here only indices and vertices are useful
-                        tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-                        tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
-                        tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
-                        tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-
-                        t->vertex[v] = glm::vec3(vx, vy, vz);
-                    }
-                    index_offset += fv;
-
-                    // Compute the initial normal using glm::normalize
-                    t->normal = glm::normalize(glm::cross(t->vertex[1] - t->vertex[0], t->vertex[2] - t->vertex[0]));
-                    //t->diffuse = (const vec3f&)materials[materialID].diffuse;
-                    mesh->triangles.push_back(t);
-                }
-                mesh->diffuse = randomColor(materialID);
-                if (mesh->triangles.empty())
-                    delete mesh;
-                else
-                    model->meshes.push_back(mesh);
-            }
-        }
-        if (!material) {
-            model->material = false;
-            Mesh* mesh = new Mesh;
-            size_t index_offset = 0;
-            for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-                int fv = shapes[s].mesh.num_face_vertices[f];
-                // Loop over vertices in the face.
-                Triangle* t = new Triangle;
-
-                for (size_t v = 0; v < fv; v++) {
-                    // access to vertex
-                    // Here only indices and vertices are useful
-                    tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-                    tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
-                    tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
-                    tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-
-                    t->vertex[v] = glm::vec3(vx, vy, vz);
-                }
-
-                index_offset += fv;
-
-                // Compute the initial normal using glm::normalize
-                t->normal = glm::normalize(glm::cross(t->vertex[1] - t->vertex[0], t->vertex[2] - t->vertex[0]));
-                mesh->triangles.push_back(t);
-                d_triangles.push_back(*t);
-            }
-
-            model->meshes.push_back(mesh);
-        }
-    }
-    std::cout << "Loaded mesh with " << d_triangles.size() << " triangles from " << filename.c_str() << std::endl;
-    return model;
-}
-
 static void addSceneGeometry(Geom type,
                              int mat_id,
                              glm::vec3 pos,
                              glm::vec3 rot,
                              glm::vec3 s,
-                             std::string objfile) 
+                             std::string objfile,
+                             bool dynamic) 
 {
     // create a transform matrix from the pos, rot and s
     glm::mat4 translate = glm::translate(glm::mat4(), pos);
@@ -370,66 +307,74 @@ static void addSceneGeometry(Geom type,
     glm::mat4 scale = glm::scale(s);
     glm::mat4 transform = translate * rotateX * rotateY * rotateZ * scale;
 
-    // determine what kind of geometry is added
-
-    if (type == CUBE) {
-        // A cube is made of 12 triangles -> 36 vertices
-        // First create a unit cube, then transform the vertices. A unit cube has an edge length of 1.
-
-        // Add the vertices
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, 0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, 0.5f, 0.5f), transform));
-
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, 0.5f, 0.5f), transform));
-
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, -0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, -0.5f, 0.5f), transform));
-
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, -0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, 0.5f, 0.5f), transform));
-
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, 0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, -0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, 0.5f, -0.5f), transform));
-
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, 0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, -0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, -0.5f, -0.5f), transform));
-
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, -0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.5f, 0.5f), transform));
-
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, -0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, -0.5f, -0.5f), transform));
-
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, -0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, -0.5f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, -0.5f, -0.5f), transform));
-
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, -0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, -0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, -0.5f, 0.5f), transform));
+    // Triangle geometry is stored once in object space and placed in the scene by an instance transform.
+    // mesh is null when the same shape (and material) was added before, then only the instance is new.
+    SceneMesh* mesh = nullptr;
+    const ObjModel* model = nullptr;
+    if (type == CUBE || type == ICOSPHERE || type == MESH || type == AREA_LIGHT) {
+        std::string key;
+        if (type == MESH) {
+            if (objfile == "")
+            {
+                return;
+            }
+            // OBJ files with a material library create their own materials, otherwise mat_id applies
+            model = &scene.loadObjCached(objfile);
+            key = model->has_materials ? objfile : objfile + "#" + std::to_string(mat_id);
+        }
+        else {
+            const char* shape = type == CUBE ? "#cube#" : type == ICOSPHERE ? "#icosphere#" : "#plane#";
+            key = shape + std::to_string(mat_id);
+        }
+        // Dynamic geometry deforms independently of its copies, so it never shares a mesh
+        if (dynamic)
+            key += "#dynamic#" + std::to_string(scene.instances.size());
+
+        // glm matrices are column-major, OptixInstance::transform is row-major 3x4
+        float instance_transform[12];
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 4; ++c)
+                instance_transform[r * 4 + c] = transform[c][r];
+        mesh = scene.addInstance(key, instance_transform);
+        if (!mesh && type != AREA_LIGHT)
+            return;
+        if (mesh)
+            mesh->dynamic = dynamic;
+    }
 
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, 0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, -0.5f, -0.5f), transform));
+    // Spheres and area lights are intersected analytically unless they deform, which needs triangles
+    const bool analytic = !tessellate_primitives && !dynamic;
+    if (mesh && analytic && type == ICOSPHERE) {
+        mesh->type = GEOMETRY_SPHERES;
+        scene.allocate(*mesh, 1);
+        mesh->spheres[0] = { make_float3(0.f), 1.f };
+        mesh->material_indices[0] = mat_id;
+        return;
+    }
 
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, -0.5f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, -0.5f, -0.5f), transform));
+    // determine what kind of geometry is added
 
-        TRIANGLE_COUNT += 12;
+    if (type == CUBE) {
+        // A cube is made of 12 triangles -> 36 vertices of a unit cube, which has an edge length of 1
+        static const float3 cube[36] = {
+            { -0.5f, 0.5f, -0.5f }, { 0.5f, 0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f },
+            { -0.5f, 0.5f, -0.5f }, { -0.5f, 0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f },
+            { -0.5f, 0.5f, 0.5f }, { -0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f },
+            { -0.5f, 0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f },
+            { 0.5f, 0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { 0.5f, 0.5f, -0.5f },
+            { 0.5f, 0.5f, -0.5f }, { 0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, -0.5f },
+            { -0.5f, 0.5f, -0.5f }, { -0.5f, -0.5f, -0.5f }, { -0.5f, 0.5f, 0.5f },
+            { -0.5f, 0.5f, 0.5f }, { -0.5f, -0.5f, 0.5f }, { -0.5f, -0.5f, -0.5f },
+            { -0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { -0.5f, -0.5f, -0.5f },
+            { -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, 0.5f },
+            { -0.5f, 0.5f, -0.5f }, { 0.5f, 0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f },
+            { -0.5f, 0.5f, -0.5f }, { -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }
+        };
+        scene.allocate(*mesh, 12);
+        std::copy(cube, cube + 36, mesh->vertices.begin());
 
         // Add material id to mat indices
-        for (int i = 0; i < 12; ++i)
-            d_material_indices.push_back(mat_id);
+        std::fill(mesh->material_indices.begin(), mesh->material_indices.end(), mat_id);
     }
     else if (type == ICOSPHERE) {
         // a sphere can be created by subdividing an icosahedron
@@ -463,6 +408,7 @@ static void addSceneGeometry(Geom type,
         int rec_level = 3; // default subdivision level is set to 3, we can change it later
         for (int i = 0; i < rec_level; ++i) {
             std::vector<Vertex> temp_triangles_2;
+            temp_triangles_2.reserve(temp_triangles.size() * 4);
             for (int j = 0; j < temp_triangles.size(); j += 3) {
                 
                 // get the 3 vertices of the triangle
@@ -489,43 +435,47 @@ static void addSceneGeometry(Geom type,
                 temp_triangles_2.push_back(mid3);
             }
             // ping-pong vectors
-            temp_triangles = temp_triangles_2;
+            temp_triangles.swap(temp_triangles_2);
         }
 
         // Done with subdivision - now add the resulting vertices to the buffer as well the material indices per triangle
-        int num_triangles = 0;
-        for (int i = 0; i < temp_triangles.size(); ++i) {
-            if (i % 3 == 0) {
-                d_material_indices.push_back(mat_id);
-                num_triangles++;
-            }
-            Vertex v = temp_triangles[i];
-            d_vertices.push_back(toVertex(glm::vec3(v.x, v.y, v.z), transform));
+        scene.allocate(*mesh, temp_triangles.size() / 3);
+        for (size_t i = 0; i < temp_triangles.size(); ++i) {
+            const Vertex& v = temp_triangles[i];
+            mesh->vertices[i] = make_float3(v.x, v.y, v.z);
         }
-        TRIANGLE_COUNT += num_triangles;
+        std::fill(mesh->material_indices.begin(), mesh->material_indices.end(), mat_id);
     }
     else if (type == MESH) {
-        if(objfile == "")
-        {
-            return;
-        }
-        Model* model = loadMesh(objfile);
-        
-        for (int i = 0; i < model->meshes.size(); ++i)
+        // The model is already bucketed by material, every run becomes one contiguous range of the soup
+        const bool textured = !model->texcoords.empty();
+        scene.allocate(*mesh, model->numTriangles(), textured);
+        const float3* positions = reinterpret_cast<const float3*>(model->positions.data());
+        const float2* texcoords = reinterpret_cast<const float2*>(model->texcoords.data());
+        for (const ObjModel::MaterialRun& run : model->runs)
         {
-            Mesh* mesh = model->meshes[i];
-            int material_id = (model->material) ? addMaterial(DIFFUSE, make_float3(mesh->diffuse.x,mesh->diffuse.y,mesh->diffuse.z), make_float3(0.f), make_float3(0.f), 0.f, 0.f) : mat_id;
-            for (int j = 0; j < mesh->triangles.size(); ++j)
+            uint32_t material_id = mat_id;
+            if (model->has_materials && run.material >= 0) {
+                // The MTL colors and texture maps are shaded as a diffuse material, Ks tints nothing then
+                const ObjMaterial& m = model->materials[run.material];
+                const int32_t diffuse_texture = m.diffuse_texname.empty() ? -1 : scene.addTexture(m.diffuse_texname);
+                const int32_t specular_texture = m.specular_texname.empty() ? -1 : scene.addTexture(m.specular_texname);
+                material_id = scene.addMaterial(DIFFUSE, m.diffuse, m.specular, m.emission, m.shininess, m.ior, diffuse_texture, specular_texture);
+            }
+            else if (model->has_materials) {
+                // Faces without usemtl
+                material_id = scene.addMaterial(DIFFUSE, make_float3(0.7f), make_float3(0.f), make_float3(0.f), 0.f, 0.f);
+            }
+            for (uint32_t j = run.first_triangle; j < run.first_triangle + run.num_triangles; ++j)
             {
-                d_material_indices.push_back(material_id);
-                Triangle* t = mesh->triangles[j];
-                d_vertices.push_back(toVertex(t->vertex[0], transform));
-                d_vertices.push_back(toVertex(t->vertex[1], transform));
-                d_vertices.push_back(toVertex(t->vertex[2], transform));
-                TRIANGLE_COUNT += 1;
+                mesh->material_indices[j] = material_id;
+                mesh->vertices[3 * j + 0] = positions[model->indices[3 * j + 0]];
+                mesh->vertices[3 * j + 1] = positions[model->indices[3 * j + 1]];
+                mesh->vertices[3 * j + 2] = positions[model->indices[3 * j + 2]];
             }
+            if (textured)
+                std::copy(texcoords + 3 * run.first_triangle, texcoords + 3 * (run.first_triangle + run.num_triangles), mesh->texcoords.begin() + 3 * run.first_triangle);
         }
-        d_triangles.clear();
     }
     else if (type == AREA_LIGHT) {
         // We create area lights from 2-D planes
@@ -533,38 +483,46 @@ static void addSceneGeometry(Geom type,
         Vertex v1 = toVertex(glm::vec3(-0.5f, 0.f, -0.5f), transform);
         Vertex corner = toVertex(glm::vec3(0.5f, 0.f, -0.5f), transform);
         Vertex v2 = toVertex(glm::vec3(0.5f, 0.f, 0.5f), transform);
-        d_vertices.push_back(v1); d_vertices.push_back(corner); d_vertices.push_back(v2);
-
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.f, -0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(-0.5f, 0.f, 0.5f), transform));
-        d_vertices.push_back(toVertex(glm::vec3(0.5f, 0.f, 0.5f), transform));
-
-        // Push the material id twice, one per triangle
-        d_material_indices.push_back(mat_id);
-        d_material_indices.push_back(mat_id);
-
-        TRIANGLE_COUNT += 2;
+        if (mesh && analytic) {
+            mesh->type = GEOMETRY_PARALLELOGRAMS;
+            scene.allocate(*mesh, 1);
+            mesh->parallelograms[0] = make_float3(-0.5f, 0.f, -0.5f);
+            mesh->parallelograms[1] = make_float3(1.f, 0.f, 0.f);
+            mesh->parallelograms[2] = make_float3(0.f, 0.f, 1.f);
+            mesh->material_indices[0] = mat_id;
+        }
+        else if (mesh) {
+            static const float3 plane[6] = {
+                { -0.5f, 0.f, -0.5f }, { 0.5f, 0.f, -0.5f }, { 0.5f, 0.f, 0.5f },
+                { -0.5f, 0.f, -0.5f }, { -0.5f, 0.f, 0.5f }, { 0.5f, 0.f, 0.5f }
+            };
+            scene.allocate(*mesh, 2);
+            std::copy(plane, plane + 6, mesh->vertices.begin());
+
+            // One material id per triangle
+            std::fill(mesh->material_indices.begin(), mesh->material_indices.end(), mat_id);
+        }
         // Create a light if material is emissive
-        if (d_mat_types[mat_id] == EMISSIVE) {
+        if (scene.materials.types[mat_id] == EMISSIVE) {
             float3 c = make_float3(corner.x, corner.y, corner.z); //corner
             float3 v1f = make_float3(v1.x - c.x, 0.f, 0.f); //v1
             float3 v2f = make_float3(0.f, 0.f, v2.z - c.z); //v2
             float3 n = normalize(-cross(v1f, v2f));
-            d_lights.push_back({ AREA_LIGHT, c, v1f, v2f, n, d_emission_colors[mat_id], 0.f, 0.f });
+            scene.lights.push_back({ AREA_LIGHT, c, v1f, v2f, n, scene.materials.emission[mat_id], 0.f, 0.f });
         }
     }
     else if (type == POINT_LIGHT) {
         // We only allow point geometry for light sources
-        if (d_mat_types[mat_id] != EMISSIVE) return;
+        if (scene.materials.types[mat_id] != EMISSIVE) return;
         Vertex pos = toVertex(glm::vec3(0.f, 0.f, 0.f), transform);
-        // We can't have the point light itself to be visible since points are not supported by our triangle GAS so we won't be adding it to d_vertices
+        // We can't have the point light itself to be visible since points are not supported by our triangle GAS so we won't be adding it to the scene meshes
 
         float3 pos_f = make_float3(pos.x, pos.y, pos.z);
-        d_lights.push_back({ POINT_LIGHT, pos_f, pos_f, pos_f, make_float3(0.f), d_emission_colors[mat_id], 0.f, 0.f });
+        scene.lights.push_back({ POINT_LIGHT, pos_f, pos_f, pos_f, make_float3(0.f), scene.materials.emission[mat_id], 0.f, 0.f });
     }
     else if (type == SPOT_LIGHT) {
         // We only allow spot light geometry for light sources
-        if (d_mat_types[mat_id] != EMISSIVE) return;
+        if (scene.materials.types[mat_id] != EMISSIVE) return;
         // A spotlight is very similar to a point light in terms of being represented by a single point rather than triangle(s)
         // However, a spotlight needs additional light parameters to be set
         Vertex pos = toVertex(glm::vec3(0.f, 0.f, 0.f), transform);
@@ -572,7 +530,7 @@ static void addSceneGeometry(Geom type,
         // The normal of point lights is simply the direction the spot light cone is facing
         glm::vec4 norm = rotateX * rotateY * rotateZ * glm::vec4(0.f, -1.f, 0.f, 1.f);
         float3 n = normalize(make_float3(norm.x, norm.y, norm.z));
-        d_lights.push_back({ SPOT_LIGHT, pos_f, pos_f, pos_f, n, d_emission_colors[mat_id], glm::cos(25.f * (float)M_PI / 180.f), glm::cos(20.f * (float)M_PI / 180.f) });
+        scene.lights.push_back({ SPOT_LIGHT, pos_f, pos_f, pos_f, n, scene.materials.emission[mat_id], glm::cos(25.f * (float)M_PI / 180.f), glm::cos(20.f * (float)M_PI / 180.f) });
     }
 }
 
@@ -683,38 +641,158 @@ void printUsageAndExit( const char* argv0 )
     std::cerr << "         --launch-samples | -s       Number of samples per pixel per launch (default 16)\n";
     std::cerr << "         --no-gl-interop             Disable GL interop for display\n";
     std::cerr << "         --dim=<width>x<height>      Set image dimensions; defaults to 768x768\n";
+    std::cerr << "         --denoise                   Run the edge-aware CPU denoiser on every frame\n";
+    std::cerr << "         --no-reproject              Restart accumulation on camera moves instead of reprojecting it\n";
+    std::cerr << "         --max-history <n>           History length clamp for reprojected pixels (default 64)\n";
+    std::cerr << "         --no-history-clamp          Blend reprojected history without clamping it to the current neighborhood\n";
+    std::cerr << "         --adaptive                  Only trace pixels that have not converged yet\n";
+    std::cerr << "         --adaptive-threshold <t>    Relative error below which a pixel is converged (default 0.02)\n";
+    std::cerr << "         --cache-primary-hits        Trace the first hits once and reuse them while the camera is static\n";
+    std::cerr << "         --indirect-scale <1|2|4>    Trace indirect bounces at 1/n resolution and upsample them (default 1)\n";
+    std::cerr << "         --snorm16-positions         Store vertex positions as snorm16 relative to the mesh bounds\n";
+    std::cerr << "         --tessellate                Triangulate spheres and area lights instead of intersecting them analytically\n";
+    std::cerr << "         --scene-cache <file>        Binary scene cache to load and write (default <scene>.rrscene)\n";
+    std::cerr << "         --no-scene-cache            Always parse the scene and its OBJ files, do not write a cache\n";
+    std::cerr << "         --convert-scene             Parse the scene, write its cache and exit\n";
+    std::cerr << "         --benchmark-scene-cache     Time parsing the scene against loading its cache and exit\n";
+    std::cerr << "         --ptx-cache <dir>           Directory of the NVRTC PTX cache (default OPTIX_SAMPLES_PTX_CACHE_DIR or the user cache directory)\n";
+    std::cerr << "         --no-ptx-cache              Compile the CUDA code with NVRTC on every start\n";
+    std::cerr << "         --accel-cache <file>        Cache of built acceleration structures (default <scene>.rraccel)\n";
+    std::cerr << "         --no-accel-cache            Always build the acceleration structures, do not write a cache\n";
+    std::cerr << "         --watch                     Reload the scene when it or one of its OBJ and MTL files changes\n";
+    std::cerr << "         --animate                   Deform the DYNAMIC scene geometry every frame\n";
+    std::cerr << "         --refit-threshold <f>       Rebuild a dynamic GAS once its vertices deformed this many edge lengths on average (default 1)\n";
+    std::cerr << "         --benchmark-refit           Time refit against rebuild for every DYNAMIC mesh at startup\n";
+    std::cerr << "         --benchmark-subframes <n>   Time n static camera subframes with and without the primary hit cache and adaptive moments at startup\n";
+    std::cerr << "         --benchmark-materials <n>   Compare the material table against a hit group record per material at startup, n iterations each\n";
+    std::cerr << "         --spatial-port <port>       Accept live spatial mapping patches on this TCP port\n";
+    std::cerr << "         --spatial-cell <meters>     Decimation grid of the spatial mapping patches, 0 only welds (default 0.02)\n";
+    std::cerr << "         --edit-port <port>          Accept object, material and light edits on this TCP port\n";
+    std::cerr << "         --texture-memory <MB>       Device memory for resident material texture tiles, 0 for no limit (default 1024)\n";
     std::cerr << "         --help | -h                 Print this usage message\n";
     exit( 0 );
 }
 
 
+/*
+    Accumulation and AOV buffers. The accumulation, normal and depth buffers are double buffered so that
+    the previous launch stays readable for temporal reprojection. The launch buffer holds the colors of
+    a reprojected launch until the resolve pass has blended them in.
+*/
+void allocFrameBuffers( Params& params )
+{
+    const size_t num_pixels = static_cast<size_t>( params.width ) * params.height;
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.accum_buffer ), num_pixels * sizeof( float4 ) ) );
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.albedo_buffer ), num_pixels * sizeof( float4 ) ) );
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.normal_buffer ), num_pixels * sizeof( float4 ) ) );
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.depth_buffer ), num_pixels * sizeof( float ) ) );
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.prev_accum_buffer ), num_pixels * sizeof( float4 ) ) );
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.prev_normal_buffer ), num_pixels * sizeof( float4 ) ) );
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.prev_depth_buffer ), num_pixels * sizeof( float ) ) );
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.launch_buffer ), num_pixels * sizeof( float4 ) ) );
+
+    if( params.adaptive_sampling )
+    {
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.moment_buffer ), num_pixels * sizeof( float4 ) ) );
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.convergence_mask ), num_pixels * sizeof( unsigned char ) ) );
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.active_pixels ), num_pixels * sizeof( unsigned int ) ) );
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.next_active_pixels ), num_pixels * sizeof( unsigned int ) ) );
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.num_next_active_pixels ), sizeof( unsigned int ) ) );
+    }
+    params.num_active_pixels = 0;
+
+    if( params.cache_primary_hits )
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.primary_hits ), num_pixels * params.samples_per_launch * sizeof( PrimaryHit ) ) );
+    params.primary_hits_valid = 0;
+
+    if( params.indirect_scale > 1 )
+    {
+        const size_t num_texels = static_cast<size_t>( Upsampler::lowResolution( params.width, params.indirect_scale ) )
+                                * Upsampler::lowResolution( params.height, params.indirect_scale );
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.indirect_buffer ), num_texels * sizeof( float4 ) ) );
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &params.indirect_guide ), num_texels * sizeof( float4 ) ) );
+    }
+}
+
+
+void freeFrameBuffers( Params& params )
+{
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.accum_buffer ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.albedo_buffer ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.normal_buffer ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.depth_buffer ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.prev_accum_buffer ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.prev_normal_buffer ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.prev_depth_buffer ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.launch_buffer ) ) );
+
+    if( params.adaptive_sampling )
+    {
+        CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.moment_buffer ) ) );
+        CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.convergence_mask ) ) );
+        CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.active_pixels ) ) );
+        CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.next_active_pixels ) ) );
+        CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.num_next_active_pixels ) ) );
+    }
+
+    if( params.cache_primary_hits )
+        CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.primary_hits ) ) );
+
+    if( params.indirect_scale > 1 )
+    {
+        CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.indirect_buffer ) ) );
+        CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.indirect_guide ) ) );
+    }
+}
+
+
 void initLaunchParams( PathTracerState& state )
 {
     /* 
     * Copy light data to device
     */
-    const size_t lights_size_in_bytes = d_lights.size() * sizeof(Light);
+    const size_t lights_size_in_bytes = scene.lights.size() * sizeof(Light);
     CUDA_CHECK(cudaMalloc(reinterpret_cast<void**>(&state.d_lights), lights_size_in_bytes));
     CUDA_CHECK(cudaMemcpy(
         reinterpret_cast<void*>(state.d_lights),
-        d_lights.data(), lights_size_in_bytes,
+        scene.lights.data(), lights_size_in_bytes,
         cudaMemcpyHostToDevice
     ));
 
-    CUDA_CHECK( cudaMalloc(
-                reinterpret_cast<void**>( &state.params.accum_buffer ),
-                state.params.width * state.params.height * sizeof( float4 )
-                ) );
+    state.params.adaptive_sampling              = adaptive_sampling ? 1u : 0u;
+    state.params.adaptive.error_threshold       = convergence_threshold;
+    state.params.adaptive.min_launches          = 8u;
+    state.params.moment_buffer                  = nullptr;
+    state.params.convergence_mask               = nullptr;
+    state.params.active_pixels                  = nullptr;
+    state.params.next_active_pixels             = nullptr;
+    state.params.num_next_active_pixels         = nullptr;
+    state.params.cache_primary_hits             = cache_primary_hits ? 1u : 0u;
+    state.params.primary_hits                   = nullptr;
+    state.params.samples_per_launch             = samples_per_launch;
+    state.params.indirect_scale                 = indirect_scale;
+    state.params.indirect_pass                  = 0u;
+    state.params.indirect_buffer                = nullptr;
+    state.params.indirect_guide                 = nullptr;
+
+    allocFrameBuffers( state.params );
     state.params.frame_buffer = nullptr;  // Will be set when output buffer is mapped
 
-    state.params.samples_per_launch = samples_per_launch;
     state.params.depth = depth;
     state.params.subframe_index     = 0u;
 
+    state.params.camera_moved                  = 0u;
+    state.params.reprojection.depth_tolerance  = 0.05f;
+    state.params.reprojection.normal_threshold = 0.9f;
+    state.params.reprojection.max_history      = max_history;
+    state.params.reprojection.clamp_history    = clamp_history ? 1u : 0u;
+    state.params.resolve_pass                  = 0u;
+
     // Get light sources in the scene
     state.params.lights         = reinterpret_cast<Light*>(state.d_lights);
-    state.params.num_lights     = d_lights.size();
-    state.params.handle         = state.gas_handle;
+    state.params.geometries     = reinterpret_cast<const GeometryData*>( state.d_geometries );
+    state.params.num_lights     = scene.lights.size();
+    state.params.handle         = state.ias_handle;
 
     CUDA_CHECK( cudaStreamCreate( &state.stream ) );
     CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &state.d_params ), sizeof( Params ) ) );
@@ -728,9 +806,18 @@ void handleCameraUpdate( Params& params )
         return;
     camera_changed = false;
 
+    // Keep the camera of the previous launch for temporal reprojection
+    params.prev_eye = params.eye;
+    params.prev_U   = params.U;
+    params.prev_V   = params.V;
+    params.prev_W   = params.W;
+
     camera.setAspectRatio( static_cast<float>( params.width ) / static_cast<float>( params.height ) );
     params.eye = camera.eye();
     camera.UVWFrame( params.U, params.V, params.W );
+
+    // Angle subtended by one pixel row, the spread of the ray cones that pick texture mip levels
+    params.pixel_spread = atanf( 2.0f * length( params.V ) / ( length( params.W ) * static_cast<float>( params.height ) ) );
 }
 
 
@@ -742,23 +829,52 @@ void handleResize( sutil::CUDAOutputBuffer<uchar4>& output_buffer, Params& param
 
     output_buffer.resize( params.width, params.height );
 
-    // Realloc accumulation buffer
-    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( params.accum_buffer ) ) );
-    CUDA_CHECK( cudaMalloc(
-                reinterpret_cast<void**>( &params.accum_buffer ),
-                params.width * params.height * sizeof( float4 )
-                ) );
+    // Realloc accumulation and AOV buffers
+    freeFrameBuffers( params );
+    allocFrameBuffers( params );
 }
 
 
 void updateState( sutil::CUDAOutputBuffer<uchar4>& output_buffer, Params& params )
 {
     // Update params on device
-    if( camera_changed || resize_dirty )
+    // With reprojection enabled, a camera move keeps the accumulation and the raygen program reprojects it
+    // Moving geometry cannot be reprojected, it always restarts the accumulation
+    if( resize_dirty || geometry_changed || shading_changed || textures_changed || ( camera_changed && !reproject ) )
         params.subframe_index = 0;
+    params.camera_moved = camera_changed ? 1u : 0u;
+
+    // Any change invalidates the convergence state and the cached primary hits - trace every pixel again
+    if( camera_changed || resize_dirty || geometry_changed )
+    {
+        params.num_active_pixels  = 0;
+        params.primary_hits_valid = 0;
+        image_converged           = false;
+    }
+
+    // Material and light edits or newly resident tiles change the shading but not the primary hits, only the
+    // accumulation restarts
+    if( shading_changed || textures_changed )
+    {
+        params.num_active_pixels = 0;
+        image_converged          = false;
+    }
+
+    geometry_changed = false;
+    shading_changed  = false;
+    textures_changed = false;
 
     handleCameraUpdate( params );
     handleResize( output_buffer, params );
+
+    // On a camera move the buffers written by the previous launch become the history of this one.
+    // Otherwise the raygen program accumulates in place.
+    if( params.camera_moved )
+    {
+        std::swap( params.accum_buffer, params.prev_accum_buffer );
+        std::swap( params.normal_buffer, params.prev_normal_buffer );
+        std::swap( params.depth_buffer, params.prev_depth_buffer );
+    }
 }
 
 
@@ -767,23 +883,192 @@ void launchSubframe( sutil::CUDAOutputBuffer<uchar4>& output_buffer, PathTracerS
     // Launch
     uchar4* result_buffer_data = output_buffer.map();
     state.params.frame_buffer  = result_buffer_data;
+    if( state.params.subframe_index == 0 )
+        state.textures.restartAccumulation();
+    state.textures.launchPrepare( state.params.demand_textures );
     CUDA_CHECK( cudaMemcpyAsync(
                 reinterpret_cast<void*>( state.d_params ),
                 &state.params, sizeof( Params ),
                 cudaMemcpyHostToDevice, state.stream
                 ) );
+    if( state.params.adaptive_sampling )
+        CUDA_CHECK( cudaMemsetAsync( state.params.num_next_active_pixels, 0, sizeof( unsigned int ), state.stream ) );
+
+    // Adaptive launches only cover the pixels that were not converged after the previous launch
+    const bool adaptive_launch = state.params.num_active_pixels > 0;
     OPTIX_CHECK( optixLaunch(
                 state.pipeline,
                 state.stream,
                 reinterpret_cast<CUdeviceptr>( state.d_params ),
                 sizeof( Params ),
                 &state.sbt,
-                state.params.width,   // launch width
-                state.params.height,  // launch height
-                1                     // launch depth
+                adaptive_launch ? state.params.num_active_pixels : state.params.width,   // launch width
+                adaptive_launch ? 1 : state.params.height,                               // launch height
+                1                                                                        // launch depth
                 ) );
+
+    // A reprojected launch left its colors in the launch buffer, blend them with the clamped history
+    if( state.params.camera_moved && state.params.subframe_index > 0 )
+    {
+        state.params.resolve_pass = 1u;
+        CUDA_CHECK( cudaMemcpyAsync(
+                    reinterpret_cast<void*>( state.d_params ),
+                    &state.params, sizeof( Params ),
+                    cudaMemcpyHostToDevice, state.stream
+                    ) );
+        state.params.resolve_pass = 0u;
+        OPTIX_CHECK( optixLaunch(
+                    state.pipeline,
+                    state.stream,
+                    reinterpret_cast<CUdeviceptr>( state.d_params ),
+                    sizeof( Params ),
+                    &state.sbt,
+                    state.params.width,    // launch width
+                    state.params.height,   // launch height
+                    1                      // launch depth
+                    ) );
+    }
+
+    // Decoupled shading: trace the indirect bounces at reduced resolution
+    if( state.params.indirect_scale > 1 )
+    {
+        state.params.indirect_pass = 1u;
+        CUDA_CHECK( cudaMemcpyAsync(
+                    reinterpret_cast<void*>( state.d_params ),
+                    &state.params, sizeof( Params ),
+                    cudaMemcpyHostToDevice, state.stream
+                    ) );
+        state.params.indirect_pass = 0u;
+        OPTIX_CHECK( optixLaunch(
+                    state.pipeline,
+                    state.stream,
+                    reinterpret_cast<CUdeviceptr>( state.d_params ),
+                    sizeof( Params ),
+                    &state.sbt,
+                    Upsampler::lowResolution( state.params.width, state.params.indirect_scale ),    // launch width
+                    Upsampler::lowResolution( state.params.height, state.params.indirect_scale ),   // launch height
+                    1                                                                               // launch depth
+                    ) );
+    }
     output_buffer.unmap();
     CUDA_SYNC_CHECK();
+
+    // Map the texture tiles this launch missed, the next launch samples them. Only tiles this accumulation
+    // fell back to coarser levels for restart it, see MaterialTextures.h
+    if( state.textures.processRequests() > 0 )
+        textures_changed = true;
+
+    // A launch with an invalid cache is always a full launch and rewrote every primary hit
+    if( state.params.cache_primary_hits )
+        state.params.primary_hits_valid = 1;
+
+    if( state.params.adaptive_sampling )
+    {
+        unsigned int num_active_pixels = 0;
+        CUDA_CHECK( cudaMemcpy( &num_active_pixels, state.params.num_next_active_pixels, sizeof( unsigned int ), cudaMemcpyDeviceToHost ) );
+        std::swap( state.params.active_pixels, state.params.next_active_pixels );
+        state.params.num_active_pixels = num_active_pixels;
+        if( num_active_pixels == 0 )
+        {
+            image_converged = true;
+            std::cout << "image converged after " << state.params.subframe_index + 1 << " subframes" << std::endl;
+        }
+    }
+}
+
+
+/*
+    Run the CPU denoiser on the accumulated frame and overwrite the output buffer with the result.
+    The output buffer must be ZERO_COPY so that the host pointer is the buffer that gets saved and displayed.
+*/
+void denoiseSubframe( sutil::CUDAOutputBuffer<uchar4>& output_buffer, PathTracerState& state )
+{
+    const size_t num_pixels = static_cast<size_t>( state.params.width ) * state.params.height;
+    state.h_accum.resize( num_pixels );
+    state.h_albedo.resize( num_pixels );
+    state.h_normal.resize( num_pixels );
+    state.h_depth.resize( num_pixels );
+
+    CUDA_CHECK( cudaMemcpy( state.h_accum.data(), state.params.accum_buffer, num_pixels * sizeof( float4 ), cudaMemcpyDeviceToHost ) );
+    CUDA_CHECK( cudaMemcpy( state.h_albedo.data(), state.params.albedo_buffer, num_pixels * sizeof( float4 ), cudaMemcpyDeviceToHost ) );
+    CUDA_CHECK( cudaMemcpy( state.h_normal.data(), state.params.normal_buffer, num_pixels * sizeof( float4 ), cudaMemcpyDeviceToHost ) );
+    CUDA_CHECK( cudaMemcpy( state.h_depth.data(), state.params.depth_buffer, num_pixels * sizeof( float ), cudaMemcpyDeviceToHost ) );
+
+    // The accumulation restarted or was reprojected, so the temporal moments of the filter are stale
+    if( state.params.subframe_index == 0 || state.params.camera_moved )
+        state.denoiser.resetHistory();
+
+    state.denoiser.filter(
+            state.params.width,
+            state.params.height,
+            state.h_accum.data(),
+            state.h_albedo.data(),
+            state.h_normal.data(),
+            state.h_depth.data(),
+            output_buffer.getHostPointer()
+            );
+}
+
+
+/*
+    Decoupled shading: upsample the indirect light with the full resolution first-hit normal and depth as guide
+    and add it, remodulated by the full resolution albedo, to the direct lighting in accum_buffer. The result
+    goes through the denoiser when it is enabled and overwrites the output buffer (which must be ZERO_COPY).
+*/
+void compositeSubframe( sutil::CUDAOutputBuffer<uchar4>& output_buffer, PathTracerState& state )
+{
+    const unsigned int width      = state.params.width;
+    const unsigned int height     = state.params.height;
+    const size_t       num_pixels = static_cast<size_t>( width ) * height;
+    const size_t       num_texels = static_cast<size_t>( Upsampler::lowResolution( width, state.params.indirect_scale ) )
+                                  * Upsampler::lowResolution( height, state.params.indirect_scale );
+    state.h_accum.resize( num_pixels );
+    state.h_albedo.resize( num_pixels );
+    state.h_normal.resize( num_pixels );
+    state.h_depth.resize( num_pixels );
+    state.h_indirect.resize( num_texels );
+    state.h_indirect_guide.resize( num_texels );
+    state.h_indirect_full.resize( num_pixels );
+
+    CUDA_CHECK( cudaMemcpy( state.h_accum.data(), state.params.accum_buffer, num_pixels * sizeof( float4 ), cudaMemcpyDeviceToHost ) );
+    CUDA_CHECK( cudaMemcpy( state.h_albedo.data(), state.params.albedo_buffer, num_pixels * sizeof( float4 ), cudaMemcpyDeviceToHost ) );
+    CUDA_CHECK( cudaMemcpy( state.h_normal.data(), state.params.normal_buffer, num_pixels * sizeof( float4 ), cudaMemcpyDeviceToHost ) );
+    CUDA_CHECK( cudaMemcpy( state.h_depth.data(), state.params.depth_buffer, num_pixels * sizeof( float ), cudaMemcpyDeviceToHost ) );
+    CUDA_CHECK( cudaMemcpy( state.h_indirect.data(), state.params.indirect_buffer, num_texels * sizeof( float4 ), cudaMemcpyDeviceToHost ) );
+    CUDA_CHECK( cudaMemcpy( state.h_indirect_guide.data(), state.params.indirect_guide, num_texels * sizeof( float4 ), cudaMemcpyDeviceToHost ) );
+
+    state.upsampler.upsample(
+            width,
+            height,
+            state.params.indirect_scale,
+            state.h_indirect.data(),
+            state.h_indirect_guide.data(),
+            state.h_normal.data(),
+            state.h_depth.data(),
+            state.h_indirect_full.data()
+            );
+
+    for( size_t i = 0; i < num_pixels; ++i )
+    {
+        float4&       c        = state.h_accum[i];
+        const float4& a        = state.h_albedo[i];
+        const float4& indirect = state.h_indirect_full[i];
+        c.x += a.x * indirect.x;
+        c.y += a.y * indirect.y;
+        c.z += a.z * indirect.z;
+    }
+
+    uchar4* out = output_buffer.getHostPointer();
+    if( denoise )
+    {
+        if( state.params.subframe_index == 0 || state.params.camera_moved )
+            state.denoiser.resetHistory();
+        state.denoiser.filter( width, height, state.h_accum.data(), state.h_albedo.data(), state.h_normal.data(), state.h_depth.data(), out );
+        return;
+    }
+
+    for( size_t i = 0; i < num_pixels; ++i )
+        out[i] = make_uchar4( toSRGB8( state.h_accum[i].x ), toSRGB8( state.h_accum[i].y ), toSRGB8( state.h_accum[i].z ), 255u );
 }
 
 
@@ -839,7 +1124,8 @@ float3 readCameraFile(std::string& scene_file) {
         }
     }
 }
-void readSceneFile(std::string& scene_file)
+// With load_geometry false only the camera is read, the materials and geometry come from the scene cache
+void readSceneFile(std::string& scene_file, bool load_geometry = true)
 {
     std::cout << "Reading scene file: " << scene_file << std::endl;
     char* fname = (char*)scene_file.c_str();
@@ -859,10 +1145,15 @@ void readSceneFile(std::string& scene_file)
                 tokens.push_back(token);
             }
             // process the tokens
-            if (tokens.size() != 7) {
+            // GEOMETRY lines may end with an optional DYNAMIC flag
+            const bool dynamic = tokens.size() == 8 && tokens[0] == "GEOMETRY" && tokens[7] == "DYNAMIC";
+            if (tokens.size() != 7 && !dynamic) {
                 std::cout << "Invalid argument count at line " << line_num << std::endl;
                 continue;
             }
+            if (!load_geometry && tokens[0] != "CAMERA") {
+                continue;
+            }
 
             // check if we're reading material, geometry or camera
             if (strcmp(tokens[0].c_str(), "MATERIAL") == 0) {
@@ -932,7 +1223,7 @@ void readSceneFile(std::string& scene_file)
                 float ior = atof(tokens[6].c_str());
                 // add material
                 std::cout << type << " material added!" << std::endl;
-                addMaterial(type, diffuse,specular, emissive, spec_exp, ior);
+                scene.addMaterial(type, diffuse,specular, emissive, spec_exp, ior);
             }
             else if (strcmp(tokens[0].c_str(), "GEOMETRY") == 0) {
                 // read geometry type
@@ -1004,7 +1295,7 @@ void readSceneFile(std::string& scene_file)
                 std::string obj_file = tokens[6];
                 // create geometry
                 std::cout << type << " geometry added!" << std::endl;
-                addSceneGeometry(type, mat_id, translate, rotate, scale, obj_file);
+                addSceneGeometry(type, mat_id, translate, rotate, scale, obj_file, dynamic);
             }
             else if (strcmp(tokens[0].c_str(), "CAMERA") == 0) {
                 if (cam_set) {
@@ -1074,6 +1365,59 @@ void readSceneFile(std::string& scene_file)
 }
 
 
+// Weld (or, for cached scenes, just index) every triangle mesh as the GAS builds do; returns the triangle count
+static size_t prepareHostGeometry( const SceneBuilder& builder )
+{
+    size_t triangles = 0;
+    for( const SceneMesh& mesh : builder.meshes )
+    {
+        if( mesh.type != GEOMETRY_TRIANGLES )
+            continue;
+        const IndexedMesh<float3> indexed = mesh.indices.empty()
+                                                ? weldTriangleSoup( mesh.vertices.data(), mesh.vertices.size() )
+                                                : makeIndexedMesh( mesh.vertices.data(), mesh.vertices.size(),
+                                                                   mesh.indices.data(), mesh.indices.size() );
+        triangles += indexed.indices.size();
+    }
+    return triangles;
+}
+
+
+// --benchmark-scene-cache: time parsing the scene against mapping its cache, up to the GAS build input
+void benchmarkSceneCache( std::string& scene_file, const std::string& cache_file )
+{
+    const int      iterations = 5;
+    const uint64_t options    = sceneCacheOptions( tessellate_primitives );
+    double         ms[2][2]   = {};  // [parse, cache][load, weld]
+    for( int it = 0; it < iterations; ++it )
+    {
+        for( int cached = 0; cached < 2; ++cached )
+        {
+            scene = SceneBuilder();
+            std::string reason;
+            const auto  t0 = std::chrono::steady_clock::now();
+            if( cached && !loadSceneCache( cache_file, scene_file, options, scene, reason ) )
+                throw std::runtime_error( "--benchmark-scene-cache: " + cache_file + ": " + reason );
+            readSceneFile( scene_file, !cached );
+            scene.releaseObjCache();
+            const auto t1 = std::chrono::steady_clock::now();
+            prepareHostGeometry( scene );
+            const auto t2 = std::chrono::steady_clock::now();
+            ms[cached][0] += std::chrono::duration<double, std::milli>( t1 - t0 ).count();
+            ms[cached][1] += std::chrono::duration<double, std::milli>( t2 - t1 ).count();
+        }
+    }
+
+    std::cout << "Scene startup (" << iterations << " iterations, ms): " << scene.numPrimitives() << " primitives\n"
+              << std::setw( 8 ) << "" << std::setw( 12 ) << "load" << std::setw( 12 ) << "weld" << std::setw( 12 ) << "total\n";
+    const char* names[2] = { "parse", "cache" };
+    for( int cached = 0; cached < 2; ++cached )
+        std::cout << std::fixed << std::setprecision( 2 ) << std::setw( 8 ) << names[cached]
+                  << std::setw( 12 ) << ms[cached][0] / iterations << std::setw( 12 ) << ms[cached][1] / iterations
+                  << std::setw( 12 ) << ( ms[cached][0] + ms[cached][1] ) / iterations << std::endl;
+}
+
+
 void createContext( PathTracerState& state )
 {
     // Initialize CUDA
@@ -1091,164 +1435,950 @@ void createContext( PathTracerState& state )
 }
 
 
-void buildMeshAccel( PathTracerState& state )
+//
+// Build an acceleration structure from a single build input. With allow_compaction the result is
+// compacted when that saves memory. Returns the size of the final output buffer.
+//
+static size_t buildAccel( OptixDeviceContext         context,
+                          const OptixBuildInput&     build_input,
+                          bool                       allow_compaction,
+                          CUdeviceptr&               d_output_buffer,
+                          OptixTraversableHandle&    handle )
 {
-    //
-    // copy mesh data to device
-    //
-    const size_t vertices_size_in_bytes = d_vertices.size() * sizeof( Vertex );
-    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &state.d_vertices ), vertices_size_in_bytes ) );
-    CUDA_CHECK( cudaMemcpy(
-                reinterpret_cast<void*>( state.d_vertices ),
-                d_vertices.data(), vertices_size_in_bytes,
-                cudaMemcpyHostToDevice
-                ) );
-
-    CUdeviceptr  d_mat_indices             = 0;
-    const size_t mat_indices_size_in_bytes = d_material_indices.size() * sizeof( uint32_t );
-    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_mat_indices ), mat_indices_size_in_bytes ) );
-    CUDA_CHECK( cudaMemcpy(
-                reinterpret_cast<void*>( d_mat_indices ),
-                d_material_indices.data(),
-                mat_indices_size_in_bytes,
-                cudaMemcpyHostToDevice
-                ) );
-
-    //
-    // Build triangle GAS
-    //
-
-    std::vector<uint32_t> triangle_input_flags; // One per SBT record for this build input
-    for (int i = 0; i < MAT_COUNT; ++i) {
-        triangle_input_flags.push_back(OPTIX_GEOMETRY_FLAG_DISABLE_ANYHIT);
-    }
-
-    OptixBuildInput triangle_input                           = {};
-    triangle_input.type                                      = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
-    triangle_input.triangleArray.vertexFormat                = OPTIX_VERTEX_FORMAT_FLOAT3;
-    triangle_input.triangleArray.vertexStrideInBytes         = sizeof( Vertex );
-    triangle_input.triangleArray.numVertices                 = static_cast<uint32_t>( d_vertices.size() );
-    triangle_input.triangleArray.vertexBuffers               = &state.d_vertices;
-    triangle_input.triangleArray.flags                       = triangle_input_flags.data();
-    triangle_input.triangleArray.numSbtRecords               = MAT_COUNT;
-    triangle_input.triangleArray.sbtIndexOffsetBuffer        = d_mat_indices;
-    triangle_input.triangleArray.sbtIndexOffsetSizeInBytes   = sizeof( uint32_t );
-    triangle_input.triangleArray.sbtIndexOffsetStrideInBytes = sizeof( uint32_t );
-
     OptixAccelBuildOptions accel_options = {};
-    accel_options.buildFlags             = OPTIX_BUILD_FLAG_ALLOW_COMPACTION;
+    accel_options.buildFlags             = allow_compaction ? OPTIX_BUILD_FLAG_ALLOW_COMPACTION : OPTIX_BUILD_FLAG_NONE;
     accel_options.operation              = OPTIX_BUILD_OPERATION_BUILD;
 
-    OptixAccelBufferSizes gas_buffer_sizes;
+    OptixAccelBufferSizes buffer_sizes;
     OPTIX_CHECK( optixAccelComputeMemoryUsage(
-                state.context,
+                context,
                 &accel_options,
-                &triangle_input,
+                &build_input,
                 1,  // num_build_inputs
-                &gas_buffer_sizes
+                &buffer_sizes
                 ) );
 
     CUdeviceptr d_temp_buffer;
-    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_temp_buffer ), gas_buffer_sizes.tempSizeInBytes ) );
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_temp_buffer ), buffer_sizes.tempSizeInBytes ) );
 
     // non-compacted output
-    CUdeviceptr d_buffer_temp_output_gas_and_compacted_size;
-    size_t      compactedSizeOffset = roundUp<size_t>( gas_buffer_sizes.outputSizeInBytes, 8ull );
+    CUdeviceptr d_buffer_temp_output_and_compacted_size;
+    size_t      compactedSizeOffset = roundUp<size_t>( buffer_sizes.outputSizeInBytes, 8ull );
     CUDA_CHECK( cudaMalloc(
-                reinterpret_cast<void**>( &d_buffer_temp_output_gas_and_compacted_size ),
+                reinterpret_cast<void**>( &d_buffer_temp_output_and_compacted_size ),
                 compactedSizeOffset + 8
                 ) );
 
     OptixAccelEmitDesc emitProperty = {};
     emitProperty.type               = OPTIX_PROPERTY_TYPE_COMPACTED_SIZE;
-    emitProperty.result             = ( CUdeviceptr )( (char*)d_buffer_temp_output_gas_and_compacted_size + compactedSizeOffset );
+    emitProperty.result             = ( CUdeviceptr )( (char*)d_buffer_temp_output_and_compacted_size + compactedSizeOffset );
 
     OPTIX_CHECK( optixAccelBuild(
-                state.context,
+                context,
                 0,                                  // CUDA stream
                 &accel_options,
-                &triangle_input,
+                &build_input,
                 1,                                  // num build inputs
                 d_temp_buffer,
-                gas_buffer_sizes.tempSizeInBytes,
-                d_buffer_temp_output_gas_and_compacted_size,
-                gas_buffer_sizes.outputSizeInBytes,
-                &state.gas_handle,
-                &emitProperty,                      // emitted property list
-                1                                   // num emitted properties
+                buffer_sizes.tempSizeInBytes,
+                d_buffer_temp_output_and_compacted_size,
+                buffer_sizes.outputSizeInBytes,
+                &handle,
+                allow_compaction ? &emitProperty : nullptr,  // emitted property list
+                allow_compaction ? 1 : 0                      // num emitted properties
                 ) );
 
     CUDA_CHECK( cudaFree( reinterpret_cast<void*>( d_temp_buffer ) ) );
-    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( d_mat_indices ) ) );
 
-    size_t compacted_gas_size;
-    CUDA_CHECK( cudaMemcpy( &compacted_gas_size, (void*)emitProperty.result, sizeof(size_t), cudaMemcpyDeviceToHost ) );
+    size_t compacted_size = buffer_sizes.outputSizeInBytes;
+    if( allow_compaction )
+        CUDA_CHECK( cudaMemcpy( &compacted_size, (void*)emitProperty.result, sizeof(size_t), cudaMemcpyDeviceToHost ) );
 
-    if( compacted_gas_size < gas_buffer_sizes.outputSizeInBytes )
+    if( compacted_size < buffer_sizes.outputSizeInBytes )
     {
-        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &state.d_gas_output_buffer ), compacted_gas_size ) );
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_output_buffer ), compacted_size ) );
 
         // use handle as input and output
-        OPTIX_CHECK( optixAccelCompact( state.context, 0, state.gas_handle, state.d_gas_output_buffer, compacted_gas_size, &state.gas_handle ) );
+        OPTIX_CHECK( optixAccelCompact( context, 0, handle, d_output_buffer, compacted_size, &handle ) );
 
-        CUDA_CHECK( cudaFree( (void*)d_buffer_temp_output_gas_and_compacted_size ) );
-    }
-    else
-    {
-        state.d_gas_output_buffer = d_buffer_temp_output_gas_and_compacted_size;
+        CUDA_CHECK( cudaFree( (void*)d_buffer_temp_output_and_compacted_size ) );
+        return compacted_size;
     }
+    d_output_buffer = d_buffer_temp_output_and_compacted_size;
+    return compactedSizeOffset + 8;
 }
 
 
-void createModule( PathTracerState& state )
+template <typename T>
+static CUdeviceptr uploadBuffer( const T* data, size_t size_in_bytes )
 {
-    OptixModuleCompileOptions module_compile_options = {};
-    module_compile_options.maxRegisterCount  = OPTIX_COMPILE_DEFAULT_MAX_REGISTER_COUNT;
-    module_compile_options.optLevel          = OPTIX_COMPILE_OPTIMIZATION_DEFAULT;
-    module_compile_options.debugLevel        = OPTIX_COMPILE_DEBUG_LEVEL_LINEINFO;
+    CUdeviceptr d_buffer = 0;
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_buffer ), size_in_bytes ) );
+    CUDA_CHECK( cudaMemcpy(
+                reinterpret_cast<void*>( d_buffer ),
+                data, size_in_bytes,
+                cudaMemcpyHostToDevice
+                ) );
+    return d_buffer;
+}
 
-    state.pipeline_compile_options.usesMotionBlur        = false;
-    state.pipeline_compile_options.traversableGraphFlags = OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_SINGLE_GAS;
-    state.pipeline_compile_options.numPayloadValues      = 2;
-    state.pipeline_compile_options.numAttributeValues    = 2;
-#ifdef DEBUG // Enables debug exceptions during optix launches. This may incur significant performance cost and should only be done during development.
-    state.pipeline_compile_options.exceptionFlags = OPTIX_EXCEPTION_FLAG_DEBUG | OPTIX_EXCEPTION_FLAG_TRACE_DEPTH | OPTIX_EXCEPTION_FLAG_STACK_OVERFLOW;
-#else
-    state.pipeline_compile_options.exceptionFlags = OPTIX_EXCEPTION_FLAG_NONE;
-#endif
-    state.pipeline_compile_options.pipelineLaunchParamsVariableName = "params";
 
-    const std::string ptx = sutil::getPtxString( OPTIX_SAMPLE_NAME, OPTIX_SAMPLE_DIR, "optixPathTracer.cu" );
+//
+// Build a static acceleration structure with compaction. With an accel_cache the structure is uploaded
+// and relocated from the cache if it holds a compatible one for the same geometry; a structure that had
+// to be built is copied back to the host and added to the cache.
+//
+static size_t buildCachedAccel( OptixDeviceContext         context,
+                                const OptixBuildInput&     build_input,
+                                uint64_t                   geometry_hash,
+                                AccelCache*                accel_cache,
+                                CUdeviceptr&               d_output_buffer,
+                                OptixTraversableHandle&    handle )
+{
+    if( !accel_cache )
+        return buildAccel( context, build_input, true, d_output_buffer, handle );
+
+    const AccelCacheKey key        = { geometry_hash, OPTIX_BUILD_FLAG_ALLOW_COMPACTION, OPTIX_VERSION };
+    const auto          compatible = [context]( const OptixAccelRelocationInfo& info ) {
+        int compatible = 0;
+        OPTIX_CHECK( optixAccelCheckRelocationCompatibility( context, &info, &compatible ) );
+        return compatible != 0;
+    };
 
-    char   log[2048];
-    size_t sizeof_log = sizeof( log );
-    OPTIX_CHECK_LOG( optixModuleCreateFromPTX(
-                state.context,
-                &module_compile_options,
-                &state.pipeline_compile_options,
-                ptx.c_str(),
-                ptx.size(),
-                log,
-                &sizeof_log,
-                &state.ptx_module
-                ) );
+    const char*              data;
+    size_t                   bytes;
+    OptixAccelRelocationInfo info;
+    std::string              reason;
+    if( accel_cache->find( key, compatible, data, bytes, info, reason ) )
+    {
+        d_output_buffer = uploadBuffer( data, bytes );
+        OPTIX_CHECK( optixAccelRelocate( context, 0, &info, 0, 0, d_output_buffer, bytes, &handle ) );
+        return bytes;
+    }
+
+    bytes = buildAccel( context, build_input, true, d_output_buffer, handle );
+    std::vector<char> host_copy( bytes );
+    CUDA_CHECK( cudaMemcpy( host_copy.data(), reinterpret_cast<void*>( d_output_buffer ), bytes, cudaMemcpyDeviceToHost ) );
+    OPTIX_CHECK( optixAccelGetRelocationInfo( context, handle, &info ) );
+    accel_cache->add( key, info, host_copy.data(), bytes );
+    return bytes;
 }
 
 
-void createProgramGroups( PathTracerState& state )
+//
+// Build or refit an acceleration structure with ALLOW_UPDATE. The output and temp buffers are allocated by
+// the first build and reused afterwards; the temp buffer covers both operations.
+//
+static void buildUpdatableAccel( OptixDeviceContext         context,
+                                 const OptixBuildInput&     build_input,
+                                 OptixBuildOperation        operation,
+                                 CUdeviceptr&               d_output_buffer,
+                                 size_t&                    output_bytes,
+                                 CUdeviceptr&               d_temp_buffer,
+                                 size_t&                    temp_bytes,
+                                 OptixTraversableHandle&    handle )
 {
-    OptixProgramGroupOptions  program_group_options = {};
-
-    char   log[2048];
-    size_t sizeof_log = sizeof( log );
+    OptixAccelBuildOptions accel_options = {};
+    accel_options.buildFlags             = OPTIX_BUILD_FLAG_ALLOW_UPDATE;
+    accel_options.operation              = operation;
 
+    if( !d_output_buffer )
     {
-        OptixProgramGroupDesc raygen_prog_group_desc    = {};
-        raygen_prog_group_desc.kind                     = OPTIX_PROGRAM_GROUP_KIND_RAYGEN;
-        raygen_prog_group_desc.raygen.module            = state.ptx_module;
-        raygen_prog_group_desc.raygen.entryFunctionName = "__raygen__rg";
+        OptixAccelBufferSizes buffer_sizes;
+        OPTIX_CHECK( optixAccelComputeMemoryUsage( context, &accel_options, &build_input, 1, &buffer_sizes ) );
+        output_bytes = buffer_sizes.outputSizeInBytes;
+        temp_bytes   = std::max( buffer_sizes.tempSizeInBytes, buffer_sizes.tempUpdateSizeInBytes );
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_output_buffer ), output_bytes ) );
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_temp_buffer ), temp_bytes ) );
+    }
 
-        OPTIX_CHECK_LOG( optixProgramGroupCreate(
+    OPTIX_CHECK( optixAccelBuild(
+                context,
+                0,                                  // CUDA stream
+                &accel_options,
+                &build_input,
+                1,                                  // num build inputs
+                d_temp_buffer,
+                temp_bytes,
+                d_output_buffer,
+                output_bytes,
+                &handle,
+                nullptr,                            // emitted property list
+                0                                   // num emitted properties
+                ) );
+}
+
+
+// True if all count material ids equal, which is then stored in material_id and no per-primitive ids are uploaded
+static bool uniformMaterial( const uint32_t* material_indices, size_t count, uint32_t& material_id )
+{
+    material_id = count ? material_indices[0] : 0;
+    for( size_t i = 1; i < count; ++i )
+        if( material_indices[i] != material_id )
+            return false;
+    return true;
+}
+
+
+//
+// Weld and pack the object space triangle soup of one mesh, copy it to device and build its GAS
+//
+static void buildPackedGAS( PathTracerState&             state,
+                            const PackedGeometry&        mesh,
+                            const uint32_t*              material_indices,
+                            bool                         dynamic,
+                            MeshAccel&                   accel,
+                            AccelCache*                  accel_cache = nullptr )
+{
+    // The copies are queued on the staging stream; the build on the default stream waits for them
+    accel.d_vertices      = state.staging.upload( mesh.positions.data(), mesh.positionBytes() );
+    accel.d_indices       = state.staging.upload( mesh.indices.data(), mesh.indexBytes() );
+    accel.d_normals       = state.staging.upload( mesh.normals.data(), mesh.normalBytes() );
+    accel.d_pre_transform = state.staging.upload( mesh.pre_transform, sizeof( mesh.pre_transform ) );
+    accel.geometry_bytes  = mesh.totalBytes();
+
+    if( !uniformMaterial( material_indices, mesh.indices.size(), accel.material_id ) )
+        accel.d_material_ids = state.staging.upload( material_indices, mesh.indices.size() * sizeof( uint32_t ) );
+
+    // One SBT record for the whole mesh, the hit programs look the material up by primitive
+    std::vector<uint32_t> triangle_input_flags( 1, OPTIX_GEOMETRY_FLAG_DISABLE_ANYHIT );
+
+    OptixBuildInput triangle_input                           = {};
+    triangle_input.type                                      = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
+    triangle_input.triangleArray.vertexFormat                = mesh.format == POSITION_SNORM16 ? OPTIX_VERTEX_FORMAT_SNORM16_3 : OPTIX_VERTEX_FORMAT_FLOAT3;
+    triangle_input.triangleArray.vertexStrideInBytes         = mesh.vertex_stride;
+    triangle_input.triangleArray.numVertices                 = mesh.num_vertices;
+    triangle_input.triangleArray.vertexBuffers               = &accel.d_vertices;
+    triangle_input.triangleArray.indexFormat                 = OPTIX_INDICES_FORMAT_UNSIGNED_INT3;
+    triangle_input.triangleArray.indexStrideInBytes          = sizeof( uint3 );
+    triangle_input.triangleArray.numIndexTriplets            = static_cast<uint32_t>( mesh.indices.size() );
+    triangle_input.triangleArray.indexBuffer                 = accel.d_indices;
+    if( mesh.format == POSITION_SNORM16 )
+    {
+        triangle_input.triangleArray.preTransform            = accel.d_pre_transform;
+        triangle_input.triangleArray.transformFormat         = OPTIX_TRANSFORM_FORMAT_MATRIX_FLOAT12;
+    }
+    triangle_input.triangleArray.flags                       = triangle_input_flags.data();
+    triangle_input.triangleArray.numSbtRecords               = 1;
+
+    if( !dynamic )
+    {
+        // The accel cache key covers everything the build reads from the device pointers above
+        uint64_t geometry_hash = 0;
+        if( accel_cache )
+        {
+            const uint32_t layout[4] = { OPTIX_BUILD_INPUT_TYPE_TRIANGLES, mesh.format, mesh.vertex_stride, mesh.num_vertices };
+            geometry_hash = hashBytes( layout, sizeof( layout ) );
+            geometry_hash = hashBytes( mesh.positions.data(), mesh.positionBytes(), geometry_hash );
+            geometry_hash = hashBytes( mesh.indices.data(), mesh.indexBytes(), geometry_hash );
+            geometry_hash = hashBytes( mesh.pre_transform, sizeof( mesh.pre_transform ), geometry_hash );
+            geometry_hash = hashBytes( triangle_input_flags.data(), triangle_input_flags.size() * sizeof( uint32_t ), geometry_hash );
+        }
+        accel.gas_bytes = buildCachedAccel( state.context, triangle_input, geometry_hash, accel_cache, accel.d_gas_output_buffer, accel.gas_handle );
+        return;
+    }
+
+    // Keep the build input (and everything it points to) for refits
+    const float3* positions = reinterpret_cast<const float3*>( mesh.positions.data() );
+    accel.dynamic        = true;
+    accel.input_flags    = triangle_input_flags;
+    accel.indices        = mesh.indices;
+    accel.rest_positions.assign( positions, positions + mesh.num_vertices );
+    accel.build_input    = triangle_input;
+    accel.build_input.triangleArray.vertexBuffers = &accel.d_vertices;
+    accel.build_input.triangleArray.flags         = accel.input_flags.data();
+    accel.refit.setThreshold( refit_threshold );
+    accel.refit.rebuilt( accel.rest_positions, accel.indices );
+
+    buildUpdatableAccel( state.context, accel.build_input, OPTIX_BUILD_OPERATION_BUILD, accel.d_gas_output_buffer,
+                         accel.gas_bytes, accel.d_temp_buffer, accel.temp_bytes, accel.gas_handle );
+}
+
+
+//
+// Build the GAS of an analytic mesh from one AABB per sphere or parallelogram. The primitives are kept
+// on the device for the intersection programs.
+//
+static void buildCustomGAS( PathTracerState& state, const SceneMesh& scene_mesh, MeshAccel& accel, AccelCache* accel_cache )
+{
+    std::vector<OptixAabb> aabbs;
+    float3 lo, hi;
+    if( scene_mesh.type == GEOMETRY_SPHERES )
+    {
+        for( const Sphere& sphere : scene_mesh.spheres )
+        {
+            sphereBounds( sphere, lo, hi );
+            aabbs.push_back( { lo.x, lo.y, lo.z, hi.x, hi.y, hi.z } );
+        }
+        accel.d_primitives   = uploadBuffer( scene_mesh.spheres.data(), scene_mesh.spheres.size() * sizeof( Sphere ) );
+        accel.geometry_bytes = scene_mesh.spheres.size() * sizeof( Sphere );
+    }
+    else
+    {
+        std::vector<Parallelogram> parallelograms;
+        for( size_t i = 0; i + 2 < scene_mesh.parallelograms.size(); i += 3 )
+        {
+            const float3* p = &scene_mesh.parallelograms[i];
+            parallelogramBounds( p[0], p[1], p[2], lo, hi );
+            aabbs.push_back( { lo.x, lo.y, lo.z, hi.x, hi.y, hi.z } );
+            parallelograms.push_back( makeParallelogram( p[0], p[1], p[2] ) );
+        }
+        accel.d_primitives   = uploadBuffer( parallelograms.data(), parallelograms.size() * sizeof( Parallelogram ) );
+        accel.geometry_bytes = parallelograms.size() * sizeof( Parallelogram );
+    }
+    accel.type = scene_mesh.type;
+
+    if( !uniformMaterial( scene_mesh.material_indices.data(), scene_mesh.material_indices.size(), accel.material_id ) )
+        accel.d_material_ids = uploadBuffer( scene_mesh.material_indices.data(), scene_mesh.material_indices.size() * sizeof( uint32_t ) );
+
+    const CUdeviceptr d_aabbs = uploadBuffer( aabbs.data(), aabbs.size() * sizeof( OptixAabb ) );
+    std::vector<uint32_t> aabb_input_flags( 1, OPTIX_GEOMETRY_FLAG_DISABLE_ANYHIT );
+
+    OptixBuildInput aabb_input                            = {};
+    aabb_input.type                                       = OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES;
+    aabb_input.customPrimitiveArray.aabbBuffers           = &d_aabbs;
+    aabb_input.customPrimitiveArray.numPrimitives         = static_cast<uint32_t>( aabbs.size() );
+    aabb_input.customPrimitiveArray.strideInBytes         = sizeof( OptixAabb );
+    aabb_input.customPrimitiveArray.flags                 = aabb_input_flags.data();
+    aabb_input.customPrimitiveArray.numSbtRecords         = 1;
+
+    uint64_t geometry_hash = 0;
+    if( accel_cache )
+    {
+        const uint32_t layout[2] = { OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES, static_cast<uint32_t>( aabbs.size() ) };
+        geometry_hash = hashBytes( layout, sizeof( layout ) );
+        geometry_hash = hashBytes( aabbs.data(), aabbs.size() * sizeof( OptixAabb ), geometry_hash );
+        geometry_hash = hashBytes( aabb_input_flags.data(), aabb_input_flags.size() * sizeof( uint32_t ), geometry_hash );
+    }
+    accel.gas_bytes = buildCachedAccel( state.context, aabb_input, geometry_hash, accel_cache, accel.d_gas_output_buffer, accel.gas_handle );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( d_aabbs ) ) );
+
+    std::cout << scene_mesh.name << ": " << aabbs.size() << ( accel.type == GEOMETRY_SPHERES ? " analytic spheres, " : " analytic parallelograms, " )
+              << accel.geometry_bytes << " bytes" << std::endl;
+}
+
+
+// The host arrays are released with the scene storage once the GAS are built
+static void releaseHostGeometry( SceneMesh& scene_mesh )
+{
+    scene_mesh.vertices         = ArenaArray<float3>();
+    scene_mesh.indices          = ArenaArray<uint3>();
+    scene_mesh.spheres          = ArenaArray<Sphere>();
+    scene_mesh.parallelograms   = ArenaArray<float3>();
+    scene_mesh.material_indices = ArenaArray<uint32_t>();
+    scene_mesh.texcoords        = ArenaArray<float2>();
+}
+
+
+// Upload the texture coordinates of a triangle mesh with the texture to object space scale of each triangle
+static void uploadTriangleTexcoords( const SceneMesh& scene_mesh, MeshAccel& accel )
+{
+    const size_t num_triangles = scene_mesh.texcoords.size() / 3;
+    std::vector<TriangleTexcoords> texcoords( num_triangles );
+    for( size_t i = 0; i < num_triangles; ++i )
+    {
+        float3 p[3];
+        for( int k = 0; k < 3; ++k )
+        {
+            const uint32_t v = scene_mesh.indices.empty() ? static_cast<uint32_t>( 3 * i + k ) : ( &scene_mesh.indices[i].x )[k];
+            p[k]                 = scene_mesh.vertices[v];
+            texcoords[i].uv[k]   = scene_mesh.texcoords[3 * i + k];
+        }
+        const float2 duv1     = texcoords[i].uv[1] - texcoords[i].uv[0];
+        const float2 duv2     = texcoords[i].uv[2] - texcoords[i].uv[0];
+        const float  uv_area  = fabsf( duv1.x * duv2.y - duv1.y * duv2.x );
+        const float  obj_area = length( cross( p[1] - p[0], p[2] - p[0] ) );
+        texcoords[i].uv_scale = obj_area > 0.0f ? sqrtf( uv_area / obj_area ) : 0.0f;
+    }
+    accel.d_texcoords     = uploadBuffer( texcoords.data(), texcoords.size() * sizeof( TriangleTexcoords ) );
+    accel.geometry_bytes += texcoords.size() * sizeof( TriangleTexcoords );
+}
+
+
+// Weld and pack the triangles of a mesh for buildMeshGAS; touches no device or shared state
+static PackedGeometry packSceneMesh( const SceneMesh& scene_mesh )
+{
+    // Dynamic positions are rewritten at runtime and may leave the load time bounds, keep them as floats
+    const PositionFormat format = scene_mesh.dynamic ? POSITION_FLOAT3 : position_format;
+    return packGeometry( scene_mesh.indices.empty()
+                             ? weldTriangleSoup( scene_mesh.vertices.data(), scene_mesh.vertices.size() )
+                             : makeIndexedMesh( scene_mesh.vertices.data(), scene_mesh.vertices.size(),
+                                                scene_mesh.indices.data(), scene_mesh.indices.size() ),
+                         format );
+}
+
+
+// packed is the packSceneMesh() result for triangle meshes and ignored otherwise
+static void buildMeshGAS( PathTracerState& state, SceneMesh& scene_mesh, const PackedGeometry& packed, MeshAccel& accel, AccelCache* accel_cache )
+{
+    if( scene_mesh.type != GEOMETRY_TRIANGLES )
+    {
+        buildCustomGAS( state, scene_mesh, accel, accel_cache );
+    }
+    else
+    {
+        std::cout << scene_mesh.name << ": ";
+        printGeometryReport( std::cout, packed );
+
+        buildPackedGAS( state, packed, scene_mesh.material_indices.data(), scene_mesh.dynamic, accel, accel_cache );
+        if( !scene_mesh.texcoords.empty() )
+            uploadTriangleTexcoords( scene_mesh, accel );
+    }
+
+    releaseHostGeometry( scene_mesh );
+}
+
+
+// Move a MeshAccel to another slot; the build input of a dynamic mesh points into the struct itself
+static void moveMeshAccel( MeshAccel& from, MeshAccel& to )
+{
+    to = std::move( from );
+    if( to.dynamic )
+    {
+        to.build_input.triangleArray.vertexBuffers = &to.d_vertices;
+        to.build_input.triangleArray.flags         = to.input_flags.data();
+    }
+    from = MeshAccel();
+}
+
+
+static void freeMeshAccel( MeshAccel& mesh )
+{
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( mesh.d_vertices ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( mesh.d_indices ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( mesh.d_normals ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( mesh.d_pre_transform ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( mesh.d_primitives ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( mesh.d_gas_output_buffer ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( mesh.d_material_ids ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( mesh.d_texcoords ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( mesh.d_temp_buffer ) ) );
+    mesh = MeshAccel();
+}
+
+
+// (Re)upload the GeometryData table the hit programs index by instance id
+static void uploadGeometryTable( PathTracerState& state )
+{
+    std::vector<GeometryData> geometries( state.meshes.size() );
+    for( size_t i = 0; i < state.meshes.size(); ++i )
+    {
+        const MeshAccel& mesh         = state.meshes[i];
+        geometries[i].normals         = reinterpret_cast<const unsigned int*>( mesh.d_normals );
+        geometries[i].spheres         = mesh.type == GEOMETRY_SPHERES ? reinterpret_cast<const Sphere*>( mesh.d_primitives ) : nullptr;
+        geometries[i].parallelograms  = mesh.type == GEOMETRY_PARALLELOGRAMS ? reinterpret_cast<const Parallelogram*>( mesh.d_primitives ) : nullptr;
+        geometries[i].material_ids    = reinterpret_cast<const unsigned int*>( mesh.d_material_ids );
+        geometries[i].texcoords       = reinterpret_cast<const TriangleTexcoords*>( mesh.d_texcoords );
+        geometries[i].material_id     = mesh.material_id;
+    }
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_geometries ) ) );
+    state.d_geometries      = uploadBuffer( geometries.data(), geometries.size() * sizeof( GeometryData ) );
+    state.params.geometries = reinterpret_cast<const GeometryData*>( state.d_geometries );
+}
+
+
+// Build or refit the IAS over d_instances as they are on the device
+static void buildInstanceAccelFromDevice( PathTracerState& state, OptixBuildOperation operation )
+{
+    OptixBuildInput instance_input            = {};
+    instance_input.type                       = OPTIX_BUILD_INPUT_TYPE_INSTANCES;
+    instance_input.instanceArray.instances    = state.d_instances;
+    instance_input.instanceArray.numInstances = static_cast<uint32_t>( state.instances.size() );
+
+    // With dynamic meshes the IAS is refit together with their GAS
+    if( state.ias_updatable )
+        buildUpdatableAccel( state.context, instance_input, operation, state.d_ias_output_buffer,
+                             state.ias_output_bytes, state.d_ias_temp_buffer, state.ias_temp_bytes, state.ias_handle );
+    else
+        buildAccel( state.context, instance_input, false, state.d_ias_output_buffer, state.ias_handle );
+}
+
+
+static void buildInstanceAccel( PathTracerState& state, OptixBuildOperation operation = OPTIX_BUILD_OPERATION_BUILD )
+{
+    std::vector<OptixInstance>& instances = state.instances;
+    instances.resize( scene.instances.size() );
+    for( size_t i = 0; i < scene.instances.size(); ++i )
+    {
+        const Instance& instance = scene.instances[i];
+        OptixInstance&  optix_instance = instances[i];
+        memcpy( optix_instance.transform, instance.transform, sizeof( instance.transform ) );
+        optix_instance.instanceId        = instance.mesh_id;
+        optix_instance.sbtOffset         = state.meshes[instance.mesh_id].type * RAY_TYPE_COUNT;
+        optix_instance.visibilityMask    = 1;
+        optix_instance.flags             = OPTIX_INSTANCE_FLAG_NONE;
+        optix_instance.traversableHandle = state.meshes[instance.mesh_id].gas_handle;
+    }
+    const size_t instances_size_in_bytes = instances.size() * sizeof( OptixInstance );
+    if( !state.d_instances )
+        state.d_instances = uploadBuffer( instances.data(), instances_size_in_bytes );
+    else
+        CUDA_CHECK( cudaMemcpy( reinterpret_cast<void*>( state.d_instances ), instances.data(), instances_size_in_bytes, cudaMemcpyHostToDevice ) );
+    buildInstanceAccelFromDevice( state, operation );
+}
+
+
+//
+// Replace the positions of a dynamic mesh and refit its GAS, or rebuild it once the refit degraded past
+// the threshold. positions holds one entry per welded vertex, in the order of MeshAccel::rest_positions.
+// The face normals are recomputed. Call updateInstanceAccel() once all meshes of a frame are updated.
+//
+void updateMeshVertices( PathTracerState& state, uint32_t mesh_id, const std::vector<float3>& positions )
+{
+    MeshAccel& accel = state.meshes[mesh_id];
+    if( !accel.dynamic || positions.size() != accel.rest_positions.size() )
+        throw std::runtime_error( "updateMeshVertices: mesh " + std::to_string( mesh_id ) + " is not dynamic or the vertex count differs" );
+
+    const std::vector<unsigned int> normals = encodeFaceNormals( positions, accel.indices );
+    CUDA_CHECK( cudaMemcpy( reinterpret_cast<void*>( accel.d_vertices ), positions.data(),
+                            positions.size() * sizeof( float3 ), cudaMemcpyHostToDevice ) );
+    CUDA_CHECK( cudaMemcpy( reinterpret_cast<void*>( accel.d_normals ), normals.data(),
+                            normals.size() * sizeof( unsigned int ), cudaMemcpyHostToDevice ) );
+
+    OptixBuildOperation operation = OPTIX_BUILD_OPERATION_UPDATE;
+    if( accel.refit.needsRebuild( positions ) )
+    {
+        operation = OPTIX_BUILD_OPERATION_BUILD;
+        accel.refit.rebuilt( positions, accel.indices );
+        state.ias_needs_rebuild = true;
+    }
+    else
+    {
+        accel.refit.refitted();
+    }
+    buildUpdatableAccel( state.context, accel.build_input, operation, accel.d_gas_output_buffer,
+                         accel.gas_bytes, accel.d_temp_buffer, accel.temp_bytes, accel.gas_handle );
+    geometry_changed = true;
+}
+
+
+void updateInstanceAccel( PathTracerState& state )
+{
+    // A GAS rebuild may hand out a different traversable handle, only a full IAS build picks that up
+    buildInstanceAccel( state, state.ias_needs_rebuild ? OPTIX_BUILD_OPERATION_BUILD : OPTIX_BUILD_OPERATION_UPDATE );
+    state.ias_needs_rebuild = false;
+}
+
+
+// Build the IAS from scratch into new buffers, once the instance count changed or GAS handles were replaced
+static void rebuildInstanceAccel( PathTracerState& state )
+{
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_instances ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_ias_output_buffer ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_ias_temp_buffer ) ) );
+    state.d_instances = state.d_ias_output_buffer = state.d_ias_temp_buffer = 0;
+    buildInstanceAccel( state );
+    state.params.handle = state.ias_handle;
+}
+
+
+//
+// Copy the transforms of the given scene instances (ascending indices) into the IAS instances, upload only
+// those records and refit the IAS. Records that lie close together go up in one copy, and a change that is
+// scattered over the whole array uploads it at once - a copy costs about as much as a few KB of data.
+//
+static void updateInstanceTransforms( PathTracerState& state, const std::vector<uint32_t>& touched )
+{
+    const uint32_t MAX_GAP = 64;  // records a copy may include needlessly rather than start another copy
+    std::vector<std::pair<uint32_t, uint32_t> > runs;  // [first, last]
+    for( uint32_t instance : touched )
+    {
+        memcpy( state.instances[instance].transform, scene.instances[instance].transform, sizeof( Instance::transform ) );
+        if( !runs.empty() && instance - runs.back().second <= MAX_GAP )
+            runs.back().second = instance;
+        else
+            runs.push_back( std::make_pair( instance, instance ) );
+    }
+    if( runs.empty() )
+        return;
+    if( runs.size() * MAX_GAP > runs.back().second - runs.front().first )
+        runs.assign( 1, std::make_pair( runs.front().first, runs.back().second ) );
+    for( const auto& run : runs )
+        CUDA_CHECK( cudaMemcpy( reinterpret_cast<void*>( state.d_instances + run.first * sizeof( OptixInstance ) ), &state.instances[run.first],
+                                ( run.second - run.first + 1 ) * sizeof( OptixInstance ), cudaMemcpyHostToDevice ) );
+
+    buildInstanceAccelFromDevice( state, state.ias_needs_rebuild ? OPTIX_BUILD_OPERATION_BUILD : OPTIX_BUILD_OPERATION_UPDATE );
+    state.ias_needs_rebuild = false;
+    state.params.handle     = state.ias_handle;
+}
+
+
+//
+// Build the GAS of the given scene meshes into accels[mesh id]. Triangle meshes are welded and packed on
+// worker threads. Each is uploaded and built here as soon as it is packed, so the uploads and GAS builds
+// overlap with packing the meshes after it.
+//
+static void buildSceneMeshes( PathTracerState& state, const std::vector<uint32_t>& mesh_ids, std::deque<MeshAccel>& accels, AccelCache* accel_cache )
+{
+    std::vector<PackedGeometry> packed( scene.meshes.size() );
+    TaskGraph                   graph;
+    for( uint32_t i : mesh_ids )
+    {
+        std::vector<TaskGraph::TaskId> dependencies;
+        if( scene.meshes[i].type == GEOMETRY_TRIANGLES )
+            dependencies.push_back( graph.add( "pack " + scene.meshes[i].name, [&, i] { packed[i] = packSceneMesh( scene.meshes[i] ); } ) );
+        graph.add( "build " + scene.meshes[i].name,
+                   [&, i] {
+                       buildMeshGAS( state, scene.meshes[i], packed[i], accels[i], accel_cache );
+                       packed[i] = PackedGeometry();
+                   },
+                   dependencies, TaskGraph::MAIN_THREAD );
+    }
+    graph.run();
+}
+
+
+// With an accel_cache_file the static GAS are relocated from it where possible and it is updated afterwards
+void buildMeshAccel( PathTracerState& state, const std::string& accel_cache_file )
+{
+    const auto t0 = std::chrono::steady_clock::now();
+
+    // Take the host geometry over from the scene, it is released in one go once it is on the device
+    const SceneStorage geometry = scene.takeGeometry();
+
+    AccelCache  accel_cache;
+    std::string accel_cache_reason;
+    const bool  accel_cache_valid = !accel_cache_file.empty() && accel_cache.open( accel_cache_file, accel_cache_reason );
+
+    state.meshes.resize( scene.meshes.size() );
+    std::vector<uint32_t> mesh_ids( scene.meshes.size() );
+    for( uint32_t i = 0; i < mesh_ids.size(); ++i )
+        mesh_ids[i] = i;
+    buildSceneMeshes( state, mesh_ids, state.meshes, accel_cache_file.empty() ? nullptr : &accel_cache );
+
+    size_t geometry_bytes = 0, gas_bytes = 0;
+    for( const MeshAccel& mesh : state.meshes )
+    {
+        geometry_bytes += mesh.geometry_bytes;
+        gas_bytes      += mesh.gas_bytes;
+    }
+    uploadGeometryTable( state );
+
+    for( const MeshAccel& mesh : state.meshes )
+        state.ias_updatable |= mesh.dynamic;
+    buildInstanceAccel( state );
+    CUDA_SYNC_CHECK();
+    const std::chrono::duration<double, std::milli> build_time = std::chrono::steady_clock::now() - t0;
+
+    // What the same scene costs when every instance is baked into one flat GAS
+    size_t flattened_triangles = 0, flattened_geometry_bytes = 0, unique_triangles = 0;
+    for( const SceneMesh& mesh : scene.meshes )
+        unique_triangles += mesh.num_primitives;
+    for( const Instance& instance : scene.instances )
+    {
+        flattened_triangles      += scene.meshes[instance.mesh_id].num_primitives;
+        flattened_geometry_bytes += state.meshes[instance.mesh_id].geometry_bytes;
+    }
+
+    const double kb = 1.0 / 1024.0;
+    std::cout << std::fixed << std::setprecision( 1 )
+              << "Acceleration: " << scene.instances.size() << " instances of " << scene.meshes.size() << " meshes, "
+              << unique_triangles << " unique primitives (" << flattened_triangles << " instanced)\n"
+              << "  geometry " << geometry_bytes * kb << " KB (flattened: " << flattened_geometry_bytes * kb << " KB)\n"
+              << "  GAS      " << gas_bytes * kb << " KB, IAS " << scene.instances.size() * sizeof( OptixInstance ) * kb << " KB of instances\n"
+              << "  build    " << build_time.count() << " ms" << std::endl;
+
+    if( accel_cache_file.empty() )
+        return;
+    std::cout << "  cache    " << accel_cache.hits() << " GAS relocated from " << accel_cache_file << ", " << accel_cache.misses() << " built";
+    if( accel_cache.misses() > 0 )
+        std::cout << " (" << ( accel_cache_valid ? accel_cache.firstMiss() : accel_cache_reason ) << ")";
+    std::cout << std::endl;
+    std::string err;
+    if( accel_cache.changed() && !accel_cache.write( accel_cache_file, err ) )
+        std::cerr << "Could not write the acceleration structure cache: " << err << std::endl;
+}
+
+
+// Rest positions of a dynamic mesh displaced by a travelling wave along y
+static void wavePositions( const MeshAccel& mesh, float time, std::vector<float3>& positions )
+{
+    sutil::Aabb bounds;
+    for( const float3& p : mesh.rest_positions )
+        bounds.include( p );
+    const float amplitude  = 0.02f * length( bounds.extent() );
+    const float wavenumber = 6.2831853f / fmaxf( bounds.maxExtent(), 1e-6f );
+
+    positions.resize( mesh.rest_positions.size() );
+    for( size_t i = 0; i < positions.size(); ++i )
+    {
+        const float3& p = mesh.rest_positions[i];
+        positions[i]    = p + make_float3( 0.f, amplitude * sinf( wavenumber * ( p.x + p.z ) - 3.f * time ), 0.f );
+    }
+}
+
+
+// --animate: deform every dynamic mesh through updateMeshVertices()
+void animateDynamicMeshes( PathTracerState& state, float time )
+{
+    if( !state.ias_updatable )
+        return;
+    std::vector<float3> positions;
+    for( size_t i = 0; i < state.meshes.size(); ++i )
+    {
+        if( !state.meshes[i].dynamic )
+            continue;
+        wavePositions( state.meshes[i], time, positions );
+        updateMeshVertices( state, static_cast<uint32_t>( i ), positions );
+    }
+    updateInstanceAccel( state );
+}
+
+
+// --benchmark-refit: time a refit against a full rebuild of every dynamic GAS, smallest mesh first
+void benchmarkRefit( PathTracerState& state )
+{
+    const int iterations = 20;
+
+    std::vector<size_t> order;
+    for( size_t i = 0; i < state.meshes.size(); ++i )
+        if( state.meshes[i].dynamic )
+            order.push_back( i );
+    std::sort( order.begin(), order.end(), []( size_t a, size_t b ) { return scene.meshes[a].num_primitives < scene.meshes[b].num_primitives; } );
+    if( order.empty() )
+    {
+        std::cout << "--benchmark-refit: the scene has no DYNAMIC geometry" << std::endl;
+        return;
+    }
+
+    std::cout << "Refit vs rebuild (" << iterations << " iterations, ms per operation):\n"
+              << std::setw( 12 ) << "triangles" << std::setw( 12 ) << "refit" << std::setw( 12 ) << "rebuild" << std::endl;
+    std::vector<float3> positions;
+    for( size_t i : order )
+    {
+        MeshAccel& mesh = state.meshes[i];
+        double     ms[2] = { 0.0, 0.0 };
+        const OptixBuildOperation operations[2] = { OPTIX_BUILD_OPERATION_UPDATE, OPTIX_BUILD_OPERATION_BUILD };
+        for( int op = 0; op < 2; ++op )
+        {
+            for( int it = 0; it < iterations; ++it )
+            {
+                wavePositions( mesh, 0.1f * it, positions );
+                CUDA_CHECK( cudaMemcpy( reinterpret_cast<void*>( mesh.d_vertices ), positions.data(),
+                                        positions.size() * sizeof( float3 ), cudaMemcpyHostToDevice ) );
+                CUDA_SYNC_CHECK();
+                const auto t0 = std::chrono::steady_clock::now();
+                buildUpdatableAccel( state.context, mesh.build_input, operations[op], mesh.d_gas_output_buffer,
+                                     mesh.gas_bytes, mesh.d_temp_buffer, mesh.temp_bytes, mesh.gas_handle );
+                CUDA_SYNC_CHECK();
+                ms[op] += std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - t0 ).count();
+            }
+        }
+        std::cout << std::fixed << std::setprecision( 3 ) << std::setw( 12 ) << scene.meshes[i].num_primitives
+                  << std::setw( 12 ) << ms[0] / iterations << std::setw( 12 ) << ms[1] / iterations << std::endl;
+
+        // Back to the rest pose, built from scratch
+        updateMeshVertices( state, static_cast<uint32_t>( i ), mesh.rest_positions );
+        buildUpdatableAccel( state.context, mesh.build_input, OPTIX_BUILD_OPERATION_BUILD, mesh.d_gas_output_buffer,
+                             mesh.gas_bytes, mesh.d_temp_buffer, mesh.temp_bytes, mesh.gas_handle );
+        mesh.refit.rebuilt( mesh.rest_positions, mesh.indices );
+    }
+    state.ias_needs_rebuild = true;
+    updateInstanceAccel( state );
+}
+
+
+// --benchmark-subframes: time static camera subframes without and with the primary hit cache, and with
+// the adaptive sampling moments at a threshold no pixel reaches so that every launch pays for them
+void benchmarkSubframes( PathTracerState& state, int num_subframes )
+{
+    struct Configuration
+    {
+        const char* name;
+        bool        cache_primary_hits;
+        bool        adaptive_sampling;
+    };
+    const Configuration configurations[] = { { "trace", false, false }, { "cached hits", true, false }, { "moments", false, true } };
+
+    Params&            params    = state.params;
+    const unsigned int cached    = params.cache_primary_hits;
+    const unsigned int adaptive  = params.adaptive_sampling;
+    const float        threshold = params.adaptive.error_threshold;
+
+    sutil::CUDAOutputBuffer<uchar4> output_buffer( sutil::CUDAOutputBufferType::CUDA_DEVICE, params.width, params.height );
+    output_buffer.setStream( state.stream );
+    handleCameraUpdate( params );
+
+    std::cout << "Static camera subframes (" << num_subframes << " per configuration, " << params.width << "x"
+              << params.height << ", " << params.samples_per_launch << " samples per launch):\n"
+              << std::setw( 14 ) << "" << std::setw( 12 ) << "ms" << std::setw( 12 ) << "relative" << std::endl;
+    double trace_ms = 0.0;
+    for( const Configuration& configuration : configurations )
+    {
+        freeFrameBuffers( params );
+        params.cache_primary_hits       = configuration.cache_primary_hits ? 1u : 0u;
+        params.adaptive_sampling        = configuration.adaptive_sampling ? 1u : 0u;
+        params.adaptive.error_threshold = 0.0f;
+        allocFrameBuffers( params );
+        params.subframe_index = 0;
+
+        // The first launch traces the primary hits the cache keeps, it is not timed
+        launchSubframe( output_buffer, state );
+        ++params.subframe_index;
+
+        const auto t0 = std::chrono::steady_clock::now();
+        for( int i = 0; i < num_subframes; ++i )
+        {
+            launchSubframe( output_buffer, state );
+            ++params.subframe_index;
+        }
+        const double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - t0 ).count() / num_subframes;
+        if( trace_ms == 0.0 )
+            trace_ms = ms;
+        std::cout << std::fixed << std::setprecision( 3 ) << std::setw( 14 ) << configuration.name << std::setw( 12 ) << ms
+                  << std::setw( 11 ) << ms / trace_ms << "x" << std::endl;
+    }
+
+    freeFrameBuffers( params );
+    params.cache_primary_hits       = cached;
+    params.adaptive_sampling        = adaptive;
+    params.adaptive.error_threshold = threshold;
+    allocFrameBuffers( params );
+    params.subframe_index = 0;
+}
+
+
+//
+// Turn the spatial mapping patches processed since the last frame into GAS and rebuild the IAS.
+// Every patch has its own mesh and identity instance; a new version replaces the GAS of its patch.
+//
+void applySpatialUpdates( PathTracerState& state )
+{
+    std::vector<SpatialPatchUpdate> updates;
+    state.spatial_ingest.poll( updates );
+    if( updates.empty() )
+        return;
+
+    size_t input_triangles = 0, triangles = 0;
+    for( SpatialPatchUpdate& update : updates )
+    {
+        auto patch = spatial_patches.find( update.id );
+        if( patch != spatial_patches.end() )
+            freeMeshAccel( state.meshes[patch->second] );
+
+        if( update.removal )
+        {
+            if( patch != spatial_patches.end() )
+            {
+                const uint32_t mesh_id = patch->second;
+                scene.instances.erase( std::remove_if( scene.instances.begin(), scene.instances.end(),
+                                                       [mesh_id]( const Instance& instance ) { return instance.mesh_id == mesh_id; } ),
+                                       scene.instances.end() );
+                scene.meshes[mesh_id].num_primitives = 0;
+                spatial_patches.erase( patch );
+            }
+            continue;
+        }
+
+        uint32_t mesh_id;
+        if( patch != spatial_patches.end() )
+        {
+            mesh_id = patch->second;
+        }
+        else
+        {
+            mesh_id = static_cast<uint32_t>( scene.meshes.size() );
+            scene.meshes.push_back( SceneMesh() );
+            scene.meshes.back().name = "#spatial#" + std::to_string( update.id );
+            state.meshes.emplace_back();
+
+            Instance instance = { { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f }, mesh_id };
+            scene.instances.push_back( instance );
+            spatial_patches[update.id] = mesh_id;
+        }
+
+        const std::vector<uint32_t> material_indices( update.geometry.indices.size(), static_cast<uint32_t>( spatial_material ) );
+        scene.meshes[mesh_id].num_primitives = material_indices.size();
+        buildPackedGAS( state, update.geometry, material_indices.data(), false, state.meshes[mesh_id] );
+        input_triangles += update.input_triangles;
+        triangles       += update.geometry.indices.size();
+    }
+
+    // The instance count changed or handles were replaced - build the IAS from scratch
+    uploadGeometryTable( state );
+    rebuildInstanceAccel( state );
+    CUDA_SYNC_CHECK();
+    geometry_changed = true;
+
+    // Latency from the arrival of a chunk to its GAS being part of the scene
+    const auto now = std::chrono::steady_clock::now();
+    double sum_ms = 0.0, max_ms = 0.0;
+    for( const SpatialPatchUpdate& update : updates )
+    {
+        const double ms = std::chrono::duration<double, std::milli>( now - update.received ).count();
+        sum_ms += ms;
+        max_ms  = std::max( max_ms, ms );
+        state.spatial_ingest.acknowledge( update.id, update.version );
+    }
+    std::cout << std::fixed << std::setprecision( 1 ) << "Spatial mapping: " << updates.size() << " patches ("
+              << input_triangles << " -> " << triangles << " triangles), " << spatial_patches.size()
+              << " live, latency mean " << sum_ms / updates.size() << " ms, max " << max_ms << " ms" << std::endl;
+}
+
+
+void createModule( PathTracerState& state )
+{
+    OptixModuleCompileOptions module_compile_options = {};
+    module_compile_options.maxRegisterCount  = OPTIX_COMPILE_DEFAULT_MAX_REGISTER_COUNT;
+    module_compile_options.optLevel          = OPTIX_COMPILE_OPTIMIZATION_DEFAULT;
+    module_compile_options.debugLevel        = OPTIX_COMPILE_DEBUG_LEVEL_LINEINFO;
+
+    state.pipeline_compile_options.usesMotionBlur        = false;
+    state.pipeline_compile_options.traversableGraphFlags = OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_SINGLE_LEVEL_INSTANCING;
+    state.pipeline_compile_options.numPayloadValues      = 2;
+    state.pipeline_compile_options.numAttributeValues    = 3;  // barycentrics, or the object space normal of a custom primitive
+#ifdef DEBUG // Enables debug exceptions during optix launches. This may incur significant performance cost and should only be done during development.
+    state.pipeline_compile_options.exceptionFlags = OPTIX_EXCEPTION_FLAG_DEBUG | OPTIX_EXCEPTION_FLAG_TRACE_DEPTH | OPTIX_EXCEPTION_FLAG_STACK_OVERFLOW;
+#else
+    state.pipeline_compile_options.exceptionFlags = OPTIX_EXCEPTION_FLAG_NONE;
+#endif
+    state.pipeline_compile_options.pipelineLaunchParamsVariableName = "params";
+
+    const auto        t0  = std::chrono::steady_clock::now();
+    const std::string ptx = sutil::getPtxString( OPTIX_SAMPLE_NAME, OPTIX_SAMPLE_DIR, "optixPathTracer.cu" );
+    const auto        t1  = std::chrono::steady_clock::now();
+
+    char   log[2048];
+    size_t sizeof_log = sizeof( log );
+    OPTIX_CHECK_LOG( optixModuleCreateFromPTX(
+                state.context,
+                &module_compile_options,
+                &state.pipeline_compile_options,
+                ptx.c_str(),
+                ptx.size(),
+                log,
+                &sizeof_log,
+                &state.ptx_module
+                ) );
+
+    // Cold and warm starts differ in whether NVRTC ran and whether OptiX found the module in its own disk cache
+    int optix_cache_enabled = 0;
+    OPTIX_CHECK( optixDeviceContextGetCacheEnabled( state.context, &optix_cache_enabled ) );
+    const sutil::PtxCacheStats                      ptx_stats   = sutil::getPtxCacheStats();
+    const std::chrono::duration<double, std::milli> ptx_time    = t1 - t0;
+    const std::chrono::duration<double, std::milli> module_time = std::chrono::steady_clock::now() - t1;
+    std::ostringstream report;  // one write, the module is created while other startup tasks print
+    report << std::fixed << std::setprecision( 1 ) << "Module: PTX " << ( ptx_stats.hits > 0 ? "from the PTX cache" : ptx_stats.misses > 0 ? "compiled by NVRTC" : "precompiled" )
+           << " in " << ptx_time.count() << " ms, optixModuleCreateFromPTX " << module_time.count() << " ms (OptiX cache "
+           << ( optix_cache_enabled ? "on" : "off" ) << ")\n";
+    std::cout << report.str() << std::flush;
+}
+
+
+void createProgramGroups( PathTracerState& state )
+{
+    OptixProgramGroupOptions  program_group_options = {};
+
+    char   log[2048];
+    size_t sizeof_log = sizeof( log );
+
+    {
+        OptixProgramGroupDesc raygen_prog_group_desc    = {};
+        raygen_prog_group_desc.kind                     = OPTIX_PROGRAM_GROUP_KIND_RAYGEN;
+        raygen_prog_group_desc.raygen.module            = state.ptx_module;
+        raygen_prog_group_desc.raygen.entryFunctionName = "__raygen__rg";
+
+        OPTIX_CHECK_LOG( optixProgramGroupCreate(
                     state.context, &raygen_prog_group_desc,
                     1,  // num program groups
                     &program_group_options,
@@ -1287,11 +2417,16 @@ void createProgramGroups( PathTracerState& state )
                     ) );
     }
 
+    // One radiance and one occlusion hit group per GeometryType, the custom primitives add their intersection program
+    const char* intersection_programs[GEOMETRY_TYPE_COUNT] = { nullptr, "__intersection__sphere", "__intersection__parallelogram" };
+    for( int type = 0; type < GEOMETRY_TYPE_COUNT; ++type )
     {
         OptixProgramGroupDesc hit_prog_group_desc        = {};
         hit_prog_group_desc.kind                         = OPTIX_PROGRAM_GROUP_KIND_HITGROUP;
         hit_prog_group_desc.hitgroup.moduleCH            = state.ptx_module;
         hit_prog_group_desc.hitgroup.entryFunctionNameCH = "__closesthit__radiance";
+        hit_prog_group_desc.hitgroup.moduleIS            = intersection_programs[type] ? state.ptx_module : nullptr;
+        hit_prog_group_desc.hitgroup.entryFunctionNameIS = intersection_programs[type];
         sizeof_log                                       = sizeof( log );
         OPTIX_CHECK_LOG( optixProgramGroupCreate(
                     state.context,
@@ -1300,12 +2435,9 @@ void createProgramGroups( PathTracerState& state )
                     &program_group_options,
                     log,
                     &sizeof_log,
-                    &state.radiance_hit_group
+                    &state.radiance_hit_groups[type]
                     ) );
 
-        memset( &hit_prog_group_desc, 0, sizeof( OptixProgramGroupDesc ) );
-        hit_prog_group_desc.kind                         = OPTIX_PROGRAM_GROUP_KIND_HITGROUP;
-        hit_prog_group_desc.hitgroup.moduleCH            = state.ptx_module;
         hit_prog_group_desc.hitgroup.entryFunctionNameCH = "__closesthit__occlusion";
         sizeof_log                                       = sizeof( log );
         OPTIX_CHECK( optixProgramGroupCreate(
@@ -1315,7 +2447,7 @@ void createProgramGroups( PathTracerState& state )
                     &program_group_options,
                     log,
                     &sizeof_log,
-                    &state.occlusion_hit_group
+                    &state.occlusion_hit_groups[type]
                     ) );
     }
 }
@@ -1323,14 +2455,17 @@ void createProgramGroups( PathTracerState& state )
 
 void createPipeline( PathTracerState& state )
 {
-    OptixProgramGroup program_groups[] =
+    std::vector<OptixProgramGroup> program_groups =
     {
         state.raygen_prog_group,
         state.radiance_miss_group,
-        state.occlusion_miss_group,
-        state.radiance_hit_group,
-        state.occlusion_hit_group
+        state.occlusion_miss_group
     };
+    for( int type = 0; type < GEOMETRY_TYPE_COUNT; ++type )
+    {
+        program_groups.push_back( state.radiance_hit_groups[type] );
+        program_groups.push_back( state.occlusion_hit_groups[type] );
+    }
 
     OptixPipelineLinkOptions pipeline_link_options = {};
     pipeline_link_options.maxTraceDepth            = 2;
@@ -1342,8 +2477,8 @@ void createPipeline( PathTracerState& state )
                 state.context,
                 &state.pipeline_compile_options,
                 &pipeline_link_options,
-                program_groups,
-                sizeof( program_groups ) / sizeof( program_groups[0] ),
+                program_groups.data(),
+                static_cast<unsigned int>( program_groups.size() ),
                 log,
                 &sizeof_log,
                 &state.pipeline
@@ -1352,11 +2487,8 @@ void createPipeline( PathTracerState& state )
     // We need to specify the max traversal depth.  Calculate the stack sizes, so we can specify all
     // parameters to optixPipelineSetStackSize.
     OptixStackSizes stack_sizes = {};
-    OPTIX_CHECK( optixUtilAccumulateStackSizes( state.raygen_prog_group,    &stack_sizes ) );
-    OPTIX_CHECK( optixUtilAccumulateStackSizes( state.radiance_miss_group,  &stack_sizes ) );
-    OPTIX_CHECK( optixUtilAccumulateStackSizes( state.occlusion_miss_group, &stack_sizes ) );
-    OPTIX_CHECK( optixUtilAccumulateStackSizes( state.radiance_hit_group,   &stack_sizes ) );
-    OPTIX_CHECK( optixUtilAccumulateStackSizes( state.occlusion_hit_group,  &stack_sizes ) );
+    for( OptixProgramGroup program_group : program_groups )
+        OPTIX_CHECK( optixUtilAccumulateStackSizes( program_group, &stack_sizes ) );
 
     uint32_t max_trace_depth = 2;
     uint32_t max_cc_depth = 0;
@@ -1374,7 +2506,7 @@ void createPipeline( PathTracerState& state )
                 &continuation_stack_size
                 ) );
 
-    const uint32_t max_traversal_depth = 1;
+    const uint32_t max_traversal_depth = 2;  // IAS -> GAS
     OPTIX_CHECK( optixPipelineSetStackSize(
                 state.pipeline,
                 direct_callable_stack_size_from_traversal,
@@ -1385,88 +2517,654 @@ void createPipeline( PathTracerState& state )
 }
 
 
-void createSBT( PathTracerState& state )
+// The material table entry of one material
+// Demand texture id of a scene texture; the texture manager is created with the first textured material
+static int demandTexture( PathTracerState& state, int32_t texture )
+{
+    if( texture < 0 )
+        return NO_TEXTURE;
+    if( !state.textures_initialized )
+    {
+        state.textures.init( texture_memory );
+        state.textures_initialized = true;
+    }
+    return state.textures.textureId( scene.textures[texture] );
+}
+
+
+static MaterialData packMaterial( PathTracerState& state, uint32_t material )
+{
+    MaterialData data;
+    data.emission_color = scene.materials.emission[material];
+    data.diffuse_color  = scene.materials.diffuse[material];
+    data.specular_color = scene.materials.specular[material];
+    data.spec_exp       = scene.materials.spec_exp[material];
+    data.ior            = scene.materials.ior[material];
+    data.mat            = scene.materials.types[material];
+    data.diffuse_texture  = demandTexture( state, scene.materials.diffuse_texture[material] );
+    data.specular_texture = demandTexture( state, scene.materials.specular_texture[material] );
+    return data;
+}
+
+
+// (Re)upload the material table; its allocation only grows, by half again, so that adding materials one at a
+// time does not reallocate every time
+static void uploadMaterials( PathTracerState& state )
+{
+    const uint32_t            mat_count = scene.numMaterials();
+    std::vector<MaterialData> materials( mat_count );
+    for( uint32_t i = 0; i < mat_count; ++i )
+        materials[i] = packMaterial( state, i );
+
+    if( mat_count > state.materials_capacity )
+    {
+        CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_materials ) ) );
+        state.materials_capacity = std::max<size_t>( mat_count, state.materials_capacity + state.materials_capacity / 2 );
+        CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &state.d_materials ), state.materials_capacity * sizeof( MaterialData ) ) );
+    }
+    CUDA_CHECK( cudaMemcpy(
+                reinterpret_cast<void*>( state.d_materials ),
+                materials.data(),
+                mat_count * sizeof( MaterialData ),
+                cudaMemcpyHostToDevice
+                ) );
+    state.params.materials = reinterpret_cast<const MaterialData*>( state.d_materials );
+}
+
+
+// Rewrite the material table entries of the given materials
+static void updateMaterials( PathTracerState& state, const std::vector<uint32_t>& materials )
+{
+    for( uint32_t material : materials )
+    {
+        const MaterialData data = packMaterial( state, material );
+        CUDA_CHECK( cudaMemcpy( reinterpret_cast<void*>( state.d_materials + material * sizeof( MaterialData ) ),
+                                &data, sizeof( MaterialData ), cudaMemcpyHostToDevice ) );
+    }
+}
+
+
+void createSBT( PathTracerState& state )
+{
+    CUdeviceptr  d_raygen_record;
+    const size_t raygen_record_size = sizeof( RayGenRecord );
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_raygen_record ), raygen_record_size ) );
+
+    RayGenRecord rg_sbt = {};
+    OPTIX_CHECK( optixSbtRecordPackHeader( state.raygen_prog_group, &rg_sbt ) );
+
+    CUDA_CHECK( cudaMemcpy(
+                reinterpret_cast<void*>( d_raygen_record ),
+                &rg_sbt,
+                raygen_record_size,
+                cudaMemcpyHostToDevice
+                ) );
+
+
+    CUdeviceptr  d_miss_records;
+    const size_t miss_record_size = sizeof( MissRecord );
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_miss_records ), miss_record_size * RAY_TYPE_COUNT ) );
+
+    MissRecord ms_sbt[2];
+    OPTIX_CHECK( optixSbtRecordPackHeader( state.radiance_miss_group,  &ms_sbt[0] ) );
+    ms_sbt[0].data.bg_color = make_float4( 0.0f );
+    OPTIX_CHECK( optixSbtRecordPackHeader( state.occlusion_miss_group, &ms_sbt[1] ) );
+    ms_sbt[1].data.bg_color = make_float4( 0.0f );
+
+    CUDA_CHECK( cudaMemcpy(
+                reinterpret_cast<void*>( d_miss_records ),
+                ms_sbt,
+                miss_record_size*RAY_TYPE_COUNT,
+                cudaMemcpyHostToDevice
+                ) );
+
+    // The radiance and occlusion records of each GeometryType, see optixPathTracer.h
+    const int    hitgroup_record_count = GEOMETRY_TYPE_COUNT * RAY_TYPE_COUNT;
+    CUdeviceptr  d_hitgroup_records;
+    const size_t hitgroup_record_size = sizeof( HitGroupRecord );
+    CUDA_CHECK( cudaMalloc(
+                reinterpret_cast<void**>( &d_hitgroup_records ),
+                hitgroup_record_size * hitgroup_record_count
+                ) );
+
+    std::vector<HitGroupRecord> hitgroup_records( hitgroup_record_count );
+    for( int type = 0; type < GEOMETRY_TYPE_COUNT; ++type )
+    {
+        OPTIX_CHECK( optixSbtRecordPackHeader( state.radiance_hit_groups[type], &hitgroup_records[type * RAY_TYPE_COUNT + RAY_TYPE_RADIANCE] ) );
+        OPTIX_CHECK( optixSbtRecordPackHeader( state.occlusion_hit_groups[type], &hitgroup_records[type * RAY_TYPE_COUNT + RAY_TYPE_OCCLUSION] ) );
+    }
+
+    CUDA_CHECK( cudaMemcpy(
+                reinterpret_cast<void*>( d_hitgroup_records ),
+                hitgroup_records.data(),
+                hitgroup_record_size * hitgroup_record_count,
+                cudaMemcpyHostToDevice
+                ) );
+
+    uploadMaterials( state );
+
+    state.sbt.raygenRecord                = d_raygen_record;
+    state.sbt.missRecordBase              = d_miss_records;
+    state.sbt.missRecordStrideInBytes     = static_cast<uint32_t>( miss_record_size );
+    state.sbt.missRecordCount             = RAY_TYPE_COUNT;
+    state.sbt.hitgroupRecordBase          = d_hitgroup_records;
+    state.sbt.hitgroupRecordStrideInBytes = static_cast<uint32_t>( hitgroup_record_size );
+    state.sbt.hitgroupRecordCount         = hitgroup_record_count;
+
+    std::cout << "SBT: " << hitgroup_record_count << " hit group records, "
+              << raygen_record_size + miss_record_size * RAY_TYPE_COUNT + hitgroup_record_size * hitgroup_record_count
+              << " bytes; material table: " << scene.numMaterials() << " materials, "
+              << scene.numMaterials() * sizeof( MaterialData ) << " bytes" << std::endl;
+}
+
+
+// Free what createSBT allocated
+static void freeSBT( PathTracerState& state )
+{
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.sbt.raygenRecord ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.sbt.missRecordBase ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.sbt.hitgroupRecordBase ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_materials ) ) );
+    state.sbt                = {};
+    state.d_materials        = 0;
+    state.materials_capacity = 0;
+}
+
+
+// --benchmark-materials: compare the material table against the layout it replaced, a hit group record per
+// geometry type, material and ray type with the material in the record. Both are uploaded for a new material
+// count and for an edit of one material, and subframes are launched with the records at either size. The
+// programs read the material table either way, so the launches only differ in the SBT they index.
+void benchmarkMaterials( PathTracerState& state, int iterations )
+{
+    typedef Record<MaterialData> MaterialRecord;
+
+    const uint32_t mat_count    = std::max( scene.numMaterials(), 1u );
+    const size_t   record_count = size_t( GEOMETRY_TYPE_COUNT ) * mat_count * RAY_TYPE_COUNT;
+    const size_t   record_bytes = record_count * sizeof( MaterialRecord );
+
+    // Record (type, material, ray) is at ( type * mat_count + material ) * RAY_TYPE_COUNT + ray
+    std::vector<MaterialRecord> records( record_count );
+    const auto packRecords = [&]( uint32_t first_material, uint32_t end_material ) {
+        for( int type = 0; type < GEOMETRY_TYPE_COUNT; ++type )
+        {
+            for( uint32_t material = first_material; material < end_material; ++material )
+            {
+                MaterialRecord* record = &records[( type * mat_count + material ) * RAY_TYPE_COUNT];
+                OPTIX_CHECK( optixSbtRecordPackHeader( state.radiance_hit_groups[type], &record[RAY_TYPE_RADIANCE] ) );
+                OPTIX_CHECK( optixSbtRecordPackHeader( state.occlusion_hit_groups[type], &record[RAY_TYPE_OCCLUSION] ) );
+                if( material < scene.numMaterials() )
+                    record[RAY_TYPE_RADIANCE].data = record[RAY_TYPE_OCCLUSION].data = packMaterial( state, material );
+            }
+        }
+    };
+    CUdeviceptr d_records = 0;
+    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_records ), record_bytes ) );
+
+    std::cout << "Materials: " << scene.numMaterials() << " materials, " << iterations << " iterations\n"
+              << "  material table: " << GEOMETRY_TYPE_COUNT * RAY_TYPE_COUNT << " hit group records, "
+              << GEOMETRY_TYPE_COUNT * RAY_TYPE_COUNT * sizeof( HitGroupRecord ) << " bytes + "
+              << scene.numMaterials() * sizeof( MaterialData ) << " bytes of materials\n"
+              << "  per-material records: " << record_count << " hit group records, " << record_bytes << " bytes\n"
+              << std::setw( 24 ) << "" << std::setw( 16 ) << "table ms" << std::setw( 16 ) << "records ms" << std::endl;
+
+    const auto time = [&]( const std::function<void()>& work ) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for( int i = 0; i < iterations; ++i )
+            work();
+        CUDA_SYNC_CHECK();
+        return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - t0 ).count() / iterations;
+    };
+    const auto print = [&]( const char* name, double table_ms, double records_ms ) {
+        std::cout << std::fixed << std::setprecision( 4 ) << std::setw( 24 ) << name << std::setw( 16 ) << table_ms
+                  << std::setw( 16 ) << records_ms << std::endl;
+    };
+
+    // A new material count rewrites everything; the records would also need new instance SBT offsets, not timed
+    print( "material count change", time( [&]() { uploadMaterials( state ); } ), time( [&]() {
+               packRecords( 0, mat_count );
+               CUDA_CHECK( cudaMemcpy( reinterpret_cast<void*>( d_records ), records.data(), record_bytes, cudaMemcpyHostToDevice ) );
+           } ) );
+
+    // An edit of material 0 rewrites one table entry, or its records of every geometry type
+    print( "material edit", time( [&]() { updateMaterials( state, { 0 } ); } ), time( [&]() {
+               packRecords( 0, 1 );
+               for( int type = 0; type < GEOMETRY_TYPE_COUNT; ++type )
+               {
+                   const size_t first = size_t( type ) * mat_count * RAY_TYPE_COUNT;
+                   CUDA_CHECK( cudaMemcpy( reinterpret_cast<void*>( d_records + first * sizeof( MaterialRecord ) ), &records[first],
+                                           RAY_TYPE_COUNT * sizeof( MaterialRecord ), cudaMemcpyHostToDevice ) );
+               }
+           } ) );
+
+    // Launches with the records at their per-material stride; every record carries the program of its
+    // geometry type and ray type so the instance SBT offsets of the current layout still find the right one
+    Params&                         params = state.params;
+    sutil::CUDAOutputBuffer<uchar4> output_buffer( sutil::CUDAOutputBufferType::CUDA_DEVICE, params.width, params.height );
+    output_buffer.setStream( state.stream );
+    handleCameraUpdate( params );
+    for( size_t i = 0; i < record_count; ++i )
+    {
+        const int type = static_cast<int>( i / RAY_TYPE_COUNT % GEOMETRY_TYPE_COUNT );
+        OPTIX_CHECK( optixSbtRecordPackHeader( i % RAY_TYPE_COUNT == RAY_TYPE_RADIANCE ? state.radiance_hit_groups[type] :
+                                                                                         state.occlusion_hit_groups[type],
+                                               &records[i] ) );
+    }
+    CUDA_CHECK( cudaMemcpy( reinterpret_cast<void*>( d_records ), records.data(), record_bytes, cudaMemcpyHostToDevice ) );
+
+    const OptixShaderBindingTable table_sbt   = state.sbt;
+    OptixShaderBindingTable       records_sbt = state.sbt;
+    records_sbt.hitgroupRecordBase            = d_records;
+    records_sbt.hitgroupRecordStrideInBytes   = static_cast<uint32_t>( sizeof( MaterialRecord ) );
+    records_sbt.hitgroupRecordCount           = static_cast<unsigned int>( record_count );
+    const auto launches = [&]( const OptixShaderBindingTable& sbt ) {
+        state.sbt             = sbt;
+        params.subframe_index = 0;
+        launchSubframe( output_buffer, state );
+        return time( [&]() {
+            ++params.subframe_index;
+            launchSubframe( output_buffer, state );
+        } );
+    };
+    const double table_ms   = launches( table_sbt );
+    const double records_ms = launches( records_sbt );
+    print( "subframe", table_ms, records_ms );
+
+    state.sbt             = table_sbt;
+    params.subframe_index = 0;
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( d_records ) ) );
+}
+
+
+// (Re)upload the light buffer
+static void uploadLights( PathTracerState& state )
+{
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_lights ) ) );
+    state.d_lights          = uploadBuffer( scene.lights.data(), scene.lights.size() * sizeof( Light ) );
+    state.params.lights     = reinterpret_cast<Light*>( state.d_lights );
+    state.params.num_lights = scene.lights.size();
+}
+
+
+static SceneCamera sceneCamera()
 {
-    CUdeviceptr  d_raygen_record;
-    const size_t raygen_record_size = sizeof( RayGenRecord );
-    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_raygen_record ), raygen_record_size ) );
+    SceneCamera scene_camera;
+    scene_camera.eye    = camera.eye();
+    scene_camera.lookat = camera.lookat();
+    scene_camera.up     = camera.up();
+    scene_camera.fovy   = camera.fovY();
+    scene_camera.width  = width;
+    scene_camera.height = height;
+    return scene_camera;
+}
 
-    RayGenRecord rg_sbt = {};
-    OPTIX_CHECK( optixSbtRecordPackHeader( state.raygen_prog_group, &rg_sbt ) );
 
-    CUDA_CHECK( cudaMemcpy(
-                reinterpret_cast<void*>( d_raygen_record ),
-                &rg_sbt,
-                raygen_record_size,
-                cudaMemcpyHostToDevice
-                ) );
+// The scene file and every OBJ and MTL file the running scene was built from
+static std::vector<std::string> sceneFiles( const std::string& scene_file )
+{
+    std::vector<std::string> files( 1, scene_file );
+    files.insert( files.end(), scene.dependencies.begin(), scene.dependencies.end() );
+    return files;
+}
 
 
-    CUdeviceptr  d_miss_records;
-    const size_t miss_record_size = sizeof( MissRecord );
-    CUDA_CHECK( cudaMalloc( reinterpret_cast<void**>( &d_miss_records ), miss_record_size * RAY_TYPE_COUNT ) );
+//
+// --watch: parse the scene file again and apply only what changed since the running scene was loaded.
+// Edited materials are rewritten in the material table, meshes whose content changed get a new GAS while the others
+// keep theirs, and the IAS, the light buffer and the camera are updated where needed. If the file does
+// not parse, the running scene stays as it is.
+//
+void reloadScene( PathTracerState& state, std::string& scene_file )
+{
+    const auto t0 = std::chrono::steady_clock::now();
+
+    // readSceneFile fills the global scene and camera, so the running ones are put aside meanwhile
+    SceneBuilder        running                = std::move( scene );
+    const sutil::Camera running_camera         = camera;
+    const int           running_width          = width;
+    const int           running_height         = height;
+    const bool          running_camera_changed = camera_changed;
+    SceneBuilder        next;
+    SceneCamera         next_camera;
+    bool                parsed = false;
+    try
+    {
+        scene = SceneBuilder();
+        readSceneFile( scene_file );
+        scene.releaseObjCache();
+        next        = std::move( scene );
+        next_camera = sceneCamera();
+        parsed      = true;
+    }
+    catch( const std::exception& e )
+    {
+        std::cerr << "Scene reload failed, keeping the running scene: " << e.what() << std::endl;
+    }
+    scene          = std::move( running );
+    camera         = running_camera;
+    width          = running_width;
+    height         = running_height;
+    camera_changed = running_camera_changed;
+    if( !parsed )
+        return;
 
-    MissRecord ms_sbt[2];
-    OPTIX_CHECK( optixSbtRecordPackHeader( state.radiance_miss_group,  &ms_sbt[0] ) );
-    ms_sbt[0].data.bg_color = make_float4( 0.0f );
-    OPTIX_CHECK( optixSbtRecordPackHeader( state.occlusion_miss_group, &ms_sbt[1] ) );
-    ms_sbt[1].data.bg_color = make_float4( 0.0f );
+    SceneSnapshot   next_snapshot = makeSceneSnapshot( next, next_camera );
+    const SceneDiff diff          = diffScenes( scene_snapshot, next_snapshot );
+    if( diff.empty() )
+    {
+        std::cout << "Scene reload: no changes" << std::endl;
+        return;
+    }
+    scene = std::move( next );
 
-    CUDA_CHECK( cudaMemcpy(
-                reinterpret_cast<void*>( d_miss_records ),
-                ms_sbt,
-                miss_record_size*RAY_TYPE_COUNT,
-                cudaMemcpyHostToDevice
-                ) );
+    if( diff.materials_resized )
+        uploadMaterials( state );
+    else if( !diff.changed_materials.empty() )
+        updateMaterials( state, diff.changed_materials );
 
-    CUdeviceptr  d_hitgroup_records;
-    const size_t hitgroup_record_size = sizeof( HitGroupRecord );
-    CUDA_CHECK( cudaMalloc(
-                reinterpret_cast<void**>( &d_hitgroup_records ),
-                hitgroup_record_size * RAY_TYPE_COUNT * MAT_COUNT
-                ) );
+    const size_t num_meshes = scene.meshes.size();
+    if( diff.numBuiltMeshes() > 0 || !diff.removed_meshes.empty() || diff.instances_changed )
+    {
+        const SceneStorage    geometry = scene.takeGeometry();
+        std::deque<MeshAccel> meshes( scene.meshes.size() );
+        std::vector<uint32_t> built;
+        for( uint32_t i = 0; i < scene.meshes.size(); ++i )
+        {
+            if( diff.mesh_sources[i] == NEW_MESH )
+            {
+                built.push_back( i );
+                continue;
+            }
+            moveMeshAccel( state.meshes[diff.mesh_sources[i]], meshes[i] );
+            releaseHostGeometry( scene.meshes[i] );
+        }
+        buildSceneMeshes( state, built, meshes, nullptr );
+        for( uint32_t old : diff.removed_meshes )
+            freeMeshAccel( state.meshes[old] );
+        state.meshes.swap( meshes );
+        uploadGeometryTable( state );
+
+        // The instance count may differ, build the IAS from scratch
+        state.ias_updatable = false;
+        for( const MeshAccel& mesh : state.meshes )
+            state.ias_updatable |= mesh.dynamic;
+        rebuildInstanceAccel( state );
+    }
+    else
+    {
+        // Nothing to build, drop the parsed geometry
+        scene.takeGeometry();
+        for( SceneMesh& mesh : scene.meshes )
+            releaseHostGeometry( mesh );
+    }
 
-    std::vector<HitGroupRecord> hitgroup_records;
-    for (int i = 0; i < RAY_TYPE_COUNT * MAT_COUNT; ++i) {
-        hitgroup_records.push_back(HitGroupRecord());
+    if( diff.lights_changed )
+        uploadLights( state );
+    if( diff.camera_changed )
+    {
+        camera.setEye( next_camera.eye );
+        camera.setLookat( next_camera.lookat );
+        camera.setUp( next_camera.up );
+        camera.setFovY( next_camera.fovy );
+        trackball.reinitOrientationFromCamera();
+        camera_changed = true;
     }
-    for( int i = 0; i < MAT_COUNT; ++i )
+    CUDA_SYNC_CHECK();
+    // A camera change restarts the accumulation by itself
+    geometry_changed |= diff.numBuiltMeshes() > 0 || !diff.removed_meshes.empty() || diff.instances_changed;
+    shading_changed |= diff.materials_resized || !diff.changed_materials.empty() || diff.lights_changed;
+    scene_snapshot = std::move( next_snapshot );
+
+    const std::chrono::duration<double, std::milli> reload_time = std::chrono::steady_clock::now() - t0;
+    std::cout << std::fixed << std::setprecision( 1 ) << "Scene reload: " << describeSceneDiff( diff, num_meshes ) << " in "
+              << reload_time.count() << " ms" << std::endl;
+}
+
+
+// Refits of the IAS for moved objects before it is built again, a refit keeps the tree of the last build
+static const unsigned int MAX_EDIT_IAS_REFITS = 64;
+
+//
+// --edit-port: apply the scene edits received since the last frame, in order, and acknowledge each with the
+// frame that is rendered next. Device work is kept to what the batch touched: moved objects and groups update
+// the instances below them in the scene graph and refit the IAS, material edits rewrite their material table entry,
+// light edits patch their element of the light buffer. Only added or removed objects build the IAS again,
+// and only a shape or OBJ file the scene has no mesh for yet builds a GAS; the meshes of removed objects
+// stay on the device for the next object that uses them. Material and light edits restart the accumulation
+// without tracing the primary rays again. Area lights have an emitter plane in the scene and cannot be edited
+// as lights.
+//
+void applySceneEdits( PathTracerState& state, uint64_t frame )
+{
+    std::vector<SceneEdit> edits;
+    state.scene_edits.poll( edits );
+    if( edits.empty() )
+        return;
+
+    const auto     t0            = std::chrono::steady_clock::now();
+    const size_t   num_meshes    = scene.meshes.size();
+    const uint32_t num_materials = scene.numMaterials();
+    bool           instances_changed = false;
+    std::set<uint32_t>        materials;
+    std::set<uint32_t>        lights;
+    std::vector<SceneEditAck> acks( edits.size() );
+    for( size_t e = 0; e < edits.size(); ++e )
     {
+        const SceneEdit& edit   = edits[e];
+        SceneEditStatus  status = SCENE_EDIT_OK;
+        auto             object = edit_objects.find( edit.id );
+        switch( edit.type )
         {
-            const int sbt_idx = i * RAY_TYPE_COUNT + 0;  // SBT for radiance ray-type for ith material
-
-            OPTIX_CHECK( optixSbtRecordPackHeader( state.radiance_hit_group, &hitgroup_records[sbt_idx] ) );
-            hitgroup_records[sbt_idx].data.emission_color = d_emission_colors[i];
-            hitgroup_records[sbt_idx].data.diffuse_color  = d_diffuse_colors[i];
-            hitgroup_records[sbt_idx].data.specular_color = d_spec_colors[i];
-            hitgroup_records[sbt_idx].data.spec_exp       = d_spec_exp[i];
-            hitgroup_records[sbt_idx].data.ior            = d_ior[i];
-            hitgroup_records[sbt_idx].data.vertices       = reinterpret_cast<float4*>( state.d_vertices );
-            hitgroup_records[sbt_idx].data.mat            = d_mat_types[i];
+            case SCENE_EDIT_ADD_GEOMETRY:
+            {
+                const uint32_t shape = edit.geometry.shape;
+                if( object != edit_objects.end() || ( shape != CUBE && shape != ICOSPHERE && shape != MESH )
+                    || edit.geometry.material >= num_materials )
+                {
+                    status = SCENE_EDIT_INVALID;
+                    break;
+                }
+                // addSceneGeometry places a new instance and creates the mesh if its shape and material are new
+                const size_t instance = scene.instances.size();
+                try
+                {
+                    addSceneGeometry( static_cast<Geom>( shape ), edit.geometry.material, glm::vec3( 0.f ), glm::vec3( 0.f ),
+                                      glm::vec3( 1.f ), edit.path, false );
+                }
+                catch( const std::exception& ex )
+                {
+                    std::cerr << "Scene edits: cannot add " << edit.path << ": " << ex.what() << std::endl;
+                    status = SCENE_EDIT_FAILED;
+                    break;
+                }
+                if( scene.instances.size() == instance )
+                {
+                    status = SCENE_EDIT_INVALID;  // a MESH without a path
+                    break;
+                }
+                const SceneGraph::NodeId node = scene_graph.addNode( SceneGraph::NO_NODE, edit.geometry.transform,
+                                                                     static_cast<uint32_t>( instance ) );
+                edit_objects[edit.id] = node;
+                instance_nodes.push_back( node );
+                instances_changed = true;
+                break;
+            }
+            case SCENE_EDIT_ADD_GROUP:
+            {
+                if( object != edit_objects.end() )
+                    status = SCENE_EDIT_INVALID;
+                else
+                    edit_objects[edit.id] = scene_graph.addNode( SceneGraph::NO_NODE, edit.transform );
+                break;
+            }
+            case SCENE_EDIT_REMOVE_GEOMETRY:
+            {
+                if( object == edit_objects.end() )
+                {
+                    status = SCENE_EDIT_UNKNOWN_OBJECT;
+                    break;
+                }
+                if( scene_graph.hasChildren( object->second ) )
+                {
+                    status = SCENE_EDIT_INVALID;
+                    break;
+                }
+                // The last instance takes the place of the removed one
+                const uint32_t instance = scene_graph.instance( object->second );
+                if( instance != SceneGraph::NO_INSTANCE )
+                {
+                    scene.instances[instance] = scene.instances.back();
+                    instance_nodes[instance]  = instance_nodes.back();
+                    scene.instances.pop_back();
+                    instance_nodes.pop_back();
+                    if( instance < instance_nodes.size() )
+                        scene_graph.setInstance( instance_nodes[instance], instance );
+                    instances_changed = true;
+                }
+                scene_graph.removeNode( object->second );
+                edit_objects.erase( object );
+                break;
+            }
+            case SCENE_EDIT_SET_TRANSFORM:
+            {
+                if( object == edit_objects.end() )
+                    status = SCENE_EDIT_UNKNOWN_OBJECT;
+                else
+                    scene_graph.setLocal( object->second, edit.transform );
+                break;
+            }
+            case SCENE_EDIT_SET_PARENT:
+            {
+                auto parent = edit_objects.find( edit.parent );
+                if( object == edit_objects.end() || ( edit.parent != SCENE_EDIT_NO_PARENT && parent == edit_objects.end() ) )
+                    status = SCENE_EDIT_UNKNOWN_OBJECT;
+                else if( !scene_graph.setParent( object->second, parent == edit_objects.end() ? SceneGraph::NO_NODE : parent->second ) )
+                    status = SCENE_EDIT_INVALID;
+                break;
+            }
+            case SCENE_EDIT_SET_MATERIAL:
+            {
+                if( edit.id >= scene.numMaterials() )
+                {
+                    status = SCENE_EDIT_UNKNOWN_OBJECT;
+                    break;
+                }
+                if( edit.material.type > EMISSIVE )
+                {
+                    status = SCENE_EDIT_INVALID;
+                    break;
+                }
+                const uint32_t material = static_cast<uint32_t>( edit.id );
+                scene.materials.types[material]    = static_cast<Material>( edit.material.type );
+                scene.materials.diffuse[material]  = edit.material.diffuse;
+                scene.materials.specular[material] = edit.material.specular;
+                scene.materials.emission[material] = edit.material.emission;
+                scene.materials.spec_exp[material] = edit.material.spec_exp;
+                scene.materials.ior[material]      = edit.material.ior;
+                materials.insert( material );
+                break;
+            }
+            case SCENE_EDIT_SET_LIGHT:
+            {
+                if( edit.id >= scene.lights.size() )
+                {
+                    status = SCENE_EDIT_UNKNOWN_OBJECT;
+                    break;
+                }
+                // An area light is emitted by a plane of the scene with an emissive material shared by other
+                // planes, which a light edit cannot move or recolor; point and spot lights have no geometry
+                if( ( edit.light.shape != POINT_LIGHT && edit.light.shape != SPOT_LIGHT ) || scene.lights[edit.id].shape == AREA_LIGHT )
+                {
+                    status = SCENE_EDIT_INVALID;
+                    break;
+                }
+                Light& light        = scene.lights[edit.id];
+                light.shape         = static_cast<Geom>( edit.light.shape );
+                light.corner        = edit.light.corner;
+                light.v1            = edit.light.v1;
+                light.v2            = edit.light.v2;
+                light.normal        = edit.light.normal;
+                light.emission      = edit.light.emission;
+                light.width         = edit.light.width;
+                light.falloff_start = edit.light.falloff_start;
+                lights.insert( static_cast<uint32_t>( edit.id ) );
+                break;
+            }
         }
+        acks[e].magic    = SCENE_EDIT_ACK_MAGIC;
+        acks[e].sequence = edit.sequence;
+        acks[e].frame    = frame;
+        acks[e].status   = status;
+        acks[e].reserved = 0;
+    }
 
-        {
-            const int sbt_idx = i * RAY_TYPE_COUNT + 1;  // SBT for occlusion ray-type for ith material
-            memset( &hitgroup_records[sbt_idx], 0, hitgroup_record_size );
+    // World transforms of the moved subtrees, written into the scene instances below them
+    std::vector<uint32_t> touched;
+    scene_graph.update( scene.instances.data(), sizeof( Instance ), touched );
 
-            OPTIX_CHECK( optixSbtRecordPackHeader( state.occlusion_hit_group, &hitgroup_records[sbt_idx] ) );
-        }
+    // GAS for the meshes the added objects created
+    if( scene.meshes.size() > num_meshes )
+    {
+        const SceneStorage    geometry = scene.takeGeometry();
+        std::vector<uint32_t> built;
+        for( size_t i = num_meshes; i < scene.meshes.size(); ++i )
+            built.push_back( static_cast<uint32_t>( i ) );
+        state.meshes.resize( scene.meshes.size() );
+        buildSceneMeshes( state, built, state.meshes, nullptr );
+        uploadGeometryTable( state );
     }
 
-    CUDA_CHECK( cudaMemcpy(
-                reinterpret_cast<void*>( d_hitgroup_records ),
-                hitgroup_records.data(),
-                hitgroup_record_size*RAY_TYPE_COUNT*MAT_COUNT,
-                cudaMemcpyHostToDevice
-                ) );
+    // An OBJ file with a material library adds materials, which only grows the material table
+    if( scene.numMaterials() != num_materials )
+        uploadMaterials( state );
+    else if( !materials.empty() )
+        updateMaterials( state, std::vector<uint32_t>( materials.begin(), materials.end() ) );
 
-    state.sbt.raygenRecord                = d_raygen_record;
-    state.sbt.missRecordBase              = d_miss_records;
-    state.sbt.missRecordStrideInBytes     = static_cast<uint32_t>( miss_record_size );
-    state.sbt.missRecordCount             = RAY_TYPE_COUNT;
-    state.sbt.hitgroupRecordBase          = d_hitgroup_records;
-    state.sbt.hitgroupRecordStrideInBytes = static_cast<uint32_t>( hitgroup_record_size );
-    state.sbt.hitgroupRecordCount         = RAY_TYPE_COUNT * MAT_COUNT;
+    for( uint32_t light : lights )
+        CUDA_CHECK( cudaMemcpy( reinterpret_cast<void*>( state.d_lights + light * sizeof( Light ) ), &scene.lights[light],
+                                sizeof( Light ), cudaMemcpyHostToDevice ) );
+
+    if( instances_changed )
+    {
+        rebuildInstanceAccel( state );
+        state.ias_edit_refits = 0;
+    }
+    else if( !touched.empty() )
+    {
+        if( ++state.ias_edit_refits >= MAX_EDIT_IAS_REFITS )
+        {
+            state.ias_needs_rebuild = true;
+            state.ias_edit_refits   = 0;
+        }
+        updateInstanceTransforms( state, touched );
+    }
+    CUDA_SYNC_CHECK();
+    // Rejected edits change nothing, material and light edits keep the cached primary hits
+    geometry_changed |= instances_changed || !touched.empty() || scene.meshes.size() > num_meshes;
+    shading_changed |= scene.numMaterials() != num_materials || !materials.empty() || !lights.empty();
+    state.scene_edits.acknowledge( acks );
+
+    // Edits can arrive with every frame, so they are summarized once per second
+    static auto   report_start = t0;
+    static size_t report_edits = 0, report_rejected = 0, report_frames = 0;
+    static double report_ms = 0.0, report_max_ms = 0.0;
+    const auto    t1 = std::chrono::steady_clock::now();
+    const double  ms = std::chrono::duration<double, std::milli>( t1 - t0 ).count();
+    report_edits += edits.size();
+    report_frames += 1;
+    report_ms += ms;
+    report_max_ms = std::max( report_max_ms, ms );
+    for( const SceneEditAck& ack : acks )
+        report_rejected += ack.status != SCENE_EDIT_OK;
+    if( t1 - report_start >= std::chrono::seconds( 1 ) )
+    {
+        std::cout << std::fixed << std::setprecision( 2 ) << "Scene edits: " << report_edits << " in " << report_frames
+                  << " frames (" << report_rejected << " rejected), " << scene.instances.size() << " objects, apply mean "
+                  << report_ms / report_frames << " ms, max " << report_max_ms << " ms" << std::endl;
+        report_start = t1;
+        report_edits = report_rejected = report_frames = 0;
+        report_ms = report_max_ms = 0.0;
+    }
 }
 
 
@@ -1475,20 +3173,28 @@ void cleanupState( PathTracerState& state )
     OPTIX_CHECK( optixPipelineDestroy( state.pipeline ) );
     OPTIX_CHECK( optixProgramGroupDestroy( state.raygen_prog_group ) );
     OPTIX_CHECK( optixProgramGroupDestroy( state.radiance_miss_group ) );
-    OPTIX_CHECK( optixProgramGroupDestroy( state.radiance_hit_group ) );
-    OPTIX_CHECK( optixProgramGroupDestroy( state.occlusion_hit_group ) );
+    for( int type = 0; type < GEOMETRY_TYPE_COUNT; ++type )
+    {
+        OPTIX_CHECK( optixProgramGroupDestroy( state.radiance_hit_groups[type] ) );
+        OPTIX_CHECK( optixProgramGroupDestroy( state.occlusion_hit_groups[type] ) );
+    }
     OPTIX_CHECK( optixProgramGroupDestroy( state.occlusion_miss_group ) );
     OPTIX_CHECK( optixModuleDestroy( state.ptx_module ) );
     OPTIX_CHECK( optixDeviceContextDestroy( state.context ) );
 
 
-    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.sbt.raygenRecord ) ) );
-    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.sbt.missRecordBase ) ) );
-    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.sbt.hitgroupRecordBase ) ) );
-    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_vertices ) ) );
+    freeSBT( state );
+    for( MeshAccel& mesh : state.meshes )
+        freeMeshAccel( mesh );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_geometries ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_instances ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_ias_output_buffer ) ) );
+    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_ias_temp_buffer ) ) );
     CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_lights ) ) );
-    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_gas_output_buffer ) ) );
-    CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.params.accum_buffer ) ) );
+    state.staging.release();
+    state.textures.printStats( std::cout );
+    state.textures.release();
+    freeFrameBuffers( state.params );
     CUDA_CHECK( cudaFree( reinterpret_cast<void*>( state.d_params ) ) );
 }
 
@@ -1501,6 +3207,7 @@ void cleanupState( PathTracerState& state )
 
 int main( int argc, char* argv[] )
 {
+    const auto      startup_begin = std::chrono::steady_clock::now();
     PathTracerState state;
     sutil::CUDAOutputBufferType output_buffer_type = sutil::CUDAOutputBufferType::ZERO_COPY;
     float3 prev_lookat;
@@ -1510,6 +3217,10 @@ int main( int argc, char* argv[] )
     //
     std::string outfile;
     std::string scene_file;
+    std::string scene_cache_file;
+    std::string accel_cache_file;
+    bool        convert_scene         = false;
+    bool        benchmark_scene_cache = false;
 
     for( int i = 1; i < argc; ++i )
     {
@@ -1542,6 +3253,148 @@ int main( int argc, char* argv[] )
             state.params.width  = w;
             state.params.height = h;
         }
+        else if( arg == "--denoise" )
+        {
+            denoise = true;
+        }
+        else if( arg == "--no-reproject" )
+        {
+            reproject = false;
+        }
+        else if( arg == "--adaptive" )
+        {
+            adaptive_sampling = true;
+        }
+        else if( arg == "--adaptive-threshold" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            convergence_threshold = static_cast<float>( atof( argv[++i] ) );
+        }
+        else if( arg == "--cache-primary-hits" )
+        {
+            cache_primary_hits = true;
+        }
+        else if( arg == "--no-history-clamp" )
+        {
+            clamp_history = false;
+        }
+        else if( arg == "--max-history" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            max_history = static_cast<float>( atof( argv[++i] ) );
+        }
+        else if( arg == "--snorm16-positions" )
+        {
+            position_format = POSITION_SNORM16;
+        }
+        else if( arg == "--tessellate" )
+        {
+            tessellate_primitives = true;
+        }
+        else if( arg == "--scene-cache" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            scene_cache_file = argv[++i];
+        }
+        else if( arg == "--no-scene-cache" )
+        {
+            use_scene_cache = false;
+        }
+        else if( arg == "--convert-scene" )
+        {
+            convert_scene = true;
+        }
+        else if( arg == "--benchmark-scene-cache" )
+        {
+            benchmark_scene_cache = true;
+        }
+        else if( arg == "--ptx-cache" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            sutil::setPtxCache( argv[++i], sutil::defaultPtxCacheBytes() );
+        }
+        else if( arg == "--no-ptx-cache" )
+        {
+            sutil::setPtxCache( nullptr, 0 );
+        }
+        else if( arg == "--accel-cache" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            accel_cache_file = argv[++i];
+        }
+        else if( arg == "--no-accel-cache" )
+        {
+            use_accel_cache = false;
+        }
+        else if( arg == "--watch" )
+        {
+            watch_scene = true;
+        }
+        else if( arg == "--animate" )
+        {
+            animate_dynamic = true;
+        }
+        else if( arg == "--refit-threshold" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            refit_threshold = static_cast<float>( atof( argv[++i] ) );
+        }
+        else if( arg == "--benchmark-refit" )
+        {
+            benchmark_refit = true;
+        }
+        else if( arg == "--benchmark-subframes" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            benchmark_subframes = atoi( argv[++i] );
+        }
+        else if( arg == "--benchmark-materials" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            benchmark_materials = atoi( argv[++i] );
+        }
+        else if( arg == "--spatial-port" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            spatial_mapping = true;
+            state.spatial_ingest.settings().port = static_cast<uint16_t>( atoi( argv[++i] ) );
+        }
+        else if( arg == "--spatial-cell" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            state.spatial_ingest.settings().cell_size = static_cast<float>( atof( argv[++i] ) );
+        }
+        else if( arg == "--edit-port" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            scene_editing = true;
+            state.scene_edits.settings().port = static_cast<uint16_t>( atoi( argv[++i] ) );
+        }
+        else if( arg == "--texture-memory" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            texture_memory = static_cast<size_t>( atof( argv[++i] ) * 1024.0 * 1024.0 );
+        }
+        else if( arg == "--indirect-scale" )
+        {
+            if( i >= argc - 1 )
+                printUsageAndExit( argv[0] );
+            indirect_scale = static_cast<unsigned int>( atoi( argv[++i] ) );
+            if( indirect_scale != 1 && indirect_scale != 2 && indirect_scale != 4 )
+                printUsageAndExit( argv[0] );
+        }
         else if( arg == "--launch-samples" || arg == "-s" )
         {
             if( i >= argc - 1 )
@@ -1555,24 +3408,135 @@ int main( int argc, char* argv[] )
         }
     }
 
+    // The indirect pass has no list of active pixels, so adaptive launches would leave it stale
+    if( adaptive_sampling && indirect_scale > 1 )
+    {
+        std::cerr << "--adaptive is ignored with --indirect-scale\n";
+        adaptive_sampling = false;
+    }
+
+    // Spatial mapping patches are meshes the scene file does not know about, a reload would drop them
+    if( watch_scene && spatial_mapping )
+    {
+        std::cerr << "--watch is ignored with --spatial-port\n";
+        watch_scene = false;
+    }
+
+    // Edits address the instances of the scene file by index, which a reload or spatial patches would shift
+    if( scene_editing && ( watch_scene || spatial_mapping ) )
+    {
+        std::cerr << "--edit-port is ignored with --watch and --spatial-port\n";
+        scene_editing = false;
+    }
+    // Moved objects refit the IAS instead of building it again
+    state.ias_updatable = scene_editing;
+
     try
     {
-        // Set up the scene
-        readSceneFile(scene_file);
-        prev_lookat = camera.lookat();
-        state.params.width = width;
-        state.params.height = height;
+        // Set up the scene, from its binary cache when that is still valid
+        if( scene_cache_file.empty() )
+            scene_cache_file = sceneCachePath( scene_file );
+        if( accel_cache_file.empty() )
+            accel_cache_file = accelCachePath( scene_file );
+        const auto loadScene = [&] {
+            const uint64_t cache_options = sceneCacheOptions( tessellate_primitives );
+            std::string    cache_reason;
+            const auto     load_start = std::chrono::steady_clock::now();
+            const bool     from_cache = use_scene_cache && !convert_scene
+                                    && loadSceneCache( scene_cache_file, scene_file, cache_options, scene, cache_reason );
+            readSceneFile( scene_file, !from_cache );
+            scene.releaseObjCache();
+            const std::chrono::duration<double, std::milli> load_time = std::chrono::steady_clock::now() - load_start;
+            std::ostringstream report;  // one write, the context and module are created meanwhile
+            report << std::fixed << std::setprecision( 1 ) << "Scene: " << scene.meshes.size() << " meshes, "
+                   << scene.instances.size() << " instances, " << scene.numPrimitives() << " primitives, "
+                   << scene.numMaterials() << " materials loaded in " << load_time.count() << " ms "
+                   << ( from_cache ? "from " + scene_cache_file : "by parsing" ) << " (geometry arena "
+                   << scene.arenaBytes() / ( 1024.0 * 1024.0 ) << " MB, peak RSS "
+                   << peakResidentBytes() / ( 1024.0 * 1024.0 ) << " MB)\n";
+            std::cout << report.str() << std::flush;
+            if( ( use_scene_cache || convert_scene ) && !from_cache )
+            {
+                if( !convert_scene )
+                    std::cout << "Scene cache " + scene_cache_file + ": " + cache_reason + ", writing a new one\n" << std::flush;
+                std::string err;
+                if( !writeSceneCache( scene_cache_file, scene_file, cache_options, scene, err ) )
+                    std::cerr << "Could not write the scene cache: " << err << std::endl;
+                else if( convert_scene )
+                    std::cout << "Wrote " << scene_cache_file << std::endl;
+            }
+        };
+        if( convert_scene || benchmark_scene_cache )
+        {
+            loadScene();
+            if( !convert_scene )
+                benchmarkSceneCache( scene_file, scene_cache_file );
+            return 0;
+        }
 
         //
-        // Set up OptiX state
+        // Set up OptiX state. Loading the scene is independent of creating the context, module, program
+        // groups and pipeline, so the two chains run concurrently. Geometry uploads and the launch setup
+        // stay on the main thread, which keeps the order of device work the same as without the graph.
         //
-        createContext( state );
-        buildMeshAccel( state );
-        createModule( state );
-        createProgramGroups( state );
-        createPipeline( state );
-        createSBT( state );
-        initLaunchParams( state );
+        const auto onWorker = []( std::function<void()> work ) {
+            return [work] {
+                CUDA_CHECK( cudaFree( 0 ) );  // make the primary context current on this worker thread
+                work();
+            };
+        };
+        TaskGraph startup;
+        const TaskGraph::TaskId load = startup.add( "scene", [&] {
+            loadScene();
+            if( spatial_mapping )
+            {
+                // Every patch uses one neutral diffuse material, added before the material table is uploaded
+                spatial_material = scene.addMaterial( DIFFUSE, make_float3( 0.7f ), make_float3( 0.f ), make_float3( 0.f ), 0.f, 0.f );
+                state.spatial_ingest.settings().format = position_format;
+            }
+            if( watch_scene )
+                scene_snapshot = makeSceneSnapshot( scene, sceneCamera() );
+            if( scene_editing )
+            {
+                // The instances of the scene file are the objects 0 to n-1, without a parent
+                for( uint32_t i = 0; i < scene.instances.size(); ++i )
+                {
+                    edit_objects[i] = scene_graph.addNode( SceneGraph::NO_NODE, scene.instances[i].transform, i );
+                    instance_nodes.push_back( edit_objects[i] );
+                }
+                std::vector<uint32_t> touched;
+                scene_graph.update( nullptr, 0, touched );
+            }
+        } );
+        const TaskGraph::TaskId context = startup.add( "context", [&] { createContext( state ); }, {}, TaskGraph::MAIN_THREAD );
+        const TaskGraph::TaskId module = startup.add( "module", onWorker( [&] { createModule( state ); } ), { context } );
+        const TaskGraph::TaskId groups = startup.add( "program groups", onWorker( [&] { createProgramGroups( state ); } ), { module } );
+        const TaskGraph::TaskId pipeline = startup.add( "pipeline", onWorker( [&] { createPipeline( state ); } ), { groups } );
+        const TaskGraph::TaskId geometry = startup.add( "geometry", [&] {
+            buildMeshAccel( state, use_accel_cache ? accel_cache_file : std::string() );
+        }, { load, context }, TaskGraph::MAIN_THREAD );
+        const TaskGraph::TaskId sbt = startup.add( "sbt", onWorker( [&] { createSBT( state ); } ), { load, groups } );
+        startup.add( "launch params", [&] {
+            state.params.width  = width;
+            state.params.height = height;
+            initLaunchParams( state );
+        }, { geometry, pipeline, sbt }, TaskGraph::MAIN_THREAD );
+        startup.run();
+
+        prev_lookat = camera.lookat();
+        startup.printTimeline( std::cout, "Startup timeline" );
+        const std::chrono::duration<double, std::milli> startup_time = std::chrono::steady_clock::now() - startup_begin;
+        std::cout << "Startup: " << startup_time.count() << " ms to the first launch" << std::endl;
+        if( benchmark_refit )
+            benchmarkRefit( state );
+        if( benchmark_subframes > 0 )
+            benchmarkSubframes( state, benchmark_subframes );
+        if( benchmark_materials > 0 )
+            benchmarkMaterials( state, benchmark_materials );
+        if( spatial_mapping && !state.spatial_ingest.start() )
+            spatial_mapping = false;
+        if( scene_editing && !state.scene_edits.start() )
+            scene_editing = false;
 
 
         if( outfile.empty() )
@@ -1620,21 +3584,50 @@ int main( int argc, char* argv[] )
                 std::chrono::duration<double> render_time( 0.0 );
                 std::chrono::duration<double> display_time( 0.0 );
                 std::chrono::duration<double> save_time(0.0);
+                std::chrono::duration<double> postprocess_time(0.0);
+                bool converged_frame_saved = false;
+
+                // With --watch, edits to the scene, camera included, arrive as reloads instead of the lookat poll
+                FileWatcher scene_watcher;
+                if( watch_scene )
+                {
+                    scene_watcher.watch( sceneFiles( scene_file ) );
+                    std::cout << "Watching " << scene_file << " and " << scene.dependencies.size() << " OBJ and MTL files"
+                              << ( scene_watcher.usesInotify() ? "" : " (polling)" ) << std::endl;
+                }
+                uint64_t frame_index = 0;  // frames shown so far, scene edits are acknowledged with the one they appear in
                 do
                 {
-                    float3 curr_lookat = readCameraFile(scene_file);
-                    float3 diff = curr_lookat - prev_lookat;
-                    if (diff.x * diff.x + diff.y * diff.y + diff.z * diff.z >= 1)
+                    if( watch_scene )
+                    {
+                        if( scene_watcher.poll() )
+                        {
+                            reloadScene( state, scene_file );
+                            scene_watcher.watch( sceneFiles( scene_file ) );
+                        }
+                    }
+                    else
                     {
-                        std::cout << "camera changed!" << std::endl;
-                        trackball.setViewMode(sutil::Trackball::EyeFixed);
-                        camera.setLookat(curr_lookat);
-                        camera_changed = true;
-                        prev_lookat = curr_lookat;
+                        float3 curr_lookat = readCameraFile(scene_file);
+                        float3 diff = curr_lookat - prev_lookat;
+                        if (diff.x * diff.x + diff.y * diff.y + diff.z * diff.z >= 1)
+                        {
+                            std::cout << "camera changed!" << std::endl;
+                            trackball.setViewMode(sutil::Trackball::EyeFixed);
+                            camera.setLookat(curr_lookat);
+                            camera_changed = true;
+                            prev_lookat = curr_lookat;
+                        }
                     }
 
                     auto t0 = std::chrono::steady_clock::now();
                     glfwPollEvents();
+                    if( animate_dynamic )
+                        animateDynamicMeshes( state, static_cast<float>( glfwGetTime() ) );
+                    if( spatial_mapping )
+                        applySpatialUpdates( state );
+                    if( scene_editing )
+                        applySceneEdits( state, frame_index );
 
                     updateState( output_buffer, state.params );
                     auto t1 = std::chrono::steady_clock::now();
@@ -1658,26 +3651,48 @@ int main( int argc, char* argv[] )
                         saveRequestedQuarter = false;
                         std::cout << "4-way split elapsed time: " << timer().getCpuElapsedTimeForPreviousOperation() << " ms" << std::endl;
                     }
-                    else {
+                    else if (!image_converged || !converged_frame_saved) {
                         sutil::saveImage(outfile.c_str(), buffer, false);
+                        converged_frame_saved = image_converged;
                     }
                     t1 = std::chrono::steady_clock::now();
                     save_time += t1 - t0;
                     t0 = t1;
-                    launchSubframe(output_buffer, state);
-                    t1 = std::chrono::steady_clock::now();
-                    render_time += t1 - t0;
-                    t0 = t1;
+
+                    // Once every pixel converged the frame does not change anymore - idle until the camera moves,
+                    // unless texture tiles are still being read: only a launch maps them
+                    const bool launched = !image_converged || state.textures.loading();
+                    if (launched) {
+                        launchSubframe(output_buffer, state);
+                        t1 = std::chrono::steady_clock::now();
+                        render_time += t1 - t0;
+                        t0 = t1;
+
+                        if (state.params.indirect_scale > 1) {
+                            compositeSubframe(output_buffer, state);
+                            t1 = std::chrono::steady_clock::now();
+                            postprocess_time += t1 - t0;
+                            t0 = t1;
+                        }
+                        else if (denoise) {
+                            denoiseSubframe(output_buffer, state);
+                            t1 = std::chrono::steady_clock::now();
+                            postprocess_time += t1 - t0;
+                            t0 = t1;
+                        }
+                    }
 
                     displaySubframe(output_buffer, gl_display, window);
                     t1 = std::chrono::steady_clock::now();
                     display_time += t1 - t0;
 
-                    sutil::displayStats( state_update_time, render_time, display_time, save_time );
+                    sutil::displayStats( state_update_time, render_time, display_time, save_time, postprocess_time );
 
                     glfwSwapBuffers( window );
 
-                    ++state.params.subframe_index;
+                    if (launched)
+                        ++state.params.subframe_index;
+                    ++frame_index;
                 } while( !glfwWindowShouldClose( window ));
                 CUDA_SYNC_CHECK();
             }
@@ -1702,6 +3717,31 @@ int main( int argc, char* argv[] )
             handleResize( output_buffer, state.params );
             launchSubframe( output_buffer, state );
 
+            // Launch again while texture tiles are still arriving, the image is saved once they are resident.
+            // Launches that would map nothing new wait for the loader threads instead of spinning. A reader
+            // that never finishes, or tiles that keep coming, hold the image back for 16 passes or 30 s at most.
+            const int  max_texture_passes = 16;
+            const auto texture_deadline   = std::chrono::steady_clock::now() + std::chrono::seconds( 30 );
+            int        pass               = 0;
+            bool       textures_pending   = textures_changed || state.textures.loading();
+            while( textures_pending && pass < max_texture_passes && std::chrono::steady_clock::now() < texture_deadline )
+            {
+                if( textures_changed )
+                    ++pass;
+                else
+                    std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+                updateState( output_buffer, state.params );
+                launchSubframe( output_buffer, state );
+                textures_pending = textures_changed || state.textures.loading();
+            }
+            if( textures_pending )
+                std::cerr << "Warning: saving " << outfile << " with texture tiles still loading after " << pass
+                          << " passes" << std::endl;
+            if( state.params.indirect_scale > 1 )
+                compositeSubframe( output_buffer, state );
+            else if( denoise )
+                denoiseSubframe( output_buffer, state );
+
             sutil::ImageBuffer buffer;
             buffer.data         = output_buffer.getHostPointer();
             buffer.width        = output_buffer.width();
@@ -1716,6 +3756,8 @@ int main( int argc, char* argv[] )
             }
         }
 
+        state.spatial_ingest.stop();
+        state.scene_edits.stop();
         cleanupState( state );
     }
     catch( std::exception& e )
@@ -33,6 +33,8 @@
 #include <sutil/vec_math.h>
 #include <cuda/helpers.h>
 
+#include <DemandLoading/Tex2D.h>
+
 #define TWO_PI            6.2831853071795864769252867665590057683943f
 #define EPSILON           0.00001f
 
@@ -59,8 +61,17 @@ struct RadiancePRD
     unsigned int seed;
     int          countEmitted;
     int          done;
-    int          pad;
+    float        path_length;   // distance travelled up to the current ray origin, widens texture footprints
     bool         hitLight;
+
+    // First-hit AOVs, written by the closest-hit and miss programs
+    float3       hit_albedo;
+    float3       hit_normal;
+    float        hit_distance;
+    unsigned int hit_material;
+    unsigned int hit_primitive;
+    float2       hit_texcoord;
+    float        hit_footprint;
 };
 
 
@@ -289,160 +300,87 @@ static __forceinline__ __device__ bool traceOcclusion(
 }
 
 
-//------------------------------------------------------------------------------
-//
-//
-//
-//------------------------------------------------------------------------------
-
-extern "C" __global__ void __raygen__rg()
-{
-    const int    w   = params.width;
-    const int    h   = params.height;
-    const float3 eye = params.eye;
-    const float3 U   = params.U;
-    const float3 V   = params.V;
-    const float3 W   = params.W;
-    const uint3  idx = optixGetLaunchIndex();
-    const int    subframe_index = params.subframe_index;
-
-    unsigned int seed = tea<4>( idx.y*w + idx.x, subframe_index );
-
-    float3 result = make_float3( 0.0f );
-    int i = params.samples_per_launch;
-    do
-    {
-        // The center of each pixel is at fraction (0.5,0.5)
-        const float2 subpixel_jitter = make_float2( rnd( seed ), rnd( seed ) );
-
-        const float2 d = 2.0f * make_float2(
-                ( static_cast<float>( idx.x ) + subpixel_jitter.x ) / static_cast<float>( w ),
-                ( static_cast<float>( idx.y ) + subpixel_jitter.y ) / static_cast<float>( h )
-                ) - 1.0f;
-        float3 ray_direction = normalize(d.x*U + d.y*V + W);
-        float3 ray_origin    = eye;
-
-        RadiancePRD prd;
-        prd.emitted      = make_float3(0.f);
-        prd.radiance     = make_float3(0.f);
-        prd.attenuation  = make_float3(1.f);
-        prd.countEmitted = true;
-        prd.done         = false;
-        prd.seed         = seed;
-        prd.hitLight     = false;
-
-        int depth = 0;
-        for( ;; )
-        {
-            traceRadiance(
-                    params.handle,
-                    ray_origin,
-                    ray_direction,
-                    0.01f,  // tmin       // TODO: smarter offset
-                    1e16f,  // tmax
-                    &prd );
-
-            result += prd.emitted;
-            result += prd.radiance * prd.attenuation;
-
-            if( depth >= params.depth || prd.hitLight) // Stop tracing if a certain depth is reached or a light source is hit
-                break;
-
-            // If the ray did not intersect anything we want to set the total ray accumulation to zero
-            if (prd.done) {
-                result = make_float3(0.f);
-                break;
-            }
-
-            ray_origin    = prd.origin;
-            ray_direction = prd.direction;
-
-            // Apply Russian Roulette
-            if (depth > 2) {
-                // find max component of attenuation
-                float maxComp = 0.f;
-                if (prd.attenuation.x > prd.attenuation.y) {
-                    if (prd.attenuation.x > prd.attenuation.z)
-                        maxComp = prd.attenuation.x;
-                    else
-                        maxComp = prd.attenuation.z;
-                }
-                else {
-                    if (prd.attenuation.y > prd.attenuation.z)
-                        maxComp = prd.attenuation.y;
-                    else
-                        maxComp = prd.attenuation.z;
-                }
-                float r = rnd(prd.seed);
-                if (r > maxComp)
-                    break;
-                prd.attenuation /= maxComp;
-            }
-            ++depth;
-        }
-    }
-    while( --i );
-
-    const uint3    launch_index = optixGetLaunchIndex();
-    const unsigned int image_index  = launch_index.y * params.width + launch_index.x;
-    float3         accum_color  = result / static_cast<float>( params.samples_per_launch );
-
-    if( subframe_index > 0 )
-    {
-        const float                 a = 1.0f / static_cast<float>( subframe_index+1 );
-        const float3 accum_color_prev = make_float3( params.accum_buffer[ image_index ]);
-        accum_color = lerp( accum_color_prev, accum_color, a );
-    }
-    params.accum_buffer[ image_index ] = make_float4( accum_color, 1.0f);
-    params.frame_buffer[ image_index ] = make_color ( accum_color );
-}
-
-
-extern "C" __global__ void __miss__radiance()
-{
-    MissData* rt_data  = reinterpret_cast<MissData*>( optixGetSbtDataPointer() );
-    RadiancePRD* prd = getPRD();
-
-    prd->radiance = make_float3( rt_data->bg_color );
-    prd->done      = true;
-}
-
-
-extern "C" __global__ void __closesthit__occlusion()
+/*
+    Sample a demand loaded material texture with a square filter footprint in texture space. A missing
+    tile is requested by the lookup and filled in before the next launch; until then the coarse levels
+    of the mip tail, or the material color if the texture is not initialized yet, stand in for it.
+*/
+static __forceinline__ __device__ float3 sampleMaterialTexture(
+        int           texture_id,
+        const float2& uv,
+        float         footprint,
+        const float3& fallback
+        )
 {
-    setPayloadOcclusion( true );
+    const demandLoading::DemandTextureContext& context = params.demand_textures;
+
+    // OBJ texture coordinates have v pointing up, texture rows go down
+    const float s = uv.x;
+    const float t = 1.0f - uv.y;
+
+    bool   resident = false;
+    float4 texel    = demandLoading::tex2DGrad<float4>( context, texture_id, s, t, make_float2( footprint, 0.0f ),
+                                                        make_float2( 0.0f, footprint ), &resident );
+    if( resident )
+        return make_float3( texel );
+
+    const demandLoading::DemandTextureInfo& info = context.m_textureInfos[texture_id];
+    if( !info.isInitialized )
+        return fallback;
+    const unsigned int tail_level = min( static_cast<unsigned int>( info.mipTailFirstLevel ), info.mipLevels - 1u );
+    texel = demandLoading::tex2DLod<float4>( context, texture_id, s, t, static_cast<float>( tail_level ), &resident );
+    return resident ? make_float3( texel ) : fallback;
 }
 
 
-extern "C" __global__ void __closesthit__radiance()
+/*
+    Shade the hit point P with facing normal N: record the first-hit AOVs, sample the next path direction
+    and add one light sample. Shared by the closest-hit program and by raygen for cached primary hits.
+    footprint is the texture space filter width at uv, negative for hits without texture coordinates.
+*/
+static __forceinline__ __device__ void shadeHit(
+        RadiancePRD*        prd,
+        unsigned int        material_id,
+        const float3&       P,
+        const float3&       N,
+        const float3&       ray_dir,
+        float               hit_distance,
+        unsigned int        prim_idx,
+        const float2&       uv,
+        float               footprint
+        )
 {
-    HitGroupData* rt_data = (HitGroupData*)optixGetSbtDataPointer();
-
-    const int    prim_idx        = optixGetPrimitiveIndex();
-    const float3 ray_dir         = optixGetWorldRayDirection();
-    const int    vert_idx_offset = prim_idx*3;
-
-    const Material mat = rt_data->mat; // material
-    const float3 P = optixGetWorldRayOrigin() + optixGetRayTmax() * ray_dir; // this is the intersection point!
-    const float3 v0 = make_float3(rt_data->vertices[vert_idx_offset + 0]);
-    const float3 v1 = make_float3(rt_data->vertices[vert_idx_offset + 1]);
-    const float3 v2 = make_float3(rt_data->vertices[vert_idx_offset + 2]);
-
-    const float3 N_0 = normalize(cross(v1 - v0, v2 - v0));
+    const MaterialData* material = &params.materials[material_id];
+    const Material      mat      = material->mat;
 
-    const float3 N    = faceforward( N_0, -ray_dir, N_0 );
+    float3 diffuse_color  = material->diffuse_color;
+    float3 specular_color = material->specular_color;
+    if( footprint >= 0.0f )
+    {
+        if( material->diffuse_texture != NO_TEXTURE )
+            diffuse_color = sampleMaterialTexture( material->diffuse_texture, uv, footprint, diffuse_color );
+        if( material->specular_texture != NO_TEXTURE )
+            specular_color = sampleMaterialTexture( material->specular_texture, uv, footprint, specular_color );
+    }
 
-    RadiancePRD* prd = getPRD();
+    prd->hit_albedo    = ( mat == GLOSSY || mat == MIRROR || mat == FRESNEL ) ? specular_color : diffuse_color;
+    prd->hit_normal    = N;
+    prd->hit_distance  = hit_distance;
+    prd->hit_material  = material_id;
+    prd->hit_primitive = prim_idx;
+    prd->hit_texcoord  = uv;
+    prd->hit_footprint = footprint;
+    prd->path_length  += hit_distance;
 
     if( prd->countEmitted )
-        prd->emitted = rt_data->emission_color;
+        prd->emitted = material->emission_color;
     else
         prd->emitted = make_float3( 0.0f );
 
     // Return if a light source is hit
     if (mat == EMISSIVE) {
         prd->hitLight = true;
-        prd->radiance += rt_data->emission_color;
+        prd->radiance += material->emission_color;
         return;
     }
 
@@ -453,16 +391,16 @@ extern "C" __global__ void __closesthit__radiance()
         const float z2 = rnd(seed);
 
         float3 w_in = make_float3(ray_dir.x, ray_dir.y, ray_dir.z);
-        computeNewDirection(z1, z2, rt_data->ior, rt_data->spec_exp, w_in, mat, N);
+        computeNewDirection(z1, z2, material->ior, material->spec_exp, w_in, mat, N);
         prd->direction = w_in;
         prd->origin    = P + prd->direction * EPSILON;
 
         // Update attenuation with brdf sample
         if (mat == GLOSSY || mat == MIRROR || mat == FRESNEL) {
-            prd->attenuation *= (rt_data->specular_color);
+            prd->attenuation *= specular_color;
         }
         else {
-            prd->attenuation *= (rt_data->diffuse_color);
+            prd->attenuation *= diffuse_color;
         }
         prd->countEmitted = false;
     }
@@ -480,7 +418,7 @@ extern "C" __global__ void __closesthit__radiance()
         if (dist <= 0.01f) {
             // too close to point light -> consider this as intersection with the point light
             prd->hitLight = true;
-            prd->radiance += rt_data->emission_color;
+            prd->radiance += material->emission_color;
             return;
         }
         const float3 L = normalize(light.corner - P);
@@ -512,7 +450,7 @@ extern "C" __global__ void __closesthit__radiance()
         if (dist <= 0.01f) {
             // too close to spot light -> consider this as intersection with the spot light
             prd->hitLight = true;
-            prd->radiance += rt_data->emission_color;
+            prd->radiance += material->emission_color;
             return;
         }
         float3 L = normalize(light.corner - P);
@@ -582,3 +520,372 @@ extern "C" __global__ void __closesthit__radiance()
         prd->radiance += (light.emission * weight);
     }
 }
+
+
+//------------------------------------------------------------------------------
+//
+//
+//
+//------------------------------------------------------------------------------
+
+extern "C" __global__ void __raygen__rg()
+{
+    const int    w   = params.width;
+    const int    h   = params.height;
+    const float3 eye = params.eye;
+    const float3 U   = params.U;
+    const float3 V   = params.V;
+    const float3 W   = params.W;
+    const uint3  launch_idx = optixGetLaunchIndex();
+    const int    subframe_index = params.subframe_index;
+
+    // The indirect pass of decoupled shading covers the image with scale x scale pixel blocks
+    const unsigned int scale        = params.indirect_pass ? params.indirect_scale : 1u;
+    const unsigned int launch_width = ( params.width + scale - 1 ) / scale;
+
+    // Adaptive launches are 1D over the list of pixels that have not converged yet
+    const unsigned int image_index = params.num_active_pixels > 0
+                                   ? params.active_pixels[ launch_idx.x ]
+                                   : launch_idx.y * launch_width + launch_idx.x;
+    const uint2        idx         = make_uint2( image_index % launch_width, image_index / launch_width );
+
+    // Resolve pass after a camera move: every pixel of the previous launch has written its color, clamp
+    // the reprojected history to the colors around the pixel and blend this launch's color into it
+    if( params.resolve_pass )
+    {
+        float4 history = params.accum_buffer[ image_index ];
+        if( history.w > 0.0f && params.reprojection.clamp_history )
+            history = make_float4( clampToNeighborhood( make_float3( history ), params.launch_buffer, idx.x, idx.y, w, h ), history.w );
+
+        const float4 accum = accumulateLaunch( history, make_float3( params.launch_buffer[ image_index ] ) );
+        params.accum_buffer[ image_index ] = accum;
+        params.frame_buffer[ image_index ] = make_color( make_float3( accum ) );
+        return;
+    }
+
+    unsigned int seed = tea<4>( params.indirect_pass ? image_index + params.width * params.height : image_index, subframe_index );
+
+    // Decoupled shading: the full resolution pass stops after direct lighting at the first hit
+    const unsigned int max_depth = params.indirect_scale > 1 && !params.indirect_pass ? 0u : params.depth;
+
+    float3 result = make_float3( 0.0f );
+    float3 albedo = make_float3( 0.0f );
+    float3 normal = make_float3( 0.0f );
+    float  hit_distance = 0.0f;
+    int    num_hits = 0;
+    int i = params.samples_per_launch;
+    do
+    {
+        // The center of each pixel is at fraction (0.5,0.5)
+        // With the primary hit cache enabled sample s of a pixel always uses the same jitter
+        const unsigned int sample_index = params.samples_per_launch - i;
+        unsigned int       jitter_seed  = tea<4>( image_index, sample_index );
+        const float2 subpixel_jitter = params.cache_primary_hits
+                                     ? make_float2( rnd( jitter_seed ), rnd( jitter_seed ) )
+                                     : make_float2( rnd( seed ), rnd( seed ) );
+
+        const float2 d = 2.0f * make_float2(
+                fminf( ( static_cast<float>( idx.x ) + subpixel_jitter.x ) * scale, static_cast<float>( w ) ) / static_cast<float>( w ),
+                fminf( ( static_cast<float>( idx.y ) + subpixel_jitter.y ) * scale, static_cast<float>( h ) ) / static_cast<float>( h )
+                ) - 1.0f;
+        float3 ray_direction = normalize(d.x*U + d.y*V + W);
+        float3 ray_origin    = eye;
+
+        RadiancePRD prd;
+        prd.emitted      = make_float3(0.f);
+        prd.radiance     = make_float3(0.f);
+        prd.attenuation  = make_float3(1.f);
+        prd.countEmitted = true;
+        prd.done         = false;
+        prd.seed         = seed;
+        prd.hitLight     = false;
+        prd.path_length  = 0.0f;
+
+        PrimaryHit* primary_hit = params.cache_primary_hits && !params.indirect_pass
+                                ? &params.primary_hits[ static_cast<size_t>( image_index ) * params.samples_per_launch + sample_index ]
+                                : 0;
+
+        float3 sample_indirect = make_float3( 0.0f );  // bounces after the first hit, indirect pass only
+        float3 first_albedo    = make_float3( 0.0f );
+
+        int depth = 0;
+        for( ;; )
+        {
+            if( depth == 0 && primary_hit && params.primary_hits_valid )
+            {
+                // Start the path from the cached first hit instead of tracing the primary ray
+                const PrimaryHit hit = *primary_hit;
+                if( hit.material_id == PRIMARY_HIT_MISS )
+                {
+                    prd.radiance     = hit.position;
+                    prd.done         = true;
+                    prd.hit_albedo   = make_float3( 0.0f );
+                    prd.hit_normal   = make_float3( 0.0f );
+                    prd.hit_distance = 0.0f;
+                }
+                else
+                {
+                    shadeHit( &prd, hit.material_id, hit.position, hit.normal, ray_direction,
+                              length( hit.position - ray_origin ), hit.primitive_id, hit.texcoord, hit.footprint );
+                }
+            }
+            else
+            {
+                traceRadiance(
+                        params.handle,
+                        ray_origin,
+                        ray_direction,
+                        0.01f,  // tmin       // TODO: smarter offset
+                        1e16f,  // tmax
+                        &prd );
+
+                if( depth == 0 && primary_hit )
+                {
+                    PrimaryHit hit;
+                    hit.material_id  = prd.hit_material;
+                    hit.primitive_id = prd.hit_primitive;
+                    hit.normal       = prd.hit_normal;
+                    hit.texcoord     = prd.hit_texcoord;
+                    hit.footprint    = prd.hit_footprint;
+                    hit.position     = prd.hit_material == PRIMARY_HIT_MISS
+                                     ? prd.radiance
+                                     : ray_origin + prd.hit_distance * ray_direction;
+                    *primary_hit = hit;
+                }
+            }
+
+            if( !params.indirect_pass )
+            {
+                result += prd.emitted;
+                result += prd.radiance * prd.attenuation;
+            }
+            else if( depth > 0 )
+            {
+                sample_indirect += prd.emitted;
+                sample_indirect += prd.radiance * prd.attenuation;
+            }
+
+            if( depth == 0 )
+            {
+                first_albedo  = prd.hit_albedo;
+                albedo       += prd.hit_albedo;
+                normal       += prd.hit_normal;
+                hit_distance += prd.hit_distance;
+                num_hits     += prd.hit_distance > 0.0f ? 1 : 0;
+            }
+
+            if( depth >= max_depth || prd.hitLight) // Stop tracing if a certain depth is reached or a light source is hit
+                break;
+
+            // If the ray did not intersect anything we want to set the total ray accumulation to zero
+            if (prd.done) {
+                result          = make_float3(0.f);
+                sample_indirect = make_float3(0.f);
+                break;
+            }
+
+            ray_origin    = prd.origin;
+            ray_direction = prd.direction;
+
+            // Apply Russian Roulette
+            if (depth > 2) {
+                // find max component of attenuation
+                float maxComp = 0.f;
+                if (prd.attenuation.x > prd.attenuation.y) {
+                    if (prd.attenuation.x > prd.attenuation.z)
+                        maxComp = prd.attenuation.x;
+                    else
+                        maxComp = prd.attenuation.z;
+                }
+                else {
+                    if (prd.attenuation.y > prd.attenuation.z)
+                        maxComp = prd.attenuation.y;
+                    else
+                        maxComp = prd.attenuation.z;
+                }
+                float r = rnd(prd.seed);
+                if (r > maxComp)
+                    break;
+                prd.attenuation /= maxComp;
+            }
+            ++depth;
+        }
+
+        // Indirect light is stored demodulated by the first-hit albedo and remodulated at full resolution
+        if( params.indirect_pass )
+            result += sample_indirect / fmaxf( first_albedo, make_float3( 1e-3f ) );
+    }
+    while( --i );
+
+    if( params.indirect_pass )
+    {
+        // Accumulate the low resolution indirect light and the guide the upsampler compares against.
+        // A camera move restarts the indirect accumulation.
+        const float4 prev_indirect = params.indirect_buffer[ image_index ];
+        const float  history       = subframe_index > 0 && !params.camera_moved ? prev_indirect.w : 0.0f;
+        const float  a             = 1.0f / ( history + 1.0f );
+
+        float3 accum_indirect = result / static_cast<float>( params.samples_per_launch );
+        float4 guide          = make_float4(
+                normal / static_cast<float>( params.samples_per_launch ),
+                num_hits > 0 ? hit_distance / static_cast<float>( num_hits ) : 0.0f );
+        if( history > 0.0f )
+        {
+            accum_indirect = lerp( make_float3( prev_indirect ), accum_indirect, a );
+            guide          = lerp( params.indirect_guide[ image_index ], guide, a );
+        }
+        params.indirect_buffer[ image_index ] = make_float4( accum_indirect, history + 1.0f );
+        params.indirect_guide[ image_index ]  = guide;
+        return;
+    }
+
+    const float3   launch_color = result / static_cast<float>( params.samples_per_launch );
+    float4         accum        = make_float4( launch_color, 1.0f );
+    float3         accum_albedo = albedo / static_cast<float>( params.samples_per_launch );
+    float3         accum_normal = normal / static_cast<float>( params.samples_per_launch );
+    float          accum_depth  = num_hits > 0 ? hit_distance / static_cast<float>( num_hits ) : 0.0f;
+    const bool     reprojected  = subframe_index > 0 && params.camera_moved;
+
+    if( reprojected )
+    {
+        // Reproject the previous accumulation through the first hit along the pixel center
+        accum = make_float4( 0.0f );
+        if( accum_depth > 0.0f )
+        {
+            const float2 d = 2.0f * make_float2(
+                    ( static_cast<float>( idx.x ) + 0.5f ) / static_cast<float>( w ),
+                    ( static_cast<float>( idx.y ) + 0.5f ) / static_cast<float>( h )
+                    ) - 1.0f;
+            const float3 P = eye + normalize( d.x*U + d.y*V + W ) * accum_depth;
+            accum = reprojectHistory(
+                    P, accum_normal,
+                    params.prev_accum_buffer, params.prev_normal_buffer, params.prev_depth_buffer,
+                    params.width, params.height,
+                    params.prev_eye, params.prev_U, params.prev_V, params.prev_W,
+                    params.reprojection );
+        }
+        // The resolve pass blends this launch in once the colors of the neighbors are known
+        params.launch_buffer[ image_index ] = make_float4( launch_color, 0.0f );
+    }
+    else if( subframe_index > 0 )
+    {
+        // Static camera - the buffers were not swapped, accumulate in place
+        accum = accumulateLaunch( params.accum_buffer[ image_index ], launch_color );
+
+        const float a = 1.0f / accum.w;
+        accum_albedo = lerp( make_float3( params.albedo_buffer[ image_index ] ), accum_albedo, a );
+        accum_normal = lerp( make_float3( params.normal_buffer[ image_index ] ), accum_normal, a );
+        accum_depth  = lerp( params.depth_buffer[ image_index ], accum_depth, a );
+    }
+    params.accum_buffer[ image_index ]  = accum;
+    params.albedo_buffer[ image_index ] = make_float4( accum_albedo, 1.0f );
+    params.normal_buffer[ image_index ] = make_float4( accum_normal, 0.0f );
+    params.depth_buffer[ image_index ]  = accum_depth;
+    if( !reprojected )
+        params.frame_buffer[ image_index ] = make_color( make_float3( accum ) );
+
+    if( params.adaptive_sampling )
+    {
+        // Moments restart whenever the accumulation was restarted or reprojected
+        const bool   restart = subframe_index == 0 || params.camera_moved;
+        const float4 moments = updateMoments( params.moment_buffer[ image_index ], pixelLuminance( launch_color ), restart );
+        params.moment_buffer[ image_index ] = moments;
+
+        const bool converged = pixelConverged( moments, params.adaptive );
+        params.convergence_mask[ image_index ] = converged ? 1 : 0;
+        if( !converged )
+            params.next_active_pixels[ atomicAdd( params.num_next_active_pixels, 1u ) ] = image_index;
+    }
+}
+
+
+extern "C" __global__ void __miss__radiance()
+{
+    MissData* rt_data  = reinterpret_cast<MissData*>( optixGetSbtDataPointer() );
+    RadiancePRD* prd = getPRD();
+
+    prd->radiance = make_float3( rt_data->bg_color );
+    prd->done      = true;
+
+    prd->hit_albedo   = make_float3( 0.0f );
+    prd->hit_normal   = make_float3( 0.0f );
+    prd->hit_distance = 0.0f;
+    prd->hit_material = PRIMARY_HIT_MISS;
+    prd->hit_footprint = -1.0f;
+}
+
+
+extern "C" __global__ void __closesthit__occlusion()
+{
+    setPayloadOcclusion( true );
+}
+
+
+// The analytic intersection programs run in object space and report the object space normal as attributes
+static __forceinline__ __device__ void reportCustomHit( float t, const float3& normal )
+{
+    optixReportIntersection( t, 0, __float_as_uint( normal.x ), __float_as_uint( normal.y ), __float_as_uint( normal.z ) );
+}
+
+
+extern "C" __global__ void __intersection__sphere()
+{
+    const Sphere& sphere = params.geometries[optixGetInstanceId()].spheres[optixGetPrimitiveIndex()];
+
+    float  t;
+    float3 normal;
+    if( intersectSphere( sphere, optixGetObjectRayOrigin(), optixGetObjectRayDirection(), optixGetRayTmin(), optixGetRayTmax(), t, normal ) )
+        reportCustomHit( t, normal );
+}
+
+
+extern "C" __global__ void __intersection__parallelogram()
+{
+    const Parallelogram& parallelogram = params.geometries[optixGetInstanceId()].parallelograms[optixGetPrimitiveIndex()];
+
+    float  t;
+    float3 normal;
+    if( intersectParallelogram( parallelogram, optixGetObjectRayOrigin(), optixGetObjectRayDirection(), optixGetRayTmin(), optixGetRayTmax(), t, normal ) )
+        reportCustomHit( t, normal );
+}
+
+
+extern "C" __global__ void __closesthit__radiance()
+{
+    const GeometryData& geometry = params.geometries[optixGetInstanceId()];
+
+    const int          prim_idx    = optixGetPrimitiveIndex();
+    const float3       ray_dir     = optixGetWorldRayDirection();
+    const unsigned int material_id = geometry.material_ids ? geometry.material_ids[prim_idx] : geometry.material_id;
+
+    const float3 P = optixGetWorldRayOrigin() + optixGetRayTmax() * ray_dir; // this is the intersection point!
+    // Normals are in object space, stored once per mesh for triangles and computed by the intersection
+    // program for analytic primitives
+    float3 N_object;
+    if( optixIsTriangleHit() )
+        N_object = decodeOctahedral( geometry.normals[prim_idx] );
+    else
+        N_object = make_float3( __uint_as_float( optixGetAttribute_0() ), __uint_as_float( optixGetAttribute_1() ),
+                                __uint_as_float( optixGetAttribute_2() ) );
+    const float3 N_0 = normalize( optixTransformNormalFromObjectToWorldSpace( N_object ) );
+
+    const float3 N    = faceforward( N_0, -ray_dir, N_0 );
+
+    RadiancePRD* prd = getPRD();
+
+    // Interpolate the texture coordinate and estimate the texture space footprint of the ray cone
+    // from the pixel spread angle, the distance travelled and the incidence angle
+    float2 uv        = make_float2( 0.0f );
+    float  footprint = -1.0f;
+    if( geometry.texcoords && optixIsTriangleHit() )
+    {
+        const TriangleTexcoords& tc = geometry.texcoords[prim_idx];
+        const float2             b  = optixGetTriangleBarycentrics();
+        uv = ( 1.0f - b.x - b.y ) * tc.uv[0] + b.x * tc.uv[1] + b.y * tc.uv[2];
+
+        const float cone_width = params.pixel_spread * ( prd->path_length + optixGetRayTmax() );
+        footprint = cone_width * tc.uv_scale / fmaxf( fabsf( dot( N, ray_dir ) ), 0.1f );
+    }
+
+    shadeHit( prd, material_id, P, N, ray_dir, optixGetRayTmax(), prim_idx, uv, footprint );
+}
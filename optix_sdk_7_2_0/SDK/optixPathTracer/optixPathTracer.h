@@ -25,9 +25,17 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
+#pragma once
+
 //#include "gdt/gdt/math/AffineSpace.h"
 //#include <vector>
 //using namespace gdt;
+#include "AdaptiveSampling.h"
+#include "AnalyticPrimitives.h"
+#include "Reprojection.h"
+#include "VertexCompression.h"
+
+#include <DemandLoading/DemandTextureContext.h>
 
 /*
 *   Enumerators for path tracing
@@ -72,10 +80,87 @@ struct Light
     float falloff_start; // used for spot lights
 };
 
+/*
+*   Cached first hit of one primary ray, see Params::primary_hits
+*/
+#define PRIMARY_HIT_MISS 0xffffffffu
+
+struct PrimaryHit
+{
+    float3       position;      // hit point, or the radiance returned by the miss program on a miss
+    float3       normal;        // geometric normal facing the ray
+    unsigned int material_id;   // index into Params::materials, PRIMARY_HIT_MISS on a miss
+    unsigned int primitive_id;
+    float2       texcoord;      // interpolated texture coordinate of a textured triangle
+    float        footprint;     // texture space width of the pixel footprint, see Params::pixel_spread
+};
+
+/*
+*   Primitive type of a mesh. The hit group records are laid out as RAY_TYPE_COUNT records per type,
+*   since custom primitives need their intersection program in the hit group; an instance selects its
+*   records through its sbtOffset. Materials are not in the SBT, see MaterialData.
+*/
+enum GeometryType
+{
+    GEOMETRY_TRIANGLES      = 0,
+    GEOMETRY_SPHERES        = 1,
+    GEOMETRY_PARALLELOGRAMS = 2,
+    GEOMETRY_TYPE_COUNT
+};
+
+/*
+*   Texture coordinates of one triangle. uv_scale is the ratio of texture space to object space edge
+*   lengths, sqrt( uv area / object area ), precomputed to turn a world space ray footprint into a
+*   texture space filter width.
+*/
+struct TriangleTexcoords
+{
+    float2 uv[3];
+    float  uv_scale;
+};
+
+/*
+*   Per-mesh data looked up by the hit programs through optixGetInstanceId()
+*/
+struct GeometryData
+{
+    const unsigned int*  normals;         // triangles: octahedral object space geometric normal per triangle, see VertexCompression.h
+    const Sphere*        spheres;         // spheres: one per primitive, object space
+    const Parallelogram* parallelograms;  // parallelograms: one per primitive, object space
+    const unsigned int*  material_ids;    // material id per primitive, nullptr if all of them use material_id
+    const TriangleTexcoords* texcoords;   // triangles: per primitive, nullptr for untextured meshes
+    unsigned int         material_id;
+};
+
+/*
+*   Shading parameters of one material, looked up in Params::materials by the material id of the hit
+*   primitive. The SBT does not grow with the material count and a material edit rewrites one entry.
+*   Texture ids index Params::demand_textures and replace the matching color where present.
+*/
+#define NO_TEXTURE -1
+
+struct MaterialData
+{
+    float3   emission_color;
+    float3   diffuse_color;
+    float3   specular_color;
+    float    spec_exp;
+    float    ior;
+    Material mat;
+    int      diffuse_texture;     // demand texture id, NO_TEXTURE for none
+    int      specular_texture;    // demand texture id, NO_TEXTURE for none
+};
+
 struct Params
 {
     unsigned int subframe_index;
-    float4*      accum_buffer;
+    float4*      accum_buffer;        // running mean in rgb, history length in w
+    float4*      albedo_buffer;       // first-hit albedo AOV
+    float4*      normal_buffer;       // first-hit world space normal AOV
+    float*       depth_buffer;        // first-hit distance along the primary ray AOV, 0 on miss
+    float4*      prev_accum_buffer;   // previous launch's accum_buffer (ping-pong)
+    float4*      prev_normal_buffer;  // previous launch's normal_buffer (ping-pong)
+    float*       prev_depth_buffer;   // previous launch's depth_buffer (ping-pong)
     uchar4*      frame_buffer;
     unsigned int width;
     unsigned int height;
@@ -88,7 +173,47 @@ struct Params
     float3       V;
     float3       W;
 
+    // Temporal reprojection
+    unsigned int camera_moved;        // the camera changed since the previous launch
+    float3       prev_eye;
+    float3       prev_U;
+    float3       prev_V;
+    float3       prev_W;
+    ReprojectionSettings reprojection;
+    unsigned int resolve_pass;        // this launch clamps and blends the history reprojected by the previous one
+    float4*      launch_buffer;       // colors of the current launch before accumulation, for the neighborhood clamp
+
+    // Adaptive sampling
+    unsigned int   adaptive_sampling;
+    AdaptiveSamplingSettings adaptive;
+    float4*        moment_buffer;           // running luminance moments per pixel, see AdaptiveSampling.h
+    unsigned char* convergence_mask;        // 1 for pixels that stopped sampling
+    unsigned int*  active_pixels;           // pixels traced by a 1D launch
+    unsigned int   num_active_pixels;       // size of the 1D launch, 0 for a full 2D launch
+    unsigned int*  next_active_pixels;      // non converged pixels, appended to by this launch
+    unsigned int*  num_next_active_pixels;
+
+    // Primary hit cache. While the camera is static every launch uses the same fixed jitter pattern,
+    // so the first hit of sample s of a pixel is traced once and read back from primary_hits afterwards.
+    unsigned int        cache_primary_hits;
+    unsigned int        primary_hits_valid;  // primary_hits holds the hits of the current camera
+    PrimaryHit*         primary_hits;        // samples_per_launch entries per pixel
+    const MaterialData* materials;           // per material id
+
+    // Demand loaded material textures. Only the tiles touched by a launch are requested and the
+    // host makes them resident before the next launch, see DemandTextureManager.
+    demandLoading::DemandTextureContext demand_textures;
+    float                               pixel_spread;  // angle subtended by one pixel, for texture filter widths
+
+    // Decoupled shading rates. With indirect_scale > 1 the full resolution launch only traces primary
+    // visibility and direct lighting, a second launch at 1/indirect_scale resolution traces the bounces.
+    unsigned int indirect_scale;      // 1, 2 or 4
+    unsigned int indirect_pass;       // this launch is the reduced resolution indirect pass
+    float4*      indirect_buffer;     // indirect light demodulated by the first-hit albedo, history length in w
+    float4*      indirect_guide;      // first-hit normal (xyz) and distance (w) of the indirect pass
+
     Light*     lights;
+    const GeometryData* geometries;   // per mesh, indexed by instance id
     OptixTraversableHandle handle;
 };
 
@@ -106,11 +231,4 @@ struct MissData
 
 struct HitGroupData
 {
-    float3  emission_color;
-    float3  diffuse_color;
-    float3  specular_color;
-    float  spec_exp;
-    float  ior;
-    float4* vertices;
-    Material mat;
 };
@@ -0,0 +1,355 @@
+#include "PtxCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined( _WIN32 )
+#    ifndef WIN32_LEAN_AND_MEAN
+#        define WIN32_LEAN_AND_MEAN 1
+#    endif
+#    include <windows.h>
+#    include <direct.h>
+#    include <sys/utime.h>
+#else
+#    include <dirent.h>
+#    include <unistd.h>
+#    include <utime.h>
+#endif
+
+
+namespace sutil
+{
+
+static const char ENTRY_SUFFIX[] = ".ptx";
+
+
+void PtxCacheKey::add( const void* data, size_t size )
+{
+    const unsigned char* p = static_cast<const unsigned char*>( data );
+    for( size_t i = 0; i < size; ++i )
+        m_hash = ( m_hash ^ p[i] ) * 0x100000001B3ull;
+}
+
+
+void PtxCacheKey::add( const std::string& s )
+{
+    const uint64_t length = s.size();
+    add( &length, sizeof( length ) );
+    add( s.data(), s.size() );
+}
+
+
+std::string PtxCacheKey::hex() const
+{
+    char text[17];
+    snprintf( text, sizeof( text ), "%016llx", static_cast<unsigned long long>( m_hash ) );
+    return text;
+}
+
+
+static bool readFile( const std::string& path, std::string& contents )
+{
+    std::ifstream file( path.c_str(), std::ios::binary );
+    if( !file.good() )
+        return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+
+static bool isFile( const std::string& path )
+{
+    struct stat info;
+    return stat( path.c_str(), &info ) == 0 && ( info.st_mode & S_IFMT ) == S_IFREG;
+}
+
+
+static std::string directoryOf( const std::string& path )
+{
+    const size_t slash = path.find_last_of( "/\\" );
+    return slash == std::string::npos ? std::string( "." ) : path.substr( 0, slash );
+}
+
+
+// The name of every #include "name" or #include <name> directive; quoted says which kind it was
+static void includeDirectives( const std::string& source, std::vector<std::pair<std::string, bool> >& includes )
+{
+    std::istringstream lines( source );
+    for( std::string line; std::getline( lines, line ); )
+    {
+        size_t i = line.find_first_not_of( " \t" );
+        if( i == std::string::npos || line[i] != '#' )
+            continue;
+        i = line.find_first_not_of( " \t", i + 1 );
+        if( i == std::string::npos || line.compare( i, 7, "include" ) != 0 )
+            continue;
+        i = line.find_first_not_of( " \t", i + 7 );
+        if( i == std::string::npos || ( line[i] != '"' && line[i] != '<' ) )
+            continue;
+        const char   close = line[i] == '"' ? '"' : '>';
+        const size_t end   = line.find( close, i + 1 );
+        if( end != std::string::npos )
+            includes.push_back( std::make_pair( line.substr( i + 1, end - i - 1 ), close == '"' ) );
+    }
+}
+
+
+static void collectIncludes( const std::string&              source,
+                             const std::string&              source_path,
+                             const std::vector<std::string>& include_dirs,
+                             std::set<std::string>&          visited,
+                             std::vector<std::string>&       files )
+{
+    std::vector<std::pair<std::string, bool> > includes;
+    includeDirectives( source, includes );
+    for( const std::pair<std::string, bool>& include : includes )
+    {
+        std::string path;
+        if( include.second && isFile( directoryOf( source_path ) + '/' + include.first ) )
+            path = directoryOf( source_path ) + '/' + include.first;
+        for( size_t d = 0; path.empty() && d < include_dirs.size(); ++d )
+            if( isFile( include_dirs[d] + '/' + include.first ) )
+                path = include_dirs[d] + '/' + include.first;
+
+        std::string contents;
+        if( path.empty() || !visited.insert( path ).second || !readFile( path, contents ) )
+            continue;
+        files.push_back( path );
+        collectIncludes( contents, path, include_dirs, visited, files );
+    }
+}
+
+
+void collectIncludes( const std::string&              source,
+                      const std::string&              source_path,
+                      const std::vector<std::string>& include_dirs,
+                      std::vector<std::string>&       files )
+{
+    std::set<std::string> visited( files.begin(), files.end() );
+    collectIncludes( source, source_path, include_dirs, visited, files );
+}
+
+
+PtxCacheKey compilationKey( const std::string&              source,
+                            const std::string&              source_path,
+                            const std::vector<std::string>& include_dirs,
+                            const std::vector<std::string>& options )
+{
+    PtxCacheKey key;
+    key.add( source );
+    std::vector<std::string> headers;
+    collectIncludes( source, source_path, include_dirs, headers );
+    for( const std::string& header : headers )
+    {
+        std::string contents;
+        readFile( header, contents );
+        key.add( header );
+        key.add( contents );
+    }
+    for( const std::string& option : options )
+        key.add( option );
+    return key;
+}
+
+
+static bool makeDirectories( const std::string& path )
+{
+    for( size_t i = 1; i <= path.size(); ++i )
+    {
+        if( i < path.size() && path[i] != '/' && path[i] != '\\' )
+            continue;
+        const std::string prefix = path.substr( 0, i );
+#if defined( _WIN32 )
+        if( prefix.size() == 2 && prefix[1] == ':' )
+            continue;  // drive letter
+        _mkdir( prefix.c_str() );
+#else
+        mkdir( prefix.c_str(), 0755 );
+#endif
+    }
+    struct stat info;
+    return stat( path.c_str(), &info ) == 0 && ( info.st_mode & S_IFMT ) == S_IFDIR;
+}
+
+
+// Header line in front of the PTX, checked on load against truncated or foreign files
+static std::string entryHeader( const PtxCacheKey& key, size_t ptx_bytes )
+{
+    return "// sutil ptx cache " + key.hex() + ' ' + std::to_string( static_cast<unsigned long long>( ptx_bytes ) ) + '\n';
+}
+
+
+PtxCache::PtxCache( const std::string& directory, uint64_t max_bytes )
+    : m_directory( directory )
+    , m_max_bytes( max_bytes )
+{
+}
+
+
+std::string PtxCache::entryPath( const PtxCacheKey& key ) const
+{
+    return m_directory + '/' + key.hex() + ENTRY_SUFFIX;
+}
+
+
+bool PtxCache::load( const PtxCacheKey& key, std::string& ptx ) const
+{
+    if( !enabled() )
+        return false;
+
+    const std::string path = entryPath( key );
+    std::string       contents;
+    if( !readFile( path, contents ) )
+        return false;
+    const size_t newline = contents.find( '\n' );
+    if( newline == std::string::npos || contents.compare( 0, newline + 1, entryHeader( key, contents.size() - newline - 1 ) ) != 0 )
+        return false;
+
+    ptx.assign( contents, newline + 1, std::string::npos );
+    utime( path.c_str(), NULL );  // most recently used
+    return true;
+}
+
+
+bool PtxCache::store( const PtxCacheKey& key, const std::string& ptx ) const
+{
+    if( !enabled() || !makeDirectories( m_directory ) )
+        return false;
+
+    const std::string path = entryPath( key );
+#if defined( _WIN32 )
+    const std::string temp_path = path + ".tmp" + std::to_string( GetCurrentProcessId() );
+#else
+    const std::string temp_path = path + ".tmp" + std::to_string( getpid() );
+#endif
+    bool written;
+    {
+        std::ofstream file( temp_path.c_str(), std::ios::binary | std::ios::trunc );
+        const std::string header = entryHeader( key, ptx.size() );
+        file.write( header.data(), header.size() );
+        file.write( ptx.data(), ptx.size() );
+        written = static_cast<bool>( file );
+    }
+#if defined( _WIN32 )
+    const bool renamed = written && MoveFileExA( temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+    const bool renamed = written && std::rename( temp_path.c_str(), path.c_str() ) == 0;
+#endif
+    if( !renamed )
+    {
+        std::remove( temp_path.c_str() );
+        return false;
+    }
+
+    // The new entry stays even if it alone exceeds the limit
+    evict( path );
+    return true;
+}
+
+
+size_t PtxCache::evict() const
+{
+    return evict( std::string() );
+}
+
+
+size_t PtxCache::evict( const std::string& keep ) const
+{
+    const std::vector<Entry> all   = entries();
+    uint64_t                 total = 0;
+    for( const Entry& entry : all )
+        total += entry.bytes;
+
+    size_t removed = 0;
+    for( const Entry& entry : all )
+    {
+        if( total <= m_max_bytes )
+            break;
+        if( entry.path != keep && std::remove( entry.path.c_str() ) == 0 )
+        {
+            total -= entry.bytes;
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+
+std::vector<PtxCache::Entry> PtxCache::entries() const
+{
+    std::vector<std::string> names;
+    if( !enabled() )
+        return std::vector<Entry>();
+#if defined( _WIN32 )
+    WIN32_FIND_DATAA find_data;
+    HANDLE           find = FindFirstFileA( ( m_directory + "\\*" + ENTRY_SUFFIX ).c_str(), &find_data );
+    if( find != INVALID_HANDLE_VALUE )
+    {
+        do
+            names.push_back( find_data.cFileName );
+        while( FindNextFileA( find, &find_data ) );
+        FindClose( find );
+    }
+#else
+    if( DIR* dir = opendir( m_directory.c_str() ) )
+    {
+        while( const dirent* entry = readdir( dir ) )
+            names.push_back( entry->d_name );
+        closedir( dir );
+    }
+#endif
+
+    const size_t       suffix = sizeof( ENTRY_SUFFIX ) - 1;
+    std::vector<Entry> result;
+    for( const std::string& name : names )
+    {
+        // Only files named <16 hex digits>.ptx belong to the cache
+        if( name.size() != 16 + suffix || name.compare( 16, suffix, ENTRY_SUFFIX ) != 0
+            || name.find_first_not_of( "0123456789abcdef" ) != 16 )
+            continue;
+        struct stat info;
+        const std::string path = m_directory + '/' + name;
+        if( stat( path.c_str(), &info ) != 0 )
+            continue;
+        result.push_back( { path, static_cast<uint64_t>( info.st_size ), static_cast<int64_t>( info.st_mtime ) } );
+    }
+    std::sort( result.begin(), result.end(), []( const Entry& a, const Entry& b ) {
+        return a.last_used != b.last_used ? a.last_used < b.last_used : a.path < b.path;
+    } );
+    return result;
+}
+
+
+std::string defaultPtxCacheDirectory()
+{
+    if( const char* directory = getenv( "OPTIX_SAMPLES_PTX_CACHE_DIR" ) )
+        return directory;
+#if defined( _WIN32 )
+    if( const char* local = getenv( "LOCALAPPDATA" ) )
+        return std::string( local ) + "\\optix-samples\\ptx";
+#else
+    if( const char* xdg = getenv( "XDG_CACHE_HOME" ) )
+        if( *xdg )
+            return std::string( xdg ) + "/optix-samples/ptx";
+    if( const char* home = getenv( "HOME" ) )
+        return std::string( home ) + "/.cache/optix-samples/ptx";
+#endif
+    return std::string();
+}
+
+
+uint64_t defaultPtxCacheBytes()
+{
+    if( const char* megabytes = getenv( "OPTIX_SAMPLES_PTX_CACHE_SIZE" ) )
+        return static_cast<uint64_t>( std::max( 0.0, atof( megabytes ) ) * 1024.0 * 1024.0 );
+    return uint64_t( 256 ) << 20;
+}
+
+} // end namespace sutil
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "sutilapi.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sutil
+{
+
+//-----------------------------------------------------------------------------
+//
+// On-disk cache of PTX compiled by NVRTC, used by getPtxString. Entries are
+// files named after the key in one directory. They are written under a
+// temporary name and renamed into place, so concurrent processes never see a
+// partial entry. A hit refreshes the modification time of its file, and
+// store() removes the least recently used files until the directory is back
+// under its size limit.
+//
+// Nothing here depends on CUDA or NVRTC.
+//
+//-----------------------------------------------------------------------------
+
+// 64-bit FNV-1a hash over every input of a compilation
+class PtxCacheKey
+{
+  public:
+    SUTILAPI void add( const void* data, size_t size );
+    SUTILAPI void add( const std::string& s );  // length prefixed, so "ab" + "c" differs from "a" + "bc"
+
+    uint64_t value() const { return m_hash; }
+    SUTILAPI std::string hex() const;
+
+  private:
+    uint64_t m_hash = 0xCBF29CE484222325ull;
+};
+
+// Append the files the preprocessor may read for source, recursively. Both
+// quoted and angle-bracket includes are resolved against include_dirs; quoted
+// includes are looked up next to the including file first. Includes that
+// resolve nowhere (NVRTC built-in headers) and computed includes are skipped.
+// Directives inside comments or disabled #if blocks are followed as well,
+// which can only add files to the key.
+SUTILAPI void collectIncludes( const std::string&              source,
+                               const std::string&              source_path,
+                               const std::vector<std::string>& include_dirs,
+                               std::vector<std::string>&       files );
+
+// Key of compiling source, read from source_path, with options: the source, the path and contents
+// of every file collectIncludes() finds, and the options. The caller adds the compiler version.
+SUTILAPI PtxCacheKey compilationKey( const std::string&              source,
+                                     const std::string&              source_path,
+                                     const std::vector<std::string>& include_dirs,
+                                     const std::vector<std::string>& options );
+
+class PtxCache
+{
+  public:
+    struct Entry
+    {
+        std::string path;
+        uint64_t    bytes;
+        int64_t     last_used;  // modification time in seconds
+    };
+
+    PtxCache() = default;
+    SUTILAPI PtxCache( const std::string& directory, uint64_t max_bytes );
+
+    bool               enabled() const { return !m_directory.empty(); }
+    const std::string& directory() const { return m_directory; }
+    uint64_t           maxBytes() const { return m_max_bytes; }
+
+    // Read the PTX stored for key and mark it as used; false if there is no intact entry
+    SUTILAPI bool load( const PtxCacheKey& key, std::string& ptx ) const;
+
+    // Store ptx under key, creating the directory if needed, then evict down to the size limit
+    SUTILAPI bool store( const PtxCacheKey& key, const std::string& ptx ) const;
+
+    // Remove least recently used entries until the cache fits its limit; returns how many went
+    SUTILAPI size_t evict() const;
+
+    // Entries on disk, least recently used first
+    SUTILAPI std::vector<Entry> entries() const;
+
+    SUTILAPI std::string entryPath( const PtxCacheKey& key ) const;
+
+  private:
+    size_t evict( const std::string& keep ) const;
+
+    std::string m_directory;
+    uint64_t    m_max_bytes = 0;
+};
+
+// OPTIX_SAMPLES_PTX_CACHE_DIR if set (empty disables the cache), else a
+// optix-samples/ptx directory in the per-user cache location of the platform
+SUTILAPI std::string defaultPtxCacheDirectory();
+
+// OPTIX_SAMPLES_PTX_CACHE_SIZE in MB if set, else 256 MB
+SUTILAPI uint64_t defaultPtxCacheBytes();
+
+} // end namespace sutil
@@ -31,6 +31,7 @@
 #include <sutil/Exception.h>
 #include <sutil/GLDisplay.h>
 #include <sutil/PPMLoader.h>
+#include <sutil/PtxCache.h>
 #include <sutil/sutil.h>
 #include <sutil/vec_math.h>
 
@@ -753,13 +754,14 @@ void displayFPS( unsigned int frame_count )
 void displayStats(std::chrono::duration<double>& state_update_time,
     std::chrono::duration<double>& render_time,
     std::chrono::duration<double>& display_time,
-    std::chrono::duration<double>& save_time)
+    std::chrono::duration<double>& save_time,
+    std::chrono::duration<double>& postprocess_time)
 {
     constexpr std::chrono::duration<double> display_update_min_interval_time(0.5);
     static int32_t                          total_subframe_count = 0;
     static int32_t                          last_update_frames = 0;
     static auto                             last_update_time = std::chrono::steady_clock::now();
-    static char                             display_text[128];
+    static char                             display_text[256];
 
     const auto cur_time = std::chrono::steady_clock::now();
 
@@ -775,16 +777,18 @@ void displayStats(std::chrono::duration<double>& state_update_time,
             "state update: %8.1f ms\n"
             "save image  : %8.1f ms\n"
             "render      : %8.1f ms\n"
+            "post-process: %8.1f ms\n"
             "display     : %8.1f ms\n",
             last_update_frames / std::chrono::duration<double>(cur_time - last_update_time).count(),
             (durationMs(state_update_time) / last_update_frames).count(),
             (durationMs(save_time) / last_update_frames).count(),
             (durationMs(render_time) / last_update_frames).count(),
+            (durationMs(postprocess_time) / last_update_frames).count(),
             (durationMs(display_time) / last_update_frames).count());
 
         last_update_time = cur_time;
         last_update_frames = 0;
-        state_update_time = save_time = render_time = display_time = std::chrono::duration<double>::zero();
+        state_update_time = save_time = render_time = postprocess_time = display_time = std::chrono::duration<double>::zero();
         if (total_subframe_count < 105) {
             std::cout << display_text << std::endl;
         }
@@ -899,46 +903,46 @@ static void getCuStringFromFile( std::string& cu, std::string& location, const c
 
 static std::string g_nvrtcLog;
 
-static void getPtxFromCuString( std::string& ptx, const char* sample_name, const char* cu_source, const char* name, const char** log_string )
+// Include directories (in search order) and NVRTC options for compiling a sample's CUDA file
+static void getNvrtcOptions( const char* sample_name, std::vector<std::string>& include_dirs, std::vector<std::string>& options )
 {
-    // Create program
-    nvrtcProgram prog = 0;
-    NVRTC_CHECK_ERROR( nvrtcCreateProgram( &prog, cu_source, name, 0, NULL, NULL ) );
-
-    // Gather NVRTC options
-    std::vector<const char*> options;
-
     const std::string base_dir = getSampleDir();
 
     // Set sample dir as the primary include path
-    std::string sample_dir;
     if( sample_name )
-    {
-        sample_dir = std::string( "-I" ) + base_dir + '/' + sample_name;
-        options.push_back( sample_dir.c_str() );
-    }
+        include_dirs.push_back( base_dir + '/' + sample_name );
 
     // Collect include dirs
-    std::vector<std::string> include_dirs;
-    const char*              abs_dirs[] = {SAMPLES_ABSOLUTE_INCLUDE_DIRS};
-    const char*              rel_dirs[] = {SAMPLES_RELATIVE_INCLUDE_DIRS};
+    const char* abs_dirs[] = {SAMPLES_ABSOLUTE_INCLUDE_DIRS};
+    const char* rel_dirs[] = {SAMPLES_RELATIVE_INCLUDE_DIRS};
 
     for( const char* dir : abs_dirs )
     {
-        include_dirs.push_back( std::string( "-I" ) + dir );
+        include_dirs.push_back( dir );
     }
     for( const char* dir : rel_dirs )
     {
-        include_dirs.push_back( "-I" + base_dir + '/' + dir );
+        include_dirs.push_back( base_dir + '/' + dir );
     }
-    for( const std::string& dir : include_dirs)
+    for( const std::string& dir : include_dirs )
     {
-        options.push_back( dir.c_str() );
+        options.push_back( "-I" + dir );
     }
 
     // Collect NVRTC options
-    const char*  compiler_options[] = {CUDA_NVRTC_OPTIONS};
-    std::copy( std::begin( compiler_options ), std::end( compiler_options ), std::back_inserter( options ) );
+    const char* compiler_options[] = {CUDA_NVRTC_OPTIONS};
+    options.insert( options.end(), std::begin( compiler_options ), std::end( compiler_options ) );
+}
+
+static void getPtxFromCuString( std::string& ptx, const std::vector<std::string>& option_strings, const char* cu_source, const char* name, const char** log_string )
+{
+    // Create program
+    nvrtcProgram prog = 0;
+    NVRTC_CHECK_ERROR( nvrtcCreateProgram( &prog, cu_source, name, 0, NULL, NULL ) );
+
+    std::vector<const char*> options;
+    for( const std::string& option : option_strings )
+        options.push_back( option.c_str() );
 
     // JIT compile CU to PTX
     const nvrtcResult compileRes = nvrtcCompileProgram( prog, (int)options.size(), options.data() );
@@ -1018,6 +1022,19 @@ static void getPtxStringFromFile( std::string& ptx, const char* sample_name, con
 
 #endif  // CUDA_NVRTC_ENABLED
 
+static PtxCache      g_ptxDiskCache( defaultPtxCacheDirectory(), defaultPtxCacheBytes() );
+static PtxCacheStats g_ptxCacheStats;
+
+void setPtxCache( const char* directory, size_t max_bytes )
+{
+    g_ptxDiskCache = PtxCache( directory ? directory : "", max_bytes );
+}
+
+PtxCacheStats getPtxCacheStats()
+{
+    return g_ptxCacheStats;
+}
+
 struct PtxSourceCache
 {
     std::map<std::string, std::string*> map;
@@ -1044,7 +1061,35 @@ const char* getPtxString( const char* sample, const char* sampleDir, const char*
 #if CUDA_NVRTC_ENABLED
         std::string location;
         getCuStringFromFile( cu, location, sampleDir, filename );
-        getPtxFromCuString( *ptx, sample, cu.c_str(), location.c_str(), log );
+
+        std::vector<std::string> include_dirs, options;
+        getNvrtcOptions( sample, include_dirs, options );
+
+        // The disk cache key covers the source, every header it may include, the options and the compiler
+        PtxCacheKey cache_key;
+        bool        cached = false;
+        if( g_ptxDiskCache.enabled() )
+        {
+            cache_key = compilationKey( cu, location, include_dirs, options );
+            int nvrtc_version[2] = {};
+            NVRTC_CHECK_ERROR( nvrtcVersion( &nvrtc_version[0], &nvrtc_version[1] ) );
+            cache_key.add( nvrtc_version, sizeof( nvrtc_version ) );
+            cached = g_ptxDiskCache.load( cache_key, *ptx );
+        }
+
+        if( !cached )
+        {
+            const auto t0 = std::chrono::steady_clock::now();
+            getPtxFromCuString( *ptx, options, cu.c_str(), location.c_str(), log );
+            g_ptxCacheStats.compile_ms += std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - t0 ).count();
+            ++g_ptxCacheStats.misses;
+            if( g_ptxDiskCache.enabled() && !g_ptxDiskCache.store( cache_key, *ptx ) )
+                std::cerr << "sutil: could not write the PTX cache in " << g_ptxDiskCache.directory() << "\n";
+        }
+        else
+        {
+            ++g_ptxCacheStats.hits;
+        }
 #else
         getPtxStringFromFile( *ptx, sample, filename );
 #endif
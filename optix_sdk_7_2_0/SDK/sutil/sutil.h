@@ -114,7 +114,8 @@ SUTILAPI void displayFPS( unsigned total_frame_count );
 SUTILAPI void displayStats( std::chrono::duration<double>& state_update_time,
                             std::chrono::duration<double>& render_time,
                             std::chrono::duration<double>& display_time,
-                            std::chrono::duration<double>& save_time);
+                            std::chrono::duration<double>& save_time,
+                            std::chrono::duration<double>& postprocess_time);
 
 // Display a short string starting at x,y.
 SUTILAPI void displayText( const char* text, float x, float y );
@@ -152,6 +153,19 @@ SUTILAPI const char* getPtxString(
         const char* filename,               // Cuda C input file name
         const char** log = NULL );          // (Optional) pointer to compiler log string. If *log == NULL there is no output. Only valid until the next getPtxString call
 
+// Directory and size limit of the on-disk cache of NVRTC compiled PTX (see PtxCache.h). A NULL or empty
+// directory disables it. The defaults come from OPTIX_SAMPLES_PTX_CACHE_DIR and OPTIX_SAMPLES_PTX_CACHE_SIZE.
+SUTILAPI void setPtxCache( const char* directory, size_t max_bytes );
+
+struct PtxCacheStats
+{
+    unsigned int hits       = 0;   // getPtxString calls answered from the disk cache
+    unsigned int misses     = 0;   // calls that ran NVRTC
+    double       compile_ms = 0.0; // time spent in NVRTC
+};
+
+SUTILAPI PtxCacheStats getPtxCacheStats();
+
 // Ensures that width and height have the minimum size to prevent launch errors.
 SUTILAPI void ensureMinimumSize(
     int& width,                             // Will be assigned the minimum suitable width if too small.